@@ -9,6 +9,8 @@
 
 #include <jni.h>
 #include <obd/obd.h>
+#include <stdint.h>
+#include <stdlib.h>
 
 /* ═══════════════════════════════════════════════════════════════════════════
  *  ELM327 AT Commands
@@ -253,3 +255,209 @@ Java_com_carscan_app_obd_ObdNative_parseVinResponse(
     if (r != OBD_OK) return NULL;
     return (*env)->NewStringUTF(env, vin);
 }
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Change filter
+ *  An obd_filter_t lives on the native heap; Kotlin holds it as a Long
+ *  handle from filterCreate() until filterDestroy().
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+JNIEXPORT jlong JNICALL
+Java_com_carscan_app_obd_ObdNative_filterCreate(
+    JNIEnv *env, jobject thiz, jlong keepalive_ms)
+{
+    obd_filter_t *filter;
+
+    (void)env;
+    (void)thiz;
+    filter = malloc(sizeof(*filter));
+    if (!filter) return 0;
+    obd_filter_init(filter);
+    filter->keepalive_us = (uint64_t)keepalive_ms * 1000u;
+    return (jlong)(intptr_t)filter;
+}
+
+JNIEXPORT void JNICALL
+Java_com_carscan_app_obd_ObdNative_filterDestroy(
+    JNIEnv *env, jobject thiz, jlong handle)
+{
+    (void)env;
+    (void)thiz;
+    free((obd_filter_t *)(intptr_t)handle);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_carscan_app_obd_ObdNative_filterSet(
+    JNIEnv *env, jobject thiz, jlong handle, jint pid,
+    jfloat abs_deadband, jfloat rel_deadband, jlong keepalive_ms)
+{
+    obd_filter_t *filter = (obd_filter_t *)(intptr_t)handle;
+
+    (void)env;
+    (void)thiz;
+    if (!filter) return JNI_FALSE;
+    return obd_filter_set(filter, (uint8_t)pid, abs_deadband, rel_deadband,
+                          (uint64_t)keepalive_ms * 1000u) == OBD_OK;
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_carscan_app_obd_ObdNative_filterDecode(
+    JNIEnv *env, jobject thiz, jlong handle, jstring cleaned_hex, jlong now_ms)
+{
+    obd_filter_t *filter = (obd_filter_t *)(intptr_t)handle;
+    const char *hex;
+    obd_pid_response_t pid_resp;
+    obd_sensor_value_t val;
+    obd_result_t r;
+    jclass cls;
+    jmethodID ctor;
+
+    (void)thiz;
+    if (!filter) return NULL;
+    hex = (*env)->GetStringUTFChars(env, cleaned_hex, NULL);
+    if (!hex) return NULL;  /* OOM — JVM already threw OutOfMemoryError */
+    r = obd_pid_parse_response(hex, &pid_resp);
+    (*env)->ReleaseStringUTFChars(env, cleaned_hex, hex);
+    if (r != OBD_OK) return NULL;
+
+    /* Unchanged bytes stop here, before decoding and before any JNI objects */
+    if (obd_filter_decode(filter, &pid_resp, (uint64_t)now_ms * 1000u, &val) != OBD_OK) {
+        return NULL;
+    }
+
+    cls = (*env)->FindClass(env, "com/carscan/app/obd/SensorValue");
+    if (!cls) return NULL;  /* Class stripped by ProGuard or not found */
+    ctor = (*env)->GetMethodID(env, cls, "<init>",
+        "(IFLjava/lang/String;Ljava/lang/String;)V");
+    if (!ctor) return NULL;  /* Constructor not found */
+    return (*env)->NewObject(env, cls, ctor,
+        (jint)val.pid, val.value,
+        (*env)->NewStringUTF(env, val.name),
+        (*env)->NewStringUTF(env, val.unit));
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_carscan_app_obd_ObdNative_filterStats(
+    JNIEnv *env, jobject thiz, jlong handle)
+{
+    obd_filter_t *filter = (obd_filter_t *)(intptr_t)handle;
+    jclass cls;
+    jmethodID ctor;
+
+    (void)thiz;
+    if (!filter) return NULL;
+
+    /* Construct FilterStats(samples, unchanged, passed, keepalives: Long) */
+    cls = (*env)->FindClass(env, "com/carscan/app/obd/FilterStats");
+    if (!cls) return NULL;  /* Class stripped by ProGuard or not found */
+    ctor = (*env)->GetMethodID(env, cls, "<init>", "(JJJJ)V");
+    if (!ctor) return NULL;  /* Constructor not found */
+    return (*env)->NewObject(env, cls, ctor,
+        (jlong)filter->samples, (jlong)filter->unchanged,
+        (jlong)filter->passed, (jlong)filter->keepalives);
+}
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Downsampling
+ *  Results come back as FloatArrays ready to draw. The arrays are pinned
+ *  with GetPrimitiveArrayCritical rather than copied, so a query over a
+ *  long trip costs its pixels, not the trip; the output array is made
+ *  first because no JNI calls are allowed while they're pinned.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+JNIEXPORT jfloatArray JNICALL
+Java_com_carscan_app_obd_ObdNative_lttb(
+    JNIEnv *env, jobject thiz, jfloatArray xs, jfloatArray ys, jint threshold)
+{
+    jsize n, i;
+    size_t count, *index;
+    jfloatArray result;
+    float *x, *y, *out;
+    obd_result_t r;
+
+    (void)thiz;
+    n = (*env)->GetArrayLength(env, xs);
+    if (threshold < 0 || (*env)->GetArrayLength(env, ys) != n) return NULL;
+    count = (size_t)n < (size_t)threshold ? (size_t)n : (size_t)threshold;
+    index = malloc((count ? count : 1) * sizeof(*index));
+    if (!index) return NULL;
+    result = (*env)->NewFloatArray(env, (jsize)(2 * count));
+    if (!result) {
+        free(index);
+        return NULL;  /* OOM — JVM already threw OutOfMemoryError */
+    }
+
+    x = (*env)->GetPrimitiveArrayCritical(env, xs, NULL);
+    y = (*env)->GetPrimitiveArrayCritical(env, ys, NULL);
+    out = (*env)->GetPrimitiveArrayCritical(env, result, NULL);
+    r = OBD_ERROR_INVALID_ARG;
+    if (x && y && out) {
+        r = obd_lttb(x, y, (size_t)n, (size_t)threshold, index, &count);
+        for (i = 0; r == OBD_OK && (size_t)i < count; i++) {
+            out[2 * i] = x[index[i]];       /* x0, y0, x1, y1, ... */
+            out[2 * i + 1] = y[index[i]];
+        }
+    }
+    if (out) (*env)->ReleasePrimitiveArrayCritical(env, result, out, 0);
+    if (y) (*env)->ReleasePrimitiveArrayCritical(env, ys, y, JNI_ABORT);
+    if (x) (*env)->ReleasePrimitiveArrayCritical(env, xs, x, JNI_ABORT);
+    free(index);
+    return r == OBD_OK ? result : NULL;
+}
+
+JNIEXPORT jfloatArray JNICALL
+Java_com_carscan_app_obd_ObdNative_pyramidBuild(
+    JNIEnv *env, jobject thiz, jfloatArray values)
+{
+    obd_pyramid_t pyr;
+    jfloatArray result;
+    size_t n, size;
+    float *v, *out;
+    obd_result_t r = OBD_ERROR_INVALID_ARG;
+
+    (void)thiz;
+    n = (size_t)(*env)->GetArrayLength(env, values);
+    size = obd_pyramid_size(n);
+    if (size == 0) return NULL;
+    result = (*env)->NewFloatArray(env, (jsize)size);
+    if (!result) return NULL;  /* OOM — JVM already threw OutOfMemoryError */
+
+    v = (*env)->GetPrimitiveArrayCritical(env, values, NULL);
+    out = (*env)->GetPrimitiveArrayCritical(env, result, NULL);
+    if (v && out) r = obd_pyramid_build(&pyr, v, n, out, size);
+    if (out) (*env)->ReleasePrimitiveArrayCritical(env, result, out, 0);
+    if (v) (*env)->ReleasePrimitiveArrayCritical(env, values, v, JNI_ABORT);
+    return r == OBD_OK ? result : NULL;
+}
+
+JNIEXPORT jfloatArray JNICALL
+Java_com_carscan_app_obd_ObdNative_pyramidQuery(
+    JNIEnv *env, jobject thiz, jfloatArray pyramid, jfloatArray values,
+    jint first, jint last, jint pixels)
+{
+    obd_pyramid_t pyr;
+    jfloatArray result;
+    size_t n, len;
+    float *p, *v, *out;
+    obd_result_t r = OBD_ERROR_INVALID_ARG;
+
+    (void)thiz;
+    if (!pyramid || !values || first < 0 || last < 0 || pixels <= 0) return NULL;
+    n = (size_t)(*env)->GetArrayLength(env, values);
+    len = (size_t)(*env)->GetArrayLength(env, pyramid);
+    result = (*env)->NewFloatArray(env, 2 * pixels);
+    if (!result) return NULL;  /* OOM — JVM already threw OutOfMemoryError */
+
+    p = (*env)->GetPrimitiveArrayCritical(env, pyramid, NULL);
+    v = (*env)->GetPrimitiveArrayCritical(env, values, NULL);
+    out = (*env)->GetPrimitiveArrayCritical(env, result, NULL);
+    if (p && v && out && obd_pyramid_attach(&pyr, p, len, n) == OBD_OK) {
+        r = obd_pyramid_query(&pyr, v, (size_t)first, (size_t)last, (size_t)pixels, out);
+    }
+    if (out) (*env)->ReleasePrimitiveArrayCritical(env, result, out, 0);
+    if (v) (*env)->ReleasePrimitiveArrayCritical(env, values, v, JNI_ABORT);
+    if (p) (*env)->ReleasePrimitiveArrayCritical(env, pyramid, p, JNI_ABORT);
+    return r == OBD_OK ? result : NULL;
+}
@@ -66,6 +66,57 @@ object ObdNative {
     /** Parse a VIN response into a 17-character string. Null on error. */
     external fun parseVinResponse(cleanedHex: String): String?
 
+    /* ── Change filter ────────────────────────────────────────────────── */
+
+    /**
+     * Create a change filter; returns a handle (0 on failure) to pass to the
+     * other filter functions and, when done, to filterDestroy(). PIDs
+     * without filterSet() pass any change, and repeat after keepaliveMs of
+     * silence (0 = never).
+     */
+    external fun filterCreate(keepaliveMs: Long): Long
+
+    /** Free a filter from filterCreate(). */
+    external fun filterDestroy(handle: Long)
+
+    /** Deadbands (absolute, and relative to the last value passed) and keepalive for a PID. */
+    external fun filterSet(handle: Long, pid: Int, absDeadband: Float, relDeadband: Float,
+                           keepaliveMs: Long): Boolean
+
+    /**
+     * decodeSensor(), through the filter: null unless the value changed by more
+     * than its deadband or its keepalive is due (or on error). Replies with
+     * the same data bytes as last time aren't decoded at all.
+     */
+    external fun filterDecode(handle: Long, cleanedHex: String, nowMs: Long): SensorValue?
+
+    /** The filter's counters. Null on error. */
+    external fun filterStats(handle: Long): FilterStats?
+
+    /* ── Downsampling ─────────────────────────────────────────────────── */
+
+    /**
+     * Largest-Triangle-Three-Buckets: at most threshold (>= 3) of the samples,
+     * chosen to keep the line's shape, as x0, y0, x1, y1, ... ready for a
+     * Path. Reads every sample; for zooming a long trip use pyramidQuery().
+     * Null on error.
+     */
+    external fun lttb(x: FloatArray, y: FloatArray, threshold: Int): FloatArray?
+
+    /**
+     * The min/max pyramid of an evenly spaced series. Build it once, when the
+     * trip log is written, and store it next to the log. Null on error.
+     */
+    external fun pyramidBuild(values: FloatArray): FloatArray?
+
+    /**
+     * Min and max of values[first until last] under each of pixels columns:
+     * min0, max0, min1, max1, ... one vertical line per column. Costs the
+     * number of columns, whatever the window. Null on error.
+     */
+    external fun pyramidQuery(pyramid: FloatArray, values: FloatArray, first: Int, last: Int,
+                              pixels: Int): FloatArray?
+
     /* ── Response type constants (match obd_elm_response_type_t) ──────── */
 
     const val RESPONSE_DATA = 0
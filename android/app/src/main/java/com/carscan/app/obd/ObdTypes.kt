@@ -20,3 +20,14 @@ data class DtcCode(
     val code: Int,        // Numeric part, e.g. 0x0301
     val formatted: String // "P0301"
 )
+
+/**
+ * Counters of a change filter.
+ * Produced by ObdNative.filterStats().
+ */
+data class FilterStats(
+    val samples: Long,    // Replies filtered
+    val unchanged: Long,  // ...stopped before decoding (same bytes as last time)
+    val passed: Long,     // ...handed on
+    val keepalives: Long  // ...of those, only because the keepalive was due
+)
@@ -3,6 +3,7 @@ package com.carscan.app.ui
 import android.content.Intent
 import android.graphics.Typeface
 import android.os.Bundle
+import android.os.SystemClock
 import android.view.Gravity
 import android.widget.Button
 import android.widget.LinearLayout
@@ -20,6 +21,8 @@ import kotlinx.coroutines.launch
 /**
  * Live sensor data display.
  * Polls mock adapter for RPM, speed, coolant temp, and throttle position.
+ * Replies go through a native change filter, so a card is only redrawn
+ * when its value has moved by more than its deadband.
  */
 class LiveDataActivity : AppCompatActivity() {
 
@@ -29,6 +32,9 @@ class LiveDataActivity : AppCompatActivity() {
     // PIDs to poll: RPM, Speed, Coolant, Throttle
     private val pollPids = listOf(0x0C, 0x0D, 0x05, 0x11)
 
+    // Change filter: redraw only on real changes, and every 5 s regardless
+    private var filter = 0L
+
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
 
@@ -75,6 +81,10 @@ class LiveDataActivity : AppCompatActivity() {
         scroll.addView(layout)
         setContentView(scroll)
 
+        filter = ObdNative.filterCreate(KEEPALIVE_MS)
+        ObdNative.filterSet(filter, 0x0C, 25f, 0f, KEEPALIVE_MS)   // RPM: 25 rpm
+        ObdNative.filterSet(filter, 0x11, 1f, 0f, KEEPALIVE_MS)    // Throttle: 1%
+
         // Connect and start polling
         lifecycleScope.launch {
             adapter.connect()
@@ -82,6 +92,12 @@ class LiveDataActivity : AppCompatActivity() {
         }
     }
 
+    override fun onDestroy() {
+        super.onDestroy()
+        ObdNative.filterDestroy(filter)
+        filter = 0L
+    }
+
     private fun createSensorCard(pid: Int, name: String): LinearLayout {
         val card = LinearLayout(this).apply {
             orientation = LinearLayout.VERTICAL
@@ -119,7 +135,9 @@ class LiveDataActivity : AppCompatActivity() {
                 val request = ObdNative.buildPidRequest(0x01, pid) ?: continue
                 val raw = adapter.sendCommand(request)
                 val cleaned = ObdNative.cleanResponse(raw) ?: continue
-                val sensor = ObdNative.decodeSensor(cleaned) ?: continue
+                // Null when nothing changed: no decode, no redraw
+                val sensor = ObdNative.filterDecode(
+                    filter, cleaned, SystemClock.elapsedRealtime()) ?: continue
 
                 sensorViews[pid]?.text = formatSensor(sensor)
             }
@@ -134,4 +152,8 @@ class LiveDataActivity : AppCompatActivity() {
             "${"%.1f".format(s.value)} ${s.unit}"
         }
     }
+
+    companion object {
+        private const val KEEPALIVE_MS = 5000L
+    }
 }
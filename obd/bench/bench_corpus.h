@@ -0,0 +1,133 @@
+/**
+ * bench_corpus.h — Realistic input mixes for the obd_bench benchmarks.
+ *
+ * The unit tests in tests/test_data.h use one canned response per case.
+ * A benchmark needs a MIX: real adapters hand us spaced and unspaced hex,
+ * multi-line replies, echoes, prompts and error lines all interleaved.
+ * Measuring one happy-path string would hide the cost of the others.
+ *
+ * Every array is NULL-terminated so the benchmark loops don't need a
+ * separate count.
+ */
+
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+/* ── Hex strings (input to obd_hex_to_bytes) ───────────────────────────
+ * ATS1 (spaces on, the default) vs ATS0 (spaces off) adapters. */
+static const char *const corpus_hex_spaced[] = {
+    "41 0C 1A F8",
+    "41 0D 3C",
+    "41 05 7B",
+    "41 10 01 A4",
+    "41 01 83 07 65 04",
+    "43 01 03 01 04 00 00",
+    "49 02 01 57 42 41 33",
+    "7E8 06 41 00 BE 3F A8 13",
+    NULL
+};
+
+static const char *const corpus_hex_unspaced[] = {
+    "410C1AF8",
+    "410D3C",
+    "41057B",
+    "411001A4",
+    "410183076504",
+    "43010301040000",
+    "49020157424133",
+    "4100BE3FA813",
+    NULL
+};
+
+
+/* ── Single lines (input to obd_elm327_classify_response) ───────────────
+ * Roughly what a polling loop sees: mostly data, with the occasional
+ * status or error line mixed in. */
+static const char *const corpus_classify[] = {
+    "41 0C 1A F8",
+    "41 0D 3C",
+    "OK",
+    "41 05 7B",
+    "NO DATA",
+    "41 11 33",
+    "?",
+    "49 02 01 57 42 41 33",
+    "ELM327 v1.5",
+    "UNABLE TO CONNECT",
+    "41 10 01 A4",
+    ">",
+    NULL
+};
+
+
+/* ── Raw adapter output (input to obd_elm327_clean_response) ────────────
+ * Echo + data + prompt, exactly as it arrives over Bluetooth. */
+static const char *const corpus_clean_single[] = {
+    "010C\r41 0C 1A F8\r\r>",
+    "010D\r41 0D 3C\r\r>",
+    "0105\r41 05 7B\r\r>",
+    "0111\r41 11 33\r\r>",
+    "0110\r41 10 01 A4\r\r>",
+    "41 0C 1A F8\r\r>",          /* echo already off (ATE0) */
+    "410D3C\r\r>",                /* spaces off (ATS0) */
+    NULL
+};
+
+/* Multi-line replies: VIN and multi-ECU answers */
+static const char *const corpus_clean_multiline[] = {
+    "0902\r49 02 01 57 42 41 33\r49 02 02 42 35 46 4B\r"
+    "49 02 03 37 46 4E 31\r49 02 04 32 33 34 35\r49 02 05 36 00 00 00\r\r>",
+    "0100\r41 00 BE 3F A8 13\r41 00 98 18 80 11\r\r>",
+    "03\r43 01 03 01 04 00 00\r43 C1 23 00 00 00 00\r\r>",
+    NULL
+};
+
+/* Replies with no usable data — the cleaner has to scan them fully */
+static const char *const corpus_clean_error[] = {
+    "0100\rNO DATA\r\r>",
+    "ATZZ\r?\r\r>",
+    "0100\rSEARCHING...\rUNABLE TO CONNECT\r\r>",
+    "010C\rCAN ERROR\r\r>",
+    "010C\rBUS INIT: ...ERROR\r\r>",
+    NULL
+};
+
+
+/* ── Cleaned Mode 01 responses (input to obd_pid_parse_response) ────── */
+static const char *const corpus_pid[] = {
+    "41 0C 1A F8",
+    "41 0D 3C",
+    "41 05 7B",
+    "41 11 33",
+    "41 0F 46",
+    "41 10 01 A4",
+    "41 04 4C",
+    "41 1F 01 00",
+    "41 01 83 07 65 04",
+    "410C1AF8",
+    NULL
+};
+
+
+/* ── Cleaned Mode 03 responses (input to obd_dtc_parse_response) ────── */
+static const char *const corpus_dtc[] = {
+    "43 01 03 01 04 00 00",
+    "43 01 03 41 04 80 00",
+    "43 00 00 00 00 00 00",
+    "43 C1 23 00 00 00 00",
+    "43 03 01 03 02 03 03\r43 03 04 00 00 00 00",
+    NULL
+};
+
+
+/* ── Cleaned Mode 09 PID 02 responses (input to obd_vin_parse_response) */
+static const char *const corpus_vin[] = {
+    "49 02 01 57 42 41 33\r49 02 02 42 35 46 4B\r49 02 03 37 46 4E 31\r"
+    "49 02 04 32 33 34 35\r49 02 05 36 00 00 00",
+    "49 02 01 00 00 00 31\r49 02 02 47 31 4A 43\r49 02 03 35 34 34 34\r"
+    "49 02 04 52 37 32 35\r49 02 05 32 33 36 37",
+    "4902015742413\r",            /* truncated: the parser must reject it */
+    NULL
+};
+
+#endif /* BENCH_CORPUS_H */
@@ -0,0 +1,500 @@
+/**
+ * bench_fleet.c — Many adapters at once through the fleet loop (obd_fleet_bench).
+ *
+ * obd_bench measures single parser calls. This measures the whole path
+ * a test rig or gateway runs: write a command to a tty, let the "car"
+ * answer, read it back, clean, parse, decode, hand it over, send the
+ * next one — for hundreds of adapters on one thread.
+ *
+ * Each adapter is an emulator (io/emu.c) on the far side of a pty (or
+ * of a socketpair, standing in for a WiFi adapter's TCP connection);
+ * one "car" thread serves all of them over its own epoll loop. The
+ * driver threads each run an obd_fleet_t over their share of the near
+ * ends. Every adapter always has one request in flight, cycling through
+ * RPM, speed, coolant, throttle, intake temp and MAF.
+ *
+ * Reported:
+ *   PIDs/s     results per second across all adapters
+ *   latency    submit → result, µs: p50, p90, p99, p99.9, max
+ *   wakeups    epoll_wait / io_uring_enter returns per result: < 1 means
+ *              each wakeup handled several adapters
+ *   syscalls   every system call the fleet made, per result
+ *
+ * Usage:
+ *   obd_fleet_bench                          256 adapters, 1 thread, 5 s
+ *   obd_fleet_bench --adapters 64 --threads 4 --seconds 10
+ *   obd_fleet_bench --backend uring --transport socket
+ *   obd_fleet_bench --compare                both backends, 100 and 1000
+ *                                            adapters on sockets, one table
+ *   obd_fleet_bench --json results.json      also write one JSON line
+ *
+ * The car side replies at once, so the numbers are the host's cost per
+ * round trip; a real car adds 30–100 ms of bus time on top.
+ */
+
+#define _GNU_SOURCE
+
+#include <obd/obd_io.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS     64
+#define MAX_SAMPLES     (1u << 21)      /* Latency samples kept per thread */
+
+static const uint8_t pid_cycle[] = { 0x0C, 0x0D, 0x05, 0x11, 0x0F, 0x10 };
+#define PID_CYCLE_LEN (sizeof(pid_cycle) / sizeof(pid_cycle[0]))
+
+static atomic_int stop_cars;
+static atomic_int stop_drivers;
+static atomic_int measuring;
+
+
+/* ── The car side: every emulator on one epoll loop ──────────────────── */
+
+typedef struct {
+    int       *fds;                     /* pty slaves / socket far ends */
+    obd_emu_t *emus;
+    size_t     count;
+    uint64_t   answered;
+} car_side_t;
+
+static void *car_thread(void *arg)
+{
+    car_side_t *cars = arg;
+    struct epoll_event events[64];
+    char in[512], out[2048];
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    size_t i;
+
+    for (i = 0; i < cars->count; i++) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.u64 = i;
+        epoll_ctl(ep, EPOLL_CTL_ADD, cars->fds[i], &ev);
+    }
+
+    while (!atomic_load(&stop_cars)) {
+        int n = epoll_wait(ep, events, 64, 10);
+        int k;
+
+        for (k = 0; k < n; k++) {
+            size_t idx = (size_t)events[k].data.u64;
+            ssize_t got;
+
+            while ((got = read(cars->fds[idx], in, sizeof(in))) > 0) {
+                size_t n_out = 0, done = 0;
+                obd_emu_feed(&cars->emus[idx], in, (size_t)got, out, sizeof(out), &n_out);
+                while (done < n_out) {
+                    ssize_t w = write(cars->fds[idx], out + done, n_out - done);
+                    if (w > 0) done += (size_t)w;
+                    else if (w < 0 && errno != EAGAIN && errno != EINTR) break;
+                }
+                if (n_out > 0) cars->answered++;
+            }
+        }
+    }
+    close(ep);
+    return NULL;
+}
+
+
+/* ── The driver side: one fleet per thread ───────────────────────────── */
+
+typedef struct {
+    obd_fleet_t          fleet;
+    obd_fleet_adapter_t *slots;
+    size_t               count;
+    uint64_t            *submitted_at;  /* Per adapter */
+    size_t              *next_pid;
+    uint32_t            *samples;       /* Latency, µs */
+    size_t               sample_count;
+    uint64_t             results;       /* While measuring */
+    uint64_t             errors;
+    uint64_t             wakeups_start;
+    uint64_t             syscalls_start;
+} driver_t;
+
+static void submit_next(driver_t *d, size_t index)
+{
+    uint8_t pid = pid_cycle[d->next_pid[index]++ % PID_CYCLE_LEN];
+    d->submitted_at[index] = obd_io_now_us();
+    obd_fleet_submit_pid(&d->fleet, index, 0x01, pid, d->submitted_at[index], NULL);
+}
+
+static void on_result(void *ctx, size_t index, const obd_session_result_t *res)
+{
+    driver_t *d = ctx;
+
+    if (res->status == OBD_ERROR_IO && res->id == 0) {
+        return;                         /* Adapter lost: nothing to resubmit */
+    }
+    if (atomic_load(&measuring)) {
+        uint64_t us = obd_io_now_us() - d->submitted_at[index];
+        d->results++;
+        if (res->status != OBD_OK) d->errors++;
+        if (d->sample_count < MAX_SAMPLES) {
+            d->samples[d->sample_count++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+        }
+    }
+    if (!atomic_load(&stop_drivers)) {
+        submit_next(d, index);
+    }
+}
+
+static void *driver_thread(void *arg)
+{
+    driver_t *d = arg;
+    int started = 0;
+    size_t i;
+
+    for (i = 0; i < d->count; i++) {
+        submit_next(d, i);
+    }
+    while (!atomic_load(&stop_drivers)) {
+        if (!started && atomic_load(&measuring)) {
+            d->wakeups_start = d->fleet.stats.wakeups;
+            d->syscalls_start = d->fleet.stats.syscalls;
+            started = 1;
+        }
+        obd_fleet_step(&d->fleet, 10);
+    }
+    return NULL;
+}
+
+
+/* ── Report ──────────────────────────────────────────────────────────── */
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t n, double p)
+{
+    size_t at;
+    if (n == 0) return 0;
+    at = (size_t)(p / 100.0 * (double)(n - 1) + 0.5);
+    return sorted[at < n ? at : n - 1];
+}
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+    }
+}
+
+typedef struct {
+    size_t              adapters;
+    size_t              threads;
+    long                seconds;
+    long                warmup_ms;
+    obd_fleet_backend_t backend;
+    int                 sockets;        /* socketpairs instead of ptys */
+} config_t;
+
+typedef struct {
+    obd_fleet_backend_t backend;        /* What the fleets actually used */
+    double              secs;
+    double              rate;
+    uint64_t            results, errors, timeouts, lost, wakeups, syscalls;
+    uint32_t            p50, p90, p99, p999, max;
+} outcome_t;
+
+static int open_adapter(int sockets, int *near_end, int *far_end)
+{
+    int sv[2];
+
+    if (!sockets) {
+        return obd_pty_open(near_end, far_end) == OBD_OK;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) < 0) {
+        return 0;
+    }
+    *near_end = sv[0];
+    *far_end = sv[1];
+    return 1;
+}
+
+/* One measured run; 0 on success */
+static int run(const config_t *cfg, outcome_t *out)
+{
+    static driver_t drivers[MAX_THREADS];
+    pthread_t driver_ids[MAX_THREADS], car_id;
+    car_side_t cars;
+    int *masters;
+    uint32_t *all;
+    size_t all_count = 0, i, t;
+    uint64_t start_us, elapsed_us;
+
+    memset(out, 0, sizeof(*out));
+    memset(drivers, 0, sizeof(drivers));
+    atomic_store(&stop_cars, 0);
+    atomic_store(&stop_drivers, 0);
+    atomic_store(&measuring, 0);
+
+    masters = calloc(cfg->adapters, sizeof(*masters));
+    cars.fds = calloc(cfg->adapters, sizeof(*cars.fds));
+    cars.emus = calloc(cfg->adapters, sizeof(*cars.emus));
+    cars.count = cfg->adapters;
+    cars.answered = 0;
+    if (!masters || !cars.fds || !cars.emus) {
+        fprintf(stderr, "obd_fleet_bench: out of memory\n");
+        return 1;
+    }
+    for (i = 0; i < cfg->adapters; i++) {
+        if (!open_adapter(cfg->sockets, &masters[i], &cars.fds[i])) {
+            fprintf(stderr, "obd_fleet_bench: adapter %zu: %s\n", i, strerror(errno));
+            return 1;
+        }
+        obd_emu_init(&cars.emus[i]);
+        cars.emus[i].echo = 0;          /* As if ATE0 had been sent */
+    }
+
+    /* Adapters dealt out to the threads in contiguous shares */
+    for (t = 0; t < cfg->threads; t++) {
+        driver_t *d = &drivers[t];
+        size_t first = cfg->adapters * t / cfg->threads;
+        size_t last = cfg->adapters * (t + 1) / cfg->threads;
+
+        d->count = last - first;
+        d->slots = calloc(d->count, sizeof(*d->slots));
+        d->submitted_at = calloc(d->count, sizeof(*d->submitted_at));
+        d->next_pid = calloc(d->count, sizeof(*d->next_pid));
+        d->samples = malloc(MAX_SAMPLES * sizeof(*d->samples));
+        if (!d->slots || !d->submitted_at || !d->next_pid || !d->samples ||
+            obd_fleet_init(&d->fleet, d->slots, d->count, on_result, d) != OBD_OK ||
+            obd_fleet_set_backend(&d->fleet, cfg->backend) != OBD_OK) {
+            fprintf(stderr, "obd_fleet_bench: fleet setup failed\n");
+            return 1;
+        }
+        for (i = first; i < last; i++) {
+            obd_fleet_add(&d->fleet, masters[i], NULL);
+            d->next_pid[i - first] = i;
+        }
+    }
+    out->backend = obd_fleet_backend(&drivers[0].fleet);
+
+    pthread_create(&car_id, NULL, car_thread, &cars);
+    for (t = 0; t < cfg->threads; t++) {
+        pthread_create(&driver_ids[t], NULL, driver_thread, &drivers[t]);
+    }
+
+    sleep_ms(cfg->warmup_ms);
+    start_us = obd_io_now_us();
+    atomic_store(&measuring, 1);
+    sleep_ms(cfg->seconds * 1000);
+    atomic_store(&measuring, 0);
+    elapsed_us = obd_io_now_us() - start_us;
+
+    atomic_store(&stop_drivers, 1);
+    for (t = 0; t < cfg->threads; t++) pthread_join(driver_ids[t], NULL);
+    atomic_store(&stop_cars, 1);
+    pthread_join(car_id, NULL);
+
+    /* Everyone's samples together */
+    for (t = 0; t < cfg->threads; t++) all_count += drivers[t].sample_count;
+    all = malloc((all_count ? all_count : 1) * sizeof(*all));
+    if (!all) {
+        fprintf(stderr, "obd_fleet_bench: out of memory\n");
+        return 1;
+    }
+    all_count = 0;
+    for (t = 0; t < cfg->threads; t++) {
+        driver_t *d = &drivers[t];
+        memcpy(all + all_count, d->samples, d->sample_count * sizeof(*all));
+        all_count += d->sample_count;
+        out->results += d->results;
+        out->errors += d->errors;
+        out->wakeups += d->fleet.stats.wakeups - d->wakeups_start;
+        out->syscalls += d->fleet.stats.syscalls - d->syscalls_start;
+        out->lost += d->fleet.stats.lost;
+        out->timeouts += d->fleet.stats.timeouts;
+    }
+    qsort(all, all_count, sizeof(*all), compare_u32);
+
+    out->secs = (double)elapsed_us / 1e6;
+    out->rate = (double)out->results / out->secs;
+    out->p50 = percentile(all, all_count, 50);
+    out->p90 = percentile(all, all_count, 90);
+    out->p99 = percentile(all, all_count, 99);
+    out->p999 = percentile(all, all_count, 99.9);
+    out->max = all_count ? all[all_count - 1] : 0;
+
+    for (t = 0; t < cfg->threads; t++) {
+        obd_fleet_close(&drivers[t].fleet);
+        free(drivers[t].slots);
+        free(drivers[t].submitted_at);
+        free(drivers[t].next_pid);
+        free(drivers[t].samples);
+    }
+    for (i = 0; i < cfg->adapters; i++) {
+        close(masters[i]);
+        close(cars.fds[i]);
+    }
+    free(all);
+    free(masters);
+    free(cars.fds);
+    free(cars.emus);
+    return 0;
+}
+
+static double per_result(uint64_t n, uint64_t results)
+{
+    return results ? (double)n / (double)results : 0.0;
+}
+
+/* epoll vs io_uring at 100 and 1000 adapters, same transport */
+static int compare(config_t cfg)
+{
+    static const size_t sizes[] = { 100, 1000 };
+    static const obd_fleet_backend_t backends[] = { OBD_FLEET_EPOLL, OBD_FLEET_URING };
+    size_t s, b;
+    int failed = 0;
+
+    printf("%-9s %-9s %9s %8s %8s %8s %10s %10s\n", "adapters", "backend", "PIDs/s",
+           "p50 us", "p99 us", "max us", "wakeups/r", "syscalls/r");
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+            outcome_t o;
+
+            cfg.adapters = sizes[s];
+            cfg.backend = backends[b];
+            if (cfg.threads > cfg.adapters) cfg.threads = cfg.adapters;
+            if (run(&cfg, &o) != 0) return 1;
+            printf("%-9zu %-9s %9.0f %8u %8u %8u %10.2f %10.2f\n", cfg.adapters,
+                   obd_fleet_backend_name(o.backend), o.rate, o.p50, o.p99, o.max,
+                   per_result(o.wakeups, o.results), per_result(o.syscalls, o.results));
+            fflush(stdout);
+            if (o.errors || o.lost) failed = 1;
+        }
+    }
+    return failed;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--adapters N] [--threads N] [--seconds N] [--warmup-ms N]\n"
+            "          [--backend epoll|uring] [--transport pty|socket] [--compare]\n"
+            "          [--json PATH|-]\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    config_t cfg;
+    outcome_t o;
+    const char *json_path = NULL;
+    int do_compare = 0, transport_given = 0;
+    size_t i;
+    struct rlimit rl;
+
+    cfg.adapters = 256;
+    cfg.threads = 1;
+    cfg.seconds = 5;
+    cfg.warmup_ms = 500;
+    cfg.backend = OBD_FLEET_EPOLL;
+    cfg.sockets = 0;
+
+    for (i = 1; i < (size_t)argc; i++) {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < (size_t)argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--adapters") == 0 && val) {
+            cfg.adapters = (size_t)atol(val); i++;
+        } else if (strcmp(arg, "--threads") == 0 && val) {
+            cfg.threads = (size_t)atol(val); i++;
+        } else if (strcmp(arg, "--seconds") == 0 && val) {
+            cfg.seconds = atol(val); i++;
+        } else if (strcmp(arg, "--warmup-ms") == 0 && val) {
+            cfg.warmup_ms = atol(val); i++;
+        } else if (strcmp(arg, "--backend") == 0 && val &&
+                   (strcmp(val, "epoll") == 0 || strcmp(val, "uring") == 0)) {
+            cfg.backend = strcmp(val, "uring") == 0 ? OBD_FLEET_URING : OBD_FLEET_EPOLL; i++;
+        } else if (strcmp(arg, "--transport") == 0 && val &&
+                   (strcmp(val, "pty") == 0 || strcmp(val, "socket") == 0)) {
+            cfg.sockets = strcmp(val, "socket") == 0; i++;
+            transport_given = 1;
+        } else if (strcmp(arg, "--compare") == 0) {
+            do_compare = 1;
+        } else if (strcmp(arg, "--json") == 0 && val) {
+            json_path = val; i++;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (cfg.adapters == 0 || cfg.threads == 0 || cfg.threads > MAX_THREADS ||
+        cfg.threads > cfg.adapters || cfg.seconds <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    /* Two fds per adapter, plus a few */
+    {
+        size_t most = do_compare ? 1000 : cfg.adapters;
+        if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < 2 * most + 64) {
+            rl.rlim_cur = rl.rlim_max < 2 * most + 64 ? rl.rlim_max : 2 * most + 64;
+            setrlimit(RLIMIT_NOFILE, &rl);
+        }
+    }
+
+    if (do_compare) {
+        if (!transport_given) cfg.sockets = 1;  /* io_uring's best case: multishot recv */
+        return compare(cfg);
+    }
+    if (run(&cfg, &o) != 0) {
+        return 1;
+    }
+
+    {
+        FILE *table_out = (json_path && strcmp(json_path, "-") == 0) ? stderr : stdout;
+        const char *backend = obd_fleet_backend_name(o.backend);
+        const char *transport = cfg.sockets ? "socket" : "pty";
+
+        fprintf(table_out, "adapters %zu  threads %zu  backend %s  transport %s  "
+                           "measured %.1f s\n",
+                cfg.adapters, cfg.threads, backend, transport, o.secs);
+        fprintf(table_out, "results %llu  PIDs/s %.0f  errors %llu  timeouts %llu  lost %llu\n",
+                (unsigned long long)o.results, o.rate, (unsigned long long)o.errors,
+                (unsigned long long)o.timeouts, (unsigned long long)o.lost);
+        fprintf(table_out, "latency us  p50 %u  p90 %u  p99 %u  p99.9 %u  max %u\n",
+                o.p50, o.p90, o.p99, o.p999, o.max);
+        fprintf(table_out, "wakeups per result %.2f  syscalls per result %.2f\n",
+                per_result(o.wakeups, o.results), per_result(o.syscalls, o.results));
+
+        if (json_path) {
+            FILE *f = strcmp(json_path, "-") == 0 ? stdout : fopen(json_path, "w");
+            if (!f) {
+                fprintf(stderr, "obd_fleet_bench: can't write %s\n", json_path);
+                return 1;
+            }
+            fprintf(f, "{\"adapters\": %zu, \"threads\": %zu, \"backend\": \"%s\", "
+                       "\"transport\": \"%s\", "
+                       "\"pids_per_sec\": %.0f, \"p50_us\": %u, \"p90_us\": %u, "
+                       "\"p99_us\": %u, \"p999_us\": %u, \"max_us\": %u, "
+                       "\"syscalls_per_result\": %.2f, "
+                       "\"errors\": %llu, \"timeouts\": %llu}\n",
+                    cfg.adapters, cfg.threads, backend, transport, o.rate,
+                    o.p50, o.p90, o.p99, o.p999, o.max,
+                    per_result(o.syscalls, o.results),
+                    (unsigned long long)o.errors, (unsigned long long)o.timeouts);
+            if (f != stdout) fclose(f);
+        }
+    }
+    return o.errors == 0 && o.lost == 0 ? 0 : 1;
+}
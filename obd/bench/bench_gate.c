@@ -0,0 +1,218 @@
+/**
+ * bench_gate.c — Read, write and compare performance baselines.
+ *
+ * The baseline is a small JSON file that we both write and read, so the
+ * reader only needs to understand the exact layout the writer produces:
+ *
+ *   {
+ *     "schema": 1,
+ *     "metric": "...",
+ *     "profiles": {
+ *       "optimized": {
+ *         "hex_to_bytes/spaced": 1.2345,
+ *         ...
+ *       },
+ *       "unoptimized": {
+ *         ...
+ *       }
+ *     }
+ *   }
+ *
+ * One value per line keeps diffs of the checked-in file readable.
+ */
+
+#include "bench_gate.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Pull the text between the first pair of double quotes on a line.
+ * Returns a pointer just past the closing quote, or NULL. */
+static const char *read_quoted(const char *line, char *out, size_t out_size)
+{
+    const char *start = strchr(line, '"');
+    const char *end;
+    size_t len;
+
+    if (!start) return NULL;
+    start++;
+    end = strchr(start, '"');
+    if (!end) return NULL;
+
+    len = (size_t)(end - start);
+    if (len >= out_size) len = out_size - 1;
+    memcpy(out, start, len);
+    out[len] = '\0';
+    return end + 1;
+}
+
+/* Bounded copy that always null-terminates */
+static void copy_name(char *dst, size_t dst_size, const char *src)
+{
+    size_t len = strlen(src);
+    if (len >= dst_size) len = dst_size - 1;
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+int bench_gate_load(const char *path, bench_gate_baseline_t *out)
+{
+    FILE *f;
+    char line[256];
+    int in_profiles = 0;
+    bench_gate_profile_t *current = NULL;
+
+    memset(out, 0, sizeof(*out));
+
+    f = fopen(path, "r");
+    if (!f) return -1;
+
+    while (fgets(line, sizeof(line), f)) {
+        char key[BENCH_GATE_NAME_LEN];
+        const char *rest;
+
+        /* A closing brace ends the innermost open section */
+        if (strchr(line, '}')) {
+            if (current) current = NULL;
+            else in_profiles = 0;
+            continue;
+        }
+
+        rest = read_quoted(line, key, sizeof(key));
+        if (!rest) continue;
+
+        if (strchr(rest, '{')) {
+            /* "profiles": {   or   "optimized": { */
+            if (strcmp(key, "profiles") == 0) {
+                in_profiles = 1;
+            } else if (in_profiles) {
+                current = bench_gate_profile(out, key, 1);
+            }
+        } else if (current) {
+            /* "hex_to_bytes/spaced": 1.2345, */
+            const char *colon = strchr(rest, ':');
+            if (colon) {
+                bench_gate_set(current, key, strtod(colon + 1, NULL));
+            }
+        }
+    }
+
+    fclose(f);
+    return out->count > 0 ? 0 : -1;
+}
+
+int bench_gate_save(const char *path, const bench_gate_baseline_t *baseline)
+{
+    FILE *f;
+    size_t p, i;
+
+    f = fopen(path, "w");
+    if (!f) return -1;
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"schema\": 1,\n");
+    fprintf(f, "  \"metric\": \"median ns/op divided by reference/hex_scan ns/op\",\n");
+    fprintf(f, "  \"profiles\": {\n");
+    for (p = 0; p < baseline->count; p++) {
+        const bench_gate_profile_t *prof = &baseline->profiles[p];
+        fprintf(f, "    \"%s\": {\n", prof->name);
+        for (i = 0; i < prof->count; i++) {
+            fprintf(f, "      \"%s\": %.4f%s\n", prof->entries[i].name,
+                    prof->entries[i].rel_cost, i + 1 < prof->count ? "," : "");
+        }
+        fprintf(f, "    }%s\n", p + 1 < baseline->count ? "," : "");
+    }
+    fprintf(f, "  }\n}\n");
+
+    fclose(f);
+    return 0;
+}
+
+bench_gate_profile_t *bench_gate_profile(bench_gate_baseline_t *baseline,
+                                         const char *name, int create)
+{
+    size_t i;
+    bench_gate_profile_t *prof;
+
+    for (i = 0; i < baseline->count; i++) {
+        if (strcmp(baseline->profiles[i].name, name) == 0) {
+            return &baseline->profiles[i];
+        }
+    }
+    if (!create || baseline->count >= BENCH_GATE_MAX_PROFILES) {
+        return NULL;
+    }
+
+    prof = &baseline->profiles[baseline->count++];
+    memset(prof, 0, sizeof(*prof));
+    copy_name(prof->name, sizeof(prof->name), name);
+    return prof;
+}
+
+void bench_gate_set(bench_gate_profile_t *profile, const char *name,
+                    double rel_cost)
+{
+    size_t i;
+
+    for (i = 0; i < profile->count; i++) {
+        if (strcmp(profile->entries[i].name, name) == 0) {
+            profile->entries[i].rel_cost = rel_cost;
+            return;
+        }
+    }
+    if (profile->count >= BENCH_GATE_MAX_ENTRIES) return;
+
+    copy_name(profile->entries[profile->count].name, BENCH_GATE_NAME_LEN, name);
+    profile->entries[profile->count].rel_cost = rel_cost;
+    profile->count++;
+}
+
+static const bench_gate_entry_t *find_entry(const bench_gate_profile_t *profile,
+                                            const char *name)
+{
+    size_t i;
+    if (!profile) return NULL;
+    for (i = 0; i < profile->count; i++) {
+        if (strcmp(profile->entries[i].name, name) == 0) {
+            return &profile->entries[i];
+        }
+    }
+    return NULL;
+}
+
+int bench_gate_compare(FILE *out, const bench_gate_profile_t *profile,
+                       const char *const *names, const double *rel_costs,
+                       size_t count, double tolerance_pct)
+{
+    size_t i;
+    int regressions = 0;
+
+    fprintf(out, "%-24s %10s %10s %11s  %s\n",
+            "benchmark", "baseline", "current", "throughput", "status");
+
+    for (i = 0; i < count; i++) {
+        const bench_gate_entry_t *base = find_entry(profile, names[i]);
+        double change_pct;
+
+        if (!base || base->rel_cost <= 0.0 || rel_costs[i] <= 0.0) {
+            fprintf(out, "%-24s %10s %10.4f %11s  new (not in baseline)\n",
+                    names[i], "-", rel_costs[i], "-");
+            continue;
+        }
+
+        /* Throughput is 1/cost, so the change in throughput is
+         * baseline_cost / current_cost - 1. */
+        change_pct = (base->rel_cost / rel_costs[i] - 1.0) * 100.0;
+
+        fprintf(out, "%-24s %10.4f %10.4f %+10.1f%%  ",
+                names[i], base->rel_cost, rel_costs[i], change_pct);
+        if (change_pct < -tolerance_pct) {
+            fprintf(out, "REGRESSED (limit -%.0f%%)\n", tolerance_pct);
+            regressions++;
+        } else {
+            fprintf(out, "ok\n");
+        }
+    }
+
+    return regressions;
+}
@@ -0,0 +1,77 @@
+/**
+ * bench_gate.h — Baseline file handling for the performance regression gate.
+ *
+ * The gate compares each benchmark's RELATIVE cost (time per op divided
+ * by the time of a fixed reference kernel, measured in the same run)
+ * against a checked-in baseline. Relative cost cancels out "this box is
+ * slower than the one that wrote the baseline", so the same file works
+ * on any Linux machine.
+ *
+ * The baseline keeps one table per build profile ("optimized" for
+ * Release/RelWithDebInfo, "unoptimized" for Debug), because -O0 and -O2
+ * change the ratios far more than any real regression would.
+ */
+
+#ifndef BENCH_GATE_H
+#define BENCH_GATE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define BENCH_GATE_NAME_LEN     48
+#define BENCH_GATE_MAX_ENTRIES  64
+#define BENCH_GATE_MAX_PROFILES  4
+
+typedef struct {
+    char   name[BENCH_GATE_NAME_LEN];
+    double rel_cost;                    /* min ns/op ÷ reference min ns/op */
+} bench_gate_entry_t;
+
+typedef struct {
+    char               name[16];        /* "optimized" / "unoptimized" */
+    bench_gate_entry_t entries[BENCH_GATE_MAX_ENTRIES];
+    size_t             count;
+} bench_gate_profile_t;
+
+typedef struct {
+    bench_gate_profile_t profiles[BENCH_GATE_MAX_PROFILES];
+    size_t               count;
+} bench_gate_baseline_t;
+
+/**
+ * Load a baseline file written by bench_gate_save().
+ * Returns 0 on success, -1 if the file can't be opened or is malformed.
+ * `out` is always initialized (empty on failure).
+ */
+int bench_gate_load(const char *path, bench_gate_baseline_t *out);
+
+/** Write the baseline back out, one entry per line. Returns 0 or -1. */
+int bench_gate_save(const char *path, const bench_gate_baseline_t *baseline);
+
+/**
+ * Find a profile by name. With create=1, adds an empty one if missing.
+ * Returns NULL if not found (or no room to create it).
+ */
+bench_gate_profile_t *bench_gate_profile(bench_gate_baseline_t *baseline,
+                                         const char *name, int create);
+
+/** Set (add or replace) one benchmark's relative cost in a profile. */
+void bench_gate_set(bench_gate_profile_t *profile, const char *name,
+                    double rel_cost);
+
+/**
+ * Compare current relative costs against the baseline and print a
+ * readable table to `out`.
+ *
+ * A benchmark FAILS when its throughput dropped by more than
+ * tolerance_pct percent, i.e. baseline/current < 1 - tolerance/100.
+ * Getting faster never fails. Benchmarks missing from the baseline are
+ * listed as "new" and don't fail either.
+ *
+ * Returns the number of regressions (0 = gate passes).
+ */
+int bench_gate_compare(FILE *out, const bench_gate_profile_t *profile,
+                       const char *const *names, const double *rel_costs,
+                       size_t count, double tolerance_pct);
+
+#endif /* BENCH_GATE_H */
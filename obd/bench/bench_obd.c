@@ -0,0 +1,712 @@
+/**
+ * bench_obd.c — Microbenchmarks for every parser and decoder (obd_bench).
+ *
+ * The unit tests tell us whether the library is CORRECT. This tool tells
+ * us what it COSTS, so a change to hex_utils.c or elm327.c that slows the
+ * polling hot path shows up as a number instead of a vague feeling.
+ *
+ * Each benchmark runs one library function over a realistic input mix
+ * (bench_corpus.h) and reports:
+ *   - ns/op          median wall time per call
+ *   - bytes/s        input bytes processed per second
+ *   - cycles/byte    CPU cycles per input byte, read from the hardware
+ *                    counter via perf_event_open (Linux only; reported as
+ *                    null when the kernel doesn't allow it)
+ *
+ * Usage:
+ *   obd_bench                       human-readable table on stdout
+ *   obd_bench --json results.json   also write JSON (use "-" for stdout)
+ *   obd_bench --filter clean        only run benchmarks containing "clean"
+ *                                   (comma-separated: "classify,clean")
+ *   obd_bench --reps 9 --min-time-ms 20 --label abc1234
+ *
+ * The JSON has one benchmark per line so two runs can be compared with
+ * a plain diff across commits.
+ *
+ * Regression gate (see bench_gate.h):
+ *   obd_bench --check baseline.json --tolerance 40 --runs 7
+ *       exit 1 if any benchmark's throughput dropped more than 40%
+ *   obd_bench --write-baseline baseline.json
+ *       refresh this build profile's entries after an intended change
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE          /* syscall() for perf_event_open */
+#elif !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <obd/obd.h>
+#include "bench_corpus.h"
+#include "bench_gate.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define BENCH_MAX_REPS 64
+#define BENCH_MAX_RUNS 32
+
+/* ctest treats this exit code as "skipped" (SKIP_RETURN_CODE) */
+#define BENCH_EXIT_SKIP 77
+
+
+/* ── Clock ───────────────────────────────────────────────────────────────
+ *
+ * Monotonic nanoseconds. QueryPerformanceCounter on Windows,
+ * clock_gettime(CLOCK_MONOTONIC) everywhere else.
+ */
+static uint64_t bench_now_ns(void)
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+
+/* ── Cycle counter ───────────────────────────────────────────────────────
+ *
+ * perf_event_open gives us the real CPU cycle count for this thread,
+ * user space only. It can fail (container, perf_event_paranoid=3, no
+ * PMU in a VM); then cycles_available stays 0 and we report null.
+ */
+static int cycles_available = 0;
+
+#if defined(__linux__)
+static int cycles_fd = -1;
+
+static void cycles_open(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    cycles_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    cycles_available = cycles_fd >= 0;
+}
+
+static uint64_t cycles_read(void)
+{
+    uint64_t count = 0;
+    if (cycles_fd < 0 || read(cycles_fd, &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+    return count;
+}
+#else
+static void cycles_open(void) { cycles_available = 0; }
+static uint64_t cycles_read(void) { return 0; }
+#endif
+
+
+/* ── Benchmark bodies ────────────────────────────────────────────────────
+ *
+ * Each body makes ONE pass over its input mix, calling the library
+ * function once per input. Results are folded into bench_sink so the
+ * compiler can't optimize the calls away. Input byte counts are worked
+ * out once before timing starts, so strlen() never shows up in ns/op.
+ */
+static volatile unsigned bench_sink;
+
+typedef void (*bench_pass_fn)(const char *const *inputs);
+
+static void pass_hex_to_bytes(const char *const *inputs)
+{
+    uint8_t buf[64];
+    size_t len;
+    unsigned acc = 0;
+    for (; *inputs; inputs++) {
+        acc += (unsigned)obd_hex_to_bytes(*inputs, buf, sizeof(buf), &len);
+    }
+    bench_sink = acc;
+}
+
+/* Encode direction: bytes come from the spaced corpus, decoded once */
+static uint8_t encode_inputs[16][32];
+static size_t encode_lens[16];
+static size_t encode_count;
+
+static size_t setup_bytes_to_hex(const char *const *inputs, size_t *bytes)
+{
+    *bytes = 0;
+    for (encode_count = 0; inputs[encode_count] && encode_count < 16; encode_count++) {
+        if (obd_hex_to_bytes(inputs[encode_count], encode_inputs[encode_count],
+                             sizeof(encode_inputs[0]),
+                             &encode_lens[encode_count]) != OBD_OK) {
+            encode_lens[encode_count] = 0;
+        }
+        *bytes += encode_lens[encode_count];
+    }
+    return encode_count;
+}
+
+static void pass_bytes_to_hex(const char *const *inputs)
+{
+    char out[OBD_MAX_RESPONSE_LEN];
+    size_t i;
+    unsigned acc = 0;
+    (void)inputs;
+    for (i = 0; i < encode_count; i++) {
+        acc += (unsigned)obd_bytes_to_hex(encode_inputs[i], encode_lens[i],
+                                          out, sizeof(out));
+    }
+    bench_sink = acc;
+}
+
+static void pass_classify(const char *const *inputs)
+{
+    unsigned acc = 0;
+    for (; *inputs; inputs++) {
+        acc += (unsigned)obd_elm327_classify_response(*inputs);
+    }
+    bench_sink = acc;
+}
+
+static void pass_clean(const char *const *inputs)
+{
+    char out[OBD_MAX_RESPONSE_LEN];
+    unsigned acc = 0;
+    for (; *inputs; inputs++) {
+        acc += (unsigned)obd_elm327_clean_response(*inputs, out, sizeof(out));
+    }
+    bench_sink = acc;
+}
+
+static void pass_pid_parse(const char *const *inputs)
+{
+    obd_pid_response_t resp;
+    unsigned acc = 0;
+    for (; *inputs; inputs++) {
+        if (obd_pid_parse_response(*inputs, &resp) == OBD_OK) {
+            acc += resp.pid;
+        }
+    }
+    bench_sink = acc;
+}
+
+/* Decode direction: PID responses are parsed once up front so the
+ * benchmark measures only the table lookup + formula. */
+static obd_pid_response_t sensor_inputs[16];
+static size_t sensor_count;
+
+static size_t setup_sensor_decode(const char *const *inputs, size_t *bytes)
+{
+    size_t i;
+    *bytes = 0;
+    sensor_count = 0;
+    for (i = 0; inputs[i] && sensor_count < 16; i++) {
+        if (obd_pid_parse_response(inputs[i], &sensor_inputs[sensor_count]) == OBD_OK) {
+            *bytes += 2 + sensor_inputs[sensor_count].data_len;  /* mode + PID + data */
+            sensor_count++;
+        }
+    }
+    return sensor_count;
+}
+
+static void pass_sensor_decode(const char *const *inputs)
+{
+    obd_sensor_value_t val;
+    size_t i;
+    float acc = 0.0f;
+    (void)inputs;
+    for (i = 0; i < sensor_count; i++) {
+        if (obd_sensor_decode(&sensor_inputs[i], &val) == OBD_OK) {
+            acc += val.value;
+        }
+    }
+    bench_sink = (unsigned)acc;
+}
+
+static void pass_dtc_parse(const char *const *inputs)
+{
+    obd_dtc_list_t list;
+    unsigned acc = 0;
+    for (; *inputs; inputs++) {
+        acc += (unsigned)obd_dtc_parse_response(*inputs, &list);
+        acc += (unsigned)list.count;
+    }
+    bench_sink = acc;
+}
+
+static void pass_vin_parse(const char *const *inputs)
+{
+    char vin[OBD_VIN_LENGTH + 1];
+    unsigned acc = 0;
+    for (; *inputs; inputs++) {
+        if (obd_vin_parse_response(*inputs, vin, sizeof(vin)) == OBD_OK) {
+            acc += (unsigned char)vin[0];
+        }
+    }
+    bench_sink = acc;
+}
+
+
+/* ── Reference kernel ────────────────────────────────────────────────────
+ *
+ * A deliberately plain hex-digit scanner that lives HERE, not in the
+ * library. Its speed follows the machine (clock, caches, compiler flags)
+ * but never changes when the library does. Dividing each benchmark by it
+ * cancels out "this box is slower" and leaves "this parser got slower".
+ */
+static void pass_reference(const char *const *inputs)
+{
+    unsigned acc = 0;
+    for (; *inputs; inputs++) {
+        const char *p;
+        for (p = *inputs; *p; p++) {
+            if (*p >= '0' && *p <= '9') acc = acc * 16u + (unsigned)(*p - '0');
+            else if (*p >= 'A' && *p <= 'F') acc = acc * 16u + (unsigned)(*p - 'A' + 10);
+        }
+    }
+    bench_sink = acc;
+}
+
+
+/* ── Benchmark table ─────────────────────────────────────────────────────
+ *
+ * One row per benchmark. To measure something new, add a pass function
+ * and a row — the runner and the JSON writer pick it up automatically.
+ */
+typedef struct {
+    const char *name;
+    bench_pass_fn pass;
+    const char *const *inputs;
+    /* Optional: prepares derived inputs, returns the ops per pass and
+     * the input bytes per pass. When NULL, ops = number of strings in
+     * `inputs` and bytes = their total length. */
+    size_t (*setup)(const char *const *inputs, size_t *bytes_per_pass);
+} bench_case_t;
+
+static const bench_case_t bench_cases[] = {
+    { "hex_to_bytes/spaced",   pass_hex_to_bytes,  corpus_hex_spaced,      NULL },
+    { "hex_to_bytes/unspaced", pass_hex_to_bytes,  corpus_hex_unspaced,    NULL },
+    { "bytes_to_hex/mix",      pass_bytes_to_hex,  corpus_hex_spaced,      setup_bytes_to_hex },
+    { "classify/mix",          pass_classify,      corpus_classify,        NULL },
+    { "clean/single",          pass_clean,         corpus_clean_single,    NULL },
+    { "clean/multiline",       pass_clean,         corpus_clean_multiline, NULL },
+    { "clean/error",           pass_clean,         corpus_clean_error,     NULL },
+    { "pid_parse/mix",         pass_pid_parse,     corpus_pid,             NULL },
+    { "sensor_decode/mix",     pass_sensor_decode, corpus_pid,             setup_sensor_decode },
+    { "dtc_parse/mix",         pass_dtc_parse,     corpus_dtc,             NULL },
+    { "vin_parse/multiline",   pass_vin_parse,     corpus_vin,             NULL },
+};
+
+#define BENCH_CASE_COUNT (sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+static const bench_case_t reference_case =
+    { "reference/hex_scan", pass_reference, corpus_hex_spaced, NULL };
+
+
+/* ── Runner ──────────────────────────────────────────────────────────────
+ *
+ * For each benchmark:
+ *   1. Run setup (if any) and count the ops (inputs) per pass.
+ *   2. Calibrate: double the pass count until one sample takes at least
+ *      min_time_ns, so timer resolution doesn't dominate.
+ *   3. Take `reps` samples and keep the median (robust to the odd
+ *      interrupt or frequency change) plus the minimum.
+ */
+typedef struct {
+    const char *name;
+    size_t ops_per_pass;
+    size_t bytes_per_pass;
+    double ns_per_op;        /* median over samples */
+    double ns_per_op_min;
+    double bytes_per_sec;
+    double cycles_per_byte;  /* < 0 when the cycle counter is unavailable */
+    int    samples;
+} bench_result_t;
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median_of(double *values, int count)
+{
+    qsort(values, (size_t)count, sizeof(double), compare_double);
+    if (count % 2) return values[count / 2];
+    return (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
+
+static void run_case(const bench_case_t *bc, int reps, uint64_t min_time_ns,
+                     bench_result_t *res)
+{
+    double ns_samples[BENCH_MAX_REPS];
+    double cyc_samples[BENCH_MAX_REPS];
+    uint64_t passes = 1;
+    uint64_t i, t0, t1, c0, c1;
+    int s;
+
+    memset(res, 0, sizeof(*res));
+    res->name = bc->name;
+    if (bc->setup) {
+        res->ops_per_pass = bc->setup(bc->inputs, &res->bytes_per_pass);
+    } else {
+        for (; bc->inputs[res->ops_per_pass]; res->ops_per_pass++) {
+            res->bytes_per_pass += strlen(bc->inputs[res->ops_per_pass]);
+        }
+    }
+    bc->pass(bc->inputs);  /* warm the caches */
+
+    /* Calibrate the pass count */
+    for (;;) {
+        t0 = bench_now_ns();
+        for (i = 0; i < passes; i++) bc->pass(bc->inputs);
+        t1 = bench_now_ns();
+        if (t1 - t0 >= min_time_ns || passes >= (1u << 30)) break;
+        passes *= 2;
+    }
+
+    for (s = 0; s < reps; s++) {
+        c0 = cycles_read();
+        t0 = bench_now_ns();
+        for (i = 0; i < passes; i++) bc->pass(bc->inputs);
+        t1 = bench_now_ns();
+        c1 = cycles_read();
+
+        ns_samples[s] = (double)(t1 - t0) / ((double)passes * (double)res->ops_per_pass);
+        cyc_samples[s] = (double)(c1 - c0) / ((double)passes * (double)res->bytes_per_pass);
+    }
+
+    res->samples = reps;
+    res->ns_per_op = median_of(ns_samples, reps);
+    res->ns_per_op_min = ns_samples[0];  /* sorted by median_of() */
+    res->bytes_per_sec = (double)res->bytes_per_pass /
+                         ((double)res->ops_per_pass * res->ns_per_op) * 1e9;
+    res->cycles_per_byte = cycles_available ? median_of(cyc_samples, reps) : -1.0;
+}
+
+
+/* ── Output ──────────────────────────────────────────────────────────── */
+
+static const char *compiler_name(void)
+{
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc";
+#else
+    return "unknown";
+#endif
+}
+
+static int is_optimized_build(void)
+{
+#if defined(__OPTIMIZE__) || (defined(_MSC_VER) && defined(NDEBUG))
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+static void print_table(FILE *f, const bench_result_t *res, size_t count)
+{
+    size_t i;
+
+    fprintf(f, "%-24s %10s %10s %14s %12s\n",
+            "benchmark", "ns/op", "min ns/op", "MB/s", "cycles/byte");
+    for (i = 0; i < count; i++) {
+        fprintf(f, "%-24s %10.1f %10.1f %14.1f ",
+                res[i].name, res[i].ns_per_op, res[i].ns_per_op_min,
+                res[i].bytes_per_sec / 1e6);
+        if (res[i].cycles_per_byte >= 0) {
+            fprintf(f, "%12.2f\n", res[i].cycles_per_byte);
+        } else {
+            fprintf(f, "%12s\n", "n/a");
+        }
+    }
+}
+
+static void write_json(FILE *f, const bench_result_t *res, size_t count,
+                       const char *label)
+{
+    size_t i;
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"schema\": 1,\n");
+    fprintf(f, "  \"label\": \"%s\",\n", label ? label : "");
+    fprintf(f, "  \"compiler\": \"%s\",\n", compiler_name());
+    fprintf(f, "  \"optimized\": %s,\n", is_optimized_build() ? "true" : "false");
+    fprintf(f, "  \"cycles_source\": \"%s\",\n",
+            cycles_available ? "perf_event_open" : "unavailable");
+    fprintf(f, "  \"benchmarks\": [\n");
+    for (i = 0; i < count; i++) {
+        fprintf(f, "    {\"name\": \"%s\", \"ops_per_pass\": %lu, "
+                   "\"bytes_per_pass\": %lu, \"samples\": %d, "
+                   "\"ns_per_op\": %.3f, \"ns_per_op_min\": %.3f, "
+                   "\"bytes_per_sec\": %.0f, \"cycles_per_byte\": ",
+                res[i].name, (unsigned long)res[i].ops_per_pass,
+                (unsigned long)res[i].bytes_per_pass, res[i].samples,
+                res[i].ns_per_op, res[i].ns_per_op_min, res[i].bytes_per_sec);
+        if (res[i].cycles_per_byte >= 0) {
+            fprintf(f, "%.3f}", res[i].cycles_per_byte);
+        } else {
+            fprintf(f, "null}");
+        }
+        fprintf(f, "%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+
+/* ── Suite helpers ───────────────────────────────────────────────────── */
+
+/* Does `name` match the filter? The filter is a comma-separated list of
+ * substrings; NULL matches everything. */
+static int filter_matches(const char *filter, const char *name)
+{
+    char token[BENCH_GATE_NAME_LEN];
+    const char *p = filter;
+
+    if (!filter) return 1;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        if (len > 0 && len < sizeof(token)) {
+            memcpy(token, p, len);
+            token[len] = '\0';
+            if (strstr(name, token)) return 1;
+        }
+        p += len;
+        if (*p == ',') p++;
+    }
+    return 0;
+}
+
+/* Run every benchmark matching the filter. Returns how many ran. */
+static size_t run_suite(const char *filter, int reps, uint64_t min_time_ns,
+                        bench_result_t *results)
+{
+    size_t i, count = 0;
+    for (i = 0; i < BENCH_CASE_COUNT; i++) {
+        if (!filter_matches(filter, bench_cases[i].name)) continue;
+        run_case(&bench_cases[i], reps, min_time_ns, &results[count]);
+        count++;
+    }
+    return count;
+}
+
+
+/* ── Regression gate ─────────────────────────────────────────────────────
+ *
+ * Noise control, in layers:
+ *   - within a run, each benchmark uses its FASTEST of `reps` samples.
+ *     Timing noise (interrupts, migrations, a busy neighbour) only ever
+ *     adds time, so the minimum is the steadiest estimate of true cost.
+ *   - the reference kernel is re-measured in EVERY run, right next to
+ *     the benchmarks, so a slow phase of the machine hits both sides of
+ *     the ratio
+ *   - the final relative cost is the MEDIAN over `runs` independent runs,
+ *     so one bad run can't fail the gate
+ */
+static const char *build_profile(void)
+{
+    return is_optimized_build() ? "optimized" : "unoptimized";
+}
+
+static size_t measure_relative(const char *filter, int reps, uint64_t min_time_ns,
+                               int runs, const char **names, double *rel_costs)
+{
+    static double per_run[BENCH_CASE_COUNT][BENCH_MAX_RUNS];
+    bench_result_t results[BENCH_CASE_COUNT];
+    bench_result_t ref;
+    size_t i, count = 0;
+    int r;
+
+    for (r = 0; r < runs; r++) {
+        run_case(&reference_case, reps, min_time_ns, &ref);
+        count = run_suite(filter, reps, min_time_ns, results);
+        for (i = 0; i < count; i++) {
+            names[i] = results[i].name;
+            per_run[i][r] = results[i].ns_per_op_min / ref.ns_per_op_min;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        rel_costs[i] = median_of(per_run[i], runs);
+    }
+    return count;
+}
+
+static int run_gate(const char *check_path, const char *write_path,
+                    const char *filter, int reps, uint64_t min_time_ns,
+                    int runs, double tolerance_pct)
+{
+    const char *names[BENCH_CASE_COUNT];
+    double rel_costs[BENCH_CASE_COUNT];
+    static bench_gate_baseline_t baseline;
+    bench_gate_profile_t *profile;
+    size_t i, count;
+    int regressions;
+
+    count = measure_relative(filter, reps, min_time_ns, runs, names, rel_costs);
+    if (count == 0) {
+        fprintf(stderr, "no benchmarks match filter '%s'\n", filter ? filter : "");
+        return 2;
+    }
+
+    if (write_path) {
+        /* Keep the other profiles; replace only our own entries */
+        bench_gate_load(write_path, &baseline);
+        profile = bench_gate_profile(&baseline, build_profile(), 1);
+        if (!profile) return 1;
+        for (i = 0; i < count; i++) {
+            bench_gate_set(profile, names[i], rel_costs[i]);
+        }
+        if (bench_gate_save(write_path, &baseline) != 0) {
+            fprintf(stderr, "cannot write %s\n", write_path);
+            return 1;
+        }
+        printf("wrote %lu '%s' entries to %s\n",
+               (unsigned long)count, build_profile(), write_path);
+        return 0;
+    }
+
+    if (bench_gate_load(check_path, &baseline) != 0) {
+        printf("SKIP: cannot read baseline %s\n", check_path);
+        return BENCH_EXIT_SKIP;
+    }
+    profile = bench_gate_profile(&baseline, build_profile(), 0);
+    if (!profile) {
+        printf("SKIP: baseline has no '%s' profile\n", build_profile());
+        return BENCH_EXIT_SKIP;
+    }
+
+    printf("profile: %s, median of %d runs, tolerance %.0f%%\n",
+           build_profile(), runs, tolerance_pct);
+    regressions = bench_gate_compare(stdout, profile, names, rel_costs,
+                                     count, tolerance_pct);
+    printf("\n%s (%d regressed)\n",
+           regressions == 0 ? "ALL PASSED" : "SOME FAILED", regressions);
+    return regressions == 0 ? 0 : 1;
+}
+
+
+/* ── main ────────────────────────────────────────────────────────────── */
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--json PATH|-] [--filter SUBSTR[,SUBSTR]] [--reps N]\n"
+            "          [--min-time-ms N] [--label TEXT]\n"
+            "       %s --check BASELINE [--tolerance PCT] [--runs N] [--filter ...]\n"
+            "       %s --write-baseline BASELINE [--runs N] [--filter ...]\n",
+            argv0, argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+    bench_result_t results[BENCH_CASE_COUNT];
+    const char *json_path = NULL;
+    const char *filter = NULL;
+    const char *label = NULL;
+    const char *check_path = NULL;
+    const char *write_path = NULL;
+    double tolerance_pct = 40.0;
+    int runs = 0;                /* 0 = default for the mode, see below */
+    int reps = 0;                /* 0 = default for the mode, see below */
+    uint64_t min_time_ns = 0;
+    size_t i, count;
+    FILE *table_out = stdout;
+
+    for (i = 1; i < (size_t)argc; i++) {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < (size_t)argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--json") == 0 && val) {
+            json_path = val; i++;
+        } else if (strcmp(arg, "--filter") == 0 && val) {
+            filter = val; i++;
+        } else if (strcmp(arg, "--label") == 0 && val) {
+            label = val; i++;
+        } else if (strcmp(arg, "--reps") == 0 && val) {
+            reps = atoi(val); i++;
+        } else if (strcmp(arg, "--min-time-ms") == 0 && val) {
+            min_time_ns = (uint64_t)atoi(val) * 1000000u; i++;
+        } else if (strcmp(arg, "--check") == 0 && val) {
+            check_path = val; i++;
+        } else if (strcmp(arg, "--write-baseline") == 0 && val) {
+            write_path = val; i++;
+        } else if (strcmp(arg, "--tolerance") == 0 && val) {
+            tolerance_pct = atof(val); i++;
+        } else if (strcmp(arg, "--runs") == 0 && val) {
+            runs = atoi(val); i++;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    /* The baseline is written from more runs than a check uses, so it
+     * sits near the true median rather than on one lucky run. */
+    if (runs == 0) runs = write_path ? 15 : 7;
+    if (runs < 1) runs = 1;
+    if (runs > BENCH_MAX_RUNS) runs = BENCH_MAX_RUNS;
+
+    /* The gate writes and checks with the SAME sampling settings: the
+     * min-of-reps statistic shifts with the number of reps, so a baseline
+     * taken one way can't be compared with a check run another way. */
+    if (check_path || write_path) {
+        if (reps == 0) reps = 5;
+        if (min_time_ns == 0) min_time_ns = 4u * 1000000u;
+    } else {
+        if (reps == 0) reps = 7;
+        if (min_time_ns == 0) min_time_ns = 10u * 1000000u;
+    }
+    if (reps < 1) reps = 1;
+    if (reps > BENCH_MAX_REPS) reps = BENCH_MAX_REPS;
+
+    if (check_path || write_path) {
+        return run_gate(check_path, write_path, filter, reps, min_time_ns,
+                        runs, tolerance_pct);
+    }
+
+    cycles_open();
+    count = run_suite(filter, reps, min_time_ns, results);
+
+    /* Keep stdout clean for JSON when it's going there */
+    if (json_path && strcmp(json_path, "-") == 0) {
+        table_out = stderr;
+    }
+    print_table(table_out, results, count);
+
+    if (json_path) {
+        FILE *f = strcmp(json_path, "-") == 0 ? stdout : fopen(json_path, "w");
+        if (!f) {
+            fprintf(stderr, "cannot open %s for writing\n", json_path);
+            return 1;
+        }
+        write_json(f, results, count, label);
+        if (f != stdout) fclose(f);
+    }
+
+    return 0;
+}
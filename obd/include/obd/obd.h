@@ -130,6 +130,8 @@ obd_result_t obd_elm327_clean_response(const char *raw, char *out,
  *
  *  PIDs (Parameter IDs) are how you ask the car for specific data.
  *  Mode 01 = live data, Mode 02 = freeze frame (snapshot at time of DTC).
+ *  Mode 02 requests and replies carry a frame number as well; use the
+ *  obd_freeze_*() functions for those.
  *
  *  Example: Mode 01, PID 0C = Engine RPM
  *           You send "010C\r", car responds "41 0C 1A F8"
@@ -138,7 +140,8 @@ obd_result_t obd_elm327_clean_response(const char *raw, char *out,
 /**
  * Build a PID request command string.
  *
- * @param mode  OBD mode (0x01 for live data, 0x02 for freeze frame)
+ * @param mode  OBD mode (0x01 for live data). For 0x02 this asks for
+ *              frame 0 ("02PP00"); see obd_freeze_build_request()
  * @param pid   The PID to request (e.g., 0x0C for RPM)
  * @param out   Output buffer for the command (e.g., "010C\r")
  * @param out_size  Size of output buffer (OBD_MAX_COMMAND_LEN is enough)
@@ -191,6 +194,14 @@ obd_result_t obd_sensor_decode(const obd_pid_response_t *response,
  */
 obd_result_t obd_sensor_get_name(uint8_t pid, char *name, size_t name_size);
 
+/**
+ * How many data bytes a PID's reply carries (e.g. 2 for RPM, 1 for speed).
+ * Lets a caller split a multi-PID reply like "41 0C 1A F8 0D 3C".
+ *
+ * @return OBD_OK or OBD_ERROR_UNKNOWN_PID
+ */
+obd_result_t obd_sensor_get_byte_count(uint8_t pid, size_t *out);
+
 
 /* ═══════════════════════════════════════════════════════════════════════════
  *  DTC (Diagnostic Trouble Codes) — Mode 03
@@ -266,6 +277,1247 @@ obd_result_t obd_vin_parse_response(const char *response,
                                     char *vin, size_t vin_size);
 
 
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Multi-frame replies and supported PIDs
+ *
+ *  Anything longer than 7 bytes travels over CAN in several frames, and
+ *  more than one ECU can answer a request. obd_reply_reassemble() turns
+ *  what the adapter printed back into one message per ECU.
+ *
+ *  PID 0x00, 0x20, 0x40... of a mode say which PIDs the car supports,
+ *  as a chain of 32-bit bitmaps. obd_pid_supported_*() collect them.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Reassemble a cleaned response into whole messages.
+ *
+ * Understands all three ways the ELM327 prints a reply:
+ *   "46 00 C0 00 00 01"                       single frame, headers off
+ *   "013\r0: 46 01 0B ...\r1: ...\r2: ..."     multi-frame, headers off
+ *   "7E8 10 13 46 01 ...\r7E8 21 ..."          headers on, ECUs may interleave
+ *
+ * Padding after the announced length is dropped.
+ *
+ * @param response  Cleaned response (obd_elm327_clean_response() output)
+ * @param out       Output array, one entry per message
+ * @param max       Number of entries in out
+ * @param count     Receives the number of messages
+ * @return OBD_OK, OBD_ERROR_PARSE_FAILED if a frame is missing or out of
+ *         order, OBD_ERROR_BUFFER_TOO_SMALL if there are more than max
+ *         messages, OBD_ERROR_NO_DATA if there is nothing at all
+ */
+obd_result_t obd_reply_reassemble(const char *response, obd_reply_t *out,
+                                  size_t max, size_t *count);
+
+/**
+ * Merge the bitmaps in a reply to PID 0x00 / 0x20 / ... into a set.
+ *
+ * Zero the set before the first call, then call once per reply. Every
+ * bitmap in the reply is merged (CAN allows asking for up to six in one
+ * request), from every ECU that answered.
+ *
+ * @param response  Cleaned response, e.g. "41 00 BE 3E B8 11"
+ * @param mode      Requested mode (0x01, 0x06, 0x09...); replies from
+ *                  other services are ignored
+ * @param set       Set to merge into
+ * @return OBD_OK, or OBD_ERROR_PARSE_FAILED if the reply holds no bitmap
+ */
+obd_result_t obd_pid_supported_parse(const char *response, uint8_t mode,
+                                     obd_pid_supported_t *set);
+
+/** Returns 1 if pid is in the set, else 0. PID 0x00 is always supported. */
+int obd_pid_supported_has(const obd_pid_supported_t *set, uint8_t pid);
+
+/**
+ * Which bitmap to ask for next.
+ *
+ * Walks the chain 0x00, 0x20, 0x40...: the first bitmap that the car
+ * says exists but hasn't been merged yet.
+ *
+ * @param set   Set built by obd_pid_supported_parse()
+ * @param base  Receives the PID to request
+ * @return 1 if there is one, 0 when the chain is complete
+ */
+int obd_pid_supported_next(const obd_pid_supported_t *set, uint8_t *base);
+
+/**
+ * List the supported PIDs in ascending order, leaving out the bitmap
+ * PIDs themselves (0x20, 0x40...).
+ *
+ * @param set    Set built by obd_pid_supported_parse()
+ * @param pids   Output array
+ * @param max    Number of entries in pids
+ * @param count  Receives the number of PIDs
+ * @return OBD_OK or OBD_ERROR_BUFFER_TOO_SMALL
+ */
+obd_result_t obd_pid_supported_list(const obd_pid_supported_t *set,
+                                    uint8_t *pids, size_t max, size_t *count);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Monitor test results — Mode 06
+ *
+ *  The results of the emissions self-tests the car last ran (catalyst,
+ *  O2 sensors, EGR, EVAP, misfire per cylinder), each with its limits.
+ *  MID 0x00, 0x20... are supported-MID bitmaps, read like Mode 01 PID
+ *  0x00 with obd_pid_supported_parse(..., 0x06, ...).
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Build a Mode 06 request.
+ *
+ * A request can ask for up to six bitmap MIDs (0x00, 0x20, ... 0xE0) at
+ * once, or for exactly one test MID: that's what SAE J1979 allows on
+ * CAN. To read many test MIDs, queue one request per MID.
+ *
+ * @param mids      MIDs to ask for, e.g. {0x00, 0x20, 0x40} → "06002040\r"
+ * @param count     Number of MIDs (1-6)
+ * @param out       Output buffer
+ * @param out_size  Size of output buffer
+ * @return OBD_OK, OBD_ERROR_INVALID_ARG for a mix of test MIDs and
+ *         bitmaps or more than one test MID, OBD_ERROR_BUFFER_TOO_SMALL
+ */
+obd_result_t obd_monitor_build_request(const uint8_t *mids, size_t count,
+                                       char *out, size_t out_size);
+
+/**
+ * Parse a Mode 06 reply into test results.
+ *
+ * Input (after reassembly): "46 01 0B 24 00 00 00 00 FF FF ..."
+ *   0x46        = response header (0x40 + 0x06)
+ *   01 0B 24    = MID 0x01, TID 0x0B, UASID 0x24
+ *   00 00       = test value
+ *   00 00 FF FF = minimum, maximum
+ * and so on, nine bytes per test. Bitmap MIDs in the same reply are
+ * skipped. Values are scaled per the UASID; unknown UASIDs are left raw.
+ *
+ * @param response  Cleaned response, any framing obd_reply_reassemble()
+ *                  understands, any number of ECUs
+ * @param out       Output results (caller-provided)
+ * @return OBD_OK, OBD_ERROR_BUFFER_TOO_SMALL for more than
+ *         OBD_MONITOR_MAX_TESTS tests, or OBD_ERROR_*
+ */
+obd_result_t obd_monitor_parse_response(const char *response,
+                                        obd_monitor_result_t *out);
+
+/** Unit of a UASID ("V", "%", "counts"...), "" if unknown. Never NULL. */
+const char *obd_monitor_unit(uint8_t uasid);
+
+/** Name of a monitor ("Catalyst Bank 1"...), NULL if not in the table. */
+const char *obd_monitor_name(uint8_t mid);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Freeze frames — Mode 02
+ *
+ *  The snapshot of Mode 01 PIDs the car stored with an emissions DTC.
+ *  Requests and replies carry a frame number after each PID:
+ *  "02 0C 00" → "42 0C 00 1A F8". On CAN three PIDs fit in one request,
+ *  so a whole frame takes a handful of round trips:
+ *
+ *    obd_freeze_init(&snap, 0, 3);               frame 0, 3 PIDs/request
+ *    while (obd_freeze_next_request(&snap, cmd, sizeof(cmd)) == OBD_OK)
+ *        if (...send cmd, got a reply...)
+ *            obd_freeze_parse_response(reply, &snap);
+ *        else
+ *            obd_freeze_skip_request(&snap);
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Start an empty snapshot.
+ *
+ * @param frame  Frame number to read (0 = the emissions freeze frame)
+ * @param batch  PIDs per request: 3 (OBD_FREEZE_MAX_BATCH) on CAN, 1 on
+ *               older protocols
+ * @return OBD_OK or OBD_ERROR_INVALID_ARG
+ */
+obd_result_t obd_freeze_init(obd_freeze_frame_t *snap, uint8_t frame, uint8_t batch);
+
+/**
+ * Build a Mode 02 request for up to three PIDs of one frame.
+ *
+ * @param pids      PIDs, e.g. {0x0C, 0x0D} → "020C000D00\r"
+ * @param count     Number of PIDs (1-3)
+ * @param frame     Frame number
+ * @param out       Output buffer (OBD_MAX_COMMAND_LEN is enough)
+ * @param out_size  Size of output buffer
+ * @return OBD_OK, OBD_ERROR_INVALID_ARG or OBD_ERROR_BUFFER_TOO_SMALL
+ */
+obd_result_t obd_freeze_build_request(const uint8_t *pids, size_t count, uint8_t frame,
+                                      char *out, size_t out_size);
+
+/**
+ * The next request the snapshot needs: the supported-PID bitmaps first,
+ * then PID 02 (the DTC) and every supported PID, `batch` at a time.
+ * Remembers what it asked for until the reply is parsed or skipped.
+ *
+ * @return OBD_OK, or OBD_ERROR_NO_DATA when the snapshot is complete
+ *         (also when PID 02 says no frame is stored)
+ */
+obd_result_t obd_freeze_next_request(obd_freeze_frame_t *snap, char *out, size_t out_size);
+
+/**
+ * Decode a Mode 02 reply into the snapshot.
+ *
+ * Splits "42 PID FRAME data PID FRAME data..." by the J1979 data length
+ * of each PID. Sensor-table PIDs are decoded like Mode 01; every PID is
+ * also kept raw. When several ECUs answer, the lowest CAN id wins.
+ * The PIDs of the last request are never asked again, answered or not.
+ *
+ * @param response  Cleaned response, any framing obd_reply_reassemble()
+ *                  understands
+ * @param snap      Snapshot to fill
+ * @return OBD_OK, OBD_ERROR_PARSE_FAILED (wrong frame number, truncated
+ *         data, not a Mode 02 reply) or OBD_ERROR_BUFFER_TOO_SMALL
+ */
+obd_result_t obd_freeze_parse_response(const char *response, obd_freeze_frame_t *snap);
+
+/** The last request failed (timeout, NO DATA): don't ask for those PIDs again. */
+obd_result_t obd_freeze_skip_request(obd_freeze_frame_t *snap);
+
+/** The stored value of a PID, NULL if the snapshot doesn't have it. */
+const obd_freeze_value_t *obd_freeze_find(const obd_freeze_frame_t *snap, uint8_t pid);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Readiness monitors — PID 01 and PID 41
+ *
+ *  MIL, DTC count and the complete/incomplete state of every emissions
+ *  monitor, packed into an obd_readiness_t. The batch functions judge
+ *  thousands of those at once for inspection:
+ *
+ *    obd_readiness_decode(&pid_response, &fleet[i]);      per vehicle
+ *    obd_readiness_policy_init(&policy, 2004);
+ *    n = obd_readiness_check_batch(fleet, count, &policy, ready);
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Decode a PID 01 or PID 41 reply.
+ *
+ * Input:  mode=0x41, pid=0x01, data={0x83, 0x07, 0x65, 0x04}
+ * Output: MIL on, 3 DTCs, spark ignition; misfire, fuel system,
+ *         components, catalyst, EVAP, O2 sensor, O2 heater supported;
+ *         EVAP incomplete
+ *
+ * @param response  Parsed PID response from obd_pid_parse_response()
+ * @param out       Packed result
+ * @return OBD_OK, OBD_ERROR_UNKNOWN_PID for another PID, or
+ *         OBD_ERROR_PARSE_FAILED for fewer than 4 data bytes
+ */
+obd_result_t obd_readiness_decode(const obd_pid_response_t *response,
+                                  obd_readiness_t *out);
+
+/**
+ * The usual US inspection rules for a model year: continuous monitors
+ * don't count, a lit MIL fails, 2 incomplete monitors are allowed for
+ * 1996-2000 and 1 from 2001 on.
+ *
+ * @return OBD_OK, or OBD_ERROR_INVALID_ARG before 1996 (no OBD-II)
+ */
+obd_result_t obd_readiness_policy_init(obd_readiness_policy_t *policy,
+                                       unsigned model_year);
+
+/** Supported monitors that are incomplete, minus `ignore`: the ones holding it up. */
+uint16_t obd_readiness_pending(const obd_readiness_t *r, uint16_t ignore);
+
+/** 1 if the vehicle passes the policy, 0 if not (or either pointer is NULL). */
+int obd_readiness_is_ready(const obd_readiness_t *r, const obd_readiness_policy_t *policy);
+
+/**
+ * Judge a whole array of snapshots.
+ *
+ * @param snaps   Snapshots, one per vehicle
+ * @param count   Number of snapshots
+ * @param policy  Rules to apply
+ * @param ready   Optional (may be NULL): ready[i] = 1 if snaps[i] passes
+ * @return Number of vehicles that pass
+ */
+size_t obd_readiness_check_batch(const obd_readiness_t *snaps, size_t count,
+                                 const obd_readiness_policy_t *policy, uint8_t *ready);
+
+/**
+ * For each monitor, on how many vehicles it's pending: which monitor
+ * keeps most of the fleet from passing.
+ *
+ * @param pending  pending[b] += vehicles with bit b pending, for the
+ *                 OBD_READY_MONITOR_COUNT bits; not cleared first
+ * @return OBD_OK or OBD_ERROR_INVALID_ARG
+ */
+obd_result_t obd_readiness_tally_batch(const obd_readiness_t *snaps, size_t count,
+                                       uint16_t ignore, size_t *pending);
+
+/**
+ * Name of monitor bit `bit`: "Catalyst", or "NMHC Catalyst" when
+ * `compression` is set. NULL if out of range or reserved.
+ */
+const char *obd_readiness_monitor_name(unsigned bit, int compression);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Derived sensors — values computed from other values
+ *
+ *  Fuel economy, boost, trip distance... declared as data (obd_derived_def_t)
+ *  and kept in one value table together with the PIDs they're made from.
+ *  Feeding a sample recomputes only what depends on it:
+ *
+ *    obd_derived_init(&d, obd_derived_defaults(&n), n, 2000000);
+ *    obd_derived_feed_response(&d, &pid_response, now_us);   per reply
+ *    slot = obd_derived_find(&d, OBD_DERIVED_ECONOMY);      when drawing
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Check the definitions and work out the order to evaluate them in.
+ *
+ * @param defs        Definitions; kept by pointer, must outlive `d`
+ * @param count       Number of definitions (up to OBD_DERIVED_MAX_DEFS)
+ * @param max_age_us  How far apart in time inputs may be and still be
+ *                    combined (0 = any)
+ * @return OBD_OK, OBD_ERROR_INVALID_ARG (channel below 0x100 or twice,
+ *         an input that is neither a PID nor defined, a cycle, a wrong
+ *         input count for the operation) or OBD_ERROR_BUFFER_TOO_SMALL
+ *         (more than OBD_DERIVED_MAX_CHANNELS channels)
+ */
+obd_result_t obd_derived_init(obd_derived_t *d, const obd_derived_def_t *defs, size_t count,
+                              uint64_t max_age_us);
+
+/**
+ * A new sample of a PID: store it and recompute whatever depends on it,
+ * directly or through other derived values. Nothing else is touched.
+ *
+ * @param pid    Mode 01 PID (derived channels can't be fed)
+ * @param value  In the sensor table's unit
+ * @param t_us   When it was sampled (any monotonic clock)
+ * @return OBD_OK, or OBD_ERROR_BUFFER_TOO_SMALL when a PID no definition
+ *         uses finds the table full
+ */
+obd_result_t obd_derived_feed(obd_derived_t *d, uint8_t pid, float value, uint64_t t_us);
+
+/**
+ * obd_sensor_decode() a reply and feed the value.
+ *
+ * @return OBD_OK or the error of obd_sensor_decode() / obd_derived_feed()
+ */
+obd_result_t obd_derived_feed_response(obd_derived_t *d, const obd_pid_response_t *response,
+                                       uint64_t t_us);
+
+/** The table row for a PID or derived channel, NULL if it has none. */
+const obd_derived_slot_t *obd_derived_find(const obd_derived_t *d, uint16_t channel);
+
+/**
+ * Start an integral over (new trip): back to its offset, and whatever
+ * depends on it is recomputed.
+ *
+ * @return OBD_OK, or OBD_ERROR_UNKNOWN_PID if channel isn't an integral
+ */
+obd_result_t obd_derived_reset(obd_derived_t *d, uint16_t channel);
+
+/**
+ * The built-in definitions (OBD_DERIVED_FUEL_RATE ... OBD_DERIVED_FUEL_USED),
+ * for petrol engines. Copy and edit them for other fuels.
+ */
+const obd_derived_def_t *obd_derived_defaults(size_t *count);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Resampling — per-PID samples onto one fixed-rate timebase
+ *
+ *  Streaming, as replies arrive:
+ *
+ *    obd_resample_init(&rs, 100000, 500000);        10 Hz, at most 0.5 s late
+ *    obd_resample_add_channel(&rs, 0x0C, OBD_RESAMPLE_LINEAR);
+ *    obd_resample_push(&rs, 0x0C, t_us, rpm);       per sample
+ *    while (obd_resample_poll(&rs, now_us, &row) == OBD_OK)
+ *        ...row.values[0] is RPM at row.t_us...
+ *
+ *  Or a whole logged trip at once with obd_resample_batch().
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Empty resampler.
+ *
+ * @param period_us       Time between rows (rows fall on multiples of it)
+ * @param max_latency_us  How long a row may wait for a late channel
+ * @return OBD_OK, or OBD_ERROR_INVALID_ARG for a zero period
+ */
+obd_result_t obd_resample_init(obd_resampler_t *rs, uint64_t period_us,
+                               uint64_t max_latency_us);
+
+/**
+ * Add a column. Its index (0, 1, ...) is its place in obd_resample_row_t.
+ *
+ * @return OBD_OK, OBD_ERROR_INVALID_ARG (channel already added, unknown
+ *         mode) or OBD_ERROR_BUFFER_TOO_SMALL (OBD_RESAMPLE_MAX_CHANNELS)
+ */
+obd_result_t obd_resample_add_channel(obd_resampler_t *rs, uint16_t channel, uint8_t mode);
+
+/**
+ * A new sample. Samples of one channel must come in time order; one with
+ * the same time as the last replaces it. A full ring drops its oldest.
+ *
+ * @return OBD_OK, OBD_ERROR_UNKNOWN_PID for a channel not added, or
+ *         OBD_ERROR_INVALID_ARG for a sample older than the last one
+ */
+obd_result_t obd_resample_push(obd_resampler_t *rs, uint16_t channel, uint64_t t_us,
+                               float value);
+
+/**
+ * The next row, if it's ready: every channel has a sample at or after
+ * the row's time, or now_us is max_latency_us past it.
+ *
+ * @return OBD_OK (row filled), or OBD_ERROR_NO_DATA when the next row
+ *         isn't ready yet
+ */
+obd_result_t obd_resample_poll(obd_resampler_t *rs, uint64_t now_us, obd_resample_row_t *row);
+
+/**
+ * Resample one channel of a recorded trip onto t0_us + i * period_us,
+ * i = 0 .. n_out - 1. Before the first sample and after the last, the
+ * nearest sample is held.
+ *
+ * @param t_us, values  n_in samples in time order
+ * @param out           n_out values
+ * @return OBD_OK, or OBD_ERROR_INVALID_ARG (no samples, zero period,
+ *         unknown mode, samples out of order)
+ */
+obd_result_t obd_resample_batch(const uint64_t *t_us, const float *values, size_t n_in,
+                                uint8_t mode, uint64_t t0_us, uint64_t period_us,
+                                float *out, size_t n_out);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Summaries — min/max/mean/stddev/percentiles per sensor, in O(1) memory
+ *
+ *    obd_summary_reset(&trip_rpm);               trip start
+ *    obd_summary_add(&trip_rpm, rpm, t_us);      per sample
+ *    obd_summary_snapshot(&trip_rpm, &snap);     trip end: show it
+ *    obd_summary_merge(&day_rpm, &trip_rpm);     roll it up
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** Empty summary (also how to start one). */
+obd_result_t obd_summary_reset(obd_summary_t *s);
+
+/** One more sample, taken at t_us. */
+obd_result_t obd_summary_add(obd_summary_t *s, float value, uint64_t t_us);
+
+/**
+ * Fold `src` into `dst`: afterwards dst describes the samples of both.
+ * Count, mean, variance, min and max merge exactly; percentiles within
+ * the sketch's accuracy. src is unchanged.
+ *
+ * @return OBD_OK or OBD_ERROR_INVALID_ARG
+ */
+obd_result_t obd_summary_merge(obd_summary_t *dst, const obd_summary_t *src);
+
+/**
+ * Estimate a quantile (0.5 = median, 0.99 = p99) from the sketch.
+ * Typically within 1% of rank in the middle and much closer at the ends;
+ * 0 and 1 give the exact min and max.
+ *
+ * @return The value, or 0 for an empty summary
+ */
+float obd_summary_quantile(const obd_summary_t *s, double quantile);
+
+/**
+ * Everything at once: count, min/max with their times, mean, standard
+ * deviation, p50/p95/p99.
+ *
+ * @return OBD_OK, or OBD_ERROR_NO_DATA for an empty summary
+ */
+obd_result_t obd_summary_snapshot(const obd_summary_t *s, obd_summary_snapshot_t *out);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Heatmaps — operating-point histograms of one channel against another
+ *
+ *    static const float rpm[]  = { 0, 1000, 2000, 3000, 4000, 6000, 8000 };
+ *    static const float load[] = { 0, 20, 40, 60, 80, 100 };
+ *    obd_heatmap_init(&h, 0x0C, rpm, 6, 0x04, load, 5);
+ *
+ *    obd_heatmap_feed_sensor(&h, &value);        per decoded reply, or
+ *    obd_heatmap_add_row(&h, &row, 0, 1);        per resampled row
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Set up the axes and clear the counts.
+ *
+ * @param x_channel, y_channel  What obd_heatmap_feed() matches on
+ * @param x_edges, y_edges      bins + 1 finite edges, increasing. No bin
+ *                              may be narrower than 2/OBD_HEATMAP_LUT of
+ *                              its axis (1/128 of the range).
+ * @param x_bins, y_bins        1 .. OBD_HEATMAP_MAX_BINS
+ * @return OBD_OK or OBD_ERROR_INVALID_ARG
+ */
+obd_result_t obd_heatmap_init(obd_heatmap_t *h,
+                              uint16_t x_channel, const float *x_edges, size_t x_bins,
+                              uint16_t y_channel, const float *y_edges, size_t y_bins);
+
+/** Zero the counts, keep the axes (the next trip). */
+obd_result_t obd_heatmap_clear(obd_heatmap_t *h);
+
+/**
+ * Count one (x, y) sample.
+ *
+ * @return OBD_OK, or OBD_ERROR_INVALID_ARG for NaN (counted in dropped)
+ */
+obd_result_t obd_heatmap_add(obd_heatmap_t *h, float x, float y);
+
+/** Count n samples: x[i] against y[i]. NaN pairs are dropped. */
+obd_result_t obd_heatmap_add_batch(obd_heatmap_t *h, const float *x, const float *y, size_t n);
+
+/**
+ * One value of one channel, as it arrives. The x and y channels pair up:
+ * once each has a value since the last count, the pair is counted. For
+ * channels polled at different rates, count resampled rows instead.
+ *
+ * @return OBD_OK, or OBD_ERROR_UNKNOWN_PID if the channel is on neither axis
+ */
+obd_result_t obd_heatmap_feed(obd_heatmap_t *h, uint16_t channel, float value);
+
+/** obd_heatmap_feed() with what obd_sensor_decode() produced. */
+obd_result_t obd_heatmap_feed_sensor(obd_heatmap_t *h, const obd_sensor_value_t *value);
+
+/**
+ * Count a resampled row: columns x_col and y_col of it.
+ *
+ * @return OBD_OK, OBD_ERROR_NO_DATA if either column has no value in this
+ *         row, or OBD_ERROR_INVALID_ARG
+ */
+obd_result_t obd_heatmap_add_row(obd_heatmap_t *h, const obd_resample_row_t *row,
+                                 size_t x_col, size_t y_col);
+
+/**
+ * Add src's counts to dst's (cells saturate at UINT32_MAX).
+ *
+ * @return OBD_OK, or OBD_ERROR_INVALID_ARG if the edges differ
+ */
+obd_result_t obd_heatmap_merge(obd_heatmap_t *dst, const obd_heatmap_t *src);
+
+/** Count in cell (x bin, y bin), or 0 outside the axes. */
+uint32_t obd_heatmap_cell(const obd_heatmap_t *h, size_t x_bin, size_t y_bin);
+
+/**
+ * Write the grid as CSV: a header of x bin lower edges, then one line per
+ * y bin (its lower edge, then the counts), lowest first.
+ *
+ * @return OBD_OK or OBD_ERROR_BUFFER_TOO_SMALL (16 KB always fits)
+ */
+obd_result_t obd_heatmap_format_csv(const obd_heatmap_t *h, char *out, size_t out_size);
+
+/**
+ * Write the heatmap as JSON: both axes with their edges, the totals, and
+ * the non-zero cells as [x bin, y bin, count].
+ *
+ * @return OBD_OK or OBD_ERROR_BUFFER_TOO_SMALL (32 KB always fits)
+ */
+obd_result_t obd_heatmap_format_json(const obd_heatmap_t *h, char *out, size_t out_size);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Alert rules — conditions compiled from text, run on every sample
+ *
+ *    obd_rules_init(&rules);
+ *    obd_rules_add(&rules, "coolant hot", "$05 > 110 for 10s clear $05 < 105", NULL);
+ *
+ *    obd_rules_feed(&rules, pid, value, t_us);        per sample
+ *    obd_rules_tick(&rules, now_us);                  now and then
+ *    while (obd_rules_poll(&rules, &event) == OBD_OK)
+ *        show(event.name, event.active);
+ *
+ *  The language is described with obd_rules_t in obd_types.h.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** No rules, no channels. */
+obd_result_t obd_rules_init(obd_rules_t *rules);
+
+/**
+ * Compile a rule and add it.
+ *
+ * @param name   Copied, up to OBD_RULE_NAME_LEN - 1 characters
+ * @param index  Receives the rule's index (may be NULL)
+ * @return OBD_OK, OBD_ERROR_PARSE_FAILED (rules->error says what and
+ *         rules->error_at where), or OBD_ERROR_BUFFER_TOO_SMALL (too many
+ *         rules, channels, constants or too much code). Nothing is added
+ *         on failure.
+ */
+obd_result_t obd_rules_add(obd_rules_t *rules, const char *name, const char *text,
+                           size_t *index);
+
+/**
+ * A new sample. Runs the rules that read this channel, if all their
+ * inputs have values, and queues an event for each one that starts or
+ * ends.
+ *
+ * @return OBD_OK, or OBD_ERROR_UNKNOWN_PID if no rule reads this channel
+ */
+obd_result_t obd_rules_feed(obd_rules_t *rules, uint16_t channel, float value, uint64_t t_us);
+
+/** obd_rules_feed() with what obd_sensor_decode() produced. */
+obd_result_t obd_rules_feed_sensor(obd_rules_t *rules, const obd_sensor_value_t *value,
+                                   uint64_t t_us);
+
+/**
+ * Let "for" and "hold" run out without new samples: a rule waiting since
+ * t starts (or ends) once now_us reaches t + its duration. Call it every
+ * second or so, or after a poll cycle.
+ */
+obd_result_t obd_rules_tick(obd_rules_t *rules, uint64_t now_us);
+
+/**
+ * The oldest queued event.
+ *
+ * @return OBD_OK, or OBD_ERROR_NO_DATA when there are none
+ */
+obd_result_t obd_rules_poll(obd_rules_t *rules, obd_rule_event_t *event);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Trips — where a log's trips start and end, with a summary of each
+ *
+ *    obd_trip_init(&trip);
+ *
+ *    obd_trip_feed(&trip, pid, value, t_us, pos);     per sample
+ *    obd_trip_tick(&trip, now_us);                    now and then
+ *    while (obd_trip_poll(&trip, &event) == OBD_OK)
+ *        index(event.trip);                           e.g. into the journal
+ *    obd_trip_flush(&trip);                           end of log
+ *
+ *  An archive can be split and each part segmented on its own thread;
+ *  obd_trip_join() then stitches a trip cut at a boundary back together.
+ *  How the engine's state is read is described with obd_trip_t in
+ *  obd_types.h.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** No trips, default settings. */
+obd_result_t obd_trip_init(obd_trip_t *trip);
+
+/**
+ * A new sample. pos is where it is in the log, as the caller counts;
+ * trips report the pos of their first and last samples.
+ *
+ * @return OBD_OK, or OBD_ERROR_INVALID_ARG if t_us is older than the
+ *         previous sample
+ */
+obd_result_t obd_trip_feed(obd_trip_t *trip, uint16_t channel, float value, uint64_t t_us,
+                           uint64_t pos);
+
+/** obd_trip_feed() with what obd_sensor_decode() produced. */
+obd_result_t obd_trip_feed_sensor(obd_trip_t *trip, const obd_sensor_value_t *value,
+                                  uint64_t t_us, uint64_t pos);
+
+/**
+ * obd_trip_feed() for n samples in a row, as read back from an archive.
+ * Sample i is at pos first_pos + i. Stops at the first one that fails.
+ */
+obd_result_t obd_trip_feed_batch(obd_trip_t *trip, const uint16_t *channels,
+                                 const float *values, const uint64_t *t_us,
+                                 uint64_t first_pos, size_t n);
+
+/**
+ * Let end_after_us, gap_us and idle_after_us run out without new samples.
+ * Call it every second or so while capturing; a batch pass doesn't need
+ * it.
+ */
+obd_result_t obd_trip_tick(obd_trip_t *trip, uint64_t now_us);
+
+/**
+ * The log ends here: a trip still going ends at the last sample, with
+ * OBD_TRIP_END_FLUSH (or OBD_TRIP_END_ENGINE_OFF if the engine was
+ * already off).
+ */
+obd_result_t obd_trip_flush(obd_trip_t *trip);
+
+/**
+ * The oldest queued event.
+ *
+ * @return OBD_OK, or OBD_ERROR_NO_DATA when there are none
+ */
+obd_result_t obd_trip_poll(obd_trip_t *trip, obd_trip_event_t *event);
+
+/**
+ * Stitch b onto a, when b is the same trip carried on in the next part
+ * of the log: a was flushed, b was running from its part's first vote,
+ * and it began less than gap_us after a ended. a becomes the whole trip
+ * (less the distance between the last speed of one part and the first
+ * of the next).
+ *
+ * @return OBD_OK, or OBD_ERROR_NO_DATA if b is a trip of its own
+ */
+obd_result_t obd_trip_join(obd_trip_summary_t *a, const obd_trip_summary_t *b,
+                           uint64_t gap_us);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Adaptive polling — ask for fast-changing PIDs often, steady ones rarely
+ *
+ *    obd_sched_init(&sched);
+ *    obd_sched_add(&sched, 0x01, 0x0C, 50.0f, 100000, 1000000);    RPM
+ *    obd_sched_add(&sched, 0x01, 0x05, 1.0f, 500000, 30000000);    coolant
+ *
+ *    when the session is idle:
+ *    if (obd_sched_next(&sched, now, &mode, &pid) == OBD_OK)
+ *        obd_session_submit_pid(&session, mode, pid, now, &id);
+ *    for each result:
+ *    obd_sched_feed_result(&sched, &result);
+ *
+ *  How intervals adapt is described with obd_sched_t in obd_types.h.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** No PIDs. */
+obd_result_t obd_sched_init(obd_sched_t *sched);
+
+/**
+ * Poll a PID, between every min_us and every max_us. It starts at min_us
+ * and is due at once. Adding one that's there already changes its
+ * settings and keeps what it learnt.
+ *
+ * @param resolution  The smallest change worth seeing, in the PID's units
+ * @return OBD_OK, OBD_ERROR_INVALID_ARG (min_us 0 or over max_us,
+ *         resolution not above 0), or OBD_ERROR_BUFFER_TOO_SMALL when
+ *         OBD_SCHED_MAX_PIDS are already polled
+ */
+obd_result_t obd_sched_add(obd_sched_t *sched, uint8_t mode, uint8_t pid, float resolution,
+                           uint64_t min_us, uint64_t max_us);
+
+/**
+ * The PID to send now: the most overdue of those that are due. It counts
+ * as sent at now_us. Call it when there's room for a request (one at a
+ * time per adapter is best: obd_session_pending() is 0).
+ *
+ * @return OBD_OK, or OBD_ERROR_NO_DATA when nothing is due before
+ *         obd_sched_deadline()
+ */
+obd_result_t obd_sched_next(obd_sched_t *sched, uint64_t now_us, uint8_t *mode, uint8_t *pid);
+
+/** When the next PID falls due (µs); 0 if one was never sent, or there are none. */
+uint64_t obd_sched_deadline(const obd_sched_t *sched);
+
+/**
+ * A decoded value of a polled PID, taken at t_us. Updates its slope and
+ * noise, and with them its interval.
+ *
+ * @return OBD_OK, OBD_ERROR_UNKNOWN_PID if it isn't polled, or
+ *         OBD_ERROR_INVALID_ARG if t_us is older than its last value
+ */
+obd_result_t obd_sched_feed(obd_sched_t *sched, uint8_t mode, uint8_t pid, float value,
+                            uint64_t t_us);
+
+/**
+ * obd_sched_feed() with a session's result: the value obd_sensor_decode()
+ * produced, at the time its reply started to arrive (the FIRST_BYTE trace
+ * point, or PROMPT).
+ *
+ * @return as obd_sched_feed(), or OBD_ERROR_NO_DATA for a result with no
+ *         decoded value (an error, a timeout, an AT command)
+ */
+obd_result_t obd_sched_feed_result(obd_sched_t *sched, const obd_session_result_t *result);
+
+/**
+ * Round trips saved so far: the requests that polling every PID at its
+ * min_us would have sent over the same time, less those actually sent.
+ */
+uint64_t obd_sched_saved(const obd_sched_t *sched);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Change filter — only values that changed go downstream
+ *
+ *    obd_filter_init(&filter);
+ *    obd_filter_set(&filter, 0x0C, 25.0f, 0.0f, 5000000);     RPM: 25 rpm, 5 s
+ *    obd_filter_set(&filter, 0x04, 0.0f, 0.05f, 30000000);    load: 5%, 30 s
+ *
+ *    per reply:
+ *    if (obd_filter_decode(&filter, &response, now, &value) == OBD_OK)
+ *        show(&value);                                         a real change
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** No PIDs; the defaults pass any change. */
+obd_result_t obd_filter_init(obd_filter_t *filter);
+
+/**
+ * Deadbands and keepalive for one PID (Mode 01). Changing them keeps the
+ * PID's last values.
+ *
+ * @param abs_deadband  Pass when the value moves by more than this ...
+ * @param rel_deadband  ... or by more than this fraction of the last one passed
+ * @param keepalive_us  Pass one anyway after this long without; 0 = never
+ * @return OBD_OK, OBD_ERROR_INVALID_ARG (a negative deadband), or
+ *         OBD_ERROR_BUFFER_TOO_SMALL when OBD_FILTER_MAX_PIDS have settings
+ */
+obd_result_t obd_filter_set(obd_filter_t *filter, uint8_t pid, float abs_deadband,
+                            float rel_deadband, uint64_t keepalive_us);
+
+/**
+ * Decode a parsed reply with obd_sensor_decode(), unless its data bytes
+ * are the ones the PID's last reply had, and say whether the value goes
+ * downstream.
+ *
+ * @param out  The value (also when it doesn't go downstream, unless the
+ *             bytes were unchanged and nothing is due)
+ * @return OBD_OK (pass it on), OBD_ERROR_NO_DATA (nothing new), or what
+ *         obd_sensor_decode() returned
+ */
+obd_result_t obd_filter_decode(obd_filter_t *filter, const obd_pid_response_t *response,
+                               uint64_t now_us, obd_sensor_value_t *out);
+
+/**
+ * The deadband and keepalive half of obd_filter_decode(), for a value
+ * decoded elsewhere (a session result, say).
+ *
+ * @return OBD_OK (pass it on) or OBD_ERROR_NO_DATA
+ */
+obd_result_t obd_filter_value(obd_filter_t *filter, const obd_sensor_value_t *value,
+                              uint64_t now_us);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Downsampling — a long trip on a narrow chart
+ *
+ *    obd_lttb(x, y, n, 1000, index, &count);      1000 samples that keep
+ *                                                 the line's shape
+ *
+ *    once, when the trip log is written:
+ *    obd_pyramid_build(&pyr, values, n, buf, obd_pyramid_size(n));
+ *    store(buf, obd_pyramid_size(n));             next to the log
+ *
+ *    any zoom, later:
+ *    obd_pyramid_attach(&pyr, buf, len, n);
+ *    obd_pyramid_query(&pyr, values, first, last, 800, minmax);
+ *                                                 800 (min, max) pairs
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Largest-Triangle-Three-Buckets: the first and last samples, and from
+ * each of threshold - 2 equal buckets between them, the one making the
+ * largest triangle with the sample kept before it and the average of the
+ * next bucket. O(n).
+ *
+ * @param x,y        n samples; x ascending
+ * @param threshold  Samples wanted; at least 3 unless n <= threshold
+ * @param index      threshold entries, filled with the kept samples' indices
+ * @param count      Set to how many were kept: min(n, threshold)
+ * @return OBD_OK or OBD_ERROR_INVALID_ARG
+ */
+obd_result_t obd_lttb(const float *x, const float *y, size_t n, size_t threshold,
+                      size_t *index, size_t *count);
+
+/** Floats a pyramid over this many samples takes (0 for none). */
+size_t obd_pyramid_size(size_t samples);
+
+/**
+ * Build a pyramid over values[0..n) into buf. NaN samples are left out;
+ * a block of nothing but NaN is NaN.
+ *
+ * @return OBD_OK, OBD_ERROR_INVALID_ARG, or OBD_ERROR_BUFFER_TOO_SMALL if
+ *         buf_len < obd_pyramid_size(n)
+ */
+obd_result_t obd_pyramid_build(obd_pyramid_t *pyr, const float *values, size_t n,
+                               float *buf, size_t buf_len);
+
+/**
+ * Use a pyramid built earlier (e.g. read back from the log's side file)
+ * over n samples. buf is not copied and must outlive pyr.
+ *
+ * @return OBD_OK, OBD_ERROR_INVALID_ARG, or OBD_ERROR_BUFFER_TOO_SMALL if
+ *         buf_len is less than n samples need
+ */
+obd_result_t obd_pyramid_attach(obd_pyramid_t *pyr, const float *buf, size_t buf_len,
+                                size_t n);
+
+/**
+ * The min and max of samples [first, last) under each of pixels columns,
+ * into out[0..2 x pixels): min, max, min, max, ... Each column is read
+ * from the coarsest level with at least two blocks under it, so the cost
+ * is at most 2 x OBD_PYRAMID_FANOUT + 1 blocks a column, whatever the
+ * window. Edges between columns move to the nearest block edge, a
+ * quarter of a column at most; the window's own ends don't. The part
+ * blocks there are made up from finer levels and, under a level-0
+ * block, from values: O(levels) more for the whole query.
+ *
+ * Zoomed in past two level-0 blocks a column, the samples themselves are
+ * read from values, up to 2 x OBD_PYRAMID_BASE a column. values may be
+ * NULL; then whole level-0 blocks are used wherever samples would be, so
+ * a column may take in up to OBD_PYRAMID_BASE - 1 samples past its edge,
+ * but never misses one inside.
+ *
+ * @return OBD_OK, or OBD_ERROR_INVALID_ARG (an empty or out of range window,
+ *         no pixels)
+ */
+obd_result_t obd_pyramid_query(const obd_pyramid_t *pyr, const float *values, size_t first,
+                               size_t last, size_t pixels, float *out);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Vehicle information — Mode 09, per ECU
+ *
+ *  VIN, calibration IDs, CVNs, ECU names and in-use performance counters
+ *  from every ECU that answers, collected in an obd_vehicle_profile_t.
+ *  None of it changes while the car is in use, so the profile remembers
+ *  what it has and obd_info_next_request() only asks for what's missing:
+ *
+ *    obd_info_profile_init(&profile);            once per vehicle
+ *    while (obd_info_next_request(&profile, cmd, sizeof(cmd)) == OBD_OK)
+ *        ...send cmd, obd_info_parse_response(reply, &profile)...
+ *
+ *  Keep the profile across reconnects and the loop sends nothing.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** Empty profile: nothing known, nothing read. */
+obd_result_t obd_info_profile_init(obd_vehicle_profile_t *profile);
+
+/**
+ * The next Mode 09 request the profile still needs.
+ *
+ * The supported-PID bitmaps come first ("0900\r"), then PIDs 02, 04,
+ * 06, 0A, 08 and 0B, each only if the car supports it.
+ *
+ * @param out       Output buffer (receives e.g. "0904\r")
+ * @param out_size  Size of output buffer
+ * @return OBD_OK, or OBD_ERROR_NO_DATA when the profile is complete
+ */
+obd_result_t obd_info_next_request(const obd_vehicle_profile_t *profile,
+                                   char *out, size_t out_size);
+
+/**
+ * Merge a Mode 09 reply into the profile.
+ *
+ * Any framing obd_reply_reassemble() understands, any number of ECUs;
+ * each ECU's answer goes to its own obd_ecu_info_t. Bitmap replies
+ * (PID 00, 20...) update profile->supported. Pre-CAN VIN lines
+ * ("49 02 01 ...") are accepted too.
+ *
+ * @param response  Cleaned response
+ * @param profile   Profile to merge into
+ * @return OBD_OK, OBD_ERROR_PARSE_FAILED if no Mode 09 data was found
+ *         or a message is shorter than its item count says,
+ *         OBD_ERROR_BUFFER_TOO_SMALL for more than OBD_MAX_ECUS ECUs or
+ *         more items than the profile has room for
+ */
+obd_result_t obd_info_parse_response(const char *response,
+                                     obd_vehicle_profile_t *profile);
+
+/**
+ * Mark a PID as read (give up on it, e.g. after NO DATA) or unread (ask
+ * again: in-use performance counters grow with every drive cycle).
+ *
+ * @return OBD_OK, or OBD_ERROR_INVALID_ARG for a PID above 0x1F that
+ *         isn't a bitmap PID
+ */
+obd_result_t obd_info_set_read(obd_vehicle_profile_t *profile, uint8_t pid, int read);
+
+/** The entry for CAN id ecu (0 with headers off), NULL if it never answered. */
+obd_ecu_info_t *obd_info_find_ecu(obd_vehicle_profile_t *profile, uint16_t ecu);
+
+/**
+ * Name of in-use performance counter index for PID 0x08 (spark ignition)
+ * or 0x0B (compression ignition): "OBDCOND", "CATCOMP1"... NULL if out
+ * of range.
+ */
+const char *obd_info_ipt_name(uint8_t pid, size_t index);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Instrumentation — call counts, error tallies, latency histograms
+ *
+ *  Compiled in only with -DOBD_ENABLE_STATS=ON. Without it, the hooks in
+ *  the parsers compile to nothing and these functions just report zeros,
+ *  so your code can call them unconditionally.
+ *
+ *  Each thread counts into its own slot (no locks, no atomics on the hot
+ *  path). obd_stats_snapshot() adds all the slots together.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** Returns 1 if the library was built with OBD_ENABLE_STATS, else 0. */
+int obd_stats_enabled(void);
+
+/**
+ * Copy the counters of ALL threads, merged, into `out`.
+ *
+ * Other threads keep counting while we read, so a snapshot taken under
+ * load can be off by the few calls that were in flight.
+ */
+obd_result_t obd_stats_snapshot(obd_stats_t *out);
+
+/** Copy only the calling thread's counters into `out`. */
+obd_result_t obd_stats_snapshot_thread(obd_stats_t *out);
+
+/**
+ * Add `src` into `dst` (counts, tallies and histograms).
+ * Use this to combine snapshots from several processes or time windows.
+ */
+obd_result_t obd_stats_merge(obd_stats_t *dst, const obd_stats_t *src);
+
+/** Zero every thread's counters. */
+void obd_stats_reset(void);
+
+/**
+ * Latency (in ns) below which `quantile` of the calls completed,
+ * e.g. quantile=0.99 for p99. Returns 0 if there are no calls.
+ */
+double obd_stats_quantile_ns(const obd_stats_t *stats, obd_stat_fn_t fn,
+                             double quantile);
+
+/**
+ * Write a human-readable table (one line per function that was called).
+ *
+ * @return OBD_OK or OBD_ERROR_BUFFER_TOO_SMALL (4 KB is plenty)
+ */
+obd_result_t obd_stats_format_text(const obd_stats_t *stats,
+                                   char *out, size_t out_size);
+
+/**
+ * Write the snapshot as JSON, including the non-empty histogram buckets.
+ *
+ * @return OBD_OK or OBD_ERROR_BUFFER_TOO_SMALL (32 KB always fits)
+ */
+obd_result_t obd_stats_format_json(const obd_stats_t *stats,
+                                   char *out, size_t out_size);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Session — the request/response loop for one adapter
+ *
+ *  Still no I/O: the session decides WHAT to send and makes sense of what
+ *  comes back; you move the bytes. Every call takes "now" in microseconds
+ *  from your own monotonic clock.
+ *
+ *    obd_session_submit_pid(&s, 0x01, 0x0C, now, &id);     queue a request
+ *    obd_session_next_command(&s, now, cmd, sizeof(cmd), &n);
+ *    ...write cmd...
+ *    obd_session_write_done(&s, now);
+ *    ...as bytes arrive...
+ *    obd_session_feed(&s, bytes, len, now);
+ *    obd_session_tick(&s, now);                             handle timeouts
+ *    while (obd_session_poll(&s, &result) == OBD_OK) { ... }
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** Reset a session to idle with an empty queue and the default timeout. */
+obd_result_t obd_session_init(obd_session_t *s);
+
+/** How long to wait for the ">" prompt before OBD_ERROR_TIMEOUT (µs). */
+obd_result_t obd_session_set_timeout(obd_session_t *s, uint64_t timeout_us);
+
+/**
+ * Optional clock for the PARSED/DECODED trace points, which happen inside
+ * obd_session_feed(). Without one they get the prompt's timestamp.
+ */
+obd_result_t obd_session_set_clock(obd_session_t *s, obd_clock_fn clock, void *ctx);
+
+/**
+ * Send every finished request's timestamps to a trace collector.
+ * `track` labels this session in the Chrome trace (one row per track).
+ * Pass trace=NULL to stop tracing.
+ */
+obd_result_t obd_session_set_trace(obd_session_t *s, obd_trace_t *trace,
+                                   uint16_t track);
+
+/**
+ * Tap the raw traffic: `capture` gets each command as it is handed out
+ * (OBD_CAPTURE_TX, with its \r) and every byte passed to
+ * obd_session_feed() (OBD_CAPTURE_RX), before the session looks at it.
+ * Pass capture=NULL to stop.
+ */
+obd_result_t obd_session_set_capture(obd_session_t *s, obd_capture_fn capture,
+                                     void *ctx);
+
+/**
+ * Queue a Mode/PID request, e.g. (0x01, 0x0C) for RPM.
+ *
+ * @param out_id  Receives the request id (matches obd_session_result_t.id)
+ * @return OBD_OK or OBD_ERROR_BUSY if the queue is full
+ */
+obd_result_t obd_session_submit_pid(obd_session_t *s, uint8_t mode, uint8_t pid,
+                                    uint64_t now_us, uint32_t *out_id);
+
+/**
+ * Queue any command: "ATZ", "03", "0902"... (the \r is added for you).
+ * All-hex commands are parsed like OBD replies; anything else comes back
+ * as text in obd_session_result_t.response.
+ */
+obd_result_t obd_session_submit_command(obd_session_t *s, const char *command,
+                                        uint64_t now_us, uint32_t *out_id);
+
+/**
+ * Get the next command to write to the adapter, if it's time to send one.
+ *
+ * @param out      Receives the command including \r
+ * @param out_len  Receives its length
+ * @return OBD_OK, or OBD_ERROR_NO_DATA when there's nothing to send yet
+ *         (a request is in flight, the queue is empty, or 8 results are
+ *         waiting for obd_session_poll())
+ */
+obd_result_t obd_session_next_command(obd_session_t *s, uint64_t now_us,
+                                      char *out, size_t out_size, size_t *out_len);
+
+/** Tell the session the command from next_command() has been written. */
+obd_result_t obd_session_write_done(obd_session_t *s, uint64_t now_us);
+
+/**
+ * Hand the session bytes read from the adapter, in any chunk size.
+ * When the ">" prompt arrives, the reply is parsed and a result is
+ * queued for obd_session_poll().
+ */
+obd_result_t obd_session_feed(obd_session_t *s, const char *data, size_t len,
+                              uint64_t now_us);
+
+/**
+ * Check the timeout. Call it whenever your wait for bytes times out, or
+ * at obd_session_deadline(). A request that timed out shows up in
+ * obd_session_poll() with status OBD_ERROR_TIMEOUT.
+ */
+obd_result_t obd_session_tick(obd_session_t *s, uint64_t now_us);
+
+/** When obd_session_tick() next needs to run (µs), or 0 if never. */
+uint64_t obd_session_deadline(const obd_session_t *s);
+
+/** Requests queued or in flight. */
+size_t obd_session_pending(const obd_session_t *s);
+
+/**
+ * Withdraw a request. One still in the queue is dropped and never sent.
+ * One already sent can't be taken back — the ELM327 finishes what it
+ * started — so, as after a timeout, its result comes out of
+ * obd_session_poll() at once with status OBD_ERROR_CANCELLED, and the
+ * late reply is drained up to its prompt before anything else is sent.
+ *
+ * @return OBD_OK (dropped), OBD_PENDING (cancelled result waiting for
+ *         poll) or OBD_ERROR_NO_DATA if `id` is neither queued nor in flight
+ */
+obd_result_t obd_session_cancel(obd_session_t *s, uint32_t id);
+
+/**
+ * Take the oldest finished request's result.
+ *
+ * @return OBD_OK if `out` was filled, OBD_ERROR_NO_DATA if none are ready
+ */
+obd_result_t obd_session_poll(obd_session_t *s, obd_session_result_t *out);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Round-trip Tracing — where does each request's time go?
+ *
+ *  Attach a collector with obd_session_set_trace(). Each finished request
+ *  is added to per-(mode, PID, ECU) phase histograms, and optionally kept
+ *  in a ring of recent records for a Chrome trace-event export.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Clear a collector.
+ *
+ * @param records     Optional ring for obd_trace_format_chrome() (may be NULL)
+ * @param record_cap  Number of entries in `records`
+ */
+obd_result_t obd_trace_init(obd_trace_t *trace, obd_trace_record_t *records,
+                            size_t record_cap);
+
+/** Add one finished request (the session does this for you). */
+obd_result_t obd_trace_add(obd_trace_t *trace, const obd_trace_record_t *rec);
+
+/** Look up the numbers for one (mode, PID, ECU), or NULL if never seen. */
+const obd_trace_key_t *obd_trace_find(const obd_trace_t *trace, uint8_t mode,
+                                      uint8_t pid, uint16_t ecu);
+
+/** Time (µs) below which `quantile` of the requests finished `phase`. */
+double obd_trace_quantile_us(const obd_trace_key_t *key, obd_trace_phase_t phase,
+                             double quantile);
+
+/** Per-PID table of mean/p50/p99/max for every phase (ms). */
+obd_result_t obd_trace_format_text(const obd_trace_t *trace,
+                                   char *out, size_t out_size);
+
+/**
+ * The recorded requests as Chrome trace-event JSON. Open the file in
+ * chrome://tracing or ui.perfetto.dev. Needs roughly 1 KB per record.
+ *
+ * @return OBD_OK or OBD_ERROR_BUFFER_TOO_SMALL
+ */
+obd_result_t obd_trace_format_chrome(const obd_trace_t *trace,
+                                     char *out, size_t out_size);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Response Cache — ask the adapter less often
+ *
+ *  Sits in front of a session. Answers that are still fresh come straight
+ *  from the cache; a request that's already queued or on the wire is
+ *  shared instead of sent twice. Use obd_cache_poll() in place of
+ *  obd_session_poll() so answers get stored.
+ *
+ *  Built-in TTLs: Mode 09 and the supported-PID bitmaps forever,
+ *  temperatures 2 s, fuel level/ambient/baro 10 s, everything else 0
+ *  (not cached, but still coalesced). Override with obd_cache_set_ttl().
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** Empty the cache and reset its statistics and TTL rules. */
+obd_result_t obd_cache_init(obd_cache_t *cache);
+
+/**
+ * Set the TTL for one PID, or a whole mode with pid=OBD_CACHE_ANY_PID.
+ * ttl_us = OBD_CACHE_TTL_FOREVER never expires; 0 turns caching off.
+ */
+obd_result_t obd_cache_set_ttl(obd_cache_t *cache, uint8_t mode, uint16_t pid,
+                               uint64_t ttl_us);
+
+/** The TTL that applies to (mode, pid): your rules first, then built-ins. */
+uint64_t obd_cache_ttl_us(const obd_cache_t *cache, uint8_t mode, uint8_t pid);
+
+/**
+ * Ask for a Mode/PID through the cache.
+ *
+ * @param out     Filled with the cached result on a hit
+ * @param out_id  The session request id to wait for (when pending)
+ * @return OBD_OK      — hit, `out` is filled, nothing was sent
+ *         OBD_PENDING — sent (or joined a request in flight); the result
+ *                       with id *out_id will come out of obd_cache_poll()
+ *         OBD_ERROR_BUSY if the session queue is full
+ */
+obd_result_t obd_cache_submit_pid(obd_cache_t *cache, obd_session_t *session,
+                                  uint8_t mode, uint8_t pid, uint64_t now_us,
+                                  obd_session_result_t *out, uint32_t *out_id);
+
+/** Same for any command text. AT commands pass straight through. */
+obd_result_t obd_cache_submit_command(obd_cache_t *cache, obd_session_t *session,
+                                      const char *command, uint64_t now_us,
+                                      obd_session_result_t *out, uint32_t *out_id);
+
+/**
+ * Check the cache without sending anything.
+ *
+ * @return OBD_OK      — hit, `out` is filled
+ *         OBD_PENDING — the same request is in flight; wait for *out_id
+ *         OBD_ERROR_NO_DATA — not cached (or an AT command): send it yourself
+ */
+obd_result_t obd_cache_lookup(obd_cache_t *cache, const char *command, uint64_t now_us,
+                              obd_session_result_t *out, uint32_t *out_id);
+
+/** obd_session_poll() + obd_cache_complete(). */
+obd_result_t obd_cache_poll(obd_cache_t *cache, obd_session_t *session,
+                            uint64_t now_us, obd_session_result_t *out);
+
+/**
+ * Record a finished result (store it if cacheable, end coalescing).
+ * Only needed if you poll the session yourself.
+ */
+obd_result_t obd_cache_complete(obd_cache_t *cache, const obd_session_result_t *result,
+                                uint64_t now_us);
+
+/**
+ * Store an answer you got some other way, e.g. one PID split out of a
+ * multi-PID reply. Follows the same TTL rules; errors aren't stored.
+ */
+obd_result_t obd_cache_store(obd_cache_t *cache, const char *command,
+                             const obd_session_result_t *result, uint64_t now_us);
+
+/** Forget one command's answer ("0902"), or everything with NULL. */
+obd_result_t obd_cache_invalidate(obd_cache_t *cache, const char *command);
+
+/** Copy the hit/miss counters. */
+obd_result_t obd_cache_get_stats(const obd_cache_t *cache, obd_cache_stats_t *out);
+
+/** Counters plus one line per cached entry. 4 KB is plenty. */
+obd_result_t obd_cache_format_text(const obd_cache_t *cache, uint64_t now_us,
+                                   char *out, size_t out_size);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,327 @@
+/**
+ * obd.hpp — C++17 facade over the C library (header-only).
+ *
+ * Two things the C API can't do:
+ *
+ *   1. Decode a PID that's known at compile time for free. A dashboard
+ *      that only ever shows RPM doesn't need obd_sensor_decode()'s table
+ *      search, function pointer and name/unit copies:
+ *
+ *        std::optional<float> rpm = obd::decode<0x0C>(r);   // r: obd_pid_response_t
+ *
+ *      compiles to a length check and ((A * 256) + B) / 4. An unknown
+ *      PID is a compile error, not OBD_ERROR_UNKNOWN_PID at run time.
+ *
+ *   2. Take std::string_view and std::span (obd::span in C++17, see
+ *      below) instead of NUL-terminated strings and pointer/size pairs.
+ *      Every parser has an overload:
+ *
+ *        obd::hex_to_bytes(text, bytes, &len)
+ *        obd::elm327_classify_response(text)
+ *        obd::elm327_clean_response(raw, out)
+ *        obd::pid_parse_response(text, &resp)
+ *        obd::dtc_parse_response(text, &list)
+ *        obd::vin_parse_response(text, vin)
+ *
+ *      hex_to_bytes, pid_parse_response and the sensor table are
+ *      constexpr, so a canned reply can be checked by static_assert (the
+ *      tests do that with tests/test_data.h). The others hand a
+ *      NUL-terminated copy to the C function. Either way it's the same
+ *      obd_result_t codes as the C calls.
+ *
+ * The constexpr sensor table mirrors the one in src/sensor.c;
+ * tests/test_obd_hpp.cpp checks every entry against the C library so
+ * the two can't drift apart unnoticed. The constexpr parsers don't feed
+ * the OBD_ENABLE_STATS counters.
+ */
+
+#ifndef OBD_HPP
+#define OBD_HPP
+
+#if __cplusplus < 201703L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#error "obd.hpp needs C++17"
+#endif
+
+#include <obd/obd.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#if (__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)) && \
+    __has_include(<span>)
+#include <span>
+#define OBD_HPP_STD_SPAN 1
+#endif
+
+namespace obd {
+
+/* ── span ────────────────────────────────────────────────────────────────
+ *
+ * std::span where the compiler has it. For C++17, just enough of one to
+ * take arrays, std::array and pointer + length, so the same calls work
+ * in both.
+ */
+#ifdef OBD_HPP_STD_SPAN
+template <class T>
+using span = std::span<T>;
+#else
+template <class T>
+class span {
+public:
+    constexpr span() noexcept = default;
+    constexpr span(T *data, std::size_t size) noexcept : data_(data), size_(size) {}
+    template <std::size_t N>
+    constexpr span(T (&a)[N]) noexcept : data_(a), size_(N) {}
+    template <class U, std::size_t N>
+    constexpr span(std::array<U, N> &a) noexcept : data_(a.data()), size_(N) {}
+    template <class U, std::size_t N>
+    constexpr span(const std::array<U, N> &a) noexcept : data_(a.data()), size_(N) {}
+
+    constexpr T *data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T &operator[](std::size_t i) const noexcept { return data_[i]; }
+    constexpr T *begin() const noexcept { return data_; }
+    constexpr T *end() const noexcept { return data_ + size_; }
+
+private:
+    T          *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+#endif
+
+
+/* ── Sensor table ────────────────────────────────────────────────────── */
+
+/* The formulas of src/sensor.c, by name instead of by function pointer */
+enum class formula : uint8_t {
+    dtc_count,          /* A & 0x7F */
+    percent,            /* A * 100 / 255 */
+    temp_offset40,      /* A - 40 */
+    fuel_trim,          /* (A - 128) * 100 / 128 */
+    fuel_pressure,      /* A * 3 */
+    direct,             /* A */
+    rpm,                /* ((A * 256) + B) / 4 */
+    timing_advance,     /* A / 2 - 64 */
+    maf,                /* ((A * 256) + B) / 100 */
+    o2_voltage,         /* A / 200 */
+    runtime,            /* (A * 256) + B */
+};
+
+struct sensor_info {
+    uint8_t          pid;
+    std::string_view name;
+    std::string_view unit;
+    uint8_t          byte_count;    /* Data bytes in the reply */
+    obd::formula     formula;
+};
+
+inline constexpr std::array<sensor_info, 16> sensors = {{
+    /* PID   Name                          Unit     Bytes  Formula */
+    { 0x01, "DTC Count",                  "",       4,    formula::dtc_count },
+    { 0x04, "Engine Load",                "%",      1,    formula::percent },
+    { 0x05, "Coolant Temperature",        "C",      1,    formula::temp_offset40 },
+    { 0x06, "Short Term Fuel Trim B1",    "%",      1,    formula::fuel_trim },
+    { 0x07, "Long Term Fuel Trim B1",     "%",      1,    formula::fuel_trim },
+    { 0x0A, "Fuel Pressure",              "kPa",    1,    formula::fuel_pressure },
+    { 0x0B, "Intake Manifold Pressure",   "kPa",    1,    formula::direct },
+    { 0x0C, "Engine RPM",                 "rpm",    2,    formula::rpm },
+    { 0x0D, "Vehicle Speed",              "km/h",   1,    formula::direct },
+    { 0x0E, "Timing Advance",             "deg",    1,    formula::timing_advance },
+    { 0x0F, "Intake Air Temperature",     "C",      1,    formula::temp_offset40 },
+    { 0x10, "MAF Air Flow Rate",          "g/s",    2,    formula::maf },
+    { 0x11, "Throttle Position",          "%",      1,    formula::percent },
+    { 0x14, "O2 Sensor 1 Voltage",        "V",      1,    formula::o2_voltage },
+    { 0x1F, "Run Time Since Start",       "sec",    2,    formula::runtime },
+    { 0x33, "Barometric Pressure",        "kPa",    1,    formula::direct },
+}};
+
+/* Where a PID is in the table, or sensors.size() */
+constexpr std::size_t find_index(uint8_t pid) noexcept
+{
+    for (std::size_t i = 0; i < sensors.size(); i++) {
+        if (sensors[i].pid == pid) return i;
+    }
+    return sensors.size();
+}
+
+/* The table entry for a PID, or nullptr */
+constexpr const sensor_info *find_sensor(uint8_t pid) noexcept
+{
+    std::size_t i = find_index(pid);
+
+    return i < sensors.size() ? &sensors[i] : nullptr;
+}
+
+/* One formula on the data bytes A, B, ... (enough of them: caller checks).
+ * Same float operations in the same order as sensor.c, so the results
+ * match bit for bit. */
+constexpr float apply(formula f, const uint8_t *d) noexcept
+{
+    switch (f) {
+    case formula::dtc_count:      return (float)(d[0] & 0x7F);
+    case formula::percent:        return (float)d[0] * 100.0f / 255.0f;
+    case formula::temp_offset40:  return (float)d[0] - 40.0f;
+    case formula::fuel_trim:      return ((float)d[0] - 128.0f) * 100.0f / 128.0f;
+    case formula::fuel_pressure:  return (float)d[0] * 3.0f;
+    case formula::direct:         return (float)d[0];
+    case formula::rpm:            return ((float)d[0] * 256.0f + (float)d[1]) / 4.0f;
+    case formula::timing_advance: return (float)d[0] / 2.0f - 64.0f;
+    case formula::maf:            return ((float)d[0] * 256.0f + (float)d[1]) / 100.0f;
+    case formula::o2_voltage:     return (float)d[0] / 200.0f;
+    case formula::runtime:        return (float)d[0] * 256.0f + (float)d[1];
+    }
+    return 0.0f;
+}
+
+
+/* ── Decoding ────────────────────────────────────────────────────────── */
+
+/*
+ * decode<0x0C>(data): the PID's value from its data bytes (A, B, ...),
+ * or nothing if there are too few. The PID must be in the table.
+ */
+template <uint8_t PID>
+constexpr std::optional<float> decode(span<const uint8_t> data) noexcept
+{
+    /* An index, not a pointer: GCC won't fold a pointer comparison in a
+     * static_assert under -fsanitize=undefined */
+    constexpr std::size_t index = find_index(PID);
+    static_assert(index < sensors.size(), "PID not in the sensor table");
+    constexpr const sensor_info &info = sensors[index];
+
+    if (data.size() < info.byte_count) return std::nullopt;
+    return apply(info.formula, data.data());
+}
+
+/* decode<0x0C>(resp) straight from obd_pid_response_t; the PID must match */
+template <uint8_t PID>
+constexpr std::optional<float> decode(const obd_pid_response_t &resp) noexcept
+{
+    if (resp.pid != PID) return std::nullopt;
+    return decode<PID>(span<const uint8_t>(resp.data, resp.data_len));
+}
+
+/* The run-time version, for a PID only known then: obd_sensor_decode()
+ * without the name and unit */
+constexpr std::optional<float> decode(uint8_t pid, span<const uint8_t> data) noexcept
+{
+    const sensor_info *info = find_sensor(pid);
+
+    if (!info || data.size() < info->byte_count) return std::nullopt;
+    return apply(info->formula, data.data());
+}
+
+constexpr std::optional<float> decode(const obd_pid_response_t &resp) noexcept
+{
+    return decode(resp.pid, span<const uint8_t>(resp.data, resp.data_len));
+}
+
+
+/* ── Parsers ─────────────────────────────────────────────────────────── */
+
+/* obd_hex_to_bytes(), constexpr: "41 0C 1A F8" → {0x41, 0x0C, 0x1A, 0xF8} */
+constexpr obd_result_t hex_to_bytes(std::string_view hex, span<uint8_t> out,
+                                    std::size_t *out_len) noexcept
+{
+    std::size_t o = 0;
+
+    if (!out_len) return OBD_ERROR_INVALID_ARG;
+
+    for (std::size_t i = 0; i < hex.size();) {
+        char c = hex[i];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            i++;
+            continue;
+        }
+        if (i + 1 >= hex.size()) return OBD_ERROR_INVALID_HEX;   /* Trailing nibble */
+
+        int n[2] = { -1, -1 };
+        for (int k = 0; k < 2; k++) {
+            c = hex[i + (std::size_t)k];
+            if (c >= '0' && c <= '9') n[k] = c - '0';
+            else if (c >= 'A' && c <= 'F') n[k] = c - 'A' + 10;
+            else if (c >= 'a' && c <= 'f') n[k] = c - 'a' + 10;
+        }
+        if (n[0] < 0 || n[1] < 0) return OBD_ERROR_INVALID_HEX;
+        if (o >= out.size()) return OBD_ERROR_BUFFER_TOO_SMALL;
+        out[o++] = (uint8_t)((n[0] << 4) | n[1]);
+        i += 2;
+    }
+
+    *out_len = o;
+    return OBD_OK;
+}
+
+/* obd_pid_parse_response(), constexpr */
+constexpr obd_result_t pid_parse_response(std::string_view response,
+                                          obd_pid_response_t *out) noexcept
+{
+    uint8_t bytes[2 + OBD_MAX_DATA_BYTES] = {};
+    std::size_t count = 0;
+
+    if (!out) return OBD_ERROR_INVALID_ARG;
+
+    obd_result_t r = hex_to_bytes(response, bytes, &count);
+    if (r != OBD_OK) return r;
+    if (count < 2) return OBD_ERROR_PARSE_FAILED;
+
+    *out = obd_pid_response_t{};
+    out->mode = bytes[0];
+    out->pid = bytes[1];
+    out->data_len = count - 2;
+    for (std::size_t i = 0; i < out->data_len; i++) out->data[i] = bytes[2 + i];
+    return OBD_OK;
+}
+
+namespace detail {
+
+/* A NUL-terminated copy of a view, for the C parsers. Adapter output
+ * longer than this is no reply the library would accept anyway. */
+struct c_string {
+    char buf[OBD_MAX_RESPONSE_LEN];
+    bool fits;
+
+    explicit c_string(std::string_view s) noexcept : fits(s.size() < sizeof(buf))
+    {
+        std::size_t n = fits ? s.size() : 0;
+        s.copy(buf, n);
+        buf[n] = '\0';
+    }
+};
+
+} /* namespace detail */
+
+inline obd_elm_response_type_t elm327_classify_response(std::string_view response) noexcept
+{
+    detail::c_string s(response);
+    return s.fits ? obd_elm327_classify_response(s.buf) : OBD_ELM_RESPONSE_UNKNOWN;
+}
+
+inline obd_result_t elm327_clean_response(std::string_view raw, span<char> out) noexcept
+{
+    detail::c_string s(raw);
+    if (!s.fits) return OBD_ERROR_BUFFER_TOO_SMALL;
+    return obd_elm327_clean_response(s.buf, out.data(), out.size());
+}
+
+inline obd_result_t dtc_parse_response(std::string_view response, obd_dtc_list_t *out) noexcept
+{
+    detail::c_string s(response);
+    if (!s.fits) return OBD_ERROR_BUFFER_TOO_SMALL;
+    return obd_dtc_parse_response(s.buf, out);
+}
+
+inline obd_result_t vin_parse_response(std::string_view response, span<char> vin) noexcept
+{
+    detail::c_string s(response);
+    if (!s.fits) return OBD_ERROR_BUFFER_TOO_SMALL;
+    return obd_vin_parse_response(s.buf, vin.data(), vin.size());
+}
+
+} /* namespace obd */
+
+#endif /* OBD_HPP */
@@ -0,0 +1,823 @@
+/**
+ * obd_async.hpp — C++20 coroutines over the fleet loop (header-only).
+ *
+ * The fleet (obd_io.h) drives thousands of adapter sessions from one
+ * thread, but it speaks callbacks: submit here, get on_result() there,
+ * match them up by request id yourself. This header lets a C++20
+ * service write the same thing top to bottom:
+ *
+ *   obd::task<> check(obd::vehicle car)
+ *   {
+ *       obd_session_result_t rpm = co_await car.query(0x0C);
+ *       obd::dtc_result dtcs     = co_await car.read_dtcs();
+ *       obd::vin_result vin      = co_await car.read_vin();
+ *       ...
+ *   }
+ *
+ *   obd::executor ex;
+ *   ex.open(1000, OBD_FLEET_URING);        slots for 1000 vehicles
+ *   obd::vehicle car;
+ *   ex.add(fd, &car);                      per adapter fd
+ *   ex.spawn(check(car));
+ *   ex.run();                              until every spawned task is done
+ *
+ * Nothing is allocated per await. An awaiter lives in its coroutine's
+ * frame and goes on intrusive lists; coroutine frames come from a
+ * per-thread pool of size classes, so after warm-up a task costs no
+ * trip to the heap either. A thousand vehicles with a task each is a
+ * thousand pooled frames plus the fleet's slots.
+ *
+ * Errors are values, as in the C library: every result carries an
+ * obd_result_t status. Cancellation and timeouts follow the ELM327 (see
+ * obd_session_cancel()): a request still queued is dropped unsent; one
+ * already written is given up on and its late reply drained.
+ *
+ *   query(pid, {timeout_us, &stop_token})
+ *       timeout_us   give up after this long → OBD_ERROR_TIMEOUT
+ *                    (0 = just the session's own timeout)
+ *       stop_token   request_stop() → OBD_ERROR_CANCELLED
+ *
+ * Single-threaded: the executor, its tasks and request_stop() calls all
+ * belong to one thread. For more cores, run one executor per thread
+ * over a share of the vehicles, like fleets. Linux only. See
+ * docs/17-async-explained.txt.
+ */
+
+#ifndef OBD_ASYNC_HPP
+#define OBD_ASYNC_HPP
+
+#if __cplusplus < 202002L
+#error "obd_async.hpp needs C++20 (coroutines)"
+#endif
+#if !defined(__linux__)
+#error "obd_async.hpp runs on the fleet loop, which is Linux only"
+#endif
+
+#include <obd/obd.h>
+#include <obd/obd_io.h>
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <optional>
+#include <stop_token>
+#include <utility>
+#include <vector>
+
+namespace obd {
+
+class executor;
+class vehicle;
+
+/*
+ * Per-request knobs. The request takes its own copy of *stop, so the
+ * pointer only has to be good for the call. (A pointer, not a token, to
+ * keep options trivially destructible: GCC 12 destroys non-trivial
+ * temporaries in a co_await operand twice.)
+ */
+struct options {
+    uint64_t               timeout_us = 0;    /* 0 = the session's timeout only */
+    const std::stop_token *stop = nullptr;
+};
+
+/* read_dtcs(): Mode 03 */
+struct dtc_result {
+    obd_result_t   status = OBD_OK;
+    obd_dtc_list_t dtcs{};
+};
+
+/* read_vin(): Mode 09 PID 02 */
+struct vin_result {
+    obd_result_t status = OBD_OK;
+    char         vin[OBD_VIN_LENGTH + 1] = {};
+};
+
+
+/* ── Frame pool ──────────────────────────────────────────────────────── */
+
+namespace detail {
+
+/*
+ * Coroutine frames by size class, 64-byte steps up to 4 KB. A freed
+ * frame goes on its class's free list and the next coroutine of about
+ * the same size reuses it. Per thread, so no locks; blocks go back to
+ * the system when the thread exits.
+ */
+class frame_pool {
+public:
+    static void *allocate(std::size_t size)
+    {
+        lists &l = get();
+        std::size_t c = size_class(size);
+
+        if (c >= classes) {
+            l.from_system++;
+            return ::operator new(size);
+        }
+        if (block *b = l.head[c]) {
+            l.head[c] = b->next;
+            return b;
+        }
+        l.from_system++;
+        return ::operator new((c + 1) * granule);
+    }
+
+    static void deallocate(void *p, std::size_t size) noexcept
+    {
+        lists &l = get();
+        std::size_t c = size_class(size);
+
+        if (c >= classes) {
+            ::operator delete(p);
+            return;
+        }
+        block *b = static_cast<block *>(p);
+        b->next = l.head[c];
+        l.head[c] = b;
+    }
+
+    /* Frames that had to come from operator new, on this thread */
+    static std::size_t system_allocations() { return get().from_system; }
+
+private:
+    static constexpr std::size_t granule = 64;
+    static constexpr std::size_t classes = 64;
+
+    struct block { block *next; };
+
+    struct lists {
+        block      *head[classes] = {};
+        std::size_t from_system = 0;
+
+        ~lists()
+        {
+            for (block *&h : head) {
+                while (h) {
+                    block *next = h->next;
+                    ::operator delete(h);
+                    h = next;
+                }
+            }
+        }
+    };
+
+    static std::size_t size_class(std::size_t size) { return (size + granule - 1) / granule - 1; }
+    static lists &get()
+    {
+        thread_local lists l;
+        return l;
+    }
+};
+
+struct promise_base {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr      error;
+
+    static void *operator new(std::size_t size) { return frame_pool::allocate(size); }
+    static void operator delete(void *p, std::size_t size) noexcept
+    {
+        frame_pool::deallocate(p, size);
+    }
+
+    /* Lazy: a task starts when it's awaited (or spawned) */
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    /* When done, go straight back to whoever awaited us */
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        template <class P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            return h.promise().continuation;
+        }
+        void await_resume() noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+template <class T>
+struct task_promise;
+
+} /* namespace detail */
+
+
+/* ── task<T> ─────────────────────────────────────────────────────────── */
+
+/*
+ * A coroutine returning T. Lazy and awaitable exactly once:
+ *   T value = co_await some_task();
+ */
+template <class T = void>
+class [[nodiscard]] task {
+public:
+    using promise_type = detail::task_promise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    task() noexcept = default;
+    explicit task(handle_type h) noexcept : h_(h) {}
+    task(task &&other) noexcept : h_(std::exchange(other.h_, {})) {}
+    task &operator=(task &&other) noexcept
+    {
+        if (this != &other) {
+            if (h_) h_.destroy();
+            h_ = std::exchange(other.h_, {});
+        }
+        return *this;
+    }
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+    ~task()
+    {
+        if (h_) h_.destroy();
+    }
+
+    auto operator co_await() noexcept
+    {
+        struct awaiter {
+            handle_type h;
+
+            bool await_ready() noexcept { return !h || h.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+            {
+                h.promise().continuation = caller;
+                return h;                   /* Symmetric transfer: no stack growth */
+            }
+            T await_resume() { return h.promise().result(); }
+        };
+        return awaiter{h_};
+    }
+
+private:
+    handle_type h_;
+};
+
+namespace detail {
+
+template <class T>
+struct task_promise : promise_base {
+    std::optional<T> value;
+
+    task<T> get_return_object() noexcept
+    {
+        return task<T>(std::coroutine_handle<task_promise>::from_promise(*this));
+    }
+    template <class U>
+    void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+
+    T result()
+    {
+        if (error) std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct task_promise<void> : promise_base {
+    task<void> get_return_object() noexcept
+    {
+        return task<void>(std::coroutine_handle<task_promise>::from_promise(*this));
+    }
+    void return_void() noexcept {}
+
+    void result()
+    {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+
+/* ── What the executor resumes ───────────────────────────────────────── */
+
+/* A suspended await: on the ready list once it can go on */
+class waiter {
+public:
+    waiter(const waiter &) = delete;
+    waiter &operator=(const waiter &) = delete;
+
+    /* Its deadline on the executor's wheel has passed */
+    virtual void expired() = 0;
+
+protected:
+    explicit waiter(executor &ex) noexcept : ex_(&ex) {}
+    ~waiter();
+
+    executor               *ex_;
+    std::coroutine_handle<> handle_;
+
+private:
+    friend class obd::executor;
+    waiter *ready_prev_ = nullptr;
+    waiter *ready_next_ = nullptr;
+    bool    ready_ = false;
+};
+
+/* A timer on the executor's wheel; `timer` first, so the wheel's
+ * obd_timer_t * converts back */
+struct deadline {
+    obd_timer_t timer;
+    waiter     *owner;
+};
+
+/*
+ * One request on one vehicle, from submit to result. The awaiters the
+ * vehicle hands out (query, read_dtcs, read_vin) are this plus a way
+ * to turn the session result into what the caller asked for.
+ */
+class request : public waiter {
+public:
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h);
+
+protected:
+    request(executor &ex, std::size_t index, uint8_t mode, uint8_t pid, const char *command,
+            const options &opt) noexcept;
+    ~request();
+
+    obd_session_result_t result_;
+
+private:
+    friend class obd::executor;
+
+    struct on_stop {
+        request *r;
+        void operator()() const noexcept { r->withdraw(OBD_ERROR_CANCELLED); }
+    };
+
+    void expired() override { withdraw(OBD_ERROR_TIMEOUT); }
+    void withdraw(obd_result_t why);
+    void finish(const obd_session_result_t *res, obd_result_t status);
+
+    std::size_t     index_;
+    uint8_t         mode_;              /* 0 = send command_ */
+    uint8_t         pid_;
+    char            command_[OBD_MAX_COMMAND_LEN];
+    uint64_t        timeout_us_;
+    std::stop_token stop_;
+    uint32_t        id_ = 0;
+    obd_result_t    why_ = OBD_OK;      /* Set when we gave up on it ourselves */
+    bool            linked_ = false;
+    request        *prev_ = nullptr;    /* On its vehicle's list */
+    request        *next_ = nullptr;
+    deadline        deadline_;
+    std::optional<std::stop_callback<on_stop>> stop_cb_;
+};
+
+struct spawn_promise;
+
+} /* namespace detail */
+
+
+/* ── Awaitables ──────────────────────────────────────────────────────── */
+
+/* co_await car.query(pid) → obd_session_result_t (value decoded if known) */
+class query_op : public detail::request {
+public:
+    query_op(executor &ex, std::size_t index, uint8_t mode, uint8_t pid, const options &opt)
+        : request(ex, index, mode, pid, nullptr, opt) {}
+    obd_session_result_t await_resume() const noexcept { return result_; }
+};
+
+/* co_await car.command("ATRV") → obd_session_result_t, reply text in .response */
+class command_op : public detail::request {
+public:
+    command_op(executor &ex, std::size_t index, const char *command, const options &opt)
+        : request(ex, index, 0, 0, command, opt) {}
+    obd_session_result_t await_resume() const noexcept { return result_; }
+};
+
+/* co_await car.read_dtcs() → dtc_result */
+class dtc_op : public detail::request {
+public:
+    dtc_op(executor &ex, std::size_t index, const options &opt)
+        : request(ex, index, 0, 0, "03", opt) {}
+    dtc_result await_resume() const noexcept
+    {
+        dtc_result out;
+        out.status = result_.status;
+        if (out.status == OBD_OK) out.status = obd_dtc_parse_response(result_.response, &out.dtcs);
+        return out;
+    }
+};
+
+/* co_await car.read_vin() → vin_result */
+class vin_op : public detail::request {
+public:
+    vin_op(executor &ex, std::size_t index, const options &opt)
+        : request(ex, index, 0, 0, "0902", opt) {}
+    vin_result await_resume() const noexcept
+    {
+        vin_result out;
+        out.status = result_.status;
+        if (out.status == OBD_OK) {
+            out.status = obd_vin_parse_response(result_.response, out.vin, sizeof(out.vin));
+        }
+        return out;
+    }
+};
+
+/* co_await ex.sleep_for(us) */
+class sleep_op : public detail::waiter {
+public:
+    sleep_op(executor &ex, uint64_t us) noexcept : waiter(ex), us_(us)
+    {
+        obd_timer_init(&deadline_.timer);
+        deadline_.owner = this;
+    }
+    ~sleep_op();
+
+    bool await_ready() const noexcept { return us_ == 0; }
+    void await_suspend(std::coroutine_handle<> h);
+    void await_resume() const noexcept {}
+
+private:
+    void expired() override;
+
+    uint64_t         us_;
+    detail::deadline deadline_;
+};
+
+
+/* ── Vehicle ─────────────────────────────────────────────────────────── */
+
+/* A handle on one fleet slot: cheap to copy, valid until remove() */
+class vehicle {
+public:
+    vehicle() noexcept = default;
+
+    query_op query(uint8_t pid, const options &opt = {}) const
+    {
+        return query_op(*ex_, index_, 0x01, pid, opt);
+    }
+    query_op query(uint8_t mode, uint8_t pid, const options &opt = {}) const
+    {
+        return query_op(*ex_, index_, mode, pid, opt);
+    }
+    command_op command(const char *text, const options &opt = {}) const
+    {
+        return command_op(*ex_, index_, text, opt);
+    }
+    dtc_op read_dtcs(const options &opt = {}) const { return dtc_op(*ex_, index_, opt); }
+    vin_op read_vin(const options &opt = {}) const { return vin_op(*ex_, index_, opt); }
+
+    std::size_t index() const noexcept { return index_; }
+    obd_session_t *session() const;
+
+private:
+    friend class executor;
+    vehicle(executor *ex, std::size_t index) noexcept : ex_(ex), index_(index) {}
+
+    executor   *ex_ = nullptr;
+    std::size_t index_ = 0;
+};
+
+
+/* ── Executor ────────────────────────────────────────────────────────── */
+
+/*
+ * One thread's event loop: a fleet for the vehicles, a timer wheel for
+ * per-request timeouts and sleeps, and the list of coroutines ready to
+ * go on. Resuming only ever happens from step(), never from inside the
+ * fleet's callback.
+ */
+class executor {
+public:
+    executor() noexcept { fleet_.epoll_fd = -1; }
+    executor(const executor &) = delete;
+    executor &operator=(const executor &) = delete;
+    ~executor() { close(); }
+
+    /** Room for `capacity` vehicles; the backend as obd_fleet_set_backend(). */
+    obd_result_t open(std::size_t capacity, obd_fleet_backend_t backend = OBD_FLEET_EPOLL)
+    {
+        obd_result_t r;
+
+        if (capacity == 0) return OBD_ERROR_INVALID_ARG;
+        slots_.assign(capacity, obd_fleet_adapter_t{});
+        waiting_.assign(capacity, nullptr);
+        r = obd_fleet_init(&fleet_, slots_.data(), capacity, &executor::on_result, this);
+        if (r == OBD_OK) r = obd_fleet_set_backend(&fleet_, backend);
+        obd_wheel_init(&wheel_, 1000, obd_io_now_us());
+        return r;
+    }
+
+    /** Start driving a non-blocking adapter fd (you still own it). */
+    obd_result_t add(int fd, vehicle *out)
+    {
+        std::size_t index;
+        obd_result_t r = obd_fleet_add(&fleet_, fd, &index);
+
+        if (r == OBD_OK && out) *out = vehicle(this, index);
+        return r;
+    }
+
+    /** Stop driving it; requests still waiting finish with OBD_ERROR_IO. */
+    obd_result_t remove(vehicle v)
+    {
+        if (v.ex_ != this || v.index_ >= waiting_.size()) return OBD_ERROR_INVALID_ARG;
+        fail_all(v.index_, OBD_ERROR_IO);
+        return obd_fleet_remove(&fleet_, v.index_);
+    }
+
+    /** Run a task to completion in the background; it starts right away. */
+    void spawn(task<void> t);
+
+    /** co_await ex.sleep_for(500000): half a second, no thread blocked. */
+    sleep_op sleep_for(uint64_t us) noexcept { return sleep_op(*this, us); }
+
+    /**
+     * One round: wait up to timeout_ms for I/O or a deadline, then resume
+     * every coroutine that can go on.
+     */
+    obd_result_t step(int timeout_ms)
+    {
+        obd_result_t r;
+
+        if (ready_head_) {
+            timeout_ms = 0;
+        } else if (uint64_t next = obd_wheel_next_expiry(&wheel_)) {
+            uint64_t now = obd_io_now_us();
+            uint64_t wait_ms = next > now ? (next - now + 999) / 1000 : 0;
+            if (timeout_ms < 0 || wait_ms < static_cast<uint64_t>(timeout_ms)) {
+                timeout_ms = static_cast<int>(wait_ms);
+            }
+        }
+
+        r = obd_fleet_step(&fleet_, timeout_ms);
+        if (r != OBD_OK) return r;
+
+        uint64_t now = obd_io_now_us();
+        while (obd_timer_t *t = obd_wheel_expire(&wheel_, now)) {
+            reinterpret_cast<detail::deadline *>(t)->owner->expired();
+        }
+        while (detail::waiter *w = ready_head_) {
+            unready(*w);
+            w->handle_.resume();
+        }
+        return OBD_OK;
+    }
+
+    /** step() until every spawned task has finished. */
+    obd_result_t run()
+    {
+        while (live_ > 0) {
+            obd_result_t r = step(-1);
+            if (r != OBD_OK) return r;
+        }
+        return OBD_OK;
+    }
+
+    /** Destroy unfinished tasks, stop driving every vehicle. */
+    void close()
+    {
+        while (ready_head_) unready(*ready_head_);
+        while (spawned_) destroy_spawned();
+        obd_fleet_close(&fleet_);
+    }
+
+    std::size_t live_tasks() const noexcept { return live_; }
+    obd_fleet_t &fleet() noexcept { return fleet_; }
+    obd_fleet_backend_t backend() const noexcept { return obd_fleet_backend(&fleet_); }
+
+private:
+    friend class detail::waiter;
+    friend class detail::request;
+    friend struct detail::spawn_promise;
+    friend class sleep_op;
+    friend class vehicle;
+
+    static void on_result(void *ctx, std::size_t index, const obd_session_result_t *res)
+    {
+        executor *ex = static_cast<executor *>(ctx);
+
+        if (res->id == 0 && res->status == OBD_ERROR_IO) {
+            ex->fail_all(index, OBD_ERROR_IO);   /* The adapter went away */
+            return;
+        }
+        for (detail::request *r = ex->waiting_[index]; r; r = r->next_) {
+            if (r->id_ == res->id) {
+                r->finish(res, res->status);
+                return;
+            }
+        }
+    }
+
+    void fail_all(std::size_t index, obd_result_t status)
+    {
+        while (detail::request *r = waiting_[index]) r->finish(nullptr, status);
+    }
+
+    void link(detail::request &r)
+    {
+        r.prev_ = nullptr;
+        r.next_ = waiting_[r.index_];
+        if (r.next_) r.next_->prev_ = &r;
+        waiting_[r.index_] = &r;
+        r.linked_ = true;
+    }
+
+    void unlink(detail::request &r)
+    {
+        if (!r.linked_) return;
+        if (r.prev_) r.prev_->next_ = r.next_;
+        else waiting_[r.index_] = r.next_;
+        if (r.next_) r.next_->prev_ = r.prev_;
+        r.prev_ = r.next_ = nullptr;
+        r.linked_ = false;
+    }
+
+    void make_ready(detail::waiter &w)
+    {
+        if (w.ready_) return;
+        w.ready_prev_ = ready_tail_;
+        w.ready_next_ = nullptr;
+        if (ready_tail_) ready_tail_->ready_next_ = &w;
+        else ready_head_ = &w;
+        ready_tail_ = &w;
+        w.ready_ = true;
+    }
+
+    void unready(detail::waiter &w)
+    {
+        if (!w.ready_) return;
+        if (w.ready_prev_) w.ready_prev_->ready_next_ = w.ready_next_;
+        else ready_head_ = w.ready_next_;
+        if (w.ready_next_) w.ready_next_->ready_prev_ = w.ready_prev_;
+        else ready_tail_ = w.ready_prev_;
+        w.ready_prev_ = w.ready_next_ = nullptr;
+        w.ready_ = false;
+    }
+
+    void schedule(detail::deadline &d, uint64_t at) { obd_wheel_schedule(&wheel_, &d.timer, at); }
+    void cancel(detail::deadline &d) { obd_wheel_cancel(&wheel_, &d.timer); }
+
+    void destroy_spawned();
+
+    obd_fleet_t                      fleet_{};
+    obd_wheel_t                      wheel_{};
+    std::vector<obd_fleet_adapter_t> slots_;
+    std::vector<detail::request *>   waiting_;      /* Per vehicle: requests awaited */
+    detail::waiter                  *ready_head_ = nullptr;
+    detail::waiter                  *ready_tail_ = nullptr;
+    detail::spawn_promise           *spawned_ = nullptr;   /* Running spawned tasks */
+    std::size_t                      live_ = 0;
+};
+
+
+/* ── Out-of-line parts (they need the executor) ──────────────────────── */
+
+namespace detail {
+
+inline waiter::~waiter() { ex_->unready(*this); }
+
+inline request::request(executor &ex, std::size_t index, uint8_t mode, uint8_t pid,
+                        const char *command, const options &opt) noexcept
+    : waiter(ex), index_(index), mode_(mode), pid_(pid), timeout_us_(opt.timeout_us)
+{
+    std::memset(&result_, 0, sizeof(result_));
+    result_.mode = mode;
+    result_.pid = pid;
+    command_[0] = '\0';
+    if (command) {
+        std::size_t len = std::strlen(command);
+        if (len >= sizeof(command_)) len = sizeof(command_) - 1;   /* Session says too long */
+        std::memcpy(command_, command, len);
+        command_[len] = '\0';
+    }
+    if (opt.stop) stop_ = *opt.stop;
+    obd_timer_init(&deadline_.timer);
+    deadline_.owner = this;
+}
+
+inline request::~request()
+{
+    /* Abandoned mid-await (its coroutine was destroyed): withdraw quietly */
+    if (linked_) {
+        ex_->unlink(*this);
+        ex_->cancel(deadline_);
+        obd_fleet_cancel(&ex_->fleet_, index_, id_, obd_io_now_us());
+    }
+}
+
+inline bool request::await_suspend(std::coroutine_handle<> h)
+{
+    uint64_t now = obd_io_now_us();
+    obd_result_t r;
+
+    handle_ = h;
+    if (stop_.stop_requested()) {
+        result_.status = OBD_ERROR_CANCELLED;
+        return false;
+    }
+    r = mode_ ? obd_fleet_submit_pid(&ex_->fleet_, index_, mode_, pid_, now, &id_)
+              : obd_fleet_submit_command(&ex_->fleet_, index_, command_, now, &id_);
+    if (r == OBD_OK && ex_->fleet_.adapters[index_].state != OBD_FLEET_OPEN) {
+        r = OBD_ERROR_IO;               /* Lost while writing it */
+    }
+    if (r != OBD_OK) {
+        result_.status = r;             /* BUSY (16 queued), IO, bad command... */
+        return false;
+    }
+
+    ex_->link(*this);
+    if (timeout_us_) ex_->schedule(deadline_, now + timeout_us_);
+    if (stop_.stop_possible()) stop_cb_.emplace(stop_, on_stop{this});
+    return true;
+}
+
+/* Timeout or stop: take it back from the session, report `why` */
+inline void request::withdraw(obd_result_t why)
+{
+    if (!linked_) return;
+    why_ = why;
+    /* In flight: the cancelled result comes straight back through on_result() */
+    obd_fleet_cancel(&ex_->fleet_, index_, id_, obd_io_now_us());
+    if (linked_) finish(nullptr, why);
+}
+
+inline void request::finish(const obd_session_result_t *res, obd_result_t status)
+{
+    ex_->unlink(*this);
+    ex_->cancel(deadline_);
+    if (res) result_ = *res;
+    result_.status = why_ != OBD_OK ? why_ : status;
+    ex_->make_ready(*this);
+}
+
+/* The coroutine behind executor::spawn(): owns the task, counts itself */
+struct detached {
+    using promise_type = spawn_promise;
+};
+
+struct spawn_promise {
+    executor      *ex;
+    spawn_promise *prev = nullptr;      /* On the executor's list of running tasks */
+    spawn_promise *next = nullptr;
+
+    spawn_promise(executor &e, task<void> &) noexcept : ex(&e)
+    {
+        next = ex->spawned_;
+        if (next) next->prev = this;
+        ex->spawned_ = this;
+        ex->live_++;
+    }
+    ~spawn_promise()
+    {
+        if (prev) prev->next = next;
+        else ex->spawned_ = next;
+        if (next) next->prev = prev;
+        ex->live_--;
+    }
+
+    static void *operator new(std::size_t size) { return frame_pool::allocate(size); }
+    static void operator delete(void *p, std::size_t size) noexcept
+    {
+        frame_pool::deallocate(p, size);
+    }
+
+    detached get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }   /* Frees itself */
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }   /* Nobody to tell */
+};
+
+inline detached run_spawned(executor &, task<void> t)
+{
+    co_await t;
+}
+
+} /* namespace detail */
+
+inline sleep_op::~sleep_op() { ex_->cancel(deadline_); }
+
+inline void sleep_op::await_suspend(std::coroutine_handle<> h)
+{
+    handle_ = h;
+    ex_->schedule(deadline_, obd_io_now_us() + us_);
+}
+
+inline void sleep_op::expired() { ex_->make_ready(*this); }
+
+inline obd_session_t *vehicle::session() const
+{
+    return ex_ ? obd_fleet_session(&ex_->fleet_, index_) : nullptr;
+}
+
+inline void executor::spawn(task<void> t)
+{
+    detail::run_spawned(*this, std::move(t));
+}
+
+inline void executor::destroy_spawned()
+{
+    std::coroutine_handle<detail::spawn_promise>::from_promise(*spawned_).destroy();
+}
+
+} /* namespace obd */
+
+#endif /* OBD_ASYNC_HPP */
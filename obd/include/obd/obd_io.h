@@ -0,0 +1,785 @@
+/**
+ * obd_io.h — The POSIX side of the library: an ELM327 emulator, socket
+ * helpers and the adapter multiplexer.
+ *
+ * The core library (obd.h) never touches a file descriptor. This one
+ * does: it's built as a separate library, obd_io, on Linux/macOS only,
+ * for gateways and test rigs that run the session layer against real
+ * sockets and serial ports.
+ *
+ *   obd_emu_t   a pretend ELM327 + car, pure logic: bytes in, bytes out
+ *   obd_net_*   listen/connect on TCP and Unix sockets
+ *   obd_mux_t   one adapter shared by many clients (see obd_muxd)
+ *   obd_pty_*   pseudo-terminal pairs, for emulated serial adapters
+ *   obd_wheel_t a timer wheel for thousands of session timeouts
+ *   obd_fleet_t many adapters on one thread (Linux: epoll or io_uring)
+ *   obd_blackbox_t a crash-safe recorder of the last minutes of traffic
+ *   obd_journal_t  an append-only log with group commit, for trip files
+ */
+
+#ifndef OBD_IO_H
+#define OBD_IO_H
+
+#include <obd/obd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Types
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/* ── ELM327 emulator ─────────────────────────────────────────────────────
+ *
+ * Answers like an ELM327 v1.5 on a CAN car: AT settings (echo, linefeeds,
+ * spaces, headers), Mode 01 PIDs (up to 6 per request, supported-PID
+ * bitmaps computed from what's set), Mode 03/04 DTCs and the Mode 09 VIN.
+ * Everything else gets "NO DATA" or "?".
+ */
+#define OBD_EMU_LINE_LEN    64
+#define OBD_EMU_MAX_DTCS    16
+
+typedef struct {
+    uint8_t supported;
+    uint8_t len;                        /* 1–4 data bytes */
+    uint8_t data[4];
+} obd_emu_pid_t;
+
+typedef struct {
+    uint8_t       echo;                 /* ATE: repeat each command back */
+    uint8_t       linefeeds;            /* ATL: end lines with \r\n */
+    uint8_t       headers;              /* ATH: prefix "7E8 04" */
+    uint8_t       spaces;               /* ATS: "41 0C" vs "410C" */
+    uint16_t      ecu_id;               /* CAN id shown with headers on */
+    char          line[OBD_EMU_LINE_LEN];
+    size_t        line_len;
+    char          last[OBD_EMU_LINE_LEN];       /* An empty line repeats it */
+    obd_emu_pid_t pids[256];            /* Mode 01 values */
+    char          vin[OBD_VIN_LENGTH + 1];
+    uint16_t      dtcs[OBD_EMU_MAX_DTCS];       /* Raw 2-byte codes, 0x0301 = P0301 */
+    size_t        dtc_count;
+    uint64_t      commands;             /* Lines answered */
+    uint64_t      obd_requests;         /* OBD requests that reached the "car" */
+    char          last_obd[OBD_EMU_LINE_LEN];   /* The latest one, normalized */
+} obd_emu_t;
+
+
+/* ── Multiplexer ─────────────────────────────────────────────────────────
+ *
+ * One adapter, many clients. Each client sees its own ELM327: its AT
+ * settings are virtual, its OBD requests go through a shared session and
+ * response cache. See docs/15-mux-explained.txt.
+ */
+#define OBD_MUX_MAX_CLIENTS     16
+#define OBD_MUX_MAX_LISTENERS   4
+#define OBD_MUX_LINE_LEN        256     /* Client input not yet answered */
+#define OBD_MUX_OUT_LEN         2048    /* Client output not yet written */
+#define OBD_MUX_BATCH_MAX       6       /* PIDs per multi-PID request (J1979) */
+
+typedef enum {
+    OBD_MUX_CLIENT_IDLE = 0,            /* Nothing asked (or reading input) */
+    OBD_MUX_CLIENT_READY,               /* A command waits for the adapter */
+    OBD_MUX_CLIENT_WAITING,             /* Waiting for request wait_id */
+} obd_mux_client_state_t;
+
+typedef struct {
+    int      fd;                        /* -1 = free slot */
+    uint8_t  state;                     /* obd_mux_client_state_t */
+    uint8_t  echo;                      /* This client's own ATE/ATL/ATS */
+    uint8_t  linefeeds;
+    uint8_t  spaces;
+    uint8_t  closing;                   /* Output overflowed: drop it */
+    uint8_t  wait_pid;                  /* Its PID inside a batched request */
+    uint32_t wait_id;
+    char     command[OBD_MAX_COMMAND_LEN];  /* Normalized, waiting to go */
+    char     last[OBD_MAX_COMMAND_LEN];     /* An empty line repeats it */
+    char     in[OBD_MUX_LINE_LEN];
+    size_t   in_len;
+    char     out[OBD_MUX_OUT_LEN];
+    size_t   out_len;
+    uint64_t requests;
+} obd_mux_client_t;
+
+typedef struct {
+    uint64_t accepted;          /* Clients connected */
+    uint64_t requests;          /* Command lines received */
+    uint64_t local;             /* AT commands answered without the adapter */
+    uint64_t hits;              /* Answered from the cache */
+    uint64_t coalesced;         /* Shared a request already on its way */
+    uint64_t sent;              /* Round trips to the adapter */
+    uint64_t batches;           /* ...of which multi-PID requests */
+    uint64_t batched;           /* Client requests answered by a batch */
+    uint64_t errors;            /* Replies that weren't data (NO DATA, ?...) */
+    uint64_t dropped;           /* Clients dropped for not reading */
+} obd_mux_stats_t;
+
+typedef struct {
+    int              adapter_fd;
+    obd_session_t    session;
+    obd_cache_t      cache;
+    int              listen_fds[OBD_MUX_MAX_LISTENERS];
+    size_t           listen_count;
+    obd_mux_client_t clients[OBD_MUX_MAX_CLIENTS];
+    size_t           rr_next;           /* Round robin: who goes first next */
+    int              batching;          /* Allowed by obd_mux_set_batching() */
+    int              can;               /* Adapter reported CAN: multi-PID works */
+    uint32_t         protocol_id;       /* The ATDPN sent during setup */
+    uint32_t         batch_id;          /* Multi-PID request in flight, or 0 */
+    uint8_t          batch_pids[OBD_MUX_BATCH_MAX];  /* ...and its PIDs */
+    size_t           batch_count;
+    char             wbuf[OBD_MAX_COMMAND_LEN];     /* Command being written */
+    size_t           wbuf_len;
+    size_t           wbuf_pos;
+    obd_mux_stats_t  stats;
+} obd_mux_t;
+
+
+/* ── Timer wheel ─────────────────────────────────────────────────────────
+ *
+ * Hashed wheel: one slot per tick, a timer sits on the list of the slot
+ * its expiry falls in. Schedule, reschedule and cancel are O(1). Timers
+ * live inside the caller's structs; the wheel never allocates.
+ */
+#define OBD_WHEEL_SLOTS     512         /* Power of two */
+
+typedef struct obd_timer {
+    struct obd_timer *next;             /* NULL = not scheduled */
+    struct obd_timer *prev;
+    uint64_t          expires_us;
+} obd_timer_t;
+
+typedef struct {
+    obd_timer_t slots[OBD_WHEEL_SLOTS]; /* List heads (sentinels) */
+    uint64_t    tick_us;
+    uint64_t    cursor;                 /* Tick expiry has got up to */
+    size_t      count;
+} obd_wheel_t;
+
+
+/* ── Fleet ───────────────────────────────────────────────────────────────
+ *
+ * Many adapters, one thread: each adapter is a session on a non-blocking
+ * fd, all of them watched by one epoll instance (or one io_uring), all
+ * their timeouts on one timer wheel. The caller provides the adapter
+ * slots, so a fleet of 1000 costs 1000 × sizeof(obd_fleet_adapter_t) of
+ * the caller's memory plus, with io_uring, the rings and a read buffer
+ * pool mapped at init. See docs/16-fleet-explained.txt.
+ */
+typedef enum {
+    OBD_FLEET_EPOLL = 0,                /* epoll + read()/write(): works everywhere */
+    OBD_FLEET_URING,                    /* io_uring, Linux 6.0+ (falls back to epoll) */
+} obd_fleet_backend_t;
+
+typedef enum {
+    OBD_FLEET_FREE = 0,                 /* Slot unused */
+    OBD_FLEET_OPEN,                     /* Watched, requests flow */
+    OBD_FLEET_LOST,                     /* fd hung up or failed; not watched */
+} obd_fleet_adapter_state_t;
+
+typedef struct {
+    int           fd;
+    uint8_t       state;                /* obd_fleet_adapter_state_t */
+    obd_timer_t   timer;                /* Session deadline on the wheel */
+    char          wbuf[OBD_MAX_COMMAND_LEN];    /* Command being written */
+    size_t        wbuf_len;
+    size_t        wbuf_pos;
+    void         *user;                 /* Caller's pointer, untouched */
+    uint64_t      results;              /* Results delivered */
+    uint8_t       is_socket;            /* send(); with io_uring a multishot recv */
+    /* io_uring bookkeeping (unused with epoll) */
+    uint32_t      generation;           /* Bumped on remove: stale completions */
+    uint8_t       read_armed;           /* A recv/read is queued in the kernel */
+    uint8_t       write_busy;           /* A write is queued in the kernel */
+    obd_session_t session;
+} obd_fleet_adapter_t;
+
+/*
+ * Called for every finished request, with the adapter's index. It may
+ * submit the next request right away. A result with status OBD_ERROR_IO
+ * and id 0 says the adapter was lost.
+ */
+typedef void (*obd_fleet_result_fn)(void *ctx, size_t index,
+                                    const obd_session_result_t *result);
+
+typedef struct {
+    uint64_t results;           /* Requests finished */
+    uint64_t timeouts;          /* ...with OBD_ERROR_TIMEOUT */
+    uint64_t lost;              /* Adapters that hung up */
+    uint64_t wakeups;           /* epoll_wait calls that returned */
+    uint64_t events;            /* fd events handled */
+    uint64_t reads;             /* read() calls that returned data */
+    uint64_t writes;            /* write() calls */
+    uint64_t timer_fires;       /* Session deadlines reached */
+    uint64_t syscalls;          /* Every system call on the I/O path */
+} obd_fleet_stats_t;
+
+/* io_uring state: the mapped rings and the read buffer pool */
+typedef struct {
+    int       fd;                       /* -1 = not in use */
+    void     *sq_ring;                  /* mmap()ed (shared with cq_ring if the */
+    void     *cq_ring;                  /*   kernel has IORING_FEAT_SINGLE_MMAP) */
+    void     *sqes;
+    size_t    sq_ring_size;
+    size_t    cq_ring_size;
+    size_t    sqes_size;
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t *sq_array;
+    uint32_t  sq_mask;
+    uint32_t  sq_entries;
+    uint32_t  sq_local_tail;            /* Queued but not yet submitted: up to here */
+    uint32_t  to_submit;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t  cq_mask;
+    void     *cqes;
+    void     *buf_ring;                 /* Provided-buffer ring for reads */
+    char     *bufs;                     /* ...and the buffers it hands out */
+    size_t    buf_ring_size;
+    size_t    bufs_size;
+    uint32_t  buf_count;
+    uint16_t  buf_tail;
+    int       fixed;                    /* Adapter slots registered for WRITE_FIXED */
+} obd_fleet_uring_t;
+
+typedef struct {
+    int                  epoll_fd;
+    obd_fleet_backend_t  backend;       /* What's actually in use */
+    obd_fleet_uring_t    uring;
+    obd_fleet_adapter_t *adapters;      /* Caller's array */
+    size_t               capacity;
+    size_t               open_count;
+    obd_wheel_t          wheel;
+    obd_fleet_result_fn  on_result;
+    void                *ctx;
+    obd_fleet_stats_t    stats;
+} obd_fleet_t;
+
+
+/* ── Black box ───────────────────────────────────────────────────────────
+ *
+ * A fixed-size ring in a memory-mapped file, always recording: raw
+ * adapter traffic (through the session's capture hook) and decoded
+ * samples. Old records are overwritten; nothing is flushed by hand, so a
+ * crash loses at most the record being written. A trigger freezes the
+ * time around an event into a file of its own while recording goes on.
+ * See docs/28-blackbox-explained.txt.
+ */
+#define OBD_BLACKBOX_PAYLOAD     1024   /* Longest record; longer traffic is split */
+#define OBD_BLACKBOX_TRIGGERS    4      /* Windows waiting to be written */
+#define OBD_BLACKBOX_PATH_LEN    256
+#define OBD_BLACKBOX_REASON_LEN  32
+#define OBD_BLACKBOX_MIN_SIZE    16384  /* Smallest ring (bytes) */
+
+typedef enum {
+    OBD_BLACKBOX_TX = OBD_CAPTURE_TX,   /* Command sent to the adapter */
+    OBD_BLACKBOX_RX = OBD_CAPTURE_RX,   /* Bytes received from it */
+    OBD_BLACKBOX_SAMPLE,                /* A decoded value */
+    OBD_BLACKBOX_MARK,                  /* A trigger, with its reason */
+} obd_blackbox_type_t;
+
+/* One record, as handed to a walker. Pointers are into the ring/file. */
+typedef struct {
+    uint8_t     type;                   /* obd_blackbox_type_t */
+    uint64_t    seq;                    /* Counts up from 1, never reused */
+    uint64_t    t_us;
+    const char *data;                   /* TX/RX bytes or MARK reason (no NUL) */
+    size_t      len;
+    uint16_t    channel;                /* SAMPLE: like the rules' $XX */
+    float       value;
+} obd_blackbox_record_t;
+
+typedef void (*obd_blackbox_record_fn)(void *ctx, const obd_blackbox_record_t *rec);
+
+/* A frozen stretch of time: pending in the recorder, or read from a file */
+typedef struct {
+    uint64_t trigger_us;
+    uint64_t from_us;                   /* trigger - pre */
+    uint64_t to_us;                     /* trigger + post */
+    uint64_t records;                   /* In the file (0 while pending) */
+    char     reason[OBD_BLACKBOX_REASON_LEN];
+    char     path[OBD_BLACKBOX_PATH_LEN];
+} obd_blackbox_window_t;
+
+typedef struct {
+    uint8_t              *map;          /* Header page + ring, MAP_SHARED */
+    size_t                map_size;
+    uint8_t              *ring;
+    size_t                capacity;     /* Ring bytes */
+    size_t                head;         /* Next record goes here */
+    size_t                tail;         /* Oldest record */
+    size_t                used;
+    uint64_t              next_seq;
+    obd_blackbox_window_t windows[OBD_BLACKBOX_TRIGGERS];
+    size_t                window_count;
+    uint64_t              records;      /* Appended since open */
+    uint64_t              overwritten;  /* Dropped to make room */
+    uint64_t              recovered;    /* Found in the file at open */
+    uint64_t              windows_written;
+    uint64_t              windows_failed;
+    uint64_t              windows_recovered;  /* Pending at open: re-armed */
+} obd_blackbox_t;
+
+
+/* ── Journal ─────────────────────────────────────────────────────────────
+ *
+ * An append-only log in a directory of preallocated segment files.
+ * Records are checksummed and collected in memory; a group commit writes
+ * them with one write() and one fdatasync() every commit_us or
+ * commit_bytes, whichever comes first. Opening finds the end of the
+ * last segment and clears off anything torn. See
+ * docs/29-journal-explained.txt.
+ */
+#define OBD_JOURNAL_BUFFER       65536  /* Largest group commit (bytes) */
+#define OBD_JOURNAL_MAX_RECORD   16384  /* Largest record payload */
+#define OBD_JOURNAL_MIN_SEGMENT  (4 * OBD_JOURNAL_BUFFER)
+#define OBD_JOURNAL_PATH_LEN     256
+#define OBD_JOURNAL_TYPE_MAX     254    /* Record types 0–254 are the caller's */
+
+/* One record, as handed to a replay callback. data points into the file. */
+typedef struct {
+    uint8_t     type;
+    uint64_t    seq;                    /* Counts up from 1 across segments */
+    uint64_t    t_us;
+    const void *data;
+    size_t      len;
+} obd_journal_record_t;
+
+typedef void (*obd_journal_record_fn)(void *ctx, const obd_journal_record_t *rec);
+
+typedef struct {
+    uint64_t appended;                  /* Records accepted */
+    uint64_t commits;                   /* write + fdatasync pairs */
+    uint64_t bytes_written;
+    uint64_t segments;                  /* Segment files created */
+    uint64_t recovered;                 /* Records found in the last segment at open */
+    uint64_t truncated;                 /* Torn bytes cleared at open */
+} obd_journal_stats_t;
+
+typedef struct {
+    char                dir[OBD_JOURNAL_PATH_LEN];
+    size_t              segment_size;   /* For new segments */
+    uint64_t            commit_us;
+    size_t              commit_bytes;
+    size_t              max_segments;   /* 0 = keep them all */
+    int                 fd;             /* Current segment, -1 when closed */
+    uint32_t            first_segment;  /* Oldest segment on disk */
+    uint32_t            segment;        /* Current segment */
+    size_t              current_size;   /* ...and its size */
+    size_t              offset;         /* Where the next group goes in it */
+    size_t              checkpoint;     /* Recovery would start here */
+    uint64_t            checkpoint_gen;
+    uint64_t            next_seq;
+    uint64_t            oldest_us;      /* Time of the oldest uncommitted record */
+    uint8_t             buf[OBD_JOURNAL_BUFFER];  /* The group being collected */
+    size_t              buf_len;
+    obd_journal_stats_t stats;
+} obd_journal_t;
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  ELM327 Emulator
+ *
+ *  No I/O: feed it what a client wrote, send back what it returns.
+ *
+ *    obd_emu_init(&emu);
+ *    obd_emu_feed(&emu, "010C\r", 5, out, sizeof(out), &n);
+ *    → out = "010C\r41 0C 1A F8\r\r>"
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** Power on: echo on, no headers, a warm idling car with VIN WBA3B5FK7FN123456. */
+obd_result_t obd_emu_init(obd_emu_t *emu);
+
+/**
+ * Set a Mode 01 PID's data bytes (1–4), or len=0 to make it unsupported.
+ * The bitmap PIDs (00, 20, 40...) can't be set; they follow the table.
+ */
+obd_result_t obd_emu_set_pid(obd_emu_t *emu, uint8_t pid, const uint8_t *data,
+                             size_t len);
+
+/** Set the 17-character VIN returned for 0902. */
+obd_result_t obd_emu_set_vin(obd_emu_t *emu, const char *vin);
+
+/** Set the stored DTCs (raw codes, 0x0301 = P0301). 04 clears them. */
+obd_result_t obd_emu_set_dtcs(obd_emu_t *emu, const uint16_t *codes, size_t count);
+
+/**
+ * Feed bytes from the client. Every complete line (ending in \r) is
+ * answered; the answers go into `out`, ending in ">" like the real thing.
+ *
+ * @return OBD_OK or OBD_ERROR_BUFFER_TOO_SMALL (512 bytes per line is plenty)
+ */
+obd_result_t obd_emu_feed(obd_emu_t *emu, const char *in, size_t len,
+                          char *out, size_t out_size, size_t *out_len);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Sockets
+ *
+ *  Thin wrappers so the daemon, tools and tests don't each repeat the
+ *  getaddrinfo/bind/listen dance. All fds come back non-blocking and
+ *  close-on-exec. OBD_ERROR_IO means a system call failed; errno says why.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** Microseconds from CLOCK_MONOTONIC: the "now" every session call wants. */
+uint64_t obd_io_now_us(void);
+
+/** Make an fd non-blocking. */
+obd_result_t obd_net_set_nonblocking(int fd);
+
+/**
+ * Listen on TCP. host=NULL means 127.0.0.1 (local clients only), port 0
+ * picks a free port (see obd_net_local_port()).
+ */
+obd_result_t obd_net_listen_tcp(const char *host, uint16_t port, int *out_fd);
+
+/** Listen on a Unix socket path, replacing a stale socket file. */
+obd_result_t obd_net_listen_unix(const char *path, int *out_fd);
+
+/** The port a TCP socket is bound to. */
+obd_result_t obd_net_local_port(int fd, uint16_t *out_port);
+
+/** Connect over TCP (blocking connect, then switched to non-blocking). */
+obd_result_t obd_net_connect_tcp(const char *host, uint16_t port, int *out_fd);
+
+/** Connect to a Unix socket. */
+obd_result_t obd_net_connect_unix(const char *path, int *out_fd);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Multiplexer — one adapter, many clients
+ *
+ *    obd_mux_init(&mux, adapter_fd);             sends the setup commands
+ *    obd_net_listen_tcp(NULL, 35000, &fd);
+ *    obd_mux_add_listener(&mux, fd);
+ *    for (;;) obd_mux_step(&mux, 1000);
+ *
+ *  Clients talk to it exactly like to an ELM327. AT commands that change
+ *  settings are answered per client without touching the adapter; OBD
+ *  requests are served from the cache, shared with identical requests in
+ *  flight, or queued round-robin across clients.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Take over an adapter fd (non-blocking, already open) and queue its
+ * setup: ATZ, ATE0, ATL0, ATS1, ATH0, ATSP0, 0100, ATDPN.
+ */
+obd_result_t obd_mux_init(obd_mux_t *mux, int adapter_fd);
+
+/**
+ * Combine different clients' Mode 01 PIDs into one multi-PID request
+ * (CAN only, up to what fits in one frame). Off by default. Turns itself
+ * back off if the car doesn't answer a combined request.
+ */
+obd_result_t obd_mux_set_batching(obd_mux_t *mux, int on);
+
+/** Accept clients from a listening socket (the mux closes it). */
+obd_result_t obd_mux_add_listener(obd_mux_t *mux, int fd);
+
+/** Serve an already connected client (the mux closes it). */
+obd_result_t obd_mux_add_client(obd_mux_t *mux, int fd);
+
+/** Connected clients. */
+size_t obd_mux_client_count(const obd_mux_t *mux);
+
+/**
+ * Wait up to timeout_ms for something to happen, then handle it: accept,
+ * read, answer, write to the adapter, check timeouts.
+ *
+ * @return OBD_OK, or OBD_ERROR_IO if the adapter went away
+ */
+obd_result_t obd_mux_step(obd_mux_t *mux, int timeout_ms);
+
+/** Counters plus the cache report. 8 KB is plenty. */
+obd_result_t obd_mux_format_text(const obd_mux_t *mux, char *out, size_t out_size);
+
+/** Close every client and listener (not the adapter fd). */
+void obd_mux_close(obd_mux_t *mux);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Pseudo-terminals
+ *
+ *  A pty pair behaves like a serial line: put the emulator on the slave
+ *  side and hand the master to the code under test in place of
+ *  /dev/ttyUSB0.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** Open a pty pair, both ends raw, non-blocking and close-on-exec. */
+obd_result_t obd_pty_open(int *out_master, int *out_slave);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Timer Wheel
+ *
+ *    obd_wheel_init(&w, 1000, now);              1 ms ticks
+ *    obd_wheel_schedule(&w, &item->timer, now + 500000);
+ *    while ((t = obd_wheel_expire(&w, now)) != NULL) { ...t fired... }
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/** Empty wheel with tick_us resolution, starting at now_us. */
+obd_result_t obd_wheel_init(obd_wheel_t *w, uint64_t tick_us, uint64_t now_us);
+
+/** Mark a timer as not scheduled. Call once before first use. */
+void obd_timer_init(obd_timer_t *t);
+
+/** Is the timer on the wheel? */
+int obd_timer_pending(const obd_timer_t *t);
+
+/** (Re)schedule a timer. A time in the past fires on the next expire. */
+obd_result_t obd_wheel_schedule(obd_wheel_t *w, obd_timer_t *t, uint64_t expires_us);
+
+/** Take a timer off the wheel (no-op if it isn't on it). */
+void obd_wheel_cancel(obd_wheel_t *w, obd_timer_t *t);
+
+/**
+ * Remove and return one timer whose time has come, or NULL when none is
+ * left. Call until NULL.
+ */
+obd_timer_t *obd_wheel_expire(obd_wheel_t *w, uint64_t now_us);
+
+/** The earliest expiry on the wheel (µs), or 0 if it's empty. */
+uint64_t obd_wheel_next_expiry(const obd_wheel_t *w);
+
+/** Timers on the wheel. */
+size_t obd_wheel_count(const obd_wheel_t *w);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Fleet — many adapters, one thread (Linux)
+ *
+ *    static obd_fleet_adapter_t slots[256];
+ *    obd_fleet_init(&fleet, slots, 256, on_result, ctx);
+ *    obd_fleet_add(&fleet, fd, &index);           per adapter
+ *    obd_fleet_submit_pid(&fleet, index, 0x01, 0x0C, now, NULL);
+ *    for (;;) obd_fleet_step(&fleet, 1000);       results → on_result()
+ *
+ *  For more than one core, run one fleet per thread over a share of the
+ *  adapters: a fleet has no global state.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+#if defined(__linux__)
+
+/** Set up an empty fleet over the caller's `capacity` adapter slots (epoll). */
+obd_result_t obd_fleet_init(obd_fleet_t *fleet, obd_fleet_adapter_t *adapters,
+                            size_t capacity, obd_fleet_result_fn on_result, void *ctx);
+
+/**
+ * Switch the I/O backend; only before the first obd_fleet_add(). Asking
+ * for OBD_FLEET_URING where the kernel lacks it (or forbids it) quietly
+ * keeps epoll: check obd_fleet_backend() for what you got.
+ *
+ * @return OBD_OK, or OBD_ERROR_BUSY once adapters have been added
+ */
+obd_result_t obd_fleet_set_backend(obd_fleet_t *fleet, obd_fleet_backend_t backend);
+
+/** The backend in use. */
+obd_fleet_backend_t obd_fleet_backend(const obd_fleet_t *fleet);
+
+/** "epoll" / "io_uring". */
+const char *obd_fleet_backend_name(obd_fleet_backend_t backend);
+
+/**
+ * Start driving an adapter on a non-blocking fd (the caller keeps
+ * ownership and closes it after obd_fleet_remove()).
+ *
+ * @return OBD_OK, OBD_ERROR_BUSY when every slot is taken, OBD_ERROR_IO
+ */
+obd_result_t obd_fleet_add(obd_fleet_t *fleet, int fd, size_t *out_index);
+
+/** Stop driving an adapter. Queued requests are dropped without results. */
+obd_result_t obd_fleet_remove(obd_fleet_t *fleet, size_t index);
+
+/** The adapter's session, for obd_session_set_timeout() / _set_trace(). */
+obd_session_t *obd_fleet_session(obd_fleet_t *fleet, size_t index);
+
+/**
+ * Queue a request on one adapter; it's written as soon as the adapter is
+ * free (with io_uring: handed to the kernel at the next obd_fleet_step()).
+ */
+obd_result_t obd_fleet_submit_pid(obd_fleet_t *fleet, size_t index, uint8_t mode,
+                                  uint8_t pid, uint64_t now_us, uint32_t *out_id);
+
+/** Same, for a raw command ("0902", "ATRV"). */
+obd_result_t obd_fleet_submit_command(obd_fleet_t *fleet, size_t index,
+                                      const char *command, uint64_t now_us,
+                                      uint32_t *out_id);
+
+/**
+ * Withdraw a request (obd_session_cancel()). One already sent is reported
+ * to on_result() with OBD_ERROR_CANCELLED before this returns.
+ *
+ * @return OBD_OK (dropped unsent), OBD_PENDING (was in flight) or
+ *         OBD_ERROR_NO_DATA if it had already finished
+ */
+obd_result_t obd_fleet_cancel(obd_fleet_t *fleet, size_t index, uint32_t id,
+                              uint64_t now_us);
+
+/**
+ * Wait up to timeout_ms (less if a session deadline comes first), then
+ * handle what happened: read replies, write the next commands, fire
+ * timeouts, call on_result().
+ *
+ * @return OBD_OK, or OBD_ERROR_IO if epoll itself failed
+ */
+obd_result_t obd_fleet_step(obd_fleet_t *fleet, int timeout_ms);
+
+/** Stop watching everything and release the epoll fd (adapter fds stay open). */
+void obd_fleet_close(obd_fleet_t *fleet);
+
+#endif /* __linux__ */
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Black box
+ *
+ *    obd_blackbox_open(&bb, "/var/lib/obd/ring.bbx", 8 << 20);
+ *    obd_session_set_capture(&session, obd_blackbox_capture, &bb);
+ *    obd_blackbox_result(&bb, &result, now);      for each decoded result
+ *    obd_blackbox_trigger(&bb, now, 60000000, 30000000, "P0301.bbw", "P0301");
+ *    obd_blackbox_tick(&bb, now);                 writes it 30 s later
+ *
+ *  The ring has to hold pre + post of traffic, or the start of a window
+ *  is overwritten before it's written out.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Open (or create) a ring file and map it. An existing file keeps its
+ * own size and its records: whatever survived the last run is recovered
+ * and recording carries on after it.
+ *
+ * @param capacity  Ring bytes for a new file (≥ OBD_BLACKBOX_MIN_SIZE)
+ * @return OBD_OK, OBD_ERROR_INVALID_ARG, OBD_ERROR_PARSE_FAILED (not a
+ *         ring file) or OBD_ERROR_IO (errno set)
+ */
+obd_result_t obd_blackbox_open(obd_blackbox_t *bb, const char *path, size_t capacity);
+
+/** Unmap. Pending windows stay noted in the file; the next open re-arms them. */
+void obd_blackbox_close(obd_blackbox_t *bb);
+
+/**
+ * Record raw traffic. Matches obd_capture_fn, so it can go straight into
+ * obd_session_set_capture() with the recorder as ctx.
+ */
+void obd_blackbox_capture(void *ctx, uint8_t dir, const char *data, size_t len,
+                          uint64_t t_us);
+
+/** Record a decoded value. */
+obd_result_t obd_blackbox_sample(obd_blackbox_t *bb, uint16_t channel, float value,
+                                 uint64_t t_us);
+
+/** Record a session result's value, if it has one (channel = PID). */
+obd_result_t obd_blackbox_result(obd_blackbox_t *bb, const obd_session_result_t *result,
+                                 uint64_t t_us);
+
+/**
+ * Freeze [t_us - pre_us, t_us + post_us] into `path`. A MARK record goes
+ * into the ring and the window into the file's header page now; the file
+ * is written by obd_blackbox_tick() once t_us + post_us has passed, after
+ * a reopen if the process died first. Recording never stops.
+ *
+ * @return OBD_OK, OBD_ERROR_BUSY when OBD_BLACKBOX_TRIGGERS are pending,
+ *         OBD_ERROR_BUFFER_TOO_SMALL for a path that's too long
+ */
+obd_result_t obd_blackbox_trigger(obd_blackbox_t *bb, uint64_t t_us, uint64_t pre_us,
+                                  uint64_t post_us, const char *path, const char *reason);
+
+/**
+ * Write out every window whose end is at or before now_us (to path.tmp,
+ * fsync, rename). Call it from the loop, not from inside a capture.
+ *
+ * @return OBD_OK, or OBD_ERROR_IO if a window couldn't be written (it is
+ *         dropped and counted in windows_failed)
+ */
+obd_result_t obd_blackbox_tick(obd_blackbox_t *bb, uint64_t now_us);
+
+/** Push the ring to disk (msync). Only a power cut needs this; a crash doesn't. */
+obd_result_t obd_blackbox_sync(obd_blackbox_t *bb);
+
+/** Call fn for every record in the ring, oldest first. */
+obd_result_t obd_blackbox_walk(const obd_blackbox_t *bb, obd_blackbox_record_fn fn,
+                               void *ctx);
+
+/**
+ * Read a window file: its header into `info` (may be NULL), its records
+ * to fn, oldest first.
+ *
+ * @return OBD_OK, OBD_ERROR_PARSE_FAILED for a damaged file, OBD_ERROR_IO
+ */
+obd_result_t obd_blackbox_read_file(const char *path, obd_blackbox_window_t *info,
+                                    obd_blackbox_record_fn fn, void *ctx);
+
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  Journal
+ *
+ *    obd_journal_open(&j, "/var/lib/obd/trip", 4 << 20, now);
+ *    obd_journal_set_commit(&j, 500000, 32768);   fsync every 0.5 s or 32 KB
+ *    obd_journal_append(&j, TRIP_ROW, &row, sizeof(row), now);
+ *    obd_journal_tick(&j, now);                    from the loop
+ *    obd_journal_close(&j, now);                   commits what's left
+ *
+ *  A power cut loses at most the records of the last commit_us.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/**
+ * Open the journal in `dir` (created if missing), carrying on after the
+ * last record that made it to disk. Only the newest segment is checked,
+ * and only its last two groups are read in full, so this is quick
+ * whatever the journal's size. Torn bytes after the end are zeroed.
+ *
+ * @param segment_size  Bytes per new segment file (≥ OBD_JOURNAL_MIN_SEGMENT)
+ * @return OBD_OK, OBD_ERROR_INVALID_ARG, OBD_ERROR_BUFFER_TOO_SMALL (dir
+ *         too long) or OBD_ERROR_IO (errno set)
+ */
+obd_result_t obd_journal_open(obd_journal_t *j, const char *dir, size_t segment_size,
+                              uint64_t now_us);
+
+/**
+ * Group commit policy: commit when the oldest waiting record is
+ * commit_us old, or when commit_bytes are waiting (at most
+ * OBD_JOURNAL_BUFFER). Defaults: 500 ms, 32 KB.
+ */
+obd_result_t obd_journal_set_commit(obd_journal_t *j, uint64_t commit_us,
+                                    size_t commit_bytes);
+
+/** Delete the oldest segments beyond max_segments (0 = keep all, the default). */
+obd_result_t obd_journal_set_retention(obd_journal_t *j, size_t max_segments);
+
+/**
+ * Add a record. It is in memory until the next commit, which this call
+ * makes itself when one is due.
+ *
+ * @param type  0..OBD_JOURNAL_TYPE_MAX, the caller's to define
+ * @return OBD_OK, OBD_ERROR_INVALID_ARG (bad type, or more than
+ *         OBD_JOURNAL_MAX_RECORD bytes) or OBD_ERROR_IO from a commit
+ */
+obd_result_t obd_journal_append(obd_journal_t *j, uint8_t type, const void *data,
+                                size_t len, uint64_t t_us);
+
+/** Commit if the oldest waiting record is commit_us old. Call it from the loop. */
+obd_result_t obd_journal_tick(obd_journal_t *j, uint64_t now_us);
+
+/** Write and fdatasync everything waiting, now (say, at ignition off). */
+obd_result_t obd_journal_commit(obd_journal_t *j, uint64_t now_us);
+
+/** Commit and close. */
+obd_result_t obd_journal_close(obd_journal_t *j, uint64_t now_us);
+
+/**
+ * Read a journal directory from its oldest segment on, checking every
+ * record, and hand the records to fn in order. Works on a journal
+ * another process has open: it sees what has been committed.
+ *
+ * @return OBD_OK, OBD_ERROR_NO_DATA (no segments), OBD_ERROR_PARSE_FAILED
+ *         (a damaged segment), OBD_ERROR_IO
+ */
+obd_result_t obd_journal_replay(const char *dir, obd_journal_record_fn fn, void *ctx);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OBD_IO_H */
@@ -23,8 +23,11 @@ extern "C" {
  *
  * Every public function returns one of these. Negative = error, zero = OK.
  * The caller checks the return value before using any output parameters.
+ * The one positive value, OBD_PENDING, means "not an error, but the
+ * answer isn't ready yet" (see the response cache).
  */
 typedef enum {
+    OBD_PENDING             =  1,  /* Accepted; the result arrives later */
     OBD_OK                  =  0,  /* Success */
     OBD_ERROR_INVALID_ARG   = -1,  /* NULL pointer or bad parameter */
     OBD_ERROR_BUFFER_TOO_SMALL = -2,  /* Output buffer not big enough */
@@ -33,6 +36,10 @@ typedef enum {
     OBD_ERROR_ELM_ERROR     = -5,  /* ELM327 responded with "?" or error */
     OBD_ERROR_PARSE_FAILED  = -6,  /* Couldn't parse response format */
     OBD_ERROR_UNKNOWN_PID   = -7,  /* PID not in our lookup table */
+    OBD_ERROR_TIMEOUT       = -8,  /* Adapter never sent the ">" prompt */
+    OBD_ERROR_BUSY          = -9,  /* Session queue is full, try again later */
+    OBD_ERROR_IO            = -10, /* A system call failed (obd_io only; see errno) */
+    OBD_ERROR_CANCELLED     = -11, /* Withdrawn with obd_session_cancel() */
 } obd_result_t;
 
 
@@ -62,14 +69,15 @@ typedef enum {
  *   - Max 7 data bytes per OBD response frame
  *   - VIN is always exactly 17 characters
  *   - DTC code is 5 chars like "P0301" + null terminator
- *   - ELM327 responses are usually under 256 bytes
+ *   - ELM327 responses are usually under 256 bytes; a multi-frame Mode 09
+ *     reply from several ECUs with headers on can run to ~1 KB
  *   - A single Mode 03 response can return at most ~32 DTCs realistically
  */
 #define OBD_MAX_DATA_BYTES      7
 #define OBD_VIN_LENGTH         17
 #define OBD_DTC_CODE_LENGTH     6   /* "P0301" + '\0' */
 #define OBD_MAX_DTCS           32
-#define OBD_MAX_RESPONSE_LEN  256
+#define OBD_MAX_RESPONSE_LEN 1024
 #define OBD_MAX_COMMAND_LEN    16
 
 
@@ -149,6 +157,974 @@ typedef struct {
 } obd_dtc_list_t;
 
 
+/* ── Reassembled replies ─────────────────────────────────────────────────────
+ *
+ * On CAN, an answer longer than 7 bytes is split over several frames, and
+ * with headers on (ATH1) every ECU that answers shows up under its own CAN
+ * id. obd_reply_reassemble() puts the pieces back together: one
+ * obd_reply_t per answering ECU, holding the whole message, service byte
+ * first ("46 01 0B 24 ..." → data = {0x46, 0x01, 0x0B, 0x24, ...}).
+ */
+#define OBD_MAX_REPLY_BYTES   256
+#define OBD_MAX_ECUS            8   /* CAN ids 7E8-7EF */
+
+typedef struct {
+    uint16_t ecu;                        /* CAN id, or 0 with headers off */
+    uint8_t  data[OBD_MAX_REPLY_BYTES];
+    size_t   len;
+} obd_reply_t;
+
+
+/* ── Supported-PID set ───────────────────────────────────────────────────────
+ *
+ * PID 0x00 of a mode answers with a 32-bit bitmap: bit 31 = PID 0x01 is
+ * supported, ..., bit 0 = PID 0x20 is. PID 0x20 then covers 0x21-0x40,
+ * and so on, for as long as the last bit of each bitmap is set. The same
+ * chain describes Mode 01 PIDs, Mode 06 monitor IDs and Mode 09 info
+ * types. This is everything learnt from such a chain.
+ */
+typedef struct {
+    uint8_t bits[32];      /* Bit (id & 7) of bits[id >> 3]: id is supported */
+    uint8_t read;          /* Bit k: the bitmap at 0x20 * k has been merged */
+} obd_pid_supported_t;
+
+
+/* ── Mode 06: on-board monitoring test results ───────────────────────────────
+ *
+ * The car keeps the last result of each emissions self-test: catalyst
+ * efficiency, O2 sensor response, EGR flow, misfires per cylinder... A
+ * monitor (MID, e.g. 0x21 = catalyst bank 1) runs one or more tests (TID),
+ * each reporting a value and the limits it has to stay within. The
+ * unit-and-scaling ID (UASID) says how to turn the raw 16-bit numbers into
+ * engineering units.
+ */
+#define OBD_MONITOR_MAX_TESTS  64
+
+typedef struct {
+    uint16_t ecu;          /* Who answered (0 with headers off) */
+    uint8_t  mid;          /* Monitor, e.g. 0xA2 = misfire cylinder 1 */
+    uint8_t  tid;          /* Test within the monitor */
+    uint8_t  uasid;        /* Unit and scaling, see obd_monitor_unit() */
+    uint8_t  passed;       /* min <= value <= max */
+    float    value;        /* Scaled to the UASID's unit */
+    float    min;
+    float    max;
+} obd_monitor_test_t;
+
+typedef struct {
+    obd_monitor_test_t tests[OBD_MONITOR_MAX_TESTS];
+    size_t             count;
+} obd_monitor_result_t;
+
+
+/* ── Mode 09: vehicle information ────────────────────────────────────────────
+ *
+ * Besides the VIN, Mode 09 reports per ECU: calibration IDs (which
+ * software is flashed), calibration verification numbers (a checksum of
+ * it), the ECU's name, and in-use performance tracking (how often each
+ * monitor ran vs. how often it could have). Each ECU that answers gets
+ * its own obd_ecu_info_t.
+ *
+ * The vehicle profile collects all of it. It holds no pointers, so it
+ * can be kept across reconnects (or saved to a file) and anything in it
+ * is never asked for again. See obd_info_next_request().
+ */
+#define OBD_CALID_LENGTH       16
+#define OBD_MAX_CALIDS          8
+#define OBD_ECU_NAME_LENGTH    20   /* "ECM\0-Engine Control\0\0..." on the wire */
+#define OBD_IPT_MAX_COUNTERS   20
+
+typedef struct {
+    uint16_t ecu;                                  /* CAN id, or 0 with headers off */
+    uint32_t read;                                 /* Bit n: PID n answered */
+    char     name[OBD_ECU_NAME_LENGTH + 1];        /* PID 0A, "ECM-Engine Control" */
+    size_t   calid_count;                          /* PID 04 */
+    char     calid[OBD_MAX_CALIDS][OBD_CALID_LENGTH + 1];
+    size_t   cvn_count;                            /* PID 06, one per CALID */
+    uint32_t cvn[OBD_MAX_CALIDS];
+    uint8_t  ipt_pid;                              /* 0x08 spark, 0x0B compression, 0 none */
+    size_t   ipt_count;
+    uint16_t ipt[OBD_IPT_MAX_COUNTERS];            /* See obd_info_ipt_name() */
+} obd_ecu_info_t;
+
+typedef struct {
+    char                vin[OBD_VIN_LENGTH + 1];   /* PID 02, "" until read */
+    obd_pid_supported_t supported;                 /* Mode 09 PIDs the car has */
+    uint32_t            read;                      /* Bit n: PID n answered or given up on */
+    size_t              ecu_count;
+    obd_ecu_info_t      ecus[OBD_MAX_ECUS];
+} obd_vehicle_profile_t;
+
+
+/* ── Mode 02: freeze frame ───────────────────────────────────────────────────
+ *
+ * When the ECU stores an emissions DTC it also stores a snapshot of the
+ * Mode 01 PIDs at that moment: RPM, load, coolant temperature... That's
+ * a freeze frame. Mode 02 reads it back, PID by PID, with the frame
+ * number after each PID (frame 0 is the one every car has).
+ */
+#define OBD_FREEZE_MAX_VALUES   48
+#define OBD_FREEZE_MAX_BATCH     3   /* "02 PID FRAME" x3 fills one CAN frame */
+
+typedef struct {
+    uint8_t            pid;
+    uint8_t            has_value;      /* PID is in the sensor table */
+    float              value;          /* Decoded like Mode 01 */
+    obd_pid_response_t raw;            /* mode 0x42, pid, data (no frame byte) */
+} obd_freeze_value_t;
+
+typedef struct {
+    uint8_t             frame;          /* Frame number asked for */
+    uint8_t             batch;          /* PIDs per request: 3 on CAN, 1 otherwise */
+    uint16_t            ecu;            /* Who answered first (0 with headers off) */
+    uint8_t             has_dtc;        /* PID 02 was read and isn't 0000 */
+    obd_dtc_t           dtc;            /* The DTC that stored this frame */
+    obd_pid_supported_t supported;      /* PIDs stored in this frame */
+    uint8_t             done[32];       /* Bit (pid & 7) of done[pid >> 3]: asked */
+    uint8_t             asked[OBD_FREEZE_MAX_BATCH]; /* The request in flight */
+    size_t              asked_count;
+    size_t              count;
+    obd_freeze_value_t  values[OBD_FREEZE_MAX_VALUES];
+} obd_freeze_frame_t;
+
+
+/* ── Readiness monitors: PID 01 / PID 41 ─────────────────────────────────────
+ *
+ * PID 01 (since DTCs were cleared) and PID 41 (this drive cycle) say which
+ * emissions monitors the car has and which have finished running, plus
+ * the MIL and DTC count. An inspection station fails a car with a lit
+ * MIL or too many incomplete monitors.
+ *
+ * Each monitor is one bit of a uint16_t, the same bit for spark and
+ * compression ignition: bits 0-2 come from byte B, bits 3-10 from byte C
+ * (supported) or D (incomplete). Compression-ignition engines reuse the
+ * spark bits for their own monitors (the second name below).
+ */
+typedef enum {
+    OBD_READY_MISFIRE        = 1u << 0,
+    OBD_READY_FUEL_SYSTEM    = 1u << 1,
+    OBD_READY_COMPONENTS     = 1u << 2,
+    OBD_READY_CATALYST       = 1u << 3,     /* NMHC catalyst */
+    OBD_READY_HEATED_CAT     = 1u << 4,     /* NOx / SCR aftertreatment */
+    OBD_READY_EVAP           = 1u << 5,     /* (reserved) */
+    OBD_READY_SECONDARY_AIR  = 1u << 6,     /* Boost pressure */
+    OBD_READY_AC_REFRIG      = 1u << 7,     /* (reserved) */
+    OBD_READY_O2_SENSOR      = 1u << 8,     /* Exhaust gas sensor */
+    OBD_READY_O2_HEATER      = 1u << 9,     /* PM filter */
+    OBD_READY_EGR            = 1u << 10     /* EGR and/or VVT */
+} obd_ready_monitor_t;
+
+#define OBD_READY_MONITOR_COUNT  11
+#define OBD_READY_CONTINUOUS     (OBD_READY_MISFIRE | OBD_READY_FUEL_SYSTEM | OBD_READY_COMPONENTS)
+
+#define OBD_READINESS_MIL          0x01   /* Check engine light on (PID 01 only) */
+#define OBD_READINESS_COMPRESSION  0x02   /* Diesel: bits 3-10 are the second names */
+#define OBD_READINESS_THIS_CYCLE   0x04   /* From PID 41: supported = enabled this cycle */
+
+/* 6 bytes, so a whole fleet's worth fits in cache */
+typedef struct {
+    uint16_t supported;     /* OBD_READY_* the car has */
+    uint16_t incomplete;    /* OBD_READY_* not finished yet (subset of supported) */
+    uint8_t  dtc_count;     /* Emissions DTCs stored (PID 01 only) */
+    uint8_t  flags;         /* OBD_READINESS_* */
+} obd_readiness_t;
+
+typedef struct {
+    uint16_t ignore;            /* Monitors that never count, e.g. OBD_READY_CONTINUOUS */
+    uint8_t  max_incomplete;    /* How many of the rest may be incomplete */
+    uint8_t  allow_mil;         /* 0: a lit MIL fails, whatever the monitors say */
+} obd_readiness_policy_t;
+
+
+/* ── Derived sensors ─────────────────────────────────────────────────────────
+ *
+ * Values the car doesn't report but that follow from ones it does: fuel
+ * economy from MAF and speed, boost from MAP and barometric pressure,
+ * distance from integrating speed. Each is a row of data (inputs, an
+ * operation, coefficients), so a new one needs no new code.
+ *
+ * Channels 0x00-0xFF are Mode 01 PIDs; derived values get channels from
+ * 0x100 up and can be inputs of other derived values.
+ */
+#define OBD_DERIVED_CHANNEL_BASE   0x100
+#define OBD_DERIVED_MAX_INPUTS         3
+#define OBD_DERIVED_MAX_DEFS          16
+#define OBD_DERIVED_MAX_CHANNELS      32   /* Inputs and outputs together */
+
+/* Channels of obd_derived_defaults() */
+#define OBD_DERIVED_FUEL_RATE      0x100   /* L/h, from MAF */
+#define OBD_DERIVED_ECONOMY        0x101   /* L/100 km, fuel rate / speed */
+#define OBD_DERIVED_BOOST          0x102   /* kPa, MAP - barometric */
+#define OBD_DERIVED_POWER          0x103   /* kW, estimated from MAF */
+#define OBD_DERIVED_GEAR           0x104   /* rpm per km/h: one value per gear */
+#define OBD_DERIVED_DISTANCE       0x105   /* km, integrated speed */
+#define OBD_DERIVED_FUEL_USED      0x106   /* L, integrated fuel rate */
+
+typedef enum {
+    OBD_DERIVED_LINEAR,     /* offset + k[0]*in[0] + k[1]*in[1] + k[2]*in[2] */
+    OBD_DERIVED_PRODUCT,    /* offset + k[0] * in[0] * in[1] */
+    OBD_DERIVED_RATIO,      /* offset + k[0] * in[0] / in[1]; none while |in[1]| < limit */
+    OBD_DERIVED_INTEGRAL    /* offset + sum of k[0] * in[0] * seconds (trapezoids);
+                               gaps longer than limit seconds are skipped */
+} obd_derived_op_t;
+
+typedef struct {
+    uint16_t    channel;                            /* 0x100 and up, unique */
+    const char *name;                               /* "Fuel Economy" */
+    const char *unit;                               /* "L/100km" */
+    uint8_t     op;                                 /* obd_derived_op_t */
+    uint8_t     input_count;
+    uint16_t    inputs[OBD_DERIVED_MAX_INPUTS];     /* PIDs or other derived channels */
+    float       k[OBD_DERIVED_MAX_INPUTS];
+    float       offset;
+    float       limit;                              /* See obd_derived_op_t; 0 = none */
+} obd_derived_def_t;
+
+/* One row of the value table: a PID fed in, or a derived value */
+typedef struct {
+    uint16_t    channel;
+    uint8_t     has_value;      /* 0 until fed; derived: inputs missing, stale or /0 */
+    float       value;
+    uint64_t    t_us;           /* Sample time (derived: newest input's) */
+    const char *name;           /* From the sensor table or the definition, "" if neither */
+    const char *unit;
+} obd_derived_slot_t;
+
+typedef struct {
+    const obd_derived_def_t *defs;                  /* Caller's array, not copied */
+    size_t   def_count;
+    uint64_t max_age_us;                            /* Inputs further apart don't combine */
+    uint8_t  order[OBD_DERIVED_MAX_DEFS];           /* Evaluation order: inputs first */
+    uint8_t  out_slot[OBD_DERIVED_MAX_DEFS];
+    uint8_t  in_slot[OBD_DERIVED_MAX_DEFS][OBD_DERIVED_MAX_INPUTS];
+    uint32_t in_mask[OBD_DERIVED_MAX_DEFS];         /* Bit s: reads slot s */
+    uint8_t  has_prev[OBD_DERIVED_MAX_DEFS];        /* Integrals: last input sample */
+    float    prev_value[OBD_DERIVED_MAX_DEFS];
+    uint64_t prev_t_us[OBD_DERIVED_MAX_DEFS];
+    uint64_t evaluations;                           /* Definitions computed so far */
+    size_t   slot_count;
+    obd_derived_slot_t slots[OBD_DERIVED_MAX_CHANNELS];
+} obd_derived_t;
+
+
+/* ── Resampler ───────────────────────────────────────────────────────────────
+ *
+ * Polled PIDs arrive at their own moments and rates: RPM every 100 ms,
+ * coolant every 2 s. The resampler turns them into rows at a fixed rate
+ * (every period_us, on multiples of it), one value per channel, either
+ * holding the last sample or interpolating between the two around the
+ * row's time.
+ *
+ * A row waits for every channel to have a sample at or after its time,
+ * but never longer than max_latency_us: then the missing channels hold
+ * their last value. Each channel keeps its recent samples in a fixed
+ * ring; nothing is allocated.
+ */
+#define OBD_RESAMPLE_MAX_CHANNELS  16
+#define OBD_RESAMPLE_RING          32   /* Samples kept per channel */
+
+typedef enum {
+    OBD_RESAMPLE_HOLD,          /* Last sample at or before the row (zero-order hold) */
+    OBD_RESAMPLE_LINEAR         /* Straight line between the samples either side */
+} obd_resample_mode_t;
+
+typedef struct {
+    uint16_t channel;                       /* PID or derived channel */
+    uint8_t  mode;                          /* obd_resample_mode_t */
+    size_t   head;                          /* Oldest sample */
+    size_t   count;
+    uint64_t t_us[OBD_RESAMPLE_RING];
+    float    value[OBD_RESAMPLE_RING];
+} obd_resample_input_t;
+
+typedef struct {
+    uint64_t t_us;                          /* A multiple of period_us */
+    uint32_t valid;                         /* Bit i: values[i] is set (channel had data) */
+    uint32_t held;                          /* Bit i: no newer sample yet, last one held */
+    float    values[OBD_RESAMPLE_MAX_CHANNELS];
+} obd_resample_row_t;
+
+typedef struct {
+    uint64_t period_us;
+    uint64_t max_latency_us;
+    uint64_t next_t_us;                     /* Time of the next row */
+    uint8_t  started;                       /* A first sample set next_t_us */
+    uint64_t rows;                          /* Rows emitted */
+    uint64_t overruns;                      /* Samples pushed out of a full ring */
+    size_t   channel_count;
+    obd_resample_input_t inputs[OBD_RESAMPLE_MAX_CHANNELS];
+} obd_resampler_t;
+
+
+/* ── Per-sensor summary ──────────────────────────────────────────────────────
+ *
+ * Min, max, mean, standard deviation and percentiles of one sensor over a
+ * trip (or a day, or a fleet), without keeping the samples: a fixed
+ * ~1 KB per sensor however many samples go in. Two summaries merge into
+ * one as if all their samples had been added to it, so trips add up to
+ * days and vehicles to fleets.
+ *
+ * Percentiles come from a t-digest: the sorted samples squeezed into at
+ * most OBD_SUMMARY_CENTROIDS (mean, weight) clusters, small near the
+ * ends so p1 and p99 stay accurate, large in the middle.
+ */
+#define OBD_SUMMARY_CENTROIDS   100
+#define OBD_SUMMARY_BUFFER       32   /* New samples waiting to be merged in */
+
+typedef struct {
+    uint64_t count;
+    double   mean;                                /* Welford's running mean ... */
+    double   m2;                                  /* ... and sum of squared deviations */
+    float    min, max;
+    uint64_t min_t_us, max_t_us;                  /* When they were seen */
+    uint64_t first_t_us, last_t_us;
+    size_t   centroid_count;                      /* t-digest, sorted by mean */
+    float    centroid_mean[OBD_SUMMARY_CENTROIDS];
+    uint32_t centroid_weight[OBD_SUMMARY_CENTROIDS];
+    size_t   buffered;
+    float    buffer[OBD_SUMMARY_BUFFER];
+} obd_summary_t;
+
+/* What a summary says, for display or storage */
+typedef struct {
+    uint64_t count;
+    float    min, max;
+    uint64_t min_t_us, max_t_us;
+    float    mean;
+    float    stddev;                              /* Sample (n - 1); 0 below 2 samples */
+    float    p50, p95, p99;
+} obd_summary_snapshot_t;
+
+
+/* ── Heatmap ─────────────────────────────────────────────────────────────────
+ *
+ * How often the engine sat at each operating point: a 2-D histogram of one
+ * channel against another (RPM × load, speed × gear), with bin edges of
+ * your choosing. Counting a sample is a table lookup per axis, no search:
+ * each axis divides its range into OBD_HEATMAP_LUT equal cells and
+ * remembers which bin every cell starts in; one comparison either side
+ * then settles the bin.
+ *
+ * Values outside the edges count in the first or last bin. Heatmaps with
+ * the same edges merge by adding their cells, so trips add up to fleets
+ * and threads can count into their own and combine at the end.
+ */
+#define OBD_HEATMAP_MAX_BINS  32    /* Per axis */
+#define OBD_HEATMAP_LUT      256    /* Lookup cells per axis */
+
+typedef struct {
+    uint16_t channel;                           /* PID or derived channel on this axis */
+    uint8_t  bins;
+    float    edges[OBD_HEATMAP_MAX_BINS + 1];   /* bins + 1, increasing */
+    float    hi;                                /* Largest value below the last edge */
+    float    scale;                             /* Lookup cells per unit */
+    uint8_t  lut[OBD_HEATMAP_LUT];              /* Bin each cell starts in */
+} obd_heatmap_axis_t;
+
+typedef struct {
+    obd_heatmap_axis_t x, y;
+    uint64_t total;                             /* Samples counted */
+    uint64_t dropped;                           /* NaN samples, not counted */
+    uint8_t  has_x, has_y;                      /* obd_heatmap_feed(): half a pair */
+    float    pending_x, pending_y;
+    uint32_t counts[OBD_HEATMAP_MAX_BINS * OBD_HEATMAP_MAX_BINS];  /* [y][x], saturating */
+} obd_heatmap_t;
+
+
+/* ── Alert rules ─────────────────────────────────────────────────────────────
+ *
+ * Alerts written as text and compiled at run time, so a new one is data,
+ * not a release:
+ *
+ *   $05 > 110 for 10s clear $05 < 105         coolant hot, 5 degrees hysteresis
+ *   $0C > 6500                                over the redline
+ *   $42 < 9.5 && $0C > 0 && $0C < 400         voltage sag while cranking
+ *   abs(rate($0D)) > 15 for 500ms             hard braking (km/h per second)
+ *
+ * $XX reads channel XX (hex: a PID, or a derived channel from 0x100).
+ * Operators, tightest first: unary - and !, * /, + -, < <= > >= == !=,
+ * &&, ||; also abs(), min(), max(), and rate($XX) (change per second
+ * between its last two samples). True is 1, false is 0.
+ *
+ * for D     the condition must hold for D before the alert starts
+ * clear E   once started, the alert ends when E is true (default: when
+ *           the condition is false)
+ * hold D    ...and has been for D
+ *
+ * Durations are a number with ms, s or min. Rules compile into a shared
+ * bytecode pool; each channel knows the rules that read it, so a sample
+ * runs only those. Nothing is allocated.
+ */
+#define OBD_RULES_MAX           64
+#define OBD_RULES_MAX_CHANNELS  32     /* Distinct channels read by all rules */
+#define OBD_RULES_CODE        2048     /* Bytecode, all rules together */
+#define OBD_RULES_CONSTANTS    256
+#define OBD_RULES_STACK         16     /* Deepest expression */
+#define OBD_RULES_EVENTS        32     /* Start/end events waiting for poll */
+#define OBD_RULE_NAME_LEN       24
+
+typedef enum {
+    OBD_RULE_IDLE,
+    OBD_RULE_PENDING,           /* Condition true, "for" not reached yet */
+    OBD_RULE_ACTIVE,
+    OBD_RULE_CLEARING           /* Clear condition true, "hold" not reached yet */
+} obd_rule_state_t;
+
+typedef struct {
+    char     name[OBD_RULE_NAME_LEN];
+    uint16_t trigger_at, trigger_len;       /* The condition's bytecode */
+    uint16_t clear_at, clear_len;           /* The clear condition's; len 0 = none */
+    uint64_t for_us, hold_us;
+    uint32_t reads;                         /* Bit s: needs a value of channel slot s */
+    uint32_t reads_rate;                    /* Bit s: needs two samples of slot s */
+    uint8_t  first_slot;                    /* Its value goes in the events */
+    uint8_t  state;                         /* obd_rule_state_t */
+    uint64_t since_us;                      /* PENDING/CLEARING: since when */
+} obd_rule_t;
+
+typedef struct {
+    uint16_t channel;
+    uint8_t  samples;                       /* 0, 1, or 2 (enough for rate) */
+    float    value, prev_value;
+    uint64_t t_us, prev_t_us;
+    uint64_t rules;                         /* Bit r: rule r reads this channel */
+} obd_rule_channel_t;
+
+typedef struct {
+    uint16_t    rule;                       /* Index, as returned by obd_rules_add() */
+    uint8_t     active;                     /* 1 = started, 0 = ended */
+    uint64_t    t_us;                       /* When "for"/"hold" ran out, or the sample's time */
+    float       value;                      /* The first channel the condition reads */
+    const char *name;
+} obd_rule_event_t;
+
+typedef struct {
+    size_t   rule_count;
+    obd_rule_t rules[OBD_RULES_MAX];
+    size_t   channel_count;
+    obd_rule_channel_t channels[OBD_RULES_MAX_CHANNELS];
+    uint32_t have;                          /* Bit s: slot s has a value ... */
+    uint32_t have_rate;                     /* ... and two, for rate() */
+    size_t   code_len;
+    uint8_t  code[OBD_RULES_CODE];
+    size_t   constant_count;
+    float    constants[OBD_RULES_CONSTANTS];
+
+    obd_rule_event_t events[OBD_RULES_EVENTS];       /* Ring */
+    size_t   event_head, event_count;
+    uint64_t events_lost;                   /* Ring was full */
+    uint64_t evaluations;                   /* Rules run so far */
+
+    const char *error;                      /* Last obd_rules_add() failure, or NULL */
+    size_t   error_at;                      /* ...and where in the text */
+} obd_rules_t;
+
+
+/* ── Trips ───────────────────────────────────────────────────────────────────
+ *
+ * Where a log's trips begin and end, worked out as samples arrive. Each
+ * sample of one of these channels votes on whether the engine runs:
+ *
+ *   0x0C  RPM              at or above rpm_on: running, below: not
+ *   0x0D  speed            above idle_speed: running; standing still: no vote
+ *   0x1F  run time         went up: running; 0: not; went down: restarted
+ *   0x42  module voltage   only while no RPM has come for gap_us (some
+ *                          cars don't answer with the engine off): at or
+ *                          above charging_v running, below not. Feed ATRV
+ *                          readings on this channel too.
+ *
+ * Samples of other channels don't vote, but do count as data: a trip
+ * ends when the engine has been off for end_after_us, when no sample at
+ * all has come for gap_us, or when the run time goes backwards.
+ *
+ * "pos" is whatever says where a sample is in the log (a journal seq, a
+ * byte offset, a row number); trips carry the first and last, so a
+ * query can jump straight to trip N.
+ */
+#define OBD_TRIP_EVENTS         16     /* Start/idle/end events waiting for poll */
+
+#define OBD_TRIP_RPM          0x0C
+#define OBD_TRIP_SPEED        0x0D
+#define OBD_TRIP_RUN_TIME     0x1F
+#define OBD_TRIP_VOLTAGE      0x42
+
+typedef enum {
+    OBD_TRIP_OFF,
+    OBD_TRIP_ON,
+    OBD_TRIP_STOPPING           /* Engine off, end_after_us not reached yet */
+} obd_trip_state_t;
+
+typedef enum {
+    OBD_TRIP_END_NONE,          /* Still going */
+    OBD_TRIP_END_ENGINE_OFF,
+    OBD_TRIP_END_RESTART,       /* Run time since start went backwards */
+    OBD_TRIP_END_GAP,           /* No samples for gap_us */
+    OBD_TRIP_END_FLUSH          /* The log ended with the engine running */
+} obd_trip_end_t;
+
+#define OBD_TRIP_OPEN_START   0x01     /* Running from the very first vote */
+
+typedef struct {
+    uint32_t number;                        /* 1, 2, ... (trips + 1 when it started) */
+    uint8_t  end_reason;                    /* obd_trip_end_t */
+    uint8_t  flags;                         /* OBD_TRIP_OPEN_START */
+    uint64_t start_us, end_us;
+    uint64_t start_pos, end_pos;            /* First and last sample, in the caller's terms */
+    uint64_t idle_us;                       /* Time standing still with the engine on ... */
+    uint32_t idle_periods;                  /* ... in stretches of idle_after_us or more */
+    uint32_t samples;
+    float    distance_km;                   /* Speed integrated over time */
+    float    max_speed, max_rpm;
+    float    min_voltage, max_voltage;      /* 0 if none */
+    float    run_time_s;                    /* Last non-zero PID 1F value, 0 if none */
+} obd_trip_summary_t;
+
+typedef enum {
+    OBD_TRIP_EVENT_START,
+    OBD_TRIP_EVENT_IDLE,                    /* An idle period reached idle_after_us */
+    OBD_TRIP_EVENT_END
+} obd_trip_event_kind_t;
+
+typedef struct {
+    uint8_t  kind;                          /* obd_trip_event_kind_t */
+    uint64_t t_us;
+    obd_trip_summary_t trip;                /* As it was then; final for END */
+} obd_trip_event_t;
+
+typedef struct {
+    /* Settings: obd_trip_init() fills in defaults; change them before feeding */
+    float    rpm_on;                        /* 300 rpm */
+    float    charging_v;                    /* 13.2 V */
+    float    idle_speed;                    /* 1 km/h */
+    uint64_t end_after_us;                  /* 60 s */
+    uint64_t gap_us;                        /* 30 s */
+    uint64_t idle_after_us;                 /* 10 s */
+
+    uint8_t  state;                         /* obd_trip_state_t */
+    uint32_t trips;                         /* Started so far (set it to continue a count) */
+    obd_trip_summary_t current;             /* While state != OFF */
+    uint8_t  voted;                         /* Some sample has voted */
+    uint8_t  idle, idle_counted;
+    uint64_t idle_since_us;
+    uint64_t off_since_us, off_pos;         /* STOPPING: the first "off" sample */
+
+    uint8_t  have_last, have_speed, have_rpm, have_run_time;
+    uint64_t last_t_us, last_pos;           /* Latest sample, any channel */
+    float    speed, run_time;
+    uint64_t speed_t_us, rpm_t_us;
+
+    obd_trip_event_t events[OBD_TRIP_EVENTS];       /* Ring */
+    size_t   event_head, event_count;
+    uint64_t events_lost;                   /* Ring was full */
+} obd_trip_t;
+
+
+/* ── Adaptive polling ────────────────────────────────────────────────────────
+ *
+ * Which PID to ask for next, and how often. Each PID has a resolution
+ * (the smallest change worth seeing: 1 °C, 50 rpm) and an interval that
+ * moves between min_us and max_us as its values come in:
+ *
+ *   - the level and slope (units per second) are tracked; the interval
+ *     aims at the time the value takes to move by one resolution
+ *   - so is the noise: how far samples land from where the slope said
+ *     they would
+ *   - a sample further off than resolution + 2 x noise is a surprise and
+ *     drops the interval to min_us at once; otherwise it grows by half
+ *     per sample towards that aim
+ *
+ * Coolant at 90 °C for an hour settles at max_us; RPM in traffic stays
+ * near min_us. A PID is due once its interval has passed since it was
+ * last sent; the most overdue (time since sent / interval) goes first,
+ * and ties go to the PID added first.
+ */
+#define OBD_SCHED_MAX_PIDS      32
+
+typedef struct {
+    uint8_t  mode, pid;
+    float    resolution;
+    uint64_t min_us, max_us;
+    uint64_t interval_us;                   /* Now */
+
+    uint8_t  sent;                          /* last_sent_us is valid */
+    uint64_t last_sent_us;
+    uint8_t  samples;                       /* 0, 1, or 2 (slope known) */
+    float    level;                         /* Smoothed value ... */
+    uint64_t t_us;                          /* ... at the last sample's time */
+    float    slope;                         /* Units per second, smoothed */
+    float    noise;                         /* Mean distance from the prediction */
+
+    uint64_t polls;                         /* Sent */
+    uint64_t fixed_polls;                   /* Would have been sent every min_us */
+    uint64_t credit_us;                     /* Towards the next of those */
+    uint64_t surprises;
+} obd_sched_entry_t;
+
+typedef struct {
+    size_t   count;
+    obd_sched_entry_t entries[OBD_SCHED_MAX_PIDS];
+} obd_sched_t;
+
+
+/* ── Change filter ───────────────────────────────────────────────────────────
+ *
+ * Between decoding and whoever wants the values (a screen, a log, an
+ * uplink): only changes get through. Per PID:
+ *
+ *   - a reply whose data bytes are the same as the last one's is stopped
+ *     before it's decoded
+ *   - a value passes if it's moved from the last one passed by more than
+ *     abs_deadband, or by more than rel_deadband x |that value|
+ *   - whatever the value, one passes after keepalive_us without any
+ *     (0 = never), so the far end knows the sensor is still there
+ *
+ * The first value of a PID always passes. PIDs without settings of their
+ * own get the filter's defaults, which pass any change at all. Past
+ * OBD_FILTER_MAX_PIDS different PIDs, the rest pass unfiltered.
+ */
+#define OBD_FILTER_MAX_PIDS     32
+
+typedef struct {
+    uint8_t  pid;
+    float    abs_deadband, rel_deadband;
+    uint64_t keepalive_us;
+
+    uint8_t  raw[OBD_MAX_DATA_BYTES];       /* Last reply's data bytes ... */
+    size_t   raw_len;                       /* ... 0 = none yet */
+    obd_sensor_value_t value;               /* ... and their value */
+    uint8_t  passed;                        /* passed_value is valid */
+    float    passed_value;                  /* The last value let through ... */
+    uint64_t passed_us;                     /* ... and when */
+} obd_filter_entry_t;
+
+typedef struct {
+    /* For PIDs without obd_filter_set(): 0, 0, 0 after obd_filter_init() */
+    float    abs_deadband, rel_deadband;
+    uint64_t keepalive_us;
+
+    size_t   count;
+    obd_filter_entry_t entries[OBD_FILTER_MAX_PIDS];
+
+    uint64_t samples;                       /* Replies filtered */
+    uint64_t unchanged;                     /* ...stopped before decoding */
+    uint64_t passed;                        /* ...let through */
+    uint64_t keepalives;                    /* ...of those, only for keepalive_us */
+} obd_filter_t;
+
+
+/* ── Downsampling ────────────────────────────────────────────────────────────
+ *
+ * A chart is a thousand pixels wide; a trip is hundreds of thousands of
+ * samples. Two ways to draw it with fewer:
+ *
+ *   - obd_lttb() picks the samples that keep the line's shape
+ *     (Largest-Triangle-Three-Buckets), in one pass over the series
+ *   - a min/max pyramid, built once per trip log, gives the lowest and
+ *     highest value under each pixel of any window in O(pixels)
+ *
+ * Level k of the pyramid holds the min and max of every block of
+ * OBD_PYRAMID_BASE x OBD_PYRAMID_FANOUT^k samples, up to a level with a
+ * single block. It's one flat array of floats, level 0 first, in the
+ * caller's buffer, and its layout follows from the sample count alone:
+ * the array can be stored next to the log as it is and attached again.
+ * Samples are assumed evenly spaced (e.g. obd_resample_batch() output).
+ */
+#define OBD_PYRAMID_BASE        8       /* Samples per block at level 0 */
+#define OBD_PYRAMID_FANOUT      4       /* Blocks per block of the next level */
+#define OBD_PYRAMID_LEVELS      16      /* 8 x 4^15: 8.6 billion samples */
+
+typedef struct {
+    const float *data;                      /* min, max per block, level 0 first */
+    size_t   samples;                       /* Length of the series */
+    size_t   levels;
+    size_t   blocks[OBD_PYRAMID_LEVELS];    /* Blocks in each level ... */
+    size_t   offset[OBD_PYRAMID_LEVELS];    /* ... and where it starts in data[] */
+} obd_pyramid_t;
+
+
+/* ── Instrumentation (OBD_ENABLE_STATS) ─────────────────────────────────
+ *
+ * When the library is built with -DOBD_ENABLE_STATS=ON, every public
+ * parse function counts its calls, tallies its return codes, and records
+ * how long it took in a latency histogram. These structs hold a snapshot
+ * of those numbers. With stats disabled they're simply always zero.
+ *
+ * Latency is recorded in "ticks" of the cheapest clock the CPU offers
+ * (TSC on x86, CNTVCT on ARM64). ticks_per_us converts them to time.
+ *
+ * The histogram is log-linear ("HDR-style"): 8 linear sub-buckets per
+ * power of two. Every bucket is at most 12.5% wide relative to its
+ * value, whether that value is 40 ns or 40 ms.
+ */
+typedef enum {
+    OBD_STAT_HEX_TO_BYTES,
+    OBD_STAT_BYTES_TO_HEX,
+    OBD_STAT_CLASSIFY,
+    OBD_STAT_CLEAN,
+    OBD_STAT_PID_BUILD,
+    OBD_STAT_PID_PARSE,
+    OBD_STAT_SENSOR_DECODE,
+    OBD_STAT_DTC_PARSE,
+    OBD_STAT_VIN_PARSE,
+    OBD_STAT_REASSEMBLE,
+    OBD_STAT_MONITOR_PARSE,
+    OBD_STAT_INFO_PARSE,
+    OBD_STAT_FREEZE_PARSE,
+    OBD_STAT_READINESS_DECODE,
+    OBD_STAT_FN_COUNT          /* Number of instrumented functions */
+} obd_stat_fn_t;
+
+#define OBD_STAT_RESULT_SLOTS   16   /* results[-r] for r = 0, -1, -2, ... */
+#define OBD_STAT_SUB_BUCKETS     8   /* Linear sub-buckets per power of two */
+#define OBD_STAT_HIST_BUCKETS  240   /* Covers 0 .. 2^32 ticks */
+
+typedef struct {
+    uint64_t calls;
+    uint64_t results[OBD_STAT_RESULT_SLOTS]; /* Index = -obd_result_t */
+    uint64_t total_ticks;
+    uint64_t max_ticks;
+    uint64_t hist[OBD_STAT_HIST_BUCKETS];
+} obd_stat_counters_t;
+
+typedef struct {
+    obd_stat_counters_t fn[OBD_STAT_FN_COUNT];
+    double              ticks_per_us;   /* 0 when stats are compiled out */
+} obd_stats_t;
+
+
+/* ── Round-trip tracing ──────────────────────────────────────────────────
+ *
+ * Every request a session sends goes through the same points in time:
+ *
+ *   ENQUEUE      you called obd_session_submit_*()
+ *   WRITE_START  the session handed the command out to be written
+ *   WRITE_DONE   you told the session the write finished
+ *   FIRST_BYTE   first byte of the reply arrived
+ *   LAST_BYTE    last byte before the ">" prompt arrived
+ *   PROMPT       ">" arrived — the adapter is done
+ *   PARSED       the reply was cleaned and parsed
+ *   DECODED      the sensor formula was applied (Mode 01 only)
+ *
+ * The gaps between them are the PHASES we histogram. Knowing which phase
+ * eats the time tells you what to tune: a long PROMPT phase means the
+ * adapter is waiting out its own timeout for more ECUs to answer.
+ *
+ * All times are in microseconds from whatever monotonic clock you feed
+ * the session.
+ */
+typedef enum {
+    OBD_TRACE_ENQUEUE,
+    OBD_TRACE_WRITE_START,
+    OBD_TRACE_WRITE_DONE,
+    OBD_TRACE_FIRST_BYTE,
+    OBD_TRACE_LAST_BYTE,
+    OBD_TRACE_PROMPT,
+    OBD_TRACE_PARSED,
+    OBD_TRACE_DECODED,
+    OBD_TRACE_POINT_COUNT
+} obd_trace_point_t;
+
+typedef enum {
+    OBD_PHASE_QUEUE,        /* ENQUEUE     → WRITE_START  waiting our turn   */
+    OBD_PHASE_WRITE,        /* WRITE_START → WRITE_DONE   Bluetooth/serial write */
+    OBD_PHASE_ECU,          /* WRITE_DONE  → FIRST_BYTE   bus + ECU response */
+    OBD_PHASE_RECEIVE,      /* FIRST_BYTE  → LAST_BYTE    reply streaming in */
+    OBD_PHASE_ADAPTER,      /* LAST_BYTE   → PROMPT       adapter's own timeout */
+    OBD_PHASE_PARSE,        /* PROMPT      → PARSED                          */
+    OBD_PHASE_DECODE,       /* PARSED      → DECODED                         */
+    OBD_PHASE_TOTAL,        /* ENQUEUE     → last point reached              */
+    OBD_PHASE_COUNT
+} obd_trace_phase_t;
+
+#define OBD_TRACE_MAX_KEYS      16   /* Distinct (mode, PID, ECU) combos tracked */
+#define OBD_TRACE_HIST_BUCKETS 176   /* Same log-linear layout as stats, 0 .. 2^23 µs */
+
+/* One finished request: which points it reached and when. */
+typedef struct {
+    uint32_t id;                           /* Request id from the session */
+    uint16_t track;                        /* Session/adapter number (trace "thread") */
+    uint16_t ecu;                          /* CAN id like 0x7E8, 0 = unknown */
+    uint8_t  mode;                         /* 0x01, 0x09... (0 for AT commands) */
+    uint8_t  pid;
+    int8_t   result;                       /* obd_result_t */
+    uint8_t  reached;                      /* Bit n set = t[n] is valid */
+    uint64_t t[OBD_TRACE_POINT_COUNT];     /* µs */
+} obd_trace_record_t;
+
+/* Aggregated numbers for one (mode, PID, ECU). */
+typedef struct {
+    uint8_t  mode;
+    uint8_t  pid;
+    uint16_t ecu;
+    uint32_t count;                        /* Requests that finished */
+    uint32_t errors;                       /* ...with result != OBD_OK */
+    uint32_t timeouts;                     /* ...with OBD_ERROR_TIMEOUT */
+    uint64_t sum_us[OBD_PHASE_COUNT];
+    uint32_t max_us[OBD_PHASE_COUNT];
+    uint32_t hist[OBD_PHASE_COUNT][OBD_TRACE_HIST_BUCKETS];
+} obd_trace_key_t;
+
+/*
+ * A trace collector. ~90 KB — make it static or global, not a local.
+ * Several sessions may share one (each with its own track number).
+ * The record ring is optional caller storage that keeps the last N
+ * requests for the Chrome trace export.
+ */
+typedef struct {
+    obd_trace_key_t     keys[OBD_TRACE_MAX_KEYS];
+    size_t              key_count;
+    uint32_t            untracked;         /* Requests whose key didn't fit */
+    obd_trace_record_t *records;           /* Ring buffer (may be NULL) */
+    size_t              record_cap;
+    size_t              record_next;       /* Where the next record goes */
+    uint64_t            record_total;      /* Records ever added */
+} obd_trace_t;
+
+
+/* ── Session ─────────────────────────────────────────────────────────────
+ *
+ * An obd_session_t is the request/response loop for one adapter, as a
+ * state machine with NO I/O. You move bytes; it decides what to send
+ * next, recognizes when a reply is complete, parses it and times it.
+ *
+ *   IDLE ──next_command()──▶ WRITING ──write_done()──▶ WAITING
+ *     ▲                                                   │
+ *     └──────────── ">" prompt fed, or timeout ◀──────────┘
+ *
+ * The ELM327 handles one command at a time, so there is at most one
+ * request in flight; the rest wait in a small queue.
+ */
+#define OBD_SESSION_QUEUE_LEN   16   /* Requests waiting to be sent */
+#define OBD_SESSION_DONE_LEN     8   /* Finished results waiting for poll() */
+#define OBD_SESSION_DEFAULT_TIMEOUT_US 1000000u
+
+typedef enum {
+    OBD_SESSION_IDLE,       /* Nothing in flight */
+    OBD_SESSION_WRITING,    /* Command handed out, write not confirmed yet */
+    OBD_SESSION_WAITING,    /* Waiting for the reply and ">" */
+    OBD_SESSION_DRAINING,   /* Timed out; swallowing late bytes until ">" */
+} obd_session_state_t;
+
+typedef struct {
+    uint32_t id;
+    uint8_t  mode;                         /* 0 for AT/raw commands */
+    uint8_t  pid;
+    uint8_t  is_obd;                       /* 1 = hex OBD request, parse reply */
+    char     command[OBD_MAX_COMMAND_LEN]; /* Including the trailing \r */
+    uint64_t enqueued_us;
+} obd_session_request_t;
+
+/* What you get back from obd_session_poll() for each request. */
+typedef struct {
+    uint32_t            id;
+    obd_result_t        status;            /* Clean/parse result or OBD_ERROR_TIMEOUT */
+    uint8_t             mode;
+    uint8_t             pid;
+    uint16_t            ecu;               /* From the CAN header if ATH1, else 0 */
+    char                response[OBD_MAX_RESPONSE_LEN]; /* Cleaned reply, or the adapter's text on error */
+    int                 has_parsed;        /* `parsed` is valid */
+    obd_pid_response_t  parsed;
+    int                 has_value;         /* `value` is valid */
+    obd_sensor_value_t  value;
+    obd_trace_record_t  trace;             /* Timestamps of this request */
+} obd_session_result_t;
+
+typedef uint64_t (*obd_clock_fn)(void *ctx);  /* Returns "now" in µs */
+
+/* Which way bytes went, for a capture hook. */
+typedef enum {
+    OBD_CAPTURE_TX,         /* Command handed out to be written */
+    OBD_CAPTURE_RX,         /* Bytes fed in from the adapter */
+} obd_capture_dir_t;
+
+/* Sees every byte a session sends and receives, raw, as it goes by. */
+typedef void (*obd_capture_fn)(void *ctx, uint8_t dir, const char *data,
+                               size_t len, uint64_t t_us);
+
+typedef struct {
+    obd_session_state_t   state;
+    uint64_t              timeout_us;
+    uint64_t              deadline_us;     /* When the current wait gives up */
+    uint32_t              next_id;
+
+    obd_session_request_t queue[OBD_SESSION_QUEUE_LEN];
+    size_t                queue_head;
+    size_t                queue_count;
+
+    obd_session_request_t current;         /* The request in flight */
+    obd_trace_record_t    times;
+    char                  rx[OBD_MAX_RESPONSE_LEN];
+    size_t                rx_len;
+    int                   rx_overflow;
+
+    obd_session_result_t  done[OBD_SESSION_DONE_LEN];
+    size_t                done_head;
+    size_t                done_count;
+
+    obd_trace_t          *trace;           /* Optional collector */
+    uint16_t              track;
+    obd_clock_fn          clock;           /* Optional, times PARSED/DECODED */
+    void                 *clock_ctx;
+    obd_capture_fn        capture;         /* Optional raw traffic tap */
+    void                 *capture_ctx;
+} obd_session_t;
+
+
+/* ── Response cache ──────────────────────────────────────────────────────
+ *
+ * Some answers never change while the car is running (VIN, calibration
+ * IDs, which PIDs are supported) and some change slowly (coolant
+ * temperature). Asking the adapter again costs a full round trip.
+ *
+ * The cache sits in front of a session. Each request has a time-to-live:
+ * forever, some seconds, or 0 (never cached). A request that's already
+ * on its way to the adapter is not sent twice — the second asker is
+ * given the same request id ("coalescing").
+ */
+#define OBD_CACHE_ENTRIES      32
+#define OBD_CACHE_TTL_RULES    16
+#define OBD_CACHE_INFLIGHT     (OBD_SESSION_QUEUE_LEN + 1)
+#define OBD_CACHE_TTL_FOREVER  UINT64_MAX
+#define OBD_CACHE_ANY_PID      0xFFFF   /* Rule applies to the whole mode */
+
+typedef struct {
+    char                 key[OBD_MAX_COMMAND_LEN]; /* "010C", "0902"; "" = free */
+    uint64_t             expires_us;       /* OBD_CACHE_TTL_FOREVER = never */
+    uint64_t             last_used_us;     /* For least-recently-used eviction */
+    uint32_t             hits;
+    obd_session_result_t result;
+} obd_cache_entry_t;
+
+typedef struct {
+    char     key[OBD_MAX_COMMAND_LEN];     /* "" = free */
+    uint32_t id;                           /* Session request id */
+} obd_cache_inflight_t;
+
+typedef struct {
+    uint8_t  mode;
+    uint16_t pid;                          /* Or OBD_CACHE_ANY_PID */
+    uint64_t ttl_us;
+} obd_cache_ttl_rule_t;
+
+typedef struct {
+    uint64_t hits;          /* Answered from the cache */
+    uint64_t misses;        /* Sent to the adapter */
+    uint64_t coalesced;     /* Joined a request already in flight */
+    uint64_t expired;       /* Found, but too old (then sent or coalesced) */
+    uint64_t stores;        /* Results saved */
+    uint64_t evictions;     /* Entries pushed out to make room */
+    uint64_t passthrough;   /* AT/raw commands, never cached */
+} obd_cache_stats_t;
+
+typedef struct {
+    obd_cache_entry_t    entries[OBD_CACHE_ENTRIES];
+    obd_cache_inflight_t inflight[OBD_CACHE_INFLIGHT];
+    obd_cache_ttl_rule_t rules[OBD_CACHE_TTL_RULES];
+    size_t               rule_count;
+    obd_cache_stats_t    stats;
+} obd_cache_t;
+
+
 #ifdef __cplusplus
 }
 #endif
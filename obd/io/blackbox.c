@@ -0,0 +1,773 @@
+/**
+ * blackbox.c — A crash-safe, always-on recorder of adapter traffic.
+ *
+ * When a rule fires or a DTC appears, the interesting part is what
+ * happened just before: the minute of traffic nobody thought to keep.
+ * So everything is kept, in a ring that forgets the oldest records as
+ * new ones arrive, and a trigger copies the minutes around the event out
+ * to a file of its own.
+ *
+ * The ring lives in a file mapped with MAP_SHARED. Appending is a memcpy
+ * into the mapping: no write(), no fsync, no allocation. The kernel owns
+ * those pages, so when the process crashes they still reach the file;
+ * only a power cut needs obd_blackbox_sync().
+ *
+ *   file:  [ header page | ring ............................... ]
+ *   ring:  ... r17 | r18 | r19 | r20 | free ... | r9 | r10 | ...
+ *                                  ▲ head          ▲ tail
+ *
+ * Every record is a 32-byte header (magic, type, length, sequence
+ * number, time, FNV-1a checksum) and its payload, padded to 8 bytes.
+ * Sequence numbers count records from 1 with no gaps.
+ * A record never straddles the end of the ring: one that doesn't fit is
+ * preceded by a PAD record filling the rest (or, for less than a header's
+ * worth, by nothing — the reader skips that tail too) and goes at 0.
+ *
+ * Where head and tail are is never written down; it would cost a store
+ * and a flush on every append. On open they're found again: the newest
+ * record is the valid one with the highest sequence number, and the
+ * oldest is where the unbroken run of sequence numbers that ends at the
+ * newest begins. A record half-written when the process died fails its
+ * checksum and breaks the run, so it, and nothing before it, is lost.
+ *
+ * Window files are written by obd_blackbox_tick(), not by the append
+ * path: a trigger only notes what to write and when. The note goes into
+ * a slot of the header page, through the same mapping as the records, so
+ * a window whose tick never came (the process died first) is armed again
+ * by the next open. Files are written to path.tmp, synced and renamed,
+ * so a reader never sees half a window.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "blackbox.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FILE_MAGIC      "OBDBBOX1"
+#define WINDOW_MAGIC    "OBDBBWIN"
+#define FILE_VERSION    1
+#define HEADER_PAGE     4096
+#define REC_MAGIC       0xB0C5u
+#define REC_PAD         0xFF
+#define SAMPLE_LEN      8               /* uint16 channel, 2 spare, float */
+#define PENDING_MAGIC   0x444E4550u     /* "PEND" */
+#define PENDING_OFFSET  64              /* Slots start here in the header page */
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t data_offset;               /* Where the ring starts */
+    uint64_t capacity;
+} file_header_t;
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t trigger_us;
+    uint64_t from_us;
+    uint64_t to_us;
+    uint64_t records;
+    char     reason[OBD_BLACKBOX_REASON_LEN];
+} window_header_t;
+
+typedef struct {
+    uint16_t magic;
+    uint8_t  type;
+    uint8_t  reserved;
+    uint32_t len;                       /* Payload bytes (PAD: bytes skipped) */
+    uint64_t seq;
+    uint64_t t_us;
+    uint32_t check;                     /* FNV-1a of header (check = 0) + payload */
+    uint32_t reserved2;
+} rec_t;
+
+/* A window waiting for its tick, in a slot of the header page */
+typedef struct {
+    uint32_t magic;                     /* PENDING_MAGIC; anything else = free */
+    uint32_t check;                     /* FNV-1a of the slot (check = 0) */
+    uint64_t trigger_us;
+    uint64_t from_us;
+    uint64_t to_us;
+    char     reason[OBD_BLACKBOX_REASON_LEN];
+    char     path[OBD_BLACKBOX_PATH_LEN];
+} pending_t;
+
+_Static_assert(PENDING_OFFSET + OBD_BLACKBOX_TRIGGERS * sizeof(pending_t) <= HEADER_PAGE,
+               "pending windows must fit in the header page");
+
+/* Walks the records between tail and head */
+typedef struct {
+    size_t pos;
+    size_t left;
+} cursor_t;
+
+
+/* ── Records ─────────────────────────────────────────────────────────── */
+
+static size_t rec_size(size_t len)
+{
+    return (sizeof(rec_t) + len + 7) & ~(size_t)7;
+}
+
+static uint32_t fnv1a(uint32_t h, const uint8_t *p, size_t n)
+{
+    while (n--) {
+        h ^= *p++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* A PAD's payload is whatever was there before: only its header counts */
+static uint32_t checksum(const rec_t *r, const uint8_t *payload)
+{
+    rec_t h = *r;
+    h.check = 0;
+    return fnv1a(fnv1a(2166136261u, (const uint8_t *)&h, sizeof(h)),
+                 payload, r->type == REC_PAD ? 0 : r->len);
+}
+
+/* Is there a whole, intact record at p, ending within `room` bytes? */
+static int valid_at(const uint8_t *p, size_t room, rec_t *out)
+{
+    rec_t r;
+
+    if (room < sizeof(r)) return 0;
+    memcpy(&r, p, sizeof(r));
+    if (r.magic != REC_MAGIC || r.seq == 0) return 0;
+    if (r.type != REC_PAD && r.len > OBD_BLACKBOX_PAYLOAD) return 0;
+    if (r.len > room || rec_size(r.len) > room) return 0;
+    if (checksum(&r, p + sizeof(r)) != r.check) return 0;
+    *out = r;
+    return 1;
+}
+
+static void to_record(const rec_t *r, const uint8_t *payload, obd_blackbox_record_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->type = r->type;
+    out->seq = r->seq;
+    out->t_us = r->t_us;
+    if (r->type == OBD_BLACKBOX_SAMPLE && r->len == SAMPLE_LEN) {
+        memcpy(&out->channel, payload, sizeof(out->channel));
+        memcpy(&out->value, payload + 4, sizeof(out->value));
+    } else {
+        out->data = (const char *)payload;
+        out->len = r->len;
+    }
+}
+
+
+/* ── The ring ────────────────────────────────────────────────────────── */
+
+/* Forget the oldest record (or the unusable bytes before the wrap) */
+static void drop_oldest(obd_blackbox_t *bb)
+{
+    size_t size = bb->capacity - bb->tail;
+    rec_t r;
+
+    if (size >= sizeof(r)) {
+        memcpy(&r, bb->ring + bb->tail, sizeof(r));
+        size = rec_size(r.len);
+        if (r.type != REC_PAD) bb->overwritten++;
+    }
+    bb->tail += size;
+    if (bb->tail == bb->capacity) bb->tail = 0;
+    bb->used -= size;
+}
+
+/* The free space starts at head: make the first `size` bytes of it free */
+static void make_room(obd_blackbox_t *bb, size_t size)
+{
+    while (bb->used + size > bb->capacity) {
+        drop_oldest(bb);
+    }
+}
+
+static void write_rec(obd_blackbox_t *bb, uint8_t type, const void *data, size_t len,
+                      uint64_t t_us)
+{
+    uint8_t *at = bb->ring + bb->head;
+    rec_t r;
+
+    memset(&r, 0, sizeof(r));
+    r.magic = REC_MAGIC;
+    r.type = type;
+    r.len = (uint32_t)len;
+    r.seq = type == REC_PAD ? bb->next_seq : bb->next_seq++;
+    r.t_us = t_us;
+    r.check = checksum(&r, data);
+
+    if (type != REC_PAD) memcpy(at + sizeof(r), data, len);
+    memcpy(at, &r, sizeof(r));
+}
+
+static void append(obd_blackbox_t *bb, uint8_t type, const void *data, size_t len,
+                   uint64_t t_us)
+{
+    size_t size = rec_size(len);
+    size_t gap = bb->capacity - bb->head;
+
+    if (gap < size) {
+        make_room(bb, gap);
+        if (gap >= sizeof(rec_t)) {
+            write_rec(bb, REC_PAD, NULL, gap - sizeof(rec_t), t_us);
+        }
+        bb->used += gap;
+        bb->head = 0;
+    }
+    make_room(bb, size);
+    write_rec(bb, type, data, len, t_us);
+    bb->head += size;
+    if (bb->head == bb->capacity) bb->head = 0;
+    bb->used += size;
+    bb->records++;
+}
+
+/* The next non-PAD record, oldest first. 0 at the end. */
+static int next_rec(const obd_blackbox_t *bb, cursor_t *c, rec_t *r, const uint8_t **at)
+{
+    while (c->left > 0) {
+        size_t room = bb->capacity - c->pos;
+        size_t size;
+
+        if (room < sizeof(*r)) {
+            c->left -= room;
+            c->pos = 0;
+            continue;
+        }
+        *at = bb->ring + c->pos;
+        memcpy(r, *at, sizeof(*r));
+        size = rec_size(r->len);
+        c->pos += size;
+        if (c->pos == bb->capacity) c->pos = 0;
+        c->left -= size;
+        if (r->type != REC_PAD) return 1;
+    }
+    return 0;
+}
+
+/* Find head and tail again in a ring left by an earlier run */
+static void recover(obd_blackbox_t *bb)
+{
+    size_t pos = 0, newest_at = 0, walked = 0, run_from = 0, step;
+    uint64_t newest = 0, expect = 0, run_records = 0;
+    rec_t r;
+
+    bb->next_seq = 1;
+
+    /* The newest record anywhere */
+    while (pos < bb->capacity) {
+        if (valid_at(bb->ring + pos, bb->capacity - pos, &r)) {
+            if (r.seq > newest) {
+                newest = r.seq;
+                newest_at = pos;
+            }
+            pos += rec_size(r.len);
+        } else {
+            pos += 8;
+        }
+    }
+    if (newest == 0) return;
+
+    memcpy(&r, bb->ring + newest_at, sizeof(r));
+    bb->head = newest_at + rec_size(r.len);
+    if (bb->head == bb->capacity) bb->head = 0;
+    bb->next_seq = newest + 1;
+
+    /* Once round from just after it: the run that ends at it starts at the tail */
+    pos = bb->head;
+    bb->tail = pos;
+    for (;;) {
+        size_t room = bb->capacity - pos;
+
+        if (room < sizeof(r)) {
+            walked += room;
+            pos = 0;
+            continue;
+        }
+        if (valid_at(bb->ring + pos, room, &r)) {
+            if (r.seq != expect) {
+                bb->tail = pos;
+                run_from = walked;
+                run_records = 0;
+            }
+            /* A PAD shares its number with the record after it */
+            expect = r.type == REC_PAD ? r.seq : r.seq + 1;
+            if (r.type != REC_PAD) run_records++;
+            step = rec_size(r.len);
+            if (pos == newest_at) break;
+        } else {
+            expect = 0;
+            step = 8;
+        }
+        pos += step;
+        walked += step;
+        if (pos == bb->capacity) pos = 0;
+    }
+    bb->used = walked + step - run_from;
+    bb->recovered = run_records;
+}
+
+
+/* ── Pending windows ─────────────────────────────────────────────────── */
+
+static uint32_t pending_check(const pending_t *p)
+{
+    pending_t h = *p;
+    h.check = 0;
+    return fnv1a(2166136261u, (const uint8_t *)&h, sizeof(h));
+}
+
+/* Is slot i in use? A slot torn by a crash while it was written isn't. */
+static int pending_at(const obd_blackbox_t *bb, size_t i, pending_t *out)
+{
+    memcpy(out, bb->map + PENDING_OFFSET + i * sizeof(*out), sizeof(*out));
+    return out->magic == PENDING_MAGIC && out->check == pending_check(out) &&
+           out->reason[sizeof(out->reason) - 1] == '\0' &&
+           out->path[sizeof(out->path) - 1] == '\0' && out->path[0] != '\0';
+}
+
+static int same_window(const pending_t *p, const obd_blackbox_window_t *w)
+{
+    return p->trigger_us == w->trigger_us && p->from_us == w->from_us &&
+           p->to_us == w->to_us && strcmp(p->path, w->path) == 0;
+}
+
+/* Note a new window in a free slot; there is one while window_count < TRIGGERS */
+static void persist(obd_blackbox_t *bb, const obd_blackbox_window_t *w)
+{
+    pending_t p;
+    size_t i;
+
+    for (i = 0; i < OBD_BLACKBOX_TRIGGERS; i++) {
+        if (pending_at(bb, i, &p)) continue;
+        memset(&p, 0, sizeof(p));
+        p.magic = PENDING_MAGIC;
+        p.trigger_us = w->trigger_us;
+        p.from_us = w->from_us;
+        p.to_us = w->to_us;
+        memcpy(p.reason, w->reason, sizeof(p.reason));
+        memcpy(p.path, w->path, sizeof(p.path));
+        p.check = pending_check(&p);
+        memcpy(bb->map + PENDING_OFFSET + i * sizeof(p), &p, sizeof(p));
+        return;
+    }
+}
+
+/* The window has been written (or given up on): free its slot */
+static void forget(obd_blackbox_t *bb, const obd_blackbox_window_t *w)
+{
+    pending_t p;
+    size_t i;
+
+    for (i = 0; i < OBD_BLACKBOX_TRIGGERS; i++) {
+        if (pending_at(bb, i, &p) && same_window(&p, w)) {
+            memset(bb->map + PENDING_OFFSET + i * sizeof(p), 0, sizeof(p.magic));
+            return;
+        }
+    }
+}
+
+/* Windows an earlier run triggered but never wrote */
+static void rearm(obd_blackbox_t *bb)
+{
+    obd_blackbox_window_t *w;
+    pending_t p;
+    size_t i;
+
+    for (i = 0; i < OBD_BLACKBOX_TRIGGERS; i++) {
+        if (!pending_at(bb, i, &p)) continue;
+        w = &bb->windows[bb->window_count++];
+        memset(w, 0, sizeof(*w));
+        w->trigger_us = p.trigger_us;
+        w->from_us = p.from_us;
+        w->to_us = p.to_us;
+        memcpy(w->reason, p.reason, sizeof(w->reason));
+        memcpy(w->path, p.path, sizeof(w->path));
+        bb->windows_recovered++;
+    }
+}
+
+
+/* ── Opening ─────────────────────────────────────────────────────────── */
+
+/* Close fd without letting close() overwrite the errno we're reporting */
+static obd_result_t fail(int fd, obd_result_t result)
+{
+    int saved = errno;
+    if (fd >= 0) close(fd);
+    errno = saved;
+    return result;
+}
+
+obd_result_t obd_blackbox_open(obd_blackbox_t *bb, const char *path, size_t capacity)
+{
+    file_header_t hdr;
+    struct stat st;
+    int fd, fresh = 0;
+
+    if (!bb || !path) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(bb, 0, sizeof(*bb));
+
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0 && errno == ENOENT) {
+        capacity &= ~(size_t)7;
+        if (capacity < OBD_BLACKBOX_MIN_SIZE) {
+            return OBD_ERROR_INVALID_ARG;
+        }
+        fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        fresh = 1;
+    }
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        return fail(fd, OBD_ERROR_IO);
+    }
+
+    if (fresh) {
+        if (ftruncate(fd, (off_t)(HEADER_PAGE + capacity)) < 0) {
+            return fail(fd, OBD_ERROR_IO);
+        }
+    } else {
+        if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+            memcmp(hdr.magic, FILE_MAGIC, sizeof(hdr.magic)) != 0 ||
+            hdr.version != FILE_VERSION || hdr.data_offset != HEADER_PAGE ||
+            hdr.capacity < OBD_BLACKBOX_MIN_SIZE || hdr.capacity % 8 != 0 ||
+            (uint64_t)st.st_size < HEADER_PAGE + hdr.capacity) {
+            return fail(fd, OBD_ERROR_PARSE_FAILED);
+        }
+        capacity = (size_t)hdr.capacity;
+    }
+
+    bb->map_size = HEADER_PAGE + capacity;
+    bb->map = mmap(NULL, bb->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (bb->map == MAP_FAILED) {
+        bb->map = NULL;
+        return fail(fd, OBD_ERROR_IO);
+    }
+    close(fd);
+
+    bb->ring = bb->map + HEADER_PAGE;
+    bb->capacity = capacity;
+
+    if (fresh) {
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, FILE_MAGIC, sizeof(hdr.magic));
+        hdr.version = FILE_VERSION;
+        hdr.data_offset = HEADER_PAGE;
+        hdr.capacity = capacity;
+        memcpy(bb->map, &hdr, sizeof(hdr));
+        msync(bb->map, HEADER_PAGE, MS_SYNC);
+    }
+    recover(bb);
+    rearm(bb);
+    return OBD_OK;
+}
+
+void obd_blackbox_close(obd_blackbox_t *bb)
+{
+    if (!bb) return;
+    if (bb->map) munmap(bb->map, bb->map_size);
+    memset(bb, 0, sizeof(*bb));
+}
+
+
+/* ── Recording ───────────────────────────────────────────────────────── */
+
+void obd_blackbox_capture(void *ctx, uint8_t dir, const char *data, size_t len,
+                          uint64_t t_us)
+{
+    obd_blackbox_t *bb = ctx;
+
+    if (!bb || !bb->map || !data || dir > OBD_CAPTURE_RX) return;
+
+    while (len > 0) {
+        size_t n = len < OBD_BLACKBOX_PAYLOAD ? len : OBD_BLACKBOX_PAYLOAD;
+        append(bb, dir, data, n, t_us);
+        data += n;
+        len -= n;
+    }
+}
+
+obd_result_t obd_blackbox_sample(obd_blackbox_t *bb, uint16_t channel, float value,
+                                 uint64_t t_us)
+{
+    uint8_t payload[SAMPLE_LEN];
+
+    if (!bb || !bb->map) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(payload, 0, sizeof(payload));
+    memcpy(payload, &channel, sizeof(channel));
+    memcpy(payload + 4, &value, sizeof(value));
+    append(bb, OBD_BLACKBOX_SAMPLE, payload, sizeof(payload), t_us);
+    return OBD_OK;
+}
+
+obd_result_t obd_blackbox_result(obd_blackbox_t *bb, const obd_session_result_t *result,
+                                 uint64_t t_us)
+{
+    if (!result) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (!result->has_value) {
+        return OBD_ERROR_NO_DATA;
+    }
+    return obd_blackbox_sample(bb, result->pid, (float)result->value.value, t_us);
+}
+
+obd_result_t obd_blackbox_sync(obd_blackbox_t *bb)
+{
+    if (!bb || !bb->map) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    return msync(bb->map, bb->map_size, MS_SYNC) == 0 ? OBD_OK : OBD_ERROR_IO;
+}
+
+obd_result_t obd_blackbox_walk(const obd_blackbox_t *bb, obd_blackbox_record_fn fn,
+                               void *ctx)
+{
+    cursor_t c;
+    rec_t r;
+    const uint8_t *at;
+    obd_blackbox_record_t rec;
+
+    if (!bb || !bb->map || !fn) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    c.pos = bb->tail;
+    c.left = bb->used;
+    while (next_rec(bb, &c, &r, &at)) {
+        to_record(&r, at + sizeof(r), &rec);
+        fn(ctx, &rec);
+    }
+    return OBD_OK;
+}
+
+
+/* ── Windows ─────────────────────────────────────────────────────────── */
+
+obd_result_t obd_blackbox_trigger(obd_blackbox_t *bb, uint64_t t_us, uint64_t pre_us,
+                                  uint64_t post_us, const char *path, const char *reason)
+{
+    obd_blackbox_window_t *w;
+
+    if (!bb || !bb->map || !path || !*path) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (strlen(path) + sizeof(".tmp") > OBD_BLACKBOX_PATH_LEN) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    if (bb->window_count >= OBD_BLACKBOX_TRIGGERS) {
+        return OBD_ERROR_BUSY;
+    }
+    if (!reason) reason = "";
+
+    w = &bb->windows[bb->window_count++];
+    memset(w, 0, sizeof(*w));
+    w->trigger_us = t_us;
+    w->from_us = t_us > pre_us ? t_us - pre_us : 0;
+    w->to_us = t_us + post_us;
+    strncpy(w->reason, reason, sizeof(w->reason) - 1);
+    strcpy(w->path, path);
+
+    persist(bb, w);
+    append(bb, OBD_BLACKBOX_MARK, w->reason, strlen(w->reason), t_us);
+    return OBD_OK;
+}
+
+static int write_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* After a rename, the directory entry needs syncing too */
+static void sync_dir(const char *path)
+{
+    char dir[OBD_BLACKBOX_PATH_LEN];
+    const char *slash = strrchr(path, '/');
+    int fd;
+
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if (slash == path) {
+        strcpy(dir, "/");
+    } else {
+        memcpy(dir, path, (size_t)(slash - path));
+        dir[slash - path] = '\0';
+    }
+    fd = open(dir, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+static obd_result_t write_window(const obd_blackbox_t *bb, const obd_blackbox_window_t *w)
+{
+    char tmp[OBD_BLACKBOX_PATH_LEN + 8];
+    uint8_t buf[16384];
+    size_t buf_len = 0;
+    window_header_t hdr;
+    cursor_t c;
+    rec_t r;
+    const uint8_t *at;
+    int fd;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, WINDOW_MAGIC, sizeof(hdr.magic));
+    hdr.version = FILE_VERSION;
+    hdr.trigger_us = w->trigger_us;
+    hdr.from_us = w->from_us;
+    hdr.to_us = w->to_us;
+    memcpy(hdr.reason, w->reason, sizeof(hdr.reason));
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", w->path);
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return OBD_ERROR_IO;
+    }
+    if (write_all(fd, &hdr, sizeof(hdr)) < 0) {
+        goto failed;
+    }
+
+    /* The records, byte for byte as they are in the ring */
+    c.pos = bb->tail;
+    c.left = bb->used;
+    while (next_rec(bb, &c, &r, &at)) {
+        size_t size = rec_size(r.len);
+
+        if (r.t_us < w->from_us || r.t_us > w->to_us) continue;
+        if (buf_len + size > sizeof(buf)) {
+            if (write_all(fd, buf, buf_len) < 0) goto failed;
+            buf_len = 0;
+        }
+        memcpy(buf + buf_len, at, size);
+        buf_len += size;
+        hdr.records++;
+    }
+    if (write_all(fd, buf, buf_len) < 0 ||
+        pwrite(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        fsync(fd) < 0) {
+        goto failed;
+    }
+    if (close(fd) < 0 || rename(tmp, w->path) < 0) {
+        fd = -1;
+        goto failed;
+    }
+    sync_dir(w->path);
+    return OBD_OK;
+
+failed:
+    fail(fd, OBD_OK);
+    unlink(tmp);
+    return OBD_ERROR_IO;
+}
+
+obd_result_t obd_blackbox_tick(obd_blackbox_t *bb, uint64_t now_us)
+{
+    obd_result_t result = OBD_OK;
+    size_t i = 0;
+
+    if (!bb || !bb->map) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    while (i < bb->window_count) {
+        if (now_us < bb->windows[i].to_us) {
+            i++;
+            continue;
+        }
+        if (write_window(bb, &bb->windows[i]) == OBD_OK) {
+            bb->windows_written++;
+        } else {
+            bb->windows_failed++;
+            result = OBD_ERROR_IO;
+        }
+        forget(bb, &bb->windows[i]);
+        bb->window_count--;
+        memmove(&bb->windows[i], &bb->windows[i + 1],
+                (bb->window_count - i) * sizeof(bb->windows[0]));
+    }
+    return result;
+}
+
+obd_result_t obd_blackbox_read_file(const char *path, obd_blackbox_window_t *info,
+                                    obd_blackbox_record_fn fn, void *ctx)
+{
+    window_header_t hdr;
+    obd_blackbox_record_t rec;
+    rec_t r;
+    struct stat st;
+    const uint8_t *map;
+    size_t size, pos;
+    uint64_t count = 0;
+    obd_result_t result = OBD_OK;
+    int fd;
+
+    if (!path) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        return fail(fd, OBD_ERROR_IO);
+    }
+    size = (size_t)st.st_size;
+    if (size < sizeof(hdr)) {
+        return fail(fd, OBD_ERROR_PARSE_FAILED);
+    }
+    map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return fail(fd, OBD_ERROR_IO);
+    }
+    close(fd);
+
+    memcpy(&hdr, map, sizeof(hdr));
+    if (memcmp(hdr.magic, WINDOW_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != FILE_VERSION) {
+        munmap((void *)map, size);
+        return OBD_ERROR_PARSE_FAILED;
+    }
+    if (info) {
+        memset(info, 0, sizeof(*info));
+        info->trigger_us = hdr.trigger_us;
+        info->from_us = hdr.from_us;
+        info->to_us = hdr.to_us;
+        info->records = hdr.records;
+        memcpy(info->reason, hdr.reason, sizeof(info->reason) - 1);
+        strncpy(info->path, path, sizeof(info->path) - 1);
+    }
+
+    for (pos = sizeof(hdr); pos < size; pos += rec_size(r.len)) {
+        if (!valid_at(map + pos, size - pos, &r) || r.type == REC_PAD) {
+            result = OBD_ERROR_PARSE_FAILED;
+            break;
+        }
+        to_record(&r, map + pos + sizeof(r), &rec);
+        if (fn) fn(ctx, &rec);
+        count++;
+    }
+    if (result == OBD_OK && count != hdr.records) {
+        result = OBD_ERROR_PARSE_FAILED;
+    }
+    munmap((void *)map, size);
+    return result;
+}
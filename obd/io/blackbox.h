@@ -0,0 +1,10 @@
+/**
+ * blackbox.h — Internal header for the black-box recorder.
+ */
+
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include <obd/obd_io.h>
+
+#endif /* BLACKBOX_H */
@@ -0,0 +1,384 @@
+/**
+ * emu.c — A pretend ELM327 plugged into a pretend car.
+ *
+ * Testing the session, the cache or the multiplexer against a real
+ * adapter means a car in the loop. The emulator answers the way an
+ * ELM327 v1.5 on a CAN car does, closely enough that code can't tell:
+ *
+ *   "ATE0\r"   → "ATE0\rOK\r\r>"          (echo was still on)
+ *   "010C\r"   → "41 0C 1A F8\r\r>"
+ *   "010C0D\r" → "41 0C 1A F8 0D 3C\r\r>"  (multi-PID)
+ *   "0100\r"   → "41 00 18 3B 80 13\r\r>"  (computed from the PID table)
+ *
+ * It's pure logic like the rest of the library — bytes in, bytes out —
+ * so the same emulator runs in-process in a test or behind a socket or
+ * pty in obd_emud.
+ *
+ * Simplifications: replies longer than one CAN frame are still printed
+ * on one line (a real adapter splits them into numbered ISO-TP frames),
+ * and Mode 03 uses the pre-CAN layout without a count byte, which is
+ * what obd_dtc_parse_response() expects.
+ */
+
+#include "emu.h"
+#include "appender.h"
+#include <obd/obd_io.h>
+#include <string.h>
+
+#define ELM_VERSION "ELM327 v1.5"
+
+/* A warm, idling car */
+static const struct { uint8_t pid; uint8_t len; uint8_t data[4]; } default_pids[] = {
+    { 0x04, 1, { 0x3F } },              /* Engine load 24.7% */
+    { 0x05, 1, { 0x7B } },              /* Coolant 83 °C */
+    { 0x0B, 1, { 0x21 } },              /* Intake manifold 33 kPa */
+    { 0x0C, 2, { 0x1A, 0xF8 } },        /* RPM 1726 */
+    { 0x0D, 1, { 0x3C } },              /* Speed 60 km/h */
+    { 0x0F, 1, { 0x44 } },              /* Intake air 28 °C */
+    { 0x10, 2, { 0x01, 0xF4 } },        /* MAF 5.0 g/s */
+    { 0x11, 1, { 0x26 } },              /* Throttle 14.9% */
+    { 0x1C, 1, { 0x06 } },              /* OBD standard: EOBD */
+    { 0x1F, 2, { 0x04, 0xB0 } },        /* Run time 1200 s */
+    { 0x2F, 1, { 0x99 } },              /* Fuel level 60% */
+    { 0x33, 1, { 0x65 } },              /* Barometric 101 kPa */
+    { 0x46, 1, { 0x3A } },              /* Ambient 18 °C */
+    { 0x51, 1, { 0x01 } },              /* Fuel type: gasoline */
+    { 0x5C, 1, { 0x82 } },              /* Oil 90 °C */
+};
+#define DEFAULT_PID_COUNT (sizeof(default_pids) / sizeof(default_pids[0]))
+
+static void reset_settings(obd_emu_t *emu)
+{
+    emu->echo = 1;
+    emu->linefeeds = 0;
+    emu->headers = 0;
+    emu->spaces = 1;
+}
+
+obd_result_t obd_emu_init(obd_emu_t *emu)
+{
+    size_t i;
+
+    if (!emu) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(emu, 0, sizeof(*emu));
+    reset_settings(emu);
+    emu->ecu_id = 0x7E8;
+
+    for (i = 0; i < DEFAULT_PID_COUNT; i++) {
+        obd_emu_set_pid(emu, default_pids[i].pid, default_pids[i].data,
+                        default_pids[i].len);
+    }
+    return obd_emu_set_vin(emu, "WBA3B5FK7FN123456");
+}
+
+obd_result_t obd_emu_set_pid(obd_emu_t *emu, uint8_t pid, const uint8_t *data,
+                             size_t len)
+{
+    if (!emu || len > 4 || (len > 0 && !data) || pid % 0x20 == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(&emu->pids[pid], 0, sizeof(emu->pids[pid]));
+    if (len > 0) {
+        emu->pids[pid].supported = 1;
+        emu->pids[pid].len = (uint8_t)len;
+        memcpy(emu->pids[pid].data, data, len);
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_emu_set_vin(obd_emu_t *emu, const char *vin)
+{
+    if (!emu || !vin || strlen(vin) != OBD_VIN_LENGTH) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memcpy(emu->vin, vin, OBD_VIN_LENGTH + 1);
+    return OBD_OK;
+}
+
+obd_result_t obd_emu_set_dtcs(obd_emu_t *emu, const uint16_t *codes, size_t count)
+{
+    if (!emu || count > OBD_EMU_MAX_DTCS || (count > 0 && !codes)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (count > 0) memcpy(emu->dtcs, codes, count * sizeof(codes[0]));
+    emu->dtc_count = count;
+    return OBD_OK;
+}
+
+
+/* ── Output ──────────────────────────────────────────────────────────── */
+
+static const char *eol(const obd_emu_t *emu)
+{
+    return emu->linefeeds ? "\r\n" : "\r";
+}
+
+static void text_line(const obd_emu_t *emu, appender_t *a, const char *text)
+{
+    append(a, "%s%s", text, eol(emu));
+}
+
+/* One reply frame: optional "7E8 04 " header, then the bytes */
+static void data_line(const obd_emu_t *emu, appender_t *a, const uint8_t *bytes, size_t n)
+{
+    const char *sep = emu->spaces ? " " : "";
+    size_t i;
+
+    if (emu->headers) {
+        append(a, "%03X%s%02X%s", (unsigned)emu->ecu_id, sep, (unsigned)n, sep);
+    }
+    for (i = 0; i < n; i++) {
+        append(a, "%02X%s", (unsigned)bytes[i], i + 1 < n ? sep : "");
+    }
+    append(a, "%s", eol(emu));
+}
+
+
+/* ── Mode 01 ─────────────────────────────────────────────────────────── */
+
+/* "Which of the next 32 PIDs do you support?" — computed from the table.
+ * The last bit says whether the next bitmap PID answers too. */
+static void pid_bitmap(const obd_emu_t *emu, uint8_t base, uint8_t out[4])
+{
+    unsigned p;
+
+    memset(out, 0, 4);
+    for (p = 1; p <= 0x20 && base + p <= 0xFF; p++) {
+        unsigned pid = base + p;
+        int on = emu->pids[pid].supported;
+
+        if (pid % 0x20 == 0) {                  /* Next bitmap: anything above? */
+            unsigned q;
+            for (q = pid + 1; q <= 0xFF && !on; q++) on = emu->pids[q].supported;
+        }
+        if (on) out[(p - 1) / 8] |= (uint8_t)(0x80u >> ((p - 1) % 8));
+    }
+}
+
+static int bitmap_answers(const obd_emu_t *emu, uint8_t base)
+{
+    unsigned q;
+
+    if (base == 0) return 1;
+    for (q = (unsigned)base + 1; q <= 0xFF; q++) {
+        if (emu->pids[q].supported) return 1;
+    }
+    return 0;
+}
+
+static void mode01(obd_emu_t *emu, appender_t *a, const uint8_t *req, size_t n)
+{
+    uint8_t reply[1 + OBD_EMU_LINE_LEN];
+    size_t len = 0, i;
+
+    reply[len++] = 0x41;
+    for (i = 1; i < n && i <= 6; i++) {
+        uint8_t pid = req[i];
+
+        if (pid % 0x20 == 0) {
+            if (!bitmap_answers(emu, pid)) continue;
+            reply[len++] = pid;
+            pid_bitmap(emu, pid, &reply[len]);
+            len += 4;
+        } else if (emu->pids[pid].supported) {
+            reply[len++] = pid;
+            memcpy(&reply[len], emu->pids[pid].data, emu->pids[pid].len);
+            len += emu->pids[pid].len;
+        }
+    }
+
+    if (len == 1 || n < 2) {
+        text_line(emu, a, "NO DATA");
+    } else {
+        data_line(emu, a, reply, len);
+    }
+}
+
+
+/* ── Modes 03, 04, 09 ────────────────────────────────────────────────── */
+
+static void mode03(const obd_emu_t *emu, appender_t *a)
+{
+    uint8_t reply[1 + 2 * OBD_EMU_MAX_DTCS + 6];
+    size_t len = 0, i;
+
+    reply[len++] = 0x43;
+    for (i = 0; i < emu->dtc_count; i++) {
+        reply[len++] = (uint8_t)(emu->dtcs[i] >> 8);
+        reply[len++] = (uint8_t)(emu->dtcs[i] & 0xFF);
+    }
+    while (len < 7) reply[len++] = 0x00;        /* Pad to three codes */
+    data_line(emu, a, reply, len);
+}
+
+static void mode09(const obd_emu_t *emu, appender_t *a, const uint8_t *req, size_t n)
+{
+    uint8_t line[7];
+    size_t i, j;
+
+    if (n >= 2 && req[1] == 0x00) {
+        const uint8_t bitmap[] = { 0x49, 0x00, 0x40, 0x00, 0x00, 0x00 };    /* 02 only */
+        data_line(emu, a, bitmap, sizeof(bitmap));
+        return;
+    }
+    if (n < 2 || req[1] != 0x02) {
+        text_line(emu, a, "NO DATA");
+        return;
+    }
+
+    /* 17 characters + 3 padding bytes in five numbered lines of four */
+    for (i = 0; i < 5; i++) {
+        line[0] = 0x49;
+        line[1] = 0x02;
+        line[2] = (uint8_t)(i + 1);
+        for (j = 0; j < 4; j++) {
+            size_t k = i * 4 + j;
+            line[3 + j] = k < OBD_VIN_LENGTH ? (uint8_t)emu->vin[k] : 0x00;
+        }
+        data_line(emu, a, line, sizeof(line));
+    }
+}
+
+static void obd_request(obd_emu_t *emu, appender_t *a, const char *cmd)
+{
+    uint8_t req[OBD_EMU_LINE_LEN / 2];
+    char hex[OBD_EMU_LINE_LEN];
+    size_t len = strlen(cmd), n = 0;
+
+    /* "010C1": a trailing odd digit is the "stop after N replies" hint */
+    memcpy(hex, cmd, len + 1);
+    if (len % 2 == 1) hex[--len] = '\0';
+
+    if (len == 0 || obd_hex_to_bytes(hex, req, sizeof(req), &n) != OBD_OK) {
+        text_line(emu, a, "?");
+        return;
+    }
+
+    emu->obd_requests++;
+    memcpy(emu->last_obd, hex, len + 1);
+
+    switch (req[0]) {
+    case 0x01: mode01(emu, a, req, n); break;
+    case 0x03: mode03(emu, a); break;
+    case 0x04:
+        emu->dtc_count = 0;
+        data_line(emu, a, (const uint8_t *)"\x44", 1);
+        break;
+    case 0x09: mode09(emu, a, req, n); break;
+    default:   text_line(emu, a, "NO DATA"); break;
+    }
+}
+
+
+/* ── AT commands ─────────────────────────────────────────────────────── */
+
+static int starts(const char *cmd, const char *prefix)
+{
+    return strncmp(cmd, prefix, strlen(prefix)) == 0;
+}
+
+static void at_command(obd_emu_t *emu, appender_t *a, const char *cmd)
+{
+    const char *arg = cmd + 2;
+    size_t arg_len = strlen(arg);
+
+    if (strcmp(arg, "Z") == 0 || strcmp(arg, "WS") == 0) {
+        reset_settings(emu);
+        append(a, "%s", eol(emu));
+        text_line(emu, a, ELM_VERSION);
+    } else if (strcmp(arg, "D") == 0) {
+        reset_settings(emu);
+        text_line(emu, a, "OK");
+    } else if (arg_len == 2 && strchr("ELHS", arg[0]) && (arg[1] == '0' || arg[1] == '1')) {
+        uint8_t on = (uint8_t)(arg[1] == '1');
+        switch (arg[0]) {
+        case 'E': emu->echo = on; break;
+        case 'L': emu->linefeeds = on; break;
+        case 'H': emu->headers = on; break;
+        default:  emu->spaces = on; break;
+        }
+        text_line(emu, a, "OK");
+    } else if (strcmp(arg, "I") == 0) {
+        text_line(emu, a, ELM_VERSION);
+    } else if (strcmp(arg, "@1") == 0) {
+        text_line(emu, a, "OBDII to RS232 Interpreter");
+    } else if (strcmp(arg, "DP") == 0) {
+        text_line(emu, a, "AUTO, ISO 15765-4 (CAN 11/500)");
+    } else if (strcmp(arg, "DPN") == 0) {
+        text_line(emu, a, "A6");
+    } else if (strcmp(arg, "RV") == 0) {
+        text_line(emu, a, "12.6V");
+    } else if (starts(arg, "SP") || starts(arg, "TP") || starts(arg, "ST") ||
+               starts(arg, "AT") || starts(arg, "SH") || starts(arg, "CAF") ||
+               starts(arg, "M") || strcmp(arg, "AL") == 0 || strcmp(arg, "NL") == 0) {
+        text_line(emu, a, "OK");                /* Accepted, nothing to emulate */
+    } else {
+        text_line(emu, a, "?");
+    }
+}
+
+
+/* ── Input ───────────────────────────────────────────────────────────── */
+
+static void run_line(obd_emu_t *emu, appender_t *a)
+{
+    char cmd[OBD_EMU_LINE_LEN];
+    size_t i, len = 0;
+
+    if (emu->echo) {
+        append(a, "%.*s%s", (int)emu->line_len, emu->line, eol(emu));
+    }
+
+    /* Normalize: no spaces, upper case */
+    for (i = 0; i < emu->line_len; i++) {
+        char c = emu->line[i];
+        if (c == ' ' || c == '\t') continue;
+        cmd[len++] = (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+    }
+    cmd[len] = '\0';
+    emu->line_len = 0;
+
+    /* An empty line repeats the previous command */
+    if (len == 0) {
+        memcpy(cmd, emu->last, sizeof(cmd));
+    } else {
+        memcpy(emu->last, cmd, sizeof(cmd));
+    }
+
+    if (cmd[0] != '\0') {
+        emu->commands++;
+        if (starts(cmd, "AT")) {
+            at_command(emu, a, cmd);
+        } else {
+            obd_request(emu, a, cmd);
+        }
+    }
+    append(a, "%s>", eol(emu));
+}
+
+obd_result_t obd_emu_feed(obd_emu_t *emu, const char *in, size_t len,
+                          char *out, size_t out_size, size_t *out_len)
+{
+    appender_t a;
+    size_t i;
+
+    if (!emu || (!in && len > 0) || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    appender_init(&a, out, out_size);
+
+    for (i = 0; i < len; i++) {
+        char c = in[i];
+
+        if (c == '\r') {
+            run_line(emu, &a);
+        } else if (c != '\n' && emu->line_len + 1 < sizeof(emu->line)) {
+            emu->line[emu->line_len++] = c;
+        }
+    }
+
+    if (out_len) *out_len = a.overflow ? 0 : a.pos;
+    return appender_finish(&a);
+}
@@ -0,0 +1,10 @@
+/**
+ * emu.h — Internal header for the ELM327 emulator.
+ */
+
+#ifndef EMU_H
+#define EMU_H
+
+#include <obd/obd_io.h>
+
+#endif /* EMU_H */
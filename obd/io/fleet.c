@@ -0,0 +1,525 @@
+/**
+ * fleet.c — Many adapters on one thread.
+ *
+ * An end-of-line test rig talks to 16–64 cars at once, a fleet gateway
+ * to hundreds of WiFi adapters. A thread per adapter with blocking reads
+ * spends its time in the scheduler and falls over somewhere past twenty.
+ *
+ * Here every adapter is an obd_session_t on a non-blocking fd, and one
+ * thread drives them all:
+ *
+ *   epoll          one edge-triggered registration per fd, for both
+ *                  directions. A wakeup only reports the fds that did
+ *                  something, so the cost per wakeup doesn't grow with
+ *                  the number of idle adapters (poll()'s does).
+ *
+ *   timer wheel    every session's deadline (wheel.c). The next epoll
+ *                  timeout and "who timed out?" are cheap no matter how
+ *                  many sessions are waiting.
+ *
+ *   state machines the sessions themselves: the fleet only moves bytes
+ *                  and calls obd_session_tick() when a deadline passes.
+ *
+ * Per event:  read until EAGAIN → obd_session_feed() → deliver results
+ *             → write the next command → put the deadline on the wheel.
+ *
+ * A fleet has no global state, so N cores = N fleets on N threads, each
+ * with its own share of the adapters (obd_fleet_bench --threads N).
+ *
+ * The epoll backend lives here. obd_fleet_set_backend() can swap in the
+ * io_uring one (uring.c); everything above the byte-moving — sessions,
+ * results, the wheel — is the same for both.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "fleet.h"
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FLEET_EVENTS    64              /* epoll events taken per wakeup */
+#define READ_CHUNK      512
+#define WHEEL_TICK_US   1000            /* 1 ms: finer than any ELM327 timeout */
+
+/* An event carries the slot index and the fd it was registered with, so
+ * a late event for a slot that was removed and reused is ignored */
+#define EVENT_DATA(index, fd)   (((uint64_t)(uint32_t)(fd) << 32) | (uint32_t)(index))
+#define EVENT_INDEX(data)       ((size_t)(uint32_t)(data))
+#define EVENT_FD(data)          ((int)(uint32_t)((data) >> 32))
+
+static obd_fleet_adapter_t *from_timer(obd_timer_t *t)
+{
+    return (obd_fleet_adapter_t *)(void *)((char *)t - offsetof(obd_fleet_adapter_t, timer));
+}
+
+static int valid(const obd_fleet_t *fleet, size_t index)
+{
+    return fleet && index < fleet->capacity &&
+           fleet->adapters[index].state != OBD_FLEET_FREE;
+}
+
+
+/* ── Setup ───────────────────────────────────────────────────────────── */
+
+obd_result_t obd_fleet_init(obd_fleet_t *fleet, obd_fleet_adapter_t *adapters,
+                            size_t capacity, obd_fleet_result_fn on_result, void *ctx)
+{
+    size_t i;
+
+    if (!fleet || !adapters || capacity == 0 || !on_result) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(fleet, 0, sizeof(*fleet));
+    fleet->backend = OBD_FLEET_EPOLL;
+    fleet->uring.fd = -1;
+    fleet->adapters = adapters;
+    fleet->capacity = capacity;
+    fleet->on_result = on_result;
+    fleet->ctx = ctx;
+
+    for (i = 0; i < capacity; i++) {
+        adapters[i].fd = -1;
+        adapters[i].state = OBD_FLEET_FREE;
+        obd_timer_init(&adapters[i].timer);
+    }
+    obd_wheel_init(&fleet->wheel, WHEEL_TICK_US, obd_io_now_us());
+
+    fleet->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (fleet->epoll_fd < 0) {
+        return OBD_ERROR_IO;
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_fleet_set_backend(obd_fleet_t *fleet, obd_fleet_backend_t backend)
+{
+    size_t i;
+
+    if (!fleet) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    for (i = 0; i < fleet->capacity; i++) {
+        if (fleet->adapters[i].state != OBD_FLEET_FREE) return OBD_ERROR_BUSY;
+    }
+    if (backend == fleet->backend) {
+        return OBD_OK;
+    }
+    if (backend == OBD_FLEET_URING) {
+        /* No io_uring here (old kernel, seccomp, io_uring_disabled): stay on epoll */
+        if (uring_open(fleet) == OBD_OK) fleet->backend = OBD_FLEET_URING;
+    } else {
+        uring_close(fleet);
+        fleet->backend = OBD_FLEET_EPOLL;
+    }
+    return OBD_OK;
+}
+
+obd_fleet_backend_t obd_fleet_backend(const obd_fleet_t *fleet)
+{
+    return fleet ? fleet->backend : OBD_FLEET_EPOLL;
+}
+
+const char *obd_fleet_backend_name(obd_fleet_backend_t backend)
+{
+    return backend == OBD_FLEET_URING ? "io_uring" : "epoll";
+}
+
+obd_result_t obd_fleet_add(obd_fleet_t *fleet, int fd, size_t *out_index)
+{
+    struct epoll_event ev;
+    struct stat st;
+    obd_fleet_adapter_t *a = NULL;
+    size_t i;
+
+    if (!fleet || fd < 0 || fstat(fd, &st) < 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    for (i = 0; i < fleet->capacity && !a; i++) {
+        if (fleet->adapters[i].state == OBD_FLEET_FREE) a = &fleet->adapters[i];
+    }
+    if (!a) {
+        return OBD_ERROR_BUSY;
+    }
+    i = (size_t)(a - fleet->adapters);
+
+    {
+        uint32_t generation = a->generation;
+        memset(a, 0, sizeof(*a));
+        a->generation = generation;
+    }
+    a->fd = fd;
+    a->is_socket = S_ISSOCK(st.st_mode) ? 1 : 0;
+    obd_timer_init(&a->timer);
+    obd_session_init(&a->session);
+
+    if (fleet->backend == OBD_FLEET_URING) {
+        if (uring_watch(fleet, i) != OBD_OK) {
+            a->fd = -1;
+            return OBD_ERROR_IO;
+        }
+    } else {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.u64 = EVENT_DATA(i, fd);
+        if (epoll_ctl(fleet->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            a->fd = -1;
+            return OBD_ERROR_IO;
+        }
+    }
+
+    a->state = OBD_FLEET_OPEN;
+    fleet->open_count++;
+    if (out_index) *out_index = i;
+    return OBD_OK;
+}
+
+/* Stop watching: out of epoll (or cancelled in the ring), off the wheel */
+static void unwatch(obd_fleet_t *fleet, obd_fleet_adapter_t *a)
+{
+    if (a->state == OBD_FLEET_OPEN) {
+        if (fleet->backend == OBD_FLEET_URING) {
+            uring_unwatch(fleet, (size_t)(a - fleet->adapters));
+        } else {
+            epoll_ctl(fleet->epoll_fd, EPOLL_CTL_DEL, a->fd, NULL);
+        }
+        fleet->open_count--;
+    }
+    obd_wheel_cancel(&fleet->wheel, &a->timer);
+}
+
+obd_result_t obd_fleet_remove(obd_fleet_t *fleet, size_t index)
+{
+    obd_fleet_adapter_t *a;
+
+    if (!valid(fleet, index)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    a = &fleet->adapters[index];
+    unwatch(fleet, a);
+    a->state = OBD_FLEET_FREE;
+    a->fd = -1;
+    return OBD_OK;
+}
+
+obd_session_t *obd_fleet_session(obd_fleet_t *fleet, size_t index)
+{
+    return valid(fleet, index) ? &fleet->adapters[index].session : NULL;
+}
+
+
+/* ── Moving bytes ────────────────────────────────────────────────────── */
+
+/* The adapter hung up or failed: tell the caller once, then forget it */
+void fleet_lose(obd_fleet_t *fleet, size_t index)
+{
+    obd_fleet_adapter_t *a = &fleet->adapters[index];
+    obd_session_result_t res;
+
+    if (a->state != OBD_FLEET_OPEN) {
+        return;
+    }
+    unwatch(fleet, a);
+    a->state = OBD_FLEET_LOST;
+    fleet->stats.lost++;
+
+    memset(&res, 0, sizeof(res));
+    res.status = OBD_ERROR_IO;
+    fleet->on_result(fleet->ctx, index, &res);
+}
+
+/* The session's next deadline onto the wheel */
+static void rearm(obd_fleet_t *fleet, obd_fleet_adapter_t *a)
+{
+    uint64_t deadline = obd_session_deadline(&a->session);
+
+    if (a->state != OBD_FLEET_OPEN || deadline == 0) {
+        obd_wheel_cancel(&fleet->wheel, &a->timer);
+    } else if (!obd_timer_pending(&a->timer) || a->timer.expires_us != deadline) {
+        obd_wheel_schedule(&fleet->wheel, &a->timer, deadline);
+    }
+}
+
+/*
+ * Write what's left of the current command. OBD_OK also when the fd is
+ * full: EPOLLOUT will say when to go on.
+ */
+static obd_result_t flush(obd_fleet_t *fleet, obd_fleet_adapter_t *a, uint64_t now_us)
+{
+    while (a->wbuf_pos < a->wbuf_len) {
+        /* send(), not write(), on a socket: a peer that hung up must not SIGPIPE us */
+        ssize_t n = a->is_socket
+                  ? send(a->fd, a->wbuf + a->wbuf_pos, a->wbuf_len - a->wbuf_pos, MSG_NOSIGNAL)
+                  : write(a->fd, a->wbuf + a->wbuf_pos, a->wbuf_len - a->wbuf_pos);
+        fleet->stats.syscalls++;
+        if (n > 0) {
+            a->wbuf_pos += (size_t)n;
+            fleet->stats.writes++;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return OBD_OK;
+        } else {
+            return OBD_ERROR_IO;
+        }
+    }
+    if (a->wbuf_len > 0) {
+        fleet_written(fleet, (size_t)(a - fleet->adapters), now_us);
+    }
+    return OBD_OK;
+}
+
+void fleet_written(obd_fleet_t *fleet, size_t index, uint64_t now_us)
+{
+    obd_fleet_adapter_t *a = &fleet->adapters[index];
+
+    a->wbuf_len = 0;
+    a->wbuf_pos = 0;
+    obd_session_write_done(&a->session, now_us);
+}
+
+void fleet_received(obd_fleet_t *fleet, size_t index, const char *data, size_t len,
+                    uint64_t now_us)
+{
+    fleet->stats.reads++;
+    obd_session_feed(&fleet->adapters[index].session, data, len, now_us);
+}
+
+/* If the adapter is free and something is queued, start writing it */
+static void kick(obd_fleet_t *fleet, size_t index, uint64_t now_us)
+{
+    obd_fleet_adapter_t *a = &fleet->adapters[index];
+    size_t len;
+
+    if (a->state != OBD_FLEET_OPEN || a->wbuf_len > 0) {
+        return;
+    }
+    if (obd_session_next_command(&a->session, now_us, a->wbuf, sizeof(a->wbuf),
+                                 &len) != OBD_OK) {
+        return;
+    }
+    a->wbuf_len = len;
+    a->wbuf_pos = 0;
+    if (fleet->backend == OBD_FLEET_URING) {
+        if (uring_send(fleet, index) != OBD_OK) {
+            fleet_lose(fleet, index);
+            return;
+        }
+    } else if (flush(fleet, a, now_us) != OBD_OK) {
+        fleet_lose(fleet, index);
+        return;
+    }
+    rearm(fleet, a);
+}
+
+/* Hand finished requests to the caller (who may submit more) */
+static void deliver(obd_fleet_t *fleet, size_t index)
+{
+    obd_fleet_adapter_t *a = &fleet->adapters[index];
+    obd_session_result_t res;
+
+    while (a->state == OBD_FLEET_OPEN && obd_session_poll(&a->session, &res) == OBD_OK) {
+        a->results++;
+        fleet->stats.results++;
+        if (res.status == OBD_ERROR_TIMEOUT) fleet->stats.timeouts++;
+        fleet->on_result(fleet->ctx, index, &res);
+    }
+}
+
+static void service(obd_fleet_t *fleet, size_t index, uint32_t events, uint64_t now_us)
+{
+    obd_fleet_adapter_t *a = &fleet->adapters[index];
+    char buf[READ_CHUNK];
+
+    fleet->stats.events++;
+
+    if ((events & EPOLLOUT) && a->wbuf_len > 0) {
+        if (flush(fleet, a, now_us) != OBD_OK) {
+            fleet_lose(fleet, index);
+            return;
+        }
+    }
+
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        /* Edge-triggered: drain it all, or we won't hear about it again */
+        for (;;) {
+            ssize_t n = read(a->fd, buf, sizeof(buf));
+            fleet->stats.syscalls++;
+            if (n > 0) {
+                fleet_received(fleet, index, buf, (size_t)n, now_us);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            /* 0 = hung up; EIO = the pty's other side closed */
+            deliver(fleet, index);
+            fleet_lose(fleet, index);
+            return;
+        }
+    }
+
+    fleet_settle(fleet, index, now_us);
+}
+
+void fleet_settle(obd_fleet_t *fleet, size_t index, uint64_t now_us)
+{
+    deliver(fleet, index);
+    kick(fleet, index, now_us);
+    rearm(fleet, &fleet->adapters[index]);
+}
+
+void fleet_fire_timers(obd_fleet_t *fleet, uint64_t now_us)
+{
+    obd_timer_t *t;
+
+    while ((t = obd_wheel_expire(&fleet->wheel, now_us)) != NULL) {
+        obd_fleet_adapter_t *a = from_timer(t);
+
+        fleet->stats.timer_fires++;
+        obd_session_tick(&a->session, now_us);
+        fleet_settle(fleet, (size_t)(a - fleet->adapters), now_us);
+    }
+}
+
+
+/* ── Requests ────────────────────────────────────────────────────────── */
+
+obd_result_t obd_fleet_submit_pid(obd_fleet_t *fleet, size_t index, uint8_t mode,
+                                  uint8_t pid, uint64_t now_us, uint32_t *out_id)
+{
+    obd_result_t r;
+
+    if (!valid(fleet, index)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (fleet->adapters[index].state != OBD_FLEET_OPEN) {
+        return OBD_ERROR_IO;
+    }
+    r = obd_session_submit_pid(&fleet->adapters[index].session, mode, pid, now_us, out_id);
+    if (r == OBD_OK) {
+        kick(fleet, index, now_us);
+    }
+    return r;
+}
+
+obd_result_t obd_fleet_submit_command(obd_fleet_t *fleet, size_t index,
+                                      const char *command, uint64_t now_us,
+                                      uint32_t *out_id)
+{
+    obd_result_t r;
+
+    if (!valid(fleet, index)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (fleet->adapters[index].state != OBD_FLEET_OPEN) {
+        return OBD_ERROR_IO;
+    }
+    r = obd_session_submit_command(&fleet->adapters[index].session, command, now_us,
+                                   out_id);
+    if (r == OBD_OK) {
+        kick(fleet, index, now_us);
+    }
+    return r;
+}
+
+obd_result_t obd_fleet_cancel(obd_fleet_t *fleet, size_t index, uint32_t id,
+                              uint64_t now_us)
+{
+    obd_result_t r;
+
+    if (!valid(fleet, index)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    r = obd_session_cancel(&fleet->adapters[index].session, id);
+    if (r == OBD_PENDING && fleet->adapters[index].state == OBD_FLEET_OPEN) {
+        fleet_settle(fleet, index, now_us);
+    }
+    return r;
+}
+
+
+/* ── The loop ────────────────────────────────────────────────────────── */
+
+/* epoll: wait, then read/write whatever is ready */
+static obd_result_t epoll_step(obd_fleet_t *fleet, int timeout_ms)
+{
+    struct epoll_event events[FLEET_EVENTS];
+    uint64_t now;
+    int n, i;
+
+    n = epoll_wait(fleet->epoll_fd, events, FLEET_EVENTS, timeout_ms);
+    fleet->stats.syscalls++;
+    if (n < 0) {
+        if (errno != EINTR) return OBD_ERROR_IO;
+        n = 0;
+    }
+    fleet->stats.wakeups++;
+    now = obd_io_now_us();
+
+    for (i = 0; i < n; i++) {
+        size_t index = EVENT_INDEX(events[i].data.u64);
+        if (index < fleet->capacity &&
+            fleet->adapters[index].state == OBD_FLEET_OPEN &&
+            fleet->adapters[index].fd == EVENT_FD(events[i].data.u64)) {
+            service(fleet, index, events[i].events, now);
+        }
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_fleet_step(obd_fleet_t *fleet, int timeout_ms)
+{
+    obd_result_t r;
+    uint64_t now, next;
+
+    if (!fleet || fleet->epoll_fd < 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    /* Don't sleep past the earliest session deadline */
+    now = obd_io_now_us();
+    next = obd_wheel_next_expiry(&fleet->wheel);
+    if (next != 0) {
+        uint64_t wait_ms = next > now ? (next - now + 999) / 1000 : 0;
+        if (timeout_ms < 0 || wait_ms < (uint64_t)timeout_ms) timeout_ms = (int)wait_ms;
+    }
+
+    r = fleet->backend == OBD_FLEET_URING ? uring_step(fleet, timeout_ms)
+                                          : epoll_step(fleet, timeout_ms);
+    if (r != OBD_OK) {
+        return r;
+    }
+    fleet_fire_timers(fleet, obd_io_now_us());
+    return OBD_OK;
+}
+
+void obd_fleet_close(obd_fleet_t *fleet)
+{
+    size_t i;
+
+    if (!fleet) {
+        return;
+    }
+    for (i = 0; i < fleet->capacity; i++) {
+        if (fleet->adapters[i].state != OBD_FLEET_FREE) {
+            unwatch(fleet, &fleet->adapters[i]);
+            fleet->adapters[i].state = OBD_FLEET_FREE;
+        }
+    }
+    if (fleet->backend == OBD_FLEET_URING) {
+        uring_close(fleet);
+        fleet->backend = OBD_FLEET_EPOLL;
+    }
+    if (fleet->epoll_fd >= 0) {
+        close(fleet->epoll_fd);
+        fleet->epoll_fd = -1;
+    }
+}
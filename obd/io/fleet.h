@@ -0,0 +1,42 @@
+/**
+ * fleet.h — Internal header for the multi-adapter event loop.
+ *
+ * fleet.c owns the sessions and the epoll backend; uring.c is the
+ * io_uring backend. They meet here: the backend moves bytes and reports
+ * back through the fleet_* calls, the fleet asks the backend to watch,
+ * write and wait through the uring_* calls.
+ */
+
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <obd/obd_io.h>
+
+/* ── Called by a backend when I/O completes (fleet.c) ── */
+
+/* Reply bytes arrived */
+void fleet_received(obd_fleet_t *fleet, size_t index, const char *data, size_t len,
+                    uint64_t now_us);
+
+/* The whole command in wbuf has been written */
+void fleet_written(obd_fleet_t *fleet, size_t index, uint64_t now_us);
+
+/* Deliver results, send the next command, put the deadline on the wheel */
+void fleet_settle(obd_fleet_t *fleet, size_t index, uint64_t now_us);
+
+/* The fd hung up or failed */
+void fleet_lose(obd_fleet_t *fleet, size_t index);
+
+/* Session deadlines that have passed */
+void fleet_fire_timers(obd_fleet_t *fleet, uint64_t now_us);
+
+/* ── The io_uring backend (uring.c) ── */
+
+obd_result_t uring_open(obd_fleet_t *fleet);
+void         uring_close(obd_fleet_t *fleet);
+obd_result_t uring_watch(obd_fleet_t *fleet, size_t index);
+void         uring_unwatch(obd_fleet_t *fleet, size_t index);
+obd_result_t uring_send(obd_fleet_t *fleet, size_t index);
+obd_result_t uring_step(obd_fleet_t *fleet, int timeout_ms);
+
+#endif /* FLEET_H */
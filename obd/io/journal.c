@@ -0,0 +1,672 @@
+/**
+ * journal.c — An append-only log that survives the power going off.
+ *
+ * A logger in a car loses power at ignition off, mid-write. fsync()ing
+ * every record costs flash wear and a system call per line; never
+ * syncing loses the end of every trip. Group commit sits in between:
+ * records are collected in memory, and every commit_us (or commit_bytes,
+ * whichever comes first) the group goes out with one pwrite() and one
+ * fdatasync(). A power cut loses at most the group being collected.
+ *
+ * The log is a directory of segment files, 00000001.obdj, 00000002.obdj
+ * and so on, each preallocated to its full size when it's created, so
+ * appending never grows a file: no metadata to sync, no fragmentation.
+ *
+ *   segment:  [ header | r1 | r2 | C | r3 | r4 | r5 | C | 0 0 0 0 ... ]
+ *                                  ▲                  ▲ offset
+ *                                  group commits end with a COMMIT record
+ *
+ * Records are a 32-byte header (magic, type, length, sequence number,
+ * time, payload checksum, header checksum) and the payload, padded to
+ * 8 bytes. Sequence numbers count DATA records from 1 with no gaps,
+ * across segments.
+ *
+ * Recovery is quick however big the log: earlier segments were synced
+ * before the next was started, so only the last one is looked at. Its
+ * header page holds a checkpoint, rewritten every 256 KB of records,
+ * saying where a synced commit ended; from there only the record headers
+ * are followed, one jump per record. The last fdatasync() that returned
+ * covered everything up to the next-to-last COMMIT the walk finds; only
+ * what comes after that is checked in full.
+ * The first bad record ends the log, and the bytes after it (at most one
+ * group's worth could have been written) are zeroed so a later walk
+ * can't wander into them.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "journal.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SEGMENT_MAGIC   "OBDJRNL1"
+#define SEGMENT_VERSION 1
+#define SEGMENT_SUFFIX  ".obdj"
+#define REC_MAGIC       0x4A52u         /* "RJ" */
+#define REC_COMMIT      0xFF
+
+#define HEADER_SIZE     4096            /* Segment header + checkpoints */
+#define CHECKPOINT_AT   64              /* Two slots, used in turn */
+#define CHECKPOINT_EVERY (256u * 1024u) /* Bytes of records between them */
+
+#define DEFAULT_COMMIT_US     500000u
+#define DEFAULT_COMMIT_BYTES  32768u
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t data_offset;               /* Where the first record goes */
+    uint64_t index;
+    uint64_t size;
+    uint64_t first_seq;
+    uint64_t created_us;
+    uint32_t check;                     /* FNV-1a of this header, check = 0 */
+    uint32_t reserved[3];
+} segment_header_t;
+
+/* "Everything before offset was synced, and the next record is next_seq" */
+typedef struct {
+    uint64_t offset;
+    uint64_t next_seq;
+    uint64_t generation;                /* Newer wins; slot = generation & 1 */
+    uint32_t reserved;
+    uint32_t check;
+} checkpoint_t;
+
+typedef struct {
+    uint16_t magic;
+    uint8_t  type;
+    uint8_t  reserved;
+    uint32_t len;
+    uint64_t seq;                       /* A COMMIT has the next record's */
+    uint64_t t_us;
+    uint32_t check;                     /* FNV-1a of the payload */
+    uint32_t hcheck;                    /* FNV-1a of this header, hcheck = 0 */
+} rec_t;
+
+#define COMMIT_SIZE sizeof(rec_t)
+
+
+/* ── Records ─────────────────────────────────────────────────────────── */
+
+static size_t rec_size(size_t len)
+{
+    return (sizeof(rec_t) + len + 7) & ~(size_t)7;
+}
+
+static uint32_t fnv1a(uint32_t h, const uint8_t *p, size_t n)
+{
+    while (n--) {
+        h ^= *p++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t header_check(const rec_t *r)
+{
+    rec_t h = *r;
+    h.hcheck = 0;
+    return fnv1a(2166136261u, (const uint8_t *)&h, sizeof(h));
+}
+
+static uint32_t segment_check(const segment_header_t *sh)
+{
+    segment_header_t h = *sh;
+    h.check = 0;
+    return fnv1a(2166136261u, (const uint8_t *)&h, sizeof(h));
+}
+
+static uint32_t checkpoint_check(const checkpoint_t *cp)
+{
+    checkpoint_t c = *cp;
+    c.check = 0;
+    return fnv1a(2166136261u, (const uint8_t *)&c, sizeof(c));
+}
+
+/* A record header at p that's intact, in sequence and fits in `room`? */
+static int header_at(const uint8_t *p, size_t room, uint64_t expect, rec_t *out)
+{
+    rec_t r;
+
+    if (room < sizeof(r)) return 0;
+    memcpy(&r, p, sizeof(r));
+    if (r.magic != REC_MAGIC || r.seq != expect || header_check(&r) != r.hcheck) return 0;
+    if (r.len > OBD_JOURNAL_MAX_RECORD || rec_size(r.len) > room) return 0;
+    if (r.type == REC_COMMIT && r.len != 0) return 0;
+    *out = r;
+    return 1;
+}
+
+static int payload_ok(const uint8_t *p, const rec_t *r)
+{
+    return fnv1a(2166136261u, p + sizeof(*r), r->len) == r->check;
+}
+
+/* Add a record to the group in memory; the caller has checked it fits */
+static void put(obd_journal_t *j, uint8_t type, const void *data, size_t len,
+                uint64_t t_us)
+{
+    uint8_t *at = j->buf + j->buf_len;
+    size_t size = rec_size(len);
+    rec_t r;
+
+    memset(&r, 0, sizeof(r));
+    r.magic = REC_MAGIC;
+    r.type = type;
+    r.len = (uint32_t)len;
+    r.seq = j->next_seq;
+    r.t_us = t_us;
+    r.check = fnv1a(2166136261u, data, len);
+    r.hcheck = header_check(&r);
+
+    memcpy(at, &r, sizeof(r));
+    if (len > 0) memcpy(at + sizeof(r), data, len);
+    memset(at + sizeof(r) + len, 0, size - sizeof(r) - len);
+    j->buf_len += size;
+    if (type != REC_COMMIT) j->next_seq++;
+}
+
+
+/* ── Files ───────────────────────────────────────────────────────────── */
+
+/* Close fd without letting close() overwrite the errno we're reporting */
+static obd_result_t fail(int fd, obd_result_t result)
+{
+    int saved = errno;
+    if (fd >= 0) close(fd);
+    errno = saved;
+    return result;
+}
+
+static int sync_data(int fd)
+{
+#if defined(__APPLE__)
+    return fsync(fd);
+#else
+    return fdatasync(fd);
+#endif
+}
+
+static void sync_dir(const char *dir)
+{
+    int fd = open(dir, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+static int pwrite_all(int fd, const void *data, size_t len, size_t offset)
+{
+    const uint8_t *p = data;
+
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, (off_t)offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += (size_t)n;
+    }
+    return 0;
+}
+
+static void segment_path(char *out, size_t size, const char *dir, uint32_t index)
+{
+    snprintf(out, size, "%s/%08x" SEGMENT_SUFFIX, dir, (unsigned)index);
+}
+
+/* The oldest and newest segment numbers in dir. 0 if there are none. */
+static int find_segments(const char *dir, uint32_t *first, uint32_t *last)
+{
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    int found = 0;
+
+    if (!d) return -1;
+    while ((e = readdir(d)) != NULL) {
+        unsigned index;
+        char tail[8];
+
+        if (strlen(e->d_name) != 8 + strlen(SEGMENT_SUFFIX) ||
+            sscanf(e->d_name, "%8x%7s", &index, tail) != 2 ||
+            strcmp(tail, SEGMENT_SUFFIX) != 0 || index == 0) {
+            continue;
+        }
+        if (!found || index < *first) *first = index;
+        if (!found || index > *last) *last = index;
+        found = 1;
+    }
+    closedir(d);
+    return found;
+}
+
+/* Create, preallocate and sync a new empty segment; it becomes current */
+static obd_result_t start_segment(obd_journal_t *j, uint32_t index, uint64_t now_us)
+{
+    char path[OBD_JOURNAL_PATH_LEN + 32];
+    segment_header_t sh;
+    int fd, err;
+
+    segment_path(path, sizeof(path), j->dir, index);
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return OBD_ERROR_IO;
+    }
+#if defined(__linux__)
+    err = posix_fallocate(fd, 0, (off_t)j->segment_size);
+    if (err != 0) {
+        errno = err;
+        return fail(fd, OBD_ERROR_IO);
+    }
+#else
+    (void)err;
+    if (ftruncate(fd, (off_t)j->segment_size) < 0) {
+        return fail(fd, OBD_ERROR_IO);
+    }
+#endif
+
+    memset(&sh, 0, sizeof(sh));
+    memcpy(sh.magic, SEGMENT_MAGIC, sizeof(sh.magic));
+    sh.version = SEGMENT_VERSION;
+    sh.data_offset = HEADER_SIZE;
+    sh.index = index;
+    sh.size = j->segment_size;
+    sh.first_seq = j->next_seq;
+    sh.created_us = now_us;
+    sh.check = segment_check(&sh);
+    if (pwrite_all(fd, &sh, sizeof(sh), 0) < 0 || fsync(fd) < 0) {
+        return fail(fd, OBD_ERROR_IO);
+    }
+    sync_dir(j->dir);
+
+    if (j->fd >= 0) close(j->fd);
+    j->fd = fd;
+    j->segment = index;
+    j->current_size = j->segment_size;
+    j->offset = HEADER_SIZE;
+    j->checkpoint = HEADER_SIZE;
+    j->checkpoint_gen = 0;
+    j->stats.segments++;
+
+    /* Retention: the oldest go once there are too many */
+    while (j->max_segments > 0 && j->segment - j->first_segment + 1 > j->max_segments) {
+        segment_path(path, sizeof(path), j->dir, j->first_segment);
+        unlink(path);
+        j->first_segment++;
+    }
+    return OBD_OK;
+}
+
+/*
+ * Find where the last run stopped in segment `index`, clear any torn
+ * bytes after it and make it current. OBD_ERROR_PARSE_FAILED if its
+ * header never made it to disk.
+ */
+static obd_result_t resume_segment(obd_journal_t *j, uint32_t index)
+{
+    char path[OBD_JOURNAL_PATH_LEN + 32];
+    segment_header_t sh;
+    struct stat st;
+    const uint8_t *map;
+    size_t size, pos, end, commit_prev, commit_last, dirty_end, i;
+    uint64_t seq, seq_prev, seq_last;
+    rec_t r;
+    int fd;
+
+    segment_path(path, sizeof(path), j->dir, index);
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        return fail(fd, OBD_ERROR_IO);
+    }
+    if (pread(fd, &sh, sizeof(sh), 0) != (ssize_t)sizeof(sh) ||
+        memcmp(sh.magic, SEGMENT_MAGIC, sizeof(sh.magic)) != 0 ||
+        sh.check != segment_check(&sh) || sh.version != SEGMENT_VERSION ||
+        sh.data_offset != HEADER_SIZE || sh.index != index ||
+        sh.size > (uint64_t)st.st_size || sh.size < HEADER_SIZE) {
+        return fail(fd, OBD_ERROR_PARSE_FAILED);
+    }
+    size = (size_t)sh.size;
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        return fail(fd, OBD_ERROR_IO);
+    }
+
+    /* 1. From the newest checkpoint, follow the headers, noting the last two commits */
+    pos = HEADER_SIZE;
+    seq = sh.first_seq;
+    j->checkpoint_gen = 0;
+    for (i = 0; i < 2; i++) {
+        checkpoint_t cp;
+        memcpy(&cp, map + CHECKPOINT_AT + i * sizeof(cp), sizeof(cp));
+        if (cp.check == checkpoint_check(&cp) && cp.generation > j->checkpoint_gen &&
+            cp.offset >= HEADER_SIZE && cp.offset <= size && cp.offset % 8 == 0 &&
+            cp.next_seq >= sh.first_seq) {
+            pos = (size_t)cp.offset;
+            seq = cp.next_seq;
+            j->checkpoint_gen = cp.generation;
+        }
+    }
+    j->checkpoint = pos;
+    commit_prev = commit_last = pos;
+    seq_prev = seq_last = seq;
+    while (header_at(map + pos, size - pos, seq, &r)) {
+        pos += rec_size(r.len);
+        if (r.type == REC_COMMIT) {
+            commit_prev = commit_last;
+            seq_prev = seq_last;
+            commit_last = pos;
+            seq_last = seq;
+        } else {
+            seq++;
+        }
+    }
+
+    /* 2. Everything before the next-to-last commit was synced: check the rest */
+    end = commit_prev;
+    seq = seq_prev;
+    while (header_at(map + end, size - end, seq, &r) && payload_ok(map + end, &r)) {
+        end += rec_size(r.len);
+        if (r.type != REC_COMMIT) seq++;
+    }
+
+    /* 3. Whatever the last write left past the end, as far as it could reach */
+    dirty_end = commit_last + OBD_JOURNAL_BUFFER;
+    if (dirty_end > size) dirty_end = size;
+    for (i = dirty_end; i > end && map[i - 1] == 0; i--) {
+    }
+    dirty_end = i;
+
+    /* Records: all of them up to the end (seq counts from the segment's first) */
+    j->stats.recovered = seq - sh.first_seq;
+    munmap((void *)map, size);
+
+    if (dirty_end > end) {
+        memset(j->buf, 0, sizeof(j->buf));
+        for (i = end; i < dirty_end; i += sizeof(j->buf)) {
+            size_t n = dirty_end - i < sizeof(j->buf) ? dirty_end - i : sizeof(j->buf);
+            if (pwrite_all(fd, j->buf, n, i) < 0) {
+                return fail(fd, OBD_ERROR_IO);
+            }
+        }
+        if (sync_data(fd) < 0) {
+            return fail(fd, OBD_ERROR_IO);
+        }
+        j->stats.truncated = dirty_end - end;
+    }
+
+    j->fd = fd;
+    j->segment = index;
+    j->current_size = size;
+    j->offset = end;
+    j->next_seq = seq;
+    return OBD_OK;
+}
+
+
+/* ── Opening and settings ────────────────────────────────────────────── */
+
+obd_result_t obd_journal_open(obd_journal_t *j, const char *dir, size_t segment_size,
+                              uint64_t now_us)
+{
+    char path[OBD_JOURNAL_PATH_LEN + 32];
+    uint32_t first = 0, last = 0;
+    obd_result_t result;
+    int found;
+
+    if (!j || !dir || !*dir) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(j, 0, sizeof(*j));
+    j->fd = -1;
+    if (strlen(dir) >= sizeof(j->dir)) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    segment_size &= ~(size_t)7;
+    if (segment_size < OBD_JOURNAL_MIN_SEGMENT) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    strcpy(j->dir, dir);
+    j->segment_size = segment_size;
+    j->commit_us = DEFAULT_COMMIT_US;
+    j->commit_bytes = DEFAULT_COMMIT_BYTES;
+    j->next_seq = 1;
+
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        return OBD_ERROR_IO;
+    }
+    found = find_segments(dir, &first, &last);
+    if (found < 0) {
+        return OBD_ERROR_IO;
+    }
+    if (!found) {
+        j->first_segment = 1;
+        return start_segment(j, 1, now_us);
+    }
+
+    /* A newest segment whose header never reached the disk didn't happen */
+    j->first_segment = first;
+    for (;;) {
+        result = resume_segment(j, last);
+        if (result != OBD_ERROR_PARSE_FAILED) {
+            return result;
+        }
+        segment_path(path, sizeof(path), dir, last);
+        unlink(path);
+        if (last == first) {
+            return start_segment(j, last, now_us);
+        }
+        last--;
+    }
+}
+
+obd_result_t obd_journal_set_commit(obd_journal_t *j, uint64_t commit_us,
+                                    size_t commit_bytes)
+{
+    if (!j || commit_us == 0 || commit_bytes == 0 || commit_bytes > OBD_JOURNAL_BUFFER) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    j->commit_us = commit_us;
+    j->commit_bytes = commit_bytes;
+    return OBD_OK;
+}
+
+obd_result_t obd_journal_set_retention(obd_journal_t *j, size_t max_segments)
+{
+    if (!j) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    j->max_segments = max_segments;
+    return OBD_OK;
+}
+
+
+/* ── Appending ───────────────────────────────────────────────────────── */
+
+obd_result_t obd_journal_commit(obd_journal_t *j, uint64_t now_us)
+{
+    if (!j || j->fd < 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (j->buf_len == 0) {
+        return OBD_OK;
+    }
+
+    put(j, REC_COMMIT, NULL, 0, now_us);
+    if (pwrite_all(j->fd, j->buf, j->buf_len, j->offset) < 0 || sync_data(j->fd) < 0) {
+        j->buf_len -= COMMIT_SIZE;      /* Keep the group for another try */
+        return OBD_ERROR_IO;
+    }
+    j->offset += j->buf_len;
+    j->stats.bytes_written += j->buf_len;
+    j->stats.commits++;
+    j->buf_len = 0;
+
+    /*
+     * Now synced, this is a safe place for recovery to start. Not synced
+     * itself: the next commit's fdatasync takes it along, and until then
+     * the other slot still points somewhere safe.
+     */
+    if (j->offset - j->checkpoint >= CHECKPOINT_EVERY) {
+        checkpoint_t cp;
+
+        memset(&cp, 0, sizeof(cp));
+        cp.offset = j->offset;
+        cp.next_seq = j->next_seq;
+        cp.generation = j->checkpoint_gen + 1;
+        cp.check = checkpoint_check(&cp);
+        if (pwrite_all(j->fd, &cp, sizeof(cp),
+                       CHECKPOINT_AT + (size_t)(cp.generation & 1) * sizeof(cp)) == 0) {
+            j->checkpoint = j->offset;
+            j->checkpoint_gen = cp.generation;
+        }
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_journal_append(obd_journal_t *j, uint8_t type, const void *data,
+                                size_t len, uint64_t t_us)
+{
+    size_t size = rec_size(len);
+    obd_result_t result;
+
+    if (!j || j->fd < 0 || (!data && len > 0) || type > OBD_JOURNAL_TYPE_MAX ||
+        len > OBD_JOURNAL_MAX_RECORD) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    /* No room in the group, or in the segment: commit first */
+    if (j->buf_len + size + COMMIT_SIZE > sizeof(j->buf) ||
+        j->offset + j->buf_len + size + COMMIT_SIZE > j->current_size) {
+        result = obd_journal_commit(j, t_us);
+        if (result != OBD_OK) {
+            return result;
+        }
+    }
+    if (j->offset + size + COMMIT_SIZE > j->current_size) {
+        result = start_segment(j, j->segment + 1, t_us);
+        if (result != OBD_OK) {
+            return result;
+        }
+    }
+
+    if (j->buf_len == 0) j->oldest_us = t_us;
+    put(j, type, data, len, t_us);
+    j->stats.appended++;
+
+    if (j->buf_len >= j->commit_bytes) {
+        return obd_journal_commit(j, t_us);
+    }
+    return obd_journal_tick(j, t_us);
+}
+
+obd_result_t obd_journal_tick(obd_journal_t *j, uint64_t now_us)
+{
+    if (!j || j->fd < 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (j->buf_len > 0 && now_us >= j->oldest_us + j->commit_us) {
+        return obd_journal_commit(j, now_us);
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_journal_close(obd_journal_t *j, uint64_t now_us)
+{
+    obd_result_t result;
+
+    if (!j || j->fd < 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    result = obd_journal_commit(j, now_us);
+    close(j->fd);
+    j->fd = -1;
+    return result;
+}
+
+
+/* ── Reading ─────────────────────────────────────────────────────────── */
+
+/* Hand over one segment's records; seq carries on from the last one */
+static obd_result_t replay_segment(const char *path, uint32_t index, int newest,
+                                   uint64_t *seq, obd_journal_record_fn fn, void *ctx)
+{
+    segment_header_t sh;
+    obd_journal_record_t rec;
+    struct stat st;
+    const uint8_t *map;
+    size_t size, pos;
+    rec_t r;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        return fail(fd, OBD_ERROR_IO);
+    }
+    if (pread(fd, &sh, sizeof(sh), 0) != (ssize_t)sizeof(sh) ||
+        memcmp(sh.magic, SEGMENT_MAGIC, sizeof(sh.magic)) != 0 ||
+        sh.check != segment_check(&sh) || sh.index != index ||
+        sh.size > (uint64_t)st.st_size || sh.size < HEADER_SIZE ||
+        (*seq != 0 && sh.first_seq != *seq)) {
+        /* Being created right now, or never finished: the end of the log */
+        return fail(fd, newest ? OBD_OK : OBD_ERROR_PARSE_FAILED);
+    }
+    size = (size_t)sh.size;
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return OBD_ERROR_IO;
+    }
+
+    *seq = sh.first_seq;
+    for (pos = HEADER_SIZE; header_at(map + pos, size - pos, *seq, &r) &&
+                           payload_ok(map + pos, &r); pos += rec_size(r.len)) {
+        if (r.type == REC_COMMIT) continue;
+        rec.type = r.type;
+        rec.seq = r.seq;
+        rec.t_us = r.t_us;
+        rec.data = map + pos + sizeof(r);
+        rec.len = r.len;
+        if (fn) fn(ctx, &rec);
+        (*seq)++;
+    }
+    munmap((void *)map, size);
+    return OBD_OK;
+}
+
+obd_result_t obd_journal_replay(const char *dir, obd_journal_record_fn fn, void *ctx)
+{
+    char path[OBD_JOURNAL_PATH_LEN + 32];
+    uint32_t first = 0, last = 0, index;
+    uint64_t seq = 0;
+    int found;
+
+    if (!dir || strlen(dir) >= OBD_JOURNAL_PATH_LEN) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    found = find_segments(dir, &first, &last);
+    if (found < 0) {
+        return OBD_ERROR_IO;
+    }
+    if (!found) {
+        return OBD_ERROR_NO_DATA;
+    }
+    for (index = first; index <= last; index++) {
+        obd_result_t result;
+        segment_path(path, sizeof(path), dir, index);
+        result = replay_segment(path, index, index == last, &seq, fn, ctx);
+        if (result != OBD_OK) {
+            return result;
+        }
+    }
+    return OBD_OK;
+}
@@ -0,0 +1,10 @@
+/**
+ * journal.h — Internal header for the append-only journal.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <obd/obd_io.h>
+
+#endif /* JOURNAL_H */
@@ -0,0 +1,855 @@
+/**
+ * mux.c — One ELM327, many clients.
+ *
+ * A gateway has one adapter and several programs that want it: the
+ * telemetry uploader, a diagnostics UI, a technician's laptop. If each
+ * opens the adapter itself they trample each other — one sends ATZ in
+ * the middle of another's request, one turns echo off under another.
+ *
+ * The multiplexer owns the adapter and gives every client its own
+ * pretend ELM327 over TCP or a Unix socket:
+ *
+ *   AT settings      ATE/ATL/ATS are kept per client and applied to the
+ *                    replies it gets. Commands that would change the
+ *                    adapter (ATZ, ATSP, ATST...) are answered "OK"
+ *                    without touching it. Read-only ones (ATDP, ATRV)
+ *                    are forwarded.
+ *
+ *   OBD requests     go through one session and one response cache
+ *                    (cache.c): fresh answers come from the cache, and a
+ *                    request already on its way is shared, not resent.
+ *
+ *   Fairness         a client has at most one request outstanding (it
+ *                    waits for ">" like with a real adapter), and when
+ *                    the adapter frees up the clients are served round
+ *                    robin — one chatty client can't starve the others.
+ *
+ *   Batching         optional: different clients' Mode 01 PIDs go out as
+ *                    one multi-PID request ("010D0511") when the car
+ *                    speaks CAN, and the reply is split per PID. Only as
+ *                    many as fit one CAN frame (7 bytes) go together.
+ *
+ * The adapter is set up headers off, so a client's ATH1 is accepted but
+ * its replies still come without headers.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "mux.h"
+#include "appender.h"
+#include "hex_utils.h"
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Sent once at startup. 0100 makes the adapter find the protocol (and
+ * fills the cache); ATDPN then says whether it's CAN. */
+static const char *const setup_commands[] = {
+    "ATZ", "ATE0", "ATL0", "ATS1", "ATH0", "ATSP0", "0100", "ATDPN",
+};
+#define SETUP_COUNT (sizeof(setup_commands) / sizeof(setup_commands[0]))
+
+#define ELM_VERSION "ELM327 v1.5"
+
+/* One CAN frame carries 7 data bytes: 0x41, then PID + data for each */
+#define SINGLE_FRAME_BYTES 7
+
+
+/* ── Setup ───────────────────────────────────────────────────────────── */
+
+obd_result_t obd_mux_init(obd_mux_t *mux, int adapter_fd)
+{
+    obd_session_result_t unused;
+    uint32_t id = 0;
+    size_t i;
+
+    if (!mux || adapter_fd < 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(mux, 0, sizeof(*mux));
+    mux->adapter_fd = adapter_fd;
+    obd_session_init(&mux->session);
+    obd_cache_init(&mux->cache);
+    for (i = 0; i < OBD_MUX_MAX_CLIENTS; i++) {
+        mux->clients[i].fd = -1;
+    }
+
+    for (i = 0; i < SETUP_COUNT; i++) {
+        obd_cache_submit_command(&mux->cache, &mux->session, setup_commands[i],
+                                 obd_io_now_us(), &unused, &id);
+    }
+    mux->protocol_id = id;
+    return OBD_OK;
+}
+
+obd_result_t obd_mux_set_batching(obd_mux_t *mux, int on)
+{
+    if (!mux) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    mux->batching = on ? 1 : 0;
+    return OBD_OK;
+}
+
+obd_result_t obd_mux_add_listener(obd_mux_t *mux, int fd)
+{
+    if (!mux || fd < 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (mux->listen_count >= OBD_MUX_MAX_LISTENERS) {
+        return OBD_ERROR_BUSY;
+    }
+    mux->listen_fds[mux->listen_count++] = fd;
+    return OBD_OK;
+}
+
+obd_result_t obd_mux_add_client(obd_mux_t *mux, int fd)
+{
+    obd_mux_client_t *c = NULL;
+    int one = 1;
+    size_t i;
+
+    if (!mux || fd < 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    for (i = 0; i < OBD_MUX_MAX_CLIENTS; i++) {
+        if (mux->clients[i].fd < 0) {
+            c = &mux->clients[i];
+            break;
+        }
+    }
+    if (!c) {
+        return OBD_ERROR_BUSY;
+    }
+    if (obd_net_set_nonblocking(fd) != OBD_OK) {
+        return OBD_ERROR_IO;
+    }
+    /* Replies are tiny and someone is waiting for each one (fails
+     * harmlessly on Unix sockets) */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+    c->echo = 1;                        /* A fresh ELM327 echoes */
+    c->spaces = 1;
+    mux->stats.accepted++;
+    return OBD_OK;
+}
+
+size_t obd_mux_client_count(const obd_mux_t *mux)
+{
+    size_t i, n = 0;
+
+    if (!mux) return 0;
+    for (i = 0; i < OBD_MUX_MAX_CLIENTS; i++) {
+        if (mux->clients[i].fd >= 0) n++;
+    }
+    return n;
+}
+
+static void drop_client(obd_mux_client_t *c)
+{
+    close(c->fd);
+    c->fd = -1;
+    c->state = OBD_MUX_CLIENT_IDLE;
+}
+
+void obd_mux_close(obd_mux_t *mux)
+{
+    size_t i;
+
+    if (!mux) return;
+    for (i = 0; i < OBD_MUX_MAX_CLIENTS; i++) {
+        if (mux->clients[i].fd >= 0) drop_client(&mux->clients[i]);
+    }
+    for (i = 0; i < mux->listen_count; i++) {
+        close(mux->listen_fds[i]);
+    }
+    mux->listen_count = 0;
+}
+
+
+/* ── Talking to a client ─────────────────────────────────────────────── */
+
+static const char *eol(const obd_mux_client_t *c)
+{
+    return c->linefeeds ? "\r\n" : "\r";
+}
+
+/* Queue output; a client too slow to take it is dropped, never waited on */
+static void put(obd_mux_client_t *c, const char *data, size_t len)
+{
+    if (c->out_len + len > sizeof(c->out)) {
+        c->closing = 1;
+        return;
+    }
+    memcpy(c->out + c->out_len, data, len);
+    c->out_len += len;
+}
+
+static void put_str(obd_mux_client_t *c, const char *s)
+{
+    put(c, s, strlen(s));
+}
+
+/* Reply lines, then the blank line and ">" that end every ELM327 answer */
+static void reply_text(obd_mux_client_t *c, const char *text)
+{
+    const char *p = text;
+
+    while (*p != '\0') {
+        const char *start = p;
+        while (*p != '\0' && *p != '\r') {
+            if (*p != ' ' || c->spaces) put(c, p, 1);
+            p++;
+        }
+        if (p > start) put_str(c, eol(c));
+        if (*p == '\r') p++;
+    }
+    put_str(c, eol(c));
+    put_str(c, ">");
+}
+
+static void reply_result(obd_mux_t *mux, obd_mux_client_t *c,
+                         const obd_session_result_t *res)
+{
+    if (res->status != OBD_OK) mux->stats.errors++;
+
+    if (res->response[0] != '\0') {
+        reply_text(c, res->response);   /* Data, or what the adapter said */
+    } else if (res->status == OBD_ERROR_ELM_ERROR) {
+        reply_text(c, "?");
+    } else if (res->status == OBD_ERROR_NO_DATA || res->status == OBD_ERROR_TIMEOUT) {
+        reply_text(c, "NO DATA");
+    } else {
+        reply_text(c, "ERROR");
+    }
+    c->state = OBD_MUX_CLIENT_IDLE;
+}
+
+/* Push queued output; returns 0 if the client has gone away */
+static int flush_client(obd_mux_client_t *c)
+{
+    while (c->out_len > 0) {
+        /* send(), not write(): a client that hung up must not SIGPIPE us */
+        ssize_t n = send(c->fd, c->out, c->out_len, MSG_NOSIGNAL);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        memmove(c->out, c->out + n, c->out_len - (size_t)n);
+        c->out_len -= (size_t)n;
+    }
+    return 1;
+}
+
+
+/* ── AT commands, answered per client ────────────────────────────────── */
+
+static int starts(const char *cmd, const char *prefix)
+{
+    return strncmp(cmd, prefix, strlen(prefix)) == 0;
+}
+
+/*
+ * Returns 1 if answered here, 0 if it should go to the adapter.
+ * Anything that would change the adapter's state for everyone is
+ * answered as if it had worked.
+ */
+static int local_at(obd_mux_t *mux, obd_mux_client_t *c, const char *cmd)
+{
+    const char *arg = cmd + 2;
+
+    if (strcmp(arg, "DP") == 0 || strcmp(arg, "DPN") == 0 || strcmp(arg, "RV") == 0 ||
+        strcmp(arg, "IGN") == 0) {
+        return 0;                       /* Read-only: ask the adapter */
+    }
+
+    mux->stats.local++;
+    if (strcmp(arg, "Z") == 0 || strcmp(arg, "WS") == 0 || strcmp(arg, "D") == 0) {
+        c->echo = 1;
+        c->linefeeds = 0;
+        c->spaces = 1;
+        reply_text(c, arg[0] == 'D' ? "OK" : ELM_VERSION);
+    } else if (strlen(arg) == 2 && strchr("ELSH", arg[0]) &&
+               (arg[1] == '0' || arg[1] == '1')) {
+        uint8_t on = (uint8_t)(arg[1] == '1');
+        if (arg[0] == 'E') c->echo = on;
+        if (arg[0] == 'L') c->linefeeds = on;
+        if (arg[0] == 'S') c->spaces = on;
+        reply_text(c, "OK");            /* ATH: accepted, see top of file */
+    } else if (strcmp(arg, "I") == 0) {
+        reply_text(c, ELM_VERSION);
+    } else if (strcmp(arg, "@1") == 0) {
+        reply_text(c, "OBD mux");
+    } else if (starts(arg, "SP") || starts(arg, "TP") || starts(arg, "ST") ||
+               starts(arg, "AT") || starts(arg, "CAF") || starts(arg, "M") ||
+               strcmp(arg, "AL") == 0 || strcmp(arg, "NL") == 0) {
+        reply_text(c, "OK");
+    } else {
+        reply_text(c, "?");
+    }
+    return 1;
+}
+
+
+/* ── OBD requests ────────────────────────────────────────────────────── */
+
+static int is_hex_command(const char *cmd)
+{
+    const char *p;
+
+    if (cmd[0] == '\0') return 0;
+    for (p = cmd; *p != '\0'; p++) {
+        if (hex_char_to_nibble(*p) < 0) return 0;
+    }
+    return 1;
+}
+
+/* "010C" with a known byte count: a candidate for a multi-PID batch */
+static int batchable(const char *cmd, uint8_t *pid, size_t *bytes)
+{
+    uint8_t raw[2];
+    size_t n = 0;
+
+    if (strlen(cmd) != 4 || obd_hex_to_bytes(cmd, raw, sizeof(raw), &n) != OBD_OK ||
+        raw[0] != 0x01 || raw[1] % 0x20 == 0) {
+        return 0;
+    }
+    *pid = raw[1];
+    return obd_sensor_get_byte_count(raw[1], bytes) == OBD_OK;
+}
+
+/*
+ * Try to answer a READY client without a round trip of its own: from
+ * the cache, by sharing a request in flight, or by joining the batch
+ * on the wire. Returns 1 if the client no longer needs sending.
+ */
+static int try_shared(obd_mux_t *mux, obd_mux_client_t *c, uint64_t now_us)
+{
+    obd_session_result_t res;
+    uint32_t id = 0;
+    uint8_t pid;
+    size_t bytes;
+    obd_result_t r;
+
+    r = obd_cache_lookup(&mux->cache, c->command, now_us, &res, &id);
+    if (r == OBD_OK) {
+        mux->stats.hits++;
+        reply_result(mux, c, &res);
+        return 1;
+    }
+    if (r == OBD_PENDING) {
+        mux->stats.coalesced++;
+        c->state = OBD_MUX_CLIENT_WAITING;
+        c->wait_id = id;
+        return 1;
+    }
+
+    if (mux->batch_id != 0 && batchable(c->command, &pid, &bytes)) {
+        size_t i;
+        for (i = 0; i < mux->batch_count; i++) {
+            if (mux->batch_pids[i] == pid) {
+                mux->stats.coalesced++;
+                c->state = OBD_MUX_CLIENT_WAITING;
+                c->wait_id = mux->batch_id;
+                c->wait_pid = pid;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* A command line from a client. Returns when it's answered or queued. */
+static void run_command(obd_mux_t *mux, obd_mux_client_t *c, const char *line,
+                        uint64_t now_us)
+{
+    char cmd[OBD_MAX_COMMAND_LEN];
+    size_t len = 0;
+    const char *p;
+
+    if (c->echo) {
+        put_str(c, line);
+        put_str(c, eol(c));
+    }
+
+    for (p = line; *p != '\0' && len + 1 < sizeof(cmd); p++) {
+        if (*p == ' ' || *p == '\t') continue;
+        cmd[len++] = (*p >= 'a' && *p <= 'z') ? (char)(*p - 'a' + 'A') : *p;
+    }
+    cmd[len] = '\0';
+
+    /* An empty line repeats the previous command, like on an ELM327 */
+    if (len == 0) {
+        memcpy(cmd, c->last, sizeof(cmd));
+        if (cmd[0] == '\0') {
+            reply_text(c, "");
+            return;
+        }
+    } else {
+        memcpy(c->last, cmd, sizeof(cmd));
+    }
+
+    mux->stats.requests++;
+    c->requests++;
+
+    if (starts(cmd, "AT")) {
+        if (local_at(mux, c, cmd)) return;
+    } else if (!is_hex_command(cmd)) {
+        reply_text(c, "?");
+        return;
+    }
+
+    memcpy(c->command, cmd, sizeof(cmd));
+    c->state = OBD_MUX_CLIENT_READY;
+    try_shared(mux, c, now_us);
+}
+
+/* Work through buffered input, one line at a time, while the client
+ * isn't waiting for an answer */
+static void run_client(obd_mux_t *mux, obd_mux_client_t *c, uint64_t now_us)
+{
+    while (c->state == OBD_MUX_CLIENT_IDLE && !c->closing) {
+        char line[OBD_MUX_LINE_LEN];
+        char *cr = memchr(c->in, '\r', c->in_len);
+        size_t len, i, n = 0;
+
+        if (!cr) break;
+        len = (size_t)(cr - c->in);
+        for (i = 0; i < len; i++) {
+            if (c->in[i] != '\n') line[n++] = c->in[i];
+        }
+        line[n] = '\0';
+        memmove(c->in, cr + 1, c->in_len - len - 1);
+        c->in_len -= len + 1;
+
+        run_command(mux, c, line, now_us);
+    }
+}
+
+
+/* ── Scheduling ──────────────────────────────────────────────────────── */
+
+static obd_mux_client_t *client_at(obd_mux_t *mux, size_t k)
+{
+    obd_mux_client_t *c = &mux->clients[(mux->rr_next + k) % OBD_MUX_MAX_CLIENTS];
+    return (c->fd >= 0 && c->state == OBD_MUX_CLIENT_READY) ? c : NULL;
+}
+
+/*
+ * Start a multi-PID request with the lead client's PID plus as many
+ * other clients' PIDs as fit in one CAN frame. Returns 0 if there's
+ * nobody to batch with.
+ */
+static int send_batch(obd_mux_t *mux, obd_mux_client_t *lead, uint64_t now_us)
+{
+    obd_mux_client_t *members[OBD_MUX_MAX_CLIENTS];
+    uint8_t pids[OBD_MUX_BATCH_MAX];
+    char command[OBD_MAX_COMMAND_LEN] = "01";
+    size_t member_count = 0, pid_count = 0, frame = 1, i, k;
+    uint32_t id;
+
+    if (!batchable(lead->command, &pids[0], &i)) {
+        return 0;
+    }
+
+    for (k = 0; k < OBD_MUX_MAX_CLIENTS; k++) {
+        obd_mux_client_t *c = client_at(mux, k);
+        uint8_t pid;
+        size_t bytes;
+        int known = 0;
+
+        if (!c || !batchable(c->command, &pid, &bytes)) continue;
+        for (i = 0; i < pid_count; i++) known |= pids[i] == pid;
+
+        if (!known) {
+            if (pid_count == OBD_MUX_BATCH_MAX || frame + 1 + bytes > SINGLE_FRAME_BYTES) {
+                continue;
+            }
+            pids[pid_count++] = pid;
+            frame += 1 + bytes;
+        }
+        c->wait_pid = pid;
+        members[member_count++] = c;
+    }
+    if (pid_count < 2) {
+        return 0;
+    }
+
+    for (i = 0; i < pid_count; i++) {
+        obd_bytes_to_hex(&pids[i], 1, command + 2 + 2 * i, 3);
+    }
+    if (obd_session_submit_command(&mux->session, command, now_us, &id) != OBD_OK) {
+        return 0;
+    }
+
+    for (i = 0; i < member_count; i++) {
+        members[i]->state = OBD_MUX_CLIENT_WAITING;
+        members[i]->wait_id = id;
+    }
+    mux->batch_id = id;
+    memcpy(mux->batch_pids, pids, pid_count);
+    mux->batch_count = pid_count;
+    mux->stats.sent++;
+    mux->stats.batches++;
+    mux->stats.batched += member_count;
+    return 1;
+}
+
+/*
+ * When the adapter is free, pick what goes next. Round robin: the scan
+ * starts one past whoever went last time.
+ */
+static void schedule(obd_mux_t *mux, uint64_t now_us)
+{
+    obd_mux_client_t *lead = NULL;
+    obd_session_result_t unused;
+    uint32_t id;
+    size_t k;
+
+    if (obd_session_pending(&mux->session) > 0) {
+        return;
+    }
+
+    for (k = 0; k < OBD_MUX_MAX_CLIENTS && !lead; k++) {
+        obd_mux_client_t *c = client_at(mux, k);
+        if (c && !try_shared(mux, c, now_us)) lead = c;
+    }
+    if (!lead) {
+        return;
+    }
+
+    /* The batch scan starts at rr_next too, so the lead always gets in */
+    if (!(mux->batching && mux->can && send_batch(mux, lead, now_us))) {
+        if (obd_cache_submit_command(&mux->cache, &mux->session, lead->command, now_us,
+                                     &unused, &id) != OBD_PENDING) {
+            return;
+        }
+        lead->state = OBD_MUX_CLIENT_WAITING;
+        lead->wait_id = id;
+        mux->stats.sent++;
+    }
+    mux->rr_next = (size_t)(lead - mux->clients) + 1;
+
+    /* Anyone else asking the same thing shares it */
+    for (k = 0; k < OBD_MUX_MAX_CLIENTS; k++) {
+        obd_mux_client_t *c = client_at(mux, k);
+        if (c) try_shared(mux, c, now_us);
+    }
+}
+
+
+/* ── Results ─────────────────────────────────────────────────────────── */
+
+/*
+ * "41 0C 1A F8 0D 3C" → one result per PID, each cached like an
+ * ordinary single-PID answer and handed to whoever asked for it.
+ */
+static void split_batch(obd_mux_t *mux, const obd_session_result_t *res, uint64_t now_us)
+{
+    uint8_t bytes[OBD_MAX_RESPONSE_LEN / 2];
+    size_t n = 0, i = 1, k;
+    char line[OBD_MAX_RESPONSE_LEN];
+    size_t line_len = 0;
+
+    while (res->response[line_len] != '\0' && res->response[line_len] != '\r') line_len++;
+    memcpy(line, res->response, line_len);
+    line[line_len] = '\0';
+
+    /* The session checks the reply against the first PID only, so a car
+     * that leaves that one out (or reorders) comes back PARSE_FAILED with
+     * the text intact */
+    if ((res->status != OBD_OK && res->status != OBD_ERROR_PARSE_FAILED) ||
+        obd_hex_to_bytes(line, bytes, sizeof(bytes), &n) != OBD_OK ||
+        n < 2 || bytes[0] != 0x41) {
+        /* This car or adapter doesn't do multi-PID: stop trying, and
+         * send these requests one by one */
+        mux->can = 0;
+        for (k = 0; k < OBD_MUX_MAX_CLIENTS; k++) {
+            obd_mux_client_t *c = &mux->clients[k];
+            if (c->fd >= 0 && c->state == OBD_MUX_CLIENT_WAITING && c->wait_id == res->id) {
+                c->state = OBD_MUX_CLIENT_READY;
+            }
+        }
+        return;
+    }
+
+    while (i < n) {
+        obd_session_result_t one = *res;
+        uint8_t single[2 + OBD_MAX_DATA_BYTES];
+        char command[5];
+        size_t count;
+        uint8_t pid = bytes[i];
+
+        if (obd_sensor_get_byte_count(pid, &count) != OBD_OK || i + 1 + count > n) {
+            break;
+        }
+        one.pid = pid;
+        one.has_parsed = 1;
+        one.parsed.mode = 0x41;
+        one.parsed.pid = pid;
+        memcpy(one.parsed.data, &bytes[i + 1], count);
+        one.parsed.data_len = count;
+        one.has_value = obd_sensor_decode(&one.parsed, &one.value) == OBD_OK;
+
+        single[0] = 0x41;
+        memcpy(single + 1, &bytes[i], 1 + count);
+        obd_bytes_to_hex(single, 2 + count, one.response, sizeof(one.response));
+
+        command[0] = '0';
+        command[1] = '1';
+        obd_bytes_to_hex(&pid, 1, command + 2, 3);
+        obd_cache_store(&mux->cache, command, &one, now_us);
+
+        for (k = 0; k < OBD_MUX_MAX_CLIENTS; k++) {
+            obd_mux_client_t *c = &mux->clients[k];
+            if (c->fd >= 0 && c->state == OBD_MUX_CLIENT_WAITING &&
+                c->wait_id == res->id && c->wait_pid == pid) {
+                reply_result(mux, c, &one);
+            }
+        }
+        i += 1 + count;
+    }
+
+    /* Asked for, but the car left it out */
+    for (k = 0; k < OBD_MUX_MAX_CLIENTS; k++) {
+        obd_mux_client_t *c = &mux->clients[k];
+        if (c->fd >= 0 && c->state == OBD_MUX_CLIENT_WAITING && c->wait_id == res->id) {
+            mux->stats.errors++;
+            reply_text(c, "NO DATA");
+            c->state = OBD_MUX_CLIENT_IDLE;
+        }
+    }
+}
+
+static void collect(obd_mux_t *mux, uint64_t now_us)
+{
+    obd_session_result_t res;
+    size_t k;
+
+    while (obd_cache_poll(&mux->cache, &mux->session, now_us, &res) == OBD_OK) {
+        if (res.id == mux->protocol_id) {
+            /* "A6" / "6": protocols 6–9 are CAN */
+            const char *p = res.response[0] == 'A' ? res.response + 1 : res.response;
+            mux->can = res.status == OBD_OK && *p >= '6' && *p <= '9';
+        }
+        if (res.id == mux->batch_id) {
+            split_batch(mux, &res, now_us);
+            mux->batch_id = 0;
+            continue;
+        }
+        for (k = 0; k < OBD_MUX_MAX_CLIENTS; k++) {
+            obd_mux_client_t *c = &mux->clients[k];
+            if (c->fd >= 0 && c->state == OBD_MUX_CLIENT_WAITING && c->wait_id == res.id) {
+                reply_result(mux, c, &res);
+            }
+        }
+    }
+
+    /* Answered clients may have more lines buffered */
+    for (k = 0; k < OBD_MUX_MAX_CLIENTS; k++) {
+        obd_mux_client_t *c = &mux->clients[k];
+        if (c->fd >= 0) run_client(mux, c, now_us);
+    }
+}
+
+
+/* ── The adapter ─────────────────────────────────────────────────────── */
+
+/* Write the next command (or the rest of it) without blocking */
+static obd_result_t pump_adapter(obd_mux_t *mux, uint64_t now_us)
+{
+    if (mux->wbuf_pos == mux->wbuf_len) {
+        size_t len = 0;
+        if (obd_session_next_command(&mux->session, now_us, mux->wbuf,
+                                     sizeof(mux->wbuf), &len) != OBD_OK) {
+            return OBD_OK;
+        }
+        mux->wbuf_len = len;
+        mux->wbuf_pos = 0;
+    }
+
+    while (mux->wbuf_pos < mux->wbuf_len) {
+        ssize_t n = write(mux->adapter_fd, mux->wbuf + mux->wbuf_pos,
+                          mux->wbuf_len - mux->wbuf_pos);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return OBD_OK;
+            return OBD_ERROR_IO;
+        }
+        mux->wbuf_pos += (size_t)n;
+    }
+    obd_session_write_done(&mux->session, now_us);
+    return OBD_OK;
+}
+
+static obd_result_t read_adapter(obd_mux_t *mux, uint64_t now_us)
+{
+    char buf[512];
+
+    for (;;) {
+        ssize_t n = read(mux->adapter_fd, buf, sizeof(buf));
+        if (n > 0) {
+            obd_session_feed(&mux->session, buf, (size_t)n, now_us);
+            continue;
+        }
+        if (n == 0) return OBD_ERROR_IO;        /* Adapter closed */
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return OBD_OK;
+        if (errno != EINTR) return OBD_ERROR_IO;
+    }
+}
+
+static void read_client(obd_mux_t *mux, obd_mux_client_t *c, uint64_t now_us)
+{
+    for (;;) {
+        ssize_t n;
+
+        if (c->in_len == sizeof(c->in)) {
+            c->in_len = 0;                      /* A "line" this long is junk */
+        }
+        n = read(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len);
+        if (n > 0) {
+            c->in_len += (size_t)n;
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            drop_client(c);
+            return;
+        }
+        break;
+    }
+    run_client(mux, c, now_us);
+}
+
+static void accept_clients(obd_mux_t *mux, int listen_fd)
+{
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) return;
+        if (obd_mux_add_client(mux, fd) != OBD_OK) {
+            close(fd);                          /* Full: refuse politely */
+        }
+    }
+}
+
+
+/* ── The loop ────────────────────────────────────────────────────────── */
+
+obd_result_t obd_mux_step(obd_mux_t *mux, int timeout_ms)
+{
+    struct pollfd fds[1 + OBD_MUX_MAX_LISTENERS + OBD_MUX_MAX_CLIENTS];
+    size_t owner[OBD_MUX_MAX_CLIENTS];
+    size_t nfds = 0, first_client, i;
+    uint64_t now, deadline;
+    int n;
+
+    if (!mux) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    /* Don't sleep past the session's timeout check */
+    now = obd_io_now_us();
+    deadline = obd_session_deadline(&mux->session);
+    if (deadline != 0) {
+        uint64_t wait_ms = deadline > now ? (deadline - now + 999) / 1000 : 0;
+        if (timeout_ms < 0 || wait_ms < (uint64_t)timeout_ms) timeout_ms = (int)wait_ms;
+    }
+
+    fds[nfds].fd = mux->adapter_fd;
+    fds[nfds].events = (short)(POLLIN | (mux->wbuf_pos < mux->wbuf_len ? POLLOUT : 0));
+    nfds++;
+    for (i = 0; i < mux->listen_count; i++) {
+        fds[nfds].fd = mux->listen_fds[i];
+        fds[nfds].events = POLLIN;
+        nfds++;
+    }
+    first_client = nfds;
+    for (i = 0; i < OBD_MUX_MAX_CLIENTS; i++) {
+        obd_mux_client_t *c = &mux->clients[i];
+        if (c->fd < 0) continue;
+        owner[nfds - first_client] = i;
+        fds[nfds].fd = c->fd;
+        fds[nfds].events = (short)(POLLIN | (c->out_len > 0 ? POLLOUT : 0));
+        nfds++;
+    }
+
+    n = poll(fds, (nfds_t)nfds, timeout_ms);
+    if (n < 0 && errno != EINTR) {
+        return OBD_ERROR_IO;
+    }
+    now = obd_io_now_us();
+
+    if (n > 0) {
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            if (read_adapter(mux, now) != OBD_OK) return OBD_ERROR_IO;
+        }
+        for (i = 1; i < first_client; i++) {
+            if (fds[i].revents & POLLIN) accept_clients(mux, fds[i].fd);
+        }
+        for (i = first_client; i < nfds; i++) {
+            obd_mux_client_t *c = &mux->clients[owner[i - first_client]];
+            if (c->fd < 0 || fds[i].revents == 0) continue;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) read_client(mux, c, now);
+        }
+    }
+
+    obd_session_tick(&mux->session, now);
+    collect(mux, now);
+    schedule(mux, now);
+    if (pump_adapter(mux, now) != OBD_OK) {
+        return OBD_ERROR_IO;
+    }
+
+    for (i = 0; i < OBD_MUX_MAX_CLIENTS; i++) {
+        obd_mux_client_t *c = &mux->clients[i];
+        if (c->fd < 0) continue;
+        if (!flush_client(c) || c->closing) {
+            if (c->closing) mux->stats.dropped++;
+            drop_client(c);
+        }
+    }
+    return OBD_OK;
+}
+
+
+/* ── Reporting ───────────────────────────────────────────────────────── */
+
+/*
+ *   clients 3 (5 accepted, 0 dropped)  batching on, CAN yes
+ *   requests 1204  local 12  hits 610  coalesced 180  sent 402 (batches 96, 251 requests)
+ *   errors 4
+ *   ...cache report...
+ */
+obd_result_t obd_mux_format_text(const obd_mux_t *mux, char *out, size_t out_size)
+{
+    const obd_mux_stats_t *st;
+    appender_t a;
+    char cache_text[4096];
+
+    if (!mux || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    appender_init(&a, out, out_size);
+    st = &mux->stats;
+
+    append(&a, "clients %u (%llu accepted, %llu dropped)  batching %s, CAN %s\n",
+           (unsigned)obd_mux_client_count(mux), (unsigned long long)st->accepted,
+           (unsigned long long)st->dropped, mux->batching ? "on" : "off",
+           mux->can ? "yes" : "no");
+    append(&a, "requests %llu  local %llu  hits %llu  coalesced %llu  "
+               "sent %llu (batches %llu, %llu requests)\n",
+           (unsigned long long)st->requests, (unsigned long long)st->local,
+           (unsigned long long)st->hits, (unsigned long long)st->coalesced,
+           (unsigned long long)st->sent, (unsigned long long)st->batches,
+           (unsigned long long)st->batched);
+    append(&a, "errors %llu\n", (unsigned long long)st->errors);
+
+    if (obd_cache_format_text(&mux->cache, obd_io_now_us(), cache_text,
+                              sizeof(cache_text)) == OBD_OK) {
+        append(&a, "%s", cache_text);
+    }
+    return appender_finish(&a);
+}
@@ -0,0 +1,10 @@
+/**
+ * mux.h — Internal header for the adapter multiplexer.
+ */
+
+#ifndef MUX_H
+#define MUX_H
+
+#include <obd/obd_io.h>
+
+#endif /* MUX_H */
@@ -0,0 +1,219 @@
+/**
+ * net.c — Listen/connect helpers for TCP and Unix sockets.
+ *
+ * The multiplexer, the emulator server and the tests all need the same
+ * few socket calls. They live here once, returning obd_result_t like the
+ * rest of the library: OBD_ERROR_IO when a system call fails (errno is
+ * left as the call set it, so the caller can print it).
+ *
+ * Every fd handed out is non-blocking and close-on-exec.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "net.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+uint64_t obd_io_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+obd_result_t obd_net_set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return OBD_ERROR_IO;
+    }
+    if (fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+        return OBD_ERROR_IO;
+    }
+    return OBD_OK;
+}
+
+/* Close fd without letting close() overwrite the errno we're reporting */
+static obd_result_t fail(int fd)
+{
+    int saved = errno;
+    if (fd >= 0) close(fd);
+    errno = saved;
+    return OBD_ERROR_IO;
+}
+
+/* Every command is a handful of bytes: send them now, don't batch them */
+static void no_delay(int fd)
+{
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+static obd_result_t resolve(const char *host, uint16_t port, int passive,
+                            struct addrinfo **out)
+{
+    struct addrinfo hints;
+    char service[8];
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+
+    if (getaddrinfo(host ? host : "127.0.0.1", service, &hints, out) != 0) {
+        errno = EADDRNOTAVAIL;
+        return OBD_ERROR_IO;
+    }
+    return OBD_OK;
+}
+
+
+/* ── Listening ───────────────────────────────────────────────────────── */
+
+obd_result_t obd_net_listen_tcp(const char *host, uint16_t port, int *out_fd)
+{
+    struct addrinfo *ai;
+    int fd, one = 1;
+
+    if (!out_fd) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (resolve(host, port, 1, &ai) != OBD_OK) {
+        return OBD_ERROR_IO;
+    }
+
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(ai);
+        return OBD_ERROR_IO;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0 || listen(fd, 16) < 0 ||
+        obd_net_set_nonblocking(fd) != OBD_OK) {
+        freeaddrinfo(ai);
+        return fail(fd);
+    }
+    freeaddrinfo(ai);
+    *out_fd = fd;
+    return OBD_OK;
+}
+
+static obd_result_t unix_address(const char *path, struct sockaddr_un *addr)
+{
+    if (!path || strlen(path) >= sizeof(addr->sun_path)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, strlen(path) + 1);
+    return OBD_OK;
+}
+
+obd_result_t obd_net_listen_unix(const char *path, int *out_fd)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (!out_fd || unix_address(path, &addr) != OBD_OK) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return OBD_ERROR_IO;
+    }
+    unlink(path);                       /* Left behind by a previous run */
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0 ||
+        obd_net_set_nonblocking(fd) != OBD_OK) {
+        return fail(fd);
+    }
+    *out_fd = fd;
+    return OBD_OK;
+}
+
+obd_result_t obd_net_local_port(int fd, uint16_t *out_port)
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+
+    if (!out_port) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (getsockname(fd, (struct sockaddr *)&addr, &len) < 0) {
+        return OBD_ERROR_IO;
+    }
+    if (addr.ss_family == AF_INET) {
+        *out_port = ntohs(((struct sockaddr_in *)&addr)->sin_port);
+    } else if (addr.ss_family == AF_INET6) {
+        *out_port = ntohs(((struct sockaddr_in6 *)&addr)->sin6_port);
+    } else {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    return OBD_OK;
+}
+
+
+/* ── Connecting ──────────────────────────────────────────────────────── */
+
+obd_result_t obd_net_connect_tcp(const char *host, uint16_t port, int *out_fd)
+{
+    struct addrinfo *ai;
+    int fd;
+
+    if (!out_fd) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (resolve(host, port, 0, &ai) != OBD_OK) {
+        return OBD_ERROR_IO;
+    }
+
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(ai);
+        return OBD_ERROR_IO;
+    }
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) < 0 ||
+        obd_net_set_nonblocking(fd) != OBD_OK) {
+        freeaddrinfo(ai);
+        return fail(fd);
+    }
+    freeaddrinfo(ai);
+    no_delay(fd);
+    *out_fd = fd;
+    return OBD_OK;
+}
+
+obd_result_t obd_net_connect_unix(const char *path, int *out_fd)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (!out_fd || unix_address(path, &addr) != OBD_OK) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return OBD_ERROR_IO;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        obd_net_set_nonblocking(fd) != OBD_OK) {
+        return fail(fd);
+    }
+    *out_fd = fd;
+    return OBD_OK;
+}
@@ -0,0 +1,10 @@
+/**
+ * net.h — Internal header for the socket helpers.
+ */
+
+#ifndef NET_H
+#define NET_H
+
+#include <obd/obd_io.h>
+
+#endif /* NET_H */
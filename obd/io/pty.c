@@ -0,0 +1,81 @@
+/**
+ * pty.c — Pseudo-terminal pairs for emulated serial adapters.
+ *
+ * A USB ELM327 shows up as /dev/ttyUSB0: a tty, not a socket. To test
+ * and benchmark against that without a car, the emulator sits on the
+ * slave side of a pty and the code under test gets the master side —
+ * the same read()/write() semantics, the same kernel tty layer in the
+ * middle, hundreds of them at once.
+ *
+ * Both sides are put in raw mode (no echo, no \r → \n translation, no
+ * line editing) so the bytes arrive exactly as written, like on a serial
+ * port set up with cfmakeraw().
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include "pty.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+static int make_raw(int fd)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) < 0) {
+        return -1;
+    }
+    tio.c_iflag &= ~(tcflag_t)(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR |
+                               ICRNL | IXON);
+    tio.c_oflag &= ~(tcflag_t)OPOST;
+    tio.c_lflag &= ~(tcflag_t)(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    tio.c_cflag &= ~(tcflag_t)(CSIZE | PARENB);
+    tio.c_cflag |= CS8;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    return tcsetattr(fd, TCSANOW, &tio);
+}
+
+/* Close what was opened without letting close() overwrite errno */
+static obd_result_t fail(int master, int slave)
+{
+    int saved = errno;
+    if (slave >= 0) close(slave);
+    if (master >= 0) close(master);
+    errno = saved;
+    return OBD_ERROR_IO;
+}
+
+obd_result_t obd_pty_open(int *out_master, int *out_slave)
+{
+    const char *name;
+    int master, slave;
+
+    if (!out_master || !out_slave) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0) {
+        return OBD_ERROR_IO;
+    }
+    if (grantpt(master) < 0 || unlockpt(master) < 0 || (name = ptsname(master)) == NULL) {
+        return fail(master, -1);
+    }
+    slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        return fail(master, -1);
+    }
+    if (make_raw(slave) < 0 || make_raw(master) < 0 ||
+        obd_net_set_nonblocking(master) != OBD_OK ||
+        obd_net_set_nonblocking(slave) != OBD_OK) {
+        return fail(master, slave);
+    }
+
+    *out_master = master;
+    *out_slave = slave;
+    return OBD_OK;
+}
@@ -0,0 +1,10 @@
+/**
+ * pty.h — Internal header for the pty helper.
+ */
+
+#ifndef PTY_H
+#define PTY_H
+
+#include <obd/obd_io.h>
+
+#endif /* PTY_H */
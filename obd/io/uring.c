@@ -0,0 +1,509 @@
+/**
+ * uring.c — The fleet's io_uring backend.
+ *
+ * With epoll every round trip costs at least three system calls: the
+ * wait, a read() (plus one more that says EAGAIN) and a write(). Here
+ * reads and writes are requests in a ring shared with the kernel, and
+ * one io_uring_enter() per obd_fleet_step() both hands over every write
+ * queued since the last step and collects every completion:
+ *
+ *   sockets          one multishot recv per adapter, armed once. Each
+ *                    reply lands in a buffer the kernel picks from a
+ *                    provided-buffer ring, so no read is "posted" per
+ *                    round trip at all.
+ *
+ *   ptys, ttys       no multishot read for these: each command's write
+ *                    is linked to the read of its reply (IOSQE_IO_LINK),
+ *                    so both go in together and the read starts the
+ *                    moment the write is done.
+ *
+ *   writes           straight out of the adapter slot's wbuf. For ttys
+ *                    the caller's slot array is registered as a fixed
+ *                    buffer once, so the kernel doesn't map the pages on
+ *                    every write (WRITE_FIXED; plain WRITE if registering
+ *                    fails). Sockets get a SEND with MSG_NOSIGNAL.
+ *
+ * Completions come back tagged with op, slot and the slot's generation;
+ * one for a slot that has since been removed (and perhaps reused) is
+ * dropped. No liburing: the few structures needed are in
+ * <linux/io_uring.h> and the three system calls are used directly.
+ */
+
+#define _GNU_SOURCE
+
+#include "fleet.h"
+
+#if defined(OBD_HAVE_URING)
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define URING_MAX_ENTRIES   4096
+#define URING_MIN_ENTRIES   8
+#define BUF_SIZE            512         /* One read; same as the epoll side */
+#define BUF_MAX_COUNT       4096
+#define BUF_GROUP           0
+
+/* user_data: what finished, for which slot, in which of its lives */
+enum { OP_WRITE = 1, OP_READ, OP_RECV, OP_CANCEL };
+
+#define UD(op, gen, index)  (((uint64_t)(op) << 56) | ((uint64_t)((gen) & 0xFFFFFFu) << 32) | \
+                             (uint32_t)(index))
+#define UD_OP(ud)           ((unsigned)((ud) >> 56))
+#define UD_GEN(ud)          ((uint32_t)((ud) >> 32) & 0xFFFFFFu)
+#define UD_INDEX(ud)        ((size_t)(uint32_t)(ud))
+
+
+/* ── The ring ────────────────────────────────────────────────────────── */
+
+static uint32_t round_up_pow2(size_t n, uint32_t lo, uint32_t hi)
+{
+    uint32_t p = lo;
+    while (p < n && p < hi) p <<= 1;
+    return p;
+}
+
+/* Submit what's queued; optionally wait. Returns the syscall's result. */
+static int enter(obd_fleet_t *fleet, unsigned min_complete, unsigned flags,
+                 const void *arg, size_t arg_size)
+{
+    obd_fleet_uring_t *u = &fleet->uring;
+    int r;
+
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+    r = (int)syscall(__NR_io_uring_enter, u->fd, u->to_submit, min_complete, flags,
+                     arg, arg_size);
+    fleet->stats.syscalls++;
+    if (r > 0) {
+        u->to_submit -= (uint32_t)r < u->to_submit ? (uint32_t)r : u->to_submit;
+    }
+    return r;
+}
+
+/* Room for `n` more SQEs, submitting early if the queue is full */
+static int reserve(obd_fleet_t *fleet, uint32_t n)
+{
+    obd_fleet_uring_t *u = &fleet->uring;
+
+    if (u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) + n <= u->sq_entries) {
+        return 1;
+    }
+    enter(fleet, 0, 0, NULL, 0);
+    return u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) + n <=
+           u->sq_entries;
+}
+
+/* The next SQE, zeroed; call reserve() first */
+static struct io_uring_sqe *next_sqe(obd_fleet_uring_t *u)
+{
+    uint32_t idx = u->sq_local_tail & u->sq_mask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *)u->sqes)[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    u->sq_local_tail++;
+    u->to_submit++;
+    return sqe;
+}
+
+/* Give a read buffer back to the kernel */
+static void put_buffer(obd_fleet_uring_t *u, uint16_t bid)
+{
+    struct io_uring_buf_ring *br = u->buf_ring;
+    struct io_uring_buf *b = &br->bufs[u->buf_tail & (u->buf_count - 1)];
+
+    b->addr = (uint64_t)(uintptr_t)(u->bufs + (size_t)bid * BUF_SIZE);
+    b->len = BUF_SIZE;
+    b->bid = bid;
+    u->buf_tail++;
+    __atomic_store_n(&br->tail, u->buf_tail, __ATOMIC_RELEASE);
+}
+
+static void unmap(void **p, size_t size)
+{
+    if (*p && *p != MAP_FAILED) munmap(*p, size);
+    *p = NULL;
+}
+
+void uring_close(obd_fleet_t *fleet)
+{
+    obd_fleet_uring_t *u = &fleet->uring;
+
+    if (u->fd < 0) {
+        return;
+    }
+    close(u->fd);                       /* Cancels whatever is still in flight */
+    if (u->cq_ring != u->sq_ring) unmap(&u->cq_ring, u->cq_ring_size);
+    unmap(&u->sq_ring, u->sq_ring_size);
+    unmap(&u->sqes, u->sqes_size);
+    unmap(&u->buf_ring, u->buf_ring_size);
+    unmap((void **)&u->bufs, u->bufs_size);
+    memset(u, 0, sizeof(*u));
+    u->fd = -1;
+}
+
+static obd_result_t map_rings(obd_fleet_uring_t *u, const struct io_uring_params *p)
+{
+    u->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(uint32_t);
+    u->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_ring_size > u->sq_ring_size) u->sq_ring_size = u->cq_ring_size;
+        u->cq_ring_size = u->sq_ring_size;
+    }
+
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED) {
+        u->sq_ring = NULL;
+        return OBD_ERROR_IO;
+    }
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        u->cq_ring = u->sq_ring;
+    } else {
+        u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+        if (u->cq_ring == MAP_FAILED) {
+            u->cq_ring = NULL;
+            return OBD_ERROR_IO;
+        }
+    }
+    u->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        return OBD_ERROR_IO;
+    }
+
+    u->sq_head    = (uint32_t *)(void *)((char *)u->sq_ring + p->sq_off.head);
+    u->sq_tail    = (uint32_t *)(void *)((char *)u->sq_ring + p->sq_off.tail);
+    u->sq_array   = (uint32_t *)(void *)((char *)u->sq_ring + p->sq_off.array);
+    u->sq_mask    = *(uint32_t *)(void *)((char *)u->sq_ring + p->sq_off.ring_mask);
+    u->sq_entries = p->sq_entries;
+    u->sq_local_tail = *u->sq_tail;
+    u->cq_head    = (uint32_t *)(void *)((char *)u->cq_ring + p->cq_off.head);
+    u->cq_tail    = (uint32_t *)(void *)((char *)u->cq_ring + p->cq_off.tail);
+    u->cq_mask    = *(uint32_t *)(void *)((char *)u->cq_ring + p->cq_off.ring_mask);
+    u->cqes       = (char *)u->cq_ring + p->cq_off.cqes;
+    return OBD_OK;
+}
+
+/* The provided-buffer ring the reads pick their buffers from */
+static obd_result_t map_buffers(obd_fleet_uring_t *u, size_t capacity)
+{
+    struct io_uring_buf_reg reg;
+    uint32_t i;
+
+    u->buf_count = round_up_pow2(capacity, 64, BUF_MAX_COUNT);
+    u->buf_ring_size = u->buf_count * sizeof(struct io_uring_buf);
+    u->bufs_size = (size_t)u->buf_count * BUF_SIZE;
+
+    u->buf_ring = mmap(NULL, u->buf_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->bufs = mmap(NULL, u->bufs_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->buf_ring == MAP_FAILED || u->bufs == MAP_FAILED) {
+        if (u->buf_ring == MAP_FAILED) u->buf_ring = NULL;
+        if (u->bufs == MAP_FAILED) u->bufs = NULL;
+        return OBD_ERROR_IO;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)u->buf_ring;
+    reg.ring_entries = u->buf_count;
+    reg.bgid = BUF_GROUP;
+    if (syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return OBD_ERROR_IO;            /* Before 5.19 */
+    }
+    for (i = 0; i < u->buf_count; i++) put_buffer(u, (uint16_t)i);
+    return OBD_OK;
+}
+
+obd_result_t uring_open(obd_fleet_t *fleet)
+{
+    obd_fleet_uring_t *u = &fleet->uring;
+    struct io_uring_params p;
+    struct iovec slots;
+    uint32_t entries = round_up_pow2(fleet->capacity * 2, URING_MIN_ENTRIES,
+                                     URING_MAX_ENTRIES);
+    int fd;
+
+    memset(u, 0, sizeof(*u));
+    u->fd = -1;
+
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_COOP_TASKRUN; /* We enter every step anyway: no IPIs */
+    fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0 && errno == EINVAL) {
+        memset(&p, 0, sizeof(p));
+        fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    }
+    if (fd < 0) {
+        return OBD_ERROR_IO;            /* ENOSYS, EPERM (io_uring_disabled)... */
+    }
+    u->fd = fd;
+
+    /* The step waits with a timeout argument; NODROP keeps overflows */
+    if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP) ||
+        map_rings(u, &p) != OBD_OK || map_buffers(u, fleet->capacity) != OBD_OK) {
+        uring_close(fleet);
+        return OBD_ERROR_IO;
+    }
+
+    /* Optional: costs locked memory, which may be limited */
+    slots.iov_base = fleet->adapters;
+    slots.iov_len = fleet->capacity * sizeof(obd_fleet_adapter_t);
+    u->fixed = syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_BUFFERS, &slots, 1) == 0;
+    return OBD_OK;
+}
+
+
+/* ── Per adapter ─────────────────────────────────────────────────────── */
+
+static void queue_read(obd_fleet_t *fleet, size_t index, unsigned sqe_flags)
+{
+    obd_fleet_adapter_t *a = &fleet->adapters[index];
+    struct io_uring_sqe *sqe = next_sqe(&fleet->uring);
+
+    sqe->fd = a->fd;
+    sqe->flags = (uint8_t)(IOSQE_BUFFER_SELECT | sqe_flags);
+    sqe->buf_group = BUF_GROUP;
+    if (a->is_socket) {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->user_data = UD(OP_RECV, a->generation, index);
+    } else {
+        sqe->opcode = IORING_OP_READ;
+        sqe->off = (uint64_t)-1;
+        sqe->len = BUF_SIZE;
+        sqe->user_data = UD(OP_READ, a->generation, index);
+    }
+    a->read_armed = 1;
+}
+
+static obd_result_t arm_read(obd_fleet_t *fleet, size_t index)
+{
+    if (!reserve(fleet, 1)) {
+        return OBD_ERROR_IO;
+    }
+    queue_read(fleet, index, 0);
+    return OBD_OK;
+}
+
+obd_result_t uring_watch(obd_fleet_t *fleet, size_t index)
+{
+    obd_fleet_adapter_t *a = &fleet->adapters[index];
+
+    a->read_armed = 0;
+    a->write_busy = 0;
+
+    /* A socket's recv stays armed for good; a tty's read goes with each write */
+    return a->is_socket ? arm_read(fleet, index) : OBD_OK;
+}
+
+void uring_unwatch(obd_fleet_t *fleet, size_t index)
+{
+    obd_fleet_adapter_t *a = &fleet->adapters[index];
+    struct io_uring_sqe *sqe;
+
+    /* Whatever completes from here on belongs to an older life of the slot */
+    a->generation++;
+    if ((a->read_armed || a->write_busy) && reserve(fleet, 1)) {
+        sqe = next_sqe(&fleet->uring);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = a->fd;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = UD(OP_CANCEL, 0, index);
+        /* Now, while the fd still names this file: the caller closes it next */
+        enter(fleet, 0, 0, NULL, 0);
+    }
+    a->read_armed = 0;
+    a->write_busy = 0;
+}
+
+obd_result_t uring_send(obd_fleet_t *fleet, size_t index)
+{
+    obd_fleet_adapter_t *a = &fleet->adapters[index];
+    struct io_uring_sqe *sqe;
+    int link = !a->is_socket && !a->read_armed;
+
+    if (a->write_busy) {
+        return OBD_OK;                  /* The completion sends the rest */
+    }
+    if (!reserve(fleet, link ? 2u : 1u)) {
+        return OBD_ERROR_IO;
+    }
+    sqe = next_sqe(&fleet->uring);
+    sqe->fd = a->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(a->wbuf + a->wbuf_pos);
+    sqe->len = (uint32_t)(a->wbuf_len - a->wbuf_pos);
+    if (a->is_socket) {
+        sqe->opcode = IORING_OP_SEND;
+        sqe->msg_flags = MSG_NOSIGNAL;
+    } else {
+        sqe->opcode = fleet->uring.fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->off = (uint64_t)-1;
+        sqe->buf_index = 0;
+    }
+    sqe->user_data = UD(OP_WRITE, a->generation, index);
+    if (link) {
+        sqe->flags = IOSQE_IO_LINK;
+        queue_read(fleet, index, 0);
+    }
+    a->write_busy = 1;
+    return OBD_OK;
+}
+
+
+/* ── Completions ─────────────────────────────────────────────────────── */
+
+static void write_done(obd_fleet_t *fleet, size_t index, int res, uint64_t now_us)
+{
+    obd_fleet_adapter_t *a = &fleet->adapters[index];
+
+    a->write_busy = 0;
+    fleet->stats.writes++;
+    if (res < 0) {
+        fleet_lose(fleet, index);
+        return;
+    }
+    a->wbuf_pos += (size_t)res;
+    if (a->wbuf_pos < a->wbuf_len) {
+        /* Short write: the linked read was cancelled with it. Its CQE comes
+         * after this one, so mark it gone here or the rest goes unlinked */
+        if (!a->is_socket) a->read_armed = 0;
+        if (uring_send(fleet, index) != OBD_OK) fleet_lose(fleet, index);
+        return;
+    }
+    fleet_written(fleet, index, now_us);
+    fleet_settle(fleet, index, now_us);
+}
+
+static void read_done(obd_fleet_t *fleet, size_t index, int res, unsigned flags,
+                      uint64_t now_us)
+{
+    obd_fleet_uring_t *u = &fleet->uring;
+    obd_fleet_adapter_t *a = &fleet->adapters[index];
+
+    if (res == -ECANCELED) {
+        /* Its write came up short: write_done() already queued the next
+         * read, so read_armed is that one's */
+        return;
+    }
+    if (!a->is_socket || !(flags & IORING_CQE_F_MORE)) {
+        a->read_armed = 0;
+    }
+    if (res == 0 || (res < 0 && res != -ENOBUFS)) {
+        fleet_lose(fleet, index);       /* 0 = hung up; EIO = the pty's far end closed */
+        return;
+    }
+    if (res > 0 && (flags & IORING_CQE_F_BUFFER)) {
+        uint16_t bid = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+        fleet_received(fleet, index, u->bufs + (size_t)bid * BUF_SIZE, (size_t)res, now_us);
+        put_buffer(u, bid);
+    }
+    fleet_settle(fleet, index, now_us);
+
+    /* A socket's recv must always be there; a tty's only while a reply is due
+     * (ENOBUFS: every buffer was in use, so try again) */
+    if (a->state == OBD_FLEET_OPEN && !a->read_armed &&
+        (a->is_socket || obd_session_deadline(&a->session) != 0)) {
+        if (arm_read(fleet, index) != OBD_OK) fleet_lose(fleet, index);
+    }
+}
+
+static void complete(obd_fleet_t *fleet, uint64_t user_data, int res, unsigned flags,
+                     uint64_t now_us)
+{
+    size_t index = UD_INDEX(user_data);
+    unsigned op = UD_OP(user_data);
+    obd_fleet_adapter_t *a;
+
+    fleet->stats.events++;
+    if (op == OP_CANCEL || index >= fleet->capacity) {
+        return;
+    }
+    a = &fleet->adapters[index];
+    if (a->state != OBD_FLEET_OPEN || UD_GEN(user_data) != (a->generation & 0xFFFFFFu)) {
+        /* From before a remove: just take the buffer back */
+        if (flags & IORING_CQE_F_BUFFER) {
+            put_buffer(&fleet->uring, (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT));
+        }
+        return;
+    }
+    if (op == OP_WRITE) {
+        write_done(fleet, index, res, now_us);
+    } else {
+        read_done(fleet, index, res, flags, now_us);
+    }
+}
+
+obd_result_t uring_step(obd_fleet_t *fleet, int timeout_ms)
+{
+    obd_fleet_uring_t *u = &fleet->uring;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    uint32_t head, tail;
+    uint64_t now;
+    int r;
+
+    memset(&arg, 0, sizeof(arg));
+    if (timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+
+    /* Submit everything queued since the last step and wait, in one call */
+    head = *u->cq_head;
+    tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    r = enter(fleet, head == tail ? 1u : 0u, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+              &arg, sizeof(arg));
+    if (r < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+        return OBD_ERROR_IO;
+    }
+    fleet->stats.wakeups++;
+    now = obd_io_now_us();
+
+    while ((tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) != head) {
+        const struct io_uring_cqe *cqe =
+            &((const struct io_uring_cqe *)u->cqes)[head & u->cq_mask];
+        uint64_t user_data = cqe->user_data;
+        int res = cqe->res;
+        unsigned flags = cqe->flags;
+
+        /* Release the slot first: handling it may queue more work */
+        __atomic_store_n(u->cq_head, ++head, __ATOMIC_RELEASE);
+        complete(fleet, user_data, res, flags, now);
+    }
+    return OBD_OK;
+}
+
+#else /* Kernel headers too old: never used, obd_fleet_set_backend() keeps epoll */
+
+obd_result_t uring_open(obd_fleet_t *fleet) { (void)fleet; return OBD_ERROR_IO; }
+void uring_close(obd_fleet_t *fleet) { (void)fleet; }
+obd_result_t uring_watch(obd_fleet_t *fleet, size_t index)
+{
+    (void)fleet; (void)index;
+    return OBD_ERROR_IO;
+}
+void uring_unwatch(obd_fleet_t *fleet, size_t index) { (void)fleet; (void)index; }
+obd_result_t uring_send(obd_fleet_t *fleet, size_t index)
+{
+    (void)fleet; (void)index;
+    return OBD_ERROR_IO;
+}
+obd_result_t uring_step(obd_fleet_t *fleet, int timeout_ms)
+{
+    (void)fleet; (void)timeout_ms;
+    return OBD_ERROR_IO;
+}
+
+#endif /* OBD_HAVE_URING */
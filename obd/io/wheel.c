@@ -0,0 +1,176 @@
+/**
+ * wheel.c — A hashed timer wheel for many session timeouts.
+ *
+ * With a few hundred adapters on one thread, "which session times out
+ * next?" gets asked after every event. Scanning every session is O(n);
+ * a heap is O(log n) per change, and timeouts change on every command.
+ *
+ * The wheel is an array of slots, one per tick (1 ms by default). A
+ * timer goes into the slot of the tick it expires in, modulo the number
+ * of slots, on a doubly linked list — so scheduling, rescheduling and
+ * cancelling are all O(1). Timers further out than one turn of the wheel
+ * share a slot with nearer ones; expiry compares the real time, so they
+ * just stay put until their turn comes around again.
+ *
+ *   slot:   0    1    2    3   ...  255
+ *           │    │    │    │
+ *           t7   ·    t2   ·         t2 expires at tick 2 (or 258, 514...)
+ *           t9
+ *
+ * Timers are embedded in the caller's structs (obd_fleet_adapter_t has
+ * one): no allocation, and the caller gets back to its struct with
+ * offsetof().
+ */
+
+#include "wheel.h"
+#include <string.h>
+
+#define SLOT_MASK (OBD_WHEEL_SLOTS - 1)
+
+static void unlink_timer(obd_timer_t *t)
+{
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = NULL;
+    t->prev = NULL;
+}
+
+obd_result_t obd_wheel_init(obd_wheel_t *w, uint64_t tick_us, uint64_t now_us)
+{
+    size_t i;
+
+    if (!w || tick_us == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(w, 0, sizeof(*w));
+    w->tick_us = tick_us;
+    w->cursor = now_us / tick_us;
+    for (i = 0; i < OBD_WHEEL_SLOTS; i++) {
+        /* Each slot is a circular list around a sentinel */
+        w->slots[i].next = &w->slots[i];
+        w->slots[i].prev = &w->slots[i];
+    }
+    return OBD_OK;
+}
+
+void obd_timer_init(obd_timer_t *t)
+{
+    if (t) {
+        t->next = NULL;
+        t->prev = NULL;
+        t->expires_us = 0;
+    }
+}
+
+int obd_timer_pending(const obd_timer_t *t)
+{
+    return t && t->next != NULL;
+}
+
+obd_result_t obd_wheel_schedule(obd_wheel_t *w, obd_timer_t *t, uint64_t expires_us)
+{
+    obd_timer_t *slot;
+    uint64_t tick;
+
+    if (!w || !t) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (t->next) {
+        unlink_timer(t);
+        w->count--;
+    }
+
+    /* Already due: the slot under the cursor, picked up by the next expire */
+    tick = expires_us / w->tick_us;
+    if (tick < w->cursor) tick = w->cursor;
+
+    slot = &w->slots[tick & SLOT_MASK];
+    t->expires_us = expires_us;
+    t->prev = slot->prev;
+    t->next = slot;
+    slot->prev->next = t;
+    slot->prev = t;
+    w->count++;
+    return OBD_OK;
+}
+
+void obd_wheel_cancel(obd_wheel_t *w, obd_timer_t *t)
+{
+    if (w && t && t->next) {
+        unlink_timer(t);
+        w->count--;
+    }
+}
+
+obd_timer_t *obd_wheel_expire(obd_wheel_t *w, uint64_t now_us)
+{
+    uint64_t now_tick;
+
+    if (!w) {
+        return NULL;
+    }
+    now_tick = now_us / w->tick_us;
+    if (w->count == 0) {
+        if (now_tick > w->cursor) w->cursor = now_tick;
+        return NULL;
+    }
+
+    /* After a long sleep, one full turn visits every slot anyway */
+    if (now_tick > w->cursor + SLOT_MASK) {
+        w->cursor = now_tick - SLOT_MASK;
+    }
+
+    for (;;) {
+        obd_timer_t *slot = &w->slots[w->cursor & SLOT_MASK];
+        obd_timer_t *t;
+
+        for (t = slot->next; t != slot; t = t->next) {
+            if (t->expires_us <= now_us) {
+                unlink_timer(t);
+                w->count--;
+                return t;
+            }
+        }
+        if (w->cursor >= now_tick) {
+            return NULL;
+        }
+        w->cursor++;
+    }
+}
+
+uint64_t obd_wheel_next_expiry(const obd_wheel_t *w)
+{
+    uint64_t earliest = UINT64_MAX;
+    size_t offset;
+
+    if (!w || w->count == 0) {
+        return 0;
+    }
+
+    /* Walk one turn from the cursor. The first timer due within its own
+     * slot's tick is the answer; timers a turn or more away only count
+     * if nothing nearer exists. */
+    for (offset = 0; offset < OBD_WHEEL_SLOTS; offset++) {
+        uint64_t tick = w->cursor + offset;
+        const obd_timer_t *slot = &w->slots[tick & SLOT_MASK];
+        const obd_timer_t *t;
+        uint64_t in_turn = UINT64_MAX;
+
+        for (t = slot->next; t != slot; t = t->next) {
+            if (t->expires_us / w->tick_us <= tick) {
+                if (t->expires_us < in_turn) in_turn = t->expires_us;
+            } else if (t->expires_us < earliest) {
+                earliest = t->expires_us;
+            }
+        }
+        if (in_turn != UINT64_MAX) {
+            return in_turn;
+        }
+    }
+    return earliest;
+}
+
+size_t obd_wheel_count(const obd_wheel_t *w)
+{
+    return w ? w->count : 0;
+}
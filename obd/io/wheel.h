@@ -0,0 +1,10 @@
+/**
+ * wheel.h — Internal header for the timer wheel.
+ */
+
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#include <obd/obd_io.h>
+
+#endif /* WHEEL_H */
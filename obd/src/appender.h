@@ -0,0 +1,67 @@
+/**
+ * appender.h — Internal helper for writing text reports into a
+ * caller-provided buffer (stats, trace and cache dumpers).
+ *
+ * Usage:
+ *   appender_t a;
+ *   appender_init(&a, out, out_size);
+ *   append(&a, "%s: %d\n", name, value);
+ *   ...
+ *   return appender_finish(&a);  → OBD_OK or OBD_ERROR_BUFFER_TOO_SMALL
+ *
+ * Once the buffer runs out, further appends are ignored and finish()
+ * leaves an empty string behind, so callers never see half a report.
+ */
+
+#ifndef APPENDER_H
+#define APPENDER_H
+
+#include <obd/obd_types.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+typedef struct {
+    char  *buf;
+    size_t size;
+    size_t pos;
+    int    overflow;
+} appender_t;
+
+static inline void appender_init(appender_t *a, char *out, size_t out_size)
+{
+    a->buf = out;
+    a->size = out_size;
+    a->pos = 0;
+    a->overflow = 0;
+    out[0] = '\0';
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((format(printf, 2, 3)))
+#endif
+static inline void append(appender_t *a, const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    if (a->overflow) return;
+    va_start(args, fmt);
+    n = vsnprintf(a->buf + a->pos, a->size - a->pos, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= a->size - a->pos) {
+        a->overflow = 1;
+        return;
+    }
+    a->pos += (size_t)n;
+}
+
+static inline obd_result_t appender_finish(appender_t *a)
+{
+    if (a->overflow) {
+        a->buf[0] = '\0';
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    return OBD_OK;
+}
+
+#endif /* APPENDER_H */
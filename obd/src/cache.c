@@ -0,0 +1,483 @@
+/**
+ * cache.c — TTL response cache and request coalescing in front of a session.
+ *
+ * Several parts of an app ask for the same things independently: the
+ * dashboard wants coolant temperature every second, the trip logger wants
+ * it too, three screens want the VIN. Each ask is a full adapter round
+ * trip (50–150 ms) on a link that can only do one at a time.
+ *
+ * Two ways to ask less:
+ *
+ *   CACHE — keep each answer for its time-to-live (TTL). The VIN never
+ *   changes, so its TTL is forever; coolant temperature moves slowly, so
+ *   a couple of seconds is fine; RPM isn't cached at all.
+ *
+ *   COALESCE — if "010C" is already queued or on the wire, a second ask
+ *   for "010C" doesn't queue another one. It's handed the same request
+ *   id and both askers take the one result.
+ *
+ * Usage:
+ *   r = obd_cache_submit_pid(&cache, &session, 0x01, 0x05, now, &res, &id);
+ *   if (r == OBD_OK)      → res holds the cached answer, nothing was sent
+ *   if (r == OBD_PENDING) → wait for the result with this id from
+ *                           obd_cache_poll() (same as obd_session_poll(),
+ *                           but it also stores the answer)
+ */
+
+#include "cache.h"
+#include "hex_utils.h"
+#include "appender.h"
+#include <obd/obd.h>
+#include <string.h>
+
+#define SECONDS(s) ((uint64_t)(s) * 1000000u)
+
+/*
+ * Built-in TTLs, used when no rule from obd_cache_set_ttl() matches.
+ * Anything not listed here is not cached (TTL 0) but still coalesced.
+ */
+static const obd_cache_ttl_rule_t default_rules[] = {
+    /* Mode 09 — VIN, calibration IDs/CVNs, ECU name: fixed per vehicle */
+    { 0x09, OBD_CACHE_ANY_PID, OBD_CACHE_TTL_FOREVER },
+
+    /* Supported-PID bitmaps, OBD standard, fuel type: fixed per vehicle */
+    { 0x01, 0x00, OBD_CACHE_TTL_FOREVER },
+    { 0x01, 0x20, OBD_CACHE_TTL_FOREVER },
+    { 0x01, 0x40, OBD_CACHE_TTL_FOREVER },
+    { 0x01, 0x60, OBD_CACHE_TTL_FOREVER },
+    { 0x01, 0x80, OBD_CACHE_TTL_FOREVER },
+    { 0x01, 0xA0, OBD_CACHE_TTL_FOREVER },
+    { 0x01, 0xC0, OBD_CACHE_TTL_FOREVER },
+    { 0x01, 0x1C, OBD_CACHE_TTL_FOREVER },
+    { 0x01, 0x51, OBD_CACHE_TTL_FOREVER },
+
+    /* Slow sensors: temperatures move over minutes, not milliseconds */
+    { 0x01, 0x05, SECONDS(2) },     /* Coolant temperature */
+    { 0x01, 0x0F, SECONDS(2) },     /* Intake air temperature */
+    { 0x01, 0x5C, SECONDS(2) },     /* Engine oil temperature */
+    { 0x01, 0x46, SECONDS(10) },    /* Ambient air temperature */
+    { 0x01, 0x2F, SECONDS(10) },    /* Fuel level */
+    { 0x01, 0x33, SECONDS(10) },    /* Barometric pressure */
+};
+#define DEFAULT_RULE_COUNT (sizeof(default_rules) / sizeof(default_rules[0]))
+
+
+/* Look for a rule: exact PID first, then a whole-mode rule */
+static const obd_cache_ttl_rule_t *find_rule(const obd_cache_ttl_rule_t *rules,
+                                             size_t count, uint8_t mode, uint8_t pid)
+{
+    const obd_cache_ttl_rule_t *any = NULL;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (rules[i].mode != mode) continue;
+        if (rules[i].pid == pid) return &rules[i];
+        if (rules[i].pid == OBD_CACHE_ANY_PID && !any) any = &rules[i];
+    }
+    return any;
+}
+
+uint64_t obd_cache_ttl_us(const obd_cache_t *cache, uint8_t mode, uint8_t pid)
+{
+    const obd_cache_ttl_rule_t *rule = NULL;
+
+    if (cache) {
+        rule = find_rule(cache->rules, cache->rule_count, mode, pid);
+    }
+    if (!rule) {
+        rule = find_rule(default_rules, DEFAULT_RULE_COUNT, mode, pid);
+    }
+    return rule ? rule->ttl_us : 0;
+}
+
+obd_result_t obd_cache_init(obd_cache_t *cache)
+{
+    if (!cache) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(cache, 0, sizeof(*cache));
+    return OBD_OK;
+}
+
+obd_result_t obd_cache_set_ttl(obd_cache_t *cache, uint8_t mode, uint16_t pid,
+                               uint64_t ttl_us)
+{
+    size_t i;
+
+    if (!cache || (pid > 0xFF && pid != OBD_CACHE_ANY_PID)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    for (i = 0; i < cache->rule_count; i++) {
+        if (cache->rules[i].mode == mode && cache->rules[i].pid == pid) {
+            cache->rules[i].ttl_us = ttl_us;
+            return OBD_OK;
+        }
+    }
+    if (cache->rule_count >= OBD_CACHE_TTL_RULES) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    cache->rules[cache->rule_count].mode = mode;
+    cache->rules[cache->rule_count].pid = pid;
+    cache->rules[cache->rule_count].ttl_us = ttl_us;
+    cache->rule_count++;
+    return OBD_OK;
+}
+
+
+/* ── Keys ────────────────────────────────────────────────────────────────
+ *
+ * A request's key is its command text, normalized: "01 0c\r" → "010C".
+ * Only all-hex (OBD) commands get a key. AT commands change the adapter's
+ * state, so two of them must both really be sent.
+ *
+ * Returns 1 and fills key/mode/pid for OBD commands, 0 otherwise.
+ */
+static int make_key(const char *command, char *key, uint8_t *mode, uint8_t *pid)
+{
+    size_t len = 0;
+    const char *p;
+
+    for (p = command; *p != '\0'; p++) {
+        char c = *p;
+        if (c == ' ' || c == '\r' || c == '\n') continue;
+        if (hex_char_to_nibble(c) < 0) return 0;
+        if (len + 1 >= OBD_MAX_COMMAND_LEN) return 0;
+        key[len++] = (c >= 'a' && c <= 'f') ? (char)(c - 'a' + 'A') : c;
+    }
+    key[len] = '\0';
+    if (len < 2) return 0;
+
+    *mode = (uint8_t)((hex_char_to_nibble(key[0]) << 4) | hex_char_to_nibble(key[1]));
+    *pid = 0;
+    if (len >= 4) {
+        *pid = (uint8_t)((hex_char_to_nibble(key[2]) << 4) | hex_char_to_nibble(key[3]));
+    }
+    return 1;
+}
+
+static obd_cache_entry_t *find_entry(obd_cache_t *cache, const char *key)
+{
+    size_t i;
+    for (i = 0; i < OBD_CACHE_ENTRIES; i++) {
+        if (cache->entries[i].key[0] != '\0' && strcmp(cache->entries[i].key, key) == 0) {
+            return &cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static obd_cache_inflight_t *find_inflight_key(obd_cache_t *cache, const char *key)
+{
+    size_t i;
+    for (i = 0; i < OBD_CACHE_INFLIGHT; i++) {
+        if (cache->inflight[i].key[0] != '\0' && strcmp(cache->inflight[i].key, key) == 0) {
+            return &cache->inflight[i];
+        }
+    }
+    return NULL;
+}
+
+static obd_cache_inflight_t *find_inflight_id(obd_cache_t *cache, uint32_t id)
+{
+    size_t i;
+    for (i = 0; i < OBD_CACHE_INFLIGHT; i++) {
+        if (cache->inflight[i].key[0] != '\0' && cache->inflight[i].id == id) {
+            return &cache->inflight[i];
+        }
+    }
+    return NULL;
+}
+
+
+/* ── Asking ──────────────────────────────────────────────────────────── */
+
+/* Steps 1 and 2 of asking: a fresh answer, or a request to share */
+static obd_result_t lookup(obd_cache_t *cache, const char *key, uint64_t now_us,
+                           obd_session_result_t *out, uint32_t *out_id)
+{
+    obd_cache_entry_t *entry;
+    obd_cache_inflight_t *flight;
+
+    /* 1. Fresh answer in the cache? */
+    entry = find_entry(cache, key);
+    if (entry) {
+        if (entry->expires_us == OBD_CACHE_TTL_FOREVER || now_us < entry->expires_us) {
+            entry->hits++;
+            entry->last_used_us = now_us;
+            cache->stats.hits++;
+            *out = entry->result;
+            if (out_id) *out_id = entry->result.id;
+            return OBD_OK;
+        }
+        entry->key[0] = '\0';                   /* Stale: drop it */
+        cache->stats.expired++;
+    }
+
+    /* 2. Already on its way? Share that round trip. */
+    flight = find_inflight_key(cache, key);
+    if (flight) {
+        cache->stats.coalesced++;
+        if (out_id) *out_id = flight->id;
+        return OBD_PENDING;
+    }
+    return OBD_ERROR_NO_DATA;
+}
+
+/*
+ * Like obd_cache_submit_command(), but never sends: a caller that wants
+ * to decide for itself what goes out next (the multiplexer batches
+ * several PIDs into one request) asks here first.
+ */
+obd_result_t obd_cache_lookup(obd_cache_t *cache, const char *command, uint64_t now_us,
+                              obd_session_result_t *out, uint32_t *out_id)
+{
+    char key[OBD_MAX_COMMAND_LEN];
+    uint8_t mode, pid;
+
+    if (!cache || !command || !out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (!make_key(command, key, &mode, &pid)) {
+        return OBD_ERROR_NO_DATA;               /* AT commands are never cached */
+    }
+    return lookup(cache, key, now_us, out, out_id);
+}
+
+obd_result_t obd_cache_submit_command(obd_cache_t *cache, obd_session_t *session,
+                                      const char *command, uint64_t now_us,
+                                      obd_session_result_t *out, uint32_t *out_id)
+{
+    char key[OBD_MAX_COMMAND_LEN];
+    uint8_t mode, pid;
+    obd_cache_inflight_t *flight;
+    uint32_t id;
+    obd_result_t r;
+    size_t i;
+
+    if (!cache || !session || !command || !out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    if (!make_key(command, key, &mode, &pid)) {
+        r = obd_session_submit_command(session, command, now_us, out_id);
+        if (r != OBD_OK) return r;
+        cache->stats.passthrough++;
+        return OBD_PENDING;
+    }
+
+    r = lookup(cache, key, now_us, out, out_id);
+    if (r != OBD_ERROR_NO_DATA) {
+        return r;
+    }
+
+    /* 3. Send it */
+    for (i = 0; i < OBD_CACHE_INFLIGHT; i++) {
+        if (cache->inflight[i].key[0] == '\0') break;
+    }
+    if (i == OBD_CACHE_INFLIGHT) {
+        return OBD_ERROR_BUSY;
+    }
+
+    r = obd_session_submit_command(session, key, now_us, &id);
+    if (r != OBD_OK) {
+        return r;
+    }
+    flight = &cache->inflight[i];
+    memcpy(flight->key, key, sizeof(key));
+    flight->id = id;
+    cache->stats.misses++;
+
+    if (out_id) *out_id = id;
+    return OBD_PENDING;
+}
+
+obd_result_t obd_cache_submit_pid(obd_cache_t *cache, obd_session_t *session,
+                                  uint8_t mode, uint8_t pid, uint64_t now_us,
+                                  obd_session_result_t *out, uint32_t *out_id)
+{
+    char command[OBD_MAX_COMMAND_LEN];
+    obd_result_t r;
+
+    r = obd_pid_build_request(mode, pid, command, sizeof(command));
+    if (r != OBD_OK) {
+        return r;
+    }
+    return obd_cache_submit_command(cache, session, command, now_us, out, out_id);
+}
+
+
+/* ── Answers ─────────────────────────────────────────────────────────── */
+
+/* Pick a slot for a new entry: a free one, else the least recently used */
+static obd_cache_entry_t *claim_entry(obd_cache_t *cache)
+{
+    obd_cache_entry_t *oldest = &cache->entries[0];
+    size_t i;
+
+    for (i = 0; i < OBD_CACHE_ENTRIES; i++) {
+        obd_cache_entry_t *e = &cache->entries[i];
+        if (e->key[0] == '\0') return e;
+        if (e->last_used_us < oldest->last_used_us) oldest = e;
+    }
+    cache->stats.evictions++;
+    return oldest;
+}
+
+/* Save a finished result under `key` if it's OK and its TTL allows */
+static void store(obd_cache_t *cache, const char *key,
+                  const obd_session_result_t *result, uint64_t now_us)
+{
+    obd_cache_entry_t *entry;
+    uint64_t ttl;
+
+    /* Errors (NO DATA, timeouts) aren't stored: the next ask retries */
+    ttl = obd_cache_ttl_us(cache, result->mode, result->pid);
+    if (result->status != OBD_OK || ttl == 0) {
+        return;
+    }
+
+    entry = find_entry(cache, key);
+    if (!entry) entry = claim_entry(cache);
+
+    memcpy(entry->key, key, sizeof(entry->key));
+    entry->result = *result;
+    entry->hits = 0;
+    entry->last_used_us = now_us;
+    entry->expires_us = (ttl == OBD_CACHE_TTL_FOREVER || now_us > UINT64_MAX - ttl)
+                      ? OBD_CACHE_TTL_FOREVER : now_us + ttl;
+    cache->stats.stores++;
+}
+
+obd_result_t obd_cache_complete(obd_cache_t *cache, const obd_session_result_t *result,
+                                uint64_t now_us)
+{
+    obd_cache_inflight_t *flight;
+
+    if (!cache || !result) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    flight = find_inflight_id(cache, result->id);
+    if (!flight) {
+        return OBD_OK;                  /* Not ours (AT command, or uncached) */
+    }
+
+    store(cache, flight->key, result, now_us);
+    flight->key[0] = '\0';
+    return OBD_OK;
+}
+
+obd_result_t obd_cache_store(obd_cache_t *cache, const char *command,
+                             const obd_session_result_t *result, uint64_t now_us)
+{
+    char key[OBD_MAX_COMMAND_LEN];
+    uint8_t mode, pid;
+
+    if (!cache || !command || !result) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (!make_key(command, key, &mode, &pid)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    store(cache, key, result, now_us);
+    return OBD_OK;
+}
+
+obd_result_t obd_cache_poll(obd_cache_t *cache, obd_session_t *session,
+                            uint64_t now_us, obd_session_result_t *out)
+{
+    obd_result_t r;
+
+    if (!cache || !session || !out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    r = obd_session_poll(session, out);
+    if (r != OBD_OK) {
+        return r;
+    }
+    return obd_cache_complete(cache, out, now_us);
+}
+
+obd_result_t obd_cache_invalidate(obd_cache_t *cache, const char *command)
+{
+    char key[OBD_MAX_COMMAND_LEN];
+    obd_cache_entry_t *entry;
+    uint8_t mode, pid;
+    size_t i;
+
+    if (!cache) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (!command) {
+        for (i = 0; i < OBD_CACHE_ENTRIES; i++) cache->entries[i].key[0] = '\0';
+        return OBD_OK;
+    }
+    if (!make_key(command, key, &mode, &pid)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    entry = find_entry(cache, key);
+    if (entry) entry->key[0] = '\0';
+    return OBD_OK;
+}
+
+
+/* ── Reporting ───────────────────────────────────────────────────────── */
+
+obd_result_t obd_cache_get_stats(const obd_cache_t *cache, obd_cache_stats_t *out)
+{
+    if (!cache || !out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    *out = cache->stats;
+    return OBD_OK;
+}
+
+/*
+ *   hits 412  misses 37  coalesced 9  hit rate 91.8%
+ *   expired 20  stores 31  evictions 0  passthrough 6
+ *   key       hits   expires in
+ *   0902        57   never
+ *   0105        12   1.4 s
+ */
+obd_result_t obd_cache_format_text(const obd_cache_t *cache, uint64_t now_us,
+                                   char *out, size_t out_size)
+{
+    const obd_cache_stats_t *st;
+    appender_t a;
+    uint64_t asked;
+    size_t i;
+
+    if (!cache || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    appender_init(&a, out, out_size);
+    st = &cache->stats;
+
+    /* Coalesced asks were saved a round trip too, so they count as hits
+     * for the rate: "how many asks didn't cost a round trip of their own" */
+    asked = st->hits + st->misses + st->coalesced;
+    append(&a, "hits %llu  misses %llu  coalesced %llu  hit rate %.1f%%\n",
+           (unsigned long long)st->hits, (unsigned long long)st->misses,
+           (unsigned long long)st->coalesced,
+           asked ? 100.0 * (double)(st->hits + st->coalesced) / (double)asked : 0.0);
+    append(&a, "expired %llu  stores %llu  evictions %llu  passthrough %llu\n",
+           (unsigned long long)st->expired, (unsigned long long)st->stores,
+           (unsigned long long)st->evictions, (unsigned long long)st->passthrough);
+    append(&a, "%-10s %6s   %s\n", "key", "hits", "expires in");
+
+    for (i = 0; i < OBD_CACHE_ENTRIES; i++) {
+        const obd_cache_entry_t *e = &cache->entries[i];
+        if (e->key[0] == '\0') continue;
+
+        if (e->expires_us == OBD_CACHE_TTL_FOREVER) {
+            append(&a, "%-10s %6u   never\n", e->key, (unsigned)e->hits);
+        } else if (e->expires_us > now_us) {
+            append(&a, "%-10s %6u   %.1f s\n", e->key, (unsigned)e->hits,
+                   (double)(e->expires_us - now_us) / 1e6);
+        } else {
+            append(&a, "%-10s %6u   expired\n", e->key, (unsigned)e->hits);
+        }
+    }
+    return appender_finish(&a);
+}
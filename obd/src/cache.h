@@ -0,0 +1,10 @@
+/**
+ * cache.h — Internal header for the response cache.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <obd/obd_types.h>
+
+#endif /* CACHE_H */
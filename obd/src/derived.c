@@ -0,0 +1,355 @@
+/**
+ * derived.c — Derived (virtual) sensors.
+ *
+ * Some of the most useful numbers aren't PIDs at all:
+ *
+ *   fuel rate      = MAF × 3600 / (14.7 × 740)        L/h
+ *   fuel economy   = fuel rate × 100 / speed           L/100 km
+ *   boost          = MAP − barometric pressure         kPa
+ *   trip distance  = ∫ speed dt                        km
+ *
+ * Each is a definition (obd_derived_def_t): its inputs, one of four
+ * operations and its coefficients. Inputs can be PIDs or other derived
+ * values, so the definitions form a graph: MAF → fuel rate → economy and
+ * fuel used. obd_derived_init() sorts it once, inputs before the values
+ * made from them (and refuses cycles).
+ *
+ * After that, each sample fed in marks its slot "dirty" and one pass over
+ * the sorted definitions recomputes exactly those that read a dirty slot,
+ * marking their own output dirty in turn. A speed sample touches economy,
+ * gear and distance; it never recomputes boost.
+ *
+ * Integrals use the inputs' sample times, not the time of the call, and
+ * add up trapezoids between consecutive samples. A gap longer than the
+ * definition's limit (the adapter dropped out) is left out rather than
+ * bridged with a straight line.
+ */
+
+#include "derived.h"
+#include "sensor.h"
+#include <obd/obd.h>
+#include <string.h>
+
+/* ── Built-in definitions ────────────────────────────────────────────────
+ *
+ * Petrol at 14.7:1 air/fuel and 740 g/L. Power assumes 43 kJ/g and 30%
+ * efficiency: a rough estimate, but it moves with the throttle.
+ */
+static const obd_derived_def_t default_defs[] = {
+    { OBD_DERIVED_FUEL_RATE, "Fuel Rate", "L/h", OBD_DERIVED_LINEAR, 1,
+      { 0x10 }, { 0.33094f }, 0.0f, 0.0f },
+    { OBD_DERIVED_ECONOMY, "Fuel Economy", "L/100km", OBD_DERIVED_RATIO, 2,
+      { OBD_DERIVED_FUEL_RATE, 0x0D }, { 100.0f }, 0.0f, 1.0f },        /* Not below 1 km/h */
+    { OBD_DERIVED_BOOST, "Boost Pressure", "kPa", OBD_DERIVED_LINEAR, 2,
+      { 0x0B, 0x33 }, { 1.0f, -1.0f }, 0.0f, 0.0f },
+    { OBD_DERIVED_POWER, "Engine Power (est.)", "kW", OBD_DERIVED_LINEAR, 1,
+      { 0x10 }, { 0.8776f }, 0.0f, 0.0f },
+    { OBD_DERIVED_GEAR, "Engine Speed Ratio", "rpm/kmh", OBD_DERIVED_RATIO, 2,
+      { 0x0C, 0x0D }, { 1.0f }, 0.0f, 5.0f },                           /* Clutch in, standing */
+    { OBD_DERIVED_DISTANCE, "Trip Distance", "km", OBD_DERIVED_INTEGRAL, 1,
+      { 0x0D }, { 1.0f / 3600.0f }, 0.0f, 5.0f },                       /* km/h × s → km */
+    { OBD_DERIVED_FUEL_USED, "Fuel Used", "L", OBD_DERIVED_INTEGRAL, 1,
+      { OBD_DERIVED_FUEL_RATE }, { 1.0f / 3600.0f }, 0.0f, 5.0f },
+};
+
+const obd_derived_def_t *obd_derived_defaults(size_t *count)
+{
+    if (count) {
+        *count = sizeof(default_defs) / sizeof(default_defs[0]);
+    }
+    return default_defs;
+}
+
+
+/* ── Value table ─────────────────────────────────────────────────────────── */
+
+static int slot_of(const obd_derived_t *d, uint16_t channel)
+{
+    size_t i;
+    for (i = 0; i < d->slot_count; i++) {
+        if (d->slots[i].channel == channel) return (int)i;
+    }
+    return -1;
+}
+
+static int add_slot(obd_derived_t *d, uint16_t channel, const char *name, const char *unit)
+{
+    obd_derived_slot_t *s;
+
+    if (d->slot_count >= OBD_DERIVED_MAX_CHANNELS) {
+        return -1;
+    }
+    s = &d->slots[d->slot_count];
+    memset(s, 0, sizeof(*s));
+    s->channel = channel;
+    s->name = "";
+    s->unit = "";
+    if (name) {
+        s->name = name;
+        s->unit = unit;
+    } else if (channel < OBD_DERIVED_CHANNEL_BASE) {
+        sensor_lookup((uint8_t)channel, &s->name, &s->unit);
+    }
+    return (int)d->slot_count++;
+}
+
+static int find_def(const obd_derived_def_t *defs, size_t count, uint16_t channel)
+{
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (defs[i].channel == channel) return (int)i;
+    }
+    return -1;
+}
+
+
+/* ── Setup ───────────────────────────────────────────────────────────────── */
+
+static int valid_def(const obd_derived_def_t *def)
+{
+    if (def->channel < OBD_DERIVED_CHANNEL_BASE || !def->name || !def->unit) {
+        return 0;
+    }
+    switch (def->op) {
+    case OBD_DERIVED_LINEAR:   return def->input_count >= 1 &&
+                                      def->input_count <= OBD_DERIVED_MAX_INPUTS;
+    case OBD_DERIVED_PRODUCT:
+    case OBD_DERIVED_RATIO:    return def->input_count == 2;
+    case OBD_DERIVED_INTEGRAL: return def->input_count == 1;
+    default:                   return 0;
+    }
+}
+
+/* Inputs before outputs (Kahn's algorithm, quadratic: there are at most 16) */
+static obd_result_t sort_defs(obd_derived_t *d)
+{
+    uint8_t placed[OBD_DERIVED_MAX_DEFS] = { 0 };
+    size_t n = 0, i, j;
+
+    while (n < d->def_count) {
+        size_t before = n;
+
+        for (i = 0; i < d->def_count; i++) {
+            const obd_derived_def_t *def = &d->defs[i];
+            int ready = !placed[i];
+
+            for (j = 0; ready && j < def->input_count; j++) {
+                if (def->inputs[j] >= OBD_DERIVED_CHANNEL_BASE) {
+                    ready = placed[find_def(d->defs, d->def_count, def->inputs[j])];
+                }
+            }
+            if (ready) {
+                placed[i] = 1;
+                d->order[n++] = (uint8_t)i;
+            }
+        }
+        if (n == before) {
+            return OBD_ERROR_INVALID_ARG;     /* A cycle */
+        }
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_derived_init(obd_derived_t *d, const obd_derived_def_t *defs, size_t count,
+                              uint64_t max_age_us)
+{
+    size_t i, j;
+    obd_result_t r;
+
+    if (!d || (!defs && count > 0) || count > OBD_DERIVED_MAX_DEFS) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(d, 0, sizeof(*d));
+    d->defs = defs;
+    d->def_count = count;
+    d->max_age_us = max_age_us;
+
+    for (i = 0; i < count; i++) {
+        if (!valid_def(&defs[i]) || find_def(defs, i, defs[i].channel) >= 0) {
+            return OBD_ERROR_INVALID_ARG;
+        }
+    }
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < defs[i].input_count; j++) {
+            uint16_t in = defs[i].inputs[j];
+            if (in > 0xFF && find_def(defs, count, in) < 0) {
+                return OBD_ERROR_INVALID_ARG; /* Neither a PID nor defined */
+            }
+        }
+    }
+    r = sort_defs(d);
+    if (r != OBD_OK) {
+        return r;
+    }
+
+    /* Outputs first, so a definition's slot exists before anything reads it */
+    for (i = 0; i < count; i++) {
+        int s = add_slot(d, defs[i].channel, defs[i].name, defs[i].unit);
+        if (s < 0) return OBD_ERROR_BUFFER_TOO_SMALL;
+        d->out_slot[i] = (uint8_t)s;
+        d->slots[s].value = defs[i].offset;
+    }
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < defs[i].input_count; j++) {
+            int s = slot_of(d, defs[i].inputs[j]);
+            if (s < 0) s = add_slot(d, defs[i].inputs[j], NULL, NULL);
+            if (s < 0) return OBD_ERROR_BUFFER_TOO_SMALL;
+            d->in_slot[i][j] = (uint8_t)s;
+            d->in_mask[i] |= 1u << s;
+        }
+    }
+    return OBD_OK;
+}
+
+
+/* ── Evaluation ──────────────────────────────────────────────────────────── */
+
+static void integrate(obd_derived_t *d, size_t i)
+{
+    const obd_derived_def_t *def = &d->defs[i];
+    const obd_derived_slot_t *in = &d->slots[d->in_slot[i][0]];
+    obd_derived_slot_t *out = &d->slots[d->out_slot[i]];
+
+    if (!in->has_value) {
+        d->has_prev[i] = 0;                   /* Don't bridge the gap */
+        return;
+    }
+    if (d->has_prev[i] && in->t_us <= d->prev_t_us[i]) {
+        return;                               /* Same or older sample */
+    }
+    if (d->has_prev[i]) {
+        double dt = (double)(in->t_us - d->prev_t_us[i]) / 1e6;
+        if (def->limit <= 0.0f || dt <= (double)def->limit) {
+            out->value += (float)((double)def->k[0] *
+                                  ((double)d->prev_value[i] + (double)in->value) / 2.0 * dt);
+        }
+    }
+    d->has_prev[i] = 1;
+    d->prev_value[i] = in->value;
+    d->prev_t_us[i] = in->t_us;
+    out->has_value = 1;
+    out->t_us = in->t_us;
+}
+
+static void evaluate(obd_derived_t *d, size_t i)
+{
+    const obd_derived_def_t *def = &d->defs[i];
+    obd_derived_slot_t *out = &d->slots[d->out_slot[i]];
+    float in[OBD_DERIVED_MAX_INPUTS] = { 0 };
+    uint64_t newest = 0, oldest = UINT64_MAX;
+    float v, den;
+    size_t j;
+
+    d->evaluations++;
+    if (def->op == OBD_DERIVED_INTEGRAL) {
+        integrate(d, i);
+        return;
+    }
+
+    out->has_value = 0;
+    for (j = 0; j < def->input_count; j++) {
+        const obd_derived_slot_t *s = &d->slots[d->in_slot[i][j]];
+        if (!s->has_value) return;
+        in[j] = s->value;
+        if (s->t_us > newest) newest = s->t_us;
+        if (s->t_us < oldest) oldest = s->t_us;
+    }
+    if (d->max_age_us > 0 && newest - oldest > d->max_age_us) {
+        return;                               /* An input went stale */
+    }
+
+    switch (def->op) {
+    case OBD_DERIVED_LINEAR:
+        v = def->offset;
+        for (j = 0; j < def->input_count; j++) v += def->k[j] * in[j];
+        break;
+    case OBD_DERIVED_PRODUCT:
+        v = def->offset + def->k[0] * in[0] * in[1];
+        break;
+    default:                                  /* OBD_DERIVED_RATIO */
+        den = in[1] < 0.0f ? -in[1] : in[1];
+        if (den == 0.0f || den < def->limit) return;
+        v = def->offset + def->k[0] * in[0] / in[1];
+        break;
+    }
+    out->value = v;
+    out->has_value = 1;
+    out->t_us = newest;
+}
+
+/* Recompute every definition reading a dirty slot, in dependency order */
+static void propagate(obd_derived_t *d, uint32_t dirty)
+{
+    size_t k;
+
+    for (k = 0; k < d->def_count; k++) {
+        size_t i = d->order[k];
+        if (d->in_mask[i] & dirty) {
+            evaluate(d, i);
+            dirty |= 1u << d->out_slot[i];
+        }
+    }
+}
+
+obd_result_t obd_derived_feed(obd_derived_t *d, uint8_t pid, float value, uint64_t t_us)
+{
+    int s;
+
+    if (!d) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    s = slot_of(d, pid);
+    if (s < 0) {
+        s = add_slot(d, pid, NULL, NULL);     /* Shown, not used */
+        if (s < 0) return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    d->slots[s].value = value;
+    d->slots[s].t_us = t_us;
+    d->slots[s].has_value = 1;
+    propagate(d, 1u << s);
+    return OBD_OK;
+}
+
+obd_result_t obd_derived_feed_response(obd_derived_t *d, const obd_pid_response_t *response,
+                                       uint64_t t_us)
+{
+    obd_sensor_value_t v;
+    obd_result_t r;
+
+    if (!d || !response) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    r = obd_sensor_decode(response, &v);
+    if (r != OBD_OK) {
+        return r;
+    }
+    return obd_derived_feed(d, v.pid, v.value, t_us);
+}
+
+const obd_derived_slot_t *obd_derived_find(const obd_derived_t *d, uint16_t channel)
+{
+    int s;
+
+    if (!d) {
+        return NULL;
+    }
+    s = slot_of(d, channel);
+    return s < 0 ? NULL : &d->slots[s];
+}
+
+obd_result_t obd_derived_reset(obd_derived_t *d, uint16_t channel)
+{
+    int i;
+
+    if (!d) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    i = find_def(d->defs, d->def_count, channel);
+    if (i < 0 || d->defs[i].op != OBD_DERIVED_INTEGRAL) {
+        return OBD_ERROR_UNKNOWN_PID;
+    }
+    d->slots[d->out_slot[i]].value = d->defs[i].offset;
+    d->has_prev[i] = 0;                       /* The new trip starts at the next sample */
+    propagate(d, 1u << d->out_slot[i]);
+    return OBD_OK;
+}
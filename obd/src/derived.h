@@ -0,0 +1,10 @@
+/**
+ * derived.h — Internal header for derived sensors.
+ */
+
+#ifndef DERIVED_H
+#define DERIVED_H
+
+#include <obd/obd_types.h>
+
+#endif /* DERIVED_H */
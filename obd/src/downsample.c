@@ -0,0 +1,264 @@
+/**
+ * downsample.c — Fewer points for a chart: Largest-Triangle-Three-Buckets,
+ * and a min/max pyramid for zooming.
+ *
+ * LTTB keeps what the eye would miss (spikes, turning points), but it
+ * reads every sample in the window, so a whole trip costs the whole trip
+ * on every redraw. The pyramid is for that: its blocks already hold each
+ * stretch's extremes, and a column of the chart is made from a handful
+ * of blocks of about its own width, so a redraw costs the width of the
+ * chart, not of the window.
+ *
+ * Nothing here allocates: the pyramid lives in the caller's buffer, in a
+ * layout computed from the sample count each time it's built or attached.
+ */
+
+#include "downsample.h"
+#include <obd/obd.h>
+#include <math.h>
+#include <stdint.h>
+
+obd_result_t obd_lttb(const float *x, const float *y, size_t n, size_t threshold,
+                      size_t *index, size_t *count)
+{
+    double every, avg_x, avg_y, area, best;
+    size_t i, j, a, from, to, next_from, next_to, pick, kept = 0;
+
+    if (!x || !y || !index || !count) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (n <= threshold) {
+        for (i = 0; i < n; i++) {
+            index[i] = i;
+        }
+        *count = n;
+        return OBD_OK;
+    }
+    if (threshold < 3) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    /* Buckets between the first and last samples, each `every` wide (> 1) */
+    every = (double)(n - 2) / (double)(threshold - 2);
+    a = 0;
+    index[kept++] = 0;
+    for (i = 0; i < threshold - 2; i++) {
+        next_from = (size_t)((double)(i + 1) * every) + 1;
+        next_to = (size_t)((double)(i + 2) * every) + 1;
+        if (next_to > n) next_to = n;
+        avg_x = avg_y = 0.0;
+        for (j = next_from; j < next_to; j++) {
+            avg_x += x[j];
+            avg_y += y[j];
+        }
+        avg_x /= (double)(next_to - next_from);
+        avg_y /= (double)(next_to - next_from);
+
+        from = (size_t)((double)i * every) + 1;
+        to = (size_t)((double)(i + 1) * every) + 1;
+        best = -1.0;
+        pick = from;
+        for (j = from; j < to; j++) {
+            /* Twice the triangle (kept, candidate, next bucket's average) */
+            area = fabs(((double)x[a] - avg_x) * ((double)y[j] - y[a]) -
+                        ((double)x[a] - x[j]) * (avg_y - y[a]));
+            if (area > best) {
+                best = area;
+                pick = j;
+            }
+        }
+        index[kept++] = pick;
+        a = pick;
+    }
+    index[kept++] = n - 1;
+    *count = kept;
+    return OBD_OK;
+}
+
+/* Block counts and offsets for n samples; returns the floats needed */
+static size_t layout(obd_pyramid_t *pyr, size_t n)
+{
+    size_t k, size = 0, block = OBD_PYRAMID_BASE;
+
+    pyr->samples = n;
+    pyr->levels = 0;
+    for (k = 0; n > 0 && k < OBD_PYRAMID_LEVELS; k++) {
+        pyr->blocks[k] = n / block + (n % block != 0);
+        pyr->offset[k] = size;
+        size += 2 * pyr->blocks[k];
+        pyr->levels = k + 1;
+        if (pyr->blocks[k] == 1 || block > SIZE_MAX / OBD_PYRAMID_FANOUT) {
+            break;
+        }
+        block *= OBD_PYRAMID_FANOUT;
+    }
+    return size;
+}
+
+size_t obd_pyramid_size(size_t samples)
+{
+    obd_pyramid_t pyr;
+
+    return layout(&pyr, samples);
+}
+
+/* min/max of src[from..to) pairs (stride 2) or samples (stride 1); NaN ignored */
+static void extremes(const float *src, size_t stride, size_t from, size_t to,
+                     float *lo, float *hi)
+{
+    size_t i;
+
+    *lo = *hi = NAN;
+    for (i = from; i < to; i++) {
+        *lo = fminf(*lo, src[i * stride]);
+        *hi = fmaxf(*hi, src[i * stride + stride - 1]);
+    }
+}
+
+obd_result_t obd_pyramid_build(obd_pyramid_t *pyr, const float *values, size_t n,
+                               float *buf, size_t buf_len)
+{
+    const float *below;
+    size_t k, b, to, size;
+    float *level;
+
+    if (!pyr || !values || !buf || n == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    size = layout(pyr, n);
+    if (buf_len < size) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    for (b = 0; b < pyr->blocks[0]; b++) {
+        to = (b + 1) * OBD_PYRAMID_BASE;
+        extremes(values, 1, b * OBD_PYRAMID_BASE, to < n ? to : n,
+                 &buf[2 * b], &buf[2 * b + 1]);
+    }
+    for (k = 1; k < pyr->levels; k++) {
+        below = buf + pyr->offset[k - 1];
+        level = buf + pyr->offset[k];
+        for (b = 0; b < pyr->blocks[k]; b++) {
+            to = (b + 1) * OBD_PYRAMID_FANOUT;
+            if (to > pyr->blocks[k - 1]) to = pyr->blocks[k - 1];
+            extremes(below, 2, b * OBD_PYRAMID_FANOUT, to, &level[2 * b], &level[2 * b + 1]);
+        }
+    }
+    pyr->data = buf;
+    return OBD_OK;
+}
+
+obd_result_t obd_pyramid_attach(obd_pyramid_t *pyr, const float *buf, size_t buf_len,
+                                size_t n)
+{
+    if (!pyr || !buf || n == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (buf_len < layout(pyr, n)) {
+        pyr->levels = 0;
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    pyr->data = buf;
+    return OBD_OK;
+}
+
+/*
+ * Extremes of samples [from, to), exactly: the biggest aligned blocks
+ * that fit, and the samples themselves for the under-a-block ends. At
+ * most FANOUT - 1 blocks a level on the way up and again on the way down,
+ * plus 2 x (BASE - 1) samples. Without values, an end shorter than a
+ * level-0 block takes the whole block: a few samples too many, none lost.
+ */
+static void span_extremes(const obd_pyramid_t *pyr, const float *values, size_t from,
+                          size_t to, float *lo, float *hi)
+{
+    const float *block;
+    size_t k, size;
+
+    *lo = *hi = NAN;
+    while (from < to) {
+        if (from % OBD_PYRAMID_BASE != 0 || from + OBD_PYRAMID_BASE > to) {
+            if (values) {
+                *lo = fminf(*lo, values[from]);
+                *hi = fmaxf(*hi, values[from]);
+                from++;
+                continue;
+            }
+            block = pyr->data + 2 * (from / OBD_PYRAMID_BASE);
+            from = (from / OBD_PYRAMID_BASE + 1) * OBD_PYRAMID_BASE;
+        } else {
+            for (k = 0, size = OBD_PYRAMID_BASE;
+                 k + 1 < pyr->levels && from % (size * OBD_PYRAMID_FANOUT) == 0 &&
+                 from + size * OBD_PYRAMID_FANOUT <= to;
+                 k++, size *= OBD_PYRAMID_FANOUT) {
+            }
+            block = pyr->data + pyr->offset[k] + 2 * (from / size);
+            from += size;
+        }
+        *lo = fminf(*lo, block[0]);
+        *hi = fmaxf(*hi, block[1]);
+    }
+}
+
+obd_result_t obd_pyramid_query(const obd_pyramid_t *pyr, const float *values, size_t first,
+                               size_t last, size_t pixels, float *out)
+{
+    const float *level;
+    uint64_t range, block = OBD_PYRAMID_BASE;
+    size_t c, k = 0, a, b, ba, bb, bs;
+    float lo, hi;
+    int wide;
+
+    if (!pyr || !pyr->data || pyr->levels == 0 || !out || pixels == 0 ||
+        first >= last || last > pyr->samples) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    range = last - first;
+
+    /* The coarsest level with at least two blocks a column */
+    wide = 2 * block * pixels <= range;
+    while (k + 1 < pyr->levels && 2 * block * OBD_PYRAMID_FANOUT * pixels <= range) {
+        block *= OBD_PYRAMID_FANOUT;
+        k++;
+    }
+    level = pyr->data + pyr->offset[k];
+    bs = (size_t)block;
+
+    for (c = 0; c < pixels; c++) {
+        a = first + (size_t)(range * c / pixels);
+        b = first + (size_t)(range * (c + 1) / pixels);
+        if (b == a) b = a + 1;                  /* More columns than samples */
+
+        if (!wide) {
+            if (values) {
+                extremes(values, 1, a, b, &out[2 * c], &out[2 * c + 1]);
+                continue;
+            }
+            ba = a / bs;                        /* Level 0 blocks around it */
+            bb = (b - 1) / bs + 1;
+            extremes(level, 2, ba, bb, &out[2 * c], &out[2 * c + 1]);
+            continue;
+        }
+
+        /* Edges between columns move to the nearest block edge; the
+         * window's own two ends stay where they are */
+        if (c > 0) a = (a + bs / 2) / bs * bs;
+        if (c + 1 < pixels) b = (b + bs / 2) / bs * bs;
+        ba = (a + bs - 1) / bs;                 /* Whole blocks inside [a, b) */
+        bb = b / bs;
+        if (ba >= bb) {
+            span_extremes(pyr, values, a, b, &out[2 * c], &out[2 * c + 1]);
+            continue;
+        }
+        extremes(level, 2, ba, bb, &out[2 * c], &out[2 * c + 1]);
+
+        /* The bits either side: only the window's ends aren't block-aligned */
+        span_extremes(pyr, values, a, ba * bs, &lo, &hi);
+        out[2 * c] = fminf(out[2 * c], lo);
+        out[2 * c + 1] = fmaxf(out[2 * c + 1], hi);
+        span_extremes(pyr, values, bb * bs, b, &lo, &hi);
+        out[2 * c] = fminf(out[2 * c], lo);
+        out[2 * c + 1] = fmaxf(out[2 * c + 1], hi);
+    }
+    return OBD_OK;
+}
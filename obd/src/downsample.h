@@ -0,0 +1,10 @@
+/**
+ * downsample.h — Internal header for LTTB and the min/max pyramid.
+ */
+
+#ifndef DOWNSAMPLE_H
+#define DOWNSAMPLE_H
+
+#include <obd/obd_types.h>
+
+#endif /* DOWNSAMPLE_H */
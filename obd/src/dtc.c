@@ -28,6 +28,7 @@
 
 #include "dtc.h"
 #include "hex_utils.h"
+#include "stats.h"
 #include <obd/obd.h>
 #include <string.h>
 #include <stdio.h>
@@ -61,9 +62,10 @@ obd_result_t obd_dtc_build_request(char *out, size_t out_size)
  *
  * byte1 and byte2 together form the 16-bit DTC encoding.
  * We extract the category from the top 2 bits and format
- * the rest as a 4-digit hex number.
+ * the rest as a 4-digit hex number. Also used by freeze.c for the DTC
+ * that triggered a freeze frame (Mode 02 PID 02).
  */
-static void parse_single_dtc(uint8_t byte1, uint8_t byte2, obd_dtc_t *dtc)
+void parse_single_dtc(uint8_t byte1, uint8_t byte2, obd_dtc_t *dtc)
 {
     /* Top 2 bits of byte1 → category (0-3 → P/C/B/U) */
     uint8_t cat_bits = (byte1 >> 6) & 0x03;
@@ -101,7 +103,7 @@ static void parse_single_dtc(uint8_t byte1, uint8_t byte2, obd_dtc_t *dtc)
  * implementations, but the most common format is just the header
  * followed by DTC byte pairs.
  */
-obd_result_t obd_dtc_parse_response(const char *response, obd_dtc_list_t *out)
+static obd_result_t dtc_parse_response(const char *response, obd_dtc_list_t *out)
 {
     uint8_t bytes[64];
     size_t byte_count = 0;
@@ -150,6 +152,15 @@ obd_result_t obd_dtc_parse_response(const char *response, obd_dtc_list_t *out)
     return OBD_OK;
 }
 
+obd_result_t obd_dtc_parse_response(const char *response, obd_dtc_list_t *out)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = dtc_parse_response(response, out);
+    OBD_STATS_END(OBD_STAT_DTC_PARSE, r);
+    return r;
+}
+
 
 obd_result_t obd_dtc_format(const obd_dtc_t *dtc, char *out, size_t out_size)
 {
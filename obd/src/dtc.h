@@ -7,4 +7,9 @@
 
 #include <obd/obd_types.h>
 
+/**
+ * Decode one DTC from its two raw bytes: {0x03, 0x01} → P0301.
+ */
+void parse_single_dtc(uint8_t byte1, uint8_t byte2, obd_dtc_t *dtc);
+
 #endif /* DTC_H */
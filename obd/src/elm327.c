@@ -14,6 +14,8 @@
 
 #include "elm327.h"
 #include "hex_utils.h"
+#include "reply.h"
+#include "stats.h"
 #include <obd/obd.h>
 #include <string.h>
 
@@ -44,7 +46,7 @@ const char *obd_elm327_cmd_headers_off(void)   { return "ATH0\r"; }
  * We check the most specific patterns first (exact matches like "OK"),
  * then fall back to checking if it looks like hex data.
  */
-obd_elm_response_type_t obd_elm327_classify_response(const char *response)
+static obd_elm_response_type_t classify_response(const char *response)
 {
     const char *p;
 
@@ -108,6 +110,30 @@ obd_elm_response_type_t obd_elm327_classify_response(const char *response)
     return OBD_ELM_RESPONSE_UNKNOWN;
 }
 
+obd_elm_response_type_t obd_elm327_classify_response(const char *response)
+{
+    obd_elm_response_type_t type;
+    OBD_STATS_BEGIN();
+    type = classify_response(response);
+    OBD_STATS_END(OBD_STAT_CLASSIFY, OBD_OK);
+    return type;
+}
+
+
+/*
+ * ELM327 CAN multi-frame output with headers off: the byte count on a
+ * line of its own ("013", never "000"), then numbered segments
+ * ("0: 46 01 0B ..."). Trailing spaces are allowed.
+ */
+static int is_multi_frame_line(const char *line, size_t len)
+{
+    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t')) len--;
+    if (len == 3) {
+        return reply_length_line(line, len) > 0;
+    }
+    return len >= 2 && hex_char_to_nibble(line[0]) >= 0 && line[1] == ':';
+}
+
 
 /* ── Response cleaner ────────────────────────────────────────────────────
  *
@@ -127,8 +153,8 @@ obd_elm_response_type_t obd_elm327_classify_response(const char *response)
  *
  * Multi-line responses (like VIN) are preserved with \r separators.
  */
-obd_result_t obd_elm327_clean_response(const char *raw, char *out,
-                                       size_t out_size)
+static obd_result_t clean_response(const char *raw, char *out,
+                                   size_t out_size)
 {
     const char *p;
     const char *line_start;
@@ -184,7 +210,7 @@ obd_result_t obd_elm327_clean_response(const char *raw, char *out,
                 }
                 memcpy(line_buf, lp, line_len);
                 line_buf[line_len] = '\0';
-                type = obd_elm327_classify_response(line_buf);
+                type = classify_response(line_buf);
             }
 
             if (type == OBD_ELM_RESPONSE_DATA) {
@@ -192,16 +218,17 @@ obd_result_t obd_elm327_clean_response(const char *raw, char *out,
                  * a mode byte >= 0x40 (response = request + 0x40).
                  * Echoed requests have mode < 0x40 (01, 02, 03, 09).
                  * So if the first byte < 0x40, it's an echo, skip it.
+                 * The exception is CAN multi-frame output ("013",
+                 * "0: 49 02 01 ..."), kept for obd_reply_reassemble().
                  *
                  * Parse the first two hex chars to get the first byte. */
                 int hi = hex_char_to_nibble(lp[0]);
                 int lo = (lp + 1 < p) ? hex_char_to_nibble(lp[1]) : -1;
-                if (hi < 0 || lo < 0) {
-                    continue; /* Not a valid hex byte pair, skip */
-                }
-                {
-                    int first_byte = (hi << 4) | lo;
-                    if (first_byte < 0x40) {
+                if (!is_multi_frame_line(lp, (size_t)(p - lp))) {
+                    if (hi < 0 || lo < 0) {
+                        continue; /* Not a valid hex byte pair, skip */
+                    }
+                    if (((hi << 4) | lo) < 0x40) {
                         continue; /* Echo of our request command, skip */
                     }
                 }
@@ -250,3 +277,13 @@ obd_result_t obd_elm327_clean_response(const char *raw, char *out,
 
     return OBD_OK;
 }
+
+obd_result_t obd_elm327_clean_response(const char *raw, char *out,
+                                       size_t out_size)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = clean_response(raw, out, out_size);
+    OBD_STATS_END(OBD_STAT_CLEAN, r);
+    return r;
+}
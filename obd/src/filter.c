@@ -0,0 +1,159 @@
+/**
+ * filter.c — Change filter: deadbands, keepalives, and skipping the
+ * decode of replies that didn't change.
+ *
+ * On a steady cruise most replies repeat the last one byte for byte:
+ * coolant "41 05 82", again and again. Comparing the 1-4 data bytes
+ * with the last reply's is cheaper than decoding them, and if they're
+ * equal the value is too, so there's nothing to decode and nothing to
+ * pass on (unless a keepalive is due, and then the last value does).
+ *
+ * Replies that did change are decoded and compared with the last value
+ * passed on, not the last one seen. A value creeping up 0.1 a sample
+ * passes once it has crept past the deadband, instead of never.
+ */
+
+#include "filter.h"
+#include <obd/obd.h>
+#include <math.h>
+#include <string.h>
+
+obd_result_t obd_filter_init(obd_filter_t *filter)
+{
+    if (!filter) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(filter, 0, sizeof(*filter));
+    return OBD_OK;
+}
+
+static obd_filter_entry_t *find(obd_filter_t *filter, uint8_t pid)
+{
+    size_t i;
+
+    for (i = 0; i < filter->count; i++) {
+        if (filter->entries[i].pid == pid) {
+            return &filter->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* The PID's entry, made with the defaults if it has none; NULL when full */
+static obd_filter_entry_t *entry_for(obd_filter_t *filter, uint8_t pid)
+{
+    obd_filter_entry_t *e = find(filter, pid);
+
+    if (e || filter->count == OBD_FILTER_MAX_PIDS) {
+        return e;
+    }
+    e = &filter->entries[filter->count++];
+    memset(e, 0, sizeof(*e));
+    e->pid = pid;
+    e->abs_deadband = filter->abs_deadband;
+    e->rel_deadband = filter->rel_deadband;
+    e->keepalive_us = filter->keepalive_us;
+    return e;
+}
+
+obd_result_t obd_filter_set(obd_filter_t *filter, uint8_t pid, float abs_deadband,
+                            float rel_deadband, uint64_t keepalive_us)
+{
+    obd_filter_entry_t *e;
+
+    if (!filter || !(abs_deadband >= 0.0f) || !(rel_deadband >= 0.0f)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    e = entry_for(filter, pid);
+    if (!e) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    e->abs_deadband = abs_deadband;
+    e->rel_deadband = rel_deadband;
+    e->keepalive_us = keepalive_us;
+    return OBD_OK;
+}
+
+static int keepalive_due(const obd_filter_entry_t *e, uint64_t now_us)
+{
+    return e->keepalive_us > 0 && now_us >= e->passed_us &&
+           now_us - e->passed_us >= e->keepalive_us;
+}
+
+/* Deadbands and keepalive; records the value if it passes */
+static obd_result_t judge(obd_filter_t *filter, obd_filter_entry_t *e, float value,
+                          uint64_t now_us)
+{
+    float band;
+
+    if (e->passed) {
+        band = e->rel_deadband * fabsf(e->passed_value);
+        if (band < e->abs_deadband) band = e->abs_deadband;
+        if (!(fabsf(value - e->passed_value) > band)) {     /* Also NaN */
+            if (!keepalive_due(e, now_us)) {
+                return OBD_ERROR_NO_DATA;
+            }
+            filter->keepalives++;
+        }
+    }
+    e->passed = 1;
+    e->passed_value = value;
+    e->passed_us = now_us;
+    filter->passed++;
+    return OBD_OK;
+}
+
+obd_result_t obd_filter_decode(obd_filter_t *filter, const obd_pid_response_t *response,
+                               uint64_t now_us, obd_sensor_value_t *out)
+{
+    obd_filter_entry_t *e;
+    obd_result_t r;
+
+    if (!filter || !response || !out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    e = entry_for(filter, response->pid);
+    if (!e) {
+        return obd_sensor_decode(response, out);    /* Table full: unfiltered */
+    }
+    filter->samples++;
+
+    if (e->raw_len > 0 && e->raw_len == response->data_len &&
+        memcmp(e->raw, response->data, e->raw_len) == 0) {
+        filter->unchanged++;
+        if (!keepalive_due(e, now_us)) {
+            return OBD_ERROR_NO_DATA;
+        }
+        *out = e->value;                        /* Same bytes, same value */
+        return judge(filter, e, out->value, now_us);
+    }
+
+    r = obd_sensor_decode(response, out);
+    if (r != OBD_OK) {
+        return r;
+    }
+    if (response->data_len <= sizeof(e->raw)) {
+        memcpy(e->raw, response->data, response->data_len);
+        e->raw_len = response->data_len;
+    }
+    e->value = *out;
+    return judge(filter, e, out->value, now_us);
+}
+
+obd_result_t obd_filter_value(obd_filter_t *filter, const obd_sensor_value_t *value,
+                              uint64_t now_us)
+{
+    obd_filter_entry_t *e;
+
+    if (!filter || !value) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    e = entry_for(filter, value->pid);
+    if (!e) {
+        return OBD_OK;
+    }
+    filter->samples++;
+    e->raw_len = 0;                             /* No bytes to compare next time */
+    e->value = *value;
+    return judge(filter, e, value->value, now_us);
+}
@@ -0,0 +1,10 @@
+/**
+ * filter.h — Internal header for the change filter.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <obd/obd_types.h>
+
+#endif /* FILTER_H */
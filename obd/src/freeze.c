@@ -0,0 +1,293 @@
+/**
+ * freeze.c — Mode 02 freeze frames.
+ *
+ * A freeze frame is the car's snapshot of its Mode 01 PIDs at the moment
+ * it stored an emissions DTC. Mode 02 reads it back. Compared to Mode 01
+ * every request and every answer has one more byte, the frame number:
+ *
+ *   request  "02 0C 00"          PID 0C of frame 0
+ *   reply    "42 0C 00 1A F8"    PID 0C, frame 0, data 1A F8
+ *
+ * Read as a Mode 01 reply, that frame byte would become data byte A.
+ *
+ * On CAN one request may name up to three PID/frame pairs (seven bytes,
+ * one frame) and the answer lists them back to back:
+ *
+ *   "02 0C 00 0D 00 05 00"  →  "42 0C 00 1A F8 0D 00 3C 05 00 7B"
+ *
+ * There are no separators, so splitting that up needs each PID's data
+ * length. Those are fixed by SAE J1979, up to PID 0x5F; PIDs above that
+ * are asked for on their own, so whatever follows them is their data.
+ *
+ * PID 02 in a freeze frame is special: it's the DTC that caused the frame
+ * to be stored, 0000 if there is none.
+ */
+
+#include "freeze.h"
+#include "dtc.h"
+#include "pid.h"
+#include "stats.h"
+#include <obd/obd.h>
+#include <stdio.h>
+#include <string.h>
+
+/* ── Data length per PID ─────────────────────────────────────────────────
+ *
+ * Bytes of data after "42 PID FRAME", from SAE J1979. 0 = not known.
+ */
+static const uint8_t pid_length[0x60] = {
+    /*       0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F */
+    /* 0x */ 4, 4, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1,
+    /* 1x */ 2, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2,
+    /* 2x */ 4, 2, 2, 2, 4, 4, 4, 4, 4, 4, 4, 4, 1, 1, 1, 1,
+    /* 3x */ 1, 2, 2, 1, 4, 4, 4, 4, 4, 4, 4, 4, 2, 2, 2, 2,
+    /* 4x */ 4, 4, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 4,
+    /* 5x */ 4, 1, 1, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 2, 1,
+};
+
+static size_t length_of(uint8_t pid)
+{
+    return pid < sizeof(pid_length) ? pid_length[pid] : 0;
+}
+
+static int is_done(const obd_freeze_frame_t *snap, uint8_t pid)
+{
+    return (snap->done[pid >> 3] >> (pid & 7)) & 1;
+}
+
+static void set_done(obd_freeze_frame_t *snap, uint8_t pid)
+{
+    snap->done[pid >> 3] = (uint8_t)(snap->done[pid >> 3] | (1u << (pid & 7)));
+}
+
+
+/* ── Requests ──────────────────────────────────────────────────────────── */
+
+obd_result_t obd_freeze_build_request(const uint8_t *pids, size_t count, uint8_t frame,
+                                      char *out, size_t out_size)
+{
+    size_t i, pos;
+
+    if (!pids || count == 0 || count > OBD_FREEZE_MAX_BATCH || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    /* "02" + 4 hex digits per PID/frame pair + \r + \0 */
+    if (out_size < 2 + 4 * count + 2) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    pos = (size_t)snprintf(out, out_size, "02");
+    for (i = 0; i < count; i++) {
+        pos += (size_t)snprintf(out + pos, out_size - pos, "%02X%02X", pids[i], frame);
+    }
+    out[pos++] = '\r';
+    out[pos] = '\0';
+    return OBD_OK;
+}
+
+obd_result_t obd_freeze_init(obd_freeze_frame_t *snap, uint8_t frame, uint8_t batch)
+{
+    if (!snap || batch == 0 || batch > OBD_FREEZE_MAX_BATCH) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(snap, 0, sizeof(*snap));
+    snap->frame = frame;
+    snap->batch = batch;
+    return OBD_OK;
+}
+
+/*
+ * What to ask next: the supported-PID bitmaps, as many per request as
+ * the batch allows (an ECU just leaves out the ones it doesn't have),
+ * then the supported PIDs in ascending order, PID 02 (the DTC) first.
+ */
+static obd_result_t freeze_next_request(obd_freeze_frame_t *snap, char *out, size_t out_size)
+{
+    uint8_t pids[OBD_FREEZE_MAX_BATCH];
+    size_t n = 0;
+    unsigned id;
+    uint8_t base;
+
+    if (obd_pid_supported_next(&snap->supported, &base)) {
+        for (id = base; id <= 0xE0 && n < snap->batch; id += 0x20) {
+            pids[n++] = (uint8_t)id;
+        }
+    } else if (is_done(snap, 0x02) && !snap->has_dtc) {
+        return OBD_ERROR_NO_DATA;              /* No frame stored */
+    } else {
+        for (id = 0x01; id <= 0xFF && n < snap->batch; id++) {
+            if (id % 0x20 == 0 || is_done(snap, (uint8_t)id) ||
+                !obd_pid_supported_has(&snap->supported, (uint8_t)id)) {
+                continue;
+            }
+            if (length_of((uint8_t)id) == 0) {
+                if (n > 0) continue;           /* Unknown length: on its own */
+                pids[n++] = (uint8_t)id;
+                break;
+            }
+            pids[n++] = (uint8_t)id;
+        }
+    }
+
+    if (n == 0) {
+        return OBD_ERROR_NO_DATA;
+    }
+    memcpy(snap->asked, pids, n);
+    snap->asked_count = n;
+    return obd_freeze_build_request(pids, n, snap->frame, out, out_size);
+}
+
+obd_result_t obd_freeze_next_request(obd_freeze_frame_t *snap, char *out, size_t out_size)
+{
+    if (!snap || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    return freeze_next_request(snap, out, out_size);
+}
+
+/* Whatever happens to a request, don't ask for the same PIDs again */
+obd_result_t obd_freeze_skip_request(obd_freeze_frame_t *snap)
+{
+    size_t i;
+
+    if (!snap) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    for (i = 0; i < snap->asked_count; i++) {
+        uint8_t pid = snap->asked[i];
+        if (pid % 0x20 == 0) {
+            snap->supported.read = (uint8_t)(snap->supported.read | (1u << (pid / 0x20)));
+        } else {
+            set_done(snap, pid);
+        }
+    }
+    snap->asked_count = 0;
+    return OBD_OK;
+}
+
+
+/* ── Response parser ───────────────────────────────────────────────────── */
+
+static obd_freeze_value_t *slot_for(obd_freeze_frame_t *snap, uint8_t pid)
+{
+    size_t i;
+
+    for (i = 0; i < snap->count; i++) {
+        if (snap->values[i].pid == pid) {
+            return &snap->values[i];           /* Read again: overwrite */
+        }
+    }
+    if (snap->count >= OBD_FREEZE_MAX_VALUES) {
+        return NULL;
+    }
+    return &snap->values[snap->count++];
+}
+
+/* "42 PID FRAME data [PID FRAME data]..." from one ECU */
+static obd_result_t decode_message(obd_freeze_frame_t *snap, const obd_reply_t *reply)
+{
+    const uint8_t *d = reply->data;
+    size_t pos = 1;
+
+    while (pos < reply->len) {
+        uint8_t pid, frame;
+        size_t len;
+
+        if (pos + 2 > reply->len) {
+            return OBD_ERROR_PARSE_FAILED;
+        }
+        pid = d[pos];
+        frame = d[pos + 1];
+        len = length_of(pid);
+        if (len == 0) {
+            len = reply->len - pos - 2;        /* Asked alone: the rest is data */
+        }
+        if (frame != snap->frame || pos + 2 + len > reply->len) {
+            return OBD_ERROR_PARSE_FAILED;
+        }
+
+        if (pid % 0x20 == 0) {
+            if (len != 4) return OBD_ERROR_PARSE_FAILED;
+            pid_supported_merge(&snap->supported, pid, d + pos + 2);
+        } else if (pid == 0x02) {
+            parse_single_dtc(d[pos + 2], d[pos + 3], &snap->dtc);
+            snap->has_dtc = (uint8_t)((d[pos + 2] | d[pos + 3]) != 0);
+            set_done(snap, pid);
+        } else {
+            obd_freeze_value_t *v = slot_for(snap, pid);
+            obd_sensor_value_t decoded;
+
+            if (!v) {
+                return OBD_ERROR_BUFFER_TOO_SMALL;
+            }
+            memset(v, 0, sizeof(*v));
+            v->pid = pid;
+            v->raw.mode = 0x42;
+            v->raw.pid = pid;
+            v->raw.data_len = len < OBD_MAX_DATA_BYTES ? len : OBD_MAX_DATA_BYTES;
+            memcpy(v->raw.data, d + pos + 2, v->raw.data_len);
+            if (obd_sensor_decode(&v->raw, &decoded) == OBD_OK) {
+                v->has_value = 1;
+                v->value = decoded.value;
+            }
+            set_done(snap, pid);
+        }
+        pos += 2 + len;
+    }
+    return OBD_OK;
+}
+
+static obd_result_t freeze_parse_response(const char *response, obd_freeze_frame_t *snap)
+{
+    obd_reply_t replies[OBD_MAX_ECUS];
+    const obd_reply_t *pick = NULL;
+    size_t count = 0, i;
+    obd_result_t r;
+
+    if (!response || !snap) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    r = obd_reply_reassemble(response, replies, OBD_MAX_ECUS, &count);
+    if (r == OBD_OK) {
+        /* Several ECUs may keep a frame; the lowest CAN id (the engine
+         * ECU, 7E8) is the one the snapshot describes */
+        for (i = 0; i < count; i++) {
+            if (replies[i].len < 1 || replies[i].data[0] != 0x42) continue;
+            if (!pick || replies[i].ecu < pick->ecu) pick = &replies[i];
+        }
+        if (!pick) {
+            r = OBD_ERROR_PARSE_FAILED;
+        } else {
+            snap->ecu = pick->ecu;
+            r = decode_message(snap, pick);
+        }
+    }
+
+    obd_freeze_skip_request(snap);             /* Asked and answered */
+    return r;
+}
+
+obd_result_t obd_freeze_parse_response(const char *response, obd_freeze_frame_t *snap)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = freeze_parse_response(response, snap);
+    OBD_STATS_END(OBD_STAT_FREEZE_PARSE, r);
+    return r;
+}
+
+const obd_freeze_value_t *obd_freeze_find(const obd_freeze_frame_t *snap, uint8_t pid)
+{
+    size_t i;
+
+    if (!snap) {
+        return NULL;
+    }
+    for (i = 0; i < snap->count; i++) {
+        if (snap->values[i].pid == pid) {
+            return &snap->values[i];
+        }
+    }
+    return NULL;
+}
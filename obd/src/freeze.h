@@ -0,0 +1,10 @@
+/**
+ * freeze.h — Internal header for Mode 02 freeze frames.
+ */
+
+#ifndef FREEZE_H
+#define FREEZE_H
+
+#include <obd/obd_types.h>
+
+#endif /* FREEZE_H */
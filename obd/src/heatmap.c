@@ -0,0 +1,288 @@
+/**
+ * heatmap.c — 2-D histograms of one channel against another.
+ *
+ * Finding a value's bin among arbitrary edges is a search: a loop or a
+ * binary search, with a branch per step that the CPU can't predict. Each
+ * axis builds a table at init instead. Its range is split into
+ * OBD_HEATMAP_LUT equal cells, and lut[c] is the bin cell c starts in:
+ *
+ *   edges    0     1000        3000              6000
+ *   cells    |..|..|..|..|..|..|..|..|..|..|..|..|
+ *   lut       0  0  1  1  1  1  2  2  2  2  2  2
+ *
+ * A cell holds at most one edge (init checks that bins are at least two
+ * cells wide), so a value's bin is lut[c] or the one after it. And if
+ * rounding put the value in the next cell over, the one before. So:
+ *
+ *   b  = lut[(v - lo) * scale]
+ *   b -= v < edges[b]
+ *   b += v >= edges[b + 1]
+ *
+ * Two comparisons turned into integers, no branches, whatever the edges.
+ * Values are first clamped into [first edge, last edge), which is how
+ * out-of-range values end up in the outer bins.
+ */
+
+#include "heatmap.h"
+#include "appender.h"
+#include <obd/obd.h>
+#include <math.h>
+#include <string.h>
+
+static obd_result_t axis_init(obd_heatmap_axis_t *ax, uint16_t channel,
+                              const float *edges, size_t bins)
+{
+    float lo, range;
+    size_t b, c;
+
+    if (!edges || bins == 0 || bins > OBD_HEATMAP_MAX_BINS) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    lo = edges[0];
+    range = edges[bins] - lo;
+    for (b = 0; b <= bins; b++) {
+        if (!isfinite(edges[b])) return OBD_ERROR_INVALID_ARG;
+    }
+    if (!(range > 0.0f) || !isfinite(range)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    for (b = 0; b < bins; b++) {
+        if (!(edges[b + 1] - edges[b] >= 2.0f * range / OBD_HEATMAP_LUT)) {
+            return OBD_ERROR_INVALID_ARG;       /* Not increasing, or too narrow */
+        }
+    }
+
+    memset(ax, 0, sizeof(*ax));
+    ax->channel = channel;
+    ax->bins = (uint8_t)bins;
+    memcpy(ax->edges, edges, (bins + 1) * sizeof(*edges));
+    ax->hi = nextafterf(edges[bins], lo);
+    ax->scale = (float)OBD_HEATMAP_LUT / range;
+
+    for (c = 0, b = 0; c < OBD_HEATMAP_LUT; c++) {
+        float start = lo + (float)c / ax->scale;
+        while (b + 1 < bins && edges[b + 1] <= start) b++;
+        ax->lut[c] = (uint8_t)b;
+    }
+    return OBD_OK;
+}
+
+static size_t axis_bin(const obd_heatmap_axis_t *ax, float v)
+{
+    size_t c, b;
+
+    v = fminf(fmaxf(v, ax->edges[0]), ax->hi);
+    c = (size_t)((v - ax->edges[0]) * ax->scale);
+    c = c < OBD_HEATMAP_LUT ? c : OBD_HEATMAP_LUT - 1;
+    b = ax->lut[c];
+    b -= (size_t)(v < ax->edges[b]);
+    b += (size_t)(v >= ax->edges[b + 1]);
+    return b;
+}
+
+static void count(obd_heatmap_t *h, float x, float y)
+{
+    uint32_t *cell = &h->counts[axis_bin(&h->y, y) * OBD_HEATMAP_MAX_BINS + axis_bin(&h->x, x)];
+    *cell += (uint32_t)(*cell != UINT32_MAX);
+    h->total++;
+}
+
+obd_result_t obd_heatmap_init(obd_heatmap_t *h,
+                              uint16_t x_channel, const float *x_edges, size_t x_bins,
+                              uint16_t y_channel, const float *y_edges, size_t y_bins)
+{
+    obd_result_t r;
+
+    if (!h) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(h, 0, sizeof(*h));
+    r = axis_init(&h->x, x_channel, x_edges, x_bins);
+    if (r == OBD_OK) r = axis_init(&h->y, y_channel, y_edges, y_bins);
+    return r;
+}
+
+obd_result_t obd_heatmap_clear(obd_heatmap_t *h)
+{
+    if (!h) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(h->counts, 0, sizeof(h->counts));
+    h->total = 0;
+    h->dropped = 0;
+    h->has_x = h->has_y = 0;
+    return OBD_OK;
+}
+
+obd_result_t obd_heatmap_add(obd_heatmap_t *h, float x, float y)
+{
+    if (!h || h->x.bins == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (isnan(x) || isnan(y)) {
+        h->dropped++;
+        return OBD_ERROR_INVALID_ARG;
+    }
+    count(h, x, y);
+    return OBD_OK;
+}
+
+obd_result_t obd_heatmap_add_batch(obd_heatmap_t *h, const float *x, const float *y, size_t n)
+{
+    size_t i;
+
+    if (!h || h->x.bins == 0 || (n > 0 && (!x || !y))) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    for (i = 0; i < n; i++) {
+        if (isnan(x[i]) || isnan(y[i])) {
+            h->dropped++;
+            continue;
+        }
+        count(h, x[i], y[i]);
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_heatmap_feed(obd_heatmap_t *h, uint16_t channel, float value)
+{
+    int used = 0;
+
+    if (!h || h->x.bins == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (channel == h->x.channel) { h->pending_x = value; h->has_x = 1; used = 1; }
+    if (channel == h->y.channel) { h->pending_y = value; h->has_y = 1; used = 1; }
+    if (!used) {
+        return OBD_ERROR_UNKNOWN_PID;
+    }
+    if (h->has_x && h->has_y) {
+        h->has_x = h->has_y = 0;
+        if (isnan(h->pending_x) || isnan(h->pending_y)) {
+            h->dropped++;
+        } else {
+            count(h, h->pending_x, h->pending_y);
+        }
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_heatmap_feed_sensor(obd_heatmap_t *h, const obd_sensor_value_t *value)
+{
+    if (!value) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    return obd_heatmap_feed(h, value->pid, value->value);
+}
+
+obd_result_t obd_heatmap_add_row(obd_heatmap_t *h, const obd_resample_row_t *row,
+                                 size_t x_col, size_t y_col)
+{
+    if (!h || !row || x_col >= OBD_RESAMPLE_MAX_CHANNELS || y_col >= OBD_RESAMPLE_MAX_CHANNELS) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (!(row->valid & (1u << x_col)) || !(row->valid & (1u << y_col))) {
+        return OBD_ERROR_NO_DATA;
+    }
+    return obd_heatmap_add(h, row->values[x_col], row->values[y_col]);
+}
+
+static int same_axis(const obd_heatmap_axis_t *a, const obd_heatmap_axis_t *b)
+{
+    return a->bins == b->bins &&
+           memcmp(a->edges, b->edges, (a->bins + 1u) * sizeof(a->edges[0])) == 0;
+}
+
+obd_result_t obd_heatmap_merge(obd_heatmap_t *dst, const obd_heatmap_t *src)
+{
+    size_t i;
+
+    if (!dst || !src || !same_axis(&dst->x, &src->x) || !same_axis(&dst->y, &src->y)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    /* Saturating add, written so the loop vectorises */
+    for (i = 0; i < OBD_HEATMAP_MAX_BINS * OBD_HEATMAP_MAX_BINS; i++) {
+        uint32_t sum = dst->counts[i] + src->counts[i];
+        dst->counts[i] = sum | (uint32_t)-(int32_t)(sum < dst->counts[i]);
+    }
+    dst->total += src->total;
+    dst->dropped += src->dropped;
+    return OBD_OK;
+}
+
+uint32_t obd_heatmap_cell(const obd_heatmap_t *h, size_t x_bin, size_t y_bin)
+{
+    if (!h || x_bin >= h->x.bins || y_bin >= h->y.bins) return 0;
+    return h->counts[y_bin * OBD_HEATMAP_MAX_BINS + x_bin];
+}
+
+
+/* ── Export ──────────────────────────────────────────────────────────────
+ *
+ * Both go through appender.h, like the stats and trace reports.
+ */
+obd_result_t obd_heatmap_format_csv(const obd_heatmap_t *h, char *out, size_t out_size)
+{
+    appender_t a;
+    size_t xb, yb;
+
+    if (!h || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    appender_init(&a, out, out_size);
+
+    append(&a, "y\\x");
+    for (xb = 0; xb < h->x.bins; xb++) {
+        append(&a, ",%g", h->x.edges[xb]);
+    }
+    append(&a, "\n");
+    for (yb = 0; yb < h->y.bins; yb++) {
+        append(&a, "%g", h->y.edges[yb]);
+        for (xb = 0; xb < h->x.bins; xb++) {
+            append(&a, ",%lu", (unsigned long)h->counts[yb * OBD_HEATMAP_MAX_BINS + xb]);
+        }
+        append(&a, "\n");
+    }
+    return appender_finish(&a);
+}
+
+static void append_axis(appender_t *a, const char *name, const obd_heatmap_axis_t *ax)
+{
+    size_t b;
+
+    append(a, "\"%s\": {\"channel\": %u, \"edges\": [", name, (unsigned)ax->channel);
+    for (b = 0; b <= ax->bins; b++) {
+        append(a, "%s%g", b ? ", " : "", ax->edges[b]);
+    }
+    append(a, "]}");
+}
+
+obd_result_t obd_heatmap_format_json(const obd_heatmap_t *h, char *out, size_t out_size)
+{
+    appender_t a;
+    size_t xb, yb;
+    int first = 1;
+
+    if (!h || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    appender_init(&a, out, out_size);
+
+    append(&a, "{");
+    append_axis(&a, "x", &h->x);
+    append(&a, ", ");
+    append_axis(&a, "y", &h->y);
+    append(&a, ", \"total\": %llu, \"dropped\": %llu, \"cells\": [",
+           (unsigned long long)h->total, (unsigned long long)h->dropped);
+    for (yb = 0; yb < h->y.bins; yb++) {
+        for (xb = 0; xb < h->x.bins; xb++) {
+            uint32_t n = h->counts[yb * OBD_HEATMAP_MAX_BINS + xb];
+            if (n == 0) continue;
+            append(&a, "%s[%u, %u, %lu]", first ? "" : ", ",
+                   (unsigned)xb, (unsigned)yb, (unsigned long)n);
+            first = 0;
+        }
+    }
+    append(&a, "]}\n");
+    return appender_finish(&a);
+}
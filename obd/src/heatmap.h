@@ -0,0 +1,10 @@
+/**
+ * heatmap.h — Internal header for operating-point heatmaps.
+ */
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <obd/obd_types.h>
+
+#endif /* HEATMAP_H */
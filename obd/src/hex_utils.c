@@ -8,6 +8,7 @@
  */
 
 #include "hex_utils.h"
+#include "stats.h"
 #include <obd/obd.h>
 #include <string.h>
 
@@ -36,8 +37,8 @@ int is_whitespace(char c)
  *
  * "41 0C" → skip space → '4','1' = 0x41, '0','C' = 0x0C
  */
-obd_result_t obd_hex_to_bytes(const char *hex, uint8_t *out, size_t out_size,
-                              size_t *out_len)
+static obd_result_t hex_to_bytes(const char *hex, uint8_t *out, size_t out_size,
+                                 size_t *out_len)
 {
     size_t i, o;
     int high, low;
@@ -89,6 +90,16 @@ obd_result_t obd_hex_to_bytes(const char *hex, uint8_t *out, size_t out_size,
     return OBD_OK;
 }
 
+obd_result_t obd_hex_to_bytes(const char *hex, uint8_t *out, size_t out_size,
+                              size_t *out_len)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = hex_to_bytes(hex, out, out_size, out_len);
+    OBD_STATS_END(OBD_STAT_HEX_TO_BYTES, r);
+    return r;
+}
+
 /*
  * Convert byte array to hex string (uppercase, space-separated).
  *
@@ -98,8 +109,8 @@ obd_result_t obd_hex_to_bytes(const char *hex, uint8_t *out, size_t out_size,
  * Buffer size needed: len*3 for "XX " per byte, but last byte has no space,
  * so len*3 - 1 + 1 (null terminator) = len*3. But we check len*3 to be safe.
  */
-obd_result_t obd_bytes_to_hex(const uint8_t *bytes, size_t len,
-                              char *out, size_t out_size)
+static obd_result_t bytes_to_hex(const uint8_t *bytes, size_t len,
+                                 char *out, size_t out_size)
 {
     /* Lookup table: index → hex character. Faster than computing each time. */
     static const char hex_chars[] = "0123456789ABCDEF";
@@ -138,6 +149,16 @@ obd_result_t obd_bytes_to_hex(const uint8_t *bytes, size_t len,
     return OBD_OK;
 }
 
+obd_result_t obd_bytes_to_hex(const uint8_t *bytes, size_t len,
+                              char *out, size_t out_size)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = bytes_to_hex(bytes, len, out, out_size);
+    OBD_STATS_END(OBD_STAT_BYTES_TO_HEX, r);
+    return r;
+}
+
 /*
  * Strip all whitespace from a string in-place.
  *
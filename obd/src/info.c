@@ -0,0 +1,330 @@
+/**
+ * info.c — Mode 09 vehicle information, per ECU.
+ *
+ * On CAN every Mode 09 answer has the same shape:
+ *
+ *   49 04 02 31 32 33 ... 00 41 42 43 ... 00
+ *   │  │  │  └──── CALID 1 ────┘ └── CALID 2 ──┘
+ *   │  │  └── NODI: number of data items that follow
+ *   │  └───── PID (info type)
+ *   └──────── 0x49 = response to mode 09
+ *
+ * Only the item size differs per PID:
+ *
+ *   02  VIN                 17 bytes ASCII, one item
+ *   04  calibration ID      16 bytes ASCII, zero-padded, one per module
+ *   06  CVN                  4 bytes, a checksum per calibration ID
+ *   08  IPT (spark)          2 bytes per counter, 16 or 20 counters
+ *   0A  ECU name            20 bytes ASCII: acronym, '-', text
+ *   0B  IPT (compression)    2 bytes per counter
+ *
+ * Anything longer than a frame arrives in pieces, and the engine and
+ * transmission ECUs both answer, so everything goes through
+ * obd_reply_reassemble() first; each ECU's message then lands in its
+ * own obd_ecu_info_t of the profile.
+ *
+ * Older protocols send the VIN as numbered lines ("49 02 01 57 42 41 33");
+ * those still go through obd_vin_parse_response(). The other PIDs are
+ * decoded in the CAN layout only.
+ */
+
+#include "info.h"
+#include "stats.h"
+#include <obd/obd.h>
+#include <string.h>
+
+/* The PIDs worth reading, in the order obd_info_next_request() asks */
+static const uint8_t info_pids[] = { 0x02, 0x04, 0x06, 0x0A, 0x08, 0x0B };
+
+#define INFO_PID_COUNT (sizeof(info_pids) / sizeof(info_pids[0]))
+
+
+/* ── Profile bookkeeping ─────────────────────────────────────────────── */
+
+obd_result_t obd_info_profile_init(obd_vehicle_profile_t *profile)
+{
+    if (!profile) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(profile, 0, sizeof(*profile));
+    return OBD_OK;
+}
+
+obd_ecu_info_t *obd_info_find_ecu(obd_vehicle_profile_t *profile, uint16_t ecu)
+{
+    size_t i;
+
+    if (!profile) {
+        return NULL;
+    }
+    for (i = 0; i < profile->ecu_count; i++) {
+        if (profile->ecus[i].ecu == ecu) {
+            return &profile->ecus[i];
+        }
+    }
+    return NULL;
+}
+
+static obd_ecu_info_t *find_or_add_ecu(obd_vehicle_profile_t *profile, uint16_t ecu)
+{
+    obd_ecu_info_t *info = obd_info_find_ecu(profile, ecu);
+
+    if (info || profile->ecu_count >= OBD_MAX_ECUS) {
+        return info;
+    }
+    info = &profile->ecus[profile->ecu_count++];
+    memset(info, 0, sizeof(*info));
+    info->ecu = ecu;
+    return info;
+}
+
+obd_result_t obd_info_set_read(obd_vehicle_profile_t *profile, uint8_t pid, int read)
+{
+    if (!profile) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (pid % 0x20 == 0) {
+        uint8_t bit = (uint8_t)(1u << (pid / 0x20));
+        profile->supported.read = (uint8_t)(read ? profile->supported.read | bit
+                                                 : profile->supported.read & ~bit);
+        return OBD_OK;
+    }
+    if (pid >= 32) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (read) {
+        profile->read |= 1u << pid;
+    } else {
+        profile->read &= ~(1u << pid);
+    }
+    return OBD_OK;
+}
+
+
+/* ── Request builder ─────────────────────────────────────────────────────
+ *
+ * First the supported-PID chain (0900, then 0920... if the car has
+ * more), then each supported PID from info_pids[] the profile doesn't
+ * have yet. A profile kept from the last connection has everything, so
+ * a reconnect sends nothing.
+ */
+static obd_result_t info_next_request(const obd_vehicle_profile_t *profile,
+                                      char *out, size_t out_size)
+{
+    uint8_t base;
+    size_t i;
+
+    if (obd_pid_supported_next(&profile->supported, &base)) {
+        return obd_pid_build_request(0x09, base, out, out_size);
+    }
+    for (i = 0; i < INFO_PID_COUNT; i++) {
+        uint8_t pid = info_pids[i];
+        if (obd_pid_supported_has(&profile->supported, pid) &&
+            !(profile->read & (1u << pid))) {
+            return obd_pid_build_request(0x09, pid, out, out_size);
+        }
+    }
+    return OBD_ERROR_NO_DATA;
+}
+
+obd_result_t obd_info_next_request(const obd_vehicle_profile_t *profile,
+                                   char *out, size_t out_size)
+{
+    if (!profile || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    return info_next_request(profile, out, out_size);
+}
+
+
+/* ── Response parser ─────────────────────────────────────────────────── */
+
+/* Copy n ASCII bytes, stopping at the zero padding */
+static void copy_ascii(char *dst, const uint8_t *src, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n && src[i] != 0x00; i++) {
+        dst[i] = (char)src[i];
+    }
+    dst[i] = '\0';
+}
+
+/* "ECM\0" "-" "Engine Control\0" → "ECM-Engine Control" */
+static void copy_ecu_name(char *dst, const uint8_t *src)
+{
+    size_t len;
+
+    copy_ascii(dst, src, 4);
+    len = strlen(dst);
+    dst[len++] = '-';
+    copy_ascii(dst + len, src + 5, OBD_ECU_NAME_LENGTH - 5);
+}
+
+/* One reassembled "49 PID NODI items..." message from one ECU */
+static obd_result_t merge_message(obd_vehicle_profile_t *profile, const obd_reply_t *reply)
+{
+    const uint8_t *d = reply->data;
+    uint8_t pid = d[1];
+    size_t nodi = d[2], item, i;
+    const uint8_t *items = d + 3;
+    obd_ecu_info_t *info;
+
+    switch (pid) {
+    case 0x02: item = OBD_VIN_LENGTH;      break;
+    case 0x04: item = OBD_CALID_LENGTH;    break;
+    case 0x06: item = 4;                   break;
+    case 0x08:
+    case 0x0B: item = 2;                   break;
+    case 0x0A: item = OBD_ECU_NAME_LENGTH; break;
+    default:   return OBD_OK;              /* Message counts etc., nothing to keep */
+    }
+
+    if (reply->len < 3 + nodi * item) {
+        return OBD_ERROR_PARSE_FAILED;
+    }
+    info = find_or_add_ecu(profile, reply->ecu);
+    if (!info) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    switch (pid) {
+    case 0x02:
+        copy_ascii(profile->vin, items, OBD_VIN_LENGTH);
+        break;
+    case 0x04:
+        if (nodi > OBD_MAX_CALIDS) return OBD_ERROR_BUFFER_TOO_SMALL;
+        for (i = 0; i < nodi; i++) {
+            copy_ascii(info->calid[i], items + i * item, OBD_CALID_LENGTH);
+        }
+        info->calid_count = nodi;
+        break;
+    case 0x06:
+        if (nodi > OBD_MAX_CALIDS) return OBD_ERROR_BUFFER_TOO_SMALL;
+        for (i = 0; i < nodi; i++) {
+            const uint8_t *c = items + i * item;
+            info->cvn[i] = ((uint32_t)c[0] << 24) | ((uint32_t)c[1] << 16) |
+                           ((uint32_t)c[2] << 8) | c[3];
+        }
+        info->cvn_count = nodi;
+        break;
+    case 0x08:
+    case 0x0B:
+        if (nodi > OBD_IPT_MAX_COUNTERS) return OBD_ERROR_BUFFER_TOO_SMALL;
+        for (i = 0; i < nodi; i++) {
+            info->ipt[i] = (uint16_t)((items[2 * i] << 8) | items[2 * i + 1]);
+        }
+        info->ipt_pid = pid;
+        info->ipt_count = nodi;
+        break;
+    case 0x0A:
+        copy_ecu_name(info->name, items);
+        break;
+    }
+    info->read |= 1u << pid;
+    return OBD_OK;
+}
+
+static obd_result_t info_parse_response(const char *response, obd_vehicle_profile_t *profile)
+{
+    obd_reply_t replies[OBD_MAX_ECUS];
+    size_t count = 0, i;
+    uint32_t answered = 0;
+    int bitmap = 0, numbered_vin = 0;
+    obd_result_t r;
+
+    if (!response || !profile) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    r = obd_reply_reassemble(response, replies, OBD_MAX_ECUS, &count);
+    if (r != OBD_OK) {
+        return r;
+    }
+
+    for (i = 0; i < count; i++) {
+        const obd_reply_t *reply = &replies[i];
+
+        if (reply->len < 3 || reply->data[0] != 0x49) {
+            continue;                          /* Another ECU saying no */
+        }
+        if (reply->data[1] % 0x20 == 0) {
+            bitmap = 1;                        /* Supported PIDs, see below */
+            continue;
+        }
+        if (reply->data[1] == 0x02 && reply->len < 3 + OBD_VIN_LENGTH) {
+            numbered_vin = 1;                  /* "49 02 01 57 42 41 33" */
+            continue;
+        }
+        r = merge_message(profile, reply);
+        if (r != OBD_OK) {
+            return r;
+        }
+        if (reply->data[1] < 32) {
+            answered |= 1u << reply->data[1];
+        }
+    }
+
+    if (bitmap) {
+        r = obd_pid_supported_parse(response, 0x09, &profile->supported);
+        if (r != OBD_OK) {
+            return r;
+        }
+    }
+    if (numbered_vin) {
+        r = obd_vin_parse_response(response, profile->vin, sizeof(profile->vin));
+        if (r != OBD_OK) {
+            return r;
+        }
+        answered |= 1u << 0x02;
+    }
+
+    if (!answered && !bitmap) {
+        return OBD_ERROR_PARSE_FAILED;
+    }
+    profile->read |= answered;
+    return OBD_OK;
+}
+
+obd_result_t obd_info_parse_response(const char *response, obd_vehicle_profile_t *profile)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = info_parse_response(response, profile);
+    OBD_STATS_END(OBD_STAT_INFO_PARSE, r);
+    return r;
+}
+
+
+/* ── In-use performance tracking counter names ───────────────────────────
+ *
+ * IPT counters come in pairs per monitor: how often it completed (COMP)
+ * and how often the conditions to run it were met (COND). COMP / COND is
+ * the in-use monitor performance ratio regulators look at.
+ */
+static const char *const ipt_spark[] = {
+    "OBDCOND", "IGNCNTR",
+    "CATCOMP1", "CATCOND1", "CATCOMP2", "CATCOND2",
+    "O2SCOMP1", "O2SCOND1", "O2SCOMP2", "O2SCOND2",
+    "EGRCOMP", "EGRCOND", "AIRCOMP", "AIRCOND",
+    "EVAPCOMP", "EVAPCOND",
+    "SO2SCOMP1", "SO2SCOND1", "SO2SCOMP2", "SO2SCOND2",
+};
+
+static const char *const ipt_compression[] = {
+    "OBDCOND", "IGNCNTR",
+    "HCCATCOMP", "HCCATCOND", "NCATCOMP", "NCATCOND",
+    "NADSCOMP", "NADSCOND", "PMCOMP", "PMCOND",
+    "EGSCOMP", "EGSCOND", "EGRCOMP", "EGRCOND",
+    "BPCOMP", "BPCOND", "FUELCOMP", "FUELCOND",
+};
+
+const char *obd_info_ipt_name(uint8_t pid, size_t index)
+{
+    if (pid == 0x08 && index < sizeof(ipt_spark) / sizeof(ipt_spark[0])) {
+        return ipt_spark[index];
+    }
+    if (pid == 0x0B && index < sizeof(ipt_compression) / sizeof(ipt_compression[0])) {
+        return ipt_compression[index];
+    }
+    return NULL;
+}
@@ -0,0 +1,10 @@
+/**
+ * info.h — Internal header for Mode 09 vehicle information.
+ */
+
+#ifndef INFO_H
+#define INFO_H
+
+#include <obd/obd_types.h>
+
+#endif /* INFO_H */
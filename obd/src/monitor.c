@@ -0,0 +1,359 @@
+/**
+ * monitor.c — Mode 06 on-board monitoring test results.
+ *
+ * While driving, the ECU keeps testing its own emissions hardware: is
+ * the catalyst still storing oxygen, does the O2 sensor switch fast
+ * enough, how many misfires did cylinder 3 have. Mode 06 reads the last
+ * result of each test. On CAN a reply looks like this:
+ *
+ *   46 01 0B 24 00 00 00 00 FF FF 01 0C 24 00 05 00 00 00 10
+ *   │  │  │  │  └───┘ └───┘ └───┘ └──────── next test ───────┘
+ *   │  │  │  │  value  min   max
+ *   │  │  │  └── UASID 0x24: unit "counts", 1 per bit
+ *   │  │  └───── TID 0x0B: which test of the monitor
+ *   │  └──────── MID 0x01: O2 sensor bank 1 sensor 1
+ *   └─────────── 0x46 = response to mode 06
+ *
+ * Nine bytes per test, as many tests as the monitor has. The UASID
+ * (unit and scaling ID, SAE J1979 appendix E) tells how to turn the raw
+ * 16-bit numbers into a value with a unit.
+ *
+ * Only the CAN format is decoded. Older protocols report one test per
+ * line in a different layout.
+ */
+
+#include "monitor.h"
+#include "stats.h"
+#include <obd/obd.h>
+#include <stdio.h>
+#include <string.h>
+
+/* ── Unit and scaling table ──────────────────────────────────────────────
+ *
+ * Indexed by UASID, so decoding a test is one array read, no search.
+ * value = raw * scale + offset. 0x01-0x7F are unsigned 16-bit raw values,
+ * 0x81-0xFE the same quantities as signed (two's complement). A zero
+ * scale marks a UASID we don't know: the raw value is passed through.
+ */
+typedef struct {
+    float       scale;
+    float       offset;
+    const char *unit;
+} uasid_entry_t;
+
+static const uasid_entry_t uasid_table[256] = {
+    /* Unsigned                                                    */
+    [0x01] = { 1.0f,          0.0f,    ""         },
+    [0x02] = { 0.1f,          0.0f,    ""         },
+    [0x03] = { 0.01f,         0.0f,    ""         },
+    [0x04] = { 0.001f,        0.0f,    ""         },
+    [0x05] = { 0.0000305f,    0.0f,    ""         },
+    [0x06] = { 0.000305f,     0.0f,    ""         },
+    [0x07] = { 0.25f,         0.0f,    "rpm"      },
+    [0x08] = { 0.01f,         0.0f,    "km/h"     },
+    [0x09] = { 1.0f,          0.0f,    "km/h"     },
+    [0x0A] = { 0.122f,        0.0f,    "mV"       },
+    [0x0B] = { 0.001f,        0.0f,    "V"        },
+    [0x0C] = { 0.01f,         0.0f,    "V"        },
+    [0x0D] = { 0.00390625f,   0.0f,    "mA"       },
+    [0x0E] = { 0.001f,        0.0f,    "A"        },
+    [0x0F] = { 0.01f,         0.0f,    "A"        },
+    [0x10] = { 1.0f,          0.0f,    "ms"       },
+    [0x11] = { 100.0f,        0.0f,    "ms"       },
+    [0x12] = { 1.0f,          0.0f,    "s"        },
+    [0x13] = { 1.0f,          0.0f,    "mOhm"     },
+    [0x14] = { 1.0f,          0.0f,    "Ohm"      },
+    [0x15] = { 1.0f,          0.0f,    "kOhm"     },
+    [0x16] = { 0.1f,          -40.0f,  "C"        },
+    [0x17] = { 0.01f,         0.0f,    "kPa"      },
+    [0x18] = { 0.0117f,       0.0f,    "kPa"      },
+    [0x19] = { 0.079f,        0.0f,    "kPa"      },
+    [0x1A] = { 1.0f,          0.0f,    "kPa"      },
+    [0x1B] = { 10.0f,         0.0f,    "kPa"      },
+    [0x1C] = { 0.01f,         0.0f,    "deg"      },
+    [0x1D] = { 0.5f,          0.0f,    "deg"      },
+    [0x1E] = { 0.0000305f,    0.0f,    "lambda"   },
+    [0x1F] = { 0.05f,         0.0f,    "A/F"      },
+    [0x20] = { 0.0039062f,    0.0f,    "ratio"    },
+    [0x21] = { 1.0f,          0.0f,    "mHz"      },
+    [0x22] = { 1.0f,          0.0f,    "Hz"       },
+    [0x23] = { 1.0f,          0.0f,    "kHz"      },
+    [0x24] = { 1.0f,          0.0f,    "counts"   },
+    [0x25] = { 1.0f,          0.0f,    "km"       },
+    [0x26] = { 0.1f,          0.0f,    "mV/ms"    },
+    [0x27] = { 0.01f,         0.0f,    "g/s"      },
+    [0x28] = { 1.0f,          0.0f,    "g/s"      },
+    [0x29] = { 0.25f,         0.0f,    "Pa/s"     },
+    [0x2A] = { 0.001f,        0.0f,    "kg/h"     },
+    [0x2B] = { 1.0f,          0.0f,    "switches" },
+    [0x2C] = { 0.01f,         0.0f,    "g/cyl"    },
+    [0x2D] = { 0.01f,         0.0f,    "mg/stroke"},
+    [0x2E] = { 1.0f,          0.0f,    ""         },    /* true/false */
+    [0x2F] = { 0.01f,         0.0f,    "%"        },
+    [0x30] = { 0.001526f,     0.0f,    "%"        },
+    [0x31] = { 0.001f,        0.0f,    "L"        },
+    [0x32] = { 0.0000305f,    0.0f,    "in"       },
+    [0x33] = { 0.00024414f,   0.0f,    "ratio"    },
+    [0x34] = { 1.0f,          0.0f,    "min"      },
+    [0x35] = { 10.0f,         0.0f,    "ms"       },
+    [0x36] = { 0.01f,         0.0f,    "g"        },
+    [0x37] = { 0.1f,          0.0f,    "g"        },
+    [0x38] = { 1.0f,          0.0f,    "g"        },
+    [0x39] = { 0.01f,         -327.68f,"%"        },
+    [0x3A] = { 0.001f,        0.0f,    "g"        },
+    [0x3B] = { 0.0001f,       0.0f,    "g"        },
+    [0x3C] = { 0.1f,          0.0f,    "us"       },
+    [0x3D] = { 0.01f,         0.0f,    "mA"       },
+    [0x3E] = { 0.00006103516f,0.0f,    "mm2"      },
+    [0x3F] = { 0.01f,         0.0f,    "L"        },
+    [0x40] = { 1.0f,          0.0f,    "ppm"      },
+    [0x41] = { 0.01f,         0.0f,    "uA"       },
+
+    /* Signed                                                      */
+    [0x81] = { 1.0f,          0.0f,    ""         },
+    [0x82] = { 0.1f,          0.0f,    ""         },
+    [0x83] = { 0.01f,         0.0f,    ""         },
+    [0x84] = { 0.001f,        0.0f,    ""         },
+    [0x85] = { 0.0000305f,    0.0f,    ""         },
+    [0x86] = { 0.000305f,     0.0f,    ""         },
+    [0x8A] = { 0.122f,        0.0f,    "mV"       },
+    [0x8B] = { 0.001f,        0.0f,    "V"        },
+    [0x8C] = { 0.01f,         0.0f,    "V"        },
+    [0x8D] = { 0.00390625f,   0.0f,    "mA"       },
+    [0x8E] = { 0.001f,        0.0f,    "A"        },
+    [0x90] = { 1.0f,          0.0f,    "ms"       },
+    [0x96] = { 0.1f,          0.0f,    "C"        },
+    [0x9C] = { 0.01f,         0.0f,    "deg"      },
+    [0x9D] = { 0.5f,          0.0f,    "deg"      },
+    [0xA8] = { 1.0f,          0.0f,    "g/s"      },
+    [0xA9] = { 0.25f,         0.0f,    "Pa/s"     },
+    [0xAD] = { 0.01f,         0.0f,    "mg/stroke"},
+    [0xAE] = { 0.1f,          0.0f,    "mg/stroke"},
+    [0xAF] = { 0.01f,         0.0f,    "%"        },
+    [0xB0] = { 0.003052f,     0.0f,    "%"        },
+    [0xB1] = { 2.0f,          0.0f,    "mV/s"     },
+    [0xFC] = { 0.01f,         0.0f,    "kPa"      },
+    [0xFD] = { 0.001f,        0.0f,    "kPa"      },
+    [0xFE] = { 0.25f,         0.0f,    "Pa"       },
+};
+
+/* The raw 16-bit value as a number, signed for UASIDs 0x80 and up */
+static long raw_value(uint8_t uasid, const uint8_t *p)
+{
+    unsigned raw = ((unsigned)p[0] << 8) | p[1];
+    if ((uasid & 0x80) && (raw & 0x8000)) {
+        return (long)raw - 0x10000;
+    }
+    return (long)raw;
+}
+
+static float scaled(const uasid_entry_t *u, long raw)
+{
+    if (u->scale == 0.0f) {
+        return (float)raw;                     /* Unknown UASID */
+    }
+    return (float)raw * u->scale + u->offset;
+}
+
+const char *obd_monitor_unit(uint8_t uasid)
+{
+    const char *unit = uasid_table[uasid].unit;
+    return unit ? unit : "";
+}
+
+
+/* ── Monitor names ───────────────────────────────────────────────────────
+ *
+ * The common MIDs from SAE J1979 appendix D. Cars may report others
+ * (and manufacturer-specific ones above 0xE0); those have no name.
+ */
+typedef struct {
+    uint8_t     mid;
+    const char *name;
+} mid_entry_t;
+
+static const mid_entry_t mid_table[] = {
+    { 0x01, "O2 Sensor Bank 1 Sensor 1" },
+    { 0x02, "O2 Sensor Bank 1 Sensor 2" },
+    { 0x03, "O2 Sensor Bank 1 Sensor 3" },
+    { 0x04, "O2 Sensor Bank 1 Sensor 4" },
+    { 0x05, "O2 Sensor Bank 2 Sensor 1" },
+    { 0x06, "O2 Sensor Bank 2 Sensor 2" },
+    { 0x07, "O2 Sensor Bank 2 Sensor 3" },
+    { 0x08, "O2 Sensor Bank 2 Sensor 4" },
+    { 0x21, "Catalyst Bank 1" },
+    { 0x22, "Catalyst Bank 2" },
+    { 0x31, "EGR Bank 1" },
+    { 0x32, "EGR Bank 2" },
+    { 0x39, "EVAP Leak 0.150\"" },
+    { 0x3A, "EVAP Leak 0.090\"" },
+    { 0x3B, "EVAP Leak 0.040\"" },
+    { 0x3C, "EVAP Leak 0.020\"" },
+    { 0x3D, "Purge Flow" },
+    { 0x41, "O2 Heater Bank 1 Sensor 1" },
+    { 0x42, "O2 Heater Bank 1 Sensor 2" },
+    { 0x45, "O2 Heater Bank 2 Sensor 1" },
+    { 0x46, "O2 Heater Bank 2 Sensor 2" },
+    { 0x61, "Heated Catalyst Bank 1" },
+    { 0x62, "Heated Catalyst Bank 2" },
+    { 0x71, "Secondary Air 1" },
+    { 0x72, "Secondary Air 2" },
+    { 0x81, "Fuel System Bank 1" },
+    { 0x82, "Fuel System Bank 2" },
+    { 0xA1, "Misfire General" },
+    { 0xA2, "Misfire Cylinder 1" },
+    { 0xA3, "Misfire Cylinder 2" },
+    { 0xA4, "Misfire Cylinder 3" },
+    { 0xA5, "Misfire Cylinder 4" },
+    { 0xA6, "Misfire Cylinder 5" },
+    { 0xA7, "Misfire Cylinder 6" },
+    { 0xA8, "Misfire Cylinder 7" },
+    { 0xA9, "Misfire Cylinder 8" },
+    { 0xAA, "Misfire Cylinder 9" },
+    { 0xAB, "Misfire Cylinder 10" },
+    { 0xAC, "Misfire Cylinder 11" },
+    { 0xAD, "Misfire Cylinder 12" },
+    { 0xB0, "PM Filter Bank 1" },
+    { 0xB1, "PM Filter Bank 2" },
+};
+
+#define MID_TABLE_SIZE (sizeof(mid_table) / sizeof(mid_table[0]))
+
+const char *obd_monitor_name(uint8_t mid)
+{
+    size_t i;
+    for (i = 0; i < MID_TABLE_SIZE; i++) {
+        if (mid_table[i].mid == mid) {
+            return mid_table[i].name;
+        }
+    }
+    return NULL;
+}
+
+
+/* ── Request builder ─────────────────────────────────────────────────────
+ *
+ * "06 00 20 40\r" asks for three supported-MID bitmaps in one go; "06 A2\r"
+ * for the results of one monitor. J1979 doesn't let a CAN request mix the
+ * two or name more than one test MID, so neither do we.
+ */
+static int is_bitmap_mid(uint8_t mid)
+{
+    return mid % 0x20 == 0;
+}
+
+obd_result_t obd_monitor_build_request(const uint8_t *mids, size_t count,
+                                       char *out, size_t out_size)
+{
+    size_t i, pos;
+
+    if (!mids || count == 0 || count > 6 || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    for (i = 0; i < count; i++) {
+        if (!is_bitmap_mid(mids[i]) && count > 1) {
+            return OBD_ERROR_INVALID_ARG;
+        }
+    }
+
+    /* "06" + 2 hex digits per MID + \r + \0 */
+    if (out_size < 2 + 2 * count + 2) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    pos = (size_t)snprintf(out, out_size, "06");
+    for (i = 0; i < count; i++) {
+        pos += (size_t)snprintf(out + pos, out_size - pos, "%02X", mids[i]);
+    }
+    out[pos++] = '\r';
+    out[pos] = '\0';
+    return OBD_OK;
+}
+
+
+/* ── Response parser ─────────────────────────────────────────────────────
+ *
+ * One pass over each reassembled reply: a bitmap MID is five bytes (MID +
+ * bitmap) and skipped, a test record is nine and decoded straight into
+ * the next slot of the result. Pass/fail is decided on the raw values, so
+ * rounding in the scaled floats can't flip it.
+ */
+static obd_result_t decode_reply(const obd_reply_t *reply, obd_monitor_result_t *out)
+{
+    const uint8_t *d = reply->data;
+    size_t pos = 1;
+
+    while (pos < reply->len) {
+        uint8_t mid = d[pos];
+        const uasid_entry_t *u;
+        obd_monitor_test_t *t;
+        long value, min, max;
+
+        if (is_bitmap_mid(mid)) {
+            if (pos + 5 > reply->len) return OBD_ERROR_PARSE_FAILED;
+            pos += 5;
+            continue;
+        }
+        if (pos + 9 > reply->len) {
+            return OBD_ERROR_PARSE_FAILED;     /* Truncated record */
+        }
+        if (out->count >= OBD_MONITOR_MAX_TESTS) {
+            return OBD_ERROR_BUFFER_TOO_SMALL;
+        }
+
+        t = &out->tests[out->count++];
+        u = &uasid_table[d[pos + 2]];
+        value = raw_value(d[pos + 2], d + pos + 3);
+        min   = raw_value(d[pos + 2], d + pos + 5);
+        max   = raw_value(d[pos + 2], d + pos + 7);
+
+        t->ecu    = reply->ecu;
+        t->mid    = mid;
+        t->tid    = d[pos + 1];
+        t->uasid  = d[pos + 2];
+        t->passed = (uint8_t)(value >= min && value <= max);
+        t->value  = scaled(u, value);
+        t->min    = scaled(u, min);
+        t->max    = scaled(u, max);
+        pos += 9;
+    }
+    return OBD_OK;
+}
+
+static obd_result_t monitor_parse_response(const char *response, obd_monitor_result_t *out)
+{
+    obd_reply_t replies[OBD_MAX_ECUS];
+    size_t count = 0, i, answered = 0;
+    obd_result_t r;
+
+    if (!response || !out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    out->count = 0;
+
+    r = obd_reply_reassemble(response, replies, OBD_MAX_ECUS, &count);
+    if (r != OBD_OK) {
+        return r;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (replies[i].len < 1 || replies[i].data[0] != 0x46) {
+            continue;                          /* Negative response, other ECU */
+        }
+        r = decode_reply(&replies[i], out);
+        if (r != OBD_OK) {
+            return r;
+        }
+        answered++;
+    }
+
+    return answered > 0 ? OBD_OK : OBD_ERROR_PARSE_FAILED;
+}
+
+obd_result_t obd_monitor_parse_response(const char *response, obd_monitor_result_t *out)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = monitor_parse_response(response, out);
+    OBD_STATS_END(OBD_STAT_MONITOR_PARSE, r);
+    return r;
+}
@@ -0,0 +1,10 @@
+/**
+ * monitor.h — Internal header for Mode 06 monitor test results.
+ */
+
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <obd/obd_types.h>
+
+#endif /* MONITOR_H */
@@ -12,7 +12,9 @@
  *
  * The request format is simple: mode byte + PID byte + \r
  *   "010C\r" = Mode 01, PID 0C (RPM)
- *   "020C\r" = Mode 02, PID 0C (RPM at time of freeze frame)
+ *
+ * Mode 02 adds a frame number after the PID ("020C00\r") and echoes it
+ * in the reply ("42 0C 00 1A F8"); that's freeze.c's job.
  *
  * The response format: response_mode + PID + data bytes
  *   "41 0C 1A F8" = Mode 01 response (0x41 = 0x01 + 0x40), PID 0C, data bytes
@@ -20,6 +22,7 @@
 
 #include "pid.h"
 #include "hex_utils.h"
+#include "stats.h"
 #include <obd/obd.h>
 #include <stdio.h>
 #include <string.h>
@@ -31,15 +34,21 @@
  * followed by \r. snprintf is safe — it never writes beyond out_size.
  *
  * Example: mode=0x01, pid=0x0C → "010C\r"
+ *
+ * Mode 02 goes through obd_freeze_build_request() for frame 0
+ * ("020C00\r"): without the frame byte an ECU rejects the request.
  */
-obd_result_t obd_pid_build_request(uint8_t mode, uint8_t pid,
-                                   char *out, size_t out_size)
+static obd_result_t pid_build_request(uint8_t mode, uint8_t pid,
+                                      char *out, size_t out_size)
 {
     int n;
 
     if (!out || out_size == 0) {
         return OBD_ERROR_INVALID_ARG;
     }
+    if (mode == 0x02) {
+        return obd_freeze_build_request(&pid, 1, 0, out, out_size);
+    }
 
     /* Format: "MMPP\r" = 2 hex digits for mode + 2 for PID + \r + \0 = 6 chars */
     if (out_size < 6) {
@@ -56,6 +65,16 @@ obd_result_t obd_pid_build_request(uint8_t mode, uint8_t pid,
     return OBD_OK;
 }
 
+obd_result_t obd_pid_build_request(uint8_t mode, uint8_t pid,
+                                   char *out, size_t out_size)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = pid_build_request(mode, pid, out, out_size);
+    OBD_STATS_END(OBD_STAT_PID_BUILD, r);
+    return r;
+}
+
 
 /*
  * Parse a PID response string into a structured result.
@@ -67,8 +86,8 @@ obd_result_t obd_pid_build_request(uint8_t mode, uint8_t pid,
  *   3. Second byte is the PID (0x0C)
  *   4. Remaining bytes are the data (0x1A, 0xF8)
  */
-obd_result_t obd_pid_parse_response(const char *response,
-                                    obd_pid_response_t *out)
+static obd_result_t pid_parse_response(const char *response,
+                                       obd_pid_response_t *out)
 {
     /* Buffer big enough for mode + PID + max data bytes */
     uint8_t bytes[2 + OBD_MAX_DATA_BYTES];
@@ -107,3 +126,139 @@ obd_result_t obd_pid_parse_response(const char *response,
 
     return OBD_OK;
 }
+
+obd_result_t obd_pid_parse_response(const char *response,
+                                    obd_pid_response_t *out)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = pid_parse_response(response, out);
+    OBD_STATS_END(OBD_STAT_PID_PARSE, r);
+    return r;
+}
+
+
+/* ── Supported-PID bitmaps ───────────────────────────────────────────────
+ *
+ * "41 00 BE 3E B8 11": PID 0x00 answered with bitmap BE 3E B8 11.
+ * Read MSB first, bit 31 is PID 0x01 and bit 0 is PID 0x20:
+ *
+ *   BE = 1011 1110 → 01, 03, 04, 05, 06, 07 supported
+ *   ...
+ *   11 = 0001 0001 → 1C and 20 (the next bitmap) supported
+ *
+ * On CAN several bitmaps can come back in one reply ("46 00 .. .. .. ..
+ * 20 .. .. .. .."), and several ECUs can answer; everything is merged
+ * into one set. Mode 02 bitmaps carry a frame number after the PID.
+ */
+static void supported_set(obd_pid_supported_t *set, unsigned id)
+{
+    set->bits[id >> 3] = (uint8_t)(set->bits[id >> 3] | (1u << (id & 7)));
+}
+
+void pid_supported_merge(obd_pid_supported_t *set, uint8_t base, const uint8_t *bitmap)
+{
+    unsigned bit;
+
+    for (bit = 0; bit < 32; bit++) {
+        if (bitmap[bit >> 3] & (0x80u >> (bit & 7))) {
+            unsigned id = base + 1u + bit;
+            if (id <= 0xFF) supported_set(set, id);
+        }
+    }
+    set->read = (uint8_t)(set->read | (1u << (base / 0x20)));
+}
+
+obd_result_t obd_pid_supported_parse(const char *response, uint8_t mode,
+                                     obd_pid_supported_t *set)
+{
+    obd_reply_t replies[OBD_MAX_ECUS];
+    size_t count = 0, i, merged = 0;
+    size_t group = mode == 0x02 ? 6 : 5;     /* PID (frame) A B C D */
+    obd_result_t r;
+
+    if (!response || !set) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    r = obd_reply_reassemble(response, replies, OBD_MAX_ECUS, &count);
+    if (r != OBD_OK) {
+        return r;
+    }
+
+    for (i = 0; i < count; i++) {
+        const uint8_t *d = replies[i].data;
+        size_t len = replies[i].len, pos;
+
+        if (len < 1 || d[0] != (uint8_t)(mode + 0x40)) {
+            continue;                          /* Another ECU saying no */
+        }
+        if ((len - 1) % group != 0) {
+            return OBD_ERROR_PARSE_FAILED;
+        }
+        for (pos = 1; pos < len; pos += group) {
+            uint8_t base = d[pos];
+
+            if (base % 0x20 != 0) {
+                return OBD_ERROR_PARSE_FAILED; /* Not a bitmap PID */
+            }
+            pid_supported_merge(set, base, d + pos + group - 4);
+            merged++;
+        }
+    }
+
+    return merged > 0 ? OBD_OK : OBD_ERROR_PARSE_FAILED;
+}
+
+int obd_pid_supported_has(const obd_pid_supported_t *set, uint8_t pid)
+{
+    if (!set) {
+        return 0;
+    }
+    if (pid == 0x00) {
+        return 1;                              /* Always asked, always there */
+    }
+    return (set->bits[pid >> 3] >> (pid & 7)) & 1;
+}
+
+int obd_pid_supported_next(const obd_pid_supported_t *set, uint8_t *base)
+{
+    unsigned k;
+
+    if (!set || !base) {
+        return 0;
+    }
+    for (k = 0; k < 8; k++) {
+        if (!obd_pid_supported_has(set, (uint8_t)(k * 0x20))) {
+            return 0;                          /* The chain ends here */
+        }
+        if (!(set->read & (1u << k))) {
+            *base = (uint8_t)(k * 0x20);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+obd_result_t obd_pid_supported_list(const obd_pid_supported_t *set, uint8_t *pids,
+                                    size_t max, size_t *count)
+{
+    unsigned id;
+    size_t n = 0;
+
+    if (!set || !count || (!pids && max > 0)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    *count = 0;
+    for (id = 1; id <= 0xFF; id++) {
+        if (id % 0x20 == 0 || !obd_pid_supported_has(set, (uint8_t)id)) {
+            continue;                          /* Bitmaps aren't data */
+        }
+        if (n >= max) {
+            return OBD_ERROR_BUFFER_TOO_SMALL;
+        }
+        pids[n++] = (uint8_t)id;
+        *count = n;
+    }
+    return OBD_OK;
+}
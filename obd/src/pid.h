@@ -7,4 +7,10 @@
 
 #include <obd/obd_types.h>
 
+/**
+ * Merge one supported-PID bitmap (4 bytes, as received after PID `base`)
+ * into a set and mark that bitmap as read.
+ */
+void pid_supported_merge(obd_pid_supported_t *set, uint8_t base, const uint8_t *bitmap);
+
 #endif /* PID_H */
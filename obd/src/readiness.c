@@ -0,0 +1,192 @@
+/**
+ * readiness.c — Readiness monitors and MIL status (PID 01 and PID 41).
+ *
+ * The car runs a self-test ("monitor") for each emissions system: the
+ * catalyst, the EVAP system, the O2 sensors... After the DTCs are cleared
+ * or the battery is disconnected they all start over, and each needs its
+ * own driving conditions to finish. Until enough of them have, the car
+ * can't pass an emissions inspection.
+ *
+ * PID 01 reports the state since the DTCs were cleared, in four bytes:
+ *
+ *   "41 01 83 07 65 04"
+ *          │  │  │  └── D: incomplete, same bits as C
+ *          │  │  └───── C: supported non-continuous monitors
+ *          │  └──────── B: continuous monitors, supported (bits 0-2) and
+ *          │               incomplete (bits 4-6); bit 3 = compression ignition
+ *          └─────────── A: bit 7 = MIL on, bits 0-6 = DTC count
+ *
+ * PID 41 has the same layout for the current drive cycle (byte A unused,
+ * "supported" meaning "enabled this cycle").
+ *
+ * obd_readiness_t packs B, C and D into two 16-bit masks, so judging a
+ * vehicle is a couple of ANDs and a population count.
+ */
+
+#include "readiness.h"
+#include "stats.h"
+#include <obd/obd.h>
+#include <string.h>
+
+/* Set bits in v */
+static unsigned count_bits(uint16_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_popcount(v);
+#else
+    unsigned x = v;
+    x = x - ((x >> 1) & 0x5555u);
+    x = (x & 0x3333u) + ((x >> 2) & 0x3333u);
+    x = (x + (x >> 4)) & 0x0F0Fu;
+    return (x + (x >> 8)) & 0x1Fu;
+#endif
+}
+
+static obd_result_t readiness_decode(const obd_pid_response_t *response,
+                                     obd_readiness_t *out)
+{
+    const uint8_t *d;
+
+    if (!response || !out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (response->pid != 0x01 && response->pid != 0x41) {
+        return OBD_ERROR_UNKNOWN_PID;
+    }
+    if (response->data_len < 4) {
+        return OBD_ERROR_PARSE_FAILED;
+    }
+
+    d = response->data;
+    memset(out, 0, sizeof(*out));
+    out->supported = (uint16_t)((d[1] & 0x07) | (d[2] << 3));
+    out->incomplete = (uint16_t)(((d[1] >> 4) & 0x07) | (d[3] << 3));
+    out->incomplete &= out->supported;        /* "Incomplete" bits of absent monitors are 0 or junk */
+
+    if (d[1] & 0x08) {
+        out->flags |= OBD_READINESS_COMPRESSION;
+    }
+    if (response->pid == 0x41) {
+        out->flags |= OBD_READINESS_THIS_CYCLE;
+    } else {
+        out->dtc_count = (uint8_t)(d[0] & 0x7F);
+        if (d[0] & 0x80) {
+            out->flags |= OBD_READINESS_MIL;
+        }
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_readiness_decode(const obd_pid_response_t *response,
+                                  obd_readiness_t *out)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = readiness_decode(response, out);
+    OBD_STATS_END(OBD_STAT_READINESS_DECODE, r);
+    return r;
+}
+
+obd_result_t obd_readiness_policy_init(obd_readiness_policy_t *policy,
+                                       unsigned model_year)
+{
+    if (!policy || model_year < 1996) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    policy->ignore = OBD_READY_CONTINUOUS;
+    policy->max_incomplete = model_year <= 2000 ? 2 : 1;
+    policy->allow_mil = 0;
+    return OBD_OK;
+}
+
+uint16_t obd_readiness_pending(const obd_readiness_t *r, uint16_t ignore)
+{
+    if (!r) {
+        return 0;
+    }
+    return (uint16_t)(r->incomplete & r->supported & ~ignore);
+}
+
+/* No branches on the data: the batch loop below stays a straight line */
+static int passes(const obd_readiness_t *r, uint16_t ignore, unsigned max_incomplete,
+                  unsigned mil_fails)
+{
+    unsigned pending = count_bits((uint16_t)(r->incomplete & r->supported & ~ignore));
+    unsigned mil = (r->flags & OBD_READINESS_MIL) & mil_fails;
+    return (pending <= max_incomplete) & (mil == 0);
+}
+
+int obd_readiness_is_ready(const obd_readiness_t *r, const obd_readiness_policy_t *policy)
+{
+    if (!r || !policy) {
+        return 0;
+    }
+    return passes(r, policy->ignore, policy->max_incomplete,
+                  policy->allow_mil ? 0u : OBD_READINESS_MIL);
+}
+
+size_t obd_readiness_check_batch(const obd_readiness_t *snaps, size_t count,
+                                 const obd_readiness_policy_t *policy, uint8_t *ready)
+{
+    uint16_t ignore;
+    unsigned max_incomplete, mil_fails;
+    size_t i, n = 0;
+
+    if (!snaps || !policy) {
+        return 0;
+    }
+    ignore = policy->ignore;
+    max_incomplete = policy->max_incomplete;
+    mil_fails = policy->allow_mil ? 0u : OBD_READINESS_MIL;
+
+    for (i = 0; i < count; i++) {
+        int ok = passes(&snaps[i], ignore, max_incomplete, mil_fails);
+        if (ready) ready[i] = (uint8_t)ok;
+        n += (size_t)ok;
+    }
+    return n;
+}
+
+obd_result_t obd_readiness_tally_batch(const obd_readiness_t *snaps, size_t count,
+                                       uint16_t ignore, size_t *pending)
+{
+    size_t i;
+
+    if ((!snaps && count > 0) || !pending) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    for (i = 0; i < count; i++) {
+        unsigned m = obd_readiness_pending(&snaps[i], ignore);
+        while (m) {
+            pending[count_bits((uint16_t)((m & (0u - m)) - 1))]++;   /* Index of the lowest set bit */
+            m &= m - 1;
+        }
+    }
+    return OBD_OK;
+}
+
+
+/* ── Monitor names ───────────────────────────────────────────────────────
+ *
+ * Index = bit in obd_readiness_t. Bits 3-10 mean different monitors on
+ * compression-ignition (diesel) engines; the first three are the same.
+ */
+static const char *const spark_names[OBD_READY_MONITOR_COUNT] = {
+    "Misfire", "Fuel System", "Components",
+    "Catalyst", "Heated Catalyst", "EVAP System", "Secondary Air",
+    "A/C Refrigerant", "O2 Sensor", "O2 Sensor Heater", "EGR/VVT System",
+};
+
+static const char *const compression_names[OBD_READY_MONITOR_COUNT] = {
+    "Misfire", "Fuel System", "Components",
+    "NMHC Catalyst", "NOx/SCR Aftertreatment", NULL, "Boost Pressure",
+    NULL, "Exhaust Gas Sensor", "PM Filter", "EGR/VVT System",
+};
+
+const char *obd_readiness_monitor_name(unsigned bit, int compression)
+{
+    if (bit >= OBD_READY_MONITOR_COUNT) {
+        return NULL;
+    }
+    return compression ? compression_names[bit] : spark_names[bit];
+}
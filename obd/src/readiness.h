@@ -0,0 +1,10 @@
+/**
+ * readiness.h — Internal header for readiness monitor decoding.
+ */
+
+#ifndef READINESS_H
+#define READINESS_H
+
+#include <obd/obd_types.h>
+
+#endif /* READINESS_H */
@@ -0,0 +1,274 @@
+/**
+ * reply.c — Putting multi-frame CAN replies back together.
+ *
+ * A CAN frame carries at most 8 bytes, so anything longer than a
+ * Mode 01 answer (a VIN, calibration IDs, Mode 06 test results) is cut
+ * into pieces by ISO-TP (ISO 15765-2). The ELM327 shows the pieces in
+ * one of two ways.
+ *
+ * Headers off (the default): a length line, then numbered segments:
+ *
+ *   "013"                            ← 0x013 = 19 bytes follow
+ *   "0: 46 01 0B 24 00 00"           ← segment 0 (6 bytes)
+ *   "1: 00 00 FF FF 01 0C 24"        ← segment 1 (7 bytes)
+ *   "2: 00 05 00 00 00 10 00"        ← segment 2 (6 bytes + padding)
+ *
+ * Headers on (ATH1): every frame with its CAN id and ISO-TP PCI byte,
+ * several ECUs possibly interleaved:
+ *
+ *   "7E8 10 13 46 01 0B 24 00 00"    ← first frame, 0x013 bytes in total
+ *   "7E9 03 46 00 80"                ← single frame from another ECU
+ *   "7E8 21 00 00 FF FF 01 0C 24"    ← consecutive frame 1
+ *   "7E8 22 00 05 00 00 00 10 00"    ← consecutive frame 2
+ *
+ * A plain line ("46 00 C0 00 00 01") is a whole message on its own:
+ * a single frame with headers off, or a legacy (non-CAN) protocol.
+ *
+ * Either way the result is one obd_reply_t per message, service byte
+ * first, padding cut off at the announced length.
+ */
+
+#include "reply.h"
+#include "hex_utils.h"
+#include "stats.h"
+#include <obd/obd.h>
+#include <string.h>
+
+/* A message still waiting for frames */
+typedef struct {
+    size_t   reply;         /* Index into out[] */
+    size_t   expected;      /* Total length announced */
+    uint8_t  seq;           /* Sequence number of the next frame */
+} pending_t;
+
+typedef struct {
+    obd_reply_t *out;
+    size_t       max;
+    size_t       count;
+    pending_t    pending[OBD_MAX_ECUS];
+    size_t       n_pending;
+} assembly_t;
+
+/* Start a new message; expected = 0 means it's already complete */
+static obd_result_t begin(assembly_t *a, uint16_t ecu, size_t expected, uint8_t seq)
+{
+    obd_reply_t *r;
+
+    if (a->count >= a->max) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    if (expected > OBD_MAX_REPLY_BYTES) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    r = &a->out[a->count];
+    r->ecu = ecu;
+    r->len = 0;
+
+    if (expected > 0) {
+        if (a->n_pending >= OBD_MAX_ECUS) {
+            return OBD_ERROR_BUFFER_TOO_SMALL;
+        }
+        a->pending[a->n_pending].reply = a->count;
+        a->pending[a->n_pending].expected = expected;
+        a->pending[a->n_pending].seq = seq;
+        a->n_pending++;
+    }
+    a->count++;
+    return OBD_OK;
+}
+
+/* Add bytes to a message, up to its announced length */
+static void append(obd_reply_t *r, const uint8_t *bytes, size_t n, size_t limit)
+{
+    if (r->len + n > limit) {
+        n = limit - r->len;             /* The rest is padding */
+    }
+    memcpy(r->data + r->len, bytes, n);
+    r->len += n;
+}
+
+/* The next frame of a multi-frame message: check its number, add it,
+ * and forget the message once it's complete */
+static obd_result_t continue_pending(assembly_t *a, size_t p, uint8_t seq,
+                                     const uint8_t *bytes, size_t n)
+{
+    pending_t *pend = &a->pending[p];
+    obd_reply_t *r = &a->out[pend->reply];
+
+    if (seq != pend->seq) {
+        return OBD_ERROR_PARSE_FAILED;  /* A frame went missing */
+    }
+    pend->seq = (uint8_t)((pend->seq + 1) & 0x0F);
+    append(r, bytes, n, pend->expected);
+
+    if (r->len >= pend->expected) {
+        a->pending[p] = a->pending[a->n_pending - 1];
+        a->n_pending--;
+    }
+    return OBD_OK;
+}
+
+/* The message from `ecu` that is still collecting frames */
+static int find_pending(const assembly_t *a, uint16_t ecu, size_t *p)
+{
+    size_t i;
+    for (i = 0; i < a->n_pending; i++) {
+        if (a->out[a->pending[i].reply].ecu == ecu) {
+            *p = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* "7E8 10 13 46 01 ..." — bytes[] starts at the PCI byte */
+static obd_result_t headers_line(assembly_t *a, uint16_t ecu, const uint8_t *bytes, size_t n)
+{
+    uint8_t type = (uint8_t)(bytes[0] >> 4);
+    size_t p;
+    obd_result_t r;
+
+    switch (type) {
+    case 0x0: {                                         /* Single frame */
+        size_t len = bytes[0] & 0x0F;
+        if (len == 0 || len > n - 1) return OBD_ERROR_PARSE_FAILED;
+        r = begin(a, ecu, 0, 0);
+        if (r == OBD_OK) append(&a->out[a->count - 1], bytes + 1, len, len);
+        return r;
+    }
+    case 0x1: {                                         /* First frame */
+        size_t len;
+        if (n < 2) return OBD_ERROR_PARSE_FAILED;
+        len = ((size_t)(bytes[0] & 0x0F) << 8) | bytes[1];
+        if (len == 0 || find_pending(a, ecu, &p)) return OBD_ERROR_PARSE_FAILED;
+        r = begin(a, ecu, len, 0);
+        if (r != OBD_OK) return r;
+        /* The first frame is number 0; consecutive frames count from 1 */
+        return continue_pending(a, a->n_pending - 1, 0, bytes + 2, n - 2);
+    }
+    case 0x2:                                           /* Consecutive frame */
+        if (!find_pending(a, ecu, &p)) return OBD_ERROR_PARSE_FAILED;
+        return continue_pending(a, p, (uint8_t)(bytes[0] & 0x0F), bytes + 1, n - 1);
+    default:
+        return OBD_ERROR_PARSE_FAILED;                  /* Flow control or junk */
+    }
+}
+
+size_t reply_length_line(const char *line, size_t len)
+{
+    size_t i, expected = 0;
+
+    if (len != 3) return 0;
+    for (i = 0; i < 3; i++) {
+        int nibble = hex_char_to_nibble(line[i]);
+        if (nibble < 0) return 0;
+        expected = expected << 4 | (size_t)nibble;
+    }
+    return expected;
+}
+
+static obd_result_t one_line(assembly_t *a, const char *line)
+{
+    uint8_t bytes[OBD_MAX_RESPONSE_LEN / 2];
+    size_t n = 0, len = strlen(line), i;
+    int hex3 = len >= 3;
+    obd_result_t r;
+
+    for (i = 0; i < 3 && i < len; i++) {
+        if (hex_char_to_nibble(line[i]) < 0) hex3 = 0;
+    }
+
+    /* "013": a multi-frame message follows, headers off */
+    if (hex3 && len == 3) {
+        size_t expected = reply_length_line(line, len);
+        if (expected == 0 || a->n_pending > 0) return OBD_ERROR_PARSE_FAILED;
+        return begin(a, 0, expected, 0);
+    }
+
+    /* "1: 00 00 00 FF FF 01 0C": segment of that message */
+    if (len >= 2 && hex_char_to_nibble(line[0]) >= 0 && line[1] == ':') {
+        size_t p;
+        r = obd_hex_to_bytes(line + 2, bytes, sizeof(bytes), &n);
+        if (r != OBD_OK) return r;
+        if (!find_pending(a, 0, &p)) return OBD_ERROR_PARSE_FAILED;
+        return continue_pending(a, p, (uint8_t)hex_char_to_nibble(line[0]), bytes, n);
+    }
+
+    /* "7E8 10 13 ...": one frame with its CAN id */
+    if (hex3 && line[3] == ' ') {
+        uint16_t ecu = (uint16_t)((hex_char_to_nibble(line[0]) << 8) |
+                                  (hex_char_to_nibble(line[1]) << 4) |
+                                  hex_char_to_nibble(line[2]));
+        r = obd_hex_to_bytes(line + 4, bytes, sizeof(bytes), &n);
+        if (r != OBD_OK) return r;
+        if (n == 0) return OBD_ERROR_PARSE_FAILED;
+        return headers_line(a, ecu, bytes, n);
+    }
+
+    /* "46 00 C0 00 00 01": a whole message */
+    r = obd_hex_to_bytes(line, bytes, sizeof(bytes), &n);
+    if (r != OBD_OK) return r;
+    if (n == 0) return OBD_OK;
+    if (n > OBD_MAX_REPLY_BYTES) return OBD_ERROR_BUFFER_TOO_SMALL;
+    r = begin(a, 0, 0, 0);
+    if (r == OBD_OK) append(&a->out[a->count - 1], bytes, n, n);
+    return r;
+}
+
+static obd_result_t reply_reassemble(const char *response, obd_reply_t *out, size_t max,
+                                     size_t *count)
+{
+    assembly_t a;
+    const char *p = response;
+
+    if (!response || !out || !count || max == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    memset(&a, 0, sizeof(a));
+    a.out = out;
+    a.max = max;
+    *count = 0;
+
+    while (*p != '\0') {
+        char line[OBD_MAX_RESPONSE_LEN];
+        size_t len = 0;
+        obd_result_t r;
+
+        while (*p == '\r' || *p == '\n' || *p == ' ') p++;
+        if (*p == '\0') break;
+        while (p[len] != '\0' && p[len] != '\r' && p[len] != '\n') len++;
+        if (len >= sizeof(line)) {
+            return OBD_ERROR_BUFFER_TOO_SMALL;
+        }
+        memcpy(line, p, len);
+        line[len] = '\0';
+        while (len > 0 && is_whitespace(line[len - 1])) line[--len] = '\0';
+        p += len;
+        while (*p != '\0' && *p != '\r' && *p != '\n') p++;
+
+        r = one_line(&a, line);
+        if (r != OBD_OK) {
+            return r;
+        }
+    }
+
+    if (a.n_pending > 0) {
+        return OBD_ERROR_PARSE_FAILED;  /* Frames still missing */
+    }
+    if (a.count == 0) {
+        return OBD_ERROR_NO_DATA;
+    }
+    *count = a.count;
+    return OBD_OK;
+}
+
+obd_result_t obd_reply_reassemble(const char *response, obd_reply_t *out, size_t max,
+                                  size_t *count)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = reply_reassemble(response, out, max, count);
+    OBD_STATS_END(OBD_STAT_REASSEMBLE, r);
+    return r;
+}
@@ -0,0 +1,17 @@
+/**
+ * reply.h — Internal header for multi-frame reply reassembly.
+ */
+
+#ifndef REPLY_H
+#define REPLY_H
+
+#include <obd/obd_types.h>
+
+/**
+ * The byte count a headers-off length line announces ("013" → 19), or 0
+ * if the line isn't one: exactly three hex digits, not all zero. len
+ * excludes any trailing whitespace.
+ */
+size_t reply_length_line(const char *line, size_t len);
+
+#endif /* REPLY_H */
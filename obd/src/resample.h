@@ -0,0 +1,10 @@
+/**
+ * resample.h — Internal header for the multi-rate resampler.
+ */
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <obd/obd_types.h>
+
+#endif /* RESAMPLE_H */
@@ -0,0 +1,616 @@
+/**
+ * rules.c — Alert rules: a small expression language, compiled once.
+ *
+ * A rule's text goes through a recursive-descent parser, one function per
+ * precedence level, that writes postfix bytecode as it goes:
+ *
+ *   $05 > 110 && $0C > 0
+ *
+ *   LOAD 0  CONST 0  GT  LOAD 1  CONST 1  GT  AND
+ *
+ * Each instruction is a byte, followed by a byte of operand for LOAD,
+ * RATE (channel slot) and CONST (index into the constant pool). Running it
+ * is a loop over a switch with a small stack of floats. The parser knows
+ * how deep the stack gets, so the run loop doesn't check.
+ *
+ * Channels get a slot the first time a rule reads them. Each slot has a
+ * bitmask of the rules that read it, so a sample runs those and no
+ * others; a rule whose inputs haven't all been seen yet is skipped.
+ *
+ * Around the expression is a small state machine per rule:
+ *
+ *   IDLE ──condition──▶ PENDING ──"for" elapsed──▶ ACTIVE
+ *     ▲                    │                        │
+ *     └───not condition────┘           clear condition
+ *     ▲                                             ▼
+ *     └──────"hold" elapsed────── CLEARING ◀────────┘
+ *
+ * A zero "for" or "hold" skips the waiting state. Times are sample times,
+ * and a rule that started because "for" ran out is stamped with the
+ * moment it ran out, not with the sample that noticed.
+ */
+
+#include "rules.h"
+#include <obd/obd.h>
+#include <string.h>
+
+enum {
+    OP_CONST, OP_LOAD, OP_RATE,
+    OP_NEG, OP_NOT, OP_ABS, OP_MIN, OP_MAX,
+    OP_MUL, OP_DIV, OP_ADD, OP_SUB,
+    OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+    OP_AND, OP_OR
+};
+
+static int truth(float v)
+{
+    return v < 0.0f || v > 0.0f;                /* NaN is false */
+}
+
+
+/* ── Compiler ────────────────────────────────────────────────────────── */
+
+typedef struct {
+    obd_rules_t  *rules;
+    const char   *text;
+    const char   *p;
+    const char   *error;
+    obd_result_t  result;
+    size_t        depth, max_depth;
+    uint32_t      reads, reads_rate;
+    int           first_slot;
+} compiler_t;
+
+static int fail(compiler_t *c, const char *error, obd_result_t result)
+{
+    if (!c->error) {
+        c->error = error;
+        c->result = result;
+        c->rules->error_at = (size_t)(c->p - c->text);
+    }
+    return 0;
+}
+
+static int is_word_char(char ch)
+{
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+           (ch >= '0' && ch <= '9') || ch == '_';
+}
+
+static void skip_space(compiler_t *c)
+{
+    while (*c->p == ' ' || *c->p == '\t' || *c->p == '\n' || *c->p == '\r') c->p++;
+}
+
+/* Symbol: "&&", "<=", "(" */
+static int accept(compiler_t *c, const char *symbol)
+{
+    size_t n = strlen(symbol);
+    skip_space(c);
+    if (strncmp(c->p, symbol, n) != 0) return 0;
+    c->p += n;
+    return 1;
+}
+
+/* Word: "for", "abs"; not the start of a longer one */
+static int accept_word(compiler_t *c, const char *word)
+{
+    size_t n = strlen(word);
+    skip_space(c);
+    if (strncmp(c->p, word, n) != 0 || is_word_char(c->p[n])) return 0;
+    c->p += n;
+    return 1;
+}
+
+static int emit(compiler_t *c, uint8_t op, int operand, int stack_change)
+{
+    obd_rules_t *e = c->rules;
+    size_t need = operand >= 0 ? 2 : 1;
+
+    if (e->code_len + need > OBD_RULES_CODE) {
+        return fail(c, "too much code", OBD_ERROR_BUFFER_TOO_SMALL);
+    }
+    e->code[e->code_len++] = op;
+    if (operand >= 0) e->code[e->code_len++] = (uint8_t)operand;
+
+    c->depth = (size_t)((int)c->depth + stack_change);
+    if (c->depth > c->max_depth) c->max_depth = c->depth;
+    if (c->max_depth > OBD_RULES_STACK) {
+        return fail(c, "expression too deep", OBD_ERROR_BUFFER_TOO_SMALL);
+    }
+    return 1;
+}
+
+static int parse_number(compiler_t *c, float *out)
+{
+    double v = 0.0, scale = 1.0;
+    int digits = 0;
+
+    skip_space(c);
+    while (*c->p >= '0' && *c->p <= '9') {
+        v = v * 10.0 + (*c->p++ - '0');
+        digits++;
+    }
+    if (*c->p == '.') {
+        c->p++;
+        while (*c->p >= '0' && *c->p <= '9') {
+            scale /= 10.0;
+            v += (*c->p++ - '0') * scale;
+            digits++;
+        }
+    }
+    *out = (float)v;
+    return digits > 0;
+}
+
+static int emit_constant(compiler_t *c, float v)
+{
+    obd_rules_t *e = c->rules;
+    size_t k;
+
+    for (k = 0; k < e->constant_count; k++) {
+        if (e->constants[k] == v) break;
+    }
+    if (k == e->constant_count) {
+        if (k == OBD_RULES_CONSTANTS) {
+            return fail(c, "too many constants", OBD_ERROR_BUFFER_TOO_SMALL);
+        }
+        e->constants[e->constant_count++] = v;
+    }
+    return emit(c, OP_CONST, (int)k, 1);
+}
+
+/* "$0C" → its slot, added if new */
+static int parse_channel(compiler_t *c, int *slot)
+{
+    obd_rules_t *e = c->rules;
+    unsigned channel = 0;
+    int digits = 0;
+    const char *start;
+    size_t s;
+
+    if (!accept(c, "$")) {
+        return fail(c, "expected a channel ($0C)", OBD_ERROR_PARSE_FAILED);
+    }
+    for (start = c->p;; c->p++, digits++) {
+        char ch = *c->p;
+        if (ch >= '0' && ch <= '9') channel = channel * 16 + (unsigned)(ch - '0');
+        else if (ch >= 'a' && ch <= 'f') channel = channel * 16 + (unsigned)(ch - 'a' + 10);
+        else if (ch >= 'A' && ch <= 'F') channel = channel * 16 + (unsigned)(ch - 'A' + 10);
+        else break;
+    }
+    if (digits == 0 || digits > 4) {
+        c->p = start;
+        return fail(c, "expected 1 to 4 hex digits after $", OBD_ERROR_PARSE_FAILED);
+    }
+
+    for (s = 0; s < e->channel_count; s++) {
+        if (e->channels[s].channel == channel) break;
+    }
+    if (s == e->channel_count) {
+        if (s == OBD_RULES_MAX_CHANNELS) {
+            return fail(c, "too many channels", OBD_ERROR_BUFFER_TOO_SMALL);
+        }
+        memset(&e->channels[s], 0, sizeof(e->channels[s]));
+        e->channels[s].channel = (uint16_t)channel;
+        e->channel_count++;
+    }
+    if (c->first_slot < 0) c->first_slot = (int)s;
+    *slot = (int)s;
+    return 1;
+}
+
+static int parse_or(compiler_t *c);
+
+/* One or two arguments in parentheses, after the function's name */
+static int parse_call(compiler_t *c, uint8_t op, int args)
+{
+    if (!accept(c, "(")) return fail(c, "expected '('", OBD_ERROR_PARSE_FAILED);
+    if (!parse_or(c)) return 0;
+    if (args == 2) {
+        if (!accept(c, ",")) return fail(c, "expected ','", OBD_ERROR_PARSE_FAILED);
+        if (!parse_or(c)) return 0;
+    }
+    if (!accept(c, ")")) return fail(c, "expected ')'", OBD_ERROR_PARSE_FAILED);
+    return emit(c, op, -1, 1 - args);
+}
+
+static int parse_primary(compiler_t *c)
+{
+    float v;
+    int slot;
+
+    skip_space(c);
+    if (*c->p == '$') {
+        if (!parse_channel(c, &slot)) return 0;
+        c->reads |= 1u << slot;
+        return emit(c, OP_LOAD, slot, 1);
+    }
+    if (accept_word(c, "rate")) {
+        if (!accept(c, "(")) return fail(c, "expected '('", OBD_ERROR_PARSE_FAILED);
+        if (!parse_channel(c, &slot)) return 0;
+        if (!accept(c, ")")) return fail(c, "expected ')'", OBD_ERROR_PARSE_FAILED);
+        c->reads |= 1u << slot;
+        c->reads_rate |= 1u << slot;
+        return emit(c, OP_RATE, slot, 1);
+    }
+    if (accept_word(c, "abs")) return parse_call(c, OP_ABS, 1);
+    if (accept_word(c, "min")) return parse_call(c, OP_MIN, 2);
+    if (accept_word(c, "max")) return parse_call(c, OP_MAX, 2);
+    if (accept(c, "(")) {
+        if (!parse_or(c)) return 0;
+        if (!accept(c, ")")) return fail(c, "expected ')'", OBD_ERROR_PARSE_FAILED);
+        return 1;
+    }
+    if (parse_number(c, &v)) {
+        return emit_constant(c, v);
+    }
+    return fail(c, "expected a value", OBD_ERROR_PARSE_FAILED);
+}
+
+static int parse_unary(compiler_t *c)
+{
+    if (accept(c, "-")) return parse_unary(c) && emit(c, OP_NEG, -1, 0);
+    if (accept(c, "!")) {
+        if (accept(c, "=")) return fail(c, "expected a value", OBD_ERROR_PARSE_FAILED);
+        return parse_unary(c) && emit(c, OP_NOT, -1, 0);
+    }
+    return parse_primary(c);
+}
+
+static int parse_term(compiler_t *c)
+{
+    if (!parse_unary(c)) return 0;
+    for (;;) {
+        if (accept(c, "*")) { if (!parse_unary(c) || !emit(c, OP_MUL, -1, -1)) return 0; }
+        else if (accept(c, "/")) { if (!parse_unary(c) || !emit(c, OP_DIV, -1, -1)) return 0; }
+        else return 1;
+    }
+}
+
+static int parse_sum(compiler_t *c)
+{
+    if (!parse_term(c)) return 0;
+    for (;;) {
+        if (accept(c, "+")) { if (!parse_term(c) || !emit(c, OP_ADD, -1, -1)) return 0; }
+        else if (accept(c, "-")) { if (!parse_term(c) || !emit(c, OP_SUB, -1, -1)) return 0; }
+        else return 1;
+    }
+}
+
+/* At most one comparison: "a < b < c" means nothing useful */
+static int parse_compare(compiler_t *c)
+{
+    static const struct { const char *symbol; uint8_t op; } ops[] = {
+        { "<=", OP_LE }, { ">=", OP_GE }, { "==", OP_EQ }, { "!=", OP_NE },
+        { "<", OP_LT }, { ">", OP_GT },
+    };
+    size_t i;
+
+    if (!parse_sum(c)) return 0;
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (accept(c, ops[i].symbol)) {
+            return parse_sum(c) && emit(c, ops[i].op, -1, -1);
+        }
+    }
+    return 1;
+}
+
+static int parse_and(compiler_t *c)
+{
+    if (!parse_compare(c)) return 0;
+    while (accept(c, "&&")) {
+        if (!parse_compare(c) || !emit(c, OP_AND, -1, -1)) return 0;
+    }
+    return 1;
+}
+
+static int parse_or(compiler_t *c)
+{
+    if (!parse_and(c)) return 0;
+    while (accept(c, "||")) {
+        if (!parse_and(c) || !emit(c, OP_OR, -1, -1)) return 0;
+    }
+    return 1;
+}
+
+static int parse_duration(compiler_t *c, uint64_t *us)
+{
+    float v;
+
+    if (!parse_number(c, &v)) {
+        return fail(c, "expected a duration (500ms, 10s, 2min)", OBD_ERROR_PARSE_FAILED);
+    }
+    if (accept_word(c, "ms")) *us = (uint64_t)((double)v * 1e3);
+    else if (accept_word(c, "s")) *us = (uint64_t)((double)v * 1e6);
+    else if (accept_word(c, "min")) *us = (uint64_t)((double)v * 60e6);
+    else return fail(c, "expected ms, s or min", OBD_ERROR_PARSE_FAILED);
+    return 1;
+}
+
+/* expr [for D] [clear expr] [hold D] */
+static int parse_rule(compiler_t *c, obd_rule_t *rule)
+{
+    obd_rules_t *e = c->rules;
+
+    rule->trigger_at = (uint16_t)e->code_len;
+    if (!parse_or(c)) return 0;
+    rule->trigger_len = (uint16_t)(e->code_len - rule->trigger_at);
+
+    if (accept_word(c, "for") && !parse_duration(c, &rule->for_us)) return 0;
+    if (accept_word(c, "clear")) {
+        c->depth = 0;
+        rule->clear_at = (uint16_t)e->code_len;
+        if (!parse_or(c)) return 0;
+        rule->clear_len = (uint16_t)(e->code_len - rule->clear_at);
+    }
+    if (accept_word(c, "hold") && !parse_duration(c, &rule->hold_us)) return 0;
+
+    skip_space(c);
+    if (*c->p != '\0') {
+        return fail(c, "unexpected text", OBD_ERROR_PARSE_FAILED);
+    }
+    if (c->reads == 0) {
+        return fail(c, "the rule reads no channel", OBD_ERROR_PARSE_FAILED);
+    }
+    return 1;
+}
+
+obd_result_t obd_rules_init(obd_rules_t *rules)
+{
+    if (!rules) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(rules, 0, sizeof(*rules));
+    return OBD_OK;
+}
+
+obd_result_t obd_rules_add(obd_rules_t *rules, const char *name, const char *text,
+                           size_t *index)
+{
+    compiler_t c;
+    obd_rule_t rule;
+    size_t code_len, constant_count, channel_count, idx, s;
+
+    if (!rules || !name || !text) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    rules->error = NULL;
+    rules->error_at = 0;
+    if (rules->rule_count == OBD_RULES_MAX) {
+        rules->error = "too many rules";
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    memset(&c, 0, sizeof(c));
+    c.rules = rules;
+    c.text = c.p = text;
+    c.first_slot = -1;
+    memset(&rule, 0, sizeof(rule));
+
+    code_len = rules->code_len;
+    constant_count = rules->constant_count;
+    channel_count = rules->channel_count;
+
+    if (!parse_rule(&c, &rule)) {
+        rules->code_len = code_len;             /* Leave no trace */
+        rules->constant_count = constant_count;
+        rules->channel_count = channel_count;
+        rules->error = c.error;
+        return c.result;
+    }
+
+    idx = rules->rule_count++;
+    strncpy(rule.name, name, OBD_RULE_NAME_LEN - 1);
+    rule.reads = c.reads;
+    rule.reads_rate = c.reads_rate;
+    rule.first_slot = (uint8_t)c.first_slot;
+    rules->rules[idx] = rule;
+    for (s = 0; s < rules->channel_count; s++) {
+        if (c.reads & (1u << s)) rules->channels[s].rules |= (uint64_t)1 << idx;
+    }
+    if (index) *index = idx;
+    return OBD_OK;
+}
+
+
+/* ── Evaluation ──────────────────────────────────────────────────────── */
+
+static float run(const obd_rules_t *e, size_t at, size_t len)
+{
+    float stack[OBD_RULES_STACK];
+    const uint8_t *pc = e->code + at, *end = pc + len;
+    size_t sp = 0;
+
+    while (pc < end) {
+        const obd_rule_channel_t *ch;
+        float b;
+
+        switch (*pc++) {
+        case OP_CONST: stack[sp++] = e->constants[*pc++]; break;
+        case OP_LOAD:  stack[sp++] = e->channels[*pc++].value; break;
+        case OP_RATE:
+            ch = &e->channels[*pc++];
+            stack[sp++] = (ch->value - ch->prev_value) /
+                          (float)((double)(ch->t_us - ch->prev_t_us) / 1e6);
+            break;
+        case OP_NEG: stack[sp - 1] = -stack[sp - 1]; break;
+        case OP_NOT: stack[sp - 1] = truth(stack[sp - 1]) ? 0.0f : 1.0f; break;
+        case OP_ABS: if (stack[sp - 1] < 0.0f) stack[sp - 1] = -stack[sp - 1]; break;
+        default:
+            b = stack[--sp];
+            switch (pc[-1]) {
+            case OP_MIN: if (b < stack[sp - 1]) stack[sp - 1] = b; break;
+            case OP_MAX: if (b > stack[sp - 1]) stack[sp - 1] = b; break;
+            case OP_MUL: stack[sp - 1] *= b; break;
+            case OP_DIV: stack[sp - 1] /= b; break;
+            case OP_ADD: stack[sp - 1] += b; break;
+            case OP_SUB: stack[sp - 1] -= b; break;
+            case OP_LT:  stack[sp - 1] = stack[sp - 1] <  b ? 1.0f : 0.0f; break;
+            case OP_LE:  stack[sp - 1] = stack[sp - 1] <= b ? 1.0f : 0.0f; break;
+            case OP_GT:  stack[sp - 1] = stack[sp - 1] >  b ? 1.0f : 0.0f; break;
+            case OP_GE:  stack[sp - 1] = stack[sp - 1] >= b ? 1.0f : 0.0f; break;
+            case OP_EQ:  stack[sp - 1] = stack[sp - 1] == b ? 1.0f : 0.0f; break;
+            case OP_NE:  stack[sp - 1] = stack[sp - 1] != b ? 1.0f : 0.0f; break;
+            case OP_AND: stack[sp - 1] = truth(stack[sp - 1]) && truth(b) ? 1.0f : 0.0f; break;
+            case OP_OR:  stack[sp - 1] = truth(stack[sp - 1]) || truth(b) ? 1.0f : 0.0f; break;
+            }
+        }
+    }
+    return stack[0];
+}
+
+/* Queue an event; a full ring loses its oldest */
+static void emit_event(obd_rules_t *e, size_t r, int active, uint64_t t_us)
+{
+    obd_rule_t *rule = &e->rules[r];
+    obd_rule_event_t *ev;
+
+    if (e->event_count == OBD_RULES_EVENTS) {
+        e->event_head = (e->event_head + 1) % OBD_RULES_EVENTS;
+        e->event_count--;
+        e->events_lost++;
+    }
+    ev = &e->events[(e->event_head + e->event_count++) % OBD_RULES_EVENTS];
+    ev->rule = (uint16_t)r;
+    ev->active = (uint8_t)active;
+    ev->t_us = t_us;
+    ev->value = e->channels[rule->first_slot].value;
+    ev->name = rule->name;
+
+    rule->state = active ? OBD_RULE_ACTIVE : OBD_RULE_IDLE;
+}
+
+static void step(obd_rules_t *e, size_t r, uint64_t t_us)
+{
+    obd_rule_t *rule = &e->rules[r];
+    int trigger = 0, clear;
+
+    if ((e->have & rule->reads) != rule->reads ||
+        (e->have_rate & rule->reads_rate) != rule->reads_rate) {
+        return;                                 /* Not every input seen yet */
+    }
+    e->evaluations++;
+
+    if (rule->state <= OBD_RULE_PENDING || rule->clear_len == 0) {
+        trigger = truth(run(e, rule->trigger_at, rule->trigger_len));
+    }
+
+    switch (rule->state) {
+    case OBD_RULE_IDLE:
+        if (!trigger) break;
+        if (rule->for_us == 0) {
+            emit_event(e, r, 1, t_us);
+        } else {
+            rule->state = OBD_RULE_PENDING;
+            rule->since_us = t_us;
+        }
+        break;
+
+    case OBD_RULE_PENDING:
+        if (!trigger) {
+            rule->state = OBD_RULE_IDLE;
+        } else if (t_us - rule->since_us >= rule->for_us) {
+            emit_event(e, r, 1, rule->since_us + rule->for_us);
+        }
+        break;
+
+    default:                                    /* ACTIVE, CLEARING */
+        clear = rule->clear_len ? truth(run(e, rule->clear_at, rule->clear_len)) : !trigger;
+        if (!clear) {
+            rule->state = OBD_RULE_ACTIVE;
+        } else if (rule->state == OBD_RULE_ACTIVE) {
+            if (rule->hold_us == 0) {
+                emit_event(e, r, 0, t_us);
+            } else {
+                rule->state = OBD_RULE_CLEARING;
+                rule->since_us = t_us;
+            }
+        } else if (t_us - rule->since_us >= rule->hold_us) {
+            emit_event(e, r, 0, rule->since_us + rule->hold_us);
+        }
+        break;
+    }
+}
+
+obd_result_t obd_rules_feed(obd_rules_t *rules, uint16_t channel, float value, uint64_t t_us)
+{
+    obd_rule_channel_t *ch = NULL;
+    uint64_t pending;
+    size_t s, r;
+
+    if (!rules) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    for (s = 0; s < rules->channel_count; s++) {
+        if (rules->channels[s].channel == channel) {
+            ch = &rules->channels[s];
+            break;
+        }
+    }
+    if (!ch || ch->rules == 0) {
+        return OBD_ERROR_UNKNOWN_PID;
+    }
+
+    if (ch->samples > 0 && t_us < ch->t_us) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (ch->samples == 0 || t_us > ch->t_us) {
+        ch->prev_value = ch->value;
+        ch->prev_t_us = ch->t_us;
+        if (ch->samples < 2) ch->samples++;
+    }
+    ch->value = value;                          /* Same time: replaces */
+    ch->t_us = t_us;
+    rules->have |= 1u << s;
+    if (ch->samples == 2) rules->have_rate |= 1u << s;
+
+    for (pending = ch->rules, r = 0; pending; pending >>= 1, r++) {
+        if (pending & 1) step(rules, r, t_us);
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_rules_feed_sensor(obd_rules_t *rules, const obd_sensor_value_t *value,
+                                   uint64_t t_us)
+{
+    if (!value) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    return obd_rules_feed(rules, value->pid, value->value, t_us);
+}
+
+obd_result_t obd_rules_tick(obd_rules_t *rules, uint64_t now_us)
+{
+    size_t r;
+
+    if (!rules) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    /* Nothing new came in, so the conditions are what they were */
+    for (r = 0; r < rules->rule_count; r++) {
+        obd_rule_t *rule = &rules->rules[r];
+        if (now_us < rule->since_us) continue;
+        if (rule->state == OBD_RULE_PENDING && now_us - rule->since_us >= rule->for_us) {
+            emit_event(rules, r, 1, rule->since_us + rule->for_us);
+        } else if (rule->state == OBD_RULE_CLEARING &&
+                   now_us - rule->since_us >= rule->hold_us) {
+            emit_event(rules, r, 0, rule->since_us + rule->hold_us);
+        }
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_rules_poll(obd_rules_t *rules, obd_rule_event_t *event)
+{
+    if (!rules || !event) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (rules->event_count == 0) {
+        return OBD_ERROR_NO_DATA;
+    }
+    *event = rules->events[rules->event_head];
+    rules->event_head = (rules->event_head + 1) % OBD_RULES_EVENTS;
+    rules->event_count--;
+    return OBD_OK;
+}
@@ -0,0 +1,10 @@
+/**
+ * rules.h — Internal header for the alert rule engine.
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+#include <obd/obd_types.h>
+
+#endif /* RULES_H */
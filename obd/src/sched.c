@@ -0,0 +1,242 @@
+/**
+ * sched.c — Adaptive polling: each PID's interval follows how fast, and
+ * how cleanly, its value moves.
+ *
+ * Per PID, a smoothed level and slope (Holt's double exponential
+ * smoothing) say where the next value should be:
+ *
+ *   predicted = level + slope * dt
+ *   residual  = new value - predicted
+ *
+ * A residual beyond resolution + 2 x noise is something the interval was
+ * too long to see coming: the interval drops to min_us and the level
+ * jumps to the new value. Otherwise level and slope take in part of the
+ * residual, and the interval grows by half, but no further than
+ * resolution / |slope|: the time the value takes to move by as much as
+ * the caller cares about. Noise follows |residual| either way.
+ *
+ * Noise is what keeps a jittery signal (fuel level sloshing in the tank)
+ * from counting every sample as a surprise: once learnt, it widens the
+ * band the next sample may land in.
+ *
+ * The next PID to send is the one furthest past its interval, as a
+ * fraction of that interval, so a PID that's 200 ms late on a 100 ms
+ * interval goes before one 5 s late on a 30 s interval.
+ */
+
+#include "sched.h"
+#include <obd/obd.h>
+#include <math.h>
+#include <string.h>
+
+#define LEVEL_GAIN  0.5
+#define TREND_GAIN  0.2
+#define NOISE_GAIN  0.1
+
+obd_result_t obd_sched_init(obd_sched_t *sched)
+{
+    if (!sched) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(sched, 0, sizeof(*sched));
+    return OBD_OK;
+}
+
+static obd_sched_entry_t *find(obd_sched_t *sched, uint8_t mode, uint8_t pid)
+{
+    size_t i;
+
+    for (i = 0; i < sched->count; i++) {
+        if (sched->entries[i].mode == mode && sched->entries[i].pid == pid) {
+            return &sched->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static uint64_t clamp_interval(const obd_sched_entry_t *e, double us)
+{
+    if (!(us > (double)e->min_us)) return e->min_us;        /* Also NaN */
+    if (us >= (double)e->max_us) return e->max_us;
+    return (uint64_t)us;
+}
+
+obd_result_t obd_sched_add(obd_sched_t *sched, uint8_t mode, uint8_t pid, float resolution,
+                           uint64_t min_us, uint64_t max_us)
+{
+    obd_sched_entry_t *e;
+
+    if (!sched || !(resolution > 0.0f) || min_us == 0 || min_us > max_us) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    e = find(sched, mode, pid);
+    if (!e) {
+        if (sched->count == OBD_SCHED_MAX_PIDS) {
+            return OBD_ERROR_BUFFER_TOO_SMALL;
+        }
+        e = &sched->entries[sched->count++];
+        memset(e, 0, sizeof(*e));
+        e->mode = mode;
+        e->pid = pid;
+        e->interval_us = min_us;
+    }
+    e->resolution = resolution;
+    e->min_us = min_us;
+    e->max_us = max_us;
+    e->interval_us = clamp_interval(e, (double)e->interval_us);
+    return OBD_OK;
+}
+
+obd_result_t obd_sched_next(obd_sched_t *sched, uint64_t now_us, uint8_t *mode, uint8_t *pid)
+{
+    obd_sched_entry_t *best = NULL;
+    double best_late = 0.0, late;
+    uint64_t waited;
+    size_t i;
+
+    if (!sched || !mode || !pid) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    for (i = 0; i < sched->count; i++) {
+        obd_sched_entry_t *e = &sched->entries[i];
+        if (!e->sent) {
+            best = e;                           /* Never sent: first */
+            break;
+        }
+        if (now_us < e->last_sent_us + e->interval_us) continue;
+        late = (double)(now_us - e->last_sent_us) / (double)e->interval_us;
+        if (!best || late > best_late) {
+            best = e;
+            best_late = late;
+        }
+    }
+    if (!best) {
+        return OBD_ERROR_NO_DATA;
+    }
+
+    /* What a fixed min_us rate would have sent by now, for obd_sched_saved() */
+    if (best->sent) {
+        waited = now_us - best->last_sent_us;
+        best->credit_us += waited;
+        best->fixed_polls += best->credit_us / best->min_us;
+        best->credit_us %= best->min_us;
+    } else {
+        best->fixed_polls++;
+    }
+    best->polls++;
+    best->sent = 1;
+    best->last_sent_us = now_us;
+    *mode = best->mode;
+    *pid = best->pid;
+    return OBD_OK;
+}
+
+uint64_t obd_sched_deadline(const obd_sched_t *sched)
+{
+    uint64_t earliest = 0, due;
+    size_t i;
+
+    if (!sched) {
+        return 0;
+    }
+    for (i = 0; i < sched->count; i++) {
+        const obd_sched_entry_t *e = &sched->entries[i];
+        due = e->sent ? e->last_sent_us + e->interval_us : 0;
+        if (i == 0 || due < earliest) earliest = due;
+    }
+    return earliest;
+}
+
+/* Fold a new value into the level, slope and noise, and set the interval */
+static void adapt(obd_sched_entry_t *e, float value, uint64_t t_us)
+{
+    double dt = (double)(t_us - e->t_us) / 1e6;
+    double predicted, residual, aim;
+
+    if (dt <= 0.0) {
+        return;                                 /* Same time: keep the first */
+    }
+    if (e->samples < 2) {
+        e->slope = (float)((value - e->level) / dt);
+        e->level = value;
+        e->samples = 2;
+        e->t_us = t_us;
+        return;
+    }
+
+    predicted = e->level + e->slope * dt;
+    residual = value - predicted;
+    if (fabs(residual) > e->resolution + 2.0 * e->noise) {
+        e->surprises++;
+        e->interval_us = e->min_us;
+        e->level = value;                       /* A step, not a trend */
+    } else {
+        e->level = (float)(predicted + LEVEL_GAIN * residual);
+        e->slope += (float)(TREND_GAIN * LEVEL_GAIN * residual / dt);
+        aim = fabs(e->slope) > 0.0f ? e->resolution / fabs(e->slope) * 1e6
+                                    : (double)e->max_us;
+        e->interval_us = clamp_interval(e, fmin((double)e->interval_us * 1.5, aim));
+    }
+    e->noise += (float)(NOISE_GAIN * (fabs(residual) - e->noise));
+    e->t_us = t_us;
+}
+
+obd_result_t obd_sched_feed(obd_sched_t *sched, uint8_t mode, uint8_t pid, float value,
+                            uint64_t t_us)
+{
+    obd_sched_entry_t *e;
+
+    if (!sched) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    e = find(sched, mode, pid);
+    if (!e) {
+        return OBD_ERROR_UNKNOWN_PID;
+    }
+    if (e->samples > 0 && t_us < e->t_us) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (e->samples == 0) {
+        e->level = value;
+        e->t_us = t_us;
+        e->samples = 1;
+        return OBD_OK;
+    }
+    adapt(e, value, t_us);
+    return OBD_OK;
+}
+
+obd_result_t obd_sched_feed_result(obd_sched_t *sched, const obd_session_result_t *result)
+{
+    const obd_trace_record_t *rec;
+    uint64_t t_us;
+
+    if (!sched || !result) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (result->status != OBD_OK || !result->has_value) {
+        return OBD_ERROR_NO_DATA;
+    }
+    rec = &result->trace;
+    if (rec->reached & (1u << OBD_TRACE_FIRST_BYTE)) {
+        t_us = rec->t[OBD_TRACE_FIRST_BYTE];
+    } else {
+        t_us = rec->t[OBD_TRACE_PROMPT];
+    }
+    return obd_sched_feed(sched, result->mode, result->pid, result->value.value, t_us);
+}
+
+uint64_t obd_sched_saved(const obd_sched_t *sched)
+{
+    uint64_t fixed = 0, polls = 0;
+    size_t i;
+
+    if (!sched) {
+        return 0;
+    }
+    for (i = 0; i < sched->count; i++) {
+        fixed += sched->entries[i].fixed_polls;
+        polls += sched->entries[i].polls;
+    }
+    return fixed > polls ? fixed - polls : 0;
+}
@@ -0,0 +1,10 @@
+/**
+ * sched.h — Internal header for the adaptive poll scheduler.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <obd/obd_types.h>
+
+#endif /* SCHED_H */
@@ -15,6 +15,7 @@
  */
 
 #include "sensor.h"
+#include "stats.h"
 #include <obd/obd.h>
 #include <string.h>
 
@@ -116,7 +117,7 @@ static float formula_runtime(const uint8_t *data, size_t data_len)
 
 /* A — Number of DTCs + MIL status (encoded in PID 0x01)
  * Bit 7 of A = MIL on/off, bits 0-6 = number of DTCs.
- * We return just the DTC count for simplicity. */
+ * We return just the DTC count; obd_readiness_decode() has the rest. */
 static float formula_dtc_count(const uint8_t *data, size_t data_len)
 {
     (void)data_len;
@@ -137,6 +138,8 @@ static float formula_fuel_trim(const uint8_t *data, size_t data_len)
  *
  * Each entry maps a PID number to its name, unit, byte count, and formula.
  * To support a new PID, just add a row — no other code changes needed.
+ * The C++ facade keeps a constexpr copy (obd::sensors in obd.hpp); add
+ * the same row there, or test_obd_hpp will fail.
  *
  * byte_count is how many data bytes the PID response contains.
  * This is used for validation (making sure we got enough bytes).
@@ -166,6 +169,7 @@ static const sensor_entry_t sensor_table[] = {
     { 0x11, "Throttle Position",          "%",      1,    formula_percent },
     { 0x14, "O2 Sensor 1 Voltage",        "V",      1,    formula_o2_voltage },
     { 0x1F, "Run Time Since Start",       "sec",    2,    formula_runtime },
+    { 0x33, "Barometric Pressure",        "kPa",    1,    formula_direct },
 };
 
 /* Number of entries in the table (computed at compile time) */
@@ -198,8 +202,8 @@ static const sensor_entry_t *find_sensor_entry(uint8_t pid)
  *   3. Call the formula function to compute the value
  *   4. Fill in name and unit from the table
  */
-obd_result_t obd_sensor_decode(const obd_pid_response_t *response,
-                               obd_sensor_value_t *out)
+static obd_result_t sensor_decode(const obd_pid_response_t *response,
+                                  obd_sensor_value_t *out)
 {
     const sensor_entry_t *entry;
 
@@ -231,6 +235,16 @@ obd_result_t obd_sensor_decode(const obd_pid_response_t *response,
     return OBD_OK;
 }
 
+obd_result_t obd_sensor_decode(const obd_pid_response_t *response,
+                               obd_sensor_value_t *out)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = sensor_decode(response, out);
+    OBD_STATS_END(OBD_STAT_SENSOR_DECODE, r);
+    return r;
+}
+
 
 /*
  * Get just the name of a PID (without decoding a value).
@@ -253,3 +267,32 @@ obd_result_t obd_sensor_get_name(uint8_t pid, char *name, size_t name_size)
     name[name_size - 1] = '\0';
     return OBD_OK;
 }
+
+int sensor_lookup(uint8_t pid, const char **name, const char **unit)
+{
+    const sensor_entry_t *entry = find_sensor_entry(pid);
+
+    if (!entry) {
+        return 0;
+    }
+    *name = entry->name;
+    *unit = entry->unit;
+    return 1;
+}
+
+obd_result_t obd_sensor_get_byte_count(uint8_t pid, size_t *out)
+{
+    const sensor_entry_t *entry;
+
+    if (!out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    entry = find_sensor_entry(pid);
+    if (!entry) {
+        return OBD_ERROR_UNKNOWN_PID;
+    }
+
+    *out = entry->byte_count;
+    return OBD_OK;
+}
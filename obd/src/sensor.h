@@ -7,4 +7,10 @@
 
 #include <obd/obd_types.h>
 
+/**
+ * Name and unit of a PID in the sensor table, as static strings.
+ * Returns 0 (and leaves name/unit alone) if the PID isn't in the table.
+ */
+int sensor_lookup(uint8_t pid, const char **name, const char **unit);
+
 #endif /* SENSOR_H */
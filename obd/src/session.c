@@ -0,0 +1,582 @@
+/**
+ * session.c — The request/response loop for one ELM327, with no I/O.
+ *
+ * Talking to an adapter always goes the same way:
+ *
+ *   1. write a command ("010C\r")
+ *   2. read bytes until the ">" prompt shows up
+ *   3. clean, parse and decode what came back
+ *   4. repeat with the next command
+ *
+ * Bluetooth sockets, serial ports, TCP, ptys — all of them move bytes
+ * differently, but steps 1–4 never change. So the session does steps
+ * 1–4 and the caller moves the bytes:
+ *
+ *   obd_session_submit_pid(&s, 0x01, 0x0C, now, &id);
+ *   obd_session_next_command(&s, now, cmd, sizeof(cmd), &len);
+ *   ...write cmd to the adapter...
+ *   obd_session_write_done(&s, now);
+ *   ...each time bytes arrive...
+ *   obd_session_feed(&s, bytes, n, now);
+ *   while (obd_session_poll(&s, &result) == OBD_OK) { use result }
+ *
+ * Every call takes "now" in µs from the caller's monotonic clock. That
+ * makes the session deterministic (tests feed fake times) and lets it
+ * stamp each phase of every request for the tracer (trace.c).
+ */
+
+#include "session.h"
+#include "hex_utils.h"
+#include <obd/obd.h>
+#include <string.h>
+
+/* Record that the current request reached `point` at time `now` */
+static void mark(obd_trace_record_t *rec, obd_trace_point_t point, uint64_t now)
+{
+    rec->t[point] = now;
+    rec->reached = (uint8_t)(rec->reached | (1u << point));
+}
+
+static int has_point(const obd_trace_record_t *rec, obd_trace_point_t point)
+{
+    return (rec->reached >> point) & 1u;
+}
+
+/* PARSED/DECODED happen inside our own calls, so there's no caller
+ * timestamp for them. Use the optional clock, else the prompt time. */
+static uint64_t clock_now(const obd_session_t *s, uint64_t fallback)
+{
+    return s->clock ? s->clock(s->clock_ctx) : fallback;
+}
+
+static int in_flight(const obd_session_t *s)
+{
+    return s->state == OBD_SESSION_WRITING || s->state == OBD_SESSION_WAITING;
+}
+
+
+/* ── Setup ───────────────────────────────────────────────────────────── */
+
+obd_result_t obd_session_init(obd_session_t *s)
+{
+    if (!s) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(s, 0, sizeof(*s));
+    s->state = OBD_SESSION_IDLE;
+    s->timeout_us = OBD_SESSION_DEFAULT_TIMEOUT_US;
+    s->next_id = 1;
+    return OBD_OK;
+}
+
+obd_result_t obd_session_set_timeout(obd_session_t *s, uint64_t timeout_us)
+{
+    if (!s || timeout_us == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    s->timeout_us = timeout_us;
+    return OBD_OK;
+}
+
+obd_result_t obd_session_set_clock(obd_session_t *s, obd_clock_fn clock, void *ctx)
+{
+    if (!s) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    s->clock = clock;
+    s->clock_ctx = ctx;
+    return OBD_OK;
+}
+
+obd_result_t obd_session_set_trace(obd_session_t *s, obd_trace_t *trace,
+                                   uint16_t track)
+{
+    if (!s) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    s->trace = trace;
+    s->track = track;
+    return OBD_OK;
+}
+
+obd_result_t obd_session_set_capture(obd_session_t *s, obd_capture_fn capture,
+                                     void *ctx)
+{
+    if (!s) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    s->capture = capture;
+    s->capture_ctx = ctx;
+    return OBD_OK;
+}
+
+
+/* ── Submitting requests ─────────────────────────────────────────────── */
+
+static obd_result_t enqueue(obd_session_t *s, obd_session_request_t *req,
+                            uint64_t now_us, uint32_t *out_id)
+{
+    if (s->queue_count >= OBD_SESSION_QUEUE_LEN) {
+        return OBD_ERROR_BUSY;
+    }
+
+    req->id = s->next_id++;
+    if (s->next_id == 0) s->next_id = 1;      /* 0 is never a valid id */
+    req->enqueued_us = now_us;
+
+    s->queue[(s->queue_head + s->queue_count) % OBD_SESSION_QUEUE_LEN] = *req;
+    s->queue_count++;
+
+    if (out_id) *out_id = req->id;
+    return OBD_OK;
+}
+
+obd_result_t obd_session_submit_pid(obd_session_t *s, uint8_t mode, uint8_t pid,
+                                    uint64_t now_us, uint32_t *out_id)
+{
+    obd_session_request_t req;
+    obd_result_t r;
+
+    if (!s) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    memset(&req, 0, sizeof(req));
+    r = obd_pid_build_request(mode, pid, req.command, sizeof(req.command));   /* "02PP00" too */
+    if (r != OBD_OK) {
+        return r;
+    }
+    req.mode = mode;
+    req.pid = pid;
+    req.is_obd = 1;
+    return enqueue(s, &req, now_us, out_id);
+}
+
+/*
+ * Any command: "ATZ", "03", "0902", "010C1"...
+ *
+ * If it's all hex it's an OBD request, and the first two bytes tell us
+ * the mode and PID (PID 0 for mode-only requests like "03"). Anything
+ * else (AT commands) is passed through and its reply returned as text.
+ */
+obd_result_t obd_session_submit_command(obd_session_t *s, const char *command,
+                                        uint64_t now_us, uint32_t *out_id)
+{
+    obd_session_request_t req;
+    size_t len, i;
+    int all_hex = 1;
+
+    if (!s || !command) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    /* Ignore a trailing \r or \n — we always add exactly one \r */
+    len = strlen(command);
+    while (len > 0 && (command[len - 1] == '\r' || command[len - 1] == '\n')) {
+        len--;
+    }
+    if (len == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (len + 2 > OBD_MAX_COMMAND_LEN) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    memset(&req, 0, sizeof(req));
+    memcpy(req.command, command, len);
+    req.command[len] = '\r';
+    req.command[len + 1] = '\0';
+
+    for (i = 0; i < len; i++) {
+        if (hex_char_to_nibble(command[i]) < 0) {
+            all_hex = 0;
+            break;
+        }
+    }
+    if (all_hex && len >= 2) {
+        req.is_obd = 1;
+        req.mode = (uint8_t)((hex_char_to_nibble(command[0]) << 4) |
+                             hex_char_to_nibble(command[1]));
+        if (len >= 4) {
+            req.pid = (uint8_t)((hex_char_to_nibble(command[2]) << 4) |
+                                hex_char_to_nibble(command[3]));
+        }
+    }
+    return enqueue(s, &req, now_us, out_id);
+}
+
+
+/* ── Timeouts ────────────────────────────────────────────────────────── */
+
+/* Move a finished request into the done ring and hand it to the tracer */
+static void finish(obd_session_t *s, obd_session_result_t *res, obd_result_t status)
+{
+    res->status = status;
+    s->times.result = (int8_t)status;
+    s->times.ecu = res->ecu;
+    res->trace = s->times;
+
+    if (s->trace) {
+        obd_trace_add(s->trace, &s->times);
+    }
+}
+
+static obd_session_result_t *claim_result(obd_session_t *s)
+{
+    obd_session_result_t *res;
+
+    /* next_command() only starts a request when there's room, so this
+     * slot is always free. */
+    res = &s->done[(s->done_head + s->done_count) % OBD_SESSION_DONE_LEN];
+    s->done_count++;
+
+    memset(res, 0, sizeof(*res));
+    res->id = s->current.id;
+    res->mode = s->current.mode;
+    res->pid = s->current.pid;
+    return res;
+}
+
+/*
+ * If the adapter never sends ">", give up on the request and report
+ * OBD_ERROR_TIMEOUT. The adapter may still be busy and send its reply
+ * late, so we DRAIN for a quarter of the timeout: late bytes are thrown
+ * away instead of being mistaken for the next command's reply.
+ */
+obd_result_t obd_session_tick(obd_session_t *s, uint64_t now_us)
+{
+    if (!s) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    if (in_flight(s) && now_us >= s->deadline_us) {
+        finish(s, claim_result(s), OBD_ERROR_TIMEOUT);
+        s->state = OBD_SESSION_DRAINING;
+        s->deadline_us = now_us + s->timeout_us / 4;
+    } else if (s->state == OBD_SESSION_DRAINING && now_us >= s->deadline_us) {
+        s->state = OBD_SESSION_IDLE;
+    }
+    return OBD_OK;
+}
+
+/*
+ * An ELM327 has no "never mind": once a command is written it runs to
+ * its prompt. So a request in flight is finished as cancelled and the
+ * session drains, exactly like after a timeout — but until the request's
+ * own deadline, since the adapter may still be busy with it.
+ */
+obd_result_t obd_session_cancel(obd_session_t *s, uint32_t id)
+{
+    size_t i;
+
+    if (!s || id == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    for (i = 0; i < s->queue_count; i++) {
+        if (s->queue[(s->queue_head + i) % OBD_SESSION_QUEUE_LEN].id != id) continue;
+
+        /* Close the gap; the order of the rest doesn't change */
+        for (; i + 1 < s->queue_count; i++) {
+            s->queue[(s->queue_head + i) % OBD_SESSION_QUEUE_LEN] =
+                s->queue[(s->queue_head + i + 1) % OBD_SESSION_QUEUE_LEN];
+        }
+        s->queue_count--;
+        return OBD_OK;
+    }
+
+    if (in_flight(s) && s->current.id == id) {
+        finish(s, claim_result(s), OBD_ERROR_CANCELLED);
+        s->state = OBD_SESSION_DRAINING;
+        return OBD_PENDING;
+    }
+    return OBD_ERROR_NO_DATA;
+}
+
+uint64_t obd_session_deadline(const obd_session_t *s)
+{
+    if (!s || s->state == OBD_SESSION_IDLE) {
+        return 0;
+    }
+    return s->deadline_us;
+}
+
+size_t obd_session_pending(const obd_session_t *s)
+{
+    if (!s) {
+        return 0;
+    }
+    return s->queue_count + (in_flight(s) ? 1u : 0u);
+}
+
+
+/* ── Sending ─────────────────────────────────────────────────────────── */
+
+obd_result_t obd_session_next_command(obd_session_t *s, uint64_t now_us,
+                                      char *out, size_t out_size, size_t *out_len)
+{
+    const obd_session_request_t *next;
+    size_t len;
+
+    if (!s || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (out_len) *out_len = 0;
+
+    obd_session_tick(s, now_us);
+
+    /* Nothing to send: busy, queue empty, or results not collected yet */
+    if (s->state != OBD_SESSION_IDLE || s->queue_count == 0 ||
+        s->done_count >= OBD_SESSION_DONE_LEN) {
+        return OBD_ERROR_NO_DATA;
+    }
+
+    next = &s->queue[s->queue_head];
+    len = strlen(next->command);
+    if (len + 1 > out_size) {
+        return OBD_ERROR_BUFFER_TOO_SMALL;
+    }
+    memcpy(out, next->command, len + 1);
+    if (out_len) *out_len = len;
+    if (s->capture) {
+        s->capture(s->capture_ctx, OBD_CAPTURE_TX, out, len, now_us);
+    }
+
+    s->current = *next;
+    s->queue_head = (s->queue_head + 1) % OBD_SESSION_QUEUE_LEN;
+    s->queue_count--;
+
+    memset(&s->times, 0, sizeof(s->times));
+    s->times.id = s->current.id;
+    s->times.track = s->track;
+    s->times.mode = s->current.mode;
+    s->times.pid = s->current.pid;
+    mark(&s->times, OBD_TRACE_ENQUEUE, s->current.enqueued_us);
+    mark(&s->times, OBD_TRACE_WRITE_START, now_us);
+
+    s->rx_len = 0;
+    s->rx_overflow = 0;
+    s->state = OBD_SESSION_WRITING;
+    s->deadline_us = now_us + s->timeout_us;
+    return OBD_OK;
+}
+
+obd_result_t obd_session_write_done(obd_session_t *s, uint64_t now_us)
+{
+    if (!s || s->state != OBD_SESSION_WRITING) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    mark(&s->times, OBD_TRACE_WRITE_DONE, now_us);
+    s->state = OBD_SESSION_WAITING;
+    return OBD_OK;
+}
+
+
+/* ── Receiving ───────────────────────────────────────────────────────── */
+
+/*
+ * With headers on (ATH1) a CAN reply line looks like
+ *   "7E8 04 41 0C 1A F8"
+ *    ^^^ ^^
+ *    |   PCI byte (frame type + length)
+ *    11-bit CAN id of the ECU that answered
+ *
+ * Pull out the ECU id and return a pointer to "41 0C 1A F8". Lines
+ * without a 3-digit header are returned unchanged with ecu = 0.
+ */
+static const char *strip_can_header(const char *line, uint16_t *ecu)
+{
+    int a = hex_char_to_nibble(line[0]);
+    int b = a >= 0 ? hex_char_to_nibble(line[1]) : -1;
+    int c = b >= 0 ? hex_char_to_nibble(line[2]) : -1;
+
+    *ecu = 0;
+    if (c < 0 || line[3] != ' ') {
+        return line;
+    }
+    *ecu = (uint16_t)((a << 8) | (b << 4) | c);
+    line += 4;
+
+    /* Skip the PCI byte */
+    if (hex_char_to_nibble(line[0]) >= 0 && hex_char_to_nibble(line[1]) >= 0 &&
+        line[2] == ' ') {
+        line += 3;
+    }
+    return line;
+}
+
+/* Parse the first line of a cleaned OBD reply into res->parsed */
+static obd_result_t parse_obd_reply(const obd_session_t *s, obd_session_result_t *res)
+{
+    char line[OBD_MAX_RESPONSE_LEN];
+    const char *data;
+    size_t len = 0;
+
+    while (res->response[len] != '\0' && res->response[len] != '\r') len++;
+    memcpy(line, res->response, len);
+    line[len] = '\0';
+
+    data = strip_can_header(line, &res->ecu);
+
+    /* Only Mode 01 replies have the "41 PP data..." shape. Mode 02 has a
+     * frame number before the data, other modes (03 DTCs, 09 VIN) are
+     * multi-line; their text is in res->response for
+     * obd_freeze_parse_response(), obd_dtc_parse_response()... */
+    if (s->current.mode != 0x01) {
+        return OBD_OK;
+    }
+
+    if (obd_pid_parse_response(data, &res->parsed) != OBD_OK ||
+        res->parsed.mode != (uint8_t)(s->current.mode + 0x40) ||
+        res->parsed.pid != s->current.pid) {
+        return OBD_ERROR_PARSE_FAILED;
+    }
+    res->has_parsed = 1;
+    return OBD_OK;
+}
+
+/*
+ * AT and other non-OBD commands: return the reply lines as text, minus
+ * the echo of our own command. "?" means the adapter didn't understand.
+ */
+static obd_result_t copy_text_reply(const obd_session_t *s, obd_session_result_t *res)
+{
+    size_t cmd_len = strlen(s->current.command) - 1;   /* without \r */
+    size_t out_pos = 0;
+    const char *p = s->rx;
+
+    while (*p != '\0') {
+        const char *start;
+        size_t len;
+
+        while (*p == '\r' || *p == '\n' || *p == ' ') p++;
+        if (*p == '\0') break;
+        start = p;
+        while (*p != '\0' && *p != '\r' && *p != '\n') p++;
+        len = (size_t)(p - start);
+        while (len > 0 && start[len - 1] == ' ') len--;
+
+        if (len == cmd_len && strncmp(start, s->current.command, len) == 0) {
+            continue;                                   /* echo */
+        }
+        if (out_pos + len + 2 > sizeof(res->response)) {
+            return OBD_ERROR_BUFFER_TOO_SMALL;
+        }
+        if (out_pos > 0) res->response[out_pos++] = '\r';
+        memcpy(res->response + out_pos, start, len);
+        out_pos += len;
+    }
+    res->response[out_pos] = '\0';
+
+    if (out_pos == 0) {
+        return OBD_ERROR_NO_DATA;
+    }
+    if (obd_elm327_classify_response(res->response) == OBD_ELM_RESPONSE_ERROR) {
+        return OBD_ERROR_ELM_ERROR;
+    }
+    return OBD_OK;
+}
+
+/* The ">" arrived: turn everything received into a result */
+static void complete(obd_session_t *s, uint64_t now_us)
+{
+    obd_session_result_t *res = claim_result(s);
+    obd_result_t status;
+
+    mark(&s->times, OBD_TRACE_PROMPT, now_us);
+    s->rx[s->rx_len] = '\0';
+
+    if (s->rx_overflow) {
+        status = OBD_ERROR_BUFFER_TOO_SMALL;
+    } else if (s->current.is_obd) {
+        status = obd_elm327_clean_response(s->rx, res->response, sizeof(res->response));
+        if (status == OBD_OK) {
+            status = parse_obd_reply(s, res);
+        } else if (status != OBD_ERROR_BUFFER_TOO_SMALL) {
+            /* Keep what the adapter said ("NO DATA", "UNABLE TO CONNECT")
+             * so it can be shown or relayed; the status stays the same */
+            copy_text_reply(s, res);
+        }
+    } else {
+        status = copy_text_reply(s, res);
+    }
+    mark(&s->times, OBD_TRACE_PARSED, clock_now(s, now_us));
+
+    if (res->has_parsed && s->current.mode == 0x01) {
+        if (obd_sensor_decode(&res->parsed, &res->value) == OBD_OK) {
+            res->has_value = 1;
+        }
+        mark(&s->times, OBD_TRACE_DECODED, clock_now(s, now_us));
+    }
+
+    finish(s, res, status);
+    s->state = OBD_SESSION_IDLE;
+}
+
+obd_result_t obd_session_feed(obd_session_t *s, const char *data, size_t len,
+                              uint64_t now_us)
+{
+    size_t i;
+
+    if (!s || (!data && len > 0)) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (s->capture && len > 0) {
+        s->capture(s->capture_ctx, OBD_CAPTURE_RX, data, len, now_us);
+    }
+
+    for (i = 0; i < len; i++) {
+        char c = data[i];
+
+        switch (s->state) {
+        case OBD_SESSION_IDLE:
+            continue;                   /* Unsolicited bytes: ignore */
+
+        case OBD_SESSION_DRAINING:
+            if (c == '>') s->state = OBD_SESSION_IDLE;
+            continue;
+
+        case OBD_SESSION_WRITING:
+            /* A reply can only follow a finished write */
+            mark(&s->times, OBD_TRACE_WRITE_DONE, now_us);
+            s->state = OBD_SESSION_WAITING;
+            break;
+
+        case OBD_SESSION_WAITING:
+            break;
+        }
+
+        if (c == '>') {
+            complete(s, now_us);
+            continue;
+        }
+
+        if (!has_point(&s->times, OBD_TRACE_FIRST_BYTE)) {
+            mark(&s->times, OBD_TRACE_FIRST_BYTE, now_us);
+        }
+        if (c != '\r' && c != '\n' && c != ' ') {
+            mark(&s->times, OBD_TRACE_LAST_BYTE, now_us);
+        }
+
+        if (s->rx_len + 1 < sizeof(s->rx)) {
+            s->rx[s->rx_len++] = c;
+        } else {
+            s->rx_overflow = 1;
+        }
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_session_poll(obd_session_t *s, obd_session_result_t *out)
+{
+    if (!s || !out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (s->done_count == 0) {
+        return OBD_ERROR_NO_DATA;
+    }
+    *out = s->done[s->done_head];
+    s->done_head = (s->done_head + 1) % OBD_SESSION_DONE_LEN;
+    s->done_count--;
+    return OBD_OK;
+}
@@ -0,0 +1,10 @@
+/**
+ * session.h — Internal header for the request/response session.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <obd/obd_types.h>
+
+#endif /* SESSION_H */
@@ -0,0 +1,450 @@
+/**
+ * stats.c — Optional per-API counters and latency histograms.
+ *
+ * Built with -DOBD_ENABLE_STATS=ON, the library keeps, for every
+ * instrumented public function:
+ *   - how many times it was called
+ *   - how many calls returned each obd_result_t
+ *   - a latency histogram (log-linear, see obd_types.h)
+ *
+ * Where the counters live
+ * -----------------------
+ * Counting into one shared struct from several threads would need atomics
+ * (slow) or locks (slower). Instead each thread gets its own SLOT in a
+ * static pool the first time it calls into the library. The slot index
+ * is claimed with one atomic increment and remembered in a thread-local
+ * pointer; after that, recording is plain increments on memory no other
+ * thread writes.
+ *
+ * The pool is static (zero malloc, like the rest of the library), so a
+ * slot outlives its thread and the counts stay in the totals. If more
+ * than OBD_STATS_MAX_THREADS threads ever call in, the extras share the
+ * last slot and their counts become approximate.
+ *
+ * Without OBD_ENABLE_STATS only the reporting functions are compiled;
+ * they see empty counters and report zeros.
+ */
+
+#if defined(OBD_ENABLE_STATS) && !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L   /* clock_gettime for tick calibration */
+#endif
+
+#include "stats.h"
+#include "appender.h"
+#include <obd/obd.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>             /* _BitScanReverse64 */
+#endif
+
+#if defined(OBD_ENABLE_STATS)
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <stdatomic.h>
+#endif
+#endif
+
+
+/* ── Histogram bucket math ───────────────────────────────────────────────
+ *
+ * Values 0..7 get one bucket each. Above that, each power of two [2^e,
+ * 2^(e+1)) is split into 8 equal sub-buckets:
+ *
+ *   bucket = (e - 2) * 8 + (top 3 bits below the leading 1)
+ *
+ *   value 13  = 0b1101    → e=3, sub=0b101=5 → bucket 13
+ *   value 100 = 0b1100100 → e=6, sub=0b100=4 → bucket 36 (covers 96..103)
+ *
+ * trace.c uses the same layout (in microseconds, fewer buckets), so these
+ * take the bucket count as a parameter.
+ */
+#define SUB_BITS 3
+
+/* Position of the leading 1 bit (v > 0) */
+static int highest_bit(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(v);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long e;
+    _BitScanReverse64(&e, v);
+    return (int)e;
+#else
+    int e = 0;
+    while (v >>= 1) e++;
+    return e;
+#endif
+}
+
+size_t obd_hist_bucket(uint64_t value, size_t bucket_count)
+{
+    int e;
+    size_t idx;
+
+    if (value < OBD_STAT_SUB_BUCKETS) {
+        idx = (size_t)value;
+    } else {
+        e = highest_bit(value);
+        idx = (size_t)(e - SUB_BITS + 1) * OBD_STAT_SUB_BUCKETS +
+              (size_t)((value >> (e - SUB_BITS)) & (OBD_STAT_SUB_BUCKETS - 1));
+    }
+    return idx < bucket_count ? idx : bucket_count - 1;
+}
+
+uint64_t obd_hist_lower(size_t idx)
+{
+    size_t e, sub;
+    if (idx < OBD_STAT_SUB_BUCKETS) {
+        return (uint64_t)idx;
+    }
+    e = idx / OBD_STAT_SUB_BUCKETS + SUB_BITS - 1;
+    sub = idx % OBD_STAT_SUB_BUCKETS;
+    return (uint64_t)(OBD_STAT_SUB_BUCKETS + sub) << (e - SUB_BITS);
+}
+
+uint64_t obd_hist_upper(size_t idx, size_t bucket_count)
+{
+    if (idx + 1 >= bucket_count) {
+        return obd_hist_lower(idx) * 2;
+    }
+    return obd_hist_lower(idx + 1);
+}
+
+
+#if defined(OBD_ENABLE_STATS)
+
+/* ── Per-thread slots ────────────────────────────────────────────────── */
+
+#define OBD_STATS_MAX_THREADS 32
+
+#if defined(_MSC_VER)
+#define OBD_THREAD_LOCAL __declspec(thread)
+#else
+#define OBD_THREAD_LOCAL _Thread_local
+#endif
+
+static obd_stats_t slots[OBD_STATS_MAX_THREADS];
+static OBD_THREAD_LOCAL obd_stats_t *my_slot;
+
+#if defined(_MSC_VER)
+static volatile long slots_claimed;
+#else
+static atomic_uint slots_claimed;
+#endif
+
+static obd_stats_t *claim_slot(void)
+{
+    unsigned idx;
+#if defined(_MSC_VER)
+    idx = (unsigned)(_InterlockedIncrement(&slots_claimed) - 1);
+#else
+    idx = atomic_fetch_add(&slots_claimed, 1u);
+#endif
+    if (idx >= OBD_STATS_MAX_THREADS) {
+        idx = OBD_STATS_MAX_THREADS - 1;  /* shared overflow slot */
+    }
+    my_slot = &slots[idx];
+    return my_slot;
+}
+
+static size_t slots_in_use(void)
+{
+#if defined(_MSC_VER)
+    size_t n = (size_t)slots_claimed;
+#else
+    size_t n = (size_t)atomic_load(&slots_claimed);
+#endif
+    return n < OBD_STATS_MAX_THREADS ? n : OBD_STATS_MAX_THREADS;
+}
+
+void obd_stats_record(obd_stat_fn_t fn, obd_result_t result, uint64_t start_ticks)
+{
+    uint64_t elapsed = obd_stats_ticks() - start_ticks;
+    obd_stats_t *s = my_slot ? my_slot : claim_slot();
+    obd_stat_counters_t *c = &s->fn[fn];
+    unsigned slot = (unsigned)-(int)result;
+
+    c->calls++;
+    c->results[slot < OBD_STAT_RESULT_SLOTS ? slot : OBD_STAT_RESULT_SLOTS - 1]++;
+    c->total_ticks += elapsed;
+    if (elapsed > c->max_ticks) c->max_ticks = elapsed;
+    c->hist[obd_hist_bucket(elapsed, OBD_STAT_HIST_BUCKETS)]++;
+}
+
+
+/* ── Tick calibration ────────────────────────────────────────────────────
+ *
+ * ARM64 tells us its timer frequency directly. On x86 we count TSC ticks
+ * across ~2 ms of wall clock, once per process. The clock_gettime
+ * fallback already counts nanoseconds.
+ */
+static uint64_t wall_ns(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static double ticks_per_us(void)
+{
+    static double cached;
+    uint64_t w0, t0, w1, t1;
+
+    if (cached > 0.0) return cached;
+
+#if defined(__aarch64__) && !defined(_MSC_VER)
+    {
+        uint64_t freq;
+        __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(freq));
+        cached = (double)freq / 1e6;
+        return cached;
+    }
+#endif
+
+    w0 = wall_ns();
+    t0 = obd_stats_ticks();
+    do {
+        w1 = wall_ns();
+    } while (w1 - w0 < 2000000u);
+    t1 = obd_stats_ticks();
+
+    cached = (double)(t1 - t0) * 1000.0 / (double)(w1 - w0);
+    return cached;
+}
+
+#endif /* OBD_ENABLE_STATS */
+
+
+/* ── Public API ──────────────────────────────────────────────────────── */
+
+int obd_stats_enabled(void)
+{
+#if defined(OBD_ENABLE_STATS)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+obd_result_t obd_stats_merge(obd_stats_t *dst, const obd_stats_t *src)
+{
+    size_t f, i;
+
+    if (!dst || !src) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    for (f = 0; f < OBD_STAT_FN_COUNT; f++) {
+        obd_stat_counters_t *d = &dst->fn[f];
+        const obd_stat_counters_t *s = &src->fn[f];
+
+        d->calls += s->calls;
+        d->total_ticks += s->total_ticks;
+        if (s->max_ticks > d->max_ticks) d->max_ticks = s->max_ticks;
+        for (i = 0; i < OBD_STAT_RESULT_SLOTS; i++) d->results[i] += s->results[i];
+        for (i = 0; i < OBD_STAT_HIST_BUCKETS; i++) d->hist[i] += s->hist[i];
+    }
+    if (dst->ticks_per_us <= 0.0) {
+        dst->ticks_per_us = src->ticks_per_us;
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_stats_snapshot(obd_stats_t *out)
+{
+    if (!out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(out, 0, sizeof(*out));
+
+#if defined(OBD_ENABLE_STATS)
+    {
+        size_t i, n = slots_in_use();
+        for (i = 0; i < n; i++) {
+            obd_stats_merge(out, &slots[i]);
+        }
+        out->ticks_per_us = ticks_per_us();
+    }
+#endif
+    return OBD_OK;
+}
+
+obd_result_t obd_stats_snapshot_thread(obd_stats_t *out)
+{
+    if (!out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(out, 0, sizeof(*out));
+
+#if defined(OBD_ENABLE_STATS)
+    if (my_slot) {
+        obd_stats_merge(out, my_slot);
+    }
+    out->ticks_per_us = ticks_per_us();
+#endif
+    return OBD_OK;
+}
+
+void obd_stats_reset(void)
+{
+#if defined(OBD_ENABLE_STATS)
+    size_t i, n = slots_in_use();
+    for (i = 0; i < n; i++) {
+        memset(slots[i].fn, 0, sizeof(slots[i].fn));
+    }
+#endif
+}
+
+static double ticks_to_ns(const obd_stats_t *stats, double ticks)
+{
+    if (stats->ticks_per_us <= 0.0) return ticks;
+    return ticks * 1000.0 / stats->ticks_per_us;
+}
+
+double obd_stats_quantile_ns(const obd_stats_t *stats, obd_stat_fn_t fn,
+                             double quantile)
+{
+    const obd_stat_counters_t *c;
+    uint64_t target, seen = 0;
+    size_t i;
+
+    if (!stats || (unsigned)fn >= OBD_STAT_FN_COUNT) return 0.0;
+    c = &stats->fn[fn];
+    if (c->calls == 0) return 0.0;
+
+    if (quantile < 0.0) quantile = 0.0;
+    if (quantile > 1.0) quantile = 1.0;
+    target = (uint64_t)(quantile * (double)c->calls + 0.5);
+    if (target == 0) target = 1;
+
+    /* Walk the buckets until we've passed `target` calls; report that
+     * bucket's upper edge (an upper bound on the true quantile). */
+    for (i = 0; i < OBD_STAT_HIST_BUCKETS; i++) {
+        seen += c->hist[i];
+        if (seen >= target) {
+            double upper = (double)obd_hist_upper(i, OBD_STAT_HIST_BUCKETS);
+            if (upper > (double)c->max_ticks) upper = (double)c->max_ticks;
+            return ticks_to_ns(stats, upper);
+        }
+    }
+    return ticks_to_ns(stats, (double)c->max_ticks);
+}
+
+
+/* ── Formatters ──────────────────────────────────────────────────────────
+ *
+ * Both write into a caller-provided buffer through appender.h, which
+ * tracks the position and notices when the buffer runs out.
+ */
+static const char *const stat_fn_names[OBD_STAT_FN_COUNT] = {
+    "hex_to_bytes", "bytes_to_hex", "classify", "clean", "pid_build",
+    "pid_parse", "sensor_decode", "dtc_parse", "vin_parse", "reassemble",
+    "monitor_parse", "info_parse", "freeze_parse",
+    "readiness_decode",
+};
+
+static const char *const result_names[] = {
+    "OK", "INVALID_ARG", "BUFFER_TOO_SMALL", "INVALID_HEX", "NO_DATA",
+    "ELM_ERROR", "PARSE_FAILED", "UNKNOWN_PID", "TIMEOUT", "BUSY",
+    "IO", "CANCELLED",
+};
+#define RESULT_NAME_COUNT (sizeof(result_names) / sizeof(result_names[0]))
+
+obd_result_t obd_stats_format_text(const obd_stats_t *stats,
+                                   char *out, size_t out_size)
+{
+    appender_t a;
+    size_t f;
+
+    if (!stats || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    appender_init(&a, out, out_size);
+
+    append(&a, "%-14s %10s %9s %9s %9s %9s %9s\n",
+           "function", "calls", "errors", "mean ns", "p50 ns", "p99 ns", "max ns");
+
+    for (f = 0; f < OBD_STAT_FN_COUNT; f++) {
+        const obd_stat_counters_t *c = &stats->fn[f];
+        if (c->calls == 0) continue;
+
+        append(&a, "%-14s %10llu %9llu %9.0f %9.0f %9.0f %9.0f\n",
+               stat_fn_names[f],
+               (unsigned long long)c->calls,
+               (unsigned long long)(c->calls - c->results[0]),
+               ticks_to_ns(stats, (double)c->total_ticks / (double)c->calls),
+               obd_stats_quantile_ns(stats, (obd_stat_fn_t)f, 0.50),
+               obd_stats_quantile_ns(stats, (obd_stat_fn_t)f, 0.99),
+               ticks_to_ns(stats, (double)c->max_ticks));
+    }
+    return appender_finish(&a);
+}
+
+obd_result_t obd_stats_format_json(const obd_stats_t *stats,
+                                   char *out, size_t out_size)
+{
+    appender_t a;
+    size_t f, i;
+    int first_fn = 1;
+
+    if (!stats || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    appender_init(&a, out, out_size);
+
+    append(&a, "{\"enabled\": %s, \"ticks_per_us\": %.3f, \"functions\": [",
+           obd_stats_enabled() ? "true" : "false", stats->ticks_per_us);
+
+    for (f = 0; f < OBD_STAT_FN_COUNT; f++) {
+        const obd_stat_counters_t *c = &stats->fn[f];
+        int first = 1;
+        if (c->calls == 0) continue;
+
+        append(&a, "%s\n  {\"name\": \"%s\", \"calls\": %llu, \"mean_ns\": %.1f, "
+                   "\"p50_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f, "
+                   "\"results\": {",
+               first_fn ? "" : ",", stat_fn_names[f],
+               (unsigned long long)c->calls,
+               ticks_to_ns(stats, (double)c->total_ticks / (double)c->calls),
+               obd_stats_quantile_ns(stats, (obd_stat_fn_t)f, 0.50),
+               obd_stats_quantile_ns(stats, (obd_stat_fn_t)f, 0.99),
+               ticks_to_ns(stats, (double)c->max_ticks));
+
+        for (i = 0; i < OBD_STAT_RESULT_SLOTS; i++) {
+            if (c->results[i] == 0) continue;
+            if (i < RESULT_NAME_COUNT) {
+                append(&a, "%s\"%s\": %llu", first ? "" : ", ",
+                       result_names[i], (unsigned long long)c->results[i]);
+            } else {
+                append(&a, "%s\"ERROR_%u\": %llu", first ? "" : ", ",
+                       (unsigned)i, (unsigned long long)c->results[i]);
+            }
+            first = 0;
+        }
+
+        /* Only non-empty buckets: [bucket lower edge in ns, count] */
+        append(&a, "}, \"hist_ns\": [");
+        first = 1;
+        for (i = 0; i < OBD_STAT_HIST_BUCKETS; i++) {
+            if (c->hist[i] == 0) continue;
+            append(&a, "%s[%.1f, %llu]", first ? "" : ", ",
+                   ticks_to_ns(stats, (double)obd_hist_lower(i)),
+                   (unsigned long long)c->hist[i]);
+            first = 0;
+        }
+        append(&a, "]}");
+        first_fn = 0;
+    }
+    append(&a, "\n]}\n");
+    return appender_finish(&a);
+}
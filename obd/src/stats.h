@@ -0,0 +1,80 @@
+/**
+ * stats.h — Internal hooks for the optional instrumentation layer.
+ *
+ * Each instrumented public function looks like this:
+ *
+ *   obd_result_t obd_pid_parse_response(...)
+ *   {
+ *       obd_result_t r;
+ *       OBD_STATS_BEGIN();
+ *       r = pid_parse_response(...);          (the real work)
+ *       OBD_STATS_END(OBD_STAT_PID_PARSE, r);
+ *       return r;
+ *   }
+ *
+ * Without OBD_ENABLE_STATS both macros become ((void)0) and the compiler
+ * inlines the static worker straight back in — the wrapper costs nothing.
+ *
+ * With it, BEGIN reads the CPU tick counter and END records the call:
+ * a thread-local pointer load, one more tick read and a handful of
+ * increments. No locks, no atomics, no system calls.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <obd/obd_types.h>
+
+/*
+ * Log-linear histogram helpers (always compiled; trace.c uses them too).
+ * Values above the last bucket are clamped into it.
+ */
+size_t   obd_hist_bucket(uint64_t value, size_t bucket_count);
+uint64_t obd_hist_lower(size_t idx);                      /* smallest value in bucket */
+uint64_t obd_hist_upper(size_t idx, size_t bucket_count); /* one past the largest */
+
+#ifdef OBD_ENABLE_STATS
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif !defined(__aarch64__)
+#include <time.h>
+#endif
+
+/*
+ * Read the cheapest monotonic counter the CPU has.
+ *   x86:   RDTSC (constant-rate on every CPU from the last 15 years)
+ *   ARM64: CNTVCT_EL0, the generic timer, readable from user space
+ *   other: clock_gettime in nanoseconds
+ */
+static inline uint64_t obd_stats_ticks(void)
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return (uint64_t)__rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* Record one call: count, result tally, latency bucket. (stats.c) */
+void obd_stats_record(obd_stat_fn_t fn, obd_result_t result, uint64_t start_ticks);
+
+#define OBD_STATS_BEGIN()         uint64_t obd_stats_start_ = obd_stats_ticks()
+#define OBD_STATS_END(fn, result) obd_stats_record((fn), (result), obd_stats_start_)
+
+#else
+
+#define OBD_STATS_BEGIN()         ((void)0)
+#define OBD_STATS_END(fn, result) ((void)0)
+
+#endif /* OBD_ENABLE_STATS */
+
+#endif /* STATS_H */
@@ -0,0 +1,262 @@
+/**
+ * summary.c — Streaming per-sensor statistics.
+ *
+ * A trip of 10 Hz RPM is 36000 samples an hour. Keeping them all to work
+ * out the mean and p95 at the end costs memory and a long pause; this
+ * keeps a fixed-size obd_summary_t per sensor instead and updates it per
+ * sample.
+ *
+ * Mean and variance: Welford's method. The naive sum and sum of squares
+ * lose everything to cancellation when the values are large and close
+ * together (RPM around 2000); Welford updates the mean and the sum of
+ * squared deviations from it, which stays accurate. Two of them combine
+ * exactly (Chan et al.), which is what makes merge() work.
+ *
+ * Percentiles: a merging t-digest (Dunning). The samples, sorted, are
+ * grouped into centroids (mean, weight). How many samples a centroid may
+ * hold depends on where it sits: near q = 0 and q = 1 only a few, in the
+ * middle many. The limit comes from the scale function
+ *
+ *     k(q) = δ / 2π · asin(2q − 1)
+ *
+ * a centroid may span at most 1 in k. k rises steeply at the ends and
+ * slowly in the middle, and its whole range is δ/2, so there are never
+ * more than δ + 1 centroids. New samples wait in a small buffer; when it
+ * fills, buffer and centroids are sorted together and regrouped. Merging
+ * two digests is the same regrouping over both sets of centroids.
+ */
+
+#include "summary.h"
+#include <obd/obd.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI          3.14159265358979323846
+#define COMPRESSION ((double)(OBD_SUMMARY_CENTROIDS - 2))     /* δ: ≤ δ + 1 centroids */
+
+typedef struct {
+    float    mean;
+    uint32_t weight;
+} centroid_t;
+
+static int by_mean(const void *a, const void *b)
+{
+    float x = ((const centroid_t *)a)->mean, y = ((const centroid_t *)b)->mean;
+    return (x > y) - (x < y);
+}
+
+static double scale_k(double q)
+{
+    return COMPRESSION / (2.0 * PI) * asin(2.0 * q - 1.0);
+}
+
+static double scale_q(double k)
+{
+    double x = 2.0 * PI * k / COMPRESSION;
+    if (x > PI / 2.0) return 1.0;
+    return (sin(x) + 1.0) / 2.0;
+}
+
+/* Regroup sorted centroids into s (replacing what it had) */
+static void regroup(obd_summary_t *s, centroid_t *c, size_t n)
+{
+    double total = 0.0, so_far = 0.0, limit;
+    centroid_t cur;
+    size_t i, out = 0;
+
+    for (i = 0; i < n; i++) total += c[i].weight;
+    s->centroid_count = 0;
+    if (n == 0) return;
+
+    cur = c[0];
+    limit = scale_q(scale_k(0.0) + 1.0);
+    for (i = 1; i < n; i++) {
+        double q = (so_far + cur.weight + c[i].weight) / total;
+
+        if (q <= limit || out == OBD_SUMMARY_CENTROIDS - 1) {
+            /* Weighted mean; the last slot takes everything if it must */
+            double w = (double)cur.weight + c[i].weight;
+            cur.mean = (float)(cur.mean + (c[i].mean - cur.mean) * (c[i].weight / w));
+            cur.weight += c[i].weight;
+        } else {
+            s->centroid_mean[out] = cur.mean;
+            s->centroid_weight[out] = cur.weight;
+            out++;
+            so_far += cur.weight;
+            limit = scale_q(scale_k(so_far / total) + 1.0);
+            cur = c[i];
+        }
+    }
+    s->centroid_mean[out] = cur.mean;
+    s->centroid_weight[out] = cur.weight;
+    s->centroid_count = out + 1;
+}
+
+/* Centroids and buffered samples of s, appended to c[] */
+static size_t gather(const obd_summary_t *s, centroid_t *c)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < s->centroid_count; i++) {
+        c[n].mean = s->centroid_mean[i];
+        c[n++].weight = s->centroid_weight[i];
+    }
+    for (i = 0; i < s->buffered; i++) {
+        c[n].mean = s->buffer[i];
+        c[n++].weight = 1;
+    }
+    return n;
+}
+
+static void flush(obd_summary_t *s)
+{
+    centroid_t c[OBD_SUMMARY_CENTROIDS + OBD_SUMMARY_BUFFER];
+    size_t n;
+
+    if (s->buffered == 0) return;
+    n = gather(s, c);
+    qsort(c, n, sizeof(c[0]), by_mean);
+    s->buffered = 0;
+    regroup(s, c, n);
+}
+
+obd_result_t obd_summary_reset(obd_summary_t *s)
+{
+    if (!s) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(s, 0, sizeof(*s));
+    return OBD_OK;
+}
+
+obd_result_t obd_summary_add(obd_summary_t *s, float value, uint64_t t_us)
+{
+    double delta;
+
+    if (!s) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    if (s->count == 0 || value < s->min) { s->min = value; s->min_t_us = t_us; }
+    if (s->count == 0 || value > s->max) { s->max = value; s->max_t_us = t_us; }
+    if (s->count == 0) s->first_t_us = t_us;
+    s->last_t_us = t_us;
+
+    s->count++;
+    delta = value - s->mean;
+    s->mean += delta / (double)s->count;
+    s->m2 += delta * (value - s->mean);
+
+    s->buffer[s->buffered++] = value;
+    if (s->buffered == OBD_SUMMARY_BUFFER) {
+        flush(s);
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_summary_merge(obd_summary_t *dst, const obd_summary_t *src)
+{
+    centroid_t c[2 * (OBD_SUMMARY_CENTROIDS + OBD_SUMMARY_BUFFER)];
+    double na, nb, delta;
+    size_t n;
+
+    if (!dst || !src || dst == src) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (src->count == 0) {
+        return OBD_OK;
+    }
+    if (dst->count == 0) {
+        *dst = *src;
+        return OBD_OK;
+    }
+
+    na = (double)dst->count;
+    nb = (double)src->count;
+    delta = src->mean - dst->mean;
+    dst->mean += delta * nb / (na + nb);
+    dst->m2 += src->m2 + delta * delta * na * nb / (na + nb);
+    dst->count += src->count;
+
+    if (src->min < dst->min) { dst->min = src->min; dst->min_t_us = src->min_t_us; }
+    if (src->max > dst->max) { dst->max = src->max; dst->max_t_us = src->max_t_us; }
+    if (src->first_t_us < dst->first_t_us) dst->first_t_us = src->first_t_us;
+    if (src->last_t_us > dst->last_t_us) dst->last_t_us = src->last_t_us;
+
+    n = gather(dst, c);
+    n += gather(src, c + n);
+    qsort(c, n, sizeof(c[0]), by_mean);
+    dst->buffered = 0;
+    regroup(dst, c, n);
+    return OBD_OK;
+}
+
+/*
+ * Each centroid stands at the middle of the ranks it covers; the min sits
+ * at rank 0 and the max at rank count. Between two of those points the
+ * value is a straight line.
+ */
+static float digest_quantile(const obd_summary_t *s, double quantile)
+{
+    double rank = quantile * (double)s->count;
+    double prev_rank = 0.0, prev_value = s->min, cum = 0.0;
+    size_t i;
+
+    for (i = 0; i < s->centroid_count; i++) {
+        double center = cum + s->centroid_weight[i] / 2.0;
+        if (rank < center) {
+            return (float)(prev_value + (s->centroid_mean[i] - prev_value) *
+                                        (rank - prev_rank) / (center - prev_rank));
+        }
+        prev_rank = center;
+        prev_value = s->centroid_mean[i];
+        cum += s->centroid_weight[i];
+    }
+    if (cum <= prev_rank) return s->max;
+    return (float)(prev_value + (s->max - prev_value) * (rank - prev_rank) / (cum - prev_rank));
+}
+
+float obd_summary_quantile(const obd_summary_t *s, double quantile)
+{
+    obd_summary_t flushed;
+
+    if (!s || s->count == 0) return 0.0f;
+    if (quantile <= 0.0) return s->min;
+    if (quantile >= 1.0) return s->max;
+
+    if (s->buffered > 0) {
+        flushed = *s;
+        flush(&flushed);
+        s = &flushed;
+    }
+    return digest_quantile(s, quantile);
+}
+
+obd_result_t obd_summary_snapshot(const obd_summary_t *s, obd_summary_snapshot_t *out)
+{
+    obd_summary_t flushed;
+
+    if (!s || !out) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(out, 0, sizeof(*out));
+    if (s->count == 0) {
+        return OBD_ERROR_NO_DATA;
+    }
+
+    flushed = *s;
+    flush(&flushed);
+
+    out->count = s->count;
+    out->min = s->min;
+    out->max = s->max;
+    out->min_t_us = s->min_t_us;
+    out->max_t_us = s->max_t_us;
+    out->mean = (float)s->mean;
+    out->stddev = s->count > 1 ? (float)sqrt(s->m2 / (double)(s->count - 1)) : 0.0f;
+    out->p50 = digest_quantile(&flushed, 0.50);
+    out->p95 = digest_quantile(&flushed, 0.95);
+    out->p99 = digest_quantile(&flushed, 0.99);
+    return OBD_OK;
+}
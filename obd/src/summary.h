@@ -0,0 +1,10 @@
+/**
+ * summary.h — Internal header for per-sensor streaming summaries.
+ */
+
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <obd/obd_types.h>
+
+#endif /* SUMMARY_H */
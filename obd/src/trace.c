@@ -0,0 +1,317 @@
+/**
+ * trace.c — Round-trip latency tracing per PID and per ECU.
+ *
+ * A sample that takes 120 ms could be spending it in the Bluetooth
+ * write, in the ECU, in the adapter waiting for more ECUs to answer, or
+ * in our own parsing. The session (session.c) stamps each of those
+ * moments on every request; this file turns the stamps into:
+ *
+ *   1. Per-(mode, PID, ECU) histograms of every phase, so you can read
+ *      off "p99 ECU response time for 01 0C from 7E8 is 38 ms" and size
+ *      timeouts and polling intervals from real data.
+ *
+ *   2. A Chrome trace-event JSON export of the most recent requests.
+ *      Load it in chrome://tracing or https://ui.perfetto.dev to see each
+ *      request as a bar split into its phases, one row per adapter.
+ *
+ * Like the rest of the library: no malloc, no I/O. The collector and the
+ * record ring are caller storage.
+ */
+
+#include "trace.h"
+#include "stats.h"
+#include "appender.h"
+#include <obd/obd.h>
+#include <string.h>
+
+/* Phase n runs from point phase_from[n] to point phase_to[n].
+ * OBD_PHASE_TOTAL is special-cased (it ends at the last point reached). */
+static const obd_trace_point_t phase_from[OBD_PHASE_TOTAL] = {
+    OBD_TRACE_ENQUEUE, OBD_TRACE_WRITE_START, OBD_TRACE_WRITE_DONE,
+    OBD_TRACE_FIRST_BYTE, OBD_TRACE_LAST_BYTE, OBD_TRACE_PROMPT,
+    OBD_TRACE_PARSED,
+};
+static const obd_trace_point_t phase_to[OBD_PHASE_TOTAL] = {
+    OBD_TRACE_WRITE_START, OBD_TRACE_WRITE_DONE, OBD_TRACE_FIRST_BYTE,
+    OBD_TRACE_LAST_BYTE, OBD_TRACE_PROMPT, OBD_TRACE_PARSED,
+    OBD_TRACE_DECODED,
+};
+
+static const char *const phase_names[OBD_PHASE_COUNT] = {
+    "queue", "write", "ecu", "receive", "adapter", "parse", "decode", "total",
+};
+
+
+static int has_point(const obd_trace_record_t *rec, obd_trace_point_t point)
+{
+    return (rec->reached >> point) & 1u;
+}
+
+/*
+ * How long a request spent in one phase, in µs.
+ * Returns -1 if the request never reached both ends of the phase
+ * (e.g. a timeout has no PROMPT, an AT command has no DECODED).
+ */
+static int64_t phase_us(const obd_trace_record_t *rec, size_t phase)
+{
+    obd_trace_point_t from, to;
+
+    if (phase == OBD_PHASE_TOTAL) {
+        int p;
+        if (!has_point(rec, OBD_TRACE_ENQUEUE)) return -1;
+        for (p = OBD_TRACE_POINT_COUNT - 1; p > OBD_TRACE_ENQUEUE; p--) {
+            if (has_point(rec, (obd_trace_point_t)p)) break;
+        }
+        if (p == OBD_TRACE_ENQUEUE) return -1;
+        from = OBD_TRACE_ENQUEUE;
+        to = (obd_trace_point_t)p;
+    } else {
+        from = phase_from[phase];
+        to = phase_to[phase];
+        if (!has_point(rec, from) || !has_point(rec, to)) return -1;
+    }
+
+    /* A clock that steps backwards shouldn't produce 2^64 µs */
+    if (rec->t[to] < rec->t[from]) return 0;
+    return (int64_t)(rec->t[to] - rec->t[from]);
+}
+
+obd_result_t obd_trace_init(obd_trace_t *trace, obd_trace_record_t *records,
+                            size_t record_cap)
+{
+    if (!trace) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(trace, 0, sizeof(*trace));
+    if (records && record_cap > 0) {
+        trace->records = records;
+        trace->record_cap = record_cap;
+    }
+    return OBD_OK;
+}
+
+static obd_trace_key_t *find_key(obd_trace_t *trace, uint8_t mode, uint8_t pid,
+                                 uint16_t ecu, int create)
+{
+    size_t i;
+    obd_trace_key_t *key;
+
+    for (i = 0; i < trace->key_count; i++) {
+        key = &trace->keys[i];
+        if (key->mode == mode && key->pid == pid && key->ecu == ecu) {
+            return key;
+        }
+    }
+    if (!create || trace->key_count >= OBD_TRACE_MAX_KEYS) {
+        return NULL;
+    }
+
+    key = &trace->keys[trace->key_count++];
+    memset(key, 0, sizeof(*key));
+    key->mode = mode;
+    key->pid = pid;
+    key->ecu = ecu;
+    return key;
+}
+
+obd_result_t obd_trace_add(obd_trace_t *trace, const obd_trace_record_t *rec)
+{
+    obd_trace_key_t *key;
+    size_t phase;
+
+    if (!trace || !rec) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    /* Keep the raw record for the Chrome export (oldest gets overwritten) */
+    if (trace->record_cap > 0) {
+        trace->records[trace->record_next] = *rec;
+        trace->record_next = (trace->record_next + 1) % trace->record_cap;
+    }
+    trace->record_total++;
+
+    key = find_key(trace, rec->mode, rec->pid, rec->ecu, 1);
+    if (!key) {
+        trace->untracked++;
+        return OBD_OK;
+    }
+
+    key->count++;
+    if (rec->result != OBD_OK) key->errors++;
+    if (rec->result == OBD_ERROR_TIMEOUT) key->timeouts++;
+
+    for (phase = 0; phase < OBD_PHASE_COUNT; phase++) {
+        int64_t d = phase_us(rec, phase);
+        uint32_t us;
+        if (d < 0) continue;
+
+        us = d > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)d;
+        key->sum_us[phase] += us;
+        if (us > key->max_us[phase]) key->max_us[phase] = us;
+        key->hist[phase][obd_hist_bucket(us, OBD_TRACE_HIST_BUCKETS)]++;
+    }
+    return OBD_OK;
+}
+
+const obd_trace_key_t *obd_trace_find(const obd_trace_t *trace, uint8_t mode,
+                                      uint8_t pid, uint16_t ecu)
+{
+    if (!trace) return NULL;
+    /* find_key only writes when create=1 */
+    return find_key((obd_trace_t *)trace, mode, pid, ecu, 0);
+}
+
+/* Number of requests that had this phase at all */
+static uint32_t phase_samples(const obd_trace_key_t *key, size_t phase)
+{
+    uint32_t n = 0;
+    size_t i;
+    for (i = 0; i < OBD_TRACE_HIST_BUCKETS; i++) n += key->hist[phase][i];
+    return n;
+}
+
+double obd_trace_quantile_us(const obd_trace_key_t *key, obd_trace_phase_t phase,
+                             double quantile)
+{
+    uint32_t n, target, seen = 0;
+    size_t i;
+
+    if (!key || (unsigned)phase >= OBD_PHASE_COUNT) return 0.0;
+    n = phase_samples(key, phase);
+    if (n == 0) return 0.0;
+
+    if (quantile < 0.0) quantile = 0.0;
+    if (quantile > 1.0) quantile = 1.0;
+    target = (uint32_t)(quantile * (double)n + 0.5);
+    if (target == 0) target = 1;
+
+    /* Same walk as obd_stats_quantile_ns: upper edge of the bucket that
+     * crosses the target, capped at the real maximum. */
+    for (i = 0; i < OBD_TRACE_HIST_BUCKETS; i++) {
+        seen += key->hist[phase][i];
+        if (seen >= target) {
+            uint64_t upper = obd_hist_upper(i, OBD_TRACE_HIST_BUCKETS);
+            if (upper > key->max_us[phase]) upper = key->max_us[phase];
+            return (double)upper;
+        }
+    }
+    return (double)key->max_us[phase];
+}
+
+
+/* ── Text summary ────────────────────────────────────────────────────────
+ *
+ *   01 0C ecu 7E8   count 120  errors 0  timeouts 0
+ *     phase         mean ms    p50 ms    p99 ms    max ms
+ *     queue           0.004     0.004     0.008     0.011
+ *     ...
+ */
+obd_result_t obd_trace_format_text(const obd_trace_t *trace,
+                                   char *out, size_t out_size)
+{
+    appender_t a;
+    size_t k, phase;
+
+    if (!trace || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    appender_init(&a, out, out_size);
+
+    for (k = 0; k < trace->key_count; k++) {
+        const obd_trace_key_t *key = &trace->keys[k];
+
+        if (key->mode != 0) {
+            append(&a, "%02X %02X", (unsigned)key->mode, (unsigned)key->pid);
+        } else {
+            append(&a, "AT   ");
+        }
+        append(&a, " ecu %03X   count %u  errors %u  timeouts %u\n",
+               (unsigned)key->ecu,
+               (unsigned)key->count, (unsigned)key->errors, (unsigned)key->timeouts);
+        append(&a, "  %-10s %9s %9s %9s %9s\n",
+               "phase", "mean ms", "p50 ms", "p99 ms", "max ms");
+
+        for (phase = 0; phase < OBD_PHASE_COUNT; phase++) {
+            uint32_t n = phase_samples(key, phase);
+            if (n == 0) continue;
+            append(&a, "  %-10s %9.3f %9.3f %9.3f %9.3f\n", phase_names[phase],
+                   (double)key->sum_us[phase] / (double)n / 1000.0,
+                   obd_trace_quantile_us(key, (obd_trace_phase_t)phase, 0.50) / 1000.0,
+                   obd_trace_quantile_us(key, (obd_trace_phase_t)phase, 0.99) / 1000.0,
+                   (double)key->max_us[phase] / 1000.0);
+        }
+    }
+    if (trace->untracked > 0) {
+        append(&a, "(%u requests not aggregated: more than %d distinct PIDs)\n",
+               (unsigned)trace->untracked, OBD_TRACE_MAX_KEYS);
+    }
+    return appender_finish(&a);
+}
+
+
+/* ── Chrome trace-event export ───────────────────────────────────────────
+ *
+ * Format reference: the "Trace Event Format" doc from the Chromium
+ * project. We only need "complete" events (ph "X"): a name, a start
+ * time `ts` and a duration `dur`, both in µs. Events with the same
+ * pid/tid stack into one row, and shorter events nested inside a longer
+ * one draw underneath it — so each request shows as a bar with its
+ * phases beneath.
+ */
+obd_result_t obd_trace_format_chrome(const obd_trace_t *trace,
+                                     char *out, size_t out_size)
+{
+    appender_t a;
+    size_t n, i, first, phase;
+    int first_event = 1;
+
+    if (!trace || !out || out_size == 0) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    appender_init(&a, out, out_size);
+
+    /* Oldest record first: once the ring wrapped, that's record_next */
+    if (trace->record_total < trace->record_cap) {
+        n = (size_t)trace->record_total;
+        first = 0;
+    } else {
+        n = trace->record_cap;
+        first = trace->record_next;
+    }
+
+    append(&a, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+    for (i = 0; i < n; i++) {
+        const obd_trace_record_t *rec = &trace->records[(first + i) % trace->record_cap];
+        int64_t total = phase_us(rec, OBD_PHASE_TOTAL);
+        char name[16];
+
+        if (total < 0) continue;
+        if (rec->mode != 0) {
+            snprintf(name, sizeof(name), "%02X %02X", (unsigned)rec->mode, (unsigned)rec->pid);
+        } else {
+            snprintf(name, sizeof(name), "AT");
+        }
+
+        append(&a, "%s\n{\"name\": \"%s\", \"cat\": \"request\", \"ph\": \"X\", "
+                   "\"ts\": %llu, \"dur\": %lld, \"pid\": 1, \"tid\": %u, "
+                   "\"args\": {\"id\": %u, \"ecu\": \"%03X\", \"result\": %d}}",
+               first_event ? "" : ",", name,
+               (unsigned long long)rec->t[OBD_TRACE_ENQUEUE], (long long)total,
+               (unsigned)rec->track, (unsigned)rec->id, (unsigned)rec->ecu, (int)rec->result);
+        first_event = 0;
+
+        for (phase = 0; phase < OBD_PHASE_TOTAL; phase++) {
+            int64_t d = phase_us(rec, phase);
+            if (d < 0) continue;
+            append(&a, ",\n{\"name\": \"%s\", \"cat\": \"phase\", \"ph\": \"X\", "
+                       "\"ts\": %llu, \"dur\": %lld, \"pid\": 1, \"tid\": %u}",
+                   phase_names[phase],
+                   (unsigned long long)rec->t[phase_from[phase]], (long long)d,
+                   (unsigned)rec->track);
+        }
+    }
+
+    append(&a, "\n]}\n");
+    return appender_finish(&a);
+}
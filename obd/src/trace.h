@@ -0,0 +1,10 @@
+/**
+ * trace.h — Internal header for round-trip tracing.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <obd/obd_types.h>
+
+#endif /* TRACE_H */
@@ -0,0 +1,353 @@
+/**
+ * trip.c — Trip segmentation: engine on/off, idling and gaps, as samples
+ * arrive.
+ *
+ * Samples of RPM, speed, run time and voltage each vote "running", "not
+ * running" or nothing (see obd_trip_t). The votes drive a small state
+ * machine:
+ *
+ *   OFF ──running──▶ ON ──not running──▶ STOPPING ──end_after_us──▶ OFF
+ *                    ▲                       │
+ *                    └───────running─────────┘
+ *
+ * Whatever the state, a trip also ends when no sample has come for
+ * gap_us (the adapter dropped out, the phone slept) or when run time
+ * since start goes backwards (the engine restarted between two polls).
+ *
+ * A trip that ends because the engine stopped ends at the first "off"
+ * sample, not when end_after_us ran out. One that ends for a gap ends at
+ * the last sample before it. Either way end_pos is the sample it ended
+ * at, so [start_pos, end_pos] is the trip in the log.
+ *
+ * Everything is kept in obd_trip_t and nothing is shared, so any number
+ * of segmenters can run at once, one per archive or per thread.
+ */
+
+#include "trip.h"
+#include <obd/obd.h>
+#include <string.h>
+
+enum { VOTE_NONE, VOTE_OFF, VOTE_ON };
+
+obd_result_t obd_trip_init(obd_trip_t *trip)
+{
+    if (!trip) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    memset(trip, 0, sizeof(*trip));
+    trip->rpm_on = 300.0f;
+    trip->charging_v = 13.2f;
+    trip->idle_speed = 1.0f;
+    trip->end_after_us = 60000000u;
+    trip->gap_us = 30000000u;
+    trip->idle_after_us = 10000000u;
+    return OBD_OK;
+}
+
+/* Queue an event; a full ring loses its oldest */
+static void emit_event(obd_trip_t *t, uint8_t kind, uint64_t t_us)
+{
+    obd_trip_event_t *ev;
+
+    if (t->event_count == OBD_TRIP_EVENTS) {
+        t->event_head = (t->event_head + 1) % OBD_TRIP_EVENTS;
+        t->event_count--;
+        t->events_lost++;
+    }
+    ev = &t->events[(t->event_head + t->event_count++) % OBD_TRIP_EVENTS];
+    ev->kind = kind;
+    ev->t_us = t_us;
+    ev->trip = t->current;
+}
+
+static void start_trip(obd_trip_t *t, uint64_t t_us, uint64_t pos, int open_start)
+{
+    obd_trip_summary_t *s = &t->current;
+
+    memset(s, 0, sizeof(*s));
+    s->number = ++t->trips;
+    s->flags = open_start ? OBD_TRIP_OPEN_START : 0;
+    s->start_us = s->end_us = t_us;
+    s->start_pos = s->end_pos = pos;
+    t->state = OBD_TRIP_ON;
+    t->idle = 0;
+    emit_event(t, OBD_TRIP_EVENT_START, t_us);
+}
+
+/* An idle period that has lasted idle_after_us by at_us counts */
+static void check_idle(obd_trip_t *t, uint64_t at_us)
+{
+    if (!t->idle || t->idle_counted || at_us < t->idle_since_us ||
+        at_us - t->idle_since_us < t->idle_after_us) {
+        return;
+    }
+    t->idle_counted = 1;
+    t->current.idle_periods++;
+    emit_event(t, OBD_TRIP_EVENT_IDLE, t->idle_since_us + t->idle_after_us);
+}
+
+/* Close an idle period at at_us, adding it up if it counted */
+static void end_idle(obd_trip_t *t, uint64_t at_us)
+{
+    check_idle(t, at_us);
+    if (t->idle && t->idle_counted && at_us > t->idle_since_us) {
+        t->current.idle_us += at_us - t->idle_since_us;
+    }
+    t->idle = 0;
+}
+
+static void end_trip(obd_trip_t *t, uint8_t reason, uint64_t t_us, uint64_t pos)
+{
+    obd_trip_summary_t *s = &t->current;
+
+    end_idle(t, t_us);
+    s->end_reason = reason;
+    s->end_us = t_us;
+    s->end_pos = pos;
+    t->state = OBD_TRIP_OFF;
+    emit_event(t, OBD_TRIP_EVENT_END, t_us);
+}
+
+/* Add a sample to the trip going on */
+static void account(obd_trip_t *t, uint16_t channel, float value, uint64_t t_us, uint64_t pos)
+{
+    obd_trip_summary_t *s = &t->current;
+
+    s->samples++;
+    if (t->state == OBD_TRIP_ON) {
+        s->end_us = t_us;
+        s->end_pos = pos;
+    }
+    switch (channel) {
+    case OBD_TRIP_RPM:
+        if (value > s->max_rpm) s->max_rpm = value;
+        break;
+    case OBD_TRIP_SPEED:
+        if (value > s->max_speed) s->max_speed = value;
+        if (t->have_speed && t->speed_t_us >= s->start_us) {
+            double hours = (double)(t_us - t->speed_t_us) / 3.6e9;
+            s->distance_km += (float)((t->speed + value) * 0.5 * hours);
+        }
+        if (t->state != OBD_TRIP_ON) {
+            break;                              /* Engine off isn't idling */
+        }
+        if (value < t->idle_speed) {
+            if (!t->idle) {
+                t->idle = 1;
+                t->idle_counted = 0;
+                t->idle_since_us = t_us;
+            }
+        } else {
+            end_idle(t, t_us);
+        }
+        break;
+    case OBD_TRIP_VOLTAGE:
+        if (s->max_voltage == 0.0f || value < s->min_voltage) s->min_voltage = value;
+        if (value > s->max_voltage) s->max_voltage = value;
+        break;
+    case OBD_TRIP_RUN_TIME:
+        if (value > 0.0f) s->run_time_s = value;
+        break;
+    default:
+        break;
+    }
+    check_idle(t, t_us);
+}
+
+obd_result_t obd_trip_feed(obd_trip_t *trip, uint16_t channel, float value, uint64_t t_us,
+                           uint64_t pos)
+{
+    int vote = VOTE_NONE, restart = 0;
+
+    if (!trip) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (trip->have_last && t_us < trip->last_t_us) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+
+    if (trip->state != OBD_TRIP_OFF && t_us - trip->last_t_us >= trip->gap_us) {
+        if (trip->state == OBD_TRIP_STOPPING) {
+            end_trip(trip, OBD_TRIP_END_ENGINE_OFF, trip->off_since_us, trip->off_pos);
+        } else {
+            end_trip(trip, OBD_TRIP_END_GAP, trip->last_t_us, trip->last_pos);
+        }
+    }
+
+    switch (channel) {
+    case OBD_TRIP_RPM:
+        vote = value >= trip->rpm_on ? VOTE_ON : VOTE_OFF;
+        trip->have_rpm = 1;
+        trip->rpm_t_us = t_us;
+        break;
+    case OBD_TRIP_SPEED:
+        if (value >= trip->idle_speed) vote = VOTE_ON;
+        break;
+    case OBD_TRIP_RUN_TIME:
+        if (trip->have_run_time && value > 0.0f && value < trip->run_time) {
+            restart = 1;
+        }
+        if (value <= 0.0f) {
+            vote = VOTE_OFF;
+        } else if (!trip->have_run_time || value != trip->run_time) {
+            vote = VOTE_ON;                     /* Counting, or just seen counting */
+        }
+        break;
+    case OBD_TRIP_VOLTAGE:
+        if (!trip->have_rpm || t_us - trip->rpm_t_us >= trip->gap_us) {
+            vote = value >= trip->charging_v ? VOTE_ON : VOTE_OFF;
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (restart && trip->state != OBD_TRIP_OFF) {
+        end_trip(trip, OBD_TRIP_END_RESTART, trip->last_t_us, trip->last_pos);
+    }
+
+    switch (trip->state) {
+    case OBD_TRIP_OFF:
+        if (vote == VOTE_ON) start_trip(trip, t_us, pos, !trip->voted);
+        break;
+    case OBD_TRIP_ON:
+        if (vote == VOTE_OFF) {
+            end_idle(trip, t_us);
+            trip->state = OBD_TRIP_STOPPING;
+            trip->off_since_us = t_us;
+            trip->off_pos = pos;
+        }
+        break;
+    default:                                    /* STOPPING */
+        if (vote == VOTE_ON) trip->state = OBD_TRIP_ON;
+        break;
+    }
+    if (vote != VOTE_NONE) trip->voted = 1;
+
+    if (trip->state != OBD_TRIP_OFF) {
+        account(trip, channel, value, t_us, pos);
+    }
+    if (trip->state == OBD_TRIP_STOPPING &&
+        t_us - trip->off_since_us >= trip->end_after_us) {
+        end_trip(trip, OBD_TRIP_END_ENGINE_OFF, trip->off_since_us, trip->off_pos);
+    }
+
+    if (channel == OBD_TRIP_SPEED) {
+        trip->have_speed = 1;
+        trip->speed = value;
+        trip->speed_t_us = t_us;
+    } else if (channel == OBD_TRIP_RUN_TIME) {
+        trip->have_run_time = 1;
+        trip->run_time = value;
+    }
+    trip->have_last = 1;
+    trip->last_t_us = t_us;
+    trip->last_pos = pos;
+    return OBD_OK;
+}
+
+obd_result_t obd_trip_feed_sensor(obd_trip_t *trip, const obd_sensor_value_t *value,
+                                  uint64_t t_us, uint64_t pos)
+{
+    if (!value) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    return obd_trip_feed(trip, value->pid, value->value, t_us, pos);
+}
+
+obd_result_t obd_trip_feed_batch(obd_trip_t *trip, const uint16_t *channels,
+                                 const float *values, const uint64_t *t_us,
+                                 uint64_t first_pos, size_t n)
+{
+    obd_result_t result;
+    size_t i;
+
+    if (!trip || (n > 0 && (!channels || !values || !t_us))) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    for (i = 0; i < n; i++) {
+        result = obd_trip_feed(trip, channels[i], values[i], t_us[i], first_pos + i);
+        if (result != OBD_OK) {
+            return result;
+        }
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_trip_tick(obd_trip_t *trip, uint64_t now_us)
+{
+    if (!trip) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (trip->state == OBD_TRIP_OFF || now_us < trip->last_t_us) {
+        return OBD_OK;
+    }
+    /* Nothing new came in, so the engine is as it was */
+    if (trip->state == OBD_TRIP_STOPPING) {
+        if (now_us - trip->off_since_us >= trip->end_after_us ||
+            now_us - trip->last_t_us >= trip->gap_us) {
+            end_trip(trip, OBD_TRIP_END_ENGINE_OFF, trip->off_since_us, trip->off_pos);
+        }
+    } else if (now_us - trip->last_t_us >= trip->gap_us) {
+        end_trip(trip, OBD_TRIP_END_GAP, trip->last_t_us, trip->last_pos);
+    } else {
+        check_idle(trip, now_us);
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_trip_flush(obd_trip_t *trip)
+{
+    if (!trip) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (trip->state == OBD_TRIP_STOPPING) {
+        end_trip(trip, OBD_TRIP_END_ENGINE_OFF, trip->off_since_us, trip->off_pos);
+    } else if (trip->state == OBD_TRIP_ON) {
+        end_trip(trip, OBD_TRIP_END_FLUSH, trip->last_t_us, trip->last_pos);
+    }
+    return OBD_OK;
+}
+
+obd_result_t obd_trip_poll(obd_trip_t *trip, obd_trip_event_t *event)
+{
+    if (!trip || !event) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (trip->event_count == 0) {
+        return OBD_ERROR_NO_DATA;
+    }
+    *event = trip->events[trip->event_head];
+    trip->event_head = (trip->event_head + 1) % OBD_TRIP_EVENTS;
+    trip->event_count--;
+    return OBD_OK;
+}
+
+obd_result_t obd_trip_join(obd_trip_summary_t *a, const obd_trip_summary_t *b,
+                           uint64_t gap_us)
+{
+    if (!a || !b) {
+        return OBD_ERROR_INVALID_ARG;
+    }
+    if (a->end_reason != OBD_TRIP_END_FLUSH || !(b->flags & OBD_TRIP_OPEN_START) ||
+        b->start_us < a->end_us || b->start_us - a->end_us >= gap_us) {
+        return OBD_ERROR_NO_DATA;
+    }
+    a->end_reason = b->end_reason;
+    a->end_us = b->end_us;
+    a->end_pos = b->end_pos;
+    a->idle_us += b->idle_us;
+    a->idle_periods += b->idle_periods;
+    a->samples += b->samples;
+    a->distance_km += b->distance_km;
+    if (b->max_speed > a->max_speed) a->max_speed = b->max_speed;
+    if (b->max_rpm > a->max_rpm) a->max_rpm = b->max_rpm;
+    if (b->max_voltage > 0.0f) {
+        if (a->max_voltage == 0.0f || b->min_voltage < a->min_voltage) {
+            a->min_voltage = b->min_voltage;
+        }
+        if (b->max_voltage > a->max_voltage) a->max_voltage = b->max_voltage;
+    }
+    if (b->run_time_s > 0.0f) a->run_time_s = b->run_time_s;
+    return OBD_OK;
+}
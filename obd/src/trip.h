@@ -0,0 +1,10 @@
+/**
+ * trip.h — Internal header for the trip segmenter.
+ */
+
+#ifndef TRIP_H
+#define TRIP_H
+
+#include <obd/obd_types.h>
+
+#endif /* TRIP_H */
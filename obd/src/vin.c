@@ -30,6 +30,7 @@
 
 #include "vin.h"
 #include "hex_utils.h"
+#include "stats.h"
 #include <obd/obd.h>
 #include <string.h>
 
@@ -66,8 +67,8 @@ obd_result_t obd_vin_build_request(char *out, size_t out_size)
  *   5. Append remaining bytes as ASCII characters to the VIN string
  *   6. Stop at 17 characters (ignore null padding bytes)
  */
-obd_result_t obd_vin_parse_response(const char *response,
-                                    char *vin, size_t vin_size)
+static obd_result_t vin_parse_response(const char *response,
+                                       char *vin, size_t vin_size)
 {
     size_t vin_pos;
     const char *line_start;
@@ -151,3 +152,13 @@ obd_result_t obd_vin_parse_response(const char *response,
 
     return OBD_OK;
 }
+
+obd_result_t obd_vin_parse_response(const char *response,
+                                    char *vin, size_t vin_size)
+{
+    obd_result_t r;
+    OBD_STATS_BEGIN();
+    r = vin_parse_response(response, vin, vin_size);
+    OBD_STATS_END(OBD_STAT_VIN_PARSE, r);
+    return r;
+}
@@ -0,0 +1,312 @@
+/**
+ * test_async.cpp — Tests for the C++20 coroutine layer (obd_async.hpp).
+ *
+ * Same setup as test_fleet.c: each vehicle is an emulator at the far
+ * end of a socketpair, served between executor steps. Coroutines can't
+ * TEST_ASSERT (they don't return int), so they write down what they saw
+ * and the test functions check it afterwards.
+ */
+
+#include <obd/obd_async.hpp>
+#include "test_assert.h"
+#include "test_data.h"
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define VEHICLES 200                    /* Enough to make pooling matter */
+
+static obd::executor *ex;
+static obd::vehicle cars[VEHICLES];
+static obd_emu_t emus[VEHICLES];
+static int near_end[VEHICLES], far_end[VEHICLES];
+static int answering[VEHICLES];
+static size_t vehicle_count;
+
+static void serve_emulators()
+{
+    char in[256], out[2048];
+    ssize_t n;
+
+    for (size_t i = 0; i < vehicle_count; i++) {
+        if (far_end[i] < 0) continue;
+        while ((n = read(far_end[i], in, sizeof(in))) > 0) {
+            if (!answering[i]) continue;
+            size_t n_out = 0;
+            obd_emu_feed(&emus[i], in, (size_t)n, out, sizeof(out), &n_out);
+            if (write(far_end[i], out, n_out) != (ssize_t)n_out) return;
+        }
+    }
+}
+
+/* Step until every spawned task is done (or a second has passed) */
+static void drive()
+{
+    uint64_t start = obd_io_now_us();
+    while (ex->live_tasks() > 0 && obd_io_now_us() - start < 1000000u) {
+        ex->step(1);
+        serve_emulators();
+    }
+}
+
+static void teardown()
+{
+    if (ex) {
+        ex->close();
+        delete ex;
+        ex = nullptr;
+    }
+    for (size_t i = 0; i < vehicle_count; i++) {
+        if (near_end[i] >= 0) close(near_end[i]);
+        if (far_end[i] >= 0) close(far_end[i]);
+    }
+    vehicle_count = 0;
+}
+
+static int setup(size_t count, obd_fleet_backend_t backend)
+{
+    teardown();
+    ex = new obd::executor;
+    if (ex->open(count, backend) != OBD_OK) return 0;
+    for (size_t i = 0; i < count; i++) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) < 0) return 0;
+        near_end[i] = sv[0];
+        far_end[i] = sv[1];
+        obd_emu_init(&emus[i]);
+        emus[i].echo = 0;               /* As if ATE0 had been sent */
+        answering[i] = 1;
+        vehicle_count = i + 1;
+        if (ex->add(near_end[i], &cars[i]) != OBD_OK) return 0;
+    }
+    return 1;
+}
+
+
+/* ── Test: query, DTCs and VIN, one task per vehicle ───────────────── */
+
+static obd_session_result_t seen_rpm[VEHICLES];
+static obd::dtc_result seen_dtcs[VEHICLES];
+static obd::vin_result seen_vin[VEHICLES];
+
+static obd::task<> check(obd::vehicle car)
+{
+    size_t i = car.index();
+    seen_rpm[i] = co_await car.query(0x0C);
+    seen_dtcs[i] = co_await car.read_dtcs();
+    seen_vin[i] = co_await car.read_vin();
+}
+
+static int round_trip(obd_fleet_backend_t backend)
+{
+    static const uint16_t codes[] = { 0x0301, 0x0420 };
+
+    TEST_ASSERT(setup(4, backend), "four vehicles");
+    obd_emu_set_dtcs(&emus[2], codes, 2);
+
+    for (size_t i = 0; i < 4; i++) ex->spawn(check(cars[i]));
+    TEST_ASSERT(ex->live_tasks() == 4, "all running");
+    drive();
+    TEST_ASSERT(ex->live_tasks() == 0, "all finished");
+
+    for (size_t i = 0; i < 4; i++) {
+        TEST_ASSERT(seen_rpm[i].status == OBD_OK && seen_rpm[i].has_value &&
+                    seen_rpm[i].value.value == TEST_EXPECTED_RPM, "RPM");
+        TEST_ASSERT(seen_dtcs[i].status == OBD_OK, "DTCs read");
+        TEST_ASSERT(seen_vin[i].status == OBD_OK &&
+                    strcmp(seen_vin[i].vin, TEST_EXPECTED_VIN) == 0, "VIN");
+    }
+    TEST_ASSERT(seen_dtcs[0].dtcs.count == 0, "no codes on a healthy car");
+    TEST_ASSERT(seen_dtcs[2].dtcs.count == 2 &&
+                strcmp(seen_dtcs[2].dtcs.dtcs[0].formatted, "P0301") == 0 &&
+                strcmp(seen_dtcs[2].dtcs.dtcs[1].formatted, "P0420") == 0, "P0301, P0420");
+
+    printf("  PASS: query / read_dtcs / read_vin, %s\n", obd_fleet_backend_name(ex->backend()));
+    return 0;
+}
+
+static int test_round_trip()
+{
+    return round_trip(OBD_FLEET_EPOLL) + round_trip(OBD_FLEET_URING);
+}
+
+
+/* ── Test: many vehicles, nested tasks, frames reused ──────────────── */
+
+static size_t good[VEHICLES];
+
+static obd::task<float> read_value(obd::vehicle car, uint8_t pid)
+{
+    obd_session_result_t r = co_await car.query(pid);
+    co_return r.status == OBD_OK && r.has_value ? r.value.value : -1.0f;
+}
+
+static obd::task<> poll_car(obd::vehicle car)
+{
+    static const uint8_t pids[] = { 0x0C, 0x0D, 0x05, 0x0C, 0x0D };
+    static const float want[] = { TEST_EXPECTED_RPM, TEST_EXPECTED_SPEED,
+                                  TEST_EXPECTED_COOLANT, TEST_EXPECTED_RPM,
+                                  TEST_EXPECTED_SPEED };
+
+    for (size_t k = 0; k < sizeof(pids); k++) {
+        if (co_await read_value(car, pids[k]) == want[k]) good[car.index()]++;
+    }
+}
+
+static int test_many_vehicles()
+{
+    size_t before;
+
+    TEST_ASSERT(setup(VEHICLES, OBD_FLEET_EPOLL), "200 vehicles");
+    memset(good, 0, sizeof(good));
+
+    for (size_t i = 0; i < VEHICLES; i++) ex->spawn(poll_car(cars[i]));
+    drive();
+    TEST_ASSERT(ex->live_tasks() == 0, "first round done");
+
+    /* Second round: every frame comes back out of the pool */
+    before = obd::detail::frame_pool::system_allocations();
+    for (size_t i = 0; i < VEHICLES; i++) ex->spawn(poll_car(cars[i]));
+    drive();
+    TEST_ASSERT(ex->live_tasks() == 0, "second round done");
+    TEST_ASSERT(obd::detail::frame_pool::system_allocations() == before,
+                "no frame allocated from the heap the second time");
+
+    for (size_t i = 0; i < VEHICLES; i++) {
+        TEST_ASSERT(good[i] == 10, "ten right answers each");
+    }
+
+    printf("  PASS: 200 vehicles, 2000 awaits, pooled frames\n");
+    return 0;
+}
+
+
+/* ── Test: timeouts and cancellation ───────────────────────────────── */
+
+static obd_session_result_t seen[4];
+static uint64_t took_us;
+
+static obd::task<> timed(obd::vehicle car)
+{
+    uint64_t start = obd_io_now_us();
+    seen[0] = co_await car.query(0x0C, obd::options{.timeout_us = 20000});
+    took_us = obd_io_now_us() - start;
+}
+
+static obd::task<> stoppable(obd::vehicle car, size_t slot, std::stop_token stop)
+{
+    seen[slot] = co_await car.query(0x0C, {0, &stop});
+}
+
+static obd::task<> stopper(std::stop_source *a, std::stop_source *b)
+{
+    co_await ex->sleep_for(5000);
+    b->request_stop();                  /* Still queued behind a */
+    co_await ex->sleep_for(5000);
+    a->request_stop();                  /* On the wire */
+}
+
+static int test_timeout_and_cancel()
+{
+    std::stop_source a, b, already;
+
+    TEST_ASSERT(setup(2, OBD_FLEET_EPOLL), "setup");
+    answering[0] = 0;
+    answering[1] = 0;
+    obd_session_set_timeout(cars[1].session(), 100000);
+
+    /* A timeout well under the session's own (1 s) */
+    ex->spawn(timed(cars[0]));
+    drive();
+    TEST_ASSERT(seen[0].status == OBD_ERROR_TIMEOUT, "timed out");
+    TEST_ASSERT(took_us >= 20000 && took_us < 500000, "after 20 ms, not the session's 1 s");
+
+    /* Queued, then in flight, both withdrawn */
+    ex->spawn(stoppable(cars[1], 1, a.get_token()));
+    ex->spawn(stoppable(cars[1], 2, b.get_token()));
+    ex->spawn(stopper(&a, &b));
+    drive();
+    TEST_ASSERT(seen[2].status == OBD_ERROR_CANCELLED, "queued one cancelled");
+    TEST_ASSERT(seen[1].status == OBD_ERROR_CANCELLED, "in-flight one cancelled");
+
+    /* Stopped before it starts: never submitted */
+    already.request_stop();
+    ex->spawn(stoppable(cars[1], 3, already.get_token()));
+    TEST_ASSERT(ex->live_tasks() == 0 && seen[3].status == OBD_ERROR_CANCELLED,
+                "finished without waiting");
+
+    /* The car wakes up: after the drain the next request works */
+    answering[1] = 1;
+    ex->spawn(stoppable(cars[1], 3, std::stop_token()));
+    drive();
+    TEST_ASSERT(seen[3].status == OBD_OK && seen[3].value.value == TEST_EXPECTED_RPM,
+                "next request answered");
+
+    printf("  PASS: timeouts and cancellation\n");
+    return 0;
+}
+
+
+/* ── Test: a vehicle that goes away; sleeping ──────────────────────── */
+
+static int lost_count;
+
+static obd::task<> until_lost(obd::vehicle car)
+{
+    seen[0] = co_await car.query(0x0C);
+    seen[1] = co_await car.query(0x0D);
+    lost_count++;
+}
+
+static obd::task<> nap(uint64_t us)
+{
+    uint64_t start = obd_io_now_us();
+    co_await ex->sleep_for(us);
+    took_us = obd_io_now_us() - start;
+}
+
+static int test_lost_and_sleep()
+{
+    TEST_ASSERT(setup(1, OBD_FLEET_URING), "setup");
+    answering[0] = 0;
+    lost_count = 0;
+
+    ex->spawn(until_lost(cars[0]));
+    ex->step(0);
+    close(far_end[0]);
+    far_end[0] = -1;
+    drive();
+    TEST_ASSERT(lost_count == 1, "task ran to the end");
+    TEST_ASSERT(seen[0].status == OBD_ERROR_IO, "waiting request failed");
+    TEST_ASSERT(seen[1].status == OBD_ERROR_IO, "and the next one at once");
+
+    ex->spawn(nap(15000));
+    drive();
+    TEST_ASSERT(took_us >= 15000, "slept 15 ms");
+
+    /* Closing with a task still waiting destroys it cleanly */
+    ex->spawn(nap(10000000));
+    TEST_ASSERT(ex->live_tasks() == 1, "sleeping");
+    ex->close();
+    TEST_ASSERT(ex->live_tasks() == 0, "destroyed");
+
+    printf("  PASS: lost vehicle, sleep_for, close\n");
+    return 0;
+}
+
+int main()
+{
+    int failures = 0;
+
+    printf("=== async tests ===\n");
+    failures += test_round_trip();
+    failures += test_many_vehicles();
+    failures += test_timeout_and_cancel();
+    failures += test_lost_and_sleep();
+    teardown();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
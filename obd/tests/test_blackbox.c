@@ -0,0 +1,302 @@
+/**
+ * test_blackbox.c — Tests for the black-box recorder.
+ *
+ * Ring and window files go in /tmp, named after the pid, and are removed
+ * at the end. A "crash" is a close without a sync: the mapping goes away
+ * and whatever reached the pages is what the next open finds.
+ */
+
+#include <obd/obd_io.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define MS 1000u
+
+static obd_blackbox_t bb;
+static char ring_path[64];
+static char window_path[64];
+
+/* What a walk saw */
+static struct {
+    size_t   count;
+    uint64_t first_seq;
+    uint64_t last_seq;
+    int      in_order;
+    uint64_t min_t;
+    uint64_t max_t;
+    size_t   marks;
+    size_t   samples;
+    size_t   bytes;
+    char     last[OBD_BLACKBOX_PAYLOAD];
+    size_t   last_len;
+} seen;
+
+static void reset_seen(void)
+{
+    memset(&seen, 0, sizeof(seen));
+    seen.in_order = 1;
+    seen.min_t = UINT64_MAX;
+}
+
+static void on_record(void *ctx, const obd_blackbox_record_t *rec)
+{
+    (void)ctx;
+    if (seen.count > 0 && rec->seq <= seen.last_seq) seen.in_order = 0;
+    if (seen.count == 0) seen.first_seq = rec->seq;
+    seen.last_seq = rec->seq;
+    seen.count++;
+    if (rec->t_us < seen.min_t) seen.min_t = rec->t_us;
+    if (rec->t_us > seen.max_t) seen.max_t = rec->t_us;
+    if (rec->type == OBD_BLACKBOX_MARK) seen.marks++;
+    if (rec->type == OBD_BLACKBOX_SAMPLE) seen.samples++;
+    seen.bytes += rec->len;
+    if (rec->data) {
+        memcpy(seen.last, rec->data, rec->len);
+        seen.last_len = rec->len;
+    }
+}
+
+/* Traffic record i: 100 bytes that say which one it is */
+static void capture(size_t i, uint64_t t_us)
+{
+    char line[100];
+    memset(line, '.', sizeof(line));
+    snprintf(line, sizeof(line), "record %zu", i);
+    obd_blackbox_capture(&bb, OBD_CAPTURE_RX, line, sizeof(line), t_us);
+}
+
+/* ── Test: the ring keeps the newest records, in order ─────────────── */
+static int test_ring(void)
+{
+    static char big[2500];
+    size_t i;
+
+    unlink(ring_path);
+    TEST_ASSERT(obd_blackbox_open(&bb, ring_path, 1000) == OBD_ERROR_INVALID_ARG,
+                "ring too small");
+    TEST_ASSERT(access(ring_path, F_OK) != 0, "no file left behind");
+    TEST_ASSERT(obd_blackbox_open(&bb, ring_path, OBD_BLACKBOX_MIN_SIZE + 3) == OBD_OK,
+                "open");
+    TEST_ASSERT(bb.capacity == OBD_BLACKBOX_MIN_SIZE && bb.recovered == 0, "new ring");
+
+    for (i = 0; i < 1000; i++) capture(i, i * MS);
+    TEST_ASSERT(bb.records == 1000 && bb.used <= bb.capacity, "appended");
+    reset_seen();
+    obd_blackbox_walk(&bb, on_record, NULL);
+    TEST_ASSERT(seen.in_order && seen.last_seq == 1000 &&
+                seen.first_seq == 1001 - seen.count, "oldest first, no gaps");
+    TEST_ASSERT(seen.count > 100 && seen.count + bb.overwritten == 1000, "newest kept");
+    TEST_ASSERT(seen.min_t == (1000 - seen.count) * MS, "the oldest ones went");
+    TEST_ASSERT(strncmp(seen.last, "record 999", 10) == 0, "last record intact");
+
+    /* Longer than a record holds: split, nothing lost */
+    memset(big, 'x', sizeof(big));
+    obd_blackbox_capture(&bb, OBD_CAPTURE_TX, big, sizeof(big), 2000 * MS);
+    TEST_ASSERT(bb.records == 1003, "three records");
+    reset_seen();
+    obd_blackbox_walk(&bb, on_record, NULL);
+    TEST_ASSERT(seen.last_len == sizeof(big) - 2 * OBD_BLACKBOX_PAYLOAD, "the remainder last");
+
+    TEST_ASSERT(obd_blackbox_sample(&bb, 0x0C, 850.0f, 2001 * MS) == OBD_OK, "sample");
+    obd_blackbox_capture(&bb, 7, "x", 1, 0);
+    TEST_ASSERT(bb.records == 1004, "unknown direction ignored");
+    obd_blackbox_close(&bb);
+    TEST_ASSERT(obd_blackbox_sample(&bb, 0x0C, 1.0f, 0) == OBD_ERROR_INVALID_ARG, "closed");
+
+    printf("  PASS: ring\n");
+    return 0;
+}
+
+/* ── Test: a trigger freezes a window, recording goes on ───────────── */
+static int test_trigger(void)
+{
+    obd_blackbox_window_t info;
+    size_t i;
+
+    unlink(ring_path);
+    unlink(window_path);
+    TEST_ASSERT(obd_blackbox_open(&bb, ring_path, 1u << 20) == OBD_OK, "open");
+
+    /* 10 s of traffic every 10 ms; the event is at 5 s */
+    for (i = 0; i < 500; i++) capture(i, i * 10 * MS);
+    TEST_ASSERT(obd_blackbox_trigger(&bb, 5000 * MS, 1000 * MS, 1000 * MS,
+                                     window_path, "P0301") == OBD_OK, "trigger");
+    for (i = 500; i < 550; i++) capture(i, i * 10 * MS);
+    TEST_ASSERT(obd_blackbox_tick(&bb, 5500 * MS) == OBD_OK && bb.windows_written == 0,
+                "not until the post-trigger time has passed");
+    for (i = 550; i < 1000; i++) capture(i, i * 10 * MS);
+    TEST_ASSERT(obd_blackbox_tick(&bb, 6000 * MS) == OBD_OK && bb.windows_written == 1,
+                "written");
+    TEST_ASSERT(bb.window_count == 0, "no longer pending");
+
+    reset_seen();
+    TEST_ASSERT(obd_blackbox_read_file(window_path, &info, on_record, NULL) == OBD_OK,
+                "read the window");
+    TEST_ASSERT(info.trigger_us == 5000 * MS && info.from_us == 4000 * MS &&
+                info.to_us == 6000 * MS && strcmp(info.reason, "P0301") == 0, "header");
+    TEST_ASSERT(seen.count == 202 && info.records == 202, "4.00 s to 6.00 s, and the mark");
+    TEST_ASSERT(seen.min_t == 4000 * MS && seen.max_t == 6000 * MS, "inside the window");
+    TEST_ASSERT(seen.marks == 1 && seen.in_order, "mark included, in order");
+
+    /* The ring carried on */
+    TEST_ASSERT(bb.records == 1001, "recording never stopped");
+
+    for (i = 0; i < OBD_BLACKBOX_TRIGGERS; i++) {
+        obd_blackbox_trigger(&bb, 20000 * MS, 0, 0, window_path, NULL);
+    }
+    TEST_ASSERT(obd_blackbox_trigger(&bb, 20000 * MS, 0, 0, window_path, NULL) ==
+                OBD_ERROR_BUSY, "too many pending");
+    obd_blackbox_tick(&bb, 20000 * MS);
+    TEST_ASSERT(bb.windows_written == 5 && bb.window_count == 0, "all written");
+    TEST_ASSERT(obd_blackbox_trigger(&bb, 0, 0, 0, "/nonexistent/dir/w.bbw", "x") == OBD_OK &&
+                obd_blackbox_tick(&bb, 0) == OBD_ERROR_IO && bb.windows_failed == 1,
+                "unwritable path");
+    TEST_ASSERT(obd_blackbox_read_file(ring_path, NULL, NULL, NULL) ==
+                OBD_ERROR_PARSE_FAILED, "a ring isn't a window");
+
+    /* Killed between the trigger and its tick: the next open re-arms it */
+    unlink(window_path);
+    for (i = 3000; i < 3010; i++) capture(i, i * 10 * MS);
+    TEST_ASSERT(obd_blackbox_trigger(&bb, 30050 * MS, 50 * MS, 30000 * MS,
+                                     window_path, "P0420") == OBD_OK, "trigger");
+    obd_blackbox_close(&bb);
+    TEST_ASSERT(obd_blackbox_open(&bb, ring_path, 0) == OBD_OK, "reopen");
+    TEST_ASSERT(bb.window_count == 1 && bb.windows_recovered == 1 &&
+                strcmp(bb.windows[0].path, window_path) == 0 &&
+                strcmp(bb.windows[0].reason, "P0420") == 0 &&
+                bb.windows[0].from_us == 30000 * MS && bb.windows[0].to_us == 60050 * MS,
+                "the pending window came back");
+    TEST_ASSERT(obd_blackbox_tick(&bb, 60050 * MS) == OBD_OK && bb.windows_written == 1 &&
+                access(window_path, F_OK) == 0, "and is written");
+    reset_seen();
+    TEST_ASSERT(obd_blackbox_read_file(window_path, &info, on_record, NULL) == OBD_OK &&
+                seen.count == 11 && seen.marks == 1, "30.00 s to 30.09 s, and the mark");
+    obd_blackbox_close(&bb);
+    TEST_ASSERT(obd_blackbox_open(&bb, ring_path, 0) == OBD_OK && bb.window_count == 0,
+                "written windows aren't re-armed");
+    obd_blackbox_close(&bb);
+
+    printf("  PASS: trigger\n");
+    return 0;
+}
+
+/* ── Test: reopening after a crash ─────────────────────────────────── */
+static int test_recovery(void)
+{
+    uint64_t first, last;
+    size_t count, i;
+    int fd;
+
+    /* Not wrapped yet */
+    unlink(ring_path);
+    obd_blackbox_open(&bb, ring_path, OBD_BLACKBOX_MIN_SIZE);
+    for (i = 0; i < 50; i++) capture(i, i * MS);
+    obd_blackbox_close(&bb);
+    TEST_ASSERT(obd_blackbox_open(&bb, ring_path, 0) == OBD_OK, "reopen");
+    TEST_ASSERT(bb.recovered == 50 && bb.next_seq == 51, "all 50 back");
+    capture(50, 50 * MS);
+    reset_seen();
+    obd_blackbox_walk(&bb, on_record, NULL);
+    TEST_ASSERT(seen.count == 51 && seen.first_seq == 1 && seen.last_seq == 51 &&
+                seen.in_order, "carries on after them");
+
+    /* Wrapped several times: the same records come back */
+    for (i = 51; i < 5000; i++) capture(i, i * MS);
+    reset_seen();
+    obd_blackbox_walk(&bb, on_record, NULL);
+    first = seen.first_seq;
+    last = seen.last_seq;
+    count = seen.count;
+    obd_blackbox_close(&bb);
+    TEST_ASSERT(obd_blackbox_open(&bb, ring_path, 1u << 20) == OBD_OK, "reopen");
+    TEST_ASSERT(bb.capacity == OBD_BLACKBOX_MIN_SIZE, "the file keeps its size");
+    reset_seen();
+    obd_blackbox_walk(&bb, on_record, NULL);
+    TEST_ASSERT(seen.count == count && bb.recovered == count, "same count");
+    TEST_ASSERT(seen.first_seq == first && seen.last_seq == last, "same records");
+
+    /* The process died halfway through writing the newest record */
+    capture(5000, 5000 * MS);
+    {
+        size_t at = bb.head >= 136 ? bb.head - 136 : bb.capacity - 136;
+        obd_blackbox_close(&bb);
+        fd = open(ring_path, O_WRONLY);
+        TEST_ASSERT(fd >= 0 && pwrite(fd, "\xFF\xFF", 2, 4096 + (off_t)at + 60) == 2,
+                    "tear it");
+        close(fd);
+    }
+    TEST_ASSERT(obd_blackbox_open(&bb, ring_path, 0) == OBD_OK, "reopen");
+    reset_seen();
+    obd_blackbox_walk(&bb, on_record, NULL);
+    TEST_ASSERT(seen.last_seq == last && strncmp(seen.last, "record 4999", 11) == 0,
+                "torn record dropped, the one before it kept");
+    TEST_ASSERT(seen.count == last - seen.first_seq + 1 && bb.next_seq == last + 1,
+                "as if never written");
+    obd_blackbox_close(&bb);
+
+    fd = open(ring_path, O_WRONLY | O_TRUNC);
+    TEST_ASSERT(fd >= 0 && write(fd, "not a ring file, not at all", 27) == 27, "garbage");
+    close(fd);
+    TEST_ASSERT(obd_blackbox_open(&bb, ring_path, 0) == OBD_ERROR_PARSE_FAILED,
+                "not a ring");
+
+    printf("  PASS: recovery\n");
+    return 0;
+}
+
+/* ── Test: fed by a session ────────────────────────────────────────── */
+static int test_session(void)
+{
+    static obd_session_t session;
+    obd_session_result_t result;
+    char cmd[OBD_MAX_COMMAND_LEN];
+    size_t len;
+
+    unlink(ring_path);
+    obd_blackbox_open(&bb, ring_path, OBD_BLACKBOX_MIN_SIZE);
+    obd_session_init(&session);
+    obd_session_set_capture(&session, obd_blackbox_capture, &bb);
+
+    obd_session_submit_pid(&session, 0x01, 0x0C, 0, NULL);
+    obd_session_next_command(&session, 100, cmd, sizeof(cmd), &len);
+    obd_session_write_done(&session, 200);
+    obd_session_feed(&session, TEST_RAW_RPM_RESPONSE, strlen(TEST_RAW_RPM_RESPONSE), 30000);
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_OK, "result");
+    TEST_ASSERT(obd_blackbox_result(&bb, &result, 30000) == OBD_OK, "sample recorded");
+    result.has_value = 0;
+    TEST_ASSERT(obd_blackbox_result(&bb, &result, 30000) == OBD_ERROR_NO_DATA, "no value");
+
+    reset_seen();
+    obd_blackbox_walk(&bb, on_record, NULL);
+    TEST_ASSERT(seen.count == 3 && seen.samples == 1, "TX, RX, sample");
+    TEST_ASSERT(seen.bytes == 5 + strlen(TEST_RAW_RPM_RESPONSE), "every byte");
+    obd_blackbox_close(&bb);
+
+    printf("  PASS: session capture\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    snprintf(ring_path, sizeof(ring_path), "/tmp/obd_test_bb_%d.bbx", (int)getpid());
+    snprintf(window_path, sizeof(window_path), "/tmp/obd_test_bb_%d.bbw", (int)getpid());
+
+    printf("=== blackbox tests ===\n");
+    failures += test_ring();
+    failures += test_trigger();
+    failures += test_recovery();
+    failures += test_session();
+
+    unlink(ring_path);
+    unlink(window_path);
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
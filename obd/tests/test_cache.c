@@ -0,0 +1,230 @@
+/**
+ * test_cache.c — Tests for the TTL response cache and request coalescing.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <stdio.h>
+#include <string.h>
+
+static obd_cache_t cache;
+static obd_session_t session;
+static obd_session_result_t result;
+static char text[4096];
+
+/* Play the adapter: send whatever is queued next and answer it */
+static int answer_next(uint64_t now, const char *reply)
+{
+    char cmd[OBD_MAX_COMMAND_LEN];
+    size_t len;
+
+    if (obd_session_next_command(&session, now, cmd, sizeof(cmd), &len) != OBD_OK) return 0;
+    obd_session_write_done(&session, now);
+    obd_session_feed(&session, reply, strlen(reply), now + 30000);
+    return obd_cache_poll(&cache, &session, now + 30000, &result) == OBD_OK;
+}
+
+static void setup(void)
+{
+    obd_cache_init(&cache);
+    obd_session_init(&session);
+}
+
+/* ── Test: built-in TTLs ───────────────────────────────────────────── */
+static int test_default_ttls(void)
+{
+    setup();
+    TEST_ASSERT(obd_cache_ttl_us(&cache, 0x09, 0x02) == OBD_CACHE_TTL_FOREVER, "VIN forever");
+    TEST_ASSERT(obd_cache_ttl_us(&cache, 0x09, 0x04) == OBD_CACHE_TTL_FOREVER, "CALID forever");
+    TEST_ASSERT(obd_cache_ttl_us(&cache, 0x01, 0x00) == OBD_CACHE_TTL_FOREVER, "PID bitmap forever");
+    TEST_ASSERT(obd_cache_ttl_us(&cache, 0x01, 0x05) == 2000000, "coolant 2 s");
+    TEST_ASSERT(obd_cache_ttl_us(&cache, 0x01, 0x0C) == 0, "RPM not cached");
+    TEST_ASSERT(obd_cache_ttl_us(&cache, 0x03, 0x00) == 0, "DTCs not cached");
+
+    /* Overrides beat built-ins, exact PID beats whole-mode */
+    obd_cache_set_ttl(&cache, 0x01, OBD_CACHE_ANY_PID, 500000);
+    obd_cache_set_ttl(&cache, 0x01, 0x0C, 0);
+    TEST_ASSERT(obd_cache_ttl_us(&cache, 0x01, 0x0D) == 500000, "mode-wide override");
+    TEST_ASSERT(obd_cache_ttl_us(&cache, 0x01, 0x0C) == 0, "exact override");
+    TEST_ASSERT(obd_cache_set_ttl(&cache, 0x01, 0x100, 0) == OBD_ERROR_INVALID_ARG, "bad PID");
+
+    printf("  PASS: default and overridden TTLs\n");
+    return 0;
+}
+
+/* ── Test: hit within TTL, miss after ──────────────────────────────── */
+static int test_ttl_expiry(void)
+{
+    uint32_t id = 0;
+
+    setup();
+    TEST_ASSERT(obd_cache_submit_pid(&cache, &session, 0x01, 0x05, 0, &result, &id) == OBD_PENDING,
+                "first ask is sent");
+    TEST_ASSERT(answer_next(0, TEST_RAW_COOLANT_RESPONSE), "answered");
+    TEST_ASSERT(result.id == id && result.value.value == TEST_EXPECTED_COOLANT, "coolant value");
+
+    memset(&result, 0, sizeof(result));
+    TEST_ASSERT(obd_cache_submit_pid(&cache, &session, 0x01, 0x05, 1000000, &result, NULL) == OBD_OK,
+                "hit inside 2 s");
+    TEST_ASSERT(result.value.value == TEST_EXPECTED_COOLANT, "cached value");
+    TEST_ASSERT(obd_session_pending(&session) == 0, "nothing sent for the hit");
+
+    TEST_ASSERT(obd_cache_submit_pid(&cache, &session, 0x01, 0x05, 2100000, &result, NULL) == OBD_PENDING,
+                "expired after 2 s");
+    TEST_ASSERT(cache.stats.hits == 1 && cache.stats.misses == 2, "1 hit, 2 misses");
+    TEST_ASSERT(cache.stats.expired == 1, "1 expiry");
+
+    printf("  PASS: TTL hit and expiry\n");
+    return 0;
+}
+
+/* ── Test: concurrent asks share one round trip ────────────────────── */
+static int test_coalescing(void)
+{
+    char cmd[OBD_MAX_COMMAND_LEN];
+    uint32_t a = 0, b = 0, c = 0;
+    size_t len;
+
+    setup();
+    obd_cache_submit_pid(&cache, &session, 0x01, 0x0C, 0, &result, &a);
+    TEST_ASSERT(obd_cache_submit_pid(&cache, &session, 0x01, 0x0C, 10, &result, &b) == OBD_PENDING,
+                "second ask pending");
+    obd_cache_submit_command(&cache, &session, "01 0c", 20, &result, &c);
+    TEST_ASSERT(a == b && b == c, "all three share one request id");
+    TEST_ASSERT(obd_session_pending(&session) == 1, "only one request queued");
+    TEST_ASSERT(cache.stats.coalesced == 2, "2 coalesced");
+
+    TEST_ASSERT(answer_next(100, TEST_RAW_RPM_RESPONSE), "answered");
+    TEST_ASSERT(result.id == a, "one result for everyone");
+
+    /* RPM has TTL 0: once answered, the next ask goes out again */
+    TEST_ASSERT(obd_cache_submit_pid(&cache, &session, 0x01, 0x0C, 200000, &result, &b) == OBD_PENDING,
+                "RPM not cached");
+    TEST_ASSERT(b != a, "new request");
+    TEST_ASSERT(cache.stats.stores == 0, "nothing stored");
+
+    /* Mode 02 goes out with its frame number, like obd_session_submit_pid() */
+    setup();
+    TEST_ASSERT(obd_cache_submit_pid(&cache, &session, 0x02, 0x0C, 0, &result, &a) ==
+                OBD_PENDING, "freeze frame RPM sent");
+    TEST_ASSERT(obd_session_next_command(&session, 0, cmd, sizeof(cmd), &len) == OBD_OK &&
+                strcmp(cmd, "020C00\r") == 0, "frame 0 asked for");
+    TEST_ASSERT(obd_cache_submit_command(&cache, &session, "020C00", 10, &result, &b) ==
+                OBD_PENDING && b == a, "the same request typed out is coalesced");
+
+    printf("  PASS: coalescing\n");
+    return 0;
+}
+
+/* ── Test: errors aren't cached, AT commands pass through ──────────── */
+static int test_errors_and_passthrough(void)
+{
+    uint32_t a = 0, b = 0;
+
+    setup();
+    obd_cache_submit_command(&cache, &session, "0100", 0, &result, NULL);
+    TEST_ASSERT(answer_next(0, TEST_RAW_NO_DATA_RESPONSE), "answered");
+    TEST_ASSERT(result.status == OBD_ERROR_NO_DATA, "NO DATA");
+    TEST_ASSERT(obd_cache_submit_command(&cache, &session, "0100", 100000, &result, NULL) == OBD_PENDING,
+                "NO DATA not cached, asked again");
+
+    setup();
+    obd_cache_submit_command(&cache, &session, "ATZ", 0, &result, &a);
+    obd_cache_submit_command(&cache, &session, "ATZ", 0, &result, &b);
+    TEST_ASSERT(a != b, "AT commands are never coalesced");
+    TEST_ASSERT(cache.stats.passthrough == 2, "2 passthrough");
+
+    printf("  PASS: errors not cached, AT passthrough\n");
+    return 0;
+}
+
+/* ── Test: invalidate, LRU eviction and the report ─────────────────── */
+static int test_invalidate_and_report(void)
+{
+    int i;
+
+    setup();
+    obd_cache_submit_command(&cache, &session, "0100", 0, &result, NULL);
+    TEST_ASSERT(answer_next(0, "0100\r41 00 BE 3E B8 11\r\r>"), "bitmap answered");
+    TEST_ASSERT(obd_cache_submit_command(&cache, &session, "0100", 5, &result, NULL) == OBD_OK,
+                "bitmap cached forever");
+    TEST_ASSERT(obd_cache_invalidate(&cache, "0100") == OBD_OK, "invalidate");
+    TEST_ASSERT(obd_cache_submit_command(&cache, &session, "0100", 6, &result, NULL) == OBD_PENDING,
+                "asked again after invalidate");
+
+    TEST_ASSERT(obd_cache_format_text(&cache, 10, text, sizeof(text)) == OBD_OK, "report");
+    TEST_ASSERT(strstr(text, "hits 1  misses 2") != NULL, "report counters");
+
+    /* Fill past capacity: the least recently used entry goes */
+    setup();
+    obd_cache_set_ttl(&cache, 0x01, OBD_CACHE_ANY_PID, OBD_CACHE_TTL_FOREVER);
+    for (i = 0; i <= OBD_CACHE_ENTRIES; i++) {
+        obd_session_result_t r;
+        memset(&r, 0, sizeof(r));
+        obd_cache_submit_pid(&cache, &session, 0x01, (uint8_t)i, (uint64_t)i, &result, &r.id);
+        r.mode = 0x01;
+        r.pid = (uint8_t)i;
+        obd_cache_complete(&cache, &r, (uint64_t)i);
+        obd_session_init(&session);             /* we answered it by hand */
+    }
+    TEST_ASSERT(cache.stats.evictions == 1, "one eviction");
+    TEST_ASSERT(obd_cache_submit_pid(&cache, &session, 0x01, 0x00, 100, &result, NULL) == OBD_PENDING,
+                "oldest entry was evicted");
+    TEST_ASSERT(obd_cache_submit_pid(&cache, &session, 0x01, 0x01, 100, &result, NULL) == OBD_OK,
+                "next oldest still cached");
+
+    printf("  PASS: invalidate, eviction, report\n");
+    return 0;
+}
+
+/* ── Test: lookup without sending, storing a split-out answer ──────── */
+static int test_lookup_and_store(void)
+{
+    obd_session_result_t r;
+    uint32_t a = 0, b = 0;
+
+    setup();
+    TEST_ASSERT(obd_cache_lookup(&cache, "0105", 0, &result, NULL) == OBD_ERROR_NO_DATA,
+                "miss: caller sends it");
+    TEST_ASSERT(obd_session_pending(&session) == 0, "lookup never sends");
+    TEST_ASSERT(obd_cache_lookup(&cache, "ATZ", 0, &result, NULL) == OBD_ERROR_NO_DATA,
+                "AT never cached");
+
+    obd_cache_submit_pid(&cache, &session, 0x01, 0x0C, 0, &result, &a);
+    TEST_ASSERT(obd_cache_lookup(&cache, "010C", 1, &result, &b) == OBD_PENDING && a == b,
+                "lookup joins the request in flight");
+
+    memset(&r, 0, sizeof(r));
+    r.mode = 0x01;
+    r.pid = 0x05;
+    strcpy(r.response, "41 05 7B");
+    TEST_ASSERT(obd_cache_store(&cache, "01 05", &r, 10) == OBD_OK, "store");
+    TEST_ASSERT(obd_cache_lookup(&cache, "0105", 20, &result, NULL) == OBD_OK, "stored answer hit");
+    TEST_ASSERT(strcmp(result.response, "41 05 7B") == 0, "stored text");
+
+    r.pid = 0x0D;                               /* TTL 0: not kept */
+    obd_cache_store(&cache, "010D", &r, 10);
+    TEST_ASSERT(obd_cache_lookup(&cache, "010D", 20, &result, NULL) == OBD_ERROR_NO_DATA,
+                "uncacheable PID not stored");
+
+    printf("  PASS: lookup and store\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== cache tests ===\n");
+    failures += test_default_ttls();
+    failures += test_ttl_expiry();
+    failures += test_coalescing();
+    failures += test_errors_and_passthrough();
+    failures += test_invalidate_and_report();
+    failures += test_lookup_and_store();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 6);
+    return failures;
+}
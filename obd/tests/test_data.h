@@ -67,6 +67,140 @@
 
 #define TEST_EXPECTED_VIN           "WBA3B5FK7FN123456"
 
+/* Mode 06 monitor results, CAN, two tests of MID 0x01 (O2 B1S1):
+ *   TID 0B, UASID 24 (counts): value 0,    limits 0..0xFFFF  → pass
+ *   TID 0C, UASID 24 (counts): value 0x15, limits 0..0x10    → fail
+ * 19 bytes (0x013) of message, so three frames; the last is padded.
+ */
+#define TEST_CLEAN_MONITOR_SEGMENTS \
+    "013\r"                          \
+    "0: 46 01 0B 24 00 00\r"         \
+    "1: 00 00 FF FF 01 0C 24\r"      \
+    "2: 00 15 00 00 00 10 00"
+
+/* The same with headers on (ATH1), and a second ECU (7E9) answering in
+ * between: TID 0B, UASID 96 (signed 0.1 C), value 0xFF9C = -10.0 C */
+#define TEST_CLEAN_MONITOR_HEADERS  \
+    "7E8 10 13 46 01 0B 24 00 00\r" \
+    "7E9 10 0A 46 01 0B 96 FF 9C\r" \
+    "7E8 21 00 00 FF FF 01 0C 24\r" \
+    "7E9 21 80 00 7F FF 00 00 00\r" \
+    "7E8 22 00 15 00 00 00 10 00"
+
+/* Supported MIDs: bitmaps for 00, 20 and 40 in one reply (16 bytes)
+ *   00: C0 00 00 01 → 01, 02, 20    20: 80 00 00 01 → 21, 40
+ *   40: 00 00 00 00 → none, end of chain */
+#define TEST_CLEAN_MONITOR_SUPPORTED \
+    "010\r"                          \
+    "0: 46 00 C0 00 00 01\r"         \
+    "1: 20 80 00 00 01 40 00\r"      \
+    "2: 00 00 00 00 00 00 00"
+
+/* Mode 01 PID 00: 01, 03-07, 0B-0F, 11, 13-15, 1C, 20 */
+#define TEST_CLEAN_PID_SUPPORTED    "41 00 BE 3E B8 11"
+
+/* Mode 09 PID 00, headers on, two ECUs:
+ *   7E8: 55 40 00 00 → 02, 04, 06, 08, 0A    7E9: 14 40 00 00 → 04, 06, 0A */
+#define TEST_CLEAN_INFO_SUPPORTED   \
+    "7E8 06 49 00 55 40 00 00\r"    \
+    "7E9 06 49 00 14 40 00 00"
+
+/* Mode 09 PID 02 (VIN) on CAN: 49 02 01 + 17 bytes, headers off */
+#define TEST_CLEAN_INFO_VIN         \
+    "014\r"                         \
+    "0: 49 02 01 57 42 41\r"        \
+    "1: 33 42 35 46 4B 37 46\r"     \
+    "2: 4E 31 32 33 34 35 36"
+
+/* Mode 09 PID 04 (calibration IDs), headers on, frames interleaved:
+ *   7E8: "JMB*36761500"    7E9: "TCM-0042" (each zero-padded to 16) */
+#define TEST_CLEAN_INFO_CALID       \
+    "7E8 10 13 49 04 01 4A 4D 42\r" \
+    "7E9 10 13 49 04 01 54 43 4D\r" \
+    "7E8 21 2A 33 36 37 36 31 35\r" \
+    "7E9 21 2D 30 30 34 32 00 00\r" \
+    "7E8 22 30 30 00 00 00 00 00\r" \
+    "7E9 22 00 00 00 00 00 00 00"
+
+/* Mode 09 PID 06 (CVNs): one single frame per ECU */
+#define TEST_CLEAN_INFO_CVN         \
+    "7E8 07 49 06 01 17 91 BC 82\r" \
+    "7E9 07 49 06 01 A1 B2 C3 D4"
+
+/* Mode 09 PID 0A (ECU name), headers off: "ECM\0" "-" "EngineControl\0\0" */
+#define TEST_CLEAN_INFO_ECU_NAME    \
+    "017\r"                         \
+    "0: 49 0A 01 45 43 4D\r"        \
+    "1: 00 2D 45 6E 67 69 6E\r"     \
+    "2: 65 43 6F 6E 74 72 6F\r"     \
+    "3: 6C 00 00 00 00 00 00"
+
+/* Mode 09 PID 08 (in-use performance, spark), 16 counters:
+ *   OBDCOND 0x0123, IGNCNTR 0x0456, then 3, 6, 9 ... 42 */
+#define TEST_CLEAN_INFO_IPT         \
+    "023\r"                         \
+    "0: 49 08 10 01 23 04\r"        \
+    "1: 56 00 03 00 06 00 09\r"     \
+    "2: 00 0C 00 0F 00 12 00\r"     \
+    "3: 15 00 18 00 1B 00 1E\r"     \
+    "4: 00 21 00 24 00 27 00\r"     \
+    "5: 2A 00 00 00 00 00 00"
+
+/* Mode 02 freeze frame 0, CAN, headers off. The replies to the requests
+ * obd_freeze_next_request() makes with a batch of 3.
+ *
+ * "02 00 00 20 00 40 00": bitmaps for 00 and 20 (no 40)
+ *   00: 5E 3F 80 03 → 02, 04-07, 0B-10, 11, 1F, 20
+ *   20: 80 02 00 00 → 21, 2F */
+#define TEST_CLEAN_FREEZE_SUPPORTED \
+    "00D\r"                         \
+    "0: 42 00 00 5E 3F 80\r"        \
+    "1: 03 20 00 80 02 00 00"
+
+/* "02 02 00 04 00 05 00": DTC P0301, load 29.8%, coolant 83 C */
+#define TEST_CLEAN_FREEZE_DTC_LOAD  \
+    "00B\r"                         \
+    "0: 42 02 00 03 01 04\r"        \
+    "1: 00 4C 05 00 7B 00 00"
+
+/* "02 06 00 07 00 0B 00": fuel trims 0%, MAP 100 kPa */
+#define TEST_CLEAN_FREEZE_TRIMS     \
+    "00A\r"                         \
+    "0: 42 06 00 80 07 00\r"        \
+    "1: 80 0B 00 64 00 00 00"
+
+/* "02 0C 00 0D 00 0E 00": 1726 rpm, 60 km/h, timing 0 deg */
+#define TEST_CLEAN_FREEZE_RPM       \
+    "00B\r"                         \
+    "0: 42 0C 00 1A F8 0D\r"        \
+    "1: 00 3C 0E 00 80 00 00"
+
+/* "02 0F 00 10 00 11 00": intake 30 C, MAF 4.20 g/s, throttle 20% */
+#define TEST_CLEAN_FREEZE_AIR       \
+    "00B\r"                         \
+    "0: 42 0F 00 46 10 00\r"        \
+    "1: 01 A4 11 00 33 00 00"
+
+/* "02 1F 00 21 00 2F 00": runtime 256 s, 42 km with MIL on, fuel 0x80
+ * (21 and 2F aren't in the sensor table: raw only) */
+#define TEST_CLEAN_FREEZE_MISC      \
+    "00C\r"                         \
+    "0: 42 1F 00 01 00 21\r"        \
+    "1: 00 00 2A 2F 00 80 00"
+
+/* PID 01, spark ignition: MIL on, 3 DTCs. Continuous monitors supported
+ * and complete (B = 07); catalyst, EVAP, O2 sensor and heater supported
+ * (C = 65), EVAP incomplete (D = 04) */
+#define TEST_CLEAN_READINESS_SPARK   "41 01 83 07 65 04"
+
+/* PID 01, diesel (B bit 3): no MIL; NMHC catalyst, NOx/SCR, exhaust gas
+ * sensor, PM filter and EGR supported (C = E3), NOx/SCR and PM filter
+ * incomplete (D = 42), fuel system incomplete (B bit 5) */
+#define TEST_CLEAN_READINESS_DIESEL  "41 01 00 2F E3 42"
+
+/* PID 41, this drive cycle: byte A unused, catalyst incomplete */
+#define TEST_CLEAN_READINESS_CYCLE   "41 41 00 07 21 01"
+
 /* ── Hex conversion test data ──────────────────────────────────────────── */
 #define TEST_HEX_STRING_SPACED      "41 0C 1A F8"
 #define TEST_HEX_STRING_NO_SPACES   "410C1AF8"
@@ -0,0 +1,205 @@
+/**
+ * test_derived.c — Tests for derived sensors.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FLOAT_NEAR(a, b, tolerance) (fabs((double)(a) - (double)(b)) < (tolerance))
+#define MS 1000u
+#define S  1000000u
+
+static obd_derived_t engine;
+
+static int feed_hex(const char *hex, uint64_t t_us)
+{
+    obd_pid_response_t pid;
+    return obd_pid_parse_response(hex, &pid) == OBD_OK &&
+           obd_derived_feed_response(&engine, &pid, t_us) == OBD_OK;
+}
+
+/* ── Test: built-ins, and only what depends on a sample is recomputed ── */
+static int test_defaults(void)
+{
+    const obd_derived_def_t *defs;
+    const obd_derived_slot_t *s;
+    uint64_t before;
+    size_t n;
+
+    defs = obd_derived_defaults(&n);
+    TEST_ASSERT(obd_derived_init(&engine, defs, n, 2 * S) == OBD_OK, "init");
+    TEST_ASSERT(obd_derived_find(&engine, OBD_DERIVED_ECONOMY)->has_value == 0, "nothing yet");
+
+    /* MAF → fuel rate → economy (no speed yet) and fuel used; power */
+    TEST_ASSERT(feed_hex(TEST_CLEAN_MAF, 0), "MAF fed");
+    TEST_ASSERT(engine.evaluations == 4, "fuel rate, power, economy, fuel used");
+    s = obd_derived_find(&engine, OBD_DERIVED_FUEL_RATE);
+    TEST_ASSERT(s->has_value && FLOAT_NEAR(s->value, 1.39, 0.01), "4.2 g/s is 1.39 L/h");
+    TEST_ASSERT(strcmp(s->name, "Fuel Rate") == 0 && strcmp(s->unit, "L/h") == 0, "labels");
+    TEST_ASSERT(FLOAT_NEAR(obd_derived_find(&engine, OBD_DERIVED_POWER)->value, 3.69, 0.01),
+                "3.7 kW");
+    TEST_ASSERT(!obd_derived_find(&engine, OBD_DERIVED_ECONOMY)->has_value, "no speed yet");
+
+    /* Speed → economy, gear, distance; nothing else */
+    before = engine.evaluations;
+    TEST_ASSERT(feed_hex(TEST_CLEAN_SPEED, 100 * MS), "speed fed");
+    TEST_ASSERT(engine.evaluations - before == 3, "economy, gear, distance");
+    s = obd_derived_find(&engine, OBD_DERIVED_ECONOMY);
+    TEST_ASSERT(s->has_value && FLOAT_NEAR(s->value, 2.317, 0.01), "2.3 L/100km at 60");
+    TEST_ASSERT(s->t_us == 100 * MS, "newest input's time");
+
+    /* Real PIDs sit in the same table, with the sensor table's labels */
+    s = obd_derived_find(&engine, 0x0D);
+    TEST_ASSERT(s && s->value == TEST_EXPECTED_SPEED &&
+                strcmp(s->name, "Vehicle Speed") == 0, "speed row");
+
+    /* Boost needs both MAP and barometric */
+    before = engine.evaluations;
+    TEST_ASSERT(obd_derived_feed(&engine, 0x33, 101.0f, 200 * MS) == OBD_OK, "baro");
+    TEST_ASSERT(engine.evaluations - before == 1, "only boost");
+    TEST_ASSERT(!obd_derived_find(&engine, OBD_DERIVED_BOOST)->has_value, "no MAP yet");
+    obd_derived_feed(&engine, 0x0B, 151.0f, 300 * MS);
+    TEST_ASSERT(obd_derived_find(&engine, OBD_DERIVED_BOOST)->value == 50.0f, "50 kPa boost");
+
+    /* Standing still: no economy, no gear */
+    obd_derived_feed(&engine, 0x0C, 800.0f, 400 * MS);
+    obd_derived_feed(&engine, 0x0D, 0.0f, 400 * MS);
+    TEST_ASSERT(!obd_derived_find(&engine, OBD_DERIVED_ECONOMY)->has_value, "L/100km at 0");
+    TEST_ASSERT(!obd_derived_find(&engine, OBD_DERIVED_GEAR)->has_value, "gear at 0");
+
+    printf("  PASS: built-in definitions, incremental\n");
+    return 0;
+}
+
+/* ── Test: integrals by sample time, gaps, reset ───────────────────── */
+static int test_integral(void)
+{
+    const obd_derived_def_t *defs;
+    const obd_derived_slot_t *dist;
+    size_t n, i;
+
+    defs = obd_derived_defaults(&n);
+    obd_derived_init(&engine, defs, n, 2 * S);
+    dist = obd_derived_find(&engine, OBD_DERIVED_DISTANCE);
+
+    /* 36 km/h for 10 s = 100 m, sampled every 500 ms */
+    for (i = 0; i <= 20; i++) {
+        obd_derived_feed(&engine, 0x0D, 36.0f, i * 500 * MS);
+    }
+    TEST_ASSERT(FLOAT_NEAR(dist->value, 0.1, 1e-5), "100 m");
+
+    /* Speeding up 0 → 72 km/h over 10 s: trapezoids get it exactly */
+    obd_derived_reset(&engine, OBD_DERIVED_DISTANCE);
+    for (i = 0; i <= 10; i++) {
+        obd_derived_feed(&engine, 0x0D, 7.2f * (float)i, (20 + i) * S);
+    }
+    TEST_ASSERT(FLOAT_NEAR(dist->value, 0.1, 1e-5), "another 100 m after reset");
+
+    /* Adapter gone for 30 s: not bridged */
+    obd_derived_feed(&engine, 0x0D, 72.0f, 60 * S);
+    TEST_ASSERT(FLOAT_NEAR(dist->value, 0.1, 1e-5), "gap skipped");
+    obd_derived_feed(&engine, 0x0D, 72.0f, 61 * S);
+    TEST_ASSERT(FLOAT_NEAR(dist->value, 0.12, 1e-5), "then 20 m more");
+    obd_derived_feed(&engine, 0x0D, 72.0f, 60 * S);
+    TEST_ASSERT(FLOAT_NEAR(dist->value, 0.12, 1e-5), "older sample ignored");
+
+    /* Fuel used integrates a derived value: 3.31 L/h for one hour */
+    for (i = 0; i <= 3600; i++) {
+        obd_derived_feed(&engine, 0x10, 10.0f, 100 * S + i * S);
+    }
+    TEST_ASSERT(FLOAT_NEAR(obd_derived_find(&engine, OBD_DERIVED_FUEL_USED)->value, 3.3094, 1e-3),
+                "3.31 L in an hour");
+
+    TEST_ASSERT(obd_derived_reset(&engine, OBD_DERIVED_BOOST) == OBD_ERROR_UNKNOWN_PID,
+                "boost isn't an integral");
+
+    printf("  PASS: integrals\n");
+    return 0;
+}
+
+/* ── Test: definitions are data ────────────────────────────────────── */
+static int test_custom(void)
+{
+    static const obd_derived_def_t defs[] = {
+        { 0x201, "Coolant above intake", "C", OBD_DERIVED_LINEAR, 2,
+          { 0x200, 0x0F }, { 1.0f, -1.0f }, 0.0f, 0.0f },
+        { 0x200, "Coolant", "F", OBD_DERIVED_LINEAR, 1,
+          { 0x05 }, { 1.8f }, 32.0f, 0.0f },
+    };
+    static const obd_derived_def_t cycle[] = {
+        { 0x200, "A", "", OBD_DERIVED_LINEAR, 1, { 0x201 }, { 1.0f }, 0.0f, 0.0f },
+        { 0x201, "B", "", OBD_DERIVED_LINEAR, 1, { 0x200 }, { 1.0f }, 0.0f, 0.0f },
+    };
+    obd_derived_def_t bad = defs[1];
+    const obd_derived_slot_t *f;
+
+    /* Listed out of order: sorted at init */
+    TEST_ASSERT(obd_derived_init(&engine, defs, 2, 0) == OBD_OK, "custom init");
+    TEST_ASSERT(feed_hex(TEST_CLEAN_COOLANT, 0), "coolant");
+    f = obd_derived_find(&engine, 0x200);
+    TEST_ASSERT(f->has_value && FLOAT_NEAR(f->value, 181.4, 0.01), "83 C = 181.4 F");
+    obd_derived_feed(&engine, 0x0F, 30.0f, 60 * S);
+    TEST_ASSERT(FLOAT_NEAR(obd_derived_find(&engine, 0x201)->value, 151.4, 0.01),
+                "no max age: a minute apart still combines");
+
+    TEST_ASSERT(obd_derived_init(&engine, cycle, 2, 0) == OBD_ERROR_INVALID_ARG, "cycle");
+    bad.channel = 0x0C;
+    TEST_ASSERT(obd_derived_init(&engine, &bad, 1, 0) == OBD_ERROR_INVALID_ARG, "PID channel");
+    bad = defs[0];
+    TEST_ASSERT(obd_derived_init(&engine, &bad, 1, 0) == OBD_ERROR_INVALID_ARG, "0x200 undefined");
+    bad = defs[1];
+    bad.op = OBD_DERIVED_RATIO;
+    TEST_ASSERT(obd_derived_init(&engine, &bad, 1, 0) == OBD_ERROR_INVALID_ARG, "ratio of one");
+    TEST_ASSERT(obd_derived_init(&engine, defs, 0, 0) == OBD_OK, "no definitions");
+    TEST_ASSERT(obd_derived_feed(&engine, 0x0C, 800.0f, 0) == OBD_OK &&
+                obd_derived_find(&engine, 0x0C)->value == 800.0f, "just a value table");
+
+    printf("  PASS: custom definitions\n");
+    return 0;
+}
+
+/* ── Test: inputs too far apart ────────────────────────────────────── */
+static int test_stale(void)
+{
+    const obd_derived_def_t *defs;
+    size_t n, pid;
+
+    defs = obd_derived_defaults(&n);
+    obd_derived_init(&engine, defs, n, 1 * S);
+    obd_derived_feed(&engine, 0x10, 4.2f, 0);
+    obd_derived_feed(&engine, 0x0D, 60.0f, 3 * S);
+    TEST_ASSERT(!obd_derived_find(&engine, OBD_DERIVED_ECONOMY)->has_value,
+                "MAF 3 s older than speed");
+    obd_derived_feed(&engine, 0x10, 4.2f, 3 * S + 200 * MS);
+    TEST_ASSERT(obd_derived_find(&engine, OBD_DERIVED_ECONOMY)->has_value, "fresh again");
+
+    /* Unused PIDs fill the table up */
+    for (pid = 0x40; engine.slot_count < OBD_DERIVED_MAX_CHANNELS; pid++) {
+        TEST_ASSERT(obd_derived_feed(&engine, (uint8_t)pid, 1.0f, 0) == OBD_OK, "stored");
+    }
+    TEST_ASSERT(obd_derived_feed(&engine, (uint8_t)pid, 1.0f, 0) == OBD_ERROR_BUFFER_TOO_SMALL,
+                "table full");
+    TEST_ASSERT(obd_derived_feed(&engine, 0x0D, 50.0f, 4 * S) == OBD_OK, "used PIDs still fit");
+
+    printf("  PASS: stale inputs, full table\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== derived tests ===\n");
+    failures += test_defaults();
+    failures += test_integral();
+    failures += test_custom();
+    failures += test_stale();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
@@ -0,0 +1,218 @@
+/**
+ * test_downsample.c — Tests for LTTB and the min/max pyramid.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define N      (1u << 20)              /* About 29 hours at 10 Hz */
+#define SPIKE  123457u
+
+static float x[N], y[N];
+static float buf[400000], copy[400000];
+static float out[2 * 4096];
+static size_t index_[1000];
+
+/* A slow wave, a faster ripple, and one spike */
+static void make_series(void)
+{
+    size_t i;
+
+    for (i = 0; i < N; i++) {
+        x[i] = (float)i * 0.1f;
+        y[i] = 50.0f * sinf((float)i * 0.0001f) + 5.0f * sinf((float)i * 0.05f);
+    }
+    y[SPIKE] = 500.0f;
+}
+
+static void brute(const float *v, size_t from, size_t to, float *lo, float *hi)
+{
+    size_t i;
+
+    *lo = *hi = v[from];
+    for (i = from + 1; i < to; i++) {
+        if (v[i] < *lo) *lo = v[i];
+        if (v[i] > *hi) *hi = v[i];
+    }
+}
+
+/* ── Test: LTTB ────────────────────────────────────────────────────── */
+static int test_lttb(void)
+{
+    size_t count, i, spike = 0;
+    double every = (double)(N - 2) / 998.0;
+
+    make_series();
+    TEST_ASSERT(obd_lttb(x, y, N, 1000, index_, &count) == OBD_OK && count == 1000, "1000 kept");
+    TEST_ASSERT(index_[0] == 0 && index_[999] == N - 1, "first and last kept");
+    for (i = 1; i < 999; i++) {
+        TEST_ASSERT(index_[i] > index_[i - 1], "in order");
+        TEST_ASSERT(index_[i] >= (size_t)((double)(i - 1) * every) + 1 &&
+                    index_[i] < (size_t)((double)i * every) + 1, "one from each bucket");
+        spike += index_[i] == SPIKE;
+    }
+    TEST_ASSERT(spike == 1, "the spike survives a thousandfold reduction");
+
+    TEST_ASSERT(obd_lttb(x, y, 5, 10, index_, &count) == OBD_OK && count == 5 &&
+                index_[4] == 4, "fewer than wanted: all of them");
+    TEST_ASSERT(obd_lttb(x, y, 10, 2, index_, &count) == OBD_ERROR_INVALID_ARG,
+                "under 3 can't keep both ends and a bucket");
+    TEST_ASSERT(obd_lttb(x, NULL, 10, 5, index_, &count) == OBD_ERROR_INVALID_ARG, "NULL");
+
+    printf("  PASS: LTTB\n");
+    return 0;
+}
+
+/* ── Test: building and attaching ──────────────────────────────────── */
+static int test_build(void)
+{
+    obd_pyramid_t pyr, again;
+    size_t k, b, per = OBD_PYRAMID_BASE, to, size = obd_pyramid_size(1000);
+    float lo, hi;
+
+    make_series();
+    /* 1000 samples: 125, 32, 8, 2, 1 blocks */
+    TEST_ASSERT(size == 2 * (125 + 32 + 8 + 2 + 1), "size");
+    TEST_ASSERT(obd_pyramid_build(&pyr, y, 1000, buf, size - 1) ==
+                OBD_ERROR_BUFFER_TOO_SMALL, "too small");
+    TEST_ASSERT(obd_pyramid_build(&pyr, y, 1000, buf, size) == OBD_OK &&
+                pyr.levels == 5 && pyr.blocks[4] == 1, "built");
+
+    for (k = 0; k < pyr.levels; k++, per *= OBD_PYRAMID_FANOUT) {
+        for (b = 0; b < pyr.blocks[k]; b++) {
+            to = (b + 1) * per < 1000 ? (b + 1) * per : 1000;
+            brute(y, b * per, to, &lo, &hi);
+            TEST_ASSERT(buf[pyr.offset[k] + 2 * b] == lo &&
+                        buf[pyr.offset[k] + 2 * b + 1] == hi, "every block's min and max");
+        }
+    }
+
+    /* Stored and read back: the same answers */
+    memcpy(copy, buf, size * sizeof(float));
+    TEST_ASSERT(obd_pyramid_attach(&again, copy, size, 1000) == OBD_OK &&
+                again.levels == 5 && again.offset[4] == pyr.offset[4], "attached");
+    TEST_ASSERT(obd_pyramid_attach(&again, copy, size - 2, 1000) ==
+                OBD_ERROR_BUFFER_TOO_SMALL, "short file");
+    TEST_ASSERT(obd_pyramid_size(N) < N / 2, "well under half the series");
+
+    printf("  PASS: build and attach\n");
+    return 0;
+}
+
+/* ── Test: any window in O(pixels) ─────────────────────────────────── */
+static int test_query(void)
+{
+    obd_pyramid_t pyr;
+    size_t c, a, b, first, last, quarter, size = obd_pyramid_size(N);
+    float lo, hi, lo_in, hi_in;
+
+    make_series();
+    TEST_ASSERT(size <= sizeof(buf) / sizeof(buf[0]), "buffer");
+    TEST_ASSERT(obd_pyramid_build(&pyr, y, N, buf, size) == OBD_OK, "built");
+
+    /* The whole trip, 1024 columns of 1024 samples: exact */
+    TEST_ASSERT(obd_pyramid_query(&pyr, y, 0, N, 1024, out) == OBD_OK, "whole trip");
+    for (c = 0; c < 1024; c++) {
+        brute(y, c * 1024, (c + 1) * 1024, &lo, &hi);
+        TEST_ASSERT(out[2 * c] == lo && out[2 * c + 1] == hi, "column = its samples");
+    }
+    TEST_ASSERT(out[2 * (SPIKE / 1024) + 1] == 500.0f, "the spike is in its column");
+
+    /* An odd window: each column is its samples, give or take a quarter column */
+    first = 54321;
+    last = 987654;
+    TEST_ASSERT(obd_pyramid_query(&pyr, NULL, first, last, 777, out) == OBD_OK, "odd window");
+    quarter = (last - first) / 777 / 4 + 1;
+    for (c = 0; c < 777; c++) {
+        a = first + (last - first) * c / 777;
+        b = first + (last - first) * (c + 1) / 777;
+        brute(y, a + quarter, b - quarter, &lo_in, &hi_in);
+        brute(y, a - quarter, b + quarter, &lo, &hi);
+        TEST_ASSERT(out[2 * c] <= lo_in && out[2 * c] >= lo &&
+                    out[2 * c + 1] >= hi_in && out[2 * c + 1] <= hi, "give or take");
+    }
+
+    /* Zoomed in to 3000 samples on 1000 columns: read from the samples */
+    first = SPIKE - 1500;
+    TEST_ASSERT(obd_pyramid_query(&pyr, y, first, first + 3000, 1000, out) == OBD_OK,
+                "zoomed");
+    for (c = 0; c < 1000; c++) {
+        brute(y, first + c * 3, first + c * 3 + 3, &lo, &hi);
+        TEST_ASSERT(out[2 * c] == lo && out[2 * c + 1] == hi, "exact when zoomed");
+    }
+    TEST_ASSERT(out[2 * 500 + 1] == 500.0f, "spike in the middle");
+
+    /* Without the samples, level 0: a block's extremes, the spike's among them */
+    TEST_ASSERT(obd_pyramid_query(&pyr, NULL, first, first + 3000, 1000, out) == OBD_OK &&
+                out[2 * 500 + 1] == 500.0f && out[2 * 501 + 1] == 500.0f, "no samples");
+
+    /* Panned so both ends fall mid-block (512 samples at this zoom): a
+     * spike just inside the start stays, one just past the end stays out */
+    first = 300332;
+    last = first + 524288;
+    y[first + 100] = 600.0f;
+    y[last + 100] = 700.0f;
+    TEST_ASSERT(obd_pyramid_build(&pyr, y, N, buf, size) == OBD_OK, "rebuilt");
+    TEST_ASSERT(obd_pyramid_query(&pyr, y, first, last, 512, out) == OBD_OK &&
+                out[1] == 600.0f, "spike 100 samples in: in the first column");
+    a = (first + 1024 * 511 + 256) / 512 * 512;
+    brute(y, a, last, &lo, &hi);
+    TEST_ASSERT(out[2 * 511] == lo && out[2 * 511 + 1] == hi && hi < 700.0f,
+                "last column ends at the window's end, exactly");
+    TEST_ASSERT(obd_pyramid_query(&pyr, NULL, first, last, 512, out) == OBD_OK &&
+                out[1] == 600.0f && out[2 * 511 + 1] < 700.0f, "the same without samples");
+
+    printf("  PASS: queries\n");
+    return 0;
+}
+
+/* ── Test: NaN gaps, more columns than samples, errors ─────────────── */
+static int test_edges(void)
+{
+    obd_pyramid_t pyr;
+    float v[40];
+    size_t i;
+
+    for (i = 0; i < 40; i++) {
+        v[i] = i < 16 ? NAN : (float)i;
+    }
+    TEST_ASSERT(obd_pyramid_build(&pyr, v, 40, buf, obd_pyramid_size(40)) == OBD_OK,
+                "built over a gap");
+    TEST_ASSERT(isnan(buf[0]) && isnan(buf[3]) && buf[4] == 16.0f, "all-NaN blocks are NaN");
+    TEST_ASSERT(buf[pyr.offset[1]] == 16.0f && buf[pyr.offset[1] + 1] == 31.0f,
+                "NaN left out above");
+
+    TEST_ASSERT(obd_pyramid_query(&pyr, v, 36, 40, 8, out) == OBD_OK &&
+                out[0] == 36.0f && out[1] == 36.0f && out[14] == 39.0f,
+                "8 columns, 4 samples: each sample twice");
+
+    TEST_ASSERT(obd_pyramid_query(&pyr, v, 10, 10, 8, out) == OBD_ERROR_INVALID_ARG &&
+                obd_pyramid_query(&pyr, v, 0, 41, 8, out) == OBD_ERROR_INVALID_ARG &&
+                obd_pyramid_query(&pyr, v, 0, 40, 0, out) == OBD_ERROR_INVALID_ARG,
+                "empty window, past the end, no pixels");
+    TEST_ASSERT(obd_pyramid_build(&pyr, v, 0, buf, 100) == OBD_ERROR_INVALID_ARG &&
+                obd_pyramid_size(0) == 0, "no samples");
+    TEST_ASSERT(obd_pyramid_build(NULL, v, 40, buf, 100) == OBD_ERROR_INVALID_ARG &&
+                obd_pyramid_attach(&pyr, NULL, 100, 40) == OBD_ERROR_INVALID_ARG, "NULL");
+
+    printf("  PASS: gaps and errors\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== downsample tests ===\n");
+    failures += test_lttb();
+    failures += test_build();
+    failures += test_query();
+    failures += test_edges();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
@@ -104,6 +104,29 @@ static int test_clean_response_normal(void)
     return 0;
 }
 
+/* ── Test: response cleaning — CAN multi-frame lines are kept ──────── */
+static int test_clean_response_multi_frame(void)
+{
+    char out[OBD_MAX_RESPONSE_LEN];
+    obd_result_t r;
+
+    /* "013" and "0: ..." look like echoes (first byte < 0x40) but belong
+     * to the reply; the echo "0601" is still dropped */
+    r = obd_elm327_clean_response("0601\r" TEST_CLEAN_MONITOR_SEGMENTS "\r\r>",
+                                  out, sizeof(out));
+    TEST_ASSERT(r == OBD_OK, "multi-frame response should clean");
+    TEST_ASSERT(strcmp(out, TEST_CLEAN_MONITOR_SEGMENTS) == 0,
+                "length line and segments should be kept, echo dropped");
+
+    /* A length of 0 announces nothing: "000" is not a length line */
+    r = obd_elm327_clean_response("000\r" TEST_CLEAN_RPM "\r\r>", out, sizeof(out));
+    TEST_ASSERT(r == OBD_OK && strcmp(out, TEST_CLEAN_RPM) == 0,
+                "'000' should be dropped like an echo");
+
+    printf("  PASS: clean response — CAN multi-frame\n");
+    return 0;
+}
+
 /* ── Test: response cleaning — error conditions ────────────────────── */
 static int test_clean_response_errors(void)
 {
@@ -173,12 +196,13 @@ int main(void)
     failures += test_at_commands();
     failures += test_classify_response();
     failures += test_clean_response_normal();
+    failures += test_clean_response_multi_frame();
     failures += test_clean_response_errors();
     failures += test_clean_response_ok();
     failures += test_classify_bus_errors();
     failures += test_clean_response_buffer_too_small();
 
     printf("\n%s (%d test functions)\n",
-           failures == 0 ? "ALL PASSED" : "SOME FAILED", 7);
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 8);
     return failures;
 }
@@ -0,0 +1,165 @@
+/**
+ * test_emu.c — Tests for the ELM327 emulator.
+ *
+ * The emulator stands in for the car in the mux tests and benchmarks, so
+ * its replies are checked against the same raw fixtures (test_data.h)
+ * the parsers are tested with, and fed back through the real parsers.
+ */
+
+#include <obd/obd_io.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <stdio.h>
+#include <string.h>
+
+static obd_emu_t emu;
+static char out[1024];
+
+/* Feed one command line and return the emulator's whole answer */
+static const char *ask(const char *line)
+{
+    size_t n = 0;
+    if (obd_emu_feed(&emu, line, strlen(line), out, sizeof(out), &n) != OBD_OK) {
+        return "";
+    }
+    return out;
+}
+
+/* Ask with echo off and clean the reply like the session would */
+static obd_result_t ask_clean(const char *line, char *clean, size_t size)
+{
+    return obd_elm327_clean_response(ask(line), clean, size);
+}
+
+/* ── Test: replies match the recorded adapter fixtures ─────────────── */
+static int test_matches_fixtures(void)
+{
+    obd_emu_init(&emu);
+    TEST_ASSERT(strcmp(ask("ATZ\r"), TEST_RAW_RESET_RESPONSE) == 0, "ATZ");
+    TEST_ASSERT(strcmp(ask("010C\r"), TEST_RAW_RPM_RESPONSE) == 0, "RPM with echo");
+    TEST_ASSERT(strcmp(ask("010D\r"), TEST_RAW_SPEED_RESPONSE) == 0, "speed");
+    TEST_ASSERT(strcmp(ask("0105\r"), TEST_RAW_COOLANT_RESPONSE) == 0, "coolant");
+    TEST_ASSERT(strcmp(ask("ATZZ\r"), TEST_RAW_ERROR_RESPONSE) == 0, "unknown AT");
+    TEST_ASSERT(strcmp(ask("ATE0\r"), TEST_RAW_OK_RESPONSE) == 0, "echo off");
+    TEST_ASSERT(strcmp(ask("010C\r"), "41 0C 1A F8\r\r>") == 0, "no echo now");
+
+    /* Split across reads, lower case, an empty line repeats */
+    TEST_ASSERT(strcmp(ask("01 0"), "") == 0, "nothing until \\r");
+    TEST_ASSERT(strcmp(ask("d\r"), "41 0D 3C\r\r>") == 0, "joined line, lower case");
+    TEST_ASSERT(strcmp(ask("\r"), "41 0D 3C\r\r>") == 0, "empty line repeats");
+    TEST_ASSERT(emu.obd_requests == 6 && strcmp(emu.last_obd, "010D") == 0, "counted");
+
+    printf("  PASS: replies match fixtures\n");
+    return 0;
+}
+
+/* ── Test: multi-PID, bitmaps, unsupported PIDs ────────────────────── */
+static int test_mode01(void)
+{
+    obd_pid_response_t parsed;
+    char clean[OBD_MAX_RESPONSE_LEN];
+    const uint8_t fuel_pressure = 0x64;
+
+    obd_emu_init(&emu);
+    ask("ATE0\r");
+    TEST_ASSERT(strcmp(ask("010C0D05\r"), "41 0C 1A F8 0D 3C 05 7B\r\r>") == 0, "multi-PID");
+    TEST_ASSERT(strcmp(ask("010C1\r"), "41 0C 1A F8\r\r>") == 0, "response-count digit ignored");
+    TEST_ASSERT(strcmp(ask("010A\r"), "NO DATA\r\r>") == 0, "unsupported PID");
+
+    /* Bitmaps follow the table */
+    TEST_ASSERT(ask_clean("0100\r", clean, sizeof(clean)) == OBD_OK, "0100 answered");
+    TEST_ASSERT(obd_pid_parse_response(clean, &parsed) == OBD_OK, "0100 parses");
+    TEST_ASSERT(parsed.data_len == 4 && (parsed.data[1] & 0x10) != 0, "0C is supported");
+    TEST_ASSERT((parsed.data[1] & 0x40) == 0, "0A is not");
+    TEST_ASSERT((parsed.data[3] & 0x01) != 0, "0120 answers too");
+
+    obd_emu_set_pid(&emu, 0x0A, &fuel_pressure, 1);
+    TEST_ASSERT(strcmp(ask("010A\r"), "41 0A 64\r\r>") == 0, "PID added");
+    ask_clean("0100\r", clean, sizeof(clean));
+    obd_pid_parse_response(clean, &parsed);
+    TEST_ASSERT((parsed.data[1] & 0x40) != 0, "bitmap updated");
+    TEST_ASSERT(strcmp(ask("01E0\r"), "NO DATA\r\r>") == 0, "no PIDs that high");
+    TEST_ASSERT(obd_emu_set_pid(&emu, 0x20, &fuel_pressure, 1) == OBD_ERROR_INVALID_ARG,
+                "bitmap PIDs are computed");
+
+    printf("  PASS: Mode 01\n");
+    return 0;
+}
+
+/* ── Test: headers, spaces, linefeeds through the session ──────────── */
+static int test_formatting(void)
+{
+    static obd_session_t session;
+    obd_session_result_t result;
+    char cmd[OBD_MAX_COMMAND_LEN];
+    const char *reply;
+    size_t len;
+
+    obd_emu_init(&emu);
+    ask("ATE0\r");
+    ask("ATH1\r");
+    ask("ATS0\r");
+    TEST_ASSERT(strcmp(ask("010C\r"), "7E804410C1AF8\r\r>") == 0, "headers, no spaces");
+    ask("ATS1\r");
+    ask("ATL1\r");
+    TEST_ASSERT(strcmp(ask("010D\r"), "7E8 03 41 0D 3C\r\n\r\n>") == 0, "headers, linefeeds");
+
+    /* The session takes the ECU id from the header */
+    obd_session_init(&session);
+    obd_session_submit_pid(&session, 0x01, 0x0C, 0, NULL);
+    obd_session_next_command(&session, 0, cmd, sizeof(cmd), &len);
+    obd_session_write_done(&session, 1);
+    reply = ask(cmd);
+    obd_session_feed(&session, reply, strlen(reply), 2);
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_OK, "session result");
+    TEST_ASSERT(result.status == OBD_OK && result.ecu == 0x7E8, "ECU 7E8");
+    TEST_ASSERT(result.has_value && result.value.value == TEST_EXPECTED_RPM, "RPM decoded");
+
+    printf("  PASS: formatting settings\n");
+    return 0;
+}
+
+/* ── Test: DTCs and VIN round-trip through the parsers ─────────────── */
+static int test_dtcs_and_vin(void)
+{
+    static obd_dtc_list_t list;
+    char clean[OBD_MAX_RESPONSE_LEN];
+    char vin[OBD_VIN_LENGTH + 1];
+    const uint16_t codes[] = { 0x0301, 0x0420 };
+
+    obd_emu_init(&emu);
+    ask("ATE0\r");
+    obd_emu_set_dtcs(&emu, codes, 2);
+    TEST_ASSERT(ask_clean("03\r", clean, sizeof(clean)) == OBD_OK, "03 answered");
+    TEST_ASSERT(obd_dtc_parse_response(clean, &list) == OBD_OK && list.count == 2, "2 DTCs");
+    TEST_ASSERT(strcmp(list.dtcs[0].formatted, "P0301") == 0, "P0301");
+    TEST_ASSERT(strcmp(list.dtcs[1].formatted, "P0420") == 0, "P0420");
+
+    TEST_ASSERT(strcmp(ask("04\r"), "44\r\r>") == 0, "clear");
+    ask_clean("03\r", clean, sizeof(clean));
+    TEST_ASSERT(strcmp(clean, TEST_CLEAN_DTC_NO_CODES) == 0, "cleared");
+
+    TEST_ASSERT(ask_clean("0902\r", clean, sizeof(clean)) == OBD_OK, "0902 answered");
+    TEST_ASSERT(obd_vin_parse_response(clean, vin, sizeof(vin)) == OBD_OK, "VIN parses");
+    TEST_ASSERT(strcmp(vin, TEST_EXPECTED_VIN) == 0, "VIN matches");
+    TEST_ASSERT(strcmp(ask("0A\r"), "NO DATA\r\r>") == 0, "unsupported mode");
+    TEST_ASSERT(strcmp(ask("HELLO\r"), "?\r\r>") == 0, "not a command");
+
+    printf("  PASS: DTCs and VIN\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== emu tests ===\n");
+    failures += test_matches_fixtures();
+    failures += test_mode01();
+    failures += test_formatting();
+    failures += test_dtcs_and_vin();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
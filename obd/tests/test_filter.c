@@ -0,0 +1,165 @@
+/**
+ * test_filter.c — Tests for the change filter.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MS 1000u
+#define S  1000000u
+
+static obd_filter_t filter;
+
+/* Filter one reply, given as cleaned hex */
+static obd_result_t reply(const char *hex, uint64_t t_us, obd_sensor_value_t *out)
+{
+    obd_pid_response_t response;
+
+    if (obd_pid_parse_response(hex, &response) != OBD_OK) return OBD_ERROR_PARSE_FAILED;
+    return obd_filter_decode(&filter, &response, t_us, out);
+}
+
+/* ── Test: steady cruise ───────────────────────────────────────────── */
+static int test_cruise(void)
+{
+    obd_sensor_value_t v;
+    char hex[32];
+    uint64_t t;
+    unsigned i, rpm, passed = 0;
+
+    obd_filter_init(&filter);
+    obd_filter_set(&filter, 0x0C, 25.0f, 0.0f, 10 * S);
+    obd_filter_set(&filter, 0x11, 1.0f, 0.0f, 10 * S);
+    filter.keepalive_us = 10 * S;                /* Speed and coolant: any change */
+
+    /* Ten minutes at 100 km/h, every PID every 500 ms. RPM wobbles by
+     * a few rpm, throttle by one count (0.4%). */
+    for (i = 0, t = 0; i < 1200; i++, t += 500 * MS) {
+        rpm = 8000 + (i % 7) * 4;               /* 2000-2006 rpm, in quarters */
+        snprintf(hex, sizeof(hex), "41 0C %02X %02X", rpm >> 8, rpm & 0xFF);
+        passed += reply(hex, t, &v) == OBD_OK;
+        passed += reply("41 0D 64", t, &v) == OBD_OK;
+        passed += reply("41 05 82", t, &v) == OBD_OK;
+        passed += reply(i % 3 ? "41 11 2E" : "41 11 2F", t, &v) == OBD_OK;
+    }
+    TEST_ASSERT(filter.samples == 4800 && filter.passed == passed, "counted");
+    TEST_ASSERT(passed * 10 < filter.samples, "an order of magnitude fewer updates");
+    TEST_ASSERT(filter.keepalives == passed - 4, "all but the first of each: keepalives");
+    TEST_ASSERT(filter.unchanged >= 2400, "speed and coolant never decoded twice");
+
+    printf("  PASS: steady cruise\n");
+    return 0;
+}
+
+/* ── Test: absolute and relative deadbands ─────────────────────────── */
+static int test_deadbands(void)
+{
+    obd_sensor_value_t v;
+
+    obd_filter_init(&filter);
+    obd_filter_set(&filter, 0x0C, 25.0f, 0.0f, 0);
+    TEST_ASSERT(reply("41 0C 0C 80", 0, &v) == OBD_OK && v.value == 800.0f, "first passes");
+    TEST_ASSERT(reply("41 0C 0C A8", 1, &v) == OBD_ERROR_NO_DATA && v.value == 810.0f,
+                "810: inside 25 rpm, but decoded");
+    TEST_ASSERT(reply("41 0C 0C D0", 2, &v) == OBD_ERROR_NO_DATA, "820: still inside");
+    TEST_ASSERT(reply("41 0C 0C F8", 3, &v) == OBD_OK && v.value == 830.0f,
+                "830: crept past 800 + 25");
+    TEST_ASSERT(reply("41 0C 0C 80", 4, &v) == OBD_OK, "back down 30 passes");
+
+    /* Throttle, 1% of the value: 50.2% needs more than 0.5 */
+    obd_filter_set(&filter, 0x11, 0.0f, 0.01f, 0);
+    TEST_ASSERT(reply("41 11 80", 0, &v) == OBD_OK, "50.2%");
+    TEST_ASSERT(reply("41 11 81", 1, &v) == OBD_ERROR_NO_DATA, "50.6%: 0.39 off");
+    TEST_ASSERT(reply("41 11 82", 2, &v) == OBD_OK, "51.0%: 0.78 off");
+
+    /* Unconfigured PID, default deadbands: any change */
+    TEST_ASSERT(reply("41 0D 10", 0, &v) == OBD_OK && reply("41 0D 10", 1, &v) ==
+                OBD_ERROR_NO_DATA && reply("41 0D 11", 2, &v) == OBD_OK, "defaults");
+    filter.abs_deadband = 5.0f;
+    TEST_ASSERT(reply("41 05 50", 0, &v) == OBD_OK && reply("41 05 54", 1, &v) ==
+                OBD_ERROR_NO_DATA, "new defaults for new PIDs");
+
+    printf("  PASS: deadbands\n");
+    return 0;
+}
+
+/* ── Test: unchanged bytes and keepalives ──────────────────────────── */
+static int test_keepalive(void)
+{
+    obd_sensor_value_t v;
+    uint64_t t;
+
+    obd_filter_init(&filter);
+    obd_filter_set(&filter, 0x05, 0.0f, 0.0f, 5 * S);
+    TEST_ASSERT(reply("41 05 82", 0, &v) == OBD_OK && v.value == 90.0f, "first");
+    for (t = 1; t < 5; t++) {
+        memset(&v, 0, sizeof(v));
+        TEST_ASSERT(reply("41 05 82", t * S, &v) == OBD_ERROR_NO_DATA && v.value == 0.0f,
+                    "same bytes: not decoded, nothing out");
+    }
+    TEST_ASSERT(filter.unchanged == 4, "four skipped");
+    TEST_ASSERT(reply("41 05 82", 5 * S, &v) == OBD_OK && v.value == 90.0f &&
+                strcmp(v.unit, "C") == 0 && filter.keepalives == 1,
+                "5 s of silence: the last value again");
+    TEST_ASSERT(reply("41 05 82", 6 * S, &v) == OBD_ERROR_NO_DATA, "silence restarts");
+    TEST_ASSERT(reply("41 05 83", 7 * S, &v) == OBD_OK && v.value == 91.0f,
+                "a change passes at once");
+    TEST_ASSERT(reply("41 05 83", 11 * S, &v) == OBD_ERROR_NO_DATA &&
+                reply("41 05 83", 12 * S, &v) == OBD_OK, "keepalive counts from the change");
+
+    printf("  PASS: unchanged bytes, keepalives\n");
+    return 0;
+}
+
+/* ── Test: values from elsewhere, errors, limits ───────────────────── */
+static int test_errors(void)
+{
+    obd_sensor_value_t v = { 0x0C, 800.0f, "Engine RPM", "rpm" };
+    obd_pid_response_t response;
+    unsigned pid;
+
+    obd_filter_init(&filter);
+    obd_filter_set(&filter, 0x0C, 25.0f, 0.0f, 0);
+    TEST_ASSERT(obd_filter_value(&filter, &v, 0) == OBD_OK, "value: first passes");
+    v.value = 810.0f;
+    TEST_ASSERT(obd_filter_value(&filter, &v, 1) == OBD_ERROR_NO_DATA, "value: deadband");
+
+    TEST_ASSERT(obd_filter_init(NULL) == OBD_ERROR_INVALID_ARG, "NULL init");
+    TEST_ASSERT(obd_filter_set(&filter, 0x0C, -1.0f, 0.0f, 0) == OBD_ERROR_INVALID_ARG &&
+                obd_filter_set(&filter, 0x0C, 0.0f, -0.1f, 0) == OBD_ERROR_INVALID_ARG,
+                "negative deadband");
+    TEST_ASSERT(obd_filter_decode(&filter, NULL, 0, &v) == OBD_ERROR_INVALID_ARG &&
+                obd_filter_value(&filter, NULL, 0) == OBD_ERROR_INVALID_ARG, "NULL");
+
+    obd_pid_parse_response("41 E0 01", &response);
+    TEST_ASSERT(obd_filter_decode(&filter, &response, 0, &v) == OBD_ERROR_UNKNOWN_PID,
+                "decode errors come through");
+
+    for (pid = 0x40; filter.count < OBD_FILTER_MAX_PIDS; pid++) {
+        obd_filter_set(&filter, (uint8_t)pid, 1.0f, 0.0f, 0);
+    }
+    TEST_ASSERT(obd_filter_set(&filter, 0x05, 1.0f, 0.0f, 0) == OBD_ERROR_BUFFER_TOO_SMALL,
+                "full");
+    TEST_ASSERT(reply("41 05 82", 0, &v) == OBD_OK && reply("41 05 82", 1, &v) == OBD_OK,
+                "past the table: unfiltered");
+
+    printf("  PASS: errors and limits\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== filter tests ===\n");
+    failures += test_cruise();
+    failures += test_deadbands();
+    failures += test_keepalive();
+    failures += test_errors();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
@@ -0,0 +1,338 @@
+/**
+ * test_fleet.c — Tests for the multi-adapter event loop.
+ *
+ * Each "adapter" is an emulator on the slave side of a pty; the fleet
+ * gets the master side, just like a USB ELM327's /dev/ttyUSBn. spin()
+ * alternates fleet steps with letting the emulators answer. The same
+ * tests run on both backends, and on socketpairs (a WiFi adapter's TCP
+ * connection, as far as the fleet can tell) as well as ptys.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <obd/obd_io.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <stdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define ADAPTERS 4
+
+static obd_fleet_t fleet;
+static obd_fleet_adapter_t slots[ADAPTERS];
+static obd_emu_t emus[ADAPTERS];
+static int masters[ADAPTERS], cars[ADAPTERS];
+static int answering[ADAPTERS];         /* 0 = this car never replies */
+
+/* What the callback saw */
+static size_t results[ADAPTERS];
+static size_t chain_to;                 /* Submit again until this many */
+static obd_session_result_t last[ADAPTERS];
+static size_t lost_calls;
+
+static void on_result(void *ctx, size_t index, const obd_session_result_t *res)
+{
+    (void)ctx;
+    if (res->status == OBD_ERROR_IO && res->id == 0) {
+        lost_calls++;
+        return;
+    }
+    results[index]++;
+    last[index] = *res;
+    if (results[index] < chain_to) {
+        obd_fleet_submit_pid(&fleet, index, 0x01, 0x0C, obd_io_now_us(), NULL);
+    }
+}
+
+static void serve_emulators(void)
+{
+    char in[256], out[1024];
+    size_t i, n_out;
+    ssize_t n;
+
+    for (i = 0; i < ADAPTERS; i++) {
+        if (cars[i] < 0) continue;
+        while ((n = read(cars[i], in, sizeof(in))) > 0) {
+            if (!answering[i]) continue;
+            n_out = 0;
+            obd_emu_feed(&emus[i], in, (size_t)n, out, sizeof(out), &n_out);
+            if (write(cars[i], out, n_out) != (ssize_t)n_out) return;
+        }
+    }
+}
+
+static void spin(int steps)
+{
+    int i;
+    for (i = 0; i < steps; i++) {
+        obd_fleet_step(&fleet, 1);
+        serve_emulators();
+    }
+}
+
+/* A connected socket pair, both ends non-blocking */
+static int socket_open(int *fleet_end, int *car_end)
+{
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) < 0) return 0;
+    *fleet_end = sv[0];
+    *car_end = sv[1];
+    return 1;
+}
+
+static int setup(size_t capacity, obd_fleet_backend_t backend, int sockets)
+{
+    size_t i, index;
+
+    for (i = 0; i < ADAPTERS; i++) {
+        if (cars[i] >= 0) close(cars[i]);
+        if (masters[i] >= 0) close(masters[i]);
+        cars[i] = masters[i] = -1;
+    }
+    obd_fleet_close(&fleet);
+    memset(results, 0, sizeof(results));
+    lost_calls = 0;
+    chain_to = 0;
+
+    if (obd_fleet_init(&fleet, slots, capacity, on_result, NULL) != OBD_OK) return 0;
+    if (obd_fleet_set_backend(&fleet, backend) != OBD_OK) return 0;
+    for (i = 0; i < capacity; i++) {
+        if (sockets ? !socket_open(&masters[i], &cars[i])
+                    : obd_pty_open(&masters[i], &cars[i]) != OBD_OK) return 0;
+        obd_emu_init(&emus[i]);
+        emus[i].echo = 0;                /* As if ATE0 had been sent */
+        answering[i] = 1;
+        if (obd_fleet_add(&fleet, masters[i], &index) != OBD_OK || index != i) return 0;
+    }
+    return 1;
+}
+
+/* ── Test: requests on every adapter, chained from the callback ────── */
+static int round_trips(obd_fleet_backend_t backend, int sockets)
+{
+    size_t i, total = 0;
+
+    TEST_ASSERT(setup(ADAPTERS, backend, sockets), "four adapters");
+    TEST_ASSERT(fleet.open_count == ADAPTERS, "all open");
+
+    chain_to = 5;
+    for (i = 0; i < ADAPTERS; i++) {
+        TEST_ASSERT(obd_fleet_submit_pid(&fleet, i, 0x01, 0x0C, obd_io_now_us(), NULL) == OBD_OK,
+                    "submitted");
+    }
+    spin(200);
+
+    for (i = 0; i < ADAPTERS; i++) {
+        total += results[i];
+        TEST_ASSERT(results[i] == 5, "five each");
+        TEST_ASSERT(last[i].status == OBD_OK && last[i].has_value &&
+                    last[i].value.value == TEST_EXPECTED_RPM, "RPM decoded");
+        TEST_ASSERT(emus[i].obd_requests == 5, "each car asked five times");
+    }
+    TEST_ASSERT(fleet.stats.results == total && fleet.stats.timeouts == 0, "counted");
+    TEST_ASSERT(obd_wheel_count(&fleet.wheel) == 0, "no deadlines left");
+    TEST_ASSERT(fleet.stats.syscalls > 0, "syscalls counted");
+
+    printf("  PASS: round trips, %s over %s\n",
+           obd_fleet_backend_name(obd_fleet_backend(&fleet)), sockets ? "sockets" : "ptys");
+    return 0;
+}
+
+static int test_round_trips(void)
+{
+    return round_trips(OBD_FLEET_EPOLL, 0) + round_trips(OBD_FLEET_URING, 0) +
+           round_trips(OBD_FLEET_EPOLL, 1) + round_trips(OBD_FLEET_URING, 1);
+}
+
+/* ── Test: a car that never answers times out via the wheel ────────── */
+static int timeout(obd_fleet_backend_t backend)
+{
+    uint64_t start;
+
+    TEST_ASSERT(setup(2, backend, 0), "setup");
+    answering[1] = 0;
+    obd_session_set_timeout(obd_fleet_session(&fleet, 1), 20000);
+
+    obd_fleet_submit_pid(&fleet, 0, 0x01, 0x0D, obd_io_now_us(), NULL);
+    obd_fleet_submit_pid(&fleet, 1, 0x01, 0x0D, obd_io_now_us(), NULL);
+    TEST_ASSERT(obd_wheel_count(&fleet.wheel) == 2, "both deadlines on the wheel");
+
+    start = obd_io_now_us();
+    while (results[1] == 0 && obd_io_now_us() - start < 1000000u) spin(1);
+
+    TEST_ASSERT(results[0] == 1 && last[0].status == OBD_OK, "answering car fine");
+    TEST_ASSERT(results[1] == 1 && last[1].status == OBD_ERROR_TIMEOUT, "silent car timed out");
+    TEST_ASSERT(obd_io_now_us() - start >= 20000u, "not before its timeout");
+    TEST_ASSERT(fleet.stats.timeouts == 1 && fleet.stats.timer_fires >= 1, "counted");
+
+    printf("  PASS: timeouts, %s\n", obd_fleet_backend_name(obd_fleet_backend(&fleet)));
+    return 0;
+}
+
+static int test_timeout(void)
+{
+    return timeout(OBD_FLEET_EPOLL) + timeout(OBD_FLEET_URING);
+}
+
+/* ── Test: a car that goes away; slots are reused ──────────────────── */
+static int lost_adapter(obd_fleet_backend_t backend, int sockets)
+{
+    size_t index;
+    int m, c;
+
+    TEST_ASSERT(setup(2, backend, sockets), "setup");
+    close(cars[1]);
+    cars[1] = -1;
+    obd_fleet_submit_pid(&fleet, 1, 0x01, 0x0C, obd_io_now_us(), NULL);
+    spin(5);
+
+    TEST_ASSERT(lost_calls == 1, "told once");
+    TEST_ASSERT(slots[1].state == OBD_FLEET_LOST && fleet.open_count == 1, "marked lost");
+    TEST_ASSERT(obd_fleet_submit_pid(&fleet, 1, 0x01, 0x0C, 0, NULL) == OBD_ERROR_IO,
+                "no more requests");
+
+    /* Full until the lost one is removed */
+    TEST_ASSERT(sockets ? socket_open(&m, &c) : obd_pty_open(&m, &c) == OBD_OK,
+                "another adapter");
+    TEST_ASSERT(obd_fleet_add(&fleet, m, &index) == OBD_ERROR_BUSY, "full");
+    TEST_ASSERT(obd_fleet_remove(&fleet, 1) == OBD_OK, "removed");
+    close(masters[1]);
+    masters[1] = m;
+    cars[1] = c;
+    obd_emu_init(&emus[1]);
+    emus[1].echo = 0;
+    TEST_ASSERT(obd_fleet_add(&fleet, m, &index) == OBD_OK && index == 1, "slot reused");
+
+    obd_fleet_submit_pid(&fleet, 1, 0x01, 0x0C, obd_io_now_us(), NULL);
+    spin(20);
+    TEST_ASSERT(results[1] == 1 && last[1].status == OBD_OK, "new car answers");
+
+    printf("  PASS: lost adapters, %s over %s\n",
+           obd_fleet_backend_name(obd_fleet_backend(&fleet)), sockets ? "sockets" : "ptys");
+    return 0;
+}
+
+static int test_lost_adapter(void)
+{
+    return lost_adapter(OBD_FLEET_EPOLL, 0) + lost_adapter(OBD_FLEET_URING, 0) +
+           lost_adapter(OBD_FLEET_URING, 1);
+}
+
+/* ── Test: a command that only partly fits goes out in two writes ──── */
+
+/* Single bytes until the pty takes no more, twice in case it was still
+ * moving bytes over to the far side */
+static size_t fill(int fd)
+{
+    size_t n = 0;
+    int pass;
+    char c = 'x';
+
+    for (pass = 0; pass < 2; pass++) {
+        while (write(fd, &c, 1) == 1) n++;
+        obd_fleet_step(&fleet, 5);
+    }
+    return n;
+}
+
+static int short_write(obd_fleet_backend_t backend)
+{
+    char junk[256];
+    size_t i, room, filler, got = 0;
+    ssize_t n;
+    uint64_t start;
+    int m, c;
+
+    /* How much taking one byte off a full pty makes room for */
+    TEST_ASSERT(setup(1, backend, 0) && obd_pty_open(&m, &c) == OBD_OK, "setup");
+    fill(m);
+    TEST_ASSERT(read(c, junk, 1) == 1, "one byte off");
+    room = fill(m);
+    close(m);
+    close(c);
+    TEST_ASSERT(room > 2, "room made");
+
+    /* The same on the adapter's pty, less two: "010C\r" gets two bytes in */
+    filler = fill(masters[0]) - 1;
+    TEST_ASSERT(read(cars[0], junk, 1) == 1, "one byte off");
+    start = obd_io_now_us();
+    for (i = 0; i + 2 < room && obd_io_now_us() - start < 1000000u; ) {
+        if (write(masters[0], "x", 1) == 1) i++;
+        else obd_fleet_step(&fleet, 1);     /* The room shows up a moment later */
+    }
+    filler += i;
+    TEST_ASSERT(i + 2 == room, "two bytes of room");
+
+    /* Not spin(): the car isn't reading yet */
+    obd_fleet_submit_pid(&fleet, 0, 0x01, 0x0C, obd_io_now_us(), NULL);
+    for (i = 0; i < 5; i++) obd_fleet_step(&fleet, 1);
+
+    /* The car catches up on the filler; the rest of the command follows */
+    start = obd_io_now_us();
+    while (got < filler && obd_io_now_us() - start < 1000000u) {
+        n = read(cars[0], junk, filler - got < sizeof(junk) ? filler - got : sizeof(junk));
+        if (n > 0) got += (size_t)n;
+        else obd_fleet_step(&fleet, 1);
+    }
+    TEST_ASSERT(got == filler, "filler drained");
+    TEST_ASSERT(backend == OBD_FLEET_EPOLL || slots[0].read_armed, "a read waits for the reply");
+    spin(50);
+
+    TEST_ASSERT(fleet.stats.writes >= 2, "the command went in more than one write");
+    TEST_ASSERT(results[0] == 1 && last[0].status == OBD_OK && last[0].has_value &&
+                last[0].value.value == TEST_EXPECTED_RPM, "reply still read");
+
+    printf("  PASS: short writes, %s\n", obd_fleet_backend_name(obd_fleet_backend(&fleet)));
+    return 0;
+}
+
+static int test_short_write(void)
+{
+    return short_write(OBD_FLEET_EPOLL) + short_write(OBD_FLEET_URING);
+}
+
+/* ── Test: choosing the backend ────────────────────────────────────── */
+static int test_backend(void)
+{
+    TEST_ASSERT(setup(1, OBD_FLEET_EPOLL, 0), "setup");
+    TEST_ASSERT(obd_fleet_backend(&fleet) == OBD_FLEET_EPOLL, "epoll by default");
+    TEST_ASSERT(obd_fleet_set_backend(&fleet, OBD_FLEET_URING) == OBD_ERROR_BUSY,
+                "not once adapters are in");
+    TEST_ASSERT(obd_fleet_set_backend(NULL, OBD_FLEET_URING) == OBD_ERROR_INVALID_ARG, "NULL");
+    TEST_ASSERT(strcmp(obd_fleet_backend_name(OBD_FLEET_EPOLL), "epoll") == 0 &&
+                strcmp(obd_fleet_backend_name(OBD_FLEET_URING), "io_uring") == 0, "names");
+
+    /* Empty again: switching both ways is fine (io_uring only if the kernel has it) */
+    TEST_ASSERT(obd_fleet_remove(&fleet, 0) == OBD_OK, "removed");
+    TEST_ASSERT(obd_fleet_set_backend(&fleet, OBD_FLEET_URING) == OBD_OK, "to io_uring");
+    TEST_ASSERT(obd_fleet_set_backend(&fleet, OBD_FLEET_EPOLL) == OBD_OK &&
+                obd_fleet_backend(&fleet) == OBD_FLEET_EPOLL, "and back");
+    TEST_ASSERT(fleet.uring.fd == -1, "ring closed");
+
+    printf("  PASS: backend selection\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+    size_t i;
+
+    for (i = 0; i < ADAPTERS; i++) cars[i] = masters[i] = -1;
+    fleet.epoll_fd = -1;
+
+    printf("=== fleet tests ===\n");
+    failures += test_round_trips();
+    failures += test_timeout();
+    failures += test_lost_adapter();
+    failures += test_short_write();
+    failures += test_backend();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 5);
+    return failures;
+}
@@ -0,0 +1,155 @@
+/**
+ * test_freeze.c — Tests for Mode 02 freeze frames.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FLOAT_NEAR(a, b, tolerance) (fabs((double)(a) - (double)(b)) < (tolerance))
+
+/* Expect next_request() to ask for `want`, then feed it `reply` */
+static int step(obd_freeze_frame_t *snap, const char *want, const char *reply)
+{
+    char cmd[OBD_MAX_COMMAND_LEN];
+
+    TEST_ASSERT(obd_freeze_next_request(snap, cmd, sizeof(cmd)) == OBD_OK,
+                "snapshot should still need something");
+    TEST_ASSERT(strcmp(cmd, want) == 0, want);
+    TEST_ASSERT(obd_freeze_parse_response(reply, snap) == OBD_OK, "reply should decode");
+    return 0;
+}
+
+/* ── Test: build requests ──────────────────────────────────────────── */
+static int test_build_request(void)
+{
+    static const uint8_t pids[] = { 0x0C, 0x0D, 0x05, 0x11 };
+    char buf[OBD_MAX_COMMAND_LEN];
+    obd_result_t r;
+
+    r = obd_freeze_build_request(pids, 1, 0, buf, sizeof(buf));
+    TEST_ASSERT(r == OBD_OK && strcmp(buf, "020C00\r") == 0, "one PID, frame 0");
+
+    r = obd_freeze_build_request(pids, 3, 1, buf, sizeof(buf));
+    TEST_ASSERT(r == OBD_OK && strcmp(buf, "020C010D010501\r") == 0, "three PIDs, frame 1");
+
+    r = obd_freeze_build_request(pids, 4, 0, buf, sizeof(buf));
+    TEST_ASSERT(r == OBD_ERROR_INVALID_ARG, "four PIDs don't fit a CAN frame");
+    r = obd_freeze_build_request(pids, 2, 0, buf, 8);
+    TEST_ASSERT(r == OBD_ERROR_BUFFER_TOO_SMALL, "small buffer should error");
+
+    printf("  PASS: build Mode 02 request\n");
+    return 0;
+}
+
+/* ── Test: a whole frame in six round trips ────────────────────────── */
+static int test_whole_frame(void)
+{
+    obd_freeze_frame_t snap;
+    const obd_freeze_value_t *v;
+    char cmd[OBD_MAX_COMMAND_LEN];
+
+    TEST_ASSERT(obd_freeze_init(&snap, 0, OBD_FREEZE_MAX_BATCH) == OBD_OK, "init");
+
+    if (step(&snap, "02000020004000\r", TEST_CLEAN_FREEZE_SUPPORTED)) return 1;
+    if (step(&snap, "02020004000500\r", TEST_CLEAN_FREEZE_DTC_LOAD)) return 1;
+    if (step(&snap, "02060007000B00\r", TEST_CLEAN_FREEZE_TRIMS)) return 1;
+    if (step(&snap, "020C000D000E00\r", TEST_CLEAN_FREEZE_RPM)) return 1;
+    if (step(&snap, "020F0010001100\r", TEST_CLEAN_FREEZE_AIR)) return 1;
+    if (step(&snap, "021F0021002F00\r", TEST_CLEAN_FREEZE_MISC)) return 1;
+    TEST_ASSERT(obd_freeze_next_request(&snap, cmd, sizeof(cmd)) == OBD_ERROR_NO_DATA,
+                "frame complete after six requests");
+
+    TEST_ASSERT(snap.has_dtc && strcmp(snap.dtc.formatted, "P0301") == 0, "trigger DTC");
+    TEST_ASSERT(snap.count == 14, "14 PIDs besides the DTC");
+
+    v = obd_freeze_find(&snap, 0x0C);
+    TEST_ASSERT(v && v->has_value && v->value == TEST_EXPECTED_RPM, "RPM");
+    TEST_ASSERT(v->raw.data_len == 2 && v->raw.data[0] == 0x1A, "raw RPM bytes, no frame byte");
+    v = obd_freeze_find(&snap, 0x05);
+    TEST_ASSERT(v && v->value == TEST_EXPECTED_COOLANT, "coolant");
+    v = obd_freeze_find(&snap, 0x10);
+    TEST_ASSERT(v && FLOAT_NEAR(v->value, TEST_EXPECTED_MAF, 0.01), "MAF");
+    v = obd_freeze_find(&snap, 0x21);
+    TEST_ASSERT(v && !v->has_value && v->raw.data_len == 2 && v->raw.data[1] == 0x2A,
+                "PID 21 raw only");
+    TEST_ASSERT(obd_freeze_find(&snap, 0x2F)->raw.data[0] == 0x80, "PID 2F raw");
+    TEST_ASSERT(obd_freeze_find(&snap, 0x03) == NULL, "PID 03 not stored");
+
+    printf("  PASS: whole frame, 6 round trips\n");
+    return 0;
+}
+
+/* ── Test: one PID per request, no frame stored ────────────────────── */
+static int test_no_frame(void)
+{
+    obd_freeze_frame_t snap;
+    char cmd[OBD_MAX_COMMAND_LEN];
+
+    obd_freeze_init(&snap, 0, 1);
+    if (step(&snap, "020000\r", "42 00 00 40 00 00 00")) return 1;   /* Only PID 02 */
+    if (step(&snap, "020200\r", "42 02 00 00 00")) return 1;
+    TEST_ASSERT(!snap.has_dtc, "0000: no DTC stored a frame");
+    TEST_ASSERT(obd_freeze_next_request(&snap, cmd, sizeof(cmd)) == OBD_ERROR_NO_DATA,
+                "nothing more to read");
+
+    printf("  PASS: no frame stored\n");
+    return 0;
+}
+
+/* ── Test: several ECUs, skipped requests, bad replies ─────────────── */
+static int test_edges(void)
+{
+    obd_freeze_frame_t snap;
+    char cmd[OBD_MAX_COMMAND_LEN];
+
+    obd_freeze_init(&snap, 0, OBD_FREEZE_MAX_BATCH);
+
+    /* Lowest CAN id wins, whatever the order */
+    TEST_ASSERT(obd_freeze_parse_response("7E9 05 42 0C 00 00 00\r7E8 05 42 0C 00 1A F8",
+                                          &snap) == OBD_OK, "two ECUs");
+    TEST_ASSERT(snap.ecu == 0x7E8 && obd_freeze_find(&snap, 0x0C)->value == TEST_EXPECTED_RPM,
+                "7E8's frame");
+
+    /* A PID past the length table, asked alone: the rest is its data */
+    TEST_ASSERT(obd_freeze_parse_response("42 62 00 7D", &snap) == OBD_OK, "PID 62");
+    TEST_ASSERT(obd_freeze_find(&snap, 0x62)->raw.data_len == 1, "one byte");
+
+    TEST_ASSERT(obd_freeze_parse_response("42 0C 01 1A F8", &snap) == OBD_ERROR_PARSE_FAILED,
+                "frame 1 when frame 0 was asked for");
+    TEST_ASSERT(obd_freeze_parse_response("42 0C 00 1A F8 0D 00", &snap) ==
+                OBD_ERROR_PARSE_FAILED, "truncated second PID");
+    TEST_ASSERT(obd_freeze_parse_response(TEST_CLEAN_RPM, &snap) == OBD_ERROR_PARSE_FAILED,
+                "Mode 01 reply");
+
+    /* A request that never got an answer isn't repeated */
+    TEST_ASSERT(obd_freeze_next_request(&snap, cmd, sizeof(cmd)) == OBD_OK &&
+                strcmp(cmd, "02000020004000\r") == 0, "bitmaps asked");
+    TEST_ASSERT(obd_freeze_skip_request(&snap) == OBD_OK, "skip");
+    TEST_ASSERT(obd_freeze_next_request(&snap, cmd, sizeof(cmd)) == OBD_ERROR_NO_DATA,
+                "nothing known to be supported");
+
+    TEST_ASSERT(obd_freeze_init(&snap, 0, 4) == OBD_ERROR_INVALID_ARG, "batch of 4");
+    TEST_ASSERT(obd_freeze_parse_response(NULL, &snap) == OBD_ERROR_INVALID_ARG, "NULL");
+
+    printf("  PASS: ECUs, skips, bad replies\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== freeze tests ===\n");
+    failures += test_build_request();
+    failures += test_whole_frame();
+    failures += test_no_frame();
+    failures += test_edges();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
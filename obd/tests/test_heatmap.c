@@ -0,0 +1,212 @@
+/**
+ * test_heatmap.c — Tests for operating-point heatmaps.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const float rpm_edges[]  = { 0, 1000, 2000, 3000, 4000, 6000, 8000 };
+static const float load_edges[] = { 0, 20, 40, 60, 80, 100 };
+
+static obd_heatmap_t h, other;
+
+/* The bin a linear search would give, clamped like the heatmap */
+static size_t search(const float *edges, size_t bins, float v)
+{
+    size_t b = 0;
+    while (b + 1 < bins && v >= edges[b + 1]) b++;
+    return b;
+}
+
+/* ── Test: bins, edges, clamping ───────────────────────────────────── */
+static int test_bins(void)
+{
+    TEST_ASSERT(obd_heatmap_init(&h, 0x0C, rpm_edges, 6, 0x04, load_edges, 5) == OBD_OK, "init");
+
+    obd_heatmap_add(&h, 1726.0f, 35.0f);
+    TEST_ASSERT(obd_heatmap_cell(&h, 1, 1) == 1, "1726 rpm, 35% → (1, 1)");
+    obd_heatmap_add(&h, 1000.0f, 20.0f);
+    TEST_ASSERT(obd_heatmap_cell(&h, 1, 1) == 2, "an edge belongs to the bin above it");
+    obd_heatmap_add(&h, 999.99f, 19.99f);
+    TEST_ASSERT(obd_heatmap_cell(&h, 0, 0) == 1, "just below");
+    obd_heatmap_add(&h, 9000.0f, 100.0f);
+    obd_heatmap_add(&h, 8000.0f, 150.0f);
+    TEST_ASSERT(obd_heatmap_cell(&h, 5, 4) == 2, "last edge and above: last bin");
+    obd_heatmap_add(&h, -50.0f, -INFINITY);
+    TEST_ASSERT(obd_heatmap_cell(&h, 0, 0) == 2, "below: first bin");
+    TEST_ASSERT(obd_heatmap_add(&h, NAN, 10.0f) == OBD_ERROR_INVALID_ARG, "NaN");
+    TEST_ASSERT(h.total == 6 && h.dropped == 1, "6 counted, 1 dropped");
+    TEST_ASSERT(obd_heatmap_cell(&h, 6, 0) == 0 && obd_heatmap_cell(&h, 0, 5) == 0,
+                "outside the grid");
+
+    TEST_ASSERT(obd_heatmap_clear(&h) == OBD_OK && h.total == 0 &&
+                obd_heatmap_cell(&h, 1, 1) == 0 && h.x.bins == 6, "clear keeps the axes");
+
+    printf("  PASS: bins and edges\n");
+    return 0;
+}
+
+/* ── Test: table lookup agrees with a search, everywhere ───────────── */
+static int test_lookup(void)
+{
+    /* Uneven edges, including bins close to the narrowest allowed */
+    static const float edges[] = { -40, -38, -35, 0, 2, 60, 90, 95, 97.5f, 215 };
+    size_t i, bad = 0, xb, total = 0;
+
+    TEST_ASSERT(obd_heatmap_init(&h, 0x05, edges, 9, 0x0C, rpm_edges, 6) == OBD_OK,
+                "coolant axis");
+    for (i = 0; i <= 200000; i++) {
+        float v = -50.0f + (float)i * 0.0013f;
+        obd_heatmap_clear(&h);
+        obd_heatmap_add(&h, v, 0.0f);
+        if (obd_heatmap_cell(&h, search(edges, 9, v), 0) != 1) bad++;
+    }
+    TEST_ASSERT(bad == 0, "every value in its searched bin");
+
+    /* Each edge and the floats either side of it */
+    for (i = 0; i <= 9; i++) {
+        float around[3];
+        size_t k;
+        around[0] = nextafterf(edges[i], -INFINITY);
+        around[1] = edges[i];
+        around[2] = nextafterf(edges[i], INFINITY);
+        for (k = 0; k < 3; k++) {
+            obd_heatmap_clear(&h);
+            obd_heatmap_add(&h, around[k], 0.0f);
+            if (obd_heatmap_cell(&h, search(edges, 9, around[k]), 0) != 1) bad++;
+        }
+    }
+    TEST_ASSERT(bad == 0, "at the edges");
+
+    /* A batch counts the same */
+    {
+        static float x[1000], y[1000];
+        for (i = 0; i < 1000; i++) {
+            x[i] = -45.0f + (float)(i % 260);
+            y[i] = (float)(i * 9);
+        }
+        x[7] = NAN;
+        obd_heatmap_clear(&h);
+        TEST_ASSERT(obd_heatmap_add_batch(&h, x, y, 1000) == OBD_OK, "batch");
+        for (xb = 0; xb < 9; xb++) total += obd_heatmap_cell(&h, xb, 5);
+        TEST_ASSERT(h.total == 999 && h.dropped == 1, "999 counted");
+        TEST_ASSERT(total == 333, "y ≥ 6000 in the last row");
+    }
+
+    printf("  PASS: table lookup\n");
+    return 0;
+}
+
+/* ── Test: feeding decoded values and resampled rows ───────────────── */
+static int test_feed(void)
+{
+    obd_pid_response_t pid;
+    obd_sensor_value_t value;
+    obd_resample_row_t row;
+
+    obd_heatmap_init(&h, 0x0C, rpm_edges, 6, 0x0D, load_edges, 5);
+
+    obd_pid_parse_response(TEST_CLEAN_RPM, &pid);
+    obd_sensor_decode(&pid, &value);
+    TEST_ASSERT(obd_heatmap_feed_sensor(&h, &value) == OBD_OK && h.total == 0, "half a pair");
+    obd_pid_parse_response(TEST_CLEAN_SPEED, &pid);
+    obd_sensor_decode(&pid, &value);
+    TEST_ASSERT(obd_heatmap_feed_sensor(&h, &value) == OBD_OK && h.total == 1, "pair counted");
+    TEST_ASSERT(obd_heatmap_cell(&h, 1, 3) == 1, "1726 rpm, 60 km/h");
+
+    TEST_ASSERT(obd_heatmap_feed(&h, 0x05, 90.0f) == OBD_ERROR_UNKNOWN_PID, "not an axis");
+    obd_heatmap_feed(&h, 0x0C, 800.0f);
+    obd_heatmap_feed(&h, 0x0C, 850.0f);
+    obd_heatmap_feed(&h, 0x0D, 0.0f);
+    TEST_ASSERT(h.total == 2 && obd_heatmap_cell(&h, 0, 0) == 1, "newest x pairs up");
+
+    memset(&row, 0, sizeof(row));
+    row.valid = 0x5;
+    row.values[0] = 2500.0f;
+    row.values[2] = 90.0f;
+    TEST_ASSERT(obd_heatmap_add_row(&h, &row, 0, 2) == OBD_OK &&
+                obd_heatmap_cell(&h, 2, 4) == 1, "row columns 0 and 2");
+    TEST_ASSERT(obd_heatmap_add_row(&h, &row, 0, 1) == OBD_ERROR_NO_DATA, "column 1 empty");
+    TEST_ASSERT(obd_heatmap_add_row(&h, &row, 0, OBD_RESAMPLE_MAX_CHANNELS) ==
+                OBD_ERROR_INVALID_ARG, "no such column");
+
+    printf("  PASS: feeding\n");
+    return 0;
+}
+
+/* ── Test: merge, export, bad axes ─────────────────────────────────── */
+static int test_merge_export(void)
+{
+    static char out[32768];
+    static const float narrow[] = { 0, 1, 1000 };
+    static const float flat[] = { 5, 5 };
+    static const float down[] = { 0, 10, 5 };
+    size_t i;
+
+    obd_heatmap_init(&h, 0x0C, rpm_edges, 6, 0x04, load_edges, 5);
+    obd_heatmap_init(&other, 0x0C, rpm_edges, 6, 0x04, load_edges, 5);
+    obd_heatmap_add(&h, 2500.0f, 50.0f);
+    obd_heatmap_add(&other, 2500.0f, 50.0f);
+    obd_heatmap_add(&other, 7000.0f, 90.0f);
+    other.counts[0] = UINT32_MAX - 1;
+    h.counts[0] = 5;
+
+    TEST_ASSERT(obd_heatmap_merge(&h, &other) == OBD_OK, "merge");
+    TEST_ASSERT(obd_heatmap_cell(&h, 2, 2) == 2 && obd_heatmap_cell(&h, 5, 4) == 1, "added");
+    TEST_ASSERT(h.counts[0] == UINT32_MAX, "saturated");
+    TEST_ASSERT(h.total == 3, "totals");
+
+    TEST_ASSERT(obd_heatmap_format_csv(&h, out, sizeof(out)) == OBD_OK, "csv");
+    TEST_ASSERT(strncmp(out, "y\\x,0,1000,2000,3000,4000,6000\n", 31) == 0, "csv header");
+    TEST_ASSERT(strstr(out, "\n40,0,0,2,0,0,0\n") != NULL, "csv row");
+    TEST_ASSERT(obd_heatmap_format_json(&h, out, sizeof(out)) == OBD_OK, "json");
+    TEST_ASSERT(strstr(out, "\"channel\": 12") && strstr(out, "[2, 2, 2]") &&
+                strstr(out, "\"total\": 3"), "json content");
+
+    /* The biggest there can be, every cell at its maximum */
+    {
+        static float edges[OBD_HEATMAP_MAX_BINS + 1];
+        for (i = 0; i <= OBD_HEATMAP_MAX_BINS; i++) edges[i] = 1000.5f * (float)i - 40000.25f;
+        obd_heatmap_init(&h, 0xFFFF, edges, OBD_HEATMAP_MAX_BINS,
+                         0xFFFF, edges, OBD_HEATMAP_MAX_BINS);
+        for (i = 0; i < OBD_HEATMAP_MAX_BINS * OBD_HEATMAP_MAX_BINS; i++) h.counts[i] = UINT32_MAX;
+        TEST_ASSERT(obd_heatmap_format_csv(&h, out, 16384) == OBD_OK, "16 KB csv");
+        TEST_ASSERT(obd_heatmap_format_json(&h, out, 32768) == OBD_OK, "32 KB json");
+        TEST_ASSERT(obd_heatmap_format_json(&h, out, 100) == OBD_ERROR_BUFFER_TOO_SMALL &&
+                    out[0] == '\0', "too small");
+    }
+
+    TEST_ASSERT(obd_heatmap_init(&other, 0x0C, narrow, 2, 0x04, load_edges, 5) ==
+                OBD_ERROR_INVALID_ARG, "bin too narrow");
+    TEST_ASSERT(obd_heatmap_init(&other, 0x0C, flat, 1, 0x04, load_edges, 5) ==
+                OBD_ERROR_INVALID_ARG, "empty range");
+    TEST_ASSERT(obd_heatmap_init(&other, 0x0C, down, 2, 0x04, load_edges, 5) ==
+                OBD_ERROR_INVALID_ARG, "not increasing");
+    TEST_ASSERT(obd_heatmap_init(&other, 0x0C, rpm_edges, 0, 0x04, load_edges, 5) ==
+                OBD_ERROR_INVALID_ARG, "no bins");
+    obd_heatmap_init(&other, 0x0C, rpm_edges, 5, 0x04, load_edges, 5);
+    obd_heatmap_init(&h, 0x0C, rpm_edges, 6, 0x04, load_edges, 5);
+    TEST_ASSERT(obd_heatmap_merge(&h, &other) == OBD_ERROR_INVALID_ARG, "different edges");
+
+    printf("  PASS: merge and export\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== heatmap tests ===\n");
+    failures += test_bins();
+    failures += test_lookup();
+    failures += test_feed();
+    failures += test_merge_export();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
@@ -0,0 +1,146 @@
+/**
+ * test_info.c — Tests for Mode 09 vehicle information and the vehicle profile.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Expect next_request() to ask for `want` ("0904\r"), then feed it `reply` */
+static int step(obd_vehicle_profile_t *profile, const char *want, const char *reply)
+{
+    char cmd[OBD_MAX_COMMAND_LEN];
+
+    TEST_ASSERT(obd_info_next_request(profile, cmd, sizeof(cmd)) == OBD_OK,
+                "profile should still need something");
+    TEST_ASSERT(strcmp(cmd, want) == 0, want);
+    TEST_ASSERT(obd_info_parse_response(reply, profile) == OBD_OK, "reply should merge");
+    return 0;
+}
+
+/* ── Test: read a whole profile, then reconnect ────────────────────── */
+static int test_profile_flow(void)
+{
+    obd_vehicle_profile_t profile;
+    char cmd[OBD_MAX_COMMAND_LEN];
+
+    TEST_ASSERT(obd_info_profile_init(&profile) == OBD_OK, "init");
+
+    if (step(&profile, "0900\r", TEST_CLEAN_INFO_SUPPORTED)) return 1;
+    if (step(&profile, "0902\r", TEST_CLEAN_INFO_VIN)) return 1;
+    if (step(&profile, "0904\r", TEST_CLEAN_INFO_CALID)) return 1;
+    if (step(&profile, "0906\r", TEST_CLEAN_INFO_CVN)) return 1;
+    if (step(&profile, "090A\r", TEST_CLEAN_INFO_ECU_NAME)) return 1;
+    if (step(&profile, "0908\r", TEST_CLEAN_INFO_IPT)) return 1;
+
+    TEST_ASSERT(obd_info_next_request(&profile, cmd, sizeof(cmd)) == OBD_ERROR_NO_DATA,
+                "profile should be complete");
+
+    /* Reconnect with the same profile: nothing to send */
+    TEST_ASSERT(obd_info_next_request(&profile, cmd, sizeof(cmd)) == OBD_ERROR_NO_DATA,
+                "a kept profile never asks again");
+
+    /* ...unless the app wants fresh IPT counters */
+    TEST_ASSERT(obd_info_set_read(&profile, 0x08, 0) == OBD_OK, "forget PID 08");
+    TEST_ASSERT(obd_info_next_request(&profile, cmd, sizeof(cmd)) == OBD_OK &&
+                strcmp(cmd, "0908\r") == 0, "PID 08 asked again");
+
+    printf("  PASS: profile flow and reconnect\n");
+    return 0;
+}
+
+/* ── Test: per-ECU typed results ───────────────────────────────────── */
+static int test_per_ecu(void)
+{
+    obd_vehicle_profile_t profile;
+    obd_ecu_info_t *ecm, *tcm;
+
+    obd_info_profile_init(&profile);
+    TEST_ASSERT(obd_info_parse_response(TEST_CLEAN_INFO_CALID, &profile) == OBD_OK, "CALID");
+    TEST_ASSERT(obd_info_parse_response(TEST_CLEAN_INFO_CVN, &profile) == OBD_OK, "CVN");
+    TEST_ASSERT(profile.ecu_count == 2, "two ECUs");
+
+    ecm = obd_info_find_ecu(&profile, 0x7E8);
+    tcm = obd_info_find_ecu(&profile, 0x7E9);
+    TEST_ASSERT(ecm && tcm, "both ECUs found");
+    TEST_ASSERT(ecm->calid_count == 1 && strcmp(ecm->calid[0], "JMB*36761500") == 0,
+                "7E8 CALID");
+    TEST_ASSERT(tcm->calid_count == 1 && strcmp(tcm->calid[0], "TCM-0042") == 0,
+                "7E9 CALID");
+    TEST_ASSERT(ecm->cvn_count == 1 && ecm->cvn[0] == 0x1791BC82u, "7E8 CVN");
+    TEST_ASSERT(tcm->cvn[0] == 0xA1B2C3D4u, "7E9 CVN");
+    TEST_ASSERT(ecm->read == ((1u << 0x04) | (1u << 0x06)), "7E8 answered 04 and 06");
+    TEST_ASSERT(obd_info_find_ecu(&profile, 0x7EA) == NULL, "7EA never answered");
+
+    TEST_ASSERT(obd_info_parse_response(TEST_CLEAN_INFO_ECU_NAME, &profile) == OBD_OK, "name");
+    TEST_ASSERT(strcmp(obd_info_find_ecu(&profile, 0)->name, "ECM-EngineControl") == 0,
+                "ECU name joined at the dash");
+
+    TEST_ASSERT(obd_info_parse_response(TEST_CLEAN_INFO_IPT, &profile) == OBD_OK, "IPT");
+    TEST_ASSERT(obd_info_find_ecu(&profile, 0)->ipt_pid == 0x08, "spark counters");
+    TEST_ASSERT(obd_info_find_ecu(&profile, 0)->ipt_count == 16, "16 counters");
+    TEST_ASSERT(obd_info_find_ecu(&profile, 0)->ipt[1] == 0x0456, "IGNCNTR");
+    TEST_ASSERT(obd_info_find_ecu(&profile, 0)->ipt[15] == 42, "last counter");
+
+    printf("  PASS: per-ECU results\n");
+    return 0;
+}
+
+/* ── Test: VIN, both formats ───────────────────────────────────────── */
+static int test_vin(void)
+{
+    obd_vehicle_profile_t profile;
+
+    obd_info_profile_init(&profile);
+    TEST_ASSERT(obd_info_parse_response(TEST_CLEAN_INFO_VIN, &profile) == OBD_OK, "CAN VIN");
+    TEST_ASSERT(strcmp(profile.vin, TEST_EXPECTED_VIN) == 0, "CAN VIN matches");
+
+    obd_info_profile_init(&profile);
+    TEST_ASSERT(obd_info_parse_response(TEST_CLEAN_VIN_MULTILINE, &profile) == OBD_OK,
+                "numbered VIN lines");
+    TEST_ASSERT(strcmp(profile.vin, TEST_EXPECTED_VIN) == 0, "legacy VIN matches");
+    TEST_ASSERT(profile.read & (1u << 0x02), "PID 02 marked read");
+
+    printf("  PASS: VIN, CAN and numbered lines\n");
+    return 0;
+}
+
+/* ── Test: errors and names ────────────────────────────────────────── */
+static int test_errors(void)
+{
+    obd_vehicle_profile_t profile;
+
+    obd_info_profile_init(&profile);
+
+    /* NODI says two CVNs, only one is there */
+    TEST_ASSERT(obd_info_parse_response("49 06 02 17 91 BC 82", &profile) ==
+                OBD_ERROR_PARSE_FAILED, "short message");
+    TEST_ASSERT(obd_info_parse_response(TEST_CLEAN_RPM, &profile) == OBD_ERROR_PARSE_FAILED,
+                "not a Mode 09 reply");
+    TEST_ASSERT(obd_info_parse_response(NULL, &profile) == OBD_ERROR_INVALID_ARG, "NULL");
+    TEST_ASSERT(obd_info_set_read(&profile, 0x21, 1) == OBD_ERROR_INVALID_ARG, "PID 21");
+
+    TEST_ASSERT(strcmp(obd_info_ipt_name(0x08, 2), "CATCOMP1") == 0, "spark name");
+    TEST_ASSERT(strcmp(obd_info_ipt_name(0x0B, 8), "PMCOMP") == 0, "compression name");
+    TEST_ASSERT(obd_info_ipt_name(0x08, 20) == NULL, "out of range");
+
+    printf("  PASS: errors and counter names\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== info tests ===\n");
+    failures += test_profile_flow();
+    failures += test_per_ecu();
+    failures += test_vin();
+    failures += test_errors();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
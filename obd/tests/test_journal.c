@@ -0,0 +1,291 @@
+/**
+ * test_journal.c — Tests for the append-only journal.
+ *
+ * Journals go in a directory under /tmp named after the pid, removed at
+ * the end. A "power cut" closes the segment without committing, so the
+ * group in memory is lost, and then damages the file the way a write
+ * cut short would.
+ */
+
+#include <obd/obd_io.h>
+#include "test_assert.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MS 1000u
+
+static obd_journal_t j;
+static char dir[64];
+
+/* What a replay saw */
+static struct {
+    size_t   count;
+    uint64_t first_seq;
+    uint64_t last_seq;
+    int      in_order;
+    char     last[64];
+    uint8_t  last_type;
+} seen;
+
+static void on_record(void *ctx, const obd_journal_record_t *rec)
+{
+    (void)ctx;
+    if (seen.count > 0 && rec->seq != seen.last_seq + 1) seen.in_order = 0;
+    if (seen.count == 0) seen.first_seq = rec->seq;
+    seen.last_seq = rec->seq;
+    seen.last_type = rec->type;
+    memcpy(seen.last, rec->data, rec->len < sizeof(seen.last) ? rec->len : sizeof(seen.last));
+    seen.last[sizeof(seen.last) - 1] = '\0';
+    seen.count++;
+}
+
+static obd_result_t replay(void)
+{
+    memset(&seen, 0, sizeof(seen));
+    seen.in_order = 1;
+    return obd_journal_replay(dir, on_record, NULL);
+}
+
+/* Record i: `size` bytes that say which one it is */
+static obd_result_t append(const char *what, size_t i, size_t size, uint64_t t_us)
+{
+    char data[1024];
+    memset(data, '.', size);
+    snprintf(data, size, "%s %zu", what, i);
+    return obd_journal_append(&j, 1, data, size, t_us);
+}
+
+static void remove_dir(void)
+{
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    char path[64 + 256 + 2];
+
+    if (!d) return;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        unlink(path);
+    }
+    closedir(d);
+    rmdir(dir);
+}
+
+static char *segment(uint32_t index)
+{
+    static char path[128];
+    snprintf(path, sizeof(path), "%s/%08x.obdj", dir, (unsigned)index);
+    return path;
+}
+
+/* ── Test: group commit ────────────────────────────────────────────── */
+static int test_group_commit(void)
+{
+    size_t i;
+
+    remove_dir();
+    TEST_ASSERT(obd_journal_open(&j, dir, 1000, 0) == OBD_ERROR_INVALID_ARG,
+                "segment too small");
+    TEST_ASSERT(obd_journal_open(&j, dir, OBD_JOURNAL_MIN_SEGMENT, 0) == OBD_OK, "open");
+    TEST_ASSERT(obd_journal_set_commit(&j, 500 * MS, 1024) == OBD_OK, "policy");
+    TEST_ASSERT(replay() == OBD_OK && seen.count == 0, "empty");
+
+    /* 136 bytes a record: the 8th takes the group past 1 KB */
+    for (i = 0; i < 7; i++) append("record", i, 100, i * MS);
+    TEST_ASSERT(j.stats.commits == 0 && replay() == OBD_OK && seen.count == 0,
+                "nothing written yet");
+    append("record", 7, 100, 7 * MS);
+    TEST_ASSERT(j.stats.commits == 1 && replay() == OBD_OK && seen.count == 8,
+                "committed at 1 KB");
+
+    /* ...or when the oldest waiting record is 500 ms old */
+    append("record", 8, 100, 1000 * MS);
+    append("record", 9, 100, 1200 * MS);
+    TEST_ASSERT(obd_journal_tick(&j, 1499 * MS) == OBD_OK && j.stats.commits == 1,
+                "not yet");
+    TEST_ASSERT(obd_journal_tick(&j, 1500 * MS) == OBD_OK && j.stats.commits == 2,
+                "500 ms after the oldest");
+    TEST_ASSERT(obd_journal_tick(&j, 5000 * MS) == OBD_OK && j.stats.commits == 2,
+                "nothing waiting, nothing to do");
+
+    obd_journal_append(&j, 7, "last", 4, 6000 * MS);
+    TEST_ASSERT(obd_journal_close(&j, 6000 * MS) == OBD_OK && j.stats.commits == 3,
+                "close commits");
+    TEST_ASSERT(replay() == OBD_OK && seen.count == 11 && seen.in_order &&
+                seen.first_seq == 1 && seen.last_seq == 11, "all 11, in order");
+    TEST_ASSERT(seen.last_type == 7 && strncmp(seen.last, "last", 4) == 0, "type and data");
+
+    obd_journal_open(&j, dir, OBD_JOURNAL_MIN_SEGMENT, 0);
+    TEST_ASSERT(obd_journal_append(&j, 255, "x", 1, 0) == OBD_ERROR_INVALID_ARG,
+                "type 255 is the journal's");
+    TEST_ASSERT(obd_journal_append(&j, 1, "x", OBD_JOURNAL_MAX_RECORD + 1, 0) ==
+                OBD_ERROR_INVALID_ARG, "too long");
+    TEST_ASSERT(obd_journal_set_commit(&j, 1, OBD_JOURNAL_BUFFER + 1) ==
+                OBD_ERROR_INVALID_ARG, "group bigger than the buffer");
+    obd_journal_close(&j, 0);
+    TEST_ASSERT(obd_journal_append(&j, 1, "x", 1, 0) == OBD_ERROR_INVALID_ARG, "closed");
+
+    printf("  PASS: group commit\n");
+    return 0;
+}
+
+/* ── Test: segments roll over, the oldest are deleted ──────────────── */
+static int test_segments(void)
+{
+    size_t i;
+
+    remove_dir();
+    obd_journal_open(&j, dir, OBD_JOURNAL_MIN_SEGMENT, 0);
+    obd_journal_set_retention(&j, 3);
+    for (i = 0; i < 2000; i++) {
+        TEST_ASSERT(append("row", i, 1000, i * MS) == OBD_OK, "append");
+    }
+    TEST_ASSERT(j.stats.segments >= 7, "2 MB in 256 KB segments");
+    TEST_ASSERT(j.first_segment == j.segment - 2, "three kept");
+    TEST_ASSERT(access(segment(j.first_segment), F_OK) == 0 &&
+                access(segment(j.first_segment - 1), F_OK) != 0, "older ones gone");
+    obd_journal_close(&j, 2000 * MS);
+
+    TEST_ASSERT(replay() == OBD_OK && seen.in_order && seen.last_seq == 2000 &&
+                seen.first_seq > 1000, "the newest, across segments");
+    TEST_ASSERT(strncmp(seen.last, "row 1999", 8) == 0, "last row");
+
+    /* Carry on where it stopped */
+    TEST_ASSERT(obd_journal_open(&j, dir, OBD_JOURNAL_MIN_SEGMENT, 0) == OBD_OK, "reopen");
+    TEST_ASSERT(j.next_seq == 2001 && j.stats.recovered > 0 && j.stats.truncated == 0,
+                "found the end");
+    append("row", 2000, 1000, 2001 * MS);
+    obd_journal_close(&j, 2001 * MS);
+    TEST_ASSERT(replay() == OBD_OK && seen.in_order && seen.last_seq == 2001, "appended");
+
+    /* A big segment: recovery starts from the newest checkpoint */
+    {
+        size_t checkpoint;
+        uint64_t gen;
+        int fd;
+
+        remove_dir();
+        obd_journal_open(&j, dir, 4u << 20, 0);
+        for (i = 0; i < 1000; i++) append("row", i, 1000, i * MS);
+        obd_journal_close(&j, 1000 * MS);
+        checkpoint = j.checkpoint;
+        gen = j.checkpoint_gen;
+        TEST_ASSERT(gen >= 3 && checkpoint > 768 * 1024, "checkpoints every 256 KB");
+
+        obd_journal_open(&j, dir, 4u << 20, 0);
+        TEST_ASSERT(j.checkpoint == checkpoint && j.checkpoint_gen == gen &&
+                    j.next_seq == 1001, "resumed from it");
+        obd_journal_close(&j, 0);
+
+        /* A torn checkpoint: the other slot still works */
+        fd = open(segment(1), O_WRONLY);
+        TEST_ASSERT(fd >= 0 && pwrite(fd, "XX", 2, (off_t)(64 + (gen & 1) * 32)) == 2,
+                    "damage");
+        close(fd);
+        obd_journal_open(&j, dir, 4u << 20, 0);
+        TEST_ASSERT(j.checkpoint_gen == gen - 1 && j.next_seq == 1001 &&
+                    j.stats.recovered == 1000, "older checkpoint");
+        obd_journal_close(&j, 0);
+    }
+
+    printf("  PASS: segments\n");
+    return 0;
+}
+
+/* ── Test: power cut in the middle of a group commit ───────────────── */
+static int test_recovery(void)
+{
+    size_t i, at;
+    int fd;
+
+    remove_dir();
+    obd_journal_open(&j, dir, OBD_JOURNAL_MIN_SEGMENT, 0);
+    for (i = 1; i <= 50; i++) append("record", i, 100, i * MS);
+    obd_journal_commit(&j, 50 * MS);
+    for (i = 51; i <= 80; i++) append("record", i, 100, i * MS);
+    obd_journal_commit(&j, 80 * MS);
+    for (i = 81; i <= 90; i++) append("record", i, 100, i * MS);
+
+    /* The power goes: 81-90 were only in memory */
+    close(j.fd);
+
+    /* ...and the last write only half happened: record 65 is damaged */
+    at = 4096 + 50 * 136 + 32 + 14 * 136 + 40;
+    fd = open(segment(1), O_WRONLY);
+    TEST_ASSERT(fd >= 0 && pwrite(fd, "XX", 2, (off_t)at) == 2, "damage");
+    close(fd);
+
+    TEST_ASSERT(obd_journal_open(&j, dir, OBD_JOURNAL_MIN_SEGMENT, 0) == OBD_OK, "reopen");
+    TEST_ASSERT(j.stats.recovered == 64 && j.next_seq == 65, "up to record 64");
+    TEST_ASSERT(j.stats.truncated > 2000 && j.stats.truncated <= 16 * 136 + 32,
+                "the rest of the group cleared");
+    TEST_ASSERT(replay() == OBD_OK && seen.count == 64, "replay agrees");
+
+    /* New records in place of the lost ones, shorter: no trace of the old */
+    for (i = 0; i < 5; i++) append("new", i, 40, (100 + i) * MS);
+    obd_journal_close(&j, 200 * MS);
+    TEST_ASSERT(replay() == OBD_OK && seen.count == 69 && seen.in_order &&
+                seen.last_seq == 69 && strncmp(seen.last, "new 4", 5) == 0, "carried on");
+    TEST_ASSERT(obd_journal_open(&j, dir, OBD_JOURNAL_MIN_SEGMENT, 0) == OBD_OK &&
+                j.next_seq == 70 && j.stats.truncated == 0, "clean the second time");
+    obd_journal_close(&j, 0);
+
+    printf("  PASS: recovery\n");
+    return 0;
+}
+
+/* ── Test: a segment whose header never made it ────────────────────── */
+static int test_torn_segment(void)
+{
+    static char zeros[4096];
+    int fd;
+
+    remove_dir();
+    obd_journal_open(&j, dir, OBD_JOURNAL_MIN_SEGMENT, 0);
+    append("record", 1, 100, 0);
+    obd_journal_close(&j, 0);
+
+    /* Power went while segment 2 was being created */
+    fd = open(segment(2), O_WRONLY | O_CREAT, 0644);
+    TEST_ASSERT(fd >= 0 && write(fd, zeros, sizeof(zeros)) == (ssize_t)sizeof(zeros),
+                "empty segment");
+    close(fd);
+    TEST_ASSERT(replay() == OBD_OK && seen.count == 1, "replay stops before it");
+
+    TEST_ASSERT(obd_journal_open(&j, dir, OBD_JOURNAL_MIN_SEGMENT, 0) == OBD_OK, "open");
+    TEST_ASSERT(j.segment == 1 && j.next_seq == 2, "back to segment 1");
+    TEST_ASSERT(access(segment(2), F_OK) != 0, "the torn one removed");
+    append("record", 2, 100, 0);
+    obd_journal_close(&j, 0);
+    TEST_ASSERT(replay() == OBD_OK && seen.count == 2 && seen.in_order, "both");
+
+    remove_dir();
+    TEST_ASSERT(obd_journal_replay(dir, on_record, NULL) == OBD_ERROR_IO, "no directory");
+    TEST_ASSERT(obd_journal_open(&j, "", OBD_JOURNAL_MIN_SEGMENT, 0) ==
+                OBD_ERROR_INVALID_ARG, "no name");
+
+    printf("  PASS: torn segment\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    snprintf(dir, sizeof(dir), "/tmp/obd_test_journal_%d", (int)getpid());
+
+    printf("=== journal tests ===\n");
+    failures += test_group_commit();
+    failures += test_segments();
+    failures += test_recovery();
+    failures += test_torn_segment();
+
+    remove_dir();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
@@ -0,0 +1,152 @@
+/**
+ * test_monitor.c — Tests for Mode 06 monitor test results.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* ── Test: build Mode 06 requests ──────────────────────────────────── */
+static int test_build_request(void)
+{
+    static const uint8_t bitmaps[] = { 0x00, 0x20, 0x40 };
+    static const uint8_t mixed[] = { 0x00, 0x21 };
+    static const uint8_t seven[] = { 0x00, 0x20, 0x40, 0x60, 0x80, 0xA0, 0xC0 };
+    uint8_t misfire = 0xA2;
+    char buf[OBD_MAX_COMMAND_LEN];
+    obd_result_t r;
+
+    r = obd_monitor_build_request(bitmaps, 3, buf, sizeof(buf));
+    TEST_ASSERT(r == OBD_OK, "three bitmaps in one request");
+    TEST_ASSERT(strcmp(buf, "06002040\r") == 0, "should produce '06002040\\r'");
+
+    r = obd_monitor_build_request(&misfire, 1, buf, sizeof(buf));
+    TEST_ASSERT(r == OBD_OK && strcmp(buf, "06A2\r") == 0, "one test MID");
+
+    r = obd_monitor_build_request(mixed, 2, buf, sizeof(buf));
+    TEST_ASSERT(r == OBD_ERROR_INVALID_ARG, "test MID with a bitmap");
+    r = obd_monitor_build_request(seven, 7, buf, sizeof(buf));
+    TEST_ASSERT(r == OBD_ERROR_INVALID_ARG, "at most six MIDs");
+    r = obd_monitor_build_request(bitmaps, 3, buf, 8);
+    TEST_ASSERT(r == OBD_ERROR_BUFFER_TOO_SMALL, "small buffer should error");
+
+    printf("  PASS: build Mode 06 request\n");
+    return 0;
+}
+
+/* ── Test: parse a multi-frame reply, headers off ──────────────────── */
+static int test_parse_segments(void)
+{
+    obd_monitor_result_t res;
+    obd_result_t r;
+
+    r = obd_monitor_parse_response(TEST_CLEAN_MONITOR_SEGMENTS, &res);
+    TEST_ASSERT(r == OBD_OK, "should parse");
+    TEST_ASSERT(res.count == 2, "two tests");
+
+    TEST_ASSERT(res.tests[0].mid == 0x01 && res.tests[0].tid == 0x0B, "MID 01 TID 0B");
+    TEST_ASSERT(res.tests[0].uasid == 0x24, "counts");
+    TEST_ASSERT(res.tests[0].value == 0.0f && res.tests[0].max == 65535.0f, "0 in 0..65535");
+    TEST_ASSERT(res.tests[0].passed, "within limits");
+
+    TEST_ASSERT(res.tests[1].tid == 0x0C && res.tests[1].value == 21.0f, "TID 0C = 21");
+    TEST_ASSERT(res.tests[1].max == 16.0f && !res.tests[1].passed, "21 > 16 fails");
+
+    printf("  PASS: parse segments\n");
+    return 0;
+}
+
+/* ── Test: two ECUs with headers on, signed UASID ──────────────────── */
+static int test_parse_headers(void)
+{
+    obd_monitor_result_t res;
+    obd_result_t r;
+
+    r = obd_monitor_parse_response(TEST_CLEAN_MONITOR_HEADERS, &res);
+    TEST_ASSERT(r == OBD_OK, "should parse");
+    TEST_ASSERT(res.count == 3, "two tests from 7E8, one from 7E9");
+    TEST_ASSERT(res.tests[0].ecu == 0x7E8 && res.tests[2].ecu == 0x7E9, "ECU ids kept");
+
+    /* UASID 0x96: signed, 0.1 C per bit */
+    TEST_ASSERT(fabs((double)res.tests[2].value + 10.0) < 0.001, "0xFF9C = -10.0 C");
+    TEST_ASSERT(fabs((double)res.tests[2].min + 3276.8) < 0.01, "0x8000 = -3276.8 C");
+    TEST_ASSERT(res.tests[2].passed, "within limits");
+    TEST_ASSERT(strcmp(obd_monitor_unit(res.tests[2].uasid), "C") == 0, "unit C");
+
+    printf("  PASS: parse headers, two ECUs\n");
+    return 0;
+}
+
+/* ── Test: supported MIDs via the shared bitmap helpers ────────────── */
+static int test_supported_mids(void)
+{
+    obd_monitor_result_t res;
+    obd_pid_supported_t set;
+    uint8_t mids[8], base;
+    size_t count = 0;
+    obd_result_t r;
+
+    memset(&set, 0, sizeof(set));
+    r = obd_pid_supported_parse(TEST_CLEAN_MONITOR_SUPPORTED, 0x06, &set);
+    TEST_ASSERT(r == OBD_OK, "three bitmaps should merge");
+    TEST_ASSERT(obd_pid_supported_next(&set, &base) == 0, "chain ends at 40");
+
+    r = obd_pid_supported_list(&set, mids, sizeof(mids), &count);
+    TEST_ASSERT(r == OBD_OK && count == 3, "MIDs 01, 02, 21");
+    TEST_ASSERT(mids[0] == 0x01 && mids[1] == 0x02 && mids[2] == 0x21, "in order");
+
+    /* A bitmap-only reply parses to no tests */
+    r = obd_monitor_parse_response(TEST_CLEAN_MONITOR_SUPPORTED, &res);
+    TEST_ASSERT(r == OBD_OK && res.count == 0, "bitmaps are skipped");
+
+    printf("  PASS: supported MIDs\n");
+    return 0;
+}
+
+/* ── Test: names, units, errors ────────────────────────────────────── */
+static int test_tables_and_errors(void)
+{
+    obd_monitor_result_t res;
+    obd_result_t r;
+
+    TEST_ASSERT(strcmp(obd_monitor_name(0x21), "Catalyst Bank 1") == 0, "MID 21");
+    TEST_ASSERT(strcmp(obd_monitor_name(0xA4), "Misfire Cylinder 3") == 0, "MID A4");
+    TEST_ASSERT(obd_monitor_name(0xF1) == NULL, "unknown MID");
+    TEST_ASSERT(strcmp(obd_monitor_unit(0x0B), "V") == 0, "UASID 0B");
+    TEST_ASSERT(strcmp(obd_monitor_unit(0x7F), "") == 0, "unknown UASID");
+
+    /* Unknown UASID: raw value */
+    r = obd_monitor_parse_response("013\r0: 46 A2 0B 7F 01 00\r1: 00 00 FF FF A2 0C 24\r"
+                                   "2: 00 00 00 00 00 00 00", &res);
+    TEST_ASSERT(r == OBD_OK && res.tests[0].value == 256.0f, "raw 0x0100");
+
+    /* Record cut short */
+    r = obd_monitor_parse_response("46 01 0B 24 00 00 00", &res);
+    TEST_ASSERT(r == OBD_ERROR_PARSE_FAILED, "truncated record");
+    r = obd_monitor_parse_response(TEST_CLEAN_RPM, &res);
+    TEST_ASSERT(r == OBD_ERROR_PARSE_FAILED, "not a Mode 06 reply");
+    r = obd_monitor_parse_response(NULL, &res);
+    TEST_ASSERT(r == OBD_ERROR_INVALID_ARG, "NULL should error");
+
+    printf("  PASS: names, units, errors\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== monitor tests ===\n");
+    failures += test_build_request();
+    failures += test_parse_segments();
+    failures += test_parse_headers();
+    failures += test_supported_mids();
+    failures += test_tables_and_errors();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 5);
+    return failures;
+}
@@ -0,0 +1,322 @@
+/**
+ * test_mux.c — Tests for the adapter multiplexer.
+ *
+ * Everything runs in one thread: the mux talks to an in-process emulator
+ * over a socketpair, and each "client" is the far end of another
+ * socketpair (or a real Unix socket). spin() alternates mux steps with
+ * letting the emulator answer.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <obd/obd_io.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static obd_mux_t mux;
+static obd_emu_t emu;
+static int car_fd = -1;                 /* The emulator's end of the adapter link */
+
+/* Every OBD request the emulator saw, in order */
+static char seen[16][OBD_EMU_LINE_LEN];
+static size_t seen_count;
+
+static void serve_emulator(void)
+{
+    char in[256], out[1024];
+    uint64_t before = emu.obd_requests;
+    size_t n_out = 0;
+    ssize_t n;
+
+    while ((n = read(car_fd, in, sizeof(in))) > 0) {
+        obd_emu_feed(&emu, in, (size_t)n, out, sizeof(out), &n_out);
+        if (emu.obd_requests != before && seen_count < 16) {
+            memcpy(seen[seen_count++], emu.last_obd, sizeof(seen[0]));
+            before = emu.obd_requests;
+        }
+        if (write(car_fd, out, n_out) != (ssize_t)n_out) return;
+    }
+}
+
+static void spin(void)
+{
+    int i;
+    for (i = 0; i < 40; i++) {
+        obd_mux_step(&mux, 0);
+        serve_emulator();
+    }
+}
+
+/* A fresh mux, set up against a fresh emulator */
+static int setup(int batching)
+{
+    int sv[2];
+
+    if (car_fd >= 0) {
+        obd_mux_close(&mux);
+        close(mux.adapter_fd);
+        close(car_fd);
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) return 0;
+    obd_net_set_nonblocking(sv[1]);
+    car_fd = sv[1];
+
+    obd_emu_init(&emu);
+    obd_mux_init(&mux, sv[0]);
+    obd_net_set_nonblocking(sv[0]);
+    obd_mux_set_batching(&mux, batching);
+    spin();
+    seen_count = 0;
+    return mux.can && obd_session_pending(&mux.session) == 0;
+}
+
+static int connect_client(void)
+{
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) return -1;
+    obd_mux_add_client(&mux, sv[0]);
+    obd_net_set_nonblocking(sv[1]);
+    return sv[1];
+}
+
+static void say(int fd, const char *text)
+{
+    if (write(fd, text, strlen(text)) != (ssize_t)strlen(text)) return;
+}
+
+/* Everything the client has received so far */
+static const char *hear(int fd)
+{
+    static char buf[2048];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    buf[n > 0 ? n : 0] = '\0';
+    return buf;
+}
+
+/* ── Test: setup, echo, local AT commands ──────────────────────────── */
+static int test_basic(void)
+{
+    uint64_t commands;
+    int a;
+
+    TEST_ASSERT(setup(0), "adapter set up, CAN detected");
+    TEST_ASSERT(emu.echo == 0 && emu.spaces == 1, "adapter configured");
+    a = connect_client();
+
+    say(a, "010C\r");
+    spin();
+    TEST_ASSERT(strcmp(hear(a), TEST_RAW_RPM_RESPONSE) == 0, "RPM, echoed like an ELM327");
+
+    commands = emu.commands;
+    say(a, "ATE0\r");
+    spin();
+    TEST_ASSERT(strcmp(hear(a), TEST_RAW_OK_RESPONSE) == 0, "ATE0 answered");
+    say(a, "ATZ\r");
+    spin();
+    TEST_ASSERT(strcmp(hear(a), "ELM327 v1.5\r\r>") == 0, "ATZ answered, echo back on after");
+    say(a, "ATSP6\r");
+    spin();
+    TEST_ASSERT(strcmp(hear(a), "ATSP6\rOK\r\r>") == 0, "ATSP accepted");
+    TEST_ASSERT(emu.commands == commands, "none of them reached the adapter");
+
+    say(a, "ATRV\r");
+    spin();
+    TEST_ASSERT(strcmp(hear(a), "ATRV\r12.6V\r\r>") == 0, "ATRV forwarded");
+    say(a, "HELLO\r");
+    spin();
+    TEST_ASSERT(strcmp(hear(a), "HELLO\r?\r\r>") == 0, "junk gets ?");
+
+    close(a);
+    spin();
+    TEST_ASSERT(obd_mux_client_count(&mux) == 0, "disconnect noticed");
+
+    printf("  PASS: setup and local AT commands\n");
+    return 0;
+}
+
+/* ── Test: one client's settings don't leak into another's ─────────── */
+static int test_per_client_settings(void)
+{
+    int a, b;
+
+    setup(0);
+    a = connect_client();
+    b = connect_client();
+
+    say(a, "ATE0\rATS0\rATL1\r");
+    spin();
+    hear(a);
+
+    say(a, "010C\r");
+    say(b, "010C\r");
+    spin();
+    TEST_ASSERT(strcmp(hear(a), "410C1AF8\r\n\r\n>") == 0, "A: no echo/spaces, linefeeds");
+    TEST_ASSERT(strcmp(hear(b), TEST_RAW_RPM_RESPONSE) == 0, "B: defaults");
+
+    close(a);
+    close(b);
+    printf("  PASS: per-client settings\n");
+    return 0;
+}
+
+/* ── Test: identical requests share a round trip; cache hits ───────── */
+static int test_coalescing_and_cache(void)
+{
+    int a, b;
+
+    setup(0);
+    a = connect_client();
+    b = connect_client();
+    say(a, "ATE0\r");
+    say(b, "ATE0\r");
+    spin();
+    hear(a);
+    hear(b);
+
+    say(a, "010C\r");
+    say(b, "01 0c\r");
+    spin();
+    TEST_ASSERT(seen_count == 1, "one round trip for both");
+    TEST_ASSERT(strcmp(hear(a), "41 0C 1A F8\r\r>") == 0, "A answered");
+    TEST_ASSERT(strcmp(hear(b), "41 0C 1A F8\r\r>") == 0, "B answered");
+
+    say(a, "0105\r");
+    spin();
+    say(b, "0105\r");
+    spin();
+    TEST_ASSERT(seen_count == 2, "coolant (2 s TTL) came from the cache the second time");
+    TEST_ASSERT(strcmp(hear(b), "41 05 7B\r\r>") == 0, "cached answer");
+    TEST_ASSERT(mux.stats.hits == 1 && mux.stats.coalesced == 1, "counted");
+
+    close(a);
+    close(b);
+    printf("  PASS: coalescing and cache\n");
+    return 0;
+}
+
+/* ── Test: round robin between a chatty client and a quiet one ─────── */
+static int test_fairness(void)
+{
+    int a, b;
+
+    setup(0);
+    a = connect_client();
+    b = connect_client();
+
+    /* A pipelines three requests, B asks for one */
+    say(a, "010C\r010D\r0111\r");
+    say(b, "0104\r");
+    spin();
+
+    TEST_ASSERT(seen_count == 4, "all four sent");
+    TEST_ASSERT(strcmp(seen[0], "010C") == 0, "A first");
+    TEST_ASSERT(strcmp(seen[1], "0104") == 0, "then B, not A's next");
+    TEST_ASSERT(strcmp(seen[2], "010D") == 0 && strcmp(seen[3], "0111") == 0, "then A");
+    TEST_ASSERT(strstr(hear(a), "41 11 26") != NULL, "A got all three");
+
+    close(a);
+    close(b);
+    printf("  PASS: fairness\n");
+    return 0;
+}
+
+/* ── Test: different PIDs from different clients in one request ───── */
+static int test_batching(void)
+{
+    int a, b, c;
+
+    TEST_ASSERT(setup(1), "setup");
+    a = connect_client();
+    b = connect_client();
+    c = connect_client();
+
+    /* 41 0D 3C 05 7B 11 26: seven bytes, just fits one CAN frame */
+    say(a, "010D\r");
+    say(b, "0105\r");
+    say(c, "0111\r");
+    spin();
+
+    TEST_ASSERT(seen_count == 1 && strcmp(seen[0], "010D0511") == 0, "one multi-PID request");
+    TEST_ASSERT(strcmp(hear(a), TEST_RAW_SPEED_RESPONSE) == 0, "A gets only speed");
+    TEST_ASSERT(strcmp(hear(b), TEST_RAW_COOLANT_RESPONSE) == 0, "B gets only coolant");
+    TEST_ASSERT(strcmp(hear(c), "0111\r41 11 26\r\r>") == 0, "C gets only throttle");
+    TEST_ASSERT(mux.stats.batches == 1 && mux.stats.batched == 3, "counted");
+
+    /* The split-out coolant answer was cached like any other */
+    say(a, "0105\r");
+    spin();
+    TEST_ASSERT(seen_count == 1, "no new round trip");
+    TEST_ASSERT(strcmp(hear(a), TEST_RAW_COOLANT_RESPONSE) == 0, "from the cache");
+
+    /* A PID the car doesn't have is left out of the reply */
+    say(a, "010C\r");
+    say(b, "010A\r");
+    spin();
+    TEST_ASSERT(strcmp(seen[1], "010A0C") == 0, "batched again, B leads this time");
+    TEST_ASSERT(strcmp(hear(b), "010A\rNO DATA\r\r>") == 0, "missing PID → NO DATA");
+    TEST_ASSERT(strcmp(hear(a), TEST_RAW_RPM_RESPONSE) == 0, "A still answered");
+
+    close(a);
+    close(b);
+    close(c);
+    printf("  PASS: batching\n");
+    return 0;
+}
+
+/* ── Test: a real Unix socket listener; losing the adapter ─────────── */
+static int test_unix_listener(void)
+{
+    char path[64];
+    char clean[OBD_MAX_RESPONSE_LEN];
+    char vin[OBD_VIN_LENGTH + 1];
+    const char *reply;
+    int lfd = -1, a = -1;
+
+    setup(0);
+    snprintf(path, sizeof(path), "/tmp/obd_test_mux_%d.sock", (int)getpid());
+    TEST_ASSERT(obd_net_listen_unix(path, &lfd) == OBD_OK, "listen");
+    obd_mux_add_listener(&mux, lfd);
+    TEST_ASSERT(obd_net_connect_unix(path, &a) == OBD_OK, "connect");
+    spin();
+    TEST_ASSERT(obd_mux_client_count(&mux) == 1, "accepted");
+
+    say(a, "0902\r");
+    spin();
+    reply = hear(a);
+    TEST_ASSERT(obd_elm327_clean_response(reply, clean, sizeof(clean)) == OBD_OK, "VIN reply");
+    TEST_ASSERT(obd_vin_parse_response(clean, vin, sizeof(vin)) == OBD_OK &&
+                strcmp(vin, TEST_EXPECTED_VIN) == 0, "VIN through the mux");
+
+    close(car_fd);
+    car_fd = -1;
+    TEST_ASSERT(obd_mux_step(&mux, 0) == OBD_ERROR_IO, "adapter loss reported");
+
+    close(a);
+    obd_mux_close(&mux);
+    close(mux.adapter_fd);
+    unlink(path);
+    printf("  PASS: Unix socket listener\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== mux tests ===\n");
+    failures += test_basic();
+    failures += test_per_client_settings();
+    failures += test_coalescing_and_cache();
+    failures += test_fairness();
+    failures += test_batching();
+    failures += test_unix_listener();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 6);
+    return failures;
+}
@@ -0,0 +1,202 @@
+/**
+ * test_obd_hpp.cpp — Tests for the C++17 facade (obd.hpp).
+ *
+ * The static_asserts below run the canned replies from test_data.h
+ * through the constexpr parser and decoder at compile time: if this file
+ * builds, those pass. The run-time tests check the facade against the C
+ * library, entry by entry and byte by byte, so the constexpr sensor
+ * table can't drift from src/sensor.c.
+ */
+
+#include <obd/obd.hpp>
+#include "test_assert.h"
+#include "test_data.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/* ── Compile time ─────────────────────────────────────────────────────── */
+
+#define NOTHING (-1000.0f)
+
+template <uint8_t PID>
+constexpr float decoded(std::string_view text)
+{
+    obd_pid_response_t r{};
+    if (obd::pid_parse_response(text, &r) != OBD_OK) return NOTHING;
+    return obd::decode<PID>(r).value_or(NOTHING);
+}
+
+static_assert(decoded<0x0C>(TEST_CLEAN_RPM) == TEST_EXPECTED_RPM, "RPM");
+static_assert(decoded<0x0D>(TEST_CLEAN_SPEED) == TEST_EXPECTED_SPEED, "speed");
+static_assert(decoded<0x05>(TEST_CLEAN_COOLANT) == TEST_EXPECTED_COOLANT, "coolant");
+static_assert(decoded<0x11>(TEST_CLEAN_THROTTLE) == TEST_EXPECTED_THROTTLE, "throttle");
+static_assert(decoded<0x0F>(TEST_CLEAN_INTAKE_TEMP) == TEST_EXPECTED_INTAKE_TEMP, "intake");
+static_assert(decoded<0x10>(TEST_CLEAN_MAF) == TEST_EXPECTED_MAF, "MAF");
+static_assert(decoded<0x0A>(TEST_CLEAN_FUEL_PRESSURE) == TEST_EXPECTED_FUEL_PRESSURE, "fuel pressure");
+static_assert(decoded<0x0E>(TEST_CLEAN_TIMING_ADVANCE) == TEST_EXPECTED_TIMING_ADV, "timing");
+static_assert(decoded<0x06>(TEST_CLEAN_FUEL_TRIM) == TEST_EXPECTED_FUEL_TRIM, "fuel trim");
+static_assert(decoded<0x14>(TEST_CLEAN_O2_VOLTAGE) == TEST_EXPECTED_O2_VOLTAGE, "O2");
+static_assert(decoded<0x1F>(TEST_CLEAN_RUNTIME) == TEST_EXPECTED_RUNTIME, "runtime");
+static_assert(decoded<0x01>(TEST_CLEAN_DTC_COUNT) == TEST_EXPECTED_DTC_COUNT, "DTC count");
+
+/* Wrong PID, too few bytes, bad hex */
+static_assert(decoded<0x0D>(TEST_CLEAN_RPM) == NOTHING, "RPM reply is not speed");
+static_assert(decoded<0x0C>("41 0C 1A") == NOTHING, "RPM needs two bytes");
+static_assert(decoded<0x0C>("41 0C 1A F") == NOTHING, "trailing nibble");
+
+constexpr obd_result_t parse_status(std::string_view text)
+{
+    obd_pid_response_t r{};
+    return obd::pid_parse_response(text, &r);
+}
+
+static_assert(parse_status(TEST_CLEAN_RPM) == OBD_OK, "parses");
+static_assert(parse_status("41") == OBD_ERROR_PARSE_FAILED, "mode only");
+static_assert(parse_status("41 0C ZZ") == OBD_ERROR_INVALID_HEX, "not hex");
+static_assert(parse_status("41 0C 01 02 03 04 05 06 07 08") == OBD_ERROR_BUFFER_TOO_SMALL,
+              "more than 7 data bytes");
+
+static_assert(obd::find_sensor(0x0C)->name == "Engine RPM", "name");
+static_assert(obd::find_sensor(0x0C)->byte_count == 2, "byte count");
+static_assert(obd::find_sensor(0x00) == nullptr, "not in the table");
+
+
+/* ── Test: the constexpr table is the C table ──────────────────────────── */
+
+static int test_table_matches_c()
+{
+    char name[32];
+    size_t count;
+    size_t found = 0;
+
+    for (unsigned pid = 0; pid < 256; pid++) {
+        const obd::sensor_info *info = obd::find_sensor((uint8_t)pid);
+        obd_result_t r = obd_sensor_get_name((uint8_t)pid, name, sizeof(name));
+
+        if (!info) {
+            TEST_ASSERT(r == OBD_ERROR_UNKNOWN_PID, "unknown to both");
+            continue;
+        }
+        found++;
+        TEST_ASSERT(r == OBD_OK && info->name == name, "same name");
+        TEST_ASSERT(obd_sensor_get_byte_count((uint8_t)pid, &count) == OBD_OK &&
+                    count == info->byte_count, "same byte count");
+
+        /* Every A (B and the rest follow from it): the same bits out */
+        for (unsigned a = 0; a < 256; a++) {
+            obd_pid_response_t resp{};
+            obd_sensor_value_t want;
+            resp.mode = 0x41;
+            resp.pid = (uint8_t)pid;
+            resp.data_len = info->byte_count;
+            for (size_t k = 0; k < resp.data_len; k++) resp.data[k] = (uint8_t)(a ^ (0x5A * k));
+
+            TEST_ASSERT(obd_sensor_decode(&resp, &want) == OBD_OK, "C decodes");
+            TEST_ASSERT(strcmp(want.unit, std::string(info->unit).c_str()) == 0, "same unit");
+            std::optional<float> got = obd::decode(resp);
+            TEST_ASSERT(got && std::memcmp(&*got, &want.value, sizeof(float)) == 0,
+                        "same value, bit for bit");
+        }
+    }
+    TEST_ASSERT(found == obd::sensors.size(), "no duplicate PIDs");
+
+    printf("  PASS: constexpr sensor table matches sensor.c (%zu PIDs x 256)\n", found);
+    return 0;
+}
+
+
+/* ── Test: decode<PID> on spans ────────────────────────────────────────── */
+
+static int test_decode_spans()
+{
+    const uint8_t rpm[] = { 0x1A, 0xF8 };
+    const std::array<uint8_t, 1> speed = {{ 0x3C }};
+    uint8_t raw[4] = { 0x41, 0x0C, 0x1A, 0xF8 };
+
+    TEST_ASSERT(obd::decode<0x0C>(rpm) == TEST_EXPECTED_RPM, "from an array");
+    TEST_ASSERT(obd::decode<0x0D>(speed) == TEST_EXPECTED_SPEED, "from std::array");
+    TEST_ASSERT(obd::decode<0x0C>(obd::span<const uint8_t>(raw + 2, 2)) == TEST_EXPECTED_RPM,
+                "from pointer + length");
+    TEST_ASSERT(!obd::decode<0x0C>(obd::span<const uint8_t>(raw + 2, 1)), "too short");
+    TEST_ASSERT(obd::decode(0x0D, speed) == TEST_EXPECTED_SPEED, "run-time PID");
+    TEST_ASSERT(!obd::decode(0x00, speed), "run-time unknown PID");
+
+    printf("  PASS: decode<PID> on arrays, std::array, pointer + length\n");
+    return 0;
+}
+
+
+/* ── Test: string_view parsers agree with the C ones ───────────────────── */
+
+static int test_parsers_match_c()
+{
+    static const char *inputs[] = {
+        TEST_CLEAN_RPM, TEST_CLEAN_MAF, TEST_CLEAN_DTC_COUNT, "41", "41 0C ZZ", "",
+        "4 1", "41 0C 01 02 03 04 05 06 07 08",
+    };
+    /* Text followed by junk: the views must stop where they're told */
+    const std::string padded = std::string(TEST_CLEAN_DTC_MIXED_CODES) + "FFFF";
+    const std::string_view dtc_view(padded.data(), strlen(TEST_CLEAN_DTC_MIXED_CODES));
+    const std::string vin_text = std::string(TEST_CLEAN_VIN_MULTILINE) + "\r49 02 06";
+    const std::string_view vin_view(vin_text.data(), strlen(TEST_CLEAN_VIN_MULTILINE));
+    obd_dtc_list_t want_dtcs, got_dtcs;
+    char want_vin[OBD_VIN_LENGTH + 1], got_vin[OBD_VIN_LENGTH + 1];
+    char want_clean[64], got_clean[64];
+    std::array<uint8_t, 8> bytes{};
+    size_t len = 0;
+
+    for (const char *in : inputs) {
+        obd_pid_response_t want{}, got{};
+        obd_result_t rw = obd_pid_parse_response(in, &want);
+        obd_result_t rg = obd::pid_parse_response(in, &got);
+        TEST_ASSERT(rw == rg, "same status");
+        if (rw == OBD_OK) {
+            TEST_ASSERT(want.mode == got.mode && want.pid == got.pid &&
+                        want.data_len == got.data_len &&
+                        memcmp(want.data, got.data, want.data_len) == 0, "same response");
+        }
+    }
+
+    TEST_ASSERT(obd::hex_to_bytes(TEST_HEX_STRING_NO_SPACES, bytes, &len) == OBD_OK &&
+                len == TEST_HEX_EXPECTED_LEN && bytes[3] == TEST_HEX_EXPECTED_BYTE_3, "hex");
+    TEST_ASSERT(obd::hex_to_bytes("41 0C", bytes, nullptr) == OBD_ERROR_INVALID_ARG, "no out_len");
+
+    TEST_ASSERT(obd_dtc_parse_response(TEST_CLEAN_DTC_MIXED_CODES, &want_dtcs) == OBD_OK, "C DTCs");
+    TEST_ASSERT(obd::dtc_parse_response(dtc_view, &got_dtcs) == OBD_OK, "DTCs");
+    TEST_ASSERT(got_dtcs.count == want_dtcs.count &&
+                strcmp(got_dtcs.dtcs[1].formatted, "C0104") == 0, "same DTCs");
+
+    TEST_ASSERT(obd_vin_parse_response(TEST_CLEAN_VIN_MULTILINE, want_vin, sizeof(want_vin)) == OBD_OK,
+                "C VIN");
+    TEST_ASSERT(obd::vin_parse_response(vin_view, got_vin) == OBD_OK &&
+                strcmp(got_vin, want_vin) == 0 && strcmp(got_vin, TEST_EXPECTED_VIN) == 0, "VIN");
+
+    TEST_ASSERT(obd_elm327_clean_response(TEST_RAW_RPM_RESPONSE, want_clean, sizeof(want_clean)) == OBD_OK,
+                "C clean");
+    TEST_ASSERT(obd::elm327_clean_response(TEST_RAW_RPM_RESPONSE, got_clean) == OBD_OK &&
+                strcmp(got_clean, want_clean) == 0, "clean");
+    TEST_ASSERT(obd::elm327_classify_response("NO DATA") == obd_elm327_classify_response("NO DATA"),
+                "classify");
+
+    /* Longer than any reply: refused, not truncated */
+    std::string huge(8 * OBD_MAX_RESPONSE_LEN, '4');
+    TEST_ASSERT(obd::dtc_parse_response(huge, &got_dtcs) == OBD_ERROR_BUFFER_TOO_SMALL, "too long");
+
+    printf("  PASS: string_view / span parsers match the C ones\n");
+    return 0;
+}
+
+int main()
+{
+    int failures = 0;
+
+    printf("=== obd.hpp tests ===\n");
+    failures += test_table_matches_c();
+    failures += test_decode_spans();
+    failures += test_parsers_match_c();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 3);
+    return failures;
+}
@@ -24,10 +24,10 @@ static int test_build_request(void)
     TEST_ASSERT(r == OBD_OK, "build speed request should succeed");
     TEST_ASSERT(strcmp(buf, "010D\r") == 0, "should produce '010D\\r'");
 
-    /* Mode 02, PID 0C (freeze frame RPM) → "020C\r" */
+    /* Mode 02, PID 0C (freeze frame RPM), frame 0 → "020C00\r" */
     r = obd_pid_build_request(0x02, 0x0C, buf, sizeof(buf));
     TEST_ASSERT(r == OBD_OK, "build freeze frame request should succeed");
-    TEST_ASSERT(strcmp(buf, "020C\r") == 0, "should produce '020C\\r'");
+    TEST_ASSERT(strcmp(buf, "020C00\r") == 0, "should produce '020C00\\r'");
 
     /* Error: buffer too small */
     r = obd_pid_build_request(0x01, 0x0C, buf, 3);
@@ -96,6 +96,48 @@ static int test_parse_errors(void)
     return 0;
 }
 
+/* ── Test: supported-PID bitmaps ───────────────────────────────────── */
+static int test_supported(void)
+{
+    obd_pid_supported_t set;
+    uint8_t pids[32], base = 0xFF;
+    size_t count = 0;
+    obd_result_t r;
+
+    memset(&set, 0, sizeof(set));
+    TEST_ASSERT(obd_pid_supported_next(&set, &base) == 1 && base == 0x00,
+                "an empty set should ask for PID 00 first");
+
+    r = obd_pid_supported_parse(TEST_CLEAN_PID_SUPPORTED, 0x01, &set);
+    TEST_ASSERT(r == OBD_OK, "bitmap should parse");
+    TEST_ASSERT(obd_pid_supported_has(&set, 0x0C), "0C (RPM) should be supported");
+    TEST_ASSERT(obd_pid_supported_has(&set, 0x1C), "1C should be supported");
+    TEST_ASSERT(!obd_pid_supported_has(&set, 0x02), "02 should not be supported");
+    TEST_ASSERT(!obd_pid_supported_has(&set, 0x21), "21 is beyond what we've read");
+
+    r = obd_pid_supported_list(&set, pids, sizeof(pids), &count);
+    TEST_ASSERT(r == OBD_OK, "list should succeed");
+    TEST_ASSERT(count == 16, "16 PIDs, not counting bitmap 20");
+    TEST_ASSERT(pids[0] == 0x01 && pids[15] == 0x1C, "ascending order");
+
+    TEST_ASSERT(obd_pid_supported_next(&set, &base) == 1 && base == 0x20,
+                "bit 0 of the bitmap points to PID 20");
+    r = obd_pid_supported_parse("41 20 00 00 00 00", 0x01, &set);
+    TEST_ASSERT(r == OBD_OK, "second bitmap should parse");
+    TEST_ASSERT(obd_pid_supported_next(&set, &base) == 0, "chain should end");
+
+    /* Small buffer, wrong service, not a bitmap PID */
+    r = obd_pid_supported_list(&set, pids, 4, &count);
+    TEST_ASSERT(r == OBD_ERROR_BUFFER_TOO_SMALL, "4 slots is too few");
+    r = obd_pid_supported_parse(TEST_CLEAN_PID_SUPPORTED, 0x09, &set);
+    TEST_ASSERT(r == OBD_ERROR_PARSE_FAILED, "a Mode 01 reply holds no Mode 09 bitmap");
+    r = obd_pid_supported_parse(TEST_CLEAN_RPM, 0x01, &set);
+    TEST_ASSERT(r == OBD_ERROR_PARSE_FAILED, "PID 0C is not a bitmap");
+
+    printf("  PASS: supported-PID bitmaps\n");
+    return 0;
+}
+
 int main(void)
 {
     int failures = 0;
@@ -104,8 +146,9 @@ int main(void)
     failures += test_build_request();
     failures += test_parse_response();
     failures += test_parse_errors();
+    failures += test_supported();
 
     printf("\n%s (%d test functions)\n",
-           failures == 0 ? "ALL PASSED" : "SOME FAILED", 3);
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
     return failures;
 }
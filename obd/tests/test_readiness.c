@@ -0,0 +1,148 @@
+/**
+ * test_readiness.c — Tests for readiness monitors (PID 01 / PID 41).
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <stdio.h>
+#include <string.h>
+
+static obd_readiness_t decode(const char *response)
+{
+    obd_pid_response_t pid;
+    obd_readiness_t r;
+
+    memset(&r, 0xFF, sizeof(r));
+    if (obd_pid_parse_response(response, &pid) == OBD_OK) {
+        obd_readiness_decode(&pid, &r);
+    }
+    return r;
+}
+
+/* ── Test: PID 01, spark ignition ──────────────────────────────────── */
+static int test_decode_spark(void)
+{
+    obd_readiness_t r = decode(TEST_CLEAN_READINESS_SPARK);
+
+    TEST_ASSERT(r.flags == OBD_READINESS_MIL, "MIL on, spark, since clear");
+    TEST_ASSERT(r.dtc_count == 3, "3 DTCs");
+    TEST_ASSERT(r.supported == (OBD_READY_CONTINUOUS | OBD_READY_CATALYST | OBD_READY_EVAP |
+                                OBD_READY_O2_SENSOR | OBD_READY_O2_HEATER),
+                "supported monitors");
+    TEST_ASSERT(r.incomplete == OBD_READY_EVAP, "EVAP incomplete");
+    TEST_ASSERT(obd_readiness_pending(&r, OBD_READY_CONTINUOUS) == OBD_READY_EVAP, "pending");
+    TEST_ASSERT(sizeof(obd_readiness_t) == 6, "packed into 6 bytes");
+
+    printf("  PASS: PID 01, spark\n");
+    return 0;
+}
+
+/* ── Test: PID 01 diesel, PID 41, bad input ────────────────────────── */
+static int test_decode_other(void)
+{
+    obd_readiness_t r = decode(TEST_CLEAN_READINESS_DIESEL);
+    obd_pid_response_t pid;
+    obd_readiness_t out;
+
+    TEST_ASSERT(r.flags == OBD_READINESS_COMPRESSION && r.dtc_count == 0, "diesel, no MIL");
+    TEST_ASSERT(r.incomplete == (OBD_READY_FUEL_SYSTEM | OBD_READY_HEATED_CAT |
+                                 OBD_READY_O2_HEATER), "fuel, NOx/SCR, PM filter");
+    TEST_ASSERT(strcmp(obd_readiness_monitor_name(4, 1), "NOx/SCR Aftertreatment") == 0 &&
+                strcmp(obd_readiness_monitor_name(9, 1), "PM Filter") == 0 &&
+                strcmp(obd_readiness_monitor_name(9, 0), "O2 Sensor Heater") == 0,
+                "names depend on the engine");
+    TEST_ASSERT(obd_readiness_monitor_name(5, 1) == NULL, "reserved on diesel");
+    TEST_ASSERT(obd_readiness_monitor_name(OBD_READY_MONITOR_COUNT, 0) == NULL, "out of range");
+
+    r = decode(TEST_CLEAN_READINESS_CYCLE);
+    TEST_ASSERT(r.flags == OBD_READINESS_THIS_CYCLE, "PID 41: this cycle, no MIL");
+    TEST_ASSERT(r.incomplete == OBD_READY_CATALYST, "catalyst not done this cycle");
+
+    obd_pid_parse_response(TEST_CLEAN_RPM, &pid);
+    TEST_ASSERT(obd_readiness_decode(&pid, &out) == OBD_ERROR_UNKNOWN_PID, "PID 0C");
+    obd_pid_parse_response("41 01 83 07 65", &pid);
+    TEST_ASSERT(obd_readiness_decode(&pid, &out) == OBD_ERROR_PARSE_FAILED, "3 bytes");
+    TEST_ASSERT(obd_readiness_decode(NULL, &out) == OBD_ERROR_INVALID_ARG, "NULL");
+
+    printf("  PASS: diesel, PID 41, bad input\n");
+    return 0;
+}
+
+/* ── Test: inspection rules ────────────────────────────────────────── */
+static int test_policy(void)
+{
+    obd_readiness_policy_t p;
+    obd_readiness_t r = decode(TEST_CLEAN_READINESS_SPARK);
+
+    TEST_ASSERT(obd_readiness_policy_init(&p, 1995) == OBD_ERROR_INVALID_ARG, "pre-OBD-II");
+    TEST_ASSERT(obd_readiness_policy_init(&p, 1999) == OBD_OK && p.max_incomplete == 2,
+                "1996-2000: two allowed");
+    TEST_ASSERT(obd_readiness_policy_init(&p, 2004) == OBD_OK && p.max_incomplete == 1,
+                "2001 on: one allowed");
+
+    TEST_ASSERT(!obd_readiness_is_ready(&r, &p), "lit MIL fails");
+    p.allow_mil = 1;
+    TEST_ASSERT(obd_readiness_is_ready(&r, &p), "one incomplete is fine");
+    p.max_incomplete = 0;
+    TEST_ASSERT(!obd_readiness_is_ready(&r, &p), "but not with zero allowed");
+    p.ignore |= OBD_READY_EVAP;
+    TEST_ASSERT(obd_readiness_is_ready(&r, &p), "unless EVAP is exempt");
+
+    printf("  PASS: inspection rules\n");
+    return 0;
+}
+
+/* ── Test: a fleet at once ─────────────────────────────────────────── */
+static int test_batch(void)
+{
+    obd_readiness_t fleet[1000];
+    uint8_t ready[1000];
+    size_t pending[OBD_READY_MONITOR_COUNT];
+    obd_readiness_policy_t p;
+    size_t i, n;
+
+    /* Every third vehicle the diesel (2 pending), the others the spark
+     * one with the MIL off (1 pending) */
+    for (i = 0; i < 1000; i++) {
+        fleet[i] = decode(i % 3 == 0 ? TEST_CLEAN_READINESS_DIESEL : TEST_CLEAN_READINESS_SPARK);
+        fleet[i].flags &= (uint8_t)~OBD_READINESS_MIL;
+    }
+    fleet[1].flags |= OBD_READINESS_MIL;
+
+    obd_readiness_policy_init(&p, 2010);
+    n = obd_readiness_check_batch(fleet, 1000, &p, ready);
+    TEST_ASSERT(n == 666 - 1, "spark ones pass, but for the one with the MIL on");
+    TEST_ASSERT(ready[0] == 0 && ready[1] == 0 && ready[2] == 1, "per-vehicle verdicts");
+    TEST_ASSERT(obd_readiness_check_batch(fleet, 1000, &p, NULL) == n, "without verdicts");
+
+    obd_readiness_policy_init(&p, 1999);
+    TEST_ASSERT(obd_readiness_check_batch(fleet, 1000, &p, NULL) == 999, "two allowed");
+
+    memset(pending, 0, sizeof(pending));
+    TEST_ASSERT(obd_readiness_tally_batch(fleet, 1000, OBD_READY_CONTINUOUS, pending) == OBD_OK,
+                "tally");
+    TEST_ASSERT(pending[5] == 666, "EVAP on every spark engine");
+    TEST_ASSERT(pending[4] == 334 && pending[9] == 334, "NOx/SCR and PM filter on the diesels");
+    TEST_ASSERT(pending[1] == 0, "continuous monitors ignored");
+    TEST_ASSERT(obd_readiness_tally_batch(fleet, 1000, 0, NULL) == OBD_ERROR_INVALID_ARG,
+                "NULL tally");
+
+    printf("  PASS: fleet batch\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== readiness tests ===\n");
+    failures += test_decode_spark();
+    failures += test_decode_other();
+    failures += test_policy();
+    failures += test_batch();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
@@ -0,0 +1,124 @@
+/**
+ * test_reply.c — Tests for multi-frame CAN reply reassembly.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <stdio.h>
+#include <string.h>
+
+/* The Mode 06 message in TEST_CLEAN_MONITOR_SEGMENTS, without padding */
+static const uint8_t monitor_message[] = {
+    0x46, 0x01, 0x0B, 0x24, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF,
+    0x01, 0x0C, 0x24, 0x00, 0x15, 0x00, 0x00, 0x00, 0x10,
+};
+
+/* ── Test: a plain line is one message ─────────────────────────────── */
+static int test_single_frame(void)
+{
+    obd_reply_t replies[OBD_MAX_ECUS];
+    size_t count = 0;
+    obd_result_t r;
+
+    r = obd_reply_reassemble(TEST_CLEAN_RPM, replies, OBD_MAX_ECUS, &count);
+    TEST_ASSERT(r == OBD_OK, "single frame should reassemble");
+    TEST_ASSERT(count == 1, "one message");
+    TEST_ASSERT(replies[0].ecu == 0 && replies[0].len == 4, "4 bytes, no CAN id");
+    TEST_ASSERT(replies[0].data[0] == 0x41 && replies[0].data[3] == 0xF8, "bytes in order");
+
+    /* Legacy protocols: each line is its own message */
+    r = obd_reply_reassemble(TEST_CLEAN_VIN_MULTILINE, replies, OBD_MAX_ECUS, &count);
+    TEST_ASSERT(r == OBD_OK && count == 5, "five VIN lines, five messages");
+
+    printf("  PASS: single frames\n");
+    return 0;
+}
+
+/* ── Test: headers off, length line + numbered segments ────────────── */
+static int test_segments(void)
+{
+    obd_reply_t replies[OBD_MAX_ECUS];
+    size_t count = 0;
+    obd_result_t r;
+
+    r = obd_reply_reassemble(TEST_CLEAN_MONITOR_SEGMENTS, replies, OBD_MAX_ECUS, &count);
+    TEST_ASSERT(r == OBD_OK, "segments should reassemble");
+    TEST_ASSERT(count == 1, "one message");
+    TEST_ASSERT(replies[0].len == sizeof(monitor_message), "padding should be cut off");
+    TEST_ASSERT(memcmp(replies[0].data, monitor_message, sizeof(monitor_message)) == 0,
+                "bytes in order");
+
+    printf("  PASS: headers off, segments\n");
+    return 0;
+}
+
+/* ── Test: headers on, two ECUs interleaved ────────────────────────── */
+static int test_headers_interleaved(void)
+{
+    obd_reply_t replies[OBD_MAX_ECUS];
+    size_t count = 0;
+    obd_result_t r;
+
+    r = obd_reply_reassemble(TEST_CLEAN_MONITOR_HEADERS, replies, OBD_MAX_ECUS, &count);
+    TEST_ASSERT(r == OBD_OK, "interleaved frames should reassemble");
+    TEST_ASSERT(count == 2, "two ECUs, two messages");
+    TEST_ASSERT(replies[0].ecu == 0x7E8 && replies[1].ecu == 0x7E9, "in order of first frame");
+    TEST_ASSERT(replies[0].len == sizeof(monitor_message), "7E8: 19 bytes");
+    TEST_ASSERT(memcmp(replies[0].data, monitor_message, sizeof(monitor_message)) == 0,
+                "7E8: bytes in order");
+    TEST_ASSERT(replies[1].len == 10 && replies[1].data[9] == 0xFF, "7E9: 10 bytes");
+
+    /* Single frame: the PCI byte gives the length */
+    r = obd_reply_reassemble("7E8 03 41 0D 3C 00 00 00 00", replies, OBD_MAX_ECUS, &count);
+    TEST_ASSERT(r == OBD_OK && count == 1 && replies[0].len == 3, "SF with padding");
+
+    printf("  PASS: headers on, interleaved ECUs\n");
+    return 0;
+}
+
+/* ── Test: missing or out-of-order frames ──────────────────────────── */
+static int test_broken(void)
+{
+    obd_reply_t replies[OBD_MAX_ECUS];
+    size_t count = 0;
+    obd_result_t r;
+
+    r = obd_reply_reassemble("013\r0: 46 01 0B 24 00 00\r2: 00 15 00 00 00 10 00",
+                             replies, OBD_MAX_ECUS, &count);
+    TEST_ASSERT(r == OBD_ERROR_PARSE_FAILED, "segment 1 missing");
+
+    r = obd_reply_reassemble("013\r0: 46 01 0B 24 00 00\r1: 00 00 FF FF 01 0C 24",
+                             replies, OBD_MAX_ECUS, &count);
+    TEST_ASSERT(r == OBD_ERROR_PARSE_FAILED, "last segment missing");
+
+    r = obd_reply_reassemble("7E8 21 00 00 FF FF 01 0C 24", replies, OBD_MAX_ECUS, &count);
+    TEST_ASSERT(r == OBD_ERROR_PARSE_FAILED, "consecutive frame without a first frame");
+
+    r = obd_reply_reassemble(TEST_CLEAN_MONITOR_HEADERS, replies, 1, &count);
+    TEST_ASSERT(r == OBD_ERROR_BUFFER_TOO_SMALL, "two messages, room for one");
+
+    r = obd_reply_reassemble("", replies, OBD_MAX_ECUS, &count);
+    TEST_ASSERT(r == OBD_ERROR_NO_DATA, "nothing at all");
+
+    r = obd_reply_reassemble(NULL, replies, OBD_MAX_ECUS, &count);
+    TEST_ASSERT(r == OBD_ERROR_INVALID_ARG, "NULL should error");
+
+    printf("  PASS: broken replies\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== reply tests ===\n");
+    failures += test_single_frame();
+    failures += test_segments();
+    failures += test_headers_interleaved();
+    failures += test_broken();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
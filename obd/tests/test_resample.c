@@ -0,0 +1,161 @@
+/**
+ * test_resample.c — Tests for the multi-rate resampler.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FLOAT_NEAR(a, b, tolerance) (fabs((double)(a) - (double)(b)) < (tolerance))
+#define MS 1000u
+
+static obd_resampler_t rs;
+
+/* ── Test: two rates, linear, on a 100 ms grid ─────────────────────── */
+static int test_stream_linear(void)
+{
+    obd_resample_row_t row;
+    unsigned i;
+
+    TEST_ASSERT(obd_resample_init(&rs, 100 * MS, 500 * MS) == OBD_OK, "init");
+    TEST_ASSERT(obd_resample_add_channel(&rs, 0x0C, OBD_RESAMPLE_LINEAR) == OBD_OK, "RPM");
+    TEST_ASSERT(obd_resample_add_channel(&rs, 0x0D, OBD_RESAMPLE_LINEAR) == OBD_OK, "speed");
+    TEST_ASSERT(obd_resample_poll(&rs, 0, &row) == OBD_ERROR_NO_DATA, "nothing yet");
+
+    /* RPM every 100 ms from 0, speed every 200 ms from 20 */
+    for (i = 0; i <= 5; i++) {
+        obd_resample_push(&rs, 0x0C, i * 100 * MS, 1000.0f + 10.0f * (float)i);
+    }
+    for (i = 0; i < 3; i++) {
+        obd_resample_push(&rs, 0x0D, (20 + i * 200) * MS, 50.0f + 10.0f * (float)i);
+    }
+
+    TEST_ASSERT(obd_resample_poll(&rs, 500 * MS, &row) == OBD_OK && row.t_us == 0, "row at 0");
+    TEST_ASSERT(row.valid == 0x1 && row.values[0] == 1000.0f, "no speed before its first sample");
+
+    TEST_ASSERT(obd_resample_poll(&rs, 500 * MS, &row) == OBD_OK && row.t_us == 100 * MS,
+                "row at 100");
+    TEST_ASSERT(row.valid == 0x3 && row.held == 0, "both");
+    TEST_ASSERT(row.values[0] == 1010.0f && FLOAT_NEAR(row.values[1], 54.0, 1e-4),
+                "speed 40% from 50 to 60");
+
+    obd_resample_poll(&rs, 500 * MS, &row);
+    obd_resample_poll(&rs, 500 * MS, &row);
+    TEST_ASSERT(row.t_us == 300 * MS && FLOAT_NEAR(row.values[1], 64.0, 1e-4), "row at 300");
+    obd_resample_poll(&rs, 500 * MS, &row);
+    TEST_ASSERT(row.t_us == 400 * MS && FLOAT_NEAR(row.values[1], 69.0, 1e-4), "row at 400");
+
+    /* Speed's last sample is at 420: row 500 waits, at most 500 ms */
+    TEST_ASSERT(obd_resample_poll(&rs, 600 * MS, &row) == OBD_ERROR_NO_DATA, "waits for speed");
+    TEST_ASSERT(obd_resample_poll(&rs, 1000 * MS, &row) == OBD_OK && row.t_us == 500 * MS,
+                "latency bound reached");
+    TEST_ASSERT(row.held == 0x2 && row.values[1] == 70.0f, "speed held");
+    TEST_ASSERT(rs.rows == 6 && rs.overruns == 0, "6 rows, nothing lost");
+
+    printf("  PASS: streaming, linear\n");
+    return 0;
+}
+
+/* ── Test: hold, grid alignment, bad samples, full ring ────────────── */
+static int test_stream_hold(void)
+{
+    obd_resample_row_t row;
+    unsigned i;
+
+    obd_resample_init(&rs, 100 * MS, 0);
+    obd_resample_add_channel(&rs, 0x05, OBD_RESAMPLE_HOLD);
+    TEST_ASSERT(obd_resample_add_channel(&rs, 0x05, OBD_RESAMPLE_HOLD) == OBD_ERROR_INVALID_ARG,
+                "added twice");
+    TEST_ASSERT(obd_resample_add_channel(&rs, 0x0C, 7) == OBD_ERROR_INVALID_ARG, "bad mode");
+
+    obd_resample_push(&rs, 0x05, 130 * MS, 80.0f);
+    obd_resample_push(&rs, 0x05, 290 * MS, 81.0f);
+    TEST_ASSERT(obd_resample_push(&rs, 0x05, 290 * MS, 82.0f) == OBD_OK, "same time replaces");
+    TEST_ASSERT(obd_resample_push(&rs, 0x05, 200 * MS, 1.0f) == OBD_ERROR_INVALID_ARG,
+                "older than the last");
+    TEST_ASSERT(obd_resample_push(&rs, 0x0C, 0, 1.0f) == OBD_ERROR_UNKNOWN_PID, "not added");
+
+    TEST_ASSERT(obd_resample_poll(&rs, 0, &row) == OBD_OK && row.t_us == 200 * MS,
+                "first row on the grid after the first sample");
+    TEST_ASSERT(row.values[0] == 80.0f, "held, not interpolated");
+    TEST_ASSERT(obd_resample_poll(&rs, 0, &row) == OBD_ERROR_NO_DATA, "300 waits for a sample");
+    TEST_ASSERT(obd_resample_poll(&rs, 300 * MS, &row) == OBD_OK && row.t_us == 300 * MS,
+                "zero latency: out at 300");
+    TEST_ASSERT(row.values[0] == 82.0f && row.held == 0x1, "replaced value, held");
+
+    /* Samples with no rows taken: the ring keeps the newest */
+    for (i = 0; i < OBD_RESAMPLE_RING + 8; i++) {
+        obd_resample_push(&rs, 0x05, (1000 + i) * MS, (float)i);
+    }
+    TEST_ASSERT(rs.overruns == 9, "oldest dropped");
+    TEST_ASSERT(rs.inputs[0].count == OBD_RESAMPLE_RING, "ring full");
+
+    printf("  PASS: streaming, hold\n");
+    return 0;
+}
+
+/* ── Test: a whole trip at once ────────────────────────────────────── */
+static int test_batch(void)
+{
+    static uint64_t t[400];
+    static float v[400], out[1000];
+    obd_resample_row_t row;
+    size_t i, n = 0, bad = 0;
+
+    /* A ramp sampled irregularly: 1 unit per ms, every 7 to 13 ms */
+    for (i = 0; i < 400; i++) {
+        t[i] = (i == 0 ? 5 : t[i - 1] / MS + 7 + i % 7) * MS;
+        v[i] = (float)(t[i] / MS);
+    }
+
+    TEST_ASSERT(obd_resample_batch(t, v, 400, OBD_RESAMPLE_LINEAR, 0, 4 * MS, out, 1000) ==
+                OBD_OK, "batch");
+    TEST_ASSERT(out[0] == 5.0f, "before the first sample: held");
+    for (i = 2; i < 1000 && i * 4 * MS <= t[399]; i++) {
+        if (!FLOAT_NEAR(out[i], (double)(i * 4), 1e-3)) bad++;
+    }
+    TEST_ASSERT(bad == 0, "a ramp comes back exactly, across blocks");
+    TEST_ASSERT(out[999] == v[399], "after the last: held");
+
+    TEST_ASSERT(obd_resample_batch(t, v, 400, OBD_RESAMPLE_HOLD, 0, 4 * MS, out, 1000) ==
+                OBD_OK && out[3] == 5.0f && out[4] == 13.0f, "hold: last sample at or before");
+
+    /* Same answers as streaming */
+    obd_resample_init(&rs, 4 * MS, 0);
+    obd_resample_add_channel(&rs, 0x0C, OBD_RESAMPLE_LINEAR);
+    obd_resample_batch(t, v, 400, OBD_RESAMPLE_LINEAR, 0, 4 * MS, out, 1000);
+    for (i = 0; i < 400; i++) {
+        obd_resample_push(&rs, 0x0C, t[i], v[i]);
+        while (obd_resample_poll(&rs, t[i], &row) == OBD_OK) {
+            if (!FLOAT_NEAR(row.values[0], out[row.t_us / (4 * MS)], 1e-3)) bad++;
+            n++;
+        }
+    }
+    TEST_ASSERT(n > 900 && bad == 0, "streaming and batch agree");
+    TEST_ASSERT(rs.overruns == 0 && rs.inputs[0].count <= 2, "ring trimmed as rows go out");
+
+    t[5] = 0;
+    TEST_ASSERT(obd_resample_batch(t, v, 400, OBD_RESAMPLE_LINEAR, 0, 4 * MS, out, 1000) ==
+                OBD_ERROR_INVALID_ARG, "out of order");
+    TEST_ASSERT(obd_resample_batch(t, v, 0, OBD_RESAMPLE_LINEAR, 0, 4 * MS, out, 1000) ==
+                OBD_ERROR_INVALID_ARG, "no samples");
+
+    printf("  PASS: batch\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== resample tests ===\n");
+    failures += test_stream_linear();
+    failures += test_stream_hold();
+    failures += test_batch();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 3);
+    return failures;
+}
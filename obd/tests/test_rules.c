@@ -0,0 +1,235 @@
+/**
+ * test_rules.c — Tests for the alert rule engine.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FLOAT_NEAR(a, b, tolerance) (fabs((double)(a) - (double)(b)) < (tolerance))
+#define MS 1000u
+#define S  1000000u
+
+static obd_rules_t rules;
+
+/* Compile "cond" alone and run it once on the given channel values */
+static int holds(const char *cond, float coolant, float rpm)
+{
+    obd_rule_event_t ev;
+
+    obd_rules_init(&rules);
+    if (obd_rules_add(&rules, "t", cond, NULL) != OBD_OK) return -1;
+    obd_rules_feed(&rules, 0x05, coolant, 0);
+    obd_rules_feed(&rules, 0x0C, rpm, 0);
+    return obd_rules_poll(&rules, &ev) == OBD_OK && ev.active;
+}
+
+/* ── Test: the expression language ─────────────────────────────────── */
+static int test_expressions(void)
+{
+    TEST_ASSERT(holds("$05 > 110", 111, 0) == 1 && holds("$05 > 110", 110, 0) == 0, ">");
+    TEST_ASSERT(holds("$05 >= 110", 110, 0) == 1 && holds("$5 <= 109.5", 109.5f, 0) == 1,
+                ">= <=, one hex digit");
+    TEST_ASSERT(holds("$05 == 90 && $0C != 0", 90, 800) == 1, "== != &&");
+    TEST_ASSERT(holds("$05 > 120 || $0C > 6500", 90, 7000) == 1, "||");
+    TEST_ASSERT(holds("$0C / 4 - $05 * 2 > 0", 100, 1000) == 1 &&
+                holds("$0C / 4 - $05 * 2 > 0", 130, 1000) == 0, "precedence");
+    TEST_ASSERT(holds("-($05 - 100) > 5", 90, 0) == 1, "unary minus, parentheses");
+    TEST_ASSERT(holds("!($05 > 100)", 90, 0) == 1 && holds("!$05", 0, 0) == 1, "not");
+    TEST_ASSERT(holds("abs($05 - 100) < 3", 98, 0) == 1, "abs");
+    TEST_ASSERT(holds("min($05, $0C) > 50 && max($05, $0C) < 1000", 60, 900) == 1, "min max");
+    TEST_ASSERT(holds("$0C", 0, 800) == 1 && holds("$0C", 0, 0) == 0, "a value is true if not 0");
+    TEST_ASSERT(holds("$0C / 0 > 0 || 0 / $0C", 0, 0) == 0, "NaN is false");
+    TEST_ASSERT(holds("  $05>110for  1s ", 120, 0) == 0, "spacing; for delays it");
+
+    printf("  PASS: expressions\n");
+    return 0;
+}
+
+/* ── Test: for, clear, hold ────────────────────────────────────────── */
+static int test_windows(void)
+{
+    obd_rule_event_t ev;
+    size_t hot, i;
+
+    obd_rules_init(&rules);
+    TEST_ASSERT(obd_rules_add(&rules, "coolant hot", "$05 > 110 for 10s clear $05 < 105 hold 2s",
+                              &hot) == OBD_OK && hot == 0, "compiled");
+
+    /* Hot for 5 s, dips, then hot for good */
+    for (i = 0; i <= 5; i++) obd_rules_feed(&rules, 0x05, 112.0f, i * S);
+    obd_rules_feed(&rules, 0x05, 108.0f, 6 * S);
+    TEST_ASSERT(rules.rules[hot].state == OBD_RULE_IDLE, "dip resets the window");
+    for (i = 7; i <= 16; i++) obd_rules_feed(&rules, 0x05, 113.0f, i * S);
+    TEST_ASSERT(obd_rules_poll(&rules, &ev) == OBD_ERROR_NO_DATA, "9 s: not yet");
+    obd_rules_feed(&rules, 0x05, 114.0f, 17 * S + 500 * MS);
+    TEST_ASSERT(obd_rules_poll(&rules, &ev) == OBD_OK && ev.active == 1 && ev.rule == hot,
+                "started");
+    TEST_ASSERT(ev.t_us == 17 * S && ev.value == 114.0f, "at 7 s + 10 s, with the value");
+    TEST_ASSERT(strcmp(ev.name, "coolant hot") == 0, "name");
+
+    /* Hysteresis: 108 isn't below 105 */
+    obd_rules_feed(&rules, 0x05, 108.0f, 18 * S);
+    TEST_ASSERT(rules.rules[hot].state == OBD_RULE_ACTIVE, "still hot at 108");
+    obd_rules_feed(&rules, 0x05, 104.0f, 19 * S);
+    obd_rules_feed(&rules, 0x05, 106.0f, 20 * S);
+    TEST_ASSERT(rules.rules[hot].state == OBD_RULE_ACTIVE, "hold: 1 s below isn't enough");
+    obd_rules_feed(&rules, 0x05, 100.0f, 21 * S);
+    TEST_ASSERT(obd_rules_poll(&rules, &ev) == OBD_ERROR_NO_DATA, "clearing");
+
+    /* No more samples: tick lets hold run out */
+    obd_rules_tick(&rules, 22 * S);
+    TEST_ASSERT(obd_rules_poll(&rules, &ev) == OBD_ERROR_NO_DATA, "1 s in");
+    obd_rules_tick(&rules, 24 * S);
+    TEST_ASSERT(obd_rules_poll(&rules, &ev) == OBD_OK && ev.active == 0 && ev.t_us == 23 * S,
+                "ended when hold ran out");
+    TEST_ASSERT(rules.rules[hot].state == OBD_RULE_IDLE, "idle");
+
+    /* No clear: ends when the condition is false */
+    TEST_ASSERT(obd_rules_add(&rules, "redline", "$0C > 6500", NULL) == OBD_OK, "redline");
+    obd_rules_feed(&rules, 0x0C, 6600.0f, 30 * S);
+    obd_rules_feed(&rules, 0x0C, 6700.0f, 31 * S);
+    obd_rules_feed(&rules, 0x0C, 6000.0f, 32 * S);
+    TEST_ASSERT(obd_rules_poll(&rules, &ev) == OBD_OK && ev.active && ev.t_us == 30 * S, "on");
+    TEST_ASSERT(obd_rules_poll(&rules, &ev) == OBD_OK && !ev.active && ev.t_us == 32 * S, "off");
+    TEST_ASSERT(obd_rules_poll(&rules, &ev) == OBD_ERROR_NO_DATA, "once each");
+
+    printf("  PASS: for, clear, hold\n");
+    return 0;
+}
+
+/* ── Test: several channels, rates, only affected rules run ────────── */
+static int test_channels(void)
+{
+    obd_rule_event_t ev;
+    obd_pid_response_t pid;
+    obd_sensor_value_t value;
+    uint64_t before;
+    size_t crank, brake, i;
+
+    obd_rules_init(&rules);
+    obd_rules_add(&rules, "crank sag", "$42 < 9.5 && $0C > 0 && $0C < 400", &crank);
+    obd_rules_add(&rules, "hard braking", "rate($0D) < -15 for 500ms", &brake);
+    TEST_ASSERT(rules.channel_count == 3, "3 channels");
+
+    /* Voltage alone: RPM not seen yet, nothing runs */
+    obd_rules_feed(&rules, 0x42, 9.0f, 0);
+    TEST_ASSERT(rules.evaluations == 0, "waits for every input");
+    obd_pid_parse_response(TEST_CLEAN_RPM, &pid);
+    obd_sensor_decode(&pid, &value);
+    obd_rules_feed_sensor(&rules, &value, 10 * MS);
+    TEST_ASSERT(rules.evaluations == 1, "1726 rpm: one rule ran");
+    obd_rules_feed(&rules, 0x0C, 250.0f, 20 * MS);
+    TEST_ASSERT(obd_rules_poll(&rules, &ev) == OBD_OK && ev.rule == crank && ev.value == 9.0f,
+                "cranking at 9 V");
+
+    /* Speed: only the braking rule, and only from the second sample */
+    before = rules.evaluations;
+    obd_rules_feed(&rules, 0x0D, 80.0f, 0);
+    TEST_ASSERT(rules.evaluations == before, "rate needs two samples");
+    for (i = 1; i <= 10; i++) {
+        obd_rules_feed(&rules, 0x0D, 80.0f - 2.0f * (float)i, i * 100 * MS);   /* -20 km/h/s */
+    }
+    TEST_ASSERT(rules.evaluations == before + 10, "crank rule never ran");
+    TEST_ASSERT(obd_rules_poll(&rules, &ev) == OBD_OK && ev.rule == brake && ev.active &&
+                ev.t_us == 600 * MS, "braking, 500 ms after it began");
+
+    TEST_ASSERT(obd_rules_feed(&rules, 0x0D, 0.0f, 500 * MS) == OBD_ERROR_INVALID_ARG,
+                "older sample");
+    TEST_ASSERT(obd_rules_feed(&rules, 0x11, 0.0f, 0) == OBD_ERROR_UNKNOWN_PID, "no rule reads it");
+
+    /* Events pile up: the oldest go */
+    obd_rules_init(&rules);
+    obd_rules_add(&rules, "flap", "$0C > 1000", NULL);
+    for (i = 0; i < OBD_RULES_EVENTS + 6; i++) {
+        obd_rules_feed(&rules, 0x0C, (i % 2) ? 0.0f : 2000.0f, i * S);
+    }
+    TEST_ASSERT(rules.event_count == OBD_RULES_EVENTS && rules.events_lost == 6, "ring");
+    TEST_ASSERT(obd_rules_poll(&rules, &ev) == OBD_OK && ev.t_us == 6 * S, "oldest kept");
+
+    printf("  PASS: channels and rates\n");
+    return 0;
+}
+
+/* ── Test: mistakes in the text, limits ────────────────────────────── */
+static int test_errors(void)
+{
+    static const struct { const char *text; size_t at; } bad[] = {
+        { "$05 >",                  5 },
+        { "$05 > 110 for 10",       16 },
+        { "$05 > 110 for ten s",    14 },
+        { "($05 > 110",             10 },
+        { "$ > 3",                  1 },
+        { "$12345 > 3",             1 },
+        { "$05 > 110 junk",         10 },
+        { "1 > 0",                  5 },
+        { "abs $05",                4 },
+        { "max($05) > 1",           7 },
+    };
+    char text[256];
+    size_t i, n;
+
+    obd_rules_init(&rules);
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        TEST_ASSERT(obd_rules_add(&rules, "bad", bad[i].text, NULL) == OBD_ERROR_PARSE_FAILED,
+                    bad[i].text);
+        if (rules.error_at != bad[i].at) {
+            printf("  FAIL: \"%s\": error at %u (%s)\n", bad[i].text,
+                   (unsigned)rules.error_at, rules.error);
+            return 1;
+        }
+    }
+    TEST_ASSERT(rules.rule_count == 0 && rules.code_len == 0 && rules.constant_count == 0 &&
+                rules.channel_count == 0, "failures leave nothing behind");
+
+    /* Deeper than the stack */
+    strcpy(text, "$05");
+    for (i = 0; i < OBD_RULES_STACK; i++) strcat(text, " + ($05");
+    for (i = 0; i < OBD_RULES_STACK; i++) strcat(text, ")");
+    TEST_ASSERT(obd_rules_add(&rules, "deep", text, NULL) == OBD_ERROR_BUFFER_TOO_SMALL &&
+                strcmp(rules.error, "expression too deep") == 0, "too deep");
+
+    /* Too many channels */
+    for (i = 0, n = 0; i < OBD_RULES_MAX_CHANNELS + 1; i++) {
+        sprintf(text, "$%X > 1", (unsigned)(0x100 + i));
+        if (obd_rules_add(&rules, "ch", text, NULL) == OBD_OK) n++;
+    }
+    TEST_ASSERT(n == OBD_RULES_MAX_CHANNELS, "32 channels");
+    TEST_ASSERT(strcmp(rules.error, "too many channels") == 0, "the 33rd");
+
+    /* Too many rules */
+    for (i = rules.rule_count; i < OBD_RULES_MAX; i++) {
+        obd_rules_add(&rules, "a rule with a long, long name", "$100 > 2", NULL);
+    }
+    TEST_ASSERT(strcmp(rules.rules[OBD_RULES_MAX - 1].name, "a rule with a long, lon") == 0,
+                "name cut short");
+    TEST_ASSERT(obd_rules_add(&rules, "one more", "$100 > 3", NULL) == OBD_ERROR_BUFFER_TOO_SMALL,
+                "64 rules");
+    TEST_ASSERT(obd_rules_feed(&rules, 0x100, 5.0f, 0) == OBD_OK &&
+                rules.evaluations == OBD_RULES_MAX - OBD_RULES_MAX_CHANNELS + 1,
+                "every rule on $100 ran");
+
+    TEST_ASSERT(obd_rules_add(NULL, "x", "$05 > 1", NULL) == OBD_ERROR_INVALID_ARG, "NULL");
+    TEST_ASSERT(obd_rules_poll(&rules, NULL) == OBD_ERROR_INVALID_ARG, "NULL event");
+
+    printf("  PASS: errors and limits\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== rules tests ===\n");
+    failures += test_expressions();
+    failures += test_windows();
+    failures += test_channels();
+    failures += test_errors();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
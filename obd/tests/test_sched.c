@@ -0,0 +1,219 @@
+/**
+ * test_sched.c — Tests for the adaptive poll scheduler.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MS 1000u
+#define S  1000000u
+
+static obd_sched_t sched;
+static int step_at;                 /* Seconds: coolant jumps 10 °C then */
+static uint32_t lcg = 12345;
+
+static float jitter(void)
+{
+    lcg = lcg * 1103515245u + 12345u;
+    return (float)((lcg >> 16) & 0x7FFF) / 32767.0f * 1.6f - 0.8f;
+}
+
+static float signal(uint8_t pid, uint64_t t_us)
+{
+    double t = (double)t_us / 1e6;
+
+    switch (pid) {
+    case 0x0C: return (float)(2000.0 + 1500.0 * sin(t * 0.5));
+    case 0x05: return step_at && t >= step_at ? 100.0f : 90.0f;
+    default:   return 50.0f + jitter();                     /* 0x2F fuel level */
+    }
+}
+
+/* Poll from from_us to to_us on a 10 ms clock, each reply 20 ms after it was sent */
+static void run(uint64_t from_us, uint64_t to_us)
+{
+    uint64_t now;
+    uint8_t mode, pid;
+
+    for (now = from_us; now < to_us; now += 10 * MS) {
+        while (obd_sched_next(&sched, now, &mode, &pid) == OBD_OK) {
+            obd_sched_feed(&sched, mode, pid, signal(pid, now + 20 * MS), now + 20 * MS);
+        }
+    }
+}
+
+static const obd_sched_entry_t *entry(uint8_t pid)
+{
+    size_t i;
+
+    for (i = 0; i < sched.count; i++) {
+        if (sched.entries[i].pid == pid) return &sched.entries[i];
+    }
+    return NULL;
+}
+
+static void setup(void)
+{
+    obd_sched_init(&sched);
+    obd_sched_add(&sched, 0x01, 0x0C, 50.0f, 100 * MS, 2 * S);
+    obd_sched_add(&sched, 0x01, 0x05, 1.0f, 500 * MS, 30 * S);
+    obd_sched_add(&sched, 0x01, 0x2F, 1.0f, 1 * S, 60 * S);
+}
+
+/* ── Test: steady PIDs slow down, busy ones don't ──────────────────── */
+static int test_rates(void)
+{
+    const obd_sched_entry_t *rpm, *coolant;
+    uint64_t fixed = 0, polls = 0;
+    size_t i;
+
+    step_at = 0;
+    setup();
+    run(0, 600 * S);
+    rpm = entry(0x0C);
+    coolant = entry(0x05);
+
+    TEST_ASSERT(coolant->interval_us == 30 * S, "steady coolant: max_us");
+    TEST_ASSERT(coolant->polls < 40, "...so about 20 polls in 10 minutes, not 1200");
+    TEST_ASSERT(rpm->interval_us < 500 * MS && rpm->polls > 1200,
+                "RPM moving 750 rpm/s: polled fast");
+
+    for (i = 0; i < sched.count; i++) {
+        fixed += sched.entries[i].fixed_polls;
+        polls += sched.entries[i].polls;
+    }
+    TEST_ASSERT(obd_sched_saved(&sched) == fixed - polls, "saved = fixed rate - actual");
+    TEST_ASSERT(coolant->fixed_polls >= 1190 && obd_sched_saved(&sched) > 1500,
+                "well over a thousand round trips saved");
+
+    printf("  PASS: steady vs busy\n");
+    return 0;
+}
+
+/* ── Test: a change it didn't expect ───────────────────────────────── */
+static int test_surprise(void)
+{
+    const obd_sched_entry_t *coolant;
+    uint64_t before, t;
+
+    step_at = 300;
+    setup();
+    run(0, 299 * S);
+    coolant = entry(0x05);
+    TEST_ASSERT(coolant->interval_us == 30 * S && coolant->surprises == 0, "settled");
+    before = coolant->polls;
+
+    for (t = 299 * S; coolant->polls == before && t < 340 * S; t += 10 * MS) {
+        run(t, t + 10 * MS);
+    }
+    TEST_ASSERT(coolant->surprises == 1, "the next poll after the step is a surprise");
+    TEST_ASSERT(coolant->interval_us == 500 * MS, "...and drops to min_us");
+    TEST_ASSERT(fabs(coolant->level - 100.0f) < 0.01f, "level jumps to the new value");
+
+    run(t, t + 300 * S);
+    TEST_ASSERT(coolant->interval_us == 30 * S && coolant->surprises == 1,
+                "steady again: back to max_us");
+
+    printf("  PASS: surprises\n");
+    return 0;
+}
+
+/* ── Test: noise isn't change ──────────────────────────────────────── */
+static int test_noise(void)
+{
+    const obd_sched_entry_t *fuel;
+
+    step_at = 0;
+    setup();
+    run(0, 1800 * S);
+    fuel = entry(0x2F);
+    TEST_ASSERT(fuel->noise > 0.2f && fuel->noise < 2.0f, "noise learnt");
+    TEST_ASSERT(fuel->interval_us >= 20 * S, "jitter under the resolution: polled slowly");
+    TEST_ASSERT(fuel->surprises < 5, "jitter isn't a surprise");
+    TEST_ASSERT(fabs(fuel->level - 50.0f) < 1.0f, "level near the true value");
+
+    printf("  PASS: noise\n");
+    return 0;
+}
+
+/* ── Test: priority, session results, errors ───────────────────────── */
+static int test_priority(void)
+{
+    obd_session_result_t result;
+    uint8_t mode, pid;
+
+    obd_sched_init(&sched);
+    TEST_ASSERT(obd_sched_deadline(&sched) == 0, "no PIDs, no deadline");
+    TEST_ASSERT(obd_sched_next(&sched, 0, &mode, &pid) == OBD_ERROR_NO_DATA, "nothing to send");
+    obd_sched_add(&sched, 0x01, 0x05, 1.0f, 30 * S, 30 * S);
+    obd_sched_add(&sched, 0x01, 0x0C, 50.0f, 100 * MS, 100 * MS);
+
+    TEST_ASSERT(obd_sched_next(&sched, 0, &mode, &pid) == OBD_OK && pid == 0x05 &&
+                obd_sched_next(&sched, 0, &mode, &pid) == OBD_OK && pid == 0x0C &&
+                mode == 0x01, "never sent: in the order added");
+    TEST_ASSERT(obd_sched_next(&sched, 50 * MS, &mode, &pid) == OBD_ERROR_NO_DATA &&
+                obd_sched_deadline(&sched) == 100 * MS, "not due until 100 ms");
+    TEST_ASSERT(obd_sched_next(&sched, 35 * S, &mode, &pid) == OBD_OK && pid == 0x0C,
+                "350 intervals late goes before 1.2 intervals late");
+    TEST_ASSERT(obd_sched_next(&sched, 35 * S, &mode, &pid) == OBD_OK && pid == 0x05 &&
+                obd_sched_next(&sched, 35 * S, &mode, &pid) == OBD_ERROR_NO_DATA,
+                "then the other");
+
+    /* A session result: the decoded value, timed by its first byte */
+    memset(&result, 0, sizeof(result));
+    result.status = OBD_OK;
+    result.mode = 0x01;
+    result.pid = 0x05;
+    result.has_value = 1;
+    result.value.pid = 0x05;
+    result.value.value = 88.0f;
+    result.trace.reached = 1u << OBD_TRACE_FIRST_BYTE | 1u << OBD_TRACE_PROMPT;
+    result.trace.t[OBD_TRACE_FIRST_BYTE] = 35 * S + 30 * MS;
+    result.trace.t[OBD_TRACE_PROMPT] = 35 * S + 45 * MS;
+    TEST_ASSERT(obd_sched_feed_result(&sched, &result) == OBD_OK &&
+                sched.entries[0].level == 88.0f &&
+                sched.entries[0].t_us == 35 * S + 30 * MS, "fed from a result");
+    result.status = OBD_ERROR_TIMEOUT;
+    TEST_ASSERT(obd_sched_feed_result(&sched, &result) == OBD_ERROR_NO_DATA, "timeout: nothing");
+    TEST_ASSERT(obd_sched_feed(&sched, 0x01, 0x05, 88.0f, 35 * S) == OBD_ERROR_INVALID_ARG,
+                "older than the last value");
+    TEST_ASSERT(obd_sched_feed(&sched, 0x01, 0x0D, 1.0f, 36 * S) == OBD_ERROR_UNKNOWN_PID,
+                "not polled");
+
+    TEST_ASSERT(obd_sched_add(&sched, 0x01, 0x05, 2.0f, 1 * S, 10 * S) == OBD_OK &&
+                sched.count == 2 && sched.entries[0].interval_us == 10 * S &&
+                sched.entries[0].level == 88.0f, "re-adding: new bounds, keeps what it learnt");
+    TEST_ASSERT(obd_sched_add(&sched, 0x01, 0x0D, 0.0f, 1, 2) == OBD_ERROR_INVALID_ARG &&
+                obd_sched_add(&sched, 0x01, 0x0D, 1.0f, 0, 2) == OBD_ERROR_INVALID_ARG &&
+                obd_sched_add(&sched, 0x01, 0x0D, 1.0f, 3, 2) == OBD_ERROR_INVALID_ARG,
+                "bad resolution or bounds");
+    TEST_ASSERT(obd_sched_next(NULL, 0, &mode, &pid) == OBD_ERROR_INVALID_ARG &&
+                obd_sched_feed_result(&sched, NULL) == OBD_ERROR_INVALID_ARG, "NULL");
+
+    for (pid = 0x10; sched.count < OBD_SCHED_MAX_PIDS; pid++) {
+        obd_sched_add(&sched, 0x01, pid, 1.0f, 1 * S, 1 * S);
+    }
+    TEST_ASSERT(obd_sched_add(&sched, 0x01, 0xF0, 1.0f, 1 * S, 1 * S) ==
+                OBD_ERROR_BUFFER_TOO_SMALL, "full");
+
+    printf("  PASS: priority and errors\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== sched tests ===\n");
+    failures += test_rates();
+    failures += test_surprise();
+    failures += test_noise();
+    failures += test_priority();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
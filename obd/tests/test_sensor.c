@@ -235,6 +235,20 @@ static int test_get_name(void)
     return 0;
 }
 
+/* ── Test: sensor get_byte_count ───────────────────────────────────── */
+static int test_get_byte_count(void)
+{
+    size_t n = 0;
+
+    TEST_ASSERT(obd_sensor_get_byte_count(0x0C, &n) == OBD_OK && n == 2, "RPM has 2 bytes");
+    TEST_ASSERT(obd_sensor_get_byte_count(0x0D, &n) == OBD_OK && n == 1, "speed has 1 byte");
+    TEST_ASSERT(obd_sensor_get_byte_count(0xFF, &n) == OBD_ERROR_UNKNOWN_PID,
+                "unknown PID should error");
+
+    printf("  PASS: sensor get_byte_count\n");
+    return 0;
+}
+
 int main(void)
 {
     int failures = 0;
@@ -254,8 +268,9 @@ int main(void)
     failures += test_dtc_count();
     failures += test_unknown_pid();
     failures += test_get_name();
+    failures += test_get_byte_count();
 
     printf("\n%s (%d test functions)\n",
-           failures == 0 ? "ALL PASSED" : "SOME FAILED", 14);
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 15);
     return failures;
 }
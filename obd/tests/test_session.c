@@ -0,0 +1,342 @@
+/**
+ * test_session.c — Tests for the sans-I/O request/response session.
+ *
+ * No adapter here: the tests play the adapter's part by feeding canned
+ * replies from test_data.h, with made-up timestamps.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <stdio.h>
+#include <string.h>
+
+static obd_session_t session;
+static obd_session_result_t result;
+
+/* Send the next queued command and check it's the one we expect */
+static int send_next(uint64_t now, const char *expected)
+{
+    char cmd[OBD_MAX_COMMAND_LEN];
+    size_t len = 0;
+
+    if (obd_session_next_command(&session, now, cmd, sizeof(cmd), &len) != OBD_OK) return 0;
+    if (strcmp(cmd, expected) != 0 || len != strlen(expected)) return 0;
+    return obd_session_write_done(&session, now + 1000) == OBD_OK;
+}
+
+/* ── Test: one PID request end to end ──────────────────────────────── */
+static int test_pid_round_trip(void)
+{
+    uint32_t id = 0;
+
+    obd_session_init(&session);
+    TEST_ASSERT(obd_session_submit_pid(&session, 0x01, 0x0C, 100, &id) == OBD_OK,
+                "submit should succeed");
+    TEST_ASSERT(id != 0, "request should get an id");
+    TEST_ASSERT(obd_session_pending(&session) == 1, "one request pending");
+    TEST_ASSERT(send_next(200, "010C\r"), "should send 010C");
+
+    /* Reply arrives in pieces, as it would from Bluetooth */
+    obd_session_feed(&session, "010C\r41 0C", 10, 30000);
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_ERROR_NO_DATA,
+                "no result before the prompt");
+    obd_session_feed(&session, " 1A F8\r\r", 8, 31000);
+    obd_session_feed(&session, ">", 1, 45000);
+
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_OK, "result after prompt");
+    TEST_ASSERT(result.id == id, "result id matches");
+    TEST_ASSERT(result.status == OBD_OK, "status OK");
+    TEST_ASSERT(strcmp(result.response, TEST_CLEAN_RPM) == 0, "cleaned response");
+    TEST_ASSERT(result.has_parsed && result.parsed.pid == 0x0C, "parsed PID");
+    TEST_ASSERT(result.has_value && result.value.value == TEST_EXPECTED_RPM, "decoded RPM");
+    TEST_ASSERT(obd_session_pending(&session) == 0, "nothing pending");
+
+    /* Trace points: enqueue 100, write 200→1200, reply 30000..31000, prompt 45000 */
+    TEST_ASSERT(result.trace.t[OBD_TRACE_ENQUEUE] == 100, "enqueue time");
+    TEST_ASSERT(result.trace.t[OBD_TRACE_WRITE_START] == 200, "write start time");
+    TEST_ASSERT(result.trace.t[OBD_TRACE_WRITE_DONE] == 1200, "write done time");
+    TEST_ASSERT(result.trace.t[OBD_TRACE_FIRST_BYTE] == 30000, "first byte time");
+    TEST_ASSERT(result.trace.t[OBD_TRACE_LAST_BYTE] == 31000, "last byte time");
+    TEST_ASSERT(result.trace.t[OBD_TRACE_PROMPT] == 45000, "prompt time");
+    TEST_ASSERT(result.trace.reached == 0xFF, "all 8 points reached");
+
+    printf("  PASS: PID round trip\n");
+    return 0;
+}
+
+/* ── Test: requests go out one at a time, in order ─────────────────── */
+static int test_queue_order(void)
+{
+    char cmd[OBD_MAX_COMMAND_LEN];
+    size_t len;
+
+    obd_session_init(&session);
+    obd_session_submit_pid(&session, 0x01, 0x0C, 0, NULL);
+    obd_session_submit_pid(&session, 0x01, 0x0D, 0, NULL);
+
+    TEST_ASSERT(send_next(10, "010C\r"), "first request first");
+    TEST_ASSERT(obd_session_next_command(&session, 20, cmd, sizeof(cmd), &len) == OBD_ERROR_NO_DATA,
+                "second waits while first is in flight");
+
+    obd_session_feed(&session, TEST_RAW_RPM_RESPONSE, strlen(TEST_RAW_RPM_RESPONSE), 50);
+    TEST_ASSERT(send_next(60, "010D\r"), "second after first completes");
+    obd_session_feed(&session, TEST_RAW_SPEED_RESPONSE, strlen(TEST_RAW_SPEED_RESPONSE), 90);
+
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_OK && result.pid == 0x0C, "RPM first");
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_OK && result.pid == 0x0D, "speed second");
+    TEST_ASSERT(result.value.value == TEST_EXPECTED_SPEED, "speed decoded");
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_ERROR_NO_DATA, "queue drained");
+
+    printf("  PASS: queue order\n");
+    return 0;
+}
+
+/* ── Test: full queue is reported ──────────────────────────────────── */
+static int test_queue_full(void)
+{
+    int i;
+
+    obd_session_init(&session);
+    for (i = 0; i < OBD_SESSION_QUEUE_LEN; i++) {
+        TEST_ASSERT(obd_session_submit_pid(&session, 0x01, 0x0C, 0, NULL) == OBD_OK,
+                    "queue has room");
+    }
+    TEST_ASSERT(obd_session_submit_pid(&session, 0x01, 0x0C, 0, NULL) == OBD_ERROR_BUSY,
+                "17th request should be refused");
+
+    printf("  PASS: full queue returns BUSY\n");
+    return 0;
+}
+
+/* ── Test: NO DATA and AT commands ─────────────────────────────────── */
+static int test_errors_and_at_commands(void)
+{
+    obd_session_init(&session);
+    obd_session_submit_command(&session, "0100", 0, NULL);
+    obd_session_submit_command(&session, "ATZ", 0, NULL);
+    obd_session_submit_command(&session, "ATZZ\r", 0, NULL);
+
+    TEST_ASSERT(send_next(10, "0100\r"), "0100 sent");
+    obd_session_feed(&session, TEST_RAW_NO_DATA_RESPONSE, strlen(TEST_RAW_NO_DATA_RESPONSE), 20);
+    TEST_ASSERT(send_next(30, "ATZ\r"), "ATZ sent");
+    obd_session_feed(&session, TEST_RAW_RESET_RESPONSE, strlen(TEST_RAW_RESET_RESPONSE), 40);
+    TEST_ASSERT(send_next(50, "ATZZ\r"), "ATZZ sent with a single \\r");
+    obd_session_feed(&session, TEST_RAW_ERROR_RESPONSE, strlen(TEST_RAW_ERROR_RESPONSE), 60);
+
+    obd_session_poll(&session, &result);
+    TEST_ASSERT(result.status == OBD_ERROR_NO_DATA, "NO DATA reported");
+    TEST_ASSERT(result.mode == 0x01 && result.pid == 0x00, "mode/pid from command text");
+    TEST_ASSERT(strcmp(result.response, "NO DATA") == 0, "adapter text kept on error");
+
+    obd_session_poll(&session, &result);
+    TEST_ASSERT(result.status == OBD_OK, "ATZ OK");
+    TEST_ASSERT(strcmp(result.response, "ELM327 v1.5") == 0, "echo stripped from AT reply");
+    TEST_ASSERT(result.mode == 0, "AT command has no mode");
+
+    obd_session_poll(&session, &result);
+    TEST_ASSERT(result.status == OBD_ERROR_ELM_ERROR, "? reported as ELM error");
+
+    printf("  PASS: NO DATA and AT commands\n");
+    return 0;
+}
+
+/* ── Test: CAN headers give the ECU id ─────────────────────────────── */
+static int test_can_header(void)
+{
+    const char *reply = "7E8 04 41 0C 1A F8\r\r>";
+
+    obd_session_init(&session);
+    obd_session_submit_pid(&session, 0x01, 0x0C, 0, NULL);
+    TEST_ASSERT(send_next(10, "010C\r"), "sent");
+    obd_session_feed(&session, reply, strlen(reply), 20);
+
+    obd_session_poll(&session, &result);
+    TEST_ASSERT(result.status == OBD_OK, "header reply parses");
+    TEST_ASSERT(result.ecu == 0x7E8, "ECU id from header");
+    TEST_ASSERT(result.value.value == TEST_EXPECTED_RPM, "value decoded past header");
+    TEST_ASSERT(result.trace.ecu == 0x7E8, "trace record has ECU");
+
+    printf("  PASS: CAN header → ECU 7E8\n");
+    return 0;
+}
+
+/* ── Test: Mode 02 carries a frame number both ways ────────────────── */
+static int test_freeze_frame(void)
+{
+    const char *reply = "020C00\r42 0C 00 1A F8\r\r>";
+    obd_freeze_frame_t snap;
+
+    obd_session_init(&session);
+    obd_session_submit_pid(&session, 0x02, 0x0C, 0, NULL);
+    TEST_ASSERT(send_next(10, "020C00\r"), "frame 0 asked for");
+    obd_session_feed(&session, reply, strlen(reply), 20);
+
+    obd_session_poll(&session, &result);
+    TEST_ASSERT(result.status == OBD_OK, "reply accepted");
+    TEST_ASSERT(!result.has_parsed, "frame byte not taken for data");
+    TEST_ASSERT(strcmp(result.response, "42 0C 00 1A F8") == 0, "text kept");
+
+    obd_freeze_init(&snap, 0, 1);
+    TEST_ASSERT(obd_freeze_parse_response(result.response, &snap) == OBD_OK &&
+                obd_freeze_find(&snap, 0x0C)->value == TEST_EXPECTED_RPM,
+                "freeze parser reads it");
+
+    printf("  PASS: Mode 02 frame number\n");
+    return 0;
+}
+
+/* ── Test: timeout, then late bytes are drained ────────────────────── */
+static int test_timeout_and_drain(void)
+{
+    obd_session_init(&session);
+    obd_session_set_timeout(&session, 100000);
+    obd_session_submit_pid(&session, 0x01, 0x0C, 0, NULL);
+    obd_session_submit_pid(&session, 0x01, 0x0D, 0, NULL);
+
+    TEST_ASSERT(send_next(0, "010C\r"), "sent");
+    TEST_ASSERT(obd_session_deadline(&session) == 100000, "deadline = start + timeout");
+
+    obd_session_tick(&session, 99999);
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_ERROR_NO_DATA, "not yet");
+    obd_session_tick(&session, 100000);
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_OK, "timed out");
+    TEST_ASSERT(result.status == OBD_ERROR_TIMEOUT, "status TIMEOUT");
+    TEST_ASSERT(!(result.trace.reached & (1u << OBD_TRACE_PROMPT)), "no prompt point");
+
+    /* Late reply to 010C must not become 010D's answer */
+    obd_session_feed(&session, TEST_RAW_RPM_RESPONSE, strlen(TEST_RAW_RPM_RESPONSE), 110000);
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_ERROR_NO_DATA, "late reply dropped");
+    TEST_ASSERT(send_next(120000, "010D\r"), "next request after drain");
+    obd_session_feed(&session, TEST_RAW_SPEED_RESPONSE, strlen(TEST_RAW_SPEED_RESPONSE), 150000);
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_OK && result.pid == 0x0D, "speed reply");
+    TEST_ASSERT(result.status == OBD_OK, "speed OK");
+
+    printf("  PASS: timeout and drain\n");
+    return 0;
+}
+
+/* ── Test: withdrawing requests ────────────────────────────────────── */
+static int test_cancel(void)
+{
+    uint32_t rpm, speed, coolant;
+
+    obd_session_init(&session);
+    obd_session_set_timeout(&session, 100000);
+    obd_session_submit_pid(&session, 0x01, 0x0C, 0, &rpm);
+    obd_session_submit_pid(&session, 0x01, 0x0D, 0, &speed);
+    obd_session_submit_pid(&session, 0x01, 0x05, 0, &coolant);
+
+    /* Queued: gone without a trace */
+    TEST_ASSERT(obd_session_cancel(&session, speed) == OBD_OK, "dropped from the queue");
+    TEST_ASSERT(obd_session_pending(&session) == 2, "two left");
+    TEST_ASSERT(obd_session_cancel(&session, speed) == OBD_ERROR_NO_DATA, "only once");
+
+    /* In flight: reported, then the reply is drained */
+    TEST_ASSERT(send_next(0, "010C\r"), "RPM sent");
+    TEST_ASSERT(obd_session_cancel(&session, rpm) == OBD_PENDING, "in flight");
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_OK && result.id == rpm &&
+                result.status == OBD_ERROR_CANCELLED, "cancelled result");
+    TEST_ASSERT(obd_session_deadline(&session) == 100000, "drains until its own deadline");
+    obd_session_feed(&session, TEST_RAW_RPM_RESPONSE, strlen(TEST_RAW_RPM_RESPONSE), 2000);
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_ERROR_NO_DATA, "late reply dropped");
+
+    /* The queue carries on in order, skipping the withdrawn one */
+    TEST_ASSERT(send_next(3000, "0105\r"), "coolant next");
+    TEST_ASSERT(obd_session_cancel(&session, 0) == OBD_ERROR_INVALID_ARG, "id 0");
+    TEST_ASSERT(obd_session_cancel(NULL, coolant) == OBD_ERROR_INVALID_ARG, "NULL");
+
+    printf("  PASS: cancel queued and in-flight requests\n");
+    return 0;
+}
+
+/* ── Test: raw traffic tap ────────────────────────────────────────── */
+static char tapped[256];
+static size_t tapped_len;
+static int tapped_calls;
+
+static void tap(void *ctx, uint8_t dir, const char *data, size_t len, uint64_t t_us)
+{
+    (void)ctx;
+    (void)t_us;
+    tapped_calls++;
+    if (tapped_len + len + 1 < sizeof(tapped)) {
+        tapped[tapped_len++] = dir == OBD_CAPTURE_TX ? '<' : '>';
+        memcpy(tapped + tapped_len, data, len);
+        tapped_len += len;
+    }
+}
+
+static int test_capture(void)
+{
+    obd_session_init(&session);
+    tapped_len = 0;
+    tapped_calls = 0;
+    TEST_ASSERT(obd_session_set_capture(&session, tap, NULL) == OBD_OK, "set capture");
+    obd_session_submit_pid(&session, 0x01, 0x0C, 0, NULL);
+    TEST_ASSERT(send_next(0, "010C\r"), "sent");
+    obd_session_feed(&session, "41 0C 1A F8\r", 12, 2000);
+    obd_session_feed(&session, "", 0, 2500);
+    obd_session_feed(&session, "\r>", 2, 3000);
+    TEST_ASSERT(obd_session_poll(&session, &result) == OBD_OK && result.has_value,
+                "the tap doesn't change the result");
+    TEST_ASSERT(tapped_calls == 3, "one call per write and non-empty feed");
+    TEST_ASSERT(tapped_len == 22 &&
+                memcmp(tapped, "<010C\r>41 0C 1A F8\r>\r>", 22) == 0,
+                "both directions, byte for byte");
+
+    /* Unsolicited bytes are traffic too */
+    obd_session_feed(&session, "STOPPED\r", 8, 4000);
+    TEST_ASSERT(tapped_calls == 4, "idle bytes tapped");
+    obd_session_set_capture(&session, NULL, NULL);
+    obd_session_feed(&session, ">", 1, 5000);
+    TEST_ASSERT(tapped_calls == 4, "tap removed");
+
+    printf("  PASS: capture tap\n");
+    return 0;
+}
+
+/* ── Test: bad arguments ───────────────────────────────────────────── */
+static int test_invalid_args(void)
+{
+    char cmd[4];
+    size_t len;
+
+    TEST_ASSERT(obd_session_init(NULL) == OBD_ERROR_INVALID_ARG, "NULL session");
+    obd_session_init(&session);
+    TEST_ASSERT(obd_session_submit_command(&session, "", 0, NULL) == OBD_ERROR_INVALID_ARG,
+                "empty command");
+    TEST_ASSERT(obd_session_submit_command(&session, "ATTHISISWAYTOOLONG", 0, NULL) ==
+                OBD_ERROR_BUFFER_TOO_SMALL, "command too long");
+    TEST_ASSERT(obd_session_write_done(&session, 0) == OBD_ERROR_INVALID_ARG,
+                "write_done with nothing sent");
+    obd_session_submit_pid(&session, 0x01, 0x0C, 0, NULL);
+    TEST_ASSERT(obd_session_next_command(&session, 0, cmd, sizeof(cmd), &len) ==
+                OBD_ERROR_BUFFER_TOO_SMALL, "command buffer too small");
+    TEST_ASSERT(obd_session_pending(&session) == 1, "request still queued");
+    TEST_ASSERT(obd_session_set_timeout(&session, 0) == OBD_ERROR_INVALID_ARG, "zero timeout");
+
+    printf("  PASS: invalid arguments\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== session tests ===\n");
+    failures += test_pid_round_trip();
+    failures += test_queue_order();
+    failures += test_queue_full();
+    failures += test_errors_and_at_commands();
+    failures += test_can_header();
+    failures += test_freeze_frame();
+    failures += test_timeout_and_drain();
+    failures += test_cancel();
+    failures += test_capture();
+    failures += test_invalid_args();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 10);
+    return failures;
+}
@@ -0,0 +1,174 @@
+/**
+ * test_stats.c — Tests for the optional instrumentation layer.
+ *
+ * The reporting functions (merge, quantile, formatters) are always built,
+ * so we test them on hand-made snapshots. The counting itself only
+ * happens with -DOBD_ENABLE_STATS=ON; without it we check that the
+ * counters stay at zero.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <stdio.h>
+#include <string.h>
+
+/* obd_stats_t is ~19 KB — keep the test copies off the stack */
+static obd_stats_t snap_a;
+static obd_stats_t snap_b;
+static char text_buf[32768];
+
+/* ── Test: enabled flag matches the build ──────────────────────────── */
+static int test_enabled_flag(void)
+{
+#ifdef OBD_ENABLE_STATS
+    TEST_ASSERT(obd_stats_enabled() == 1, "stats build should report enabled");
+#else
+    TEST_ASSERT(obd_stats_enabled() == 0, "default build should report disabled");
+#endif
+
+    printf("  PASS: enabled flag (%d)\n", obd_stats_enabled());
+    return 0;
+}
+
+/* ── Test: calls and results get counted ───────────────────────────── */
+static int test_counting(void)
+{
+    obd_pid_response_t resp;
+    const obd_stat_counters_t *pid;
+
+    obd_stats_reset();
+    obd_pid_parse_response(TEST_CLEAN_RPM, &resp);
+    obd_pid_parse_response(TEST_CLEAN_SPEED, &resp);
+    obd_pid_parse_response("41", &resp);            /* too short → PARSE_FAILED */
+
+    TEST_ASSERT(obd_stats_snapshot_thread(&snap_a) == OBD_OK, "thread snapshot should succeed");
+    TEST_ASSERT(obd_stats_snapshot(&snap_b) == OBD_OK, "global snapshot should succeed");
+    pid = &snap_a.fn[OBD_STAT_PID_PARSE];
+
+#ifdef OBD_ENABLE_STATS
+    TEST_ASSERT(pid->calls == 3, "pid_parse should be called 3 times");
+    TEST_ASSERT(pid->results[0] == 2, "2 calls should return OBD_OK");
+    TEST_ASSERT(pid->results[-OBD_ERROR_PARSE_FAILED] == 1, "1 call should fail to parse");
+    TEST_ASSERT(snap_a.fn[OBD_STAT_HEX_TO_BYTES].calls == 3,
+                "pid_parse uses hex_to_bytes once per call");
+    TEST_ASSERT(snap_a.ticks_per_us > 0.0, "tick rate should be calibrated");
+    TEST_ASSERT(snap_b.fn[OBD_STAT_PID_PARSE].calls >= 3,
+                "global snapshot includes this thread");
+
+    obd_stats_reset();
+    obd_stats_snapshot_thread(&snap_a);
+    TEST_ASSERT(snap_a.fn[OBD_STAT_PID_PARSE].calls == 0, "reset should zero counters");
+#else
+    TEST_ASSERT(pid->calls == 0, "disabled build never counts");
+    TEST_ASSERT(snap_b.fn[OBD_STAT_PID_PARSE].calls == 0, "disabled build never counts");
+    TEST_ASSERT(snap_a.ticks_per_us == 0.0, "disabled build has no tick rate");
+#endif
+
+    printf("  PASS: call and result counting\n");
+    return 0;
+}
+
+/* ── Test: merging snapshots ───────────────────────────────────────── */
+static int test_merge(void)
+{
+    memset(&snap_a, 0, sizeof(snap_a));
+    memset(&snap_b, 0, sizeof(snap_b));
+
+    snap_a.fn[OBD_STAT_CLEAN].calls = 10;
+    snap_a.fn[OBD_STAT_CLEAN].results[0] = 9;
+    snap_a.fn[OBD_STAT_CLEAN].results[-OBD_ERROR_NO_DATA] = 1;
+    snap_a.fn[OBD_STAT_CLEAN].max_ticks = 50;
+    snap_a.fn[OBD_STAT_CLEAN].hist[20] = 10;
+
+    snap_b.fn[OBD_STAT_CLEAN].calls = 5;
+    snap_b.fn[OBD_STAT_CLEAN].results[0] = 5;
+    snap_b.fn[OBD_STAT_CLEAN].max_ticks = 80;
+    snap_b.fn[OBD_STAT_CLEAN].hist[20] = 3;
+    snap_b.fn[OBD_STAT_CLEAN].hist[25] = 2;
+    snap_b.ticks_per_us = 3000.0;
+
+    TEST_ASSERT(obd_stats_merge(&snap_a, &snap_b) == OBD_OK, "merge should succeed");
+    TEST_ASSERT(snap_a.fn[OBD_STAT_CLEAN].calls == 15, "calls should add");
+    TEST_ASSERT(snap_a.fn[OBD_STAT_CLEAN].results[0] == 14, "OK tallies should add");
+    TEST_ASSERT(snap_a.fn[OBD_STAT_CLEAN].results[-OBD_ERROR_NO_DATA] == 1, "error tallies kept");
+    TEST_ASSERT(snap_a.fn[OBD_STAT_CLEAN].max_ticks == 80, "max should be the larger");
+    TEST_ASSERT(snap_a.fn[OBD_STAT_CLEAN].hist[20] == 13, "buckets should add");
+    TEST_ASSERT(snap_a.fn[OBD_STAT_CLEAN].hist[25] == 2, "buckets should add");
+    TEST_ASSERT(snap_a.ticks_per_us == 3000.0, "tick rate adopted from source");
+
+    TEST_ASSERT(obd_stats_merge(NULL, &snap_b) == OBD_ERROR_INVALID_ARG, "NULL should error");
+
+    printf("  PASS: merge snapshots\n");
+    return 0;
+}
+
+/* ── Test: quantiles from the log-linear histogram ─────────────────── */
+static int test_quantile(void)
+{
+    double p50, p99, p100;
+
+    memset(&snap_a, 0, sizeof(snap_a));
+    snap_a.ticks_per_us = 1000.0;            /* 1 tick = 1 ns */
+
+    /* 99 fast calls at 5 ticks (linear bucket 5), 1 slow call at 100
+     * ticks (bucket 36, which covers 96..103). */
+    snap_a.fn[OBD_STAT_DTC_PARSE].calls = 100;
+    snap_a.fn[OBD_STAT_DTC_PARSE].hist[5] = 99;
+    snap_a.fn[OBD_STAT_DTC_PARSE].hist[36] = 1;
+    snap_a.fn[OBD_STAT_DTC_PARSE].max_ticks = 100;
+
+    p50 = obd_stats_quantile_ns(&snap_a, OBD_STAT_DTC_PARSE, 0.50);
+    p99 = obd_stats_quantile_ns(&snap_a, OBD_STAT_DTC_PARSE, 0.99);
+    p100 = obd_stats_quantile_ns(&snap_a, OBD_STAT_DTC_PARSE, 1.0);
+
+    TEST_ASSERT(p50 == 6.0, "p50 is the upper edge of bucket 5");
+    TEST_ASSERT(p99 == 6.0, "p99 still falls in the fast bucket");
+    TEST_ASSERT(p100 == 100.0, "p100 is capped at the recorded max");
+    TEST_ASSERT(obd_stats_quantile_ns(&snap_a, OBD_STAT_VIN_PARSE, 0.5) == 0.0,
+                "no calls → 0");
+
+    printf("  PASS: quantiles (p50=%.0f p99=%.0f p100=%.0f ns)\n", p50, p99, p100);
+    return 0;
+}
+
+/* ── Test: text and JSON dumpers ───────────────────────────────────── */
+static int test_format(void)
+{
+    char tiny[16];
+
+    /* snap_a still holds the dtc_parse numbers from test_quantile */
+    TEST_ASSERT(obd_stats_format_text(&snap_a, text_buf, sizeof(text_buf)) == OBD_OK,
+                "text format should succeed");
+    TEST_ASSERT(strstr(text_buf, "dtc_parse") != NULL, "text should name the function");
+    TEST_ASSERT(strstr(text_buf, "vin_parse") == NULL, "uncalled functions are omitted");
+
+    TEST_ASSERT(obd_stats_format_json(&snap_a, text_buf, sizeof(text_buf)) == OBD_OK,
+                "JSON format should succeed");
+    TEST_ASSERT(strstr(text_buf, "\"name\": \"dtc_parse\"") != NULL, "JSON should name the function");
+    TEST_ASSERT(strstr(text_buf, "\"calls\": 100") != NULL, "JSON should have the call count");
+    TEST_ASSERT(strstr(text_buf, "[96.0, 1]") != NULL, "JSON should list the slow bucket");
+
+    TEST_ASSERT(obd_stats_format_json(&snap_a, tiny, sizeof(tiny)) == OBD_ERROR_BUFFER_TOO_SMALL,
+                "tiny buffer should error");
+    TEST_ASSERT(tiny[0] == '\0', "buffer is left empty on overflow");
+
+    printf("  PASS: text and JSON dumpers\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== stats tests ===\n");
+    failures += test_enabled_flag();
+    failures += test_counting();
+    failures += test_merge();
+    failures += test_quantile();
+    failures += test_format();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 5);
+    return failures;
+}
@@ -0,0 +1,178 @@
+/**
+ * test_summary.c — Tests for per-sensor streaming summaries.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FLOAT_NEAR(a, b, tolerance) (fabs((double)(a) - (double)(b)) < (tolerance))
+#define MS 1000u
+
+static obd_summary_t a, b, all;
+
+/* 0..n-1 in a scrambled order (n a power of two: odd multiplier, mod n) */
+static unsigned scrambled(unsigned i, unsigned n)
+{
+    return (i * 2654435761u + 12345u) % n;
+}
+
+/* ── Test: mean, stddev, min and max with their times ──────────────── */
+static int test_moments(void)
+{
+    static const float coolant[] = { 80.0f, 82.0f, 79.0f, 85.0f, 84.0f, 83.0f };
+    obd_summary_snapshot_t snap;
+    size_t i;
+
+    TEST_ASSERT(obd_summary_reset(&a) == OBD_OK, "reset");
+    for (i = 0; i < 6; i++) {
+        TEST_ASSERT(obd_summary_add(&a, coolant[i], (i + 1) * 100 * MS) == OBD_OK, "add");
+    }
+    TEST_ASSERT(obd_summary_snapshot(&a, &snap) == OBD_OK && snap.count == 6, "6 samples");
+    TEST_ASSERT(FLOAT_NEAR(snap.mean, 82.1667, 1e-3), "mean");
+    TEST_ASSERT(FLOAT_NEAR(snap.stddev, 2.3166, 1e-3), "sample stddev");
+    TEST_ASSERT(snap.min == 79.0f && snap.min_t_us == 300 * MS, "min at 300 ms");
+    TEST_ASSERT(snap.max == 85.0f && snap.max_t_us == 400 * MS, "max at 400 ms");
+    TEST_ASSERT(a.first_t_us == 100 * MS && a.last_t_us == 600 * MS, "span");
+
+    /* Large, close values: a naive sum of squares would lose them */
+    obd_summary_reset(&a);
+    for (i = 0; i < 100000; i++) {
+        obd_summary_add(&a, 3000.0f + (i % 2 ? 0.5f : -0.5f), i * MS);
+    }
+    obd_summary_snapshot(&a, &snap);
+    TEST_ASSERT(FLOAT_NEAR(snap.mean, 3000.0, 1e-3) && FLOAT_NEAR(snap.stddev, 0.5, 1e-4),
+                "stable at 3000 +- 0.5");
+
+    printf("  PASS: mean, stddev, min/max\n");
+    return 0;
+}
+
+/* ── Test: percentiles against the exact ones ──────────────────────── */
+static int test_quantiles(void)
+{
+    const unsigned n = 16384;
+    obd_summary_snapshot_t snap;
+    unsigned i;
+
+    obd_summary_reset(&a);
+    for (i = 0; i < n; i++) {
+        obd_summary_add(&a, (float)scrambled(i, n), i * MS);
+    }
+    TEST_ASSERT(a.centroid_count <= OBD_SUMMARY_CENTROIDS, "bounded");
+
+    /* Rank error: ~1% in the middle, far less at the tails */
+    TEST_ASSERT(FLOAT_NEAR(obd_summary_quantile(&a, 0.50), 0.50 * n, 0.01 * n), "p50");
+    TEST_ASSERT(FLOAT_NEAR(obd_summary_quantile(&a, 0.95), 0.95 * n, 0.005 * n), "p95");
+    TEST_ASSERT(FLOAT_NEAR(obd_summary_quantile(&a, 0.99), 0.99 * n, 0.002 * n), "p99");
+    TEST_ASSERT(FLOAT_NEAR(obd_summary_quantile(&a, 0.001), 0.001 * n, 0.001 * n), "p0.1");
+    TEST_ASSERT(obd_summary_quantile(&a, 0.0) == 0.0f &&
+                obd_summary_quantile(&a, 1.0) == (float)(n - 1), "ends exact");
+    TEST_ASSERT(obd_summary_quantile(&a, 0.3) <= obd_summary_quantile(&a, 0.31), "monotonic");
+
+    obd_summary_snapshot(&a, &snap);
+    TEST_ASSERT(snap.p50 == obd_summary_quantile(&a, 0.50) &&
+                snap.p99 == obd_summary_quantile(&a, 0.99), "snapshot agrees");
+
+    /* A handful of samples, some still buffered */
+    obd_summary_reset(&a);
+    for (i = 1; i <= 5; i++) {
+        obd_summary_add(&a, (float)(i * 10), i * MS);
+    }
+    TEST_ASSERT(a.buffered == 5 && obd_summary_quantile(&a, 0.5) == 30.0f, "median of 5");
+    TEST_ASSERT(a.buffered == 5, "quantile doesn't change the summary");
+
+    printf("  PASS: quantiles\n");
+    return 0;
+}
+
+/* ── Test: two halves merged equal the whole ───────────────────────── */
+static int test_merge(void)
+{
+    const unsigned n = 8192;
+    obd_summary_snapshot_t sa, sall;
+    unsigned i;
+
+    obd_summary_reset(&a);
+    obd_summary_reset(&b);
+    obd_summary_reset(&all);
+    for (i = 0; i < n; i++) {
+        float v = 700.0f + (float)scrambled(i, n) * 0.5f;
+        obd_summary_add(i < n / 3 ? &a : &b, v, i * MS);
+        obd_summary_add(&all, v, i * MS);
+    }
+
+    TEST_ASSERT(obd_summary_merge(&a, &b) == OBD_OK, "merge");
+    obd_summary_snapshot(&a, &sa);
+    obd_summary_snapshot(&all, &sall);
+    TEST_ASSERT(sa.count == n && sa.min == sall.min && sa.max == sall.max, "exact: count, min, max");
+    TEST_ASSERT(sa.min_t_us == sall.min_t_us && sa.max_t_us == sall.max_t_us, "their times");
+    TEST_ASSERT(FLOAT_NEAR(sa.mean, sall.mean, 1e-3) && FLOAT_NEAR(sa.stddev, sall.stddev, 1e-3),
+                "mean, stddev");
+    TEST_ASSERT(a.first_t_us == 0 && a.last_t_us == (n - 1) * MS, "span");
+    TEST_ASSERT(FLOAT_NEAR(sa.p50, sall.p50, 0.01 * n * 0.5) &&
+                FLOAT_NEAR(sa.p95, sall.p95, 0.005 * n * 0.5) &&
+                FLOAT_NEAR(sa.p99, sall.p99, 0.002 * n * 0.5), "percentiles close");
+    TEST_ASSERT(a.centroid_count <= OBD_SUMMARY_CENTROIDS, "still bounded");
+
+    /* Trips into a day, many times over: stays bounded and close */
+    obd_summary_reset(&all);
+    for (i = 0; i < 50; i++) {
+        TEST_ASSERT(obd_summary_merge(&all, &b) == OBD_OK, "roll up");
+    }
+    TEST_ASSERT(all.count == 50ull * b.count && all.centroid_count <= OBD_SUMMARY_CENTROIDS,
+                "50 trips");
+    TEST_ASSERT(FLOAT_NEAR(obd_summary_quantile(&all, 0.5), obd_summary_quantile(&b, 0.5),
+                           0.01 * n * 0.5), "same median");
+
+    printf("  PASS: merge\n");
+    return 0;
+}
+
+/* ── Test: empty, NULL ─────────────────────────────────────────────── */
+static int test_edge_cases(void)
+{
+    obd_summary_snapshot_t snap;
+
+    obd_summary_reset(&a);
+    TEST_ASSERT(obd_summary_snapshot(&a, &snap) == OBD_ERROR_NO_DATA && snap.count == 0,
+                "empty");
+    TEST_ASSERT(obd_summary_quantile(&a, 0.5) == 0.0f, "empty quantile");
+
+    obd_summary_reset(&b);
+    obd_summary_add(&b, -4.0f, 7 * MS);
+    TEST_ASSERT(obd_summary_merge(&a, &b) == OBD_OK && a.count == 1 && a.min == -4.0f,
+                "into empty");
+    obd_summary_reset(&b);
+    TEST_ASSERT(obd_summary_merge(&all, &b) == OBD_OK, "from empty");
+    obd_summary_reset(&a);
+    obd_summary_add(&a, 5.0f, 0);
+    obd_summary_snapshot(&a, &snap);
+    TEST_ASSERT(snap.stddev == 0.0f && snap.p50 == 5.0f && snap.p99 == 5.0f, "one sample");
+
+    TEST_ASSERT(obd_summary_merge(&a, &a) == OBD_ERROR_INVALID_ARG, "into itself");
+    TEST_ASSERT(obd_summary_reset(NULL) == OBD_ERROR_INVALID_ARG, "NULL reset");
+    TEST_ASSERT(obd_summary_add(NULL, 1.0f, 0) == OBD_ERROR_INVALID_ARG, "NULL add");
+    TEST_ASSERT(obd_summary_snapshot(&a, NULL) == OBD_ERROR_INVALID_ARG, "NULL out");
+    TEST_ASSERT(obd_summary_quantile(NULL, 0.5) == 0.0f, "NULL quantile");
+
+    printf("  PASS: edge cases\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== summary tests ===\n");
+    failures += test_moments();
+    failures += test_quantiles();
+    failures += test_merge();
+    failures += test_edge_cases();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
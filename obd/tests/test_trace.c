@@ -0,0 +1,159 @@
+/**
+ * test_trace.c — Tests for round-trip latency tracing.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include "test_data.h"
+#include <stdio.h>
+#include <string.h>
+
+/* ~90 KB each — static, as the header recommends */
+static obd_trace_t trace;
+static obd_trace_record_t ring[4];
+static obd_session_t session;
+static obd_session_result_t result;
+static char text[16384];
+
+/* Build a record with every point from ENQUEUE up to `last` reached */
+static void make_record(obd_trace_record_t *rec, uint32_t id, uint8_t pid,
+                        const uint64_t *t, int last)
+{
+    int p;
+    memset(rec, 0, sizeof(*rec));
+    rec->id = id;
+    rec->mode = 0x01;
+    rec->pid = pid;
+    rec->ecu = 0x7E8;
+    for (p = 0; p <= last; p++) {
+        rec->t[p] = t[p];
+        rec->reached = (uint8_t)(rec->reached | (1u << p));
+    }
+}
+
+/* ── Test: phases are aggregated per key ───────────────────────────── */
+static int test_aggregate(void)
+{
+    /* enqueue, write start, write done, first, last, prompt, parsed, decoded */
+    const uint64_t t[OBD_TRACE_POINT_COUNT] = { 0, 10, 1010, 31010, 31510, 81510, 81520, 81525 };
+    obd_trace_record_t rec;
+    const obd_trace_key_t *key;
+
+    obd_trace_init(&trace, NULL, 0);
+    make_record(&rec, 1, 0x0C, t, OBD_TRACE_DECODED);
+    obd_trace_add(&trace, &rec);
+    obd_trace_add(&trace, &rec);
+
+    key = obd_trace_find(&trace, 0x01, 0x0C, 0x7E8);
+    TEST_ASSERT(key != NULL, "key created");
+    TEST_ASSERT(key->count == 2 && key->errors == 0, "two good requests");
+    TEST_ASSERT(key->max_us[OBD_PHASE_ECU] == 30000, "ECU phase 30 ms");
+    TEST_ASSERT(key->max_us[OBD_PHASE_ADAPTER] == 50000, "adapter phase 50 ms");
+    TEST_ASSERT(key->max_us[OBD_PHASE_TOTAL] == 81525, "total ends at DECODED");
+    TEST_ASSERT(key->sum_us[OBD_PHASE_WRITE] == 2000, "write phase summed");
+    TEST_ASSERT(obd_trace_quantile_us(key, OBD_PHASE_ECU, 0.5) == 30000.0,
+                "p50 capped at the real max");
+    TEST_ASSERT(obd_trace_find(&trace, 0x01, 0x0D, 0x7E8) == NULL, "other PID unseen");
+
+    printf("  PASS: per-PID phase aggregation\n");
+    return 0;
+}
+
+/* ── Test: timeouts stop at the last point reached ─────────────────── */
+static int test_timeout_record(void)
+{
+    const uint64_t t[OBD_TRACE_POINT_COUNT] = { 0, 0, 500 };
+    obd_trace_record_t rec;
+    const obd_trace_key_t *key;
+
+    obd_trace_init(&trace, NULL, 0);
+    make_record(&rec, 1, 0x0C, t, OBD_TRACE_WRITE_DONE);
+    rec.result = OBD_ERROR_TIMEOUT;
+    obd_trace_add(&trace, &rec);
+
+    key = obd_trace_find(&trace, 0x01, 0x0C, 0x7E8);
+    TEST_ASSERT(key->timeouts == 1 && key->errors == 1, "timeout counted");
+    TEST_ASSERT(obd_trace_quantile_us(key, OBD_PHASE_ECU, 0.5) == 0.0, "no ECU phase");
+    TEST_ASSERT(key->max_us[OBD_PHASE_TOTAL] == 500, "total up to write done");
+
+    printf("  PASS: timeout record\n");
+    return 0;
+}
+
+/* ── Test: key table overflow is counted, not lost silently ────────── */
+static int test_key_overflow(void)
+{
+    const uint64_t t[OBD_TRACE_POINT_COUNT] = { 0, 1 };
+    obd_trace_record_t rec;
+    int i;
+
+    obd_trace_init(&trace, NULL, 0);
+    for (i = 0; i < OBD_TRACE_MAX_KEYS + 3; i++) {
+        make_record(&rec, (uint32_t)i, (uint8_t)i, t, OBD_TRACE_WRITE_START);
+        obd_trace_add(&trace, &rec);
+    }
+    TEST_ASSERT(trace.key_count == OBD_TRACE_MAX_KEYS, "table full");
+    TEST_ASSERT(trace.untracked == 3, "3 requests untracked");
+
+    printf("  PASS: key table overflow\n");
+    return 0;
+}
+
+/* ── Test: session feeds the tracer; text and Chrome export ────────── */
+static int test_session_export(void)
+{
+    int i;
+
+    obd_trace_init(&trace, ring, 4);
+    obd_session_init(&session);
+    obd_session_set_trace(&session, &trace, 3);
+
+    /* 6 RPM requests; the ring keeps the last 4 */
+    for (i = 0; i < 6; i++) {
+        char cmd[OBD_MAX_COMMAND_LEN];
+        size_t len;
+        uint64_t base = (uint64_t)i * 100000;
+
+        obd_session_submit_pid(&session, 0x01, 0x0C, base, NULL);
+        obd_session_next_command(&session, base + 100, cmd, sizeof(cmd), &len);
+        obd_session_write_done(&session, base + 900);
+        obd_session_feed(&session, TEST_RAW_RPM_RESPONSE,
+                         strlen(TEST_RAW_RPM_RESPONSE), base + 40000);
+        obd_session_poll(&session, &result);
+    }
+
+    TEST_ASSERT(trace.record_total == 6, "6 records added");
+    TEST_ASSERT(obd_trace_find(&trace, 0x01, 0x0C, 0)->count == 6, "6 aggregated");
+
+    TEST_ASSERT(obd_trace_format_text(&trace, text, sizeof(text)) == OBD_OK, "text export");
+    TEST_ASSERT(strstr(text, "01 0C ecu 000") != NULL, "text names the key");
+    TEST_ASSERT(strstr(text, "adapter") != NULL, "text lists phases");
+
+    TEST_ASSERT(obd_trace_format_chrome(&trace, text, sizeof(text)) == OBD_OK, "chrome export");
+    TEST_ASSERT(strncmp(text, "{\"displayTimeUnit\"", 18) == 0, "JSON object");
+    TEST_ASSERT(strstr(text, "\"ts\": 200000,") != NULL, "oldest kept record is #3");
+    TEST_ASSERT(strstr(text, "\"ts\": 100000,") == NULL, "#2 was overwritten");
+    TEST_ASSERT(strstr(text, "\"name\": \"ecu\"") != NULL, "phase events present");
+    TEST_ASSERT(strstr(text, "\"tid\": 3") != NULL, "track used as tid");
+
+    TEST_ASSERT(obd_trace_format_chrome(&trace, text, 64) == OBD_ERROR_BUFFER_TOO_SMALL,
+                "small buffer refused");
+
+    printf("  PASS: session → text and Chrome trace export\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== trace tests ===\n");
+    failures += test_aggregate();
+    failures += test_timeout_record();
+    failures += test_key_overflow();
+    failures += test_session_export();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
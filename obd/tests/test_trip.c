@@ -0,0 +1,263 @@
+/**
+ * test_trip.c — Tests for the trip segmenter.
+ */
+
+#include <obd/obd.h>
+#include "test_assert.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FLOAT_NEAR(a, b, tolerance) (fabs((double)(a) - (double)(b)) < (tolerance))
+#define S 1000000u
+
+#define MAX_SAMPLES 1024
+
+static uint16_t channels[MAX_SAMPLES];
+static float    values[MAX_SAMPLES];
+static uint64_t times[MAX_SAMPLES];
+static size_t   count;
+
+static void add(uint16_t channel, float value, uint64_t t_us)
+{
+    channels[count] = channel;
+    values[count] = value;
+    times[count] = t_us;
+    count++;
+}
+
+/*
+ * One drive, a sample of RPM, speed and run time a second:
+ *
+ *     0- 19 s   idling (already running when the log starts)
+ *    20- 91 s   50 km/h, 1 km
+ *    92- 99 s   idling, too short to count
+ *   100-179 s   engine off
+ */
+static void make_drive(void)
+{
+    uint64_t i;
+
+    count = 0;
+    for (i = 0; i < 180; i++) {
+        float rpm = i < 20 ? 800.0f : i < 92 ? 2000.0f : i < 100 ? 800.0f : 0.0f;
+        float speed = (i >= 20 && i < 92) ? 50.0f : 0.0f;
+        add(0x0C, rpm, i * S);
+        add(0x0D, speed, i * S);
+        add(0x1F, i < 100 ? (float)(i + 5) : 0.0f, i * S);
+    }
+}
+
+static int next_event(obd_trip_t *t, obd_trip_event_t *ev, uint8_t kind)
+{
+    return obd_trip_poll(t, ev) == OBD_OK && ev->kind == kind;
+}
+
+/* ── Test: a drive, start to engine off ────────────────────────────── */
+static int test_drive(void)
+{
+    obd_trip_t trip;
+    obd_trip_event_t ev;
+    const obd_trip_summary_t *s = &ev.trip;
+
+    make_drive();
+    obd_trip_init(&trip);
+    TEST_ASSERT(obd_trip_feed_batch(&trip, channels, values, times, 0, count) == OBD_OK,
+                "batch fed");
+
+    TEST_ASSERT(next_event(&trip, &ev, OBD_TRIP_EVENT_START) && ev.t_us == 0 &&
+                s->number == 1 && (s->flags & OBD_TRIP_OPEN_START) && s->start_pos == 0,
+                "started at the first sample, already running");
+    TEST_ASSERT(next_event(&trip, &ev, OBD_TRIP_EVENT_IDLE) && ev.t_us == 10 * S,
+                "idling counted once idle_after_us ran out");
+    TEST_ASSERT(next_event(&trip, &ev, OBD_TRIP_EVENT_END), "ended");
+    TEST_ASSERT(s->end_reason == OBD_TRIP_END_ENGINE_OFF && s->end_us == 100 * S &&
+                s->end_pos == 300, "ends at the first engine-off sample");
+    TEST_ASSERT(s->idle_periods == 1 && s->idle_us == 20 * S,
+                "one idle period; 8 s at the lights is too short");
+    TEST_ASSERT(FLOAT_NEAR(s->distance_km, 1.0, 0.001), "distance integrated");
+    TEST_ASSERT(s->max_speed == 50.0f && s->max_rpm == 2000.0f && s->run_time_s == 104.0f,
+                "maxima and last run time");
+    TEST_ASSERT(s->max_voltage == 0.0f, "no voltage, none reported");
+    TEST_ASSERT(obd_trip_poll(&trip, &ev) == OBD_ERROR_NO_DATA && trip.state == OBD_TRIP_OFF,
+                "nothing else");
+
+    /* Capturing live: tick ends it without waiting for another sample */
+    obd_trip_init(&trip);
+    TEST_ASSERT(obd_trip_feed_batch(&trip, channels, values, times, 0, 303) == OBD_OK &&
+                trip.state == OBD_TRIP_STOPPING, "engine off, waiting");
+    obd_trip_tick(&trip, 120 * S);
+    TEST_ASSERT(trip.state == OBD_TRIP_STOPPING, "not yet");
+    obd_trip_tick(&trip, 160 * S);
+    while (obd_trip_poll(&trip, &ev) == OBD_OK && ev.kind != OBD_TRIP_EVENT_END) {}
+    TEST_ASSERT(ev.kind == OBD_TRIP_EVENT_END && s->end_us == 100 * S, "tick ended it");
+
+    printf("  PASS: a drive\n");
+    return 0;
+}
+
+/* ── Test: gaps, restarts, voltage ─────────────────────────────────── */
+static int test_boundaries(void)
+{
+    obd_trip_t trip;
+    obd_trip_event_t ev;
+    uint64_t i;
+
+    obd_trip_init(&trip);
+    for (i = 0; i < 10; i++) obd_trip_feed(&trip, 0x0C, 800.0f, i * S, i);
+    obd_trip_feed(&trip, 0x0C, 800.0f, 50 * S, 10);
+    TEST_ASSERT(next_event(&trip, &ev, OBD_TRIP_EVENT_START) &&
+                next_event(&trip, &ev, OBD_TRIP_EVENT_END) &&
+                ev.trip.end_reason == OBD_TRIP_END_GAP && ev.trip.end_us == 9 * S &&
+                ev.trip.end_pos == 9, "gap: ends at the last sample before it");
+    TEST_ASSERT(next_event(&trip, &ev, OBD_TRIP_EVENT_START) && ev.trip.number == 2 &&
+                ev.trip.start_pos == 10 && !(ev.trip.flags & OBD_TRIP_OPEN_START),
+                "next trip starts after the gap");
+    obd_trip_tick(&trip, 79 * S);
+    TEST_ASSERT(trip.state == OBD_TRIP_ON, "not a gap yet");
+    obd_trip_tick(&trip, 80 * S);
+    TEST_ASSERT(next_event(&trip, &ev, OBD_TRIP_EVENT_END) &&
+                ev.trip.end_reason == OBD_TRIP_END_GAP && ev.trip.end_us == 50 * S,
+                "tick: gap without a sample after it");
+
+    /* Run time went backwards: restarted between two polls */
+    obd_trip_init(&trip);
+    for (i = 0; i < 3; i++) obd_trip_feed(&trip, 0x1F, (float)(100 + i), i * S, i);
+    obd_trip_feed(&trip, 0x1F, 2.0f, 3 * S, 3);
+    TEST_ASSERT(next_event(&trip, &ev, OBD_TRIP_EVENT_START) &&
+                next_event(&trip, &ev, OBD_TRIP_EVENT_END) &&
+                ev.trip.end_reason == OBD_TRIP_END_RESTART && ev.trip.end_pos == 2 &&
+                ev.trip.run_time_s == 102.0f, "restart ends the trip");
+    TEST_ASSERT(next_event(&trip, &ev, OBD_TRIP_EVENT_START) && ev.trip.start_us == 3 * S,
+                "...and starts the next");
+
+    /* A car that doesn't answer with the engine off: voltage alone */
+    obd_trip_init(&trip);
+    for (i = 0; i < 10; i++) obd_trip_feed(&trip, 0x42, 14.1f, i * S, i);
+    for (i = 10; i < 20; i++) obd_trip_feed(&trip, 0x42, 12.4f, i * S, i);
+    obd_trip_tick(&trip, 70 * S);
+    TEST_ASSERT(next_event(&trip, &ev, OBD_TRIP_EVENT_START) &&
+                next_event(&trip, &ev, OBD_TRIP_EVENT_END) &&
+                ev.trip.end_reason == OBD_TRIP_END_ENGINE_OFF && ev.trip.end_us == 10 * S &&
+                ev.trip.max_voltage == 14.1f && ev.trip.min_voltage == 12.4f,
+                "voltage: charging, then not");
+
+    /* With RPM coming in, voltage has no say */
+    obd_trip_init(&trip);
+    obd_trip_feed(&trip, 0x0C, 800.0f, 0, 0);
+    obd_trip_feed(&trip, 0x42, 12.0f, 1 * S, 1);
+    TEST_ASSERT(trip.state == OBD_TRIP_ON, "RPM wins");
+    obd_trip_feed(&trip, 0x05, 90.0f, 2 * S, 2);
+    TEST_ASSERT(trip.state == OBD_TRIP_ON && trip.current.samples == 3 &&
+                trip.current.end_pos == 2, "other channels count, don't vote");
+
+    printf("  PASS: gaps, restarts, voltage\n");
+    return 0;
+}
+
+/* ── Test: parts of an archive, joined ─────────────────────────────── */
+static int test_join(void)
+{
+    obd_trip_t whole, first, second;
+    obd_trip_event_t ev;
+    obd_trip_summary_t all, a, b;
+    size_t half;
+
+    make_drive();
+    half = count / 2;                           /* 90 s: mid-drive */
+
+    obd_trip_init(&whole);
+    obd_trip_feed_batch(&whole, channels, values, times, 0, count);
+    while (obd_trip_poll(&whole, &ev) == OBD_OK) all = ev.trip;
+
+    /* As two threads would, each with its own segmenter */
+    obd_trip_init(&first);
+    obd_trip_init(&second);
+    obd_trip_feed_batch(&first, channels, values, times, 0, half);
+    obd_trip_feed_batch(&second, channels + half, values + half, times + half, half,
+                        count - half);
+    obd_trip_flush(&first);
+    obd_trip_flush(&second);
+    while (obd_trip_poll(&first, &ev) == OBD_OK) a = ev.trip;
+    TEST_ASSERT(next_event(&second, &ev, OBD_TRIP_EVENT_START), "second part starts one");
+    while (obd_trip_poll(&second, &ev) == OBD_OK) b = ev.trip;
+
+    TEST_ASSERT(a.end_reason == OBD_TRIP_END_FLUSH && a.end_pos == half - 1,
+                "first part: flushed at its last sample");
+    TEST_ASSERT((b.flags & OBD_TRIP_OPEN_START) && b.start_pos == half,
+                "second part: running from its first sample");
+    TEST_ASSERT(obd_trip_join(&a, &b, whole.gap_us) == OBD_OK, "joined");
+    TEST_ASSERT(a.start_pos == all.start_pos && a.end_pos == all.end_pos &&
+                a.end_us == all.end_us && a.end_reason == all.end_reason &&
+                a.samples == all.samples && a.idle_us == all.idle_us &&
+                a.idle_periods == all.idle_periods && a.max_rpm == all.max_rpm &&
+                a.run_time_s == all.run_time_s, "same as segmenting it whole");
+    TEST_ASSERT(FLOAT_NEAR(a.distance_km, all.distance_km, 50.0 / 3600 + 0.001),
+                "distance, less the second between the parts");
+
+    TEST_ASSERT(obd_trip_join(&all, &b, whole.gap_us) == OBD_ERROR_NO_DATA,
+                "a trip that ended doesn't continue");
+    b.flags = 0;
+    a.end_reason = OBD_TRIP_END_FLUSH;
+    TEST_ASSERT(obd_trip_join(&a, &b, whole.gap_us) == OBD_ERROR_NO_DATA,
+                "nor does one that started in its part");
+
+    printf("  PASS: joining parts\n");
+    return 0;
+}
+
+/* ── Test: errors and limits ───────────────────────────────────────── */
+static int test_errors(void)
+{
+    obd_trip_t trip;
+    obd_trip_event_t ev;
+    obd_sensor_value_t value = { 0x0C, 800.0f, "Engine RPM", "rpm" };
+    uint64_t i;
+
+    TEST_ASSERT(obd_trip_init(NULL) == OBD_ERROR_INVALID_ARG, "NULL init");
+    obd_trip_init(&trip);
+    TEST_ASSERT(obd_trip_feed(NULL, 0x0C, 1.0f, 0, 0) == OBD_ERROR_INVALID_ARG, "NULL feed");
+    TEST_ASSERT(obd_trip_feed_sensor(&trip, NULL, 0, 0) == OBD_ERROR_INVALID_ARG,
+                "NULL value");
+    TEST_ASSERT(obd_trip_feed_batch(&trip, NULL, NULL, NULL, 0, 1) == OBD_ERROR_INVALID_ARG,
+                "NULL arrays");
+    TEST_ASSERT(obd_trip_poll(&trip, NULL) == OBD_ERROR_INVALID_ARG, "NULL event");
+    TEST_ASSERT(obd_trip_poll(&trip, &ev) == OBD_ERROR_NO_DATA, "no events yet");
+    TEST_ASSERT(obd_trip_join(NULL, &ev.trip, 1) == OBD_ERROR_INVALID_ARG, "NULL join");
+
+    TEST_ASSERT(obd_trip_feed_sensor(&trip, &value, 5 * S, 0) == OBD_OK &&
+                trip.state == OBD_TRIP_ON, "decoded sensor value");
+    TEST_ASSERT(obd_trip_feed(&trip, 0x0C, 800.0f, 4 * S, 1) == OBD_ERROR_INVALID_ARG,
+                "time going backwards");
+    TEST_ASSERT(obd_trip_flush(&trip) == OBD_OK && trip.state == OBD_TRIP_OFF, "flushed");
+
+    /* Many short trips, never polled: the oldest events go */
+    obd_trip_init(&trip);
+    for (i = 0; i < OBD_TRIP_EVENTS; i++) {
+        obd_trip_feed(&trip, 0x0C, 800.0f, i * 100 * S, i * 2);
+        obd_trip_feed(&trip, 0x0C, 0.0f, (i * 100 + 1) * S, i * 2 + 1);
+        obd_trip_tick(&trip, (i * 100 + 70) * S);
+    }
+    TEST_ASSERT(trip.trips == OBD_TRIP_EVENTS && trip.events_lost == OBD_TRIP_EVENTS,
+                "full ring loses the oldest");
+    TEST_ASSERT(next_event(&trip, &ev, OBD_TRIP_EVENT_START) &&
+                ev.trip.number == OBD_TRIP_EVENTS / 2 + 1, "oldest kept");
+
+    printf("  PASS: errors and limits\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== trip tests ===\n");
+    failures += test_drive();
+    failures += test_boundaries();
+    failures += test_join();
+    failures += test_errors();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 4);
+    return failures;
+}
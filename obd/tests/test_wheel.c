@@ -0,0 +1,124 @@
+/**
+ * test_wheel.c — Tests for the timer wheel.
+ *
+ * Times are made up (µs from 0), so nothing here sleeps. Ticks are 1 ms
+ * and the wheel turns once every OBD_WHEEL_SLOTS ms.
+ */
+
+#include <obd/obd_io.h>
+#include "test_assert.h"
+#include <stdio.h>
+
+#define MS 1000u
+
+static obd_wheel_t wheel;
+
+/* ── Test: timers fire once, when due, and not before ──────────────── */
+static int test_expire(void)
+{
+    obd_timer_t a, b, c;
+
+    obd_wheel_init(&wheel, MS, 0);
+    obd_timer_init(&a);
+    obd_timer_init(&b);
+    obd_timer_init(&c);
+    TEST_ASSERT(!obd_timer_pending(&a), "not scheduled yet");
+
+    obd_wheel_schedule(&wheel, &a, 5 * MS);
+    obd_wheel_schedule(&wheel, &b, 2 * MS + 500);
+    obd_wheel_schedule(&wheel, &c, 5 * MS + 1);
+    TEST_ASSERT(obd_wheel_count(&wheel) == 3 && obd_timer_pending(&a), "scheduled");
+    TEST_ASSERT(obd_wheel_next_expiry(&wheel) == 2 * MS + 500, "b is next");
+
+    TEST_ASSERT(obd_wheel_expire(&wheel, 2 * MS) == NULL, "nothing due at 2 ms");
+    TEST_ASSERT(obd_wheel_expire(&wheel, 2 * MS + 500) == &b, "b at 2.5 ms");
+    TEST_ASSERT(obd_wheel_expire(&wheel, 2 * MS + 500) == NULL, "only once");
+    TEST_ASSERT(!obd_timer_pending(&b), "b off the wheel");
+
+    /* a and c share a slot; c is 1 µs later */
+    TEST_ASSERT(obd_wheel_expire(&wheel, 5 * MS) == &a, "a at 5 ms");
+    TEST_ASSERT(obd_wheel_expire(&wheel, 5 * MS) == NULL, "c not yet");
+    TEST_ASSERT(obd_wheel_expire(&wheel, 5 * MS + 1) == &c, "c");
+    TEST_ASSERT(obd_wheel_count(&wheel) == 0 && obd_wheel_next_expiry(&wheel) == 0, "empty");
+
+    printf("  PASS: expiry\n");
+    return 0;
+}
+
+/* ── Test: reschedule and cancel ───────────────────────────────────── */
+static int test_reschedule(void)
+{
+    obd_timer_t a, b;
+
+    obd_wheel_init(&wheel, MS, 0);
+    obd_timer_init(&a);
+    obd_timer_init(&b);
+
+    obd_wheel_schedule(&wheel, &a, 10 * MS);
+    obd_wheel_schedule(&wheel, &a, 3 * MS);
+    TEST_ASSERT(obd_wheel_count(&wheel) == 1, "moved, not added twice");
+    TEST_ASSERT(obd_wheel_expire(&wheel, 3 * MS) == &a, "fires at the new time");
+
+    obd_wheel_schedule(&wheel, &a, 4 * MS);
+    obd_wheel_schedule(&wheel, &b, 4 * MS);
+    obd_wheel_cancel(&wheel, &a);
+    obd_wheel_cancel(&wheel, &a);
+    TEST_ASSERT(obd_wheel_count(&wheel) == 1, "cancelled (twice is fine)");
+    TEST_ASSERT(obd_wheel_expire(&wheel, 4 * MS) == &b, "b still fires");
+    TEST_ASSERT(obd_wheel_expire(&wheel, 4 * MS) == NULL, "a doesn't");
+
+    /* In the past: due at once */
+    obd_wheel_schedule(&wheel, &a, 1 * MS);
+    TEST_ASSERT(obd_wheel_expire(&wheel, 4 * MS) == &a, "late timer fires");
+
+    printf("  PASS: reschedule and cancel\n");
+    return 0;
+}
+
+/* ── Test: beyond one turn of the wheel; long gaps between expires ─── */
+static int test_far_timers(void)
+{
+    const uint64_t turn = OBD_WHEEL_SLOTS * MS;
+    obd_timer_t near, far, later;
+
+    obd_wheel_init(&wheel, MS, 0);
+    obd_timer_init(&near);
+    obd_timer_init(&far);
+    obd_timer_init(&later);
+
+    /* Same slot, one turn apart */
+    obd_wheel_schedule(&wheel, &far, turn + 7 * MS);
+    TEST_ASSERT(obd_wheel_next_expiry(&wheel) == turn + 7 * MS, "only the far one");
+    obd_wheel_schedule(&wheel, &near, 7 * MS);
+    TEST_ASSERT(obd_wheel_next_expiry(&wheel) == 7 * MS, "near one first");
+
+    TEST_ASSERT(obd_wheel_expire(&wheel, 7 * MS) == &near, "near fires");
+    TEST_ASSERT(obd_wheel_expire(&wheel, 7 * MS) == NULL, "far stays");
+    TEST_ASSERT(obd_wheel_expire(&wheel, turn) == NULL, "still not due");
+    TEST_ASSERT(obd_wheel_expire(&wheel, turn + 7 * MS) == &far, "one turn later");
+
+    /* The caller slept for three turns: everything overdue comes out */
+    obd_wheel_schedule(&wheel, &near, turn + 20 * MS);
+    obd_wheel_schedule(&wheel, &later, 2 * turn + 300 * MS);
+    TEST_ASSERT(obd_wheel_expire(&wheel, 5 * turn) != NULL, "first overdue");
+    TEST_ASSERT(obd_wheel_expire(&wheel, 5 * turn) != NULL, "second overdue");
+    TEST_ASSERT(obd_wheel_expire(&wheel, 5 * turn) == NULL, "then none");
+    TEST_ASSERT(obd_wheel_count(&wheel) == 0, "empty");
+
+    printf("  PASS: timers beyond one turn\n");
+    return 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    printf("=== wheel tests ===\n");
+    failures += test_expire();
+    failures += test_reschedule();
+    failures += test_far_timers();
+
+    printf("\n%s (%d test functions)\n",
+           failures == 0 ? "ALL PASSED" : "SOME FAILED", 3);
+    return failures;
+}
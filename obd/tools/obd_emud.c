@@ -0,0 +1,205 @@
+/**
+ * obd_emud.c — Serve the ELM327 emulator over TCP or a Unix socket.
+ *
+ * For trying obd_muxd (or an app) without a car. Each connection gets
+ * its own emulated adapter + car (io/emu.c):
+ *
+ *   obd_emud --listen 35000 --delay-ms 40 &
+ *   obd_muxd --tcp 127.0.0.1:35000 --listen 35001
+ *
+ * --delay-ms holds every reply back that long, like the bus round trip
+ * of a real car (30–100 ms). --vin sets the VIN.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <obd/obd_io.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_CONNECTIONS 64
+#define OUT_LEN         4096
+
+typedef struct {
+    int       fd;                       /* -1 = free */
+    obd_emu_t emu;
+    char      out[OUT_LEN];             /* Reply waiting for its delay */
+    size_t    out_len;
+    uint64_t  due_us;
+} connection_t;
+
+static connection_t conns[MAX_CONNECTIONS];
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s (--listen [HOST:]PORT | --listen-unix PATH)\n"
+            "          [--delay-ms N] [--vin VIN]\n",
+            argv0);
+}
+
+static void serve(connection_t *c, uint64_t delay_us, uint64_t now)
+{
+    char in[512];
+    char reply[OUT_LEN];
+    size_t n_out = 0;
+    ssize_t n;
+
+    for (;;) {
+        n = read(c->fd, in, sizeof(in));
+        if (n > 0) {
+            if (obd_emu_feed(&c->emu, in, (size_t)n, reply, sizeof(reply), &n_out) == OBD_OK &&
+                c->out_len + n_out <= sizeof(c->out)) {
+                memcpy(c->out + c->out_len, reply, n_out);
+                c->out_len += n_out;
+                if (n_out > 0) c->due_us = now + delay_us;
+            }
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close(c->fd);
+            c->fd = -1;
+        }
+        return;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *listen_tcp = NULL, *listen_unix = NULL, *vin = NULL;
+    struct pollfd fds[1 + MAX_CONNECTIONS];
+    connection_t *owner[1 + MAX_CONNECTIONS];
+    uint64_t delay_us = 0;
+    int listen_fd = -1;
+    struct sigaction sa;
+    size_t i;
+
+    for (i = 1; i < (size_t)argc; i++) {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < (size_t)argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--listen") == 0 && val) {
+            listen_tcp = val; i++;
+        } else if (strcmp(arg, "--listen-unix") == 0 && val) {
+            listen_unix = val; i++;
+        } else if (strcmp(arg, "--delay-ms") == 0 && val) {
+            delay_us = (uint64_t)atol(val) * 1000u; i++;
+        } else if (strcmp(arg, "--vin") == 0 && val) {
+            vin = val; i++;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (listen_tcp) {
+        const char *colon = strrchr(listen_tcp, ':');
+        char host[256] = "";
+        long port = strtol(colon ? colon + 1 : listen_tcp, NULL, 10);
+        if (colon && (size_t)(colon - listen_tcp) < sizeof(host)) {
+            memcpy(host, listen_tcp, (size_t)(colon - listen_tcp));
+            host[colon - listen_tcp] = '\0';
+        }
+        if (port <= 0 || port > 65535 ||
+            obd_net_listen_tcp(host[0] ? host : NULL, (uint16_t)port, &listen_fd) != OBD_OK) {
+            listen_fd = -1;
+        }
+    } else if (listen_unix) {
+        if (obd_net_listen_unix(listen_unix, &listen_fd) != OBD_OK) listen_fd = -1;
+    } else {
+        usage(argv[0]);
+        return 2;
+    }
+    if (listen_fd < 0) {
+        fprintf(stderr, "obd_emud: can't listen: %s\n", strerror(errno));
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (i = 0; i < MAX_CONNECTIONS; i++) conns[i].fd = -1;
+
+    while (!stop_requested) {
+        uint64_t now = obd_io_now_us(), next_due = 0;
+        size_t nfds = 0;
+        int timeout_ms = 1000;
+
+        fds[nfds].fd = listen_fd;
+        fds[nfds].events = POLLIN;
+        owner[nfds++] = NULL;
+        for (i = 0; i < MAX_CONNECTIONS; i++) {
+            if (conns[i].fd < 0) continue;
+            fds[nfds].fd = conns[i].fd;
+            fds[nfds].events = POLLIN;
+            owner[nfds++] = &conns[i];
+            if (conns[i].out_len > 0 && (next_due == 0 || conns[i].due_us < next_due)) {
+                next_due = conns[i].due_us;
+            }
+        }
+        if (next_due != 0) {
+            timeout_ms = next_due > now ? (int)((next_due - now + 999) / 1000) : 0;
+        }
+
+        if (poll(fds, (nfds_t)nfds, timeout_ms) < 0 && errno != EINTR) {
+            break;
+        }
+        now = obd_io_now_us();
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+                connection_t *c = NULL;
+                for (i = 0; i < MAX_CONNECTIONS && !c; i++) {
+                    if (conns[i].fd < 0) c = &conns[i];
+                }
+                if (!c || obd_net_set_nonblocking(fd) != OBD_OK) {
+                    close(fd);
+                    continue;
+                }
+                c->fd = fd;
+                c->out_len = 0;
+                obd_emu_init(&c->emu);
+                if (vin) obd_emu_set_vin(&c->emu, vin);
+            }
+        }
+        for (i = 1; i < nfds; i++) {
+            if (owner[i]->fd >= 0 && fds[i].revents) serve(owner[i], delay_us, now);
+        }
+
+        /* Send the replies whose delay is up */
+        for (i = 0; i < MAX_CONNECTIONS; i++) {
+            connection_t *c = &conns[i];
+            ssize_t n;
+            if (c->fd < 0 || c->out_len == 0 || c->due_us > now) continue;
+            n = send(c->fd, c->out, c->out_len, MSG_NOSIGNAL);
+            if (n > 0) {
+                memmove(c->out, c->out + n, c->out_len - (size_t)n);
+                c->out_len -= (size_t)n;
+            }
+        }
+    }
+
+    for (i = 0; i < MAX_CONNECTIONS; i++) {
+        if (conns[i].fd >= 0) close(conns[i].fd);
+    }
+    close(listen_fd);
+    if (listen_unix) unlink(listen_unix);
+    return 0;
+}
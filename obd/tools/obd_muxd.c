@@ -0,0 +1,266 @@
+/**
+ * obd_muxd.c — Share one ELM327 between many local programs.
+ *
+ * Opens the adapter once and serves an ELM327-compatible endpoint on TCP
+ * and/or a Unix socket. Every client behaves as if it had the adapter to
+ * itself; behind the scenes their requests are queued fairly, identical
+ * ones are shared, and fresh answers come from a cache (see io/mux.c and
+ * docs/15-mux-explained.txt).
+ *
+ * Usage:
+ *   obd_muxd --serial /dev/rfcomm0 --listen 35000
+ *   obd_muxd --tcp 192.168.0.10:35000 --listen-unix /run/obd.sock --batch
+ *   obd_muxd --serial /dev/ttyUSB0 --baud 115200 --listen 35000 \
+ *            --ttl 01:0D:200 --stats-every 60
+ *
+ * Clients then connect to 127.0.0.1:35000 (or the socket) exactly as they
+ * would to a WiFi ELM327. --listen takes PORT (localhost only) or
+ * HOST:PORT, e.g. 0.0.0.0:35000 for the technician's laptop.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <obd/obd_io.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+/* "HOST:PORT" or "PORT" → host (NULL = localhost) and port */
+static int split_endpoint(const char *text, char *host, size_t host_size,
+                          uint16_t *port)
+{
+    const char *colon = strrchr(text, ':');
+    long value;
+
+    host[0] = '\0';
+    if (colon) {
+        size_t len = (size_t)(colon - text);
+        if (len == 0 || len >= host_size) return 0;
+        memcpy(host, text, len);
+        host[len] = '\0';
+        text = colon + 1;
+    }
+    value = strtol(text, NULL, 10);
+    if (value <= 0 || value > 65535) return 0;
+    *port = (uint16_t)value;
+    return 1;
+}
+
+static speed_t baud_constant(long baud)
+{
+    switch (baud) {
+    case 9600:   return B9600;
+    case 19200:  return B19200;
+    case 38400:  return B38400;
+    case 57600:  return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default:     return 0;
+    }
+}
+
+/* Raw 8N1, no echo, no line editing: the ELM327's bytes, untouched */
+static int open_serial(const char *path, long baud)
+{
+    struct termios tio;
+    speed_t speed = baud_constant(baud);
+    int fd;
+
+    if (speed == 0) {
+        fprintf(stderr, "obd_muxd: unsupported baud rate %ld\n", baud);
+        return -1;
+    }
+    fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+/* "01:0D:200" or "09:*:-1" → obd_cache_set_ttl(). -1 ms = forever. */
+static int parse_ttl(obd_mux_t *mux, const char *text)
+{
+    unsigned mode, pid = OBD_CACHE_ANY_PID;
+    char pid_text[8];
+    long ms;
+
+    if (sscanf(text, "%x:%7[^:]:%ld", &mode, pid_text, &ms) != 3 || mode > 0xFF) {
+        return 0;
+    }
+    if (strcmp(pid_text, "*") != 0 && sscanf(pid_text, "%x", &pid) != 1) {
+        return 0;
+    }
+    return obd_cache_set_ttl(&mux->cache, (uint8_t)mode, (uint16_t)pid,
+                             ms < 0 ? OBD_CACHE_TTL_FOREVER
+                                    : (uint64_t)ms * 1000u) == OBD_OK;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s (--serial PATH [--baud N] | --tcp HOST:PORT | --unix PATH)\n"
+            "          [--listen [HOST:]PORT]... [--listen-unix PATH]...\n"
+            "          [--batch] [--timeout-ms N] [--ttl MODE:PID|*:MS]...\n"
+            "          [--stats-every SECONDS]\n",
+            argv0);
+}
+
+static obd_mux_t mux;                   /* ~60 KB: keep it off the stack */
+
+int main(int argc, char **argv)
+{
+    const char *serial = NULL, *tcp = NULL, *unix_path = NULL;
+    const char *listen_tcp[OBD_MUX_MAX_LISTENERS];
+    const char *listen_unix[OBD_MUX_MAX_LISTENERS];
+    const char *ttls[OBD_CACHE_TTL_RULES];
+    size_t tcp_count = 0, unix_count = 0, ttl_count = 0;
+    long baud = 38400, timeout_ms = 0, stats_every = 0;
+    int batch = 0, adapter = -1, fd;
+    uint64_t next_stats = 0;
+    char host[256];
+    uint16_t port;
+    struct sigaction sa;
+    obd_result_t r;
+    size_t i;
+
+    for (i = 1; i < (size_t)argc; i++) {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < (size_t)argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--serial") == 0 && val) {
+            serial = val; i++;
+        } else if (strcmp(arg, "--baud") == 0 && val) {
+            baud = atol(val); i++;
+        } else if (strcmp(arg, "--tcp") == 0 && val) {
+            tcp = val; i++;
+        } else if (strcmp(arg, "--unix") == 0 && val) {
+            unix_path = val; i++;
+        } else if (strcmp(arg, "--listen") == 0 && val &&
+                   tcp_count + unix_count < OBD_MUX_MAX_LISTENERS) {
+            listen_tcp[tcp_count++] = val; i++;
+        } else if (strcmp(arg, "--listen-unix") == 0 && val &&
+                   tcp_count + unix_count < OBD_MUX_MAX_LISTENERS) {
+            listen_unix[unix_count++] = val; i++;
+        } else if (strcmp(arg, "--batch") == 0) {
+            batch = 1;
+        } else if (strcmp(arg, "--timeout-ms") == 0 && val) {
+            timeout_ms = atol(val); i++;
+        } else if (strcmp(arg, "--ttl") == 0 && val && ttl_count < OBD_CACHE_TTL_RULES) {
+            ttls[ttl_count++] = val; i++;
+        } else if (strcmp(arg, "--stats-every") == 0 && val) {
+            stats_every = atol(val); i++;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if ((serial != NULL) + (tcp != NULL) + (unix_path != NULL) != 1 ||
+        tcp_count + unix_count == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    /* ── The adapter ── */
+    if (serial) {
+        adapter = open_serial(serial, baud);
+    } else if (tcp) {
+        if (split_endpoint(tcp, host, sizeof(host), &port) &&
+            obd_net_connect_tcp(host[0] ? host : NULL, port, &fd) == OBD_OK) {
+            adapter = fd;
+        }
+    } else if (obd_net_connect_unix(unix_path, &fd) == OBD_OK) {
+        adapter = fd;
+    }
+    if (adapter < 0) {
+        fprintf(stderr, "obd_muxd: can't open adapter %s: %s\n",
+                serial ? serial : tcp ? tcp : unix_path, strerror(errno));
+        return 1;
+    }
+
+    obd_mux_init(&mux, adapter);
+    obd_mux_set_batching(&mux, batch);
+    if (timeout_ms > 0) {
+        obd_session_set_timeout(&mux.session, (uint64_t)timeout_ms * 1000u);
+    }
+    for (i = 0; i < ttl_count; i++) {
+        if (!parse_ttl(&mux, ttls[i])) {
+            fprintf(stderr, "obd_muxd: bad --ttl %s\n", ttls[i]);
+            return 2;
+        }
+    }
+
+    /* ── Where clients connect ── */
+    for (i = 0; i < tcp_count; i++) {
+        if (!split_endpoint(listen_tcp[i], host, sizeof(host), &port) ||
+            obd_net_listen_tcp(host[0] ? host : NULL, port, &fd) != OBD_OK) {
+            fprintf(stderr, "obd_muxd: can't listen on %s: %s\n", listen_tcp[i],
+                    strerror(errno));
+            return 1;
+        }
+        obd_mux_add_listener(&mux, fd);
+    }
+    for (i = 0; i < unix_count; i++) {
+        if (obd_net_listen_unix(listen_unix[i], &fd) != OBD_OK) {
+            fprintf(stderr, "obd_muxd: can't listen on %s: %s\n", listen_unix[i],
+                    strerror(errno));
+            return 1;
+        }
+        obd_mux_add_listener(&mux, fd);
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);           /* A serial/TCP adapter hanging up */
+
+    fprintf(stderr, "obd_muxd: serving %zu endpoint(s)\n", tcp_count + unix_count);
+    if (stats_every > 0) next_stats = obd_io_now_us() + (uint64_t)stats_every * 1000000u;
+
+    r = OBD_OK;
+    while (!stop_requested && r == OBD_OK) {
+        r = obd_mux_step(&mux, 1000);
+
+        if (stats_every > 0 && obd_io_now_us() >= next_stats) {
+            static char report[8192];
+            if (obd_mux_format_text(&mux, report, sizeof(report)) == OBD_OK) {
+                fputs(report, stderr);
+            }
+            next_stats += (uint64_t)stats_every * 1000000u;
+        }
+    }
+    if (r != OBD_OK) {
+        fprintf(stderr, "obd_muxd: adapter lost: %s\n", strerror(errno));
+    }
+
+    {
+        static char report[8192];
+        if (obd_mux_format_text(&mux, report, sizeof(report)) == OBD_OK) {
+            fputs(report, stderr);
+        }
+    }
+    obd_mux_close(&mux);
+    for (i = 0; i < unix_count; i++) unlink(listen_unix[i]);
+    close(adapter);
+    return r == OBD_OK ? 0 : 1;
+}